@@ -37,27 +37,61 @@ limitations under the License.
 
 namespace xla {
 namespace interpreter {
+namespace {
+
+// Returns `evaluator`, using `dynamic_dimension_inference` if it has a value.
+std::unique_ptr<HloEvaluator> WithDynamicDimensionInference(
+    std::unique_ptr<HloEvaluator> evaluator,
+    std::optional<DynamicDimensionInference>& dynamic_dimension_inference) {
+  if (dynamic_dimension_inference.has_value()) {
+    evaluator->set_dynamic_dimension_inference(
+        &dynamic_dimension_inference.value());
+  }
+  return evaluator;
+}
+
+}  // namespace
 
 InterpreterExecutable::InterpreterExecutable(
     std::unique_ptr<HloModule> hlo_module,
     std::unique_ptr<HloEvaluator> evaluator,
     std::optional<DynamicDimensionInference> dynamic_dymension_inference)
     : InterpreterExecutableBase(std::move(hlo_module)),
-      evaluator_(std::move(evaluator)),
-      dynamic_dimension_inference_(std::move(dynamic_dymension_inference)) {
-  if (dynamic_dimension_inference_.has_value()) {
-    evaluator_->set_dynamic_dimension_inference(
-        &dynamic_dimension_inference_.value());
-  }
-}
+      dynamic_dimension_inference_(std::move(dynamic_dymension_inference)),
+      evaluator_(WithDynamicDimensionInference(std::move(evaluator),
+                                               dynamic_dimension_inference_)) {}
 
 StatusOr<Literal> InterpreterExecutable::Evaluate(
     const ServiceExecutableRunOptions* run_options,
     const HloComputation& computation, absl::Span<const Literal> arg_literals) {
-  // Execute the graph using the HloEvaluator.
+  // Execute the graph using an HloEvaluator of our own, so that concurrent
+  // executions of this executable don't wait for each other.
+  std::unique_ptr<HloEvaluator> evaluator = AcquireEvaluator();
+  evaluator->ResetVisitStates();
+  StatusOr<Literal> result = evaluator->Evaluate(computation, arg_literals);
+  ReleaseEvaluator(std::move(evaluator));
+  return result;
+}
+
+std::unique_ptr<HloEvaluator> InterpreterExecutable::AcquireEvaluator() {
+  {
+    absl::MutexLock lock(&evaluator_lock_);
+    if (!idle_evaluators_.empty()) {
+      std::unique_ptr<HloEvaluator> evaluator =
+          std::move(idle_evaluators_.back());
+      idle_evaluators_.pop_back();
+      return evaluator;
+    }
+  }
+  // evaluator_ is const, and Clone only reads it, so concurrent executions
+  // can clone it without holding the lock.
+  return evaluator_->Clone();
+}
+
+void InterpreterExecutable::ReleaseEvaluator(
+    std::unique_ptr<HloEvaluator> evaluator) {
   absl::MutexLock lock(&evaluator_lock_);
-  evaluator_->ResetVisitStates();
-  return evaluator_->Evaluate(computation, arg_literals);
+  idle_evaluators_.push_back(std::move(evaluator));
 }
 
 /*static*/ int64_t InterpreterExecutable::ShapeSizeBytes(const Shape& shape) {
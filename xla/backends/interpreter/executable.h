@@ -17,7 +17,10 @@ limitations under the License.
 #define XLA_BACKENDS_INTERPRETER_EXECUTABLE_H_
 
 #include <memory>
+#include <optional>
+#include <vector>
 
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "xla/backends/interpreter/executable_base.h"
 #include "xla/hlo/evaluator/hlo_evaluator.h"
@@ -53,12 +56,23 @@ class InterpreterExecutable : public InterpreterExecutableBase {
                              absl::Span<const Literal> arg_literals) override
       ABSL_LOCKS_EXCLUDED(evaluator_lock_);
 
-  // The interpreter interprets executables with an HloEvaluator.
-  std::unique_ptr<HloEvaluator> evaluator_ ABSL_PT_GUARDED_BY(evaluator_lock_);
+  // Referenced by evaluator_ and its clones, so it is declared before them.
+  std::optional<DynamicDimensionInference> dynamic_dimension_inference_;
+  // The interpreter interprets executables with HloEvaluators cloned from this
+  // one, which is only used as a template and never evaluates anything itself.
+  std::unique_ptr<const HloEvaluator> evaluator_;
   mutable absl::Mutex evaluator_lock_;
+  // Evaluators that are not running a computation. Each concurrent execution
+  // takes one from here, or clones a new one if there are none, and returns it
+  // when done, so the pool grows to the peak number of concurrent executions.
+  std::vector<std::unique_ptr<HloEvaluator>> idle_evaluators_
+      ABSL_GUARDED_BY(evaluator_lock_);
 
  private:
-  std::optional<DynamicDimensionInference> dynamic_dimension_inference_;
+  std::unique_ptr<HloEvaluator> AcquireEvaluator()
+      ABSL_LOCKS_EXCLUDED(evaluator_lock_);
+  void ReleaseEvaluator(std::unique_ptr<HloEvaluator> evaluator)
+      ABSL_LOCKS_EXCLUDED(evaluator_lock_);
   InterpreterExecutable(const InterpreterExecutable&) = delete;
   InterpreterExecutable& operator=(const InterpreterExecutable&) = delete;
 };
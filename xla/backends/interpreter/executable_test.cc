@@ -0,0 +1,186 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/backends/interpreter/executable.h"
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/blocking_counter.h"
+#include "xla/hlo/evaluator/hlo_evaluator.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/literal.h"
+#include "xla/literal_util.h"
+#include "xla/service/hlo_parser.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace interpreter {
+namespace {
+
+// Exposes Evaluate, so that the executable can be run without a stream.
+class TestInterpreterExecutable : public InterpreterExecutable {
+ public:
+  using InterpreterExecutable::Evaluate;
+  using InterpreterExecutable::InterpreterExecutable;
+};
+
+// Adds 1 to every element of the parameter 100 times in a while loop, so that
+// every evaluation also goes through embedded evaluators.
+constexpr std::string_view kLoopHlo = R"(
+HloModule Loop
+
+cond {
+  p = (s32[], f32[16]) parameter(0)
+  i = s32[] get-tuple-element(p), index=0
+  limit = s32[] constant(100)
+  ROOT lt = pred[] compare(i, limit), direction=LT
+}
+
+body {
+  p = (s32[], f32[16]) parameter(0)
+  i = s32[] get-tuple-element(p), index=0
+  x = f32[16] get-tuple-element(p), index=1
+  one = s32[] constant(1)
+  next = s32[] add(i, one)
+  c = f32[] constant(1)
+  b = f32[16] broadcast(c), dimensions={}
+  y = f32[16] add(x, b)
+  ROOT t = (s32[], f32[16]) tuple(next, y)
+}
+
+ENTRY main {
+  x = f32[16] parameter(0)
+  zero = s32[] constant(0)
+  init = (s32[], f32[16]) tuple(zero, x)
+  loop = (s32[], f32[16]) while(init), condition=cond, body=body
+  ROOT r = f32[16] get-tuple-element(loop), index=1
+}
+)";
+
+std::unique_ptr<TestInterpreterExecutable> MakeExecutable(
+    std::string_view hlo, std::unique_ptr<HloEvaluator> evaluator) {
+  auto module = ParseAndReturnUnverifiedModule(hlo);
+  CHECK_OK(module.status());
+  return std::make_unique<TestInterpreterExecutable>(
+      std::move(module).value(), std::move(evaluator),
+      /*dynamic_dymension_inference=*/std::nullopt);
+}
+
+Literal Full(float value) {
+  return LiteralUtil::CreateR1<float>(std::vector<float>(16, value));
+}
+
+TEST(InterpreterExecutableTest, ConcurrentEvaluationsGetTheirOwnResults) {
+  std::unique_ptr<TestInterpreterExecutable> executable =
+      MakeExecutable(kLoopHlo, std::make_unique<HloEvaluator>());
+  const HloComputation& entry = *executable->module().entry_computation();
+
+  constexpr int kNumThreads = 8;
+  constexpr int kRunsPerThread = 10;
+  std::vector<char> ok(kNumThreads * kRunsPerThread, false);
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "test", kNumThreads);
+    for (int i = 0; i < kNumThreads * kRunsPerThread; ++i) {
+      pool.Schedule([&, i]() {
+        Literal arg = Full(i);
+        auto result = executable->Evaluate(/*run_options=*/nullptr, entry,
+                                           absl::MakeSpan(&arg, 1));
+        ok[i] = result.ok() && *result == Full(i + 100);
+      });
+    }
+  }
+  for (int i = 0; i < kNumThreads * kRunsPerThread; ++i) {
+    EXPECT_TRUE(ok[i]) << "evaluation " << i;
+  }
+}
+
+TEST(InterpreterExecutableTest, PooledEvaluatorsKeepCustomCallHandler) {
+  constexpr std::string_view kHlo = R"(
+HloModule CustomCall
+
+ENTRY main {
+  x = f32[16] parameter(0)
+  ROOT r = f32[16] custom-call(x), custom_call_target="negate"
+})";
+  auto evaluator = std::make_unique<HloEvaluator>();
+  evaluator->set_custom_call_handler(
+      [](HloInstruction*, absl::Span<const Literal*> operands) {
+        Literal result = operands[0]->Clone();
+        result.MutableEachCell<float>(
+            [](absl::Span<const int64_t>, float x) { return -x; });
+        return StatusOr<Literal>(std::move(result));
+      });
+  std::unique_ptr<TestInterpreterExecutable> executable =
+      MakeExecutable(kHlo, std::move(evaluator));
+  const HloComputation& entry = *executable->module().entry_computation();
+
+  constexpr int kNumRuns = 16;
+  std::vector<char> ok(kNumRuns, false);
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "test", 4);
+    for (int i = 0; i < kNumRuns; ++i) {
+      pool.Schedule([&, i]() {
+        Literal arg = Full(i);
+        auto result = executable->Evaluate(/*run_options=*/nullptr, entry,
+                                           absl::MakeSpan(&arg, 1));
+        ok[i] = result.ok() && *result == Full(-i);
+      });
+    }
+  }
+  for (int i = 0; i < kNumRuns; ++i) {
+    EXPECT_TRUE(ok[i]) << "evaluation " << i;
+  }
+}
+
+// Evaluates kLoopHlo 16 times per iteration, spread over range(0) threads.
+void BM_ConcurrentEvaluate(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  constexpr int kNumRuns = 16;
+  std::unique_ptr<TestInterpreterExecutable> executable =
+      MakeExecutable(kLoopHlo, std::make_unique<HloEvaluator>());
+  const HloComputation& entry = *executable->module().entry_computation();
+  Literal arg = Full(1);
+
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "bench", num_threads);
+  for (auto s : state) {
+    absl::BlockingCounter done(kNumRuns);
+    for (int i = 0; i < kNumRuns; ++i) {
+      pool.Schedule([&]() {
+        CHECK_OK(executable
+                     ->Evaluate(/*run_options=*/nullptr, entry,
+                                absl::MakeSpan(&arg, 1))
+                     .status());
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * kNumRuns);
+}
+
+BENCHMARK(BM_ConcurrentEvaluate)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+}  // namespace
+}  // namespace interpreter
+}  // namespace xla
@@ -111,6 +111,8 @@ DebugOptions DefaultDebugOptionsIgnoringFlags() {
   opts.set_xla_cpu_matmul_tiling_n_dim(8);
   opts.set_xla_cpu_matmul_tiling_k_dim(8);
   opts.set_xla_cpu_enable_experimental_deallocation(true);
+  opts.set_xla_cpu_parallel_codegen_split_count(1);
+  opts.set_xla_cpu_enable_inter_op_parallelism(false);
 
   opts.set_xla_partitioning_algorithm(
       DebugOptions::PARTITIONING_ALGORITHM_NOOP);
@@ -885,6 +887,19 @@ void MakeDebugOptionsFlags(std::vector<tsl::Flag>* flag_list,
           &DebugOptions::set_xla_cpu_enable_experimental_deallocation),
       debug_options->xla_cpu_enable_experimental_deallocation(),
       "Enable experimental deallocation."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_parallel_codegen_split_count",
+      int32_setter_for(&DebugOptions::set_xla_cpu_parallel_codegen_split_count),
+      debug_options->xla_cpu_parallel_codegen_split_count(),
+      "If greater than 1, split the LLVM module of each XLA:CPU computation "
+      "into up to this many shards that are compiled in parallel."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_enable_inter_op_parallelism",
+      bool_setter_for(
+          &DebugOptions::set_xla_cpu_enable_inter_op_parallelism),
+      debug_options->xla_cpu_enable_inter_op_parallelism(),
+      "Compile each op of the entry computation of XLA:CPU executables to its "
+      "own function and run independent ones concurrently."));
   flag_list->push_back(
       tsl::Flag("xla_gpu_enable_latency_hiding_scheduler",
                 bool_setter_for(
@@ -54,6 +54,10 @@ class DeviceAssignment;
 class ExecutionProfile;
 class Shape;
 
+namespace cpu {
+class CpuExecutableRunOptions;
+}  // namespace cpu
+
 namespace gpu {
 class GpuExecutableRunOptions;
 }  // namespace gpu
@@ -215,6 +219,12 @@ class ExecutableRunOptions {
       const gpu::GpuExecutableRunOptions* gpu_executable_run_options);
   const gpu::GpuExecutableRunOptions* gpu_executable_run_options() const;
 
+  // CPU-backend specific options. These are kept out-of-line to avoid bloating
+  // the size of this dependency for AOT builds.
+  ExecutableRunOptions& set_cpu_executable_run_options(
+      const cpu::CpuExecutableRunOptions* cpu_executable_run_options);
+  const cpu::CpuExecutableRunOptions* cpu_executable_run_options() const;
+
  private:
   stream_executor::DeviceMemoryAllocator* allocator_ = nullptr;
   int device_ordinal_ = -1;
@@ -231,6 +241,7 @@ class ExecutableRunOptions {
   RecvDeviceMemoryFunction* recv_device_memory_function_ = nullptr;
   RunId run_id_;
   const gpu::GpuExecutableRunOptions* gpu_executable_run_options_ = nullptr;
+  const cpu::CpuExecutableRunOptions* cpu_executable_run_options_ = nullptr;
 };
 
 }  // namespace xla
@@ -0,0 +1,509 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_HLO_EVALUATOR_COMPILED_SCALAR_COMPUTATION_H_
+#define XLA_HLO_EVALUATOR_COMPILED_SCALAR_COMPUTATION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/types/span.h"
+#include "xla/comparison_util.h"
+#include "xla/hlo/evaluator/hlo_evaluator_typed_visitor.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/primitive_util.h"
+#include "xla/shape_util.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+
+// A scalar computation, such as the reducer of a reduce or the comparator of a
+// sort, compiled once into a flat program over native values of type T, so
+// that it can be applied to the elements of a literal without creating a
+// Literal and an embedded HloEvaluator per call.
+//
+// Only computations of scalars of type T and PRED are supported, with the
+// elementwise ops listed in Compile(); values of type PRED are held as T(0)
+// and T(1). Parameters that the computation doesn't use may have any shape.
+// The ops round to T after each step and otherwise follow
+// HloEvaluatorTypedVisitor, so the results are identical.
+template <typename T>
+class CompiledScalarComputation {
+ public:
+  // Compiles `computation`, whose root must be a scalar of `result_type`,
+  // which is either PRED or the primitive type of T. Returns nullopt if the
+  // computation uses anything but parameters, constants, add, subtract,
+  // multiply, divide, maximum, minimum, and, or, xor, not, compare and select.
+  static std::optional<CompiledScalarComputation> Compile(
+      const HloComputation& computation, PrimitiveType result_type);
+
+  int64_t parameter_count() const { return uses_parameter_.size(); }
+  bool uses_parameter(int64_t i) const { return uses_parameter_[i]; }
+
+  // Runs the computation on `args`, where args[i] is the value of parameter i
+  // and is ignored if the computation doesn't use it.
+  T operator()(absl::Span<const T> args) const;
+
+  // Folds `values` into `acc` in order with a computation of two parameters,
+  // as reduce does with its reducer. Common reducers such as add and max run
+  // as a plain loop, which compilers vectorize where that is exact, i.e. for
+  // integers.
+  T Reduce(T acc, absl::Span<const T> values) const;
+
+ private:
+  // One instruction of the computation, in post order.
+  struct Step {
+    HloOpcode opcode;
+    // Whether the instruction produces a PRED.
+    bool is_pred = false;
+    ComparisonDirection direction = ComparisonDirection::kEq;
+    // Indices of the steps of the operands.
+    int64_t operands[3] = {0, 0, 0};
+    // The parameter number of a parameter or the value of a constant.
+    int64_t parameter_number = 0;
+    T constant = T();
+  };
+
+  // Returns true if Reduce folds with `opcode` directly. binary_opcode_ must
+  // only hold such opcodes, since operator() runs it through Reduce, which
+  // falls back to operator() for any other.
+  static bool IsReduceOpcode(HloOpcode opcode);
+
+  template <HloOpcode kOpcode>
+  static T Binary(T lhs, T rhs);
+  template <HloOpcode kOpcode>
+  T ReduceWith(T acc, absl::Span<const T> values) const;
+
+  std::vector<Step> steps_;
+  std::vector<bool> uses_parameter_;
+  // Set if the computation is `opcode(parameter(0), parameter(1))` for an
+  // opcode that IsReduceOpcode.
+  std::optional<HloOpcode> binary_opcode_;
+};
+
+// Calls `fn` with a value of the native type of `type`, and returns true, if
+// CompiledScalarComputation supports that type. Narrower floating point types
+// are computed in float by HloEvaluatorTypedVisitor and aren't supported.
+template <typename Fn>
+bool VisitCompiledScalarType(PrimitiveType type, Fn&& fn) {
+  switch (type) {
+    case PRED:
+      fn(bool{});
+      return true;
+    case S8:
+      fn(int8_t{});
+      return true;
+    case S16:
+      fn(int16_t{});
+      return true;
+    case S32:
+      fn(int32_t{});
+      return true;
+    case S64:
+      fn(int64_t{});
+      return true;
+    case U8:
+      fn(uint8_t{});
+      return true;
+    case U16:
+      fn(uint16_t{});
+      return true;
+    case U32:
+      fn(uint32_t{});
+      return true;
+    case U64:
+      fn(uint64_t{});
+      return true;
+    case F32:
+      fn(float{});
+      return true;
+    case F64:
+      fn(double{});
+      return true;
+    default:
+      return false;
+  }
+}
+
+template <typename T>
+std::optional<CompiledScalarComputation<T>>
+CompiledScalarComputation<T>::Compile(const HloComputation& computation,
+                                      PrimitiveType result_type) {
+  constexpr PrimitiveType kType = primitive_util::NativeToPrimitiveType<T>();
+  const HloInstruction* root = computation.root_instruction();
+  if (!ShapeUtil::IsScalarWithElementType(root->shape(), result_type) ||
+      (result_type != kType && result_type != PRED)) {
+    return std::nullopt;
+  }
+
+  CompiledScalarComputation compiled;
+  compiled.uses_parameter_.resize(computation.num_parameters());
+  absl::flat_hash_map<const HloInstruction*, int64_t> step_indices;
+  // Operands only, as the embedded evaluator doesn't run unreachable
+  // instructions either.
+  std::vector<std::pair<const HloInstruction*, bool>> stack = {{root, false}};
+  while (!stack.empty()) {
+    auto [instruction, operands_done] = stack.back();
+    stack.pop_back();
+    if (step_indices.contains(instruction)) {
+      continue;
+    }
+    if (!operands_done) {
+      stack.push_back({instruction, true});
+      for (const HloInstruction* operand : instruction->operands()) {
+        stack.push_back({operand, false});
+      }
+      continue;
+    }
+
+    const Shape& shape = instruction->shape();
+    if (!ShapeUtil::IsScalar(shape) ||
+        (shape.element_type() != kType && shape.element_type() != PRED) ||
+        instruction->operand_count() > 3) {
+      return std::nullopt;
+    }
+    Step step;
+    step.opcode = instruction->opcode();
+    step.is_pred = shape.element_type() == PRED;
+    for (int64_t i = 0; i < instruction->operand_count(); ++i) {
+      step.operands[i] = step_indices.at(instruction->operand(i));
+    }
+    // All ops but compare and select take operands of their own type.
+    bool same_type_operands = true;
+    switch (instruction->opcode()) {
+      case HloOpcode::kParameter:
+        if (step.is_pred && kType != PRED) {
+          return std::nullopt;
+        }
+        step.parameter_number = instruction->parameter_number();
+        compiled.uses_parameter_[step.parameter_number] = true;
+        break;
+      case HloOpcode::kConstant:
+        step.constant = step.is_pred
+                            ? T(instruction->literal().GetFirstElement<bool>())
+                            : instruction->literal().GetFirstElement<T>();
+        break;
+      case HloOpcode::kAdd:
+      case HloOpcode::kSubtract:
+      case HloOpcode::kMultiply:
+      case HloOpcode::kDivide:
+      case HloOpcode::kMaximum:
+      case HloOpcode::kMinimum:
+        if (step.is_pred && kType != PRED) {
+          return std::nullopt;
+        }
+        break;
+      case HloOpcode::kAnd:
+      case HloOpcode::kOr:
+      case HloOpcode::kXor:
+        if (!step.is_pred && !std::is_integral_v<T>) {
+          return std::nullopt;
+        }
+        break;
+      case HloOpcode::kNot:
+        if (!step.is_pred) {
+          return std::nullopt;
+        }
+        break;
+      case HloOpcode::kCompare:
+        step.direction = instruction->comparison_direction();
+        same_type_operands =
+            instruction->operand(0)->shape().element_type() ==
+            instruction->operand(1)->shape().element_type();
+        break;
+      case HloOpcode::kSelect:
+        same_type_operands =
+            instruction->operand(1)->shape().element_type() ==
+                shape.element_type() &&
+            instruction->operand(2)->shape().element_type() ==
+                shape.element_type();
+        break;
+      default:
+        return std::nullopt;
+    }
+    if (instruction->opcode() != HloOpcode::kCompare &&
+        instruction->opcode() != HloOpcode::kSelect) {
+      for (const HloInstruction* operand : instruction->operands()) {
+        same_type_operands &=
+            operand->shape().element_type() == shape.element_type();
+      }
+    }
+    if (!same_type_operands) {
+      return std::nullopt;
+    }
+    step_indices[instruction] = compiled.steps_.size();
+    compiled.steps_.push_back(step);
+  }
+
+  if (compiled.steps_.size() == 3 && compiled.parameter_count() == 2 &&
+      (!compiled.steps_.back().is_pred || kType == PRED)) {
+    const HloInstruction* lhs = root->operand_count() == 2
+                                    ? root->operand(0)
+                                    : nullptr;
+    const HloInstruction* rhs = root->operand_count() == 2
+                                    ? root->operand(1)
+                                    : nullptr;
+    auto is_parameter = [](const HloInstruction* hlo, int64_t number) {
+      return hlo != nullptr && hlo->opcode() == HloOpcode::kParameter &&
+             hlo->parameter_number() == number;
+    };
+    // Integer ops are commutative bit for bit; max and min of floats are not
+    // for NaNs and signed zeros.
+    const bool commutative =
+        std::is_integral_v<T> && root->opcode() != HloOpcode::kSubtract &&
+        root->opcode() != HloOpcode::kDivide;
+    if (IsReduceOpcode(root->opcode()) &&
+        ((is_parameter(lhs, 0) && is_parameter(rhs, 1)) ||
+         (commutative && is_parameter(lhs, 1) && is_parameter(rhs, 0)))) {
+      compiled.binary_opcode_ = root->opcode();
+    }
+  }
+  return compiled;
+}
+
+template <typename T>
+bool CompiledScalarComputation<T>::IsReduceOpcode(HloOpcode opcode) {
+  switch (opcode) {
+    case HloOpcode::kAdd:
+    case HloOpcode::kSubtract:
+    case HloOpcode::kMultiply:
+    case HloOpcode::kDivide:
+    case HloOpcode::kMaximum:
+    case HloOpcode::kMinimum:
+      return true;
+    case HloOpcode::kAnd:
+    case HloOpcode::kOr:
+    case HloOpcode::kXor:
+      return std::is_integral_v<T>;
+    default:
+      return false;
+  }
+}
+
+template <typename T>
+template <HloOpcode kOpcode>
+T CompiledScalarComputation<T>::Binary(T lhs, T rhs) {
+  // The evaluator computes narrow integers as 64-bit ones.
+  using ElementwiseT = std::conditional_t<
+      std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) < 8,
+      std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>, T>;
+  ElementwiseT lhs_el = lhs;
+  ElementwiseT rhs_el = rhs;
+  if constexpr (kOpcode == HloOpcode::kAdd) {
+    return static_cast<T>(ElementwiseT(ToArithmeticSafeType(lhs_el) +
+                                       ToArithmeticSafeType(rhs_el)));
+  } else if constexpr (kOpcode == HloOpcode::kSubtract) {
+    return static_cast<T>(ElementwiseT(ToArithmeticSafeType(lhs_el) -
+                                       ToArithmeticSafeType(rhs_el)));
+  } else if constexpr (kOpcode == HloOpcode::kMultiply) {
+    return static_cast<T>(ElementwiseT(ToArithmeticSafeType(lhs_el) *
+                                       ToArithmeticSafeType(rhs_el)));
+  } else if constexpr (kOpcode == HloOpcode::kDivide) {
+    if constexpr (std::is_integral_v<ElementwiseT>) {
+      if constexpr (std::is_unsigned_v<ElementwiseT>) {
+        if (rhs_el == 0) {
+          return static_cast<T>(std::numeric_limits<ElementwiseT>::max());
+        }
+      }
+      if constexpr (std::is_signed_v<ElementwiseT>) {
+        if (rhs_el == 0) {
+          return static_cast<T>(-1);
+        }
+        if (rhs_el == -1 &&
+            lhs_el == std::numeric_limits<ElementwiseT>::min()) {
+          return static_cast<T>(lhs_el);
+        }
+      }
+    }
+    return static_cast<T>(lhs_el / rhs_el);
+  } else if constexpr (kOpcode == HloOpcode::kMaximum ||
+                       kOpcode == HloOpcode::kMinimum) {
+    if constexpr (std::numeric_limits<ElementwiseT>::has_quiet_NaN) {
+      if (std::isnan(lhs_el)) {
+        return lhs;
+      }
+      if (std::isnan(rhs_el)) {
+        return rhs;
+      }
+    }
+    return static_cast<T>(kOpcode == HloOpcode::kMaximum
+                              ? std::max(lhs_el, rhs_el)
+                              : std::min(lhs_el, rhs_el));
+  } else if constexpr (kOpcode == HloOpcode::kAnd) {
+    return static_cast<T>(lhs_el & rhs_el);
+  } else if constexpr (kOpcode == HloOpcode::kOr) {
+    return static_cast<T>(lhs_el | rhs_el);
+  } else {
+    static_assert(kOpcode == HloOpcode::kXor);
+    return static_cast<T>(lhs_el ^ rhs_el);
+  }
+}
+
+template <typename T>
+T CompiledScalarComputation<T>::operator()(absl::Span<const T> args) const {
+  if (binary_opcode_.has_value()) {
+    return Reduce(args[0], absl::MakeConstSpan(&args[1], 1));
+  }
+  absl::InlinedVector<T, 16> values(steps_.size());
+  for (int64_t i = 0; i < steps_.size(); ++i) {
+    const Step& step = steps_[i];
+    const T lhs = values[step.operands[0]];
+    const T rhs = values[step.operands[1]];
+    T& value = values[i];
+    switch (step.opcode) {
+      case HloOpcode::kParameter:
+        value = args[step.parameter_number];
+        break;
+      case HloOpcode::kConstant:
+        value = step.constant;
+        break;
+      case HloOpcode::kAdd:
+        value = Binary<HloOpcode::kAdd>(lhs, rhs);
+        break;
+      case HloOpcode::kSubtract:
+        value = Binary<HloOpcode::kSubtract>(lhs, rhs);
+        break;
+      case HloOpcode::kMultiply:
+        value = Binary<HloOpcode::kMultiply>(lhs, rhs);
+        break;
+      case HloOpcode::kDivide:
+        value = Binary<HloOpcode::kDivide>(lhs, rhs);
+        break;
+      case HloOpcode::kMaximum:
+        value = Binary<HloOpcode::kMaximum>(lhs, rhs);
+        break;
+      case HloOpcode::kMinimum:
+        value = Binary<HloOpcode::kMinimum>(lhs, rhs);
+        break;
+      case HloOpcode::kAnd:
+        if (step.is_pred) {
+          value = T(lhs != T(0) && rhs != T(0));
+        } else if constexpr (std::is_integral_v<T>) {
+          value = Binary<HloOpcode::kAnd>(lhs, rhs);
+        }
+        break;
+      case HloOpcode::kOr:
+        if (step.is_pred) {
+          value = T(lhs != T(0) || rhs != T(0));
+        } else if constexpr (std::is_integral_v<T>) {
+          value = Binary<HloOpcode::kOr>(lhs, rhs);
+        }
+        break;
+      case HloOpcode::kXor:
+        if (step.is_pred) {
+          value = T((lhs != T(0)) != (rhs != T(0)));
+        } else if constexpr (std::is_integral_v<T>) {
+          value = Binary<HloOpcode::kXor>(lhs, rhs);
+        }
+        break;
+      case HloOpcode::kNot:
+        value = T(lhs == T(0));
+        break;
+      case HloOpcode::kCompare:
+        switch (step.direction) {
+          case ComparisonDirection::kEq:
+            value = T(lhs == rhs);
+            break;
+          case ComparisonDirection::kNe:
+            value = T(lhs != rhs);
+            break;
+          case ComparisonDirection::kGe:
+            value = T(lhs >= rhs);
+            break;
+          case ComparisonDirection::kGt:
+            value = T(lhs > rhs);
+            break;
+          case ComparisonDirection::kLe:
+            value = T(lhs <= rhs);
+            break;
+          case ComparisonDirection::kLt:
+            value = T(lhs < rhs);
+            break;
+        }
+        break;
+      case HloOpcode::kSelect:
+        value = lhs != T(0) ? rhs : values[step.operands[2]];
+        break;
+      default:
+        LOG(FATAL) << "Unexpected opcode " << HloOpcodeString(step.opcode);
+    }
+  }
+  return values.back();
+}
+
+template <typename T>
+template <HloOpcode kOpcode>
+T CompiledScalarComputation<T>::ReduceWith(T acc,
+                                           absl::Span<const T> values) const {
+  for (T value : values) {
+    acc = Binary<kOpcode>(acc, value);
+  }
+  return acc;
+}
+
+template <typename T>
+T CompiledScalarComputation<T>::Reduce(T acc,
+                                       absl::Span<const T> values) const {
+  if (binary_opcode_.has_value()) {
+    switch (*binary_opcode_) {
+      case HloOpcode::kAdd:
+        return ReduceWith<HloOpcode::kAdd>(acc, values);
+      case HloOpcode::kSubtract:
+        return ReduceWith<HloOpcode::kSubtract>(acc, values);
+      case HloOpcode::kMultiply:
+        return ReduceWith<HloOpcode::kMultiply>(acc, values);
+      case HloOpcode::kDivide:
+        return ReduceWith<HloOpcode::kDivide>(acc, values);
+      case HloOpcode::kMaximum:
+        return ReduceWith<HloOpcode::kMaximum>(acc, values);
+      case HloOpcode::kMinimum:
+        return ReduceWith<HloOpcode::kMinimum>(acc, values);
+      default:
+        if constexpr (std::is_integral_v<T>) {
+          switch (*binary_opcode_) {
+            case HloOpcode::kAnd:
+              return ReduceWith<HloOpcode::kAnd>(acc, values);
+            case HloOpcode::kOr:
+              return ReduceWith<HloOpcode::kOr>(acc, values);
+            case HloOpcode::kXor:
+              return ReduceWith<HloOpcode::kXor>(acc, values);
+            default:
+              break;
+          }
+        }
+        break;
+    }
+  }
+  for (T value : values) {
+    T args[] = {acc, value};
+    acc = (*this)(args);
+  }
+  return acc;
+}
+
+}  // namespace xla
+
+#endif  // XLA_HLO_EVALUATOR_COMPILED_SCALAR_COMPUTATION_H_
@@ -38,6 +38,7 @@ limitations under the License.
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "xla/hlo/evaluator/compiled_scalar_computation.h"
 #include "xla/hlo/evaluator/hlo_evaluator_typed_visitor.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_instruction.h"
@@ -944,6 +945,14 @@ HloEvaluator::HloEvaluator(int64_t max_loop_iterations)
       });
 }
 
+std::unique_ptr<HloEvaluator> HloEvaluator::Clone() const {
+  std::unique_ptr<HloEvaluator> clone = CreateEmbedded(max_loop_iterations_);
+  clone->use_fast_path_ = use_fast_path_;
+  clone->custom_call_handler_ = custom_call_handler_;
+  clone->dynamic_dimension_inference_ = dynamic_dimension_inference_;
+  return clone;
+}
+
 StatusOr<Literal> HloEvaluator::Evaluate(
     const HloComputation& computation,
     absl::Span<const Literal* const> arg_literals) {
@@ -3168,6 +3177,30 @@ class UpdateWindowIndexToInputIndex {
 };
 }  // namespace
 
+// Returns the update computation of a scatter of one array compiled for its
+// element type T, as a function that combines the element of `result` at
+// `input_index` with the element of `updates` at `update_index`, or nullptr if
+// the computation doesn't compile.
+template <typename T>
+static std::function<void(MutableLiteralBase&, absl::Span<const int64_t>,
+                          const Literal&, absl::Span<const int64_t>)>
+CompileScatterUpdate(const HloComputation& to_apply,
+                     const Shape& updates_shape) {
+  constexpr PrimitiveType kType = primitive_util::NativeToPrimitiveType<T>();
+  std::optional<CompiledScalarComputation<T>> update =
+      CompiledScalarComputation<T>::Compile(to_apply, kType);
+  if (!update.has_value() || update->parameter_count() != 2 ||
+      updates_shape.element_type() != kType) {
+    return nullptr;
+  }
+  return [update = *std::move(update)](
+             MutableLiteralBase& result, absl::Span<const int64_t> input_index,
+             const Literal& updates, absl::Span<const int64_t> update_index) {
+    T args[] = {result.Get<T>(input_index), updates.Get<T>(update_index)};
+    result.Set<T>(input_index, update(args));
+  };
+}
+
 Status HloEvaluator::HandleScatter(HloInstruction* hlo) {
   auto* scatter = DynCast<HloScatterInstruction>(hlo);
   const ScatterDimensionNumbers& dim_numbers =
@@ -3220,6 +3253,16 @@ Status HloEvaluator::HandleScatter(HloInstruction* hlo) {
   };
 
   HloEvaluator embedded_evaluator;
+  std::function<void(MutableLiteralBase&, absl::Span<const int64_t>,
+                     const Literal&, absl::Span<const int64_t>)>
+      compiled_update;
+  if (operands.size() == 1) {
+    VisitCompiledScalarType(
+        operands[0]->shape().element_type(), [&](auto value) {
+          compiled_update = CompileScatterUpdate<decltype(value)>(
+              *scatter->to_apply(), updates[0]->shape());
+        });
+  }
   auto scatter_inner_loop_body =
       [&](absl::Span<const int64_t> update_window_index,
           absl::Span<const int64_t> input_scatter_index,
@@ -3250,6 +3293,10 @@ Status HloEvaluator::HandleScatter(HloInstruction* hlo) {
       input_index[i] = input_scatter_index[i] + input_window_index[i];
     }
 
+    if (compiled_update) {
+      compiled_update(result, input_index, *updates[0], update_index);
+      return true;
+    }
     absl::InlinedVector<Literal, 2> to_apply_args;
     to_apply_args.reserve(operands.size() + updates.size());
     for (int i = 0, n = operands.size(); i < n; ++i) {
@@ -4216,6 +4263,40 @@ Status HloEvaluator::HandleSlice(HloInstruction* slice) {
   return OkStatus();
 }
 
+// Returns the comparator of `sort` compiled for the element type T of the
+// operands it uses, as a function that compares elements a and b of the rank-1
+// `literals` of the operands, or nullptr if the comparator doesn't compile.
+template <typename T>
+static std::function<bool(absl::Span<const Literal>, int64_t, int64_t)>
+CompileSortComparator(const HloInstruction& sort) {
+  constexpr PrimitiveType kType = primitive_util::NativeToPrimitiveType<T>();
+  std::optional<CompiledScalarComputation<T>> comparator =
+      CompiledScalarComputation<T>::Compile(*sort.to_apply(), PRED);
+  if (!comparator.has_value() ||
+      comparator->parameter_count() != 2 * sort.operand_count()) {
+    return nullptr;
+  }
+  for (int64_t i = 0; i < comparator->parameter_count(); ++i) {
+    if (comparator->uses_parameter(i) &&
+        sort.operand(i / 2)->shape().element_type() != kType) {
+      return nullptr;
+    }
+  }
+  return [comparator = *std::move(comparator)](
+             absl::Span<const Literal> literals, int64_t a, int64_t b) {
+    absl::InlinedVector<T, 4> args(comparator.parameter_count());
+    for (int64_t i = 0; i < literals.size(); ++i) {
+      if (comparator.uses_parameter(2 * i)) {
+        args[2 * i] = literals[i].data<T>()[a];
+      }
+      if (comparator.uses_parameter(2 * i + 1)) {
+        args[2 * i + 1] = literals[i].data<T>()[b];
+      }
+    }
+    return comparator(args) != T(0);
+  };
+}
+
 Status HloEvaluator::HandleSort(HloInstruction* sort) {
   TF_RET_CHECK(sort->operand_count() >= 1)
       << "Expected at least 1 operand for sort";
@@ -4248,6 +4329,11 @@ Status HloEvaluator::HandleSort(HloInstruction* sort) {
   increment[sort_dim] = sort_dim_elements;
   std::unique_ptr<HloEvaluator> embedded_evaluator =
       CreateEmbedded(max_loop_iterations_);
+  std::function<bool(absl::Span<const Literal>, int64_t, int64_t)>
+      compiled_comparator;
+  VisitCompiledScalarType(key_shape.element_type(), [&](auto value) {
+    compiled_comparator = CompileSortComparator<decltype(value)>(*sort);
+  });
   // Iterate through each dimension except 'sort_dim'.
   TF_RETURN_IF_ERROR(ShapeUtil::ForEachIndexWithStatus(
       key_shape, zero_base, key_shape.dimensions(), increment,
@@ -4269,9 +4355,12 @@ Status HloEvaluator::HandleSort(HloInstruction* sort) {
         std::vector<int64_t> indices_to_sort(sort_dim_elements);
         std::iota(indices_to_sort.begin(), indices_to_sort.end(), 0);
         Status compare_status = OkStatus();
-        auto comparator = [sort, &compare_status,
+        auto comparator = [sort, &compare_status, &compiled_comparator,
                            embedded_evaluator = embedded_evaluator.get(),
                            &literals_to_sort](int64_t a, int64_t b) {
+          if (compiled_comparator) {
+            return compiled_comparator(literals_to_sort, a, b);
+          }
           std::vector<Literal> literals;
           literals.reserve(2 * sort->operand_count());
           for (int64_t i = 0; i < sort->operand_count(); ++i) {
@@ -4490,6 +4579,71 @@ static StatusOr<bool> GenerateReduceOutputElement(
   return true;
 }
 
+// Reduces `input` with `function` compiled for its element type T, or returns
+// nullopt if `function` doesn't compile. The reduced elements of an output
+// element are visited in the same order as in GenerateReduceOutputElement, and
+// are a contiguous span if the reduced dimensions are the most minor ones.
+template <typename T>
+static std::optional<Literal> ReduceCompiled(
+    const Literal& input, const Literal& init_value, HloComputation* function,
+    const Shape& output_shape, absl::Span<const int64_t> arg_dim_steps,
+    absl::Span<const int64_t> arg_dim_counts,
+    absl::Span<const int64_t> result_to_arg_index) {
+  constexpr PrimitiveType kType = primitive_util::NativeToPrimitiveType<T>();
+  std::optional<CompiledScalarComputation<T>> reducer =
+      CompiledScalarComputation<T>::Compile(*function, kType);
+  if (!reducer.has_value() || reducer->parameter_count() != 2 ||
+      output_shape.element_type() != kType) {
+    return std::nullopt;
+  }
+
+  const Shape& input_shape = input.shape();
+  absl::Span<const T> input_data = input.data<T>();
+  const T init = init_value.GetFirstElement<T>();
+  const int64_t num_reduced = input_shape.rank() - result_to_arg_index.size();
+  absl::Span<const int64_t> minor_to_major =
+      LayoutUtil::MinorToMajor(input_shape);
+  const bool contiguous =
+      absl::c_all_of(minor_to_major.subspan(0, num_reduced),
+                     [&](int64_t dim) { return arg_dim_steps[dim] != 0; });
+  int64_t reduced_elements = 1;
+  for (int64_t i = 0; i < input_shape.rank(); ++i) {
+    if (arg_dim_steps[i] != 0) {
+      reduced_elements *= input_shape.dimensions(i);
+    }
+  }
+
+  Literal result(output_shape);
+  TF_CHECK_OK(result.PopulateParallel<T>(
+      [&](absl::Span<const int64_t> output_index, int /*thread_id*/) {
+        DimensionVector base(input_shape.rank(), 0);
+        for (int64_t i = 0; i < output_index.size(); ++i) {
+          base[result_to_arg_index[i]] = output_index[i];
+        }
+        if (reduced_elements == 0) {
+          return init;
+        }
+        if (contiguous) {
+          return reducer->Reduce(
+              init, input_data.subspan(
+                        IndexUtil::MultidimensionalIndexToLinearIndex(
+                            input_shape, minor_to_major, base),
+                        reduced_elements));
+        }
+        T acc = init;
+        ShapeUtil::ForEachIndexNoStatus(
+            input_shape, base, arg_dim_counts, arg_dim_steps,
+            [&](absl::Span<const int64_t> input_index) {
+              T value = input_data[IndexUtil::MultidimensionalIndexToLinearIndex(
+                  input_shape, minor_to_major, input_index)];
+              acc = reducer->Reduce(acc, absl::MakeConstSpan(&value, 1));
+              return true;
+            });
+        return acc;
+      }));
+  return std::move(result);
+}
+
 Status HloEvaluator::HandleReduce(HloInstruction* instr) {
   HloReduceInstruction* reduce = Cast<HloReduceInstruction>(instr);
   int64_t num_args = reduce->inputs().size();
@@ -4553,26 +4707,50 @@ Status HloEvaluator::HandleReduce(HloInstruction* instr) {
     }
   }
 
-  const int num_threads = ShapeUtil::GetForEachIndexParallelThreadCount() + 1;
-  std::vector<std::unique_ptr<HloEvaluator>> embedded_evaluators;
-  embedded_evaluators.reserve(num_threads);
-  for (int i = 0; i < num_threads; ++i) {
-    embedded_evaluators.push_back(CreateEmbedded(max_loop_iterations_));
-  }
-
   absl::InlinedVector<Literal, 1> results(num_args);
-  for (int64_t i = 0; i < num_args; ++i) {
-    results[i] = Literal(is_tuple ? out_shape.tuple_shapes(i) : out_shape);
-  }
+  bool reduced = false;
+
+  // Reductions of one array with a reducer that compiles for its element type
+  // don't need an embedded evaluator. Floating point sums keep the fast path
+  // of GenerateReduceOutputElement, which accumulates in double.
+  if (!is_tuple &&
+      arg_shape.element_type() == init_values[0]->shape().element_type() &&
+      !(ShapeUtil::ElementIsFloating(arg_shape) && IsScalarAdd(function))) {
+    std::optional<Literal> result;
+    VisitCompiledScalarType(arg_shape.element_type(), [&](auto value) {
+      result = ReduceCompiled<decltype(value)>(
+          *input_args[0], *init_values[0], function, output_shape,
+          arg_dim_steps, arg_dim_counts, result_to_arg_index);
+    });
+    if (result.has_value()) {
+      results[0] = *std::move(result);
+      reduced = true;
+    }
+  }
+
+  if (!reduced) {
+    const int num_threads =
+        ShapeUtil::GetForEachIndexParallelThreadCount() + 1;
+    std::vector<std::unique_ptr<HloEvaluator>> embedded_evaluators;
+    embedded_evaluators.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      embedded_evaluators.push_back(CreateEmbedded(max_loop_iterations_));
+    }
 
-  TF_RETURN_IF_ERROR(ShapeUtil::ForEachIndexParallelWithStatus(
-      output_shape, [&](absl::Span<const int64_t> output_index, int thread_id) {
-        return GenerateReduceOutputElement(
-            is_tuple, output_index, init_values, input_args,
-            absl::Span<Literal>(results), function,
-            embedded_evaluators[thread_id + 1].get(), arg_dim_steps,
-            arg_dim_counts, result_to_arg_index);
-      }));
+    for (int64_t i = 0; i < num_args; ++i) {
+      results[i] = Literal(is_tuple ? out_shape.tuple_shapes(i) : out_shape);
+    }
+
+    TF_RETURN_IF_ERROR(ShapeUtil::ForEachIndexParallelWithStatus(
+        output_shape,
+        [&](absl::Span<const int64_t> output_index, int thread_id) {
+          return GenerateReduceOutputElement(
+              is_tuple, output_index, init_values, input_args,
+              absl::Span<Literal>(results), function,
+              embedded_evaluators[thread_id + 1].get(), arg_dim_steps,
+              arg_dim_counts, result_to_arg_index);
+        }));
+  }
 
   if (is_tuple) {
     Literal tuple_result(inferred_return_shape);
@@ -4591,6 +4769,36 @@ Status HloEvaluator::HandleReduce(HloInstruction* instr) {
   return OkStatus();
 }
 
+// Evaluates a reduce window of one array with `function` compiled for its
+// element type T, or returns nullopt if `function` doesn't compile.
+template <typename T>
+static std::optional<Literal> ReduceWindowCompiled(
+    const Literal& input, const Literal& init_value, const Shape& window_shape,
+    const Window& window, HloComputation* function, const Shape& result_shape) {
+  constexpr PrimitiveType kType = primitive_util::NativeToPrimitiveType<T>();
+  std::optional<CompiledScalarComputation<T>> reducer =
+      CompiledScalarComputation<T>::Compile(*function, kType);
+  if (!reducer.has_value() || reducer->parameter_count() != 2 ||
+      input.shape().element_type() != kType ||
+      init_value.shape().element_type() != kType) {
+    return std::nullopt;
+  }
+  const T init = init_value.GetFirstElement<T>();
+  Literal result(result_shape);
+  TF_CHECK_OK(result.PopulateParallel<T>(
+      [&](absl::Span<const int64_t> output_index, int /*thread_id*/) {
+        T acc = init;
+        IterateThroughWindow(
+            window_shape, window, input.shape(), output_index,
+            [&](absl::Span<const int64_t> operand_index) {
+              T value = input.Get<T>(operand_index);
+              acc = reducer->Reduce(acc, absl::MakeConstSpan(&value, 1));
+            });
+        return acc;
+      }));
+  return std::move(result);
+}
+
 Status HloEvaluator::HandleReduceWindow(HloInstruction* hlo) {
   auto* reduce_window = Cast<HloReduceWindowInstruction>(hlo);
   const Window& window = reduce_window->window();
@@ -4628,6 +4836,20 @@ Status HloEvaluator::HandleReduceWindow(HloInstruction* hlo) {
   const Shape window_shape = ShapeUtil::MakeShape(
       input_arrays[0]->shape().element_type(), window_dimension_sizes);
 
+  if (!inferred_return_shape.IsTuple()) {
+    std::optional<Literal> result;
+    VisitCompiledScalarType(
+        inferred_return_shape.element_type(), [&](auto value) {
+          result = ReduceWindowCompiled<decltype(value)>(
+              *input_literal_vec[0], *init_literal_vec[0], window_shape,
+              window, function, inferred_return_shape);
+        });
+    if (result.has_value()) {
+      evaluated_[reduce_window] = *std::move(result);
+      return OkStatus();
+    }
+  }
+
   const int num_threads = ShapeUtil::GetForEachIndexParallelThreadCount() + 1;
   std::vector<std::unique_ptr<HloEvaluator>> embedded_evaluators;
   embedded_evaluators.reserve(num_threads);
@@ -4732,10 +4954,57 @@ Status HloEvaluator::HandleReduceWindow(HloInstruction* hlo) {
   return OkStatus();
 }
 
+// Evaluates a map with `computation` compiled for the element type T of its
+// result, or returns nullopt if `computation` doesn't compile.
+template <typename T>
+static std::optional<Literal> MapCompiled(
+    absl::Span<const Literal* const> operands, HloComputation* computation,
+    const Shape& shape) {
+  constexpr PrimitiveType kType = primitive_util::NativeToPrimitiveType<T>();
+  std::optional<CompiledScalarComputation<T>> function =
+      CompiledScalarComputation<T>::Compile(*computation, kType);
+  if (!function.has_value() ||
+      function->parameter_count() != operands.size()) {
+    return std::nullopt;
+  }
+  for (int64_t i = 0; i < operands.size(); ++i) {
+    if (function->uses_parameter(i) &&
+        operands[i]->shape().element_type() != kType) {
+      return std::nullopt;
+    }
+  }
+  Literal result(shape);
+  TF_CHECK_OK(result.PopulateParallel<T>(
+      [&](absl::Span<const int64_t> multi_index, int /*thread_id*/) {
+        absl::InlinedVector<T, 4> args(operands.size());
+        for (int64_t i = 0; i < operands.size(); ++i) {
+          if (function->uses_parameter(i)) {
+            args[i] = operands[i]->Get<T>(multi_index);
+          }
+        }
+        return (*function)(args);
+      }));
+  return std::move(result);
+}
+
 Status HloEvaluator::HandleMap(HloInstruction* map) {
   auto operands = map->operands();
   HloComputation* computation = map->to_apply();
 
+  std::optional<Literal> compiled_result;
+  VisitCompiledScalarType(map->shape().element_type(), [&](auto value) {
+    absl::InlinedVector<const Literal*, 2> operand_literals;
+    for (const HloInstruction* operand : operands) {
+      operand_literals.push_back(&GetEvaluatedLiteralFor(operand));
+    }
+    compiled_result = MapCompiled<decltype(value)>(operand_literals,
+                                                   computation, map->shape());
+  });
+  if (compiled_result.has_value()) {
+    evaluated_[map] = *std::move(compiled_result);
+    return OkStatus();
+  }
+
   Literal result(map->shape());
 
   HloEvaluator embedded_evaluator(max_loop_iterations_);
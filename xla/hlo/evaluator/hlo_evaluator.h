@@ -88,10 +88,17 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   // sub-region of control flow. Subclasses should override this to return an
   // instance of the subclass instead.
   virtual std::unique_ptr<HloEvaluator> CreateEmbedded(
-      int64_t max_loop_iterations) {
+      int64_t max_loop_iterations) const {
     return std::make_unique<HloEvaluator>(max_loop_iterations);
   }
 
+  // Returns a new evaluator, created with CreateEmbedded, that has the same
+  // loop limit, fast-path setting, custom-call handler and dynamic dimension
+  // inference as this one but none of its evaluation state. Used to run the
+  // same computations concurrently, since an evaluator is not thread-safe.
+  // Concurrent calls to Clone on the same evaluator are safe.
+  std::unique_ptr<HloEvaluator> Clone() const;
+
   // Enables subclasses to be notified when a new computation is being
   // evaluated.
   virtual void OnEvaluateComputation(const HloComputation& computation) {}
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "xla/hlo/evaluator/hlo_evaluator.h"
 
+#include <cmath>
 #include <initializer_list>
 #include <memory>
 #include <optional>
@@ -4824,6 +4825,185 @@ TEST_F(HloEvaluatorTest, SortC64) {
   EXPECT_TRUE(LiteralTestUtil::Equal(expected, result));
 }
 
+TEST_F(HloEvaluatorTest, ReduceS8WrapsAroundAlongEitherDimension) {
+  const absl::string_view hlo_text = R"(
+  HloModule m
+
+  add_s8 {
+    a = s8[] parameter(0)
+    b = s8[] parameter(1)
+    ROOT add = s8[] add(a, b)
+  }
+
+  ENTRY main {
+    c = s8[2,3]{1,0} constant({{100, 100, 100}, {1, 2, 3}})
+    init = s8[] constant(0)
+    minor = s8[2] reduce(c, init), dimensions={1}, to_apply=add_s8
+    major = s8[3] reduce(c, init), dimensions={0}, to_apply=add_s8
+    ROOT tuple = (s8[2], s8[3]) tuple(minor, major)
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  Literal expected = LiteralUtil::MakeTupleFromSlices(
+      {LiteralUtil::CreateR1<int8_t>({44, 6}),
+       LiteralUtil::CreateR1<int8_t>({101, 102, 103})});
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal result, HloEvaluator().Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, result));
+}
+
+TEST_F(HloEvaluatorTest, ReduceF32WithNaNs) {
+  const absl::string_view hlo_text = R"(
+  HloModule m
+
+  max_f32 {
+    a = f32[] parameter(0)
+    b = f32[] parameter(1)
+    ROOT max = f32[] maximum(a, b)
+  }
+
+  add_up_to_ten {
+    a = f32[] parameter(0)
+    b = f32[] parameter(1)
+    sum = f32[] add(a, b)
+    ten = f32[] constant(10)
+    lt = pred[] compare(sum, ten), direction=LT
+    ROOT select = f32[] select(lt, sum, ten)
+  }
+
+  ENTRY main {
+    c = f32[2,3]{0,1} constant({{1, nan, 3}, {4, 5, 6}})
+    init = f32[] constant(0)
+    max = f32[2] reduce(c, init), dimensions={1}, to_apply=max_f32
+    sum = f32[3] reduce(c, init), dimensions={0}, to_apply=add_up_to_ten
+    ROOT tuple = (f32[2], f32[3]) tuple(max, sum)
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal result, HloEvaluator().Evaluate(*m_->entry_computation(), {}));
+  std::vector<Literal> results = result.DecomposeTuple();
+  EXPECT_TRUE(std::isnan(results[0].Get<float>({0})));
+  EXPECT_EQ(results[0].Get<float>({1}), 6.f);
+  // The NaN compares false with ten, so the second sum is clamped.
+  EXPECT_TRUE(LiteralTestUtil::Equal(
+      LiteralUtil::CreateR1<float>({5.f, 10.f, 9.f}), results[1]));
+}
+
+TEST_F(HloEvaluatorTest, SortKeysAndValues) {
+  const absl::string_view hlo_text = R"(
+  HloModule m
+
+  less {
+    k0 = f32[] parameter(0)
+    k1 = f32[] parameter(1)
+    v0 = s32[] parameter(2)
+    v1 = s32[] parameter(3)
+    ROOT lt = pred[] compare(k0, k1), direction=LT
+  }
+
+  ENTRY main {
+    keys = f32[4] constant({3, 1, 4, 2})
+    values = s32[4] constant({0, 1, 2, 3})
+    ROOT sort = (f32[4], s32[4]) sort(keys, values), dimensions={0},
+      to_apply=less, is_stable=true
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  Literal expected = LiteralUtil::MakeTupleFromSlices(
+      {LiteralUtil::CreateR1<float>({1, 2, 3, 4}),
+       LiteralUtil::CreateR1<int32_t>({1, 3, 0, 2})});
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal result, HloEvaluator().Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, result));
+}
+
+TEST_F(HloEvaluatorTest, SortPredKeys) {
+  const absl::string_view hlo_text = R"(
+  HloModule m
+
+  less {
+    a = pred[] parameter(0)
+    b = pred[] parameter(1)
+    ROOT lt = pred[] compare(a, b), direction=LT
+  }
+
+  ENTRY main {
+    keys = pred[5] constant({1, 0, 1, 0, 0})
+    ROOT sort = pred[5] sort(keys), dimensions={0}, to_apply=less
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  Literal expected =
+      LiteralUtil::CreateR1<bool>({false, false, false, true, true});
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal result, HloEvaluator().Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, result));
+}
+
+TEST_F(HloEvaluatorTest, ReduceAndMapPredWithCompare) {
+  const absl::string_view hlo_text = R"(
+  HloModule m
+
+  ne {
+    a = pred[] parameter(0)
+    b = pred[] parameter(1)
+    ROOT ne = pred[] compare(a, b), direction=NE
+  }
+
+  ENTRY main {
+    c = pred[2,3] constant({{1, 0, 1}, {1, 1, 1}})
+    d = pred[2,3] constant({{1, 1, 0}, {0, 1, 1}})
+    init = pred[] constant(false)
+    reduce = pred[2] reduce(c, init), dimensions={1}, to_apply=ne
+    map = pred[2,3] map(c, d), dimensions={0,1}, to_apply=ne
+    ROOT tuple = (pred[2], pred[2,3]) tuple(reduce, map)
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  Literal expected = LiteralUtil::MakeTupleFromSlices(
+      {LiteralUtil::CreateR1<bool>({false, true}),
+       LiteralUtil::CreateR2<bool>(
+           {{false, true, true}, {true, false, false}})});
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal result, HloEvaluator().Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, result));
+}
+
+TEST_F(HloEvaluatorTest, MapThenReduceWindowS32) {
+  const absl::string_view hlo_text = R"(
+  HloModule m
+
+  affine {
+    x = s32[] parameter(0)
+    y = s32[] parameter(1)
+    two = s32[] constant(2)
+    mul = s32[] multiply(x, two)
+    ROOT add = s32[] add(mul, y)
+  }
+
+  min_s32 {
+    a = s32[] parameter(0)
+    b = s32[] parameter(1)
+    ROOT min = s32[] minimum(a, b)
+  }
+
+  ENTRY main {
+    a = s32[4] constant({1, 5, 2, 8})
+    b = s32[4] constant({10, 0, 3, -20})
+    map = s32[4] map(a, b), to_apply=affine
+    init = s32[] constant(2147483647)
+    ROOT window = s32[3] reduce-window(map, init), window={size=2},
+      to_apply=min_s32
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  Literal expected = LiteralUtil::CreateR1<int32_t>({10, 7, -4});
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal result, HloEvaluator().Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, result));
+}
+
 // Tests that HloEvaluator can evaluate an instruction even when its operands
 // are not constant.
 TEST_F(HloEvaluatorTest, RecursivelyEvaluateNonConstantOperands) {
@@ -0,0 +1,436 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/hlo/ir/hlo_chain_reachability.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/memory/memory.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace {
+
+template <typename Container>
+void SortAndDeduplicate(Container* container) {
+  absl::c_sort(*container);
+  container->erase(std::unique(container->begin(), container->end()),
+                   container->end());
+}
+
+}  // namespace
+
+std::unique_ptr<HloChainReachabilityMap> HloChainReachabilityMap::Build(
+    const HloComputation* computation, int64_t max_label_size) {
+  HloComputation::ChannelDependencies channel_dependencies =
+      computation->ComputeChannelDependencies();
+  std::vector<HloInstruction*> instructions =
+      computation->MakeInstructionPostOrder(channel_dependencies);
+  auto result =
+      absl::WrapUnique(new HloChainReachabilityMap(max_label_size));
+  result->nodes_.resize(instructions.size());
+  result->indices_.reserve(instructions.size());
+  for (Index i = 0; i < instructions.size(); ++i) {
+    result->indices_[GetKey(instructions[i])] = i;
+  }
+
+  std::vector<Index> num_successors(instructions.size(), 0);
+  for (Index i = 0; i < instructions.size(); ++i) {
+    Node& node = result->nodes_[i];
+    result->AppendPredecessors(instructions[i], &node.predecessors);
+    // If an instruction has channel dependencies, they are also reachable.
+    auto it = channel_dependencies.find(instructions[i]);
+    if (it != channel_dependencies.end()) {
+      for (const HloInstruction* dependency : it->second) {
+        result->AppendPredecessors(dependency, &node.predecessors);
+      }
+    }
+    SortAndDeduplicate(&node.predecessors);
+    for (Index predecessor_index : node.predecessors) {
+      ++num_successors[predecessor_index];
+    }
+  }
+  for (Index i = 0; i < instructions.size(); ++i) {
+    for (Index predecessor_index : result->nodes_[i].predecessors) {
+      if (num_successors[predecessor_index] <= kMaxSourceSuccessors &&
+          result->nodes_[predecessor_index].predecessors.empty()) {
+        result->nodes_[predecessor_index].source_successors.push_back(i);
+      }
+    }
+  }
+
+  // The last instruction added to each chain so far.
+  std::vector<Index> chain_tails;
+  for (Index i = 0; i < instructions.size(); ++i) {
+    Node& node = result->nodes_[i];
+    node.chain_predecessor = -1;
+    if (node.predecessors.empty() &&
+        num_successors[i] <= kMaxSourceSuccessors) {
+      node.chain = kNoChain;
+      node.position = 0;
+      node.complete = true;
+      continue;
+    }
+
+    // Extend the chain of the latest predecessor that is still the tail of its
+    // chain, which tends to follow the longest path through the graph.
+    for (auto it = node.predecessors.rbegin(); it != node.predecessors.rend();
+         ++it) {
+      const Index chain = result->nodes_[*it].chain;
+      if (chain != kNoChain && chain_tails[chain] == *it) {
+        node.chain_predecessor = *it;
+        break;
+      }
+    }
+    if (node.chain_predecessor >= 0) {
+      const Node& chain_predecessor = result->nodes_[node.chain_predecessor];
+      node.chain = chain_predecessor.chain;
+      node.position = chain_predecessor.position + 1;
+      chain_tails[node.chain] = i;
+    } else {
+      node.chain = chain_tails.size();
+      node.position = 0;
+      chain_tails.push_back(i);
+      result->chain_positions_.push_back(-1);
+    }
+    result->ComputeLabel(i);
+  }
+  result->ComputeIntervals();
+  return result;
+}
+
+void HloChainReachabilityMap::ComputeIntervals() {
+  const Index num_nodes = nodes_.size();
+  // The successors of node i are successors[offsets[i]:offsets[i + 1]].
+  std::vector<Index> offsets(num_nodes + 1, 0);
+  for (const Node& node : nodes_) {
+    for (Index predecessor_index : node.predecessors) {
+      ++offsets[predecessor_index + 1];
+    }
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<Index> successors(offsets.back());
+  std::vector<Index> next_successor(offsets.begin(), offsets.end() - 1);
+  for (Index i = 0; i < num_nodes; ++i) {
+    for (Index predecessor_index : nodes_[i].predecessors) {
+      successors[next_successor[predecessor_index]++] = i;
+    }
+  }
+
+  // Each traversal visits the successors in a different order, so that their
+  // intervals reject different queries.
+  std::vector<std::pair<Index, Index>> stack;  // Node, successors visited.
+  std::vector<bool> visited;
+  for (int t = 0; t < kNumTraversals; ++t) {
+    visited.assign(num_nodes, false);
+    Index rank = 0;
+    for (Index start = 0; start < num_nodes; ++start) {
+      const Index root = t % 2 == 0 ? start : num_nodes - 1 - start;
+      if (visited[root]) {
+        continue;
+      }
+      visited[root] = true;
+      nodes_[root].intervals[t].low = num_nodes;
+      stack.push_back({root, 0});
+      while (!stack.empty()) {
+        auto& [index, num_visited] = stack.back();
+        const Index begin = offsets[index];
+        const Index end = offsets[index + 1];
+        if (begin + num_visited < end) {
+          const Index successor =
+              successors[t % 2 == 0 ? begin + num_visited
+                                    : end - 1 - num_visited];
+          ++num_visited;
+          Interval& interval = nodes_[index].intervals[t];
+          if (visited[successor]) {
+            interval.low =
+                std::min(interval.low, nodes_[successor].intervals[t].low);
+          } else {
+            visited[successor] = true;
+            nodes_[successor].intervals[t].low = num_nodes;
+            stack.push_back({successor, 0});
+          }
+          continue;
+        }
+        Interval& interval = nodes_[index].intervals[t];
+        interval.rank = rank++;
+        interval.low = std::min(interval.low, interval.rank);
+        stack.pop_back();
+        if (!stack.empty()) {
+          Interval& parent = nodes_[stack.back().first].intervals[t];
+          parent.low = std::min(parent.low, interval.low);
+        }
+      }
+    }
+  }
+  intervals_valid_ = true;
+}
+
+bool HloChainReachabilityMap::MayReach(const Node& from,
+                                       const Node& node) const {
+  if (!intervals_valid_) {
+    return true;
+  }
+  for (int t = 0; t < kNumTraversals; ++t) {
+    if (node.intervals[t].low < from.intervals[t].low ||
+        node.intervals[t].rank > from.intervals[t].rank) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void HloChainReachabilityMap::AppendPredecessors(
+    const HloInstruction* instruction, IndexVector* predecessors) const {
+  for (const HloInstruction* operand : instruction->operands()) {
+    predecessors->push_back(GetIndex(operand));
+  }
+  for (const HloInstruction* predecessor :
+       instruction->control_predecessors()) {
+    predecessors->push_back(GetIndex(predecessor));
+  }
+}
+
+void HloChainReachabilityMap::ComputeLabel(Index index) {
+  Node& node = nodes_[index];
+  label_chains_.clear();
+  auto add_entry = [&](Index chain, Index position) {
+    Index& chain_position = chain_positions_[chain];
+    if (chain_position < 0) {
+      label_chains_.push_back(chain);
+    }
+    chain_position = std::max(chain_position, position);
+  };
+  add_entry(node.chain, node.position);
+  node.complete = true;
+  for (Index predecessor_index : node.predecessors) {
+    const Node& predecessor = nodes_[predecessor_index];
+    node.complete &= predecessor.complete;
+    for (const LabelEntry& entry : predecessor.label) {
+      add_entry(entry.chain, entry.position);
+    }
+  }
+  absl::c_sort(label_chains_);
+
+  node.label.clear();
+  if (label_chains_.size() <= max_label_size_) {
+    node.label.reserve(label_chains_.size());
+    for (Index chain : label_chains_) {
+      node.label.push_back({chain, chain_positions_[chain]});
+    }
+  } else {
+    // Keep the entries for the node's own chain and those of its predecessors,
+    // which answer queries about nearby instructions, and fill the rest with
+    // the most recently started chains.
+    node.complete = false;
+    absl::InlinedVector<Index, 8> kept_chains = {node.chain};
+    for (Index predecessor_index : node.predecessors) {
+      if (nodes_[predecessor_index].chain != kNoChain) {
+        kept_chains.push_back(nodes_[predecessor_index].chain);
+      }
+    }
+    SortAndDeduplicate(&kept_chains);
+    int64_t remaining =
+        std::max<int64_t>(max_label_size_ - kept_chains.size(), 0);
+    for (auto it = label_chains_.rbegin(); it != label_chains_.rend(); ++it) {
+      if (absl::c_binary_search(kept_chains, *it)) {
+        node.label.push_back({*it, chain_positions_[*it]});
+      } else if (remaining > 0) {
+        node.label.push_back({*it, chain_positions_[*it]});
+        --remaining;
+      }
+    }
+    absl::c_reverse(node.label);
+    node.label.shrink_to_fit();
+  }
+  for (Index chain : label_chains_) {
+    chain_positions_[chain] = -1;
+  }
+}
+
+HloChainReachabilityMap::LabelAnswer HloChainReachabilityMap::LookUpLabel(
+    const Node& node, const Node& from) {
+  auto it = absl::c_lower_bound(
+      node.label, from.chain,
+      [](const LabelEntry& entry, Index chain) { return entry.chain < chain; });
+  if (it != node.label.end() && it->chain == from.chain &&
+      it->position >= from.position) {
+    return LabelAnswer::kReachable;
+  }
+  return node.complete ? LabelAnswer::kUnreachable : LabelAnswer::kUnknown;
+}
+
+bool HloChainReachabilityMap::IsReachable(Index a, Index b) const {
+  if (a == b) {
+    return true;
+  }
+  // The numbering is a topological order.
+  if (a > b) {
+    return false;
+  }
+  const Node& from = nodes_[a];
+  if (!MayReach(from, nodes_[b])) {
+    return false;
+  }
+  if (from.chain == kNoChain) {
+    return absl::c_any_of(from.source_successors, [&](Index successor) {
+      return IsReachable(successor, b);
+    });
+  }
+  LabelAnswer answer = LookUpLabel(nodes_[b], from);
+  if (answer != LabelAnswer::kUnknown) {
+    return answer == LabelAnswer::kReachable;
+  }
+
+  // Search backwards from 'b'. Instructions numbered before 'a' cannot be
+  // reached from it.
+  std::vector<Index> stack = {b};
+  absl::flat_hash_set<Index> visited = {b};
+  while (!stack.empty()) {
+    const Node& node = nodes_[stack.back()];
+    stack.pop_back();
+    for (Index predecessor_index : node.predecessors) {
+      if (predecessor_index < a ||
+          !MayReach(from, nodes_[predecessor_index]) ||
+          !visited.insert(predecessor_index).second) {
+        continue;
+      }
+      if (predecessor_index == a) {
+        return true;
+      }
+      switch (LookUpLabel(nodes_[predecessor_index], from)) {
+        case LabelAnswer::kReachable:
+          return true;
+        case LabelAnswer::kUnreachable:
+          break;
+        case LabelAnswer::kUnknown:
+          stack.push_back(predecessor_index);
+          break;
+      }
+    }
+  }
+  return false;
+}
+
+void HloChainReachabilityMap::Replace(const HloInstruction* original,
+                                      const HloInstruction* replacement) {
+  if (GetKey(original) != GetKey(replacement)) {
+    indices_[GetKey(replacement)] = GetIndex(original);
+    indices_.erase(GetKey(original));
+  }
+}
+
+void HloChainReachabilityMap::UpdateReachabilityThroughInstruction(
+    const HloInstruction* instruction) {
+  std::queue<const HloInstruction*> worklist;
+  worklist.push(instruction);
+
+  IndexVector predecessors;
+  while (!worklist.empty()) {
+    const HloInstruction* item = worklist.front();
+    worklist.pop();
+
+    const Index index = GetIndex(item);
+    Node& node = nodes_[index];
+    predecessors.clear();
+    AppendPredecessors(item, &predecessors);
+    SortAndDeduplicate(&predecessors);
+    if (node.predecessors != predecessors) {
+      // The labels are only meaningful if the numbering is a topological order
+      // and if every chain is a path of the graph.
+      if ((!predecessors.empty() && predecessors.back() >= index) ||
+          (node.chain_predecessor >= 0 &&
+           !absl::c_binary_search(predecessors, node.chain_predecessor)) ||
+          node.chain == kNoChain) {
+        VLOG(3) << "Rebuilding the reachability map after the predecessors of "
+                << item->name() << " changed";
+        *this = std::move(*Build(item->parent(), max_label_size_));
+        return;
+      }
+      // Removing edges keeps the intervals conservative, adding them does not.
+      if (!absl::c_includes(node.predecessors, predecessors)) {
+        intervals_valid_ = false;
+      }
+      // Keep the successors of sources without a chain up to date.
+      for (Index predecessor_index : node.predecessors) {
+        IndexVector& successors = nodes_[predecessor_index].source_successors;
+        if (nodes_[predecessor_index].chain == kNoChain &&
+            !absl::c_binary_search(predecessors, predecessor_index)) {
+          successors.erase(absl::c_find(successors, index));
+        }
+      }
+      for (Index predecessor_index : predecessors) {
+        if (nodes_[predecessor_index].chain == kNoChain &&
+            !absl::c_binary_search(node.predecessors, predecessor_index)) {
+          nodes_[predecessor_index].source_successors.push_back(index);
+        }
+      }
+      node.predecessors = predecessors;
+    }
+    if (node.chain == kNoChain) {
+      continue;
+    }
+
+    std::vector<LabelEntry> old_label = std::move(node.label);
+    const bool old_complete = node.complete;
+    ComputeLabel(index);
+    const bool changed =
+        node.complete != old_complete ||
+        !absl::c_equal(node.label, old_label,
+                       [](const LabelEntry& x, const LabelEntry& y) {
+                         return x.chain == y.chain &&
+                                x.position == y.position;
+                       });
+    if (changed) {
+      // Add immediate successors to worklist.
+      for (const HloInstruction* user : item->users()) {
+        worklist.push(user);
+      }
+      for (const HloInstruction* succ : item->control_successors()) {
+        worklist.push(succ);
+      }
+    }
+  }
+}
+
+int64_t HloChainReachabilityMap::SizeInBytes() const {
+  int64_t size = sizeof(*this) + nodes_.capacity() * sizeof(Node) +
+                 indices_.capacity() * (sizeof(Key) + sizeof(Index) + 1) +
+                 chain_positions_.capacity() * sizeof(Index) +
+                 label_chains_.capacity() * sizeof(Index);
+  for (const Node& node : nodes_) {
+    size += node.label.capacity() * sizeof(LabelEntry);
+    if (node.predecessors.capacity() > kInlinedIndices) {
+      size += node.predecessors.capacity() * sizeof(Index);
+    }
+    if (node.source_successors.capacity() > kInlinedIndices) {
+      size += node.source_successors.capacity() * sizeof(Index);
+    }
+  }
+  return size;
+}
+
+}  // namespace xla
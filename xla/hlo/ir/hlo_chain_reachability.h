@@ -0,0 +1,191 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_HLO_IR_HLO_CHAIN_REACHABILITY_H_
+#define XLA_HLO_IR_HLO_CHAIN_REACHABILITY_H_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+
+namespace xla {
+
+// Answers the same reachability queries as HloReachabilityMap::Build, using
+// memory that grows linearly rather than quadratically with the number of
+// instructions.
+//
+// The instructions are numbered in post order and partitioned into chains,
+// paths of the graph that are grown greedily in that order. Each instruction
+// is labelled with, for every chain that reaches it, the last position in the
+// chain that does. Then 'a' reaches 'b' iff the label of 'b' has an entry for
+// the chain of 'a' at or after the position of 'a'.
+//
+// To bound memory, labels are truncated to `max_label_size` entries. The
+// labels of such instructions and of the instructions they reach are partial,
+// and queries about them fall back to a depth-first search over predecessors
+// that only visits instructions numbered between the two instructions and
+// stops at complete labels.
+//
+// Sources, instructions without predecessors such as parameters and
+// constants, that have at most kMaxSourceSuccessors successors do not start
+// chains of their own. Queries about them are answered through their
+// successors instead, which keeps the labels of large graphs small.
+//
+// Most queries that labels cannot answer are about unreachable instructions.
+// These are usually rejected by interval labels: for a few depth-first
+// traversals of the graph, each instruction records its post order rank and
+// the lowest rank among the instructions it reaches. 'a' can then only reach
+// 'b' if the interval of 'b' is contained in that of 'a' for every traversal.
+//
+// Like HloReachabilityMap, the map describes the computation as it was when the
+// map was built, except for the changes passed to
+// UpdateReachabilityThroughInstruction and Replace.
+class HloChainReachabilityMap {
+ public:
+  static constexpr int64_t kDefaultMaxLabelSize = 64;
+
+  // Computes the reachability between the instructions of `computation`. Both
+  // data dependencies (operands) and control dependencies are considered, as
+  // well as channel dependencies. Trivially an instruction is reachable from
+  // itself.
+  static std::unique_ptr<HloChainReachabilityMap> Build(
+      const HloComputation* computation,
+      int64_t max_label_size = kDefaultMaxLabelSize);
+
+  // Returns true if "b" is reachable from "a".
+  bool IsReachable(const HloInstruction* a, const HloInstruction* b) const {
+    return IsReachable(GetIndex(a), GetIndex(b));
+  }
+
+  // Returns true if "b" is reachable from "a" or "a" is reachable from "b".
+  bool IsConnected(const HloInstruction* a, const HloInstruction* b) const {
+    const Index a_index = GetIndex(a);
+    const Index b_index = GetIndex(b);
+    return IsReachable(a_index, b_index) || IsReachable(b_index, a_index);
+  }
+
+  // Checks if an instruction is in the map.
+  bool IsPresent(const HloInstruction* instruction) const {
+    return indices_.contains(GetKey(instruction));
+  }
+
+  // Replaces the instruction "original" with "replacement" in the map.
+  void Replace(const HloInstruction* original,
+               const HloInstruction* replacement);
+
+  // Updates the map after the immediate predecessor set (operands and control
+  // predecessors) of 'instruction' has changed. If the change invalidates the
+  // numbering or the chains, e.g. because a new operand comes later in the
+  // post order, the map is rebuilt from the computation of 'instruction'.
+  void UpdateReachabilityThroughInstruction(const HloInstruction* instruction);
+
+  // Returns the approximate number of bytes used by the map.
+  int64_t SizeInBytes() const;
+
+ private:
+  using Index = int32_t;
+  static constexpr Index kNoChain = -1;
+  static constexpr int kMaxSourceSuccessors = 4;
+  static constexpr int kInlinedIndices = 2;
+  using IndexVector = absl::InlinedVector<Index, kInlinedIndices>;
+
+  // The last position in `chain` that reaches an instruction.
+  struct LabelEntry {
+    Index chain;
+    Index position;
+  };
+
+  // The post order rank of an instruction in one depth-first traversal, and the
+  // lowest rank among the instructions that it reaches.
+  struct Interval {
+    Index low;
+    Index rank;
+  };
+  static constexpr int kNumTraversals = 2;
+
+  struct Node {
+    // kNoChain for sources that are answered through their successors.
+    Index chain;
+    Index position;
+    // The previous instruction in the chain, or -1 for the head of the chain.
+    Index chain_predecessor;
+    // False if `label` lacks the entries of some chains that reach the node.
+    bool complete;
+    IndexVector predecessors;
+    // Sorted by chain. Includes the node itself.
+    std::vector<LabelEntry> label;
+    Interval intervals[kNumTraversals];
+    // The successors of a source without a chain.
+    IndexVector source_successors;
+  };
+
+  enum class LabelAnswer { kReachable, kUnreachable, kUnknown };
+
+  explicit HloChainReachabilityMap(int64_t max_label_size)
+      : max_label_size_(max_label_size) {}
+
+  using Key = std::pair<int, int>;  // module ID, instruction ID.
+  static Key GetKey(const HloInstruction* instruction) {
+    return {instruction->GetModule()->unique_id(), instruction->unique_id()};
+  }
+  Index GetIndex(const HloInstruction* instruction) const {
+    return indices_.at(GetKey(instruction));
+  }
+
+  bool IsReachable(Index a, Index b) const;
+
+  // Returns false if the intervals prove that `from` does not reach `node`.
+  bool MayReach(const Node& from, const Node& node) const;
+
+  // Answers whether `from` reaches `node` using the label of `node` alone.
+  static LabelAnswer LookUpLabel(const Node& node, const Node& from);
+
+  // Appends the indices of the operands and control predecessors of
+  // `instruction` to `predecessors`.
+  void AppendPredecessors(const HloInstruction* instruction,
+                          IndexVector* predecessors) const;
+
+  // Computes the label of `index` from the labels of its predecessors.
+  void ComputeLabel(Index index);
+
+  // Computes the intervals of all nodes from their predecessors.
+  void ComputeIntervals();
+
+  int64_t max_label_size_;
+
+  absl::flat_hash_map<Key, Index> indices_;
+
+  // Indexed by the post order number of the instruction.
+  std::vector<Node> nodes_;
+
+  // Whether the intervals may be used. Edges added after Build invalidate them.
+  bool intervals_valid_ = false;
+
+  // Scratch space for ComputeLabel: the last position of each chain that
+  // reaches the node being labelled, or -1, and the chains that do.
+  std::vector<Index> chain_positions_;
+  std::vector<Index> label_chains_;
+};
+
+}  // namespace xla
+
+#endif  // XLA_HLO_IR_HLO_CHAIN_REACHABILITY_H_
@@ -146,8 +146,9 @@ HloInstruction* HloComputation::AddInstructionInternal(
   }
   instruction->set_parent(this);
   HloInstruction* pinst = instruction.get();
-  instruction_iterators_[pinst] =
-      instructions_.insert(instructions_.end(), std::move(instruction));
+  pinst->index_in_parent_ = instructions_.size();
+  instructions_.push_back(std::move(instruction));
+  ++instruction_count_;
   return pinst;
 }
 
@@ -158,8 +159,7 @@ HloInstruction* HloComputation::AddParameter(
         fusion_instruction_->operand_count() == param_instructions_.size());
   instruction->set_parent(this);
   param_instructions_.push_back(instruction.get());
-  AddInstructionInternal(std::move(instruction));
-  return instructions_.back().get();
+  return AddInstructionInternal(std::move(instruction));
 }
 
 HloInstruction* HloComputation::AddEntryComputationParameter(
@@ -175,9 +175,7 @@ HloInstruction* HloComputation::AddEntryComputationParameter(
 
   instruction->set_parent(this);
   param_instructions_.push_back(instruction.get());
-  AddInstructionInternal(std::move(instruction));
-
-  return instructions_.back().get();
+  return AddInstructionInternal(std::move(instruction));
 }
 
 Status HloComputation::ReplaceEntryComputationParameter(
@@ -371,20 +369,40 @@ Status HloComputation::RemoveInstructionImpl(HloInstruction* instruction,
       << "instruction " << instruction->name()
       << " has control successors and cannot be removed";
 
-  auto inst_it = instruction_iterators_.find(instruction);
-  TF_RET_CHECK(inst_it != instruction_iterators_.end());
-  (*inst_it->second)->set_parent(nullptr);
-  to_be_deleted_.emplace_back(inst_it->second->release());
+  TF_RET_CHECK(ContainsInstruction(instruction));
+  std::unique_ptr<HloInstruction>& slot =
+      instructions_[instruction->index_in_parent_];
+  slot->set_parent(nullptr);
+  slot->index_in_parent_ = -1;
+  to_be_deleted_.push_back(std::move(slot));
   to_be_deleted_.back()->DetachFromOperandsAndUsers();
   // Clear all operands to avoid Null operands.
   to_be_deleted_.back()->RemoveAllOperands();
   to_be_deleted_.back()->ClearCalledComputations();
   to_be_deleted_.back()->MarkAsDead();
-  instructions_.erase(inst_it->second);
-  instruction_iterators_.erase(inst_it);
+  --instruction_count_;
   return OkStatus();
 }
 
+void HloComputation::Cleanup() {
+  to_be_deleted_.clear();
+  if (instruction_count_ == static_cast<int64_t>(instructions_.size())) {
+    return;
+  }
+  int64_t next = 0;
+  for (int64_t i = 0; i < instructions_.size(); ++i) {
+    if (instructions_[i] == nullptr) {
+      continue;
+    }
+    if (i != next) {
+      instructions_[i]->index_in_parent_ = next;
+      instructions_[next] = std::move(instructions_[i]);
+    }
+    ++next;
+  }
+  instructions_.resize(next);
+}
+
 void HloComputation::set_root_instruction(HloInstruction* new_root_instruction,
                                           bool accept_different_shape) {
   // The shape of the root (ignoring layout) is an invariant of the computation
@@ -395,14 +413,7 @@ void HloComputation::set_root_instruction(HloInstruction* new_root_instruction,
         << new_root_instruction->shape() << " is incompatible with "
         << root_instruction_->shape();
   }
-  bool root_found = false;
-  for (auto& instruction : instructions_) {
-    if (new_root_instruction == instruction.get()) {
-      root_found = true;
-      break;
-    }
-  }
-  DCHECK(root_found);
+  DCHECK(ContainsInstruction(new_root_instruction));
 
   if (parent() && parent()->has_entry_computation() &&
       parent()->entry_computation() == this) {
@@ -503,23 +514,23 @@ HloComputation::ChannelDependencies HloComputation::ComputeChannelDependencies()
 
   // Create dependencies RecvDone -> Send, and between partitioned collectives.
   ChannelDependencies dependencies;
-  for (const auto& instruction : instructions_) {
+  for (HloInstruction* instruction : instructions()) {
     switch (instruction->opcode()) {
       case HloOpcode::kSend: {
         Instructions& group = channel_groups[*instruction->channel_id()];
         if (group.empty()) {
-          group.push_back(instruction.get());
+          group.push_back(instruction);
         } else {
-          dependencies[group[0]] = {instruction.get()};
+          dependencies[group[0]] = {instruction};
         }
         break;
       }
       case HloOpcode::kRecvDone: {
         Instructions& group = channel_groups[*instruction->channel_id()];
         if (group.empty()) {
-          group.push_back(instruction.get());
+          group.push_back(instruction);
         } else {
-          dependencies[instruction.get()] = {group[0]};
+          dependencies[instruction] = {group[0]};
         }
         break;
       }
@@ -532,10 +543,10 @@ HloComputation::ChannelDependencies HloComputation::ComputeChannelDependencies()
         if (channel_id) {
           Instructions& group = channel_groups[*channel_id];
           for (const HloInstruction* group_inst : group) {
-            dependencies[group_inst].push_back(instruction.get());
+            dependencies[group_inst].push_back(instruction);
           }
-          dependencies[instruction.get()] = group;
-          group.push_back(instruction.get());
+          dependencies[instruction] = group;
+          group.push_back(instruction);
         }
         break;
       }
@@ -556,13 +567,13 @@ std::vector<HloInstruction*> HloComputation::MakeInstructionPostOrder(
   post_order.reserve(instruction_count());
   absl::flat_hash_map<HloInstruction*, VisitState> visited;
   visited.reserve(instruction_count());
-  for (auto& instruction : instructions_) {
+  for (HloInstruction* instruction : instructions()) {
     if (instruction->users().empty()) {
-      ComputeInstructionPostOrder(instruction.get(), channel_dependencies,
-                                  visited, post_order);
+      ComputeInstructionPostOrder(instruction, channel_dependencies, visited,
+                                  post_order);
     }
   }
-  CHECK_EQ(instructions_.size(), post_order.size())
+  CHECK_EQ(instruction_count(), post_order.size())
       << "number of instructions does not match post order size";
   return post_order;
 }
@@ -572,10 +583,10 @@ void HloComputation::ForEachInstructionPostOrder(
   absl::flat_hash_map<HloInstruction*, VisitState> visited;
   visited.reserve(instruction_count());
   auto channel_dependencies = ComputeChannelDependencies();
-  for (auto& instruction : instructions_) {
+  for (HloInstruction* instruction : instructions()) {
     if (instruction->users().empty()) {
-      ForEachInstructionPostOrderImpl(func, instruction.get(),
-                                      channel_dependencies, visited);
+      ForEachInstructionPostOrderImpl(func, instruction, channel_dependencies,
+                                      visited);
     }
   }
 }
@@ -859,9 +870,9 @@ StatusOr<HloInstruction*> HloComputation::CreateAsyncInstructions(
   HloInstruction* async_done = AddInstruction(HloInstruction::CreateAsyncDone(
       root->shape(), async_start, async_computation,
       /*async_group_id=*/std::nullopt, async_execution_thread));
-  async_start->set_metadata(instruction->metadata());
+  async_start->CopyMetadataFrom(*instruction);
   async_start->CopyBackendConfigFrom(instruction);
-  async_done->set_metadata(instruction->metadata());
+  async_done->CopyMetadataFrom(*instruction);
   async_done->CopyBackendConfigFrom(instruction);
   if (replace) {
     TF_RETURN_IF_ERROR(ReplaceInstruction(instruction, async_done));
@@ -1092,11 +1103,10 @@ StatusOr<bool> HloComputation::ReplaceInstructionWithDifferentShape(
       new_instruction->metadata().logical_creation_pass_id() == 0 &&
       old_instruction->metadata().logical_creation_pass_id() != 0;
   if (overwrite_op_name || overwrite_pass_id) {
-    new_instruction->set_metadata(old_instruction->metadata());
+    new_instruction->CopyMetadataFrom(*old_instruction);
   }
   if (new_instruction->frontend_attributes().map().empty()) {
-    new_instruction->set_frontend_attributes(
-        old_instruction->frontend_attributes());
+    new_instruction->CopyFrontendAttributesFrom(*old_instruction);
   }
 
   // Like the metadata above, if the user didn't specify any sharding
@@ -1223,8 +1233,10 @@ void SortClonedInstructions(
     const HloComputation::InstructionList& ordered_instructions,
     std::vector<std::unique_ptr<HloInstruction>>& unordered_instructions) {
   using InstructionSorter = MappedPtrContainerSorter<HloInstruction>;
+  // Removed instructions leave null entries in ordered_instructions, which map
+  // to nothing.
   auto instruction_mapper = [&context, replace](const HloInstruction* i) {
-    return context.FindInstruction(replace(i));
+    return i == nullptr ? nullptr : context.FindInstruction(replace(i));
   };
   size_t num_mapped_instructions = 0;
   size_t mapped_index_of_last_parameter_plus_one = 0;
@@ -1274,6 +1286,9 @@ void SortClonedInstructionUsersAndControlLists(
   };
   for (const std::unique_ptr<HloInstruction>& instruction :
        sorted_instructions) {
+    if (instruction == nullptr) {
+      continue;
+    }
     HloInstruction* cloned_instruction =
         context.FindInstruction(replace(instruction.get()));
     if (!cloned_instruction) {
@@ -1324,9 +1339,9 @@ std::unique_ptr<HloComputation> HloComputation::CloneWithReplacements(
   // ourselves.
   std::vector<const HloInstruction*> postorder;
   absl::flat_hash_map<const HloInstruction*, VisitState> visited;
-  for (const auto& instr : instructions_) {
+  for (const HloInstruction* instr : instructions()) {
     std::vector<const HloInstruction*> dfs_stack;
-    const HloInstruction* new_instr = replace(instr.get());
+    const HloInstruction* new_instr = replace(instr);
     if (!new_instr) {
       continue;
     }
@@ -67,7 +67,7 @@ class HloModule;
 class HloComputation {
  public:
   // Used by instructions_.
-  using InstructionList = std::list<std::unique_ptr<HloInstruction>>;
+  using InstructionList = HloInstructionList;
 
   // Builder class for HloComputation.
   class Builder {
@@ -311,11 +311,8 @@ class HloComputation {
     return H::combine(std::move(h), instructions.size());
   }
 
-  using InstructionSequence = tsl::gtl::iterator_range<
-      UnwrappingIterator<std::list<std::unique_ptr<HloInstruction>>::iterator>>;
-
-  using ConstInstructionSequence = tsl::gtl::iterator_range<UnwrappingIterator<
-      std::list<std::unique_ptr<HloInstruction>>::const_iterator>>;
+  using InstructionSequence = HloInstructionRange;
+  using ConstInstructionSequence = HloInstructionRange;
 
   // Gets the instructions in this computation.
   //
@@ -324,13 +321,11 @@ class HloComputation {
   //
   //   for (HloInstruction* instr : computation->instructions()) { ... }
   //
+  // Instructions added while iterating are visited as well, and removing
+  // instructions does not invalidate the iterators; see HloInstructionIterator.
   ConstInstructionSequence instructions() const {
-    return {MakeUnwrappingIterator(instructions_.begin()),
-            MakeUnwrappingIterator(instructions_.end())};
-  }
-  InstructionSequence instructions() {
-    return {MakeUnwrappingIterator(instructions_.begin()),
-            MakeUnwrappingIterator(instructions_.end())};
+    return {HloInstructionIterator(&instructions_, 0),
+            HloInstructionIterator::End(&instructions_)};
   }
 
   using ChannelDependencies =
@@ -347,7 +342,7 @@ class HloComputation {
   void ForEachInstructionPostOrder(
       absl::FunctionRef<void(HloInstruction*)> func) const;
 
-  int64_t instruction_count() const { return instruction_iterators_.size(); }
+  int64_t instruction_count() const { return instruction_count_; }
 
   // Creates and returns a list of the embedded computations called by this
   // computation. This includes all embedded computations called directly or
@@ -701,8 +696,9 @@ class HloComputation {
   // Deallocate instructions that are marked by "RemoveInstruction". The two
   // stage clean up process is designed such that HloPass can have stable
   // internal pointers to HloInstructions while we create and remove
-  // HloInstructions in a pass.
-  void Cleanup() { to_be_deleted_.clear(); }
+  // HloInstructions in a pass. This also compacts the instruction list, which
+  // invalidates the iterators returned by instructions().
+  void Cleanup();
 
   // Returns true if a given instruction is marked dead in this computation.
   bool IsMarkedAsDead(const HloInstruction* inst);
@@ -758,6 +754,13 @@ class HloComputation {
   Status RemoveInstructionImpl(HloInstruction* instruction,
                                bool ignore_safety_check);
 
+  // Returns true if `instruction` is a live instruction of this computation.
+  bool ContainsInstruction(const HloInstruction* instruction) const {
+    const int64_t index = instruction->index_in_parent_;
+    return index >= 0 && index < static_cast<int64_t>(instructions_.size()) &&
+           instructions_[index].get() == instruction;
+  }
+
   std::string name_;
   int64_t unique_id_;
   HloInstruction* root_instruction_;
@@ -793,12 +796,14 @@ class HloComputation {
   // Module containing this computation.
   HloModule* parent_ = nullptr;
 
-  // Store instructions in std::list as they can be added and removed
-  // arbitrarily and we want a stable iteration order. Keep a map from
-  // instruction pointer to location in the list for fast lookup.
+  // Instructions in the order they were added. Instructions can be added and
+  // removed arbitrarily while passes iterate over them, so removal only nulls
+  // the slot of the instruction, whose index each instruction keeps in
+  // index_in_parent_, and Cleanup compacts the list.
   InstructionList instructions_;
-  absl::flat_hash_map<const HloInstruction*, InstructionList::iterator>
-      instruction_iterators_;
+
+  // Number of non-null entries in instructions_.
+  int64_t instruction_count_ = 0;
 
   // Removed instructions are moved into to_be_deleted_ first and then
   // deallocated when Cleanup is called.
@@ -841,7 +846,7 @@ Status HloComputation::AcceptOrdered(
   absl::flat_hash_set<const HloInstruction*> visited;
   for (const HloInstruction* instruction : order) {
     VLOG(3) << "Visiting ordered: " << instruction->ToString();
-    TF_RET_CHECK(instruction_iterators_.contains(instruction))
+    TF_RET_CHECK(ContainsInstruction(instruction))
         << "Instruction " << instruction->name() << " is not in computation "
         << name();
     TF_RET_CHECK(!visited.contains(instruction))
@@ -1015,7 +1015,9 @@ StatusOr<std::unique_ptr<HloInstruction>> HloInstruction::CreateFromProto(
 
   TF_RET_CHECK(!proto.name().empty());
   instruction->SetAndSanitizeName(proto.name());
-  instruction->metadata_ = proto.metadata();
+  if (proto.has_metadata()) {
+    instruction->metadata_ = std::make_shared<OpMetadata>(proto.metadata());
+  }
   instruction->backend_config_ = proto.backend_config();
 
   TF_RET_CHECK(proto.id() >= 0)
@@ -1738,11 +1740,11 @@ HloInstruction::CreateBroadcastSequence(
   if (ShapeUtil::IsScalar(operand->shape())) {
     auto broadcast =
         HloInstruction::CreateBroadcast(broadcast_shape, operand, {});
-    broadcast->set_metadata(operand->metadata());
+    broadcast->CopyMetadataFrom(*operand);
     if (operand->has_sharding()) {
       broadcast->copy_sharding(operand);
     }
-    broadcast->set_frontend_attributes(operand->frontend_attributes());
+    broadcast->CopyFrontendAttributesFrom(*operand);
     return broadcast;
   }
   // Do explicit broadcast for degenerate broadcast.
@@ -1764,19 +1766,19 @@ HloInstruction::CreateBroadcastSequence(
       ShapeUtil::MakeShape(operand->shape().element_type(),
                            reshaped_dimensions),
       operand));
-  reshaped_operand->set_metadata(operand->metadata());
+  reshaped_operand->CopyMetadataFrom(*operand);
   if (operand->has_sharding()) {
     reshaped_operand->copy_sharding(operand);
   }
-  reshaped_operand->set_frontend_attributes(operand->frontend_attributes());
+  reshaped_operand->CopyFrontendAttributesFrom(*operand);
   // Broadcast 'reshape' up to the larger size.
   auto broadcast = HloInstruction::CreateBroadcast(
       broadcast_shape, reshaped_operand, broadcast_dimensions);
-  broadcast->set_metadata(operand->metadata());
+  broadcast->CopyMetadataFrom(*operand);
   if (operand->has_sharding()) {
     broadcast->copy_sharding(operand);
   }
-  broadcast->set_frontend_attributes(operand->frontend_attributes());
+  broadcast->CopyFrontendAttributesFrom(*operand);
   return broadcast;
 }
 
@@ -1858,8 +1860,8 @@ void HloInstruction::SetupDerivedInstruction(
   } else {
     derived_instruction->clear_sharding();
   }
-  derived_instruction->set_metadata(metadata_);
-  derived_instruction->set_frontend_attributes(frontend_attributes_);
+  derived_instruction->CopyMetadataFrom(*this);
+  derived_instruction->CopyFrontendAttributesFrom(*this);
 }
 
 bool HloInstruction::IsRoot() const {
@@ -2252,7 +2254,7 @@ void HloInstruction::DetachFromOperandsAndUsers() {
     if (operand == nullptr) {
       continue;
     }
-    if (operand->user_map_.find(this) != operand->user_map_.end()) {
+    if (operand->users_.Contains(this)) {
       operand->RemoveUser(this);
     }
     operands_[operand_num] = nullptr;
@@ -2526,17 +2528,10 @@ void HloInstruction::RemoveOperandsAtAscendingIndices(
   operands_.resize(operands_.size() - removed_count);
 }
 
-void HloInstruction::AddUser(HloInstruction* user) {
-  if (!ContainsKey(user_map_, user)) {
-    user_map_.emplace(user, users_.size());
-    users_.push_back(user);
-  }
-}
+void HloInstruction::AddUser(HloInstruction* user) { users_.AddUser(user); }
 
 int64_t HloInstruction::UserId(HloInstruction* user) {
-  auto result = user_map_.find(user);
-  CHECK(result != user_map_.end());
-  return result->second;
+  return users_.UserId(user);
 }
 
 bool HloInstruction::HasConstantOperand() const {
@@ -2700,20 +2695,146 @@ bool HloInstruction::IdenticalSlowPath(
 }
 
 void HloInstruction::RemoveUser(HloInstruction* user) {
-  auto map_it = user_map_.find(user);
-  CHECK(map_it != user_map_.end());
+  users_.RemoveUser(user);
+}
 
-  const int64_t index = map_it->second;
-  CHECK_EQ(users_[index], user);
+void HloInstruction::Users::Clear() {
+  users_.clear();
+  user_map_.reset();
+}
 
-  // Move the last user into the position of the removed user.
-  users_[index] = users_.back();
-  user_map_[users_.back()] = index;
+int64_t HloInstruction::Users::Find(const HloInstruction* user) const {
+  if (user_map_ != nullptr) {
+    auto it = user_map_->find(user);
+    return it == user_map_->end() ? -1 : it->second;
+  }
+  auto it = absl::c_find(users_, user);
+  return it == users_.end() ? -1 : it - users_.begin();
+}
 
-  // Remove the user from the map and drop the last slot from the vector what
-  // have been moved to the position of the original user.
-  user_map_.erase(map_it);
+bool HloInstruction::Users::Contains(const HloInstruction* instruction) const {
+  return Find(instruction) >= 0;
+}
+
+void HloInstruction::Users::AddUser(HloInstruction* user) {
+  if (user_map_ != nullptr) {
+    if (user_map_->emplace(user, users_.size()).second) {
+      users_.push_back(user);
+    }
+    return;
+  }
+  if (absl::c_linear_search(users_, user)) {
+    return;
+  }
+  users_.push_back(user);
+  if (users_.size() > kMapThreshold) {
+    RebuildMap();
+  }
+}
+
+void HloInstruction::Users::RemoveUser(HloInstruction* user) {
+  const int64_t index = Find(user);
+  CHECK_GE(index, 0);
+
+  // Move the last user into the position of the removed user and drop the
+  // last slot.
+  users_[index] = users_.back();
   users_.pop_back();
+  if (user_map_ == nullptr) {
+    return;
+  }
+  if (index < static_cast<int64_t>(users_.size())) {
+    (*user_map_)[users_[index]] = index;
+  }
+  user_map_->erase(user);
+  // Only drop the map well below the threshold, so that adding and removing a
+  // user around the threshold does not rebuild it every time.
+  if (users_.size() <= kMapThreshold / 2) {
+    user_map_.reset();
+  }
+}
+
+int64_t HloInstruction::Users::UserId(const HloInstruction* user) const {
+  const int64_t index = Find(user);
+  CHECK_GE(index, 0);
+  return index;
+}
+
+void HloInstruction::Users::SortInstructionUsers(
+    const MappedPtrContainerSorter<HloInstruction>::MapPtrFn& map_fn,
+    const Users& sorted_instruction_users) {
+  using Sorter = MappedPtrContainerSorter<HloInstruction>;
+  auto status = Sorter::Sort(map_fn, Sorter::IndexAfterMappedElementsFn(),
+                             sorted_instruction_users.users_, users_);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to sort instruction users: " << status;
+  }
+  if (user_map_ != nullptr) {
+    RebuildMap();
+  }
+}
+
+void HloInstruction::Users::RebuildMap() {
+  if (user_map_ == nullptr) {
+    user_map_ =
+        std::make_unique<absl::flat_hash_map<const HloInstruction*, int64_t>>();
+  }
+  user_map_->clear();
+  user_map_->reserve(users_.size());
+  for (int64_t i = 0; i < users_.size(); ++i) {
+    (*user_map_)[users_[i]] = i;
+  }
+}
+
+void HloInstruction::set_metadata(const OpMetadata& metadata) {
+  if (&metadata == metadata_.get()) {
+    return;
+  }
+  auto new_metadata = std::make_shared<OpMetadata>(metadata);
+  new_metadata->set_creation_pass_id(this->metadata().creation_pass_id());
+  metadata_ = std::move(new_metadata);
+}
+
+void HloInstruction::CopyMetadataFrom(const HloInstruction& other) {
+  // The creation pass id is never copied, so the storage can only be shared if
+  // both instructions were created by the same pass.
+  if (metadata().creation_pass_id() == other.metadata().creation_pass_id()) {
+    metadata_ = other.metadata_;
+  } else {
+    set_metadata(other.metadata());
+  }
+}
+
+void HloInstruction::UpdateMetadata(
+    absl::FunctionRef<void(OpMetadata&)> update) {
+  auto new_metadata = std::make_shared<OpMetadata>(metadata());
+  update(*new_metadata);
+  metadata_ = std::move(new_metadata);
+}
+
+void HloInstruction::set_frontend_attributes(
+    FrontendAttributes frontend_attributes) {
+  if (frontend_attributes.map().empty()) {
+    frontend_attributes_.reset();
+    return;
+  }
+  frontend_attributes_ =
+      std::make_shared<FrontendAttributes>(std::move(frontend_attributes));
+}
+
+void HloInstruction::add_frontend_attributes(
+    FrontendAttributes frontend_attributes) {
+  if (frontend_attributes.map().empty()) {
+    return;
+  }
+  if (frontend_attributes_ == nullptr) {
+    set_frontend_attributes(std::move(frontend_attributes));
+    return;
+  }
+  auto merged = std::make_shared<FrontendAttributes>(*frontend_attributes_);
+  merged->mutable_map()->insert(frontend_attributes.map().begin(),
+                                frontend_attributes.map().end());
+  frontend_attributes_ = std::move(merged);
 }
 
 Status HloInstruction::ReplaceUseWith(HloInstruction* user,
@@ -2851,8 +2972,7 @@ Status HloInstruction::ReplaceAllUsesWithDifferentShape(
       }
     }
   }
-  users_.clear();
-  user_map_.clear();
+  users_.Clear();
   if (new_producer_is_user) {
     AddUser(new_producer);
   }
@@ -3203,10 +3323,10 @@ void HloInstruction::PrintWithCanonicalNameMap(
   PrintExtraAttributes(attr_printer, options);
 
   if (options.print_metadata() &&
-      (!metadata_.op_type().empty() || !metadata_.op_name().empty() ||
-       !metadata_.source_file().empty())) {
+      (!metadata().op_type().empty() || !metadata().op_name().empty() ||
+       !metadata().source_file().empty())) {
     printer->Append(", metadata={");
-    printer->Append(xla::OpMetadataToString(metadata_));
+    printer->Append(xla::OpMetadataToString(metadata()));
     printer->Append("}");
   }
   if (options.print_backend_config() && !backend_config_.empty()) {
@@ -3463,10 +3583,10 @@ void HloInstruction::PrintExtraAttributes(
       sharding().Print(printer, options.print_metadata());
     });
   }
-  if (!frontend_attributes_.map().empty()) {
+  if (frontend_attributes_ != nullptr) {
     printer.Next([this](Printer* printer) {
       AppendCat(printer, "frontend_attributes=",
-                FrontendAttributesToString(frontend_attributes_));
+                FrontendAttributesToString(*frontend_attributes_));
     });
   }
 
@@ -3533,7 +3653,7 @@ HloInstructionProto HloInstruction::ToProto() const {
     proto.add_control_predecessor_ids(control->unique_id());
   }
 
-  *proto.mutable_metadata() = metadata_;
+  *proto.mutable_metadata() = metadata();
   proto.set_backend_config(backend_config_.GetRawString());
   if (opcode() != HloOpcode::kFusion) {
     for (const HloComputation* computation : called_computations_) {
@@ -3545,7 +3665,7 @@ HloInstructionProto HloInstruction::ToProto() const {
     *proto.mutable_sharding() = sharding().ToProto();
   }
 
-  *proto.mutable_frontend_attributes() = frontend_attributes_;
+  *proto.mutable_frontend_attributes() = frontend_attributes();
 
   return proto;
 }
@@ -4587,17 +4707,8 @@ void HloInstruction::SortInstructionUsersAndControlLists(
     const MappedPtrContainerSorter<HloInstruction>::MapPtrFn& map_fn,
     const HloInstruction& sorted_instruction) {
   using Sorter = MappedPtrContainerSorter<HloInstruction>;
+  users_.SortInstructionUsers(map_fn, sorted_instruction.users_);
   auto status = Sorter::Sort(map_fn, Sorter::IndexAfterMappedElementsFn(),
-                             sorted_instruction.users_, users_);
-  if (!status.ok()) {
-    LOG(ERROR) << "Failed to sort instruction users for " << name() << "; "
-               << status;
-  }
-  user_map_.clear();
-  for (uint64_t i = 0; i < users_.size(); ++i) {
-    user_map_[users_[i]] = i;
-  }
-  status = Sorter::Sort(map_fn, Sorter::IndexAfterMappedElementsFn(),
                         sorted_instruction.control_predecessors_,
                         control_predecessors_);
   if (!status.ok()) {
@@ -4745,15 +4856,7 @@ HloInstruction* HloInstruction::fused_expression_root() const {
   return Cast<HloFusionInstruction>(this)->fused_expression_root();
 }
 
-const tsl::gtl::iterator_range<UnwrappingIterator<
-    std::list<std::unique_ptr<HloInstruction>>::const_iterator>>
-HloInstruction::fused_instructions() const {
-  return Cast<HloFusionInstruction>(this)->fused_instructions();
-}
-
-const tsl::gtl::iterator_range<
-    UnwrappingIterator<std::list<std::unique_ptr<HloInstruction>>::iterator>>
-HloInstruction::fused_instructions() {
+HloInstructionRange HloInstruction::fused_instructions() const {
   return Cast<HloFusionInstruction>(this)->fused_instructions();
 }
 
@@ -23,6 +23,8 @@ limitations under the License.
 
 #include <functional>
 #include <iosfwd>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <memory>
 #include <optional>
@@ -36,6 +38,7 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/functional/function_ref.h"
 #include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -427,6 +430,77 @@ class CanonicalNameMap {
   absl::flat_hash_map<int, std::string> canonical_name_map_;
 };
 
+class HloInstruction;
+
+// The instructions of an HloComputation in the order they were added. Removing
+// an instruction leaves a null slot, which HloComputation::Cleanup compacts
+// away.
+using HloInstructionList = std::vector<std::unique_ptr<HloInstruction>>;
+
+// Iterates over the instructions of an HloInstructionList, skipping the slots
+// of removed ones. The iterator holds an index into the list rather than a
+// position in it, so adding or removing instructions while iterating is safe,
+// and instructions added in the meantime are visited too. Only
+// HloComputation::Cleanup invalidates it.
+class HloInstructionIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = HloInstruction*;
+  using difference_type = std::ptrdiff_t;
+  using pointer = HloInstruction* const*;
+  using reference = HloInstruction*;
+
+  // Returns an iterator that compares equal to every iterator that has run off
+  // the end of `list`, however much the list has grown.
+  static HloInstructionIterator End(const HloInstructionList* list) {
+    return HloInstructionIterator(list, std::numeric_limits<int64_t>::max());
+  }
+
+  HloInstructionIterator(const HloInstructionList* list, int64_t index)
+      : list_(list), index_(index) {
+    SkipRemoved();
+  }
+
+  HloInstruction* operator*() const { return (*list_)[index_].get(); }
+
+  HloInstructionIterator& operator++() {
+    ++index_;
+    SkipRemoved();
+    return *this;
+  }
+  HloInstructionIterator operator++(int) {
+    HloInstructionIterator temp = *this;
+    ++*this;
+    return temp;
+  }
+
+  friend bool operator==(const HloInstructionIterator& a,
+                         const HloInstructionIterator& b) {
+    if (a.AtEnd() || b.AtEnd()) {
+      return a.AtEnd() == b.AtEnd();
+    }
+    return a.index_ == b.index_;
+  }
+  friend bool operator!=(const HloInstructionIterator& a,
+                         const HloInstructionIterator& b) {
+    return !(a == b);
+  }
+
+ private:
+  bool AtEnd() const { return index_ >= static_cast<int64_t>(list_->size()); }
+
+  void SkipRemoved() {
+    while (!AtEnd() && (*list_)[index_] == nullptr) {
+      ++index_;
+    }
+  }
+
+  const HloInstructionList* list_;
+  int64_t index_;
+};
+
+using HloInstructionRange = tsl::gtl::iterator_range<HloInstructionIterator>;
+
 // HLO instructions are the atomic unit of the high-level compiler's IR.
 //
 // HloInstructions live inside of an HloComputation, which is analogous to a
@@ -1244,7 +1318,7 @@ class HloInstruction {
   int64_t user_count() const { return users_.size(); }
 
   // Returns the users of this instruction.
-  const std::vector<HloInstruction*>& users() const { return users_; }
+  const std::vector<HloInstruction*>& users() const { return users_.vec(); }
 
   // Returns the index of the user in the users() vector.
   //
@@ -1253,7 +1327,7 @@ class HloInstruction {
 
   // Returns true if this instruction is a user of 'instruction'.
   bool IsUserOf(const HloInstruction* instruction) const {
-    return instruction->user_map_.contains(this);
+    return instruction->users_.Contains(this);
   }
 
   // Adds a control dependency from this instruction to the given
@@ -1807,17 +1881,19 @@ class HloInstruction {
     backend_config_ = other->backend_config_.Clone();
   }
 
-  void set_frontend_attributes(FrontendAttributes frontend_attributes) {
-    frontend_attributes_ = std::move(frontend_attributes);
-  }
+  void set_frontend_attributes(FrontendAttributes frontend_attributes);
 
-  void add_frontend_attributes(FrontendAttributes frontend_attributes) {
-    frontend_attributes_.mutable_map()->insert(
-        frontend_attributes.map().begin(), frontend_attributes.map().end());
-  }
+  void add_frontend_attributes(FrontendAttributes frontend_attributes);
 
   const FrontendAttributes& frontend_attributes() const {
-    return frontend_attributes_;
+    return frontend_attributes_ != nullptr
+               ? *frontend_attributes_
+               : FrontendAttributes::default_instance();
+  }
+
+  // Copies the frontend attributes of `other`, sharing their storage.
+  void CopyFrontendAttributesFrom(const HloInstruction& other) {
+    frontend_attributes_ = other.frontend_attributes_;
   }
 
   // Getter/setter for raw JSON-encoded backend config.  Prefer the
@@ -1857,33 +1933,44 @@ class HloInstruction {
 
   // Sets the debug metadata for this instruction, excluding creation_pass_id,
   // which should never be copied anywhere.
-  void set_metadata(const OpMetadata& metadata) {
-    int64_t creation_pass_id = metadata_.creation_pass_id();
-    metadata_ = metadata;
-    metadata_.set_creation_pass_id(creation_pass_id);
-  }
+  void set_metadata(const OpMetadata& metadata);
+
+  // Same as set_metadata(other.metadata()), but shares the storage of the
+  // metadata with `other` where possible.
+  void CopyMetadataFrom(const HloInstruction& other);
 
   void set_size_of_generated_code_in_bytes(int64_t code_size_in_bytes) {
-    metadata_.set_size_of_generated_code_in_bytes(code_size_in_bytes);
+    UpdateMetadata([&](OpMetadata& metadata) {
+      metadata.set_size_of_generated_code_in_bytes(code_size_in_bytes);
+    });
   }
   void set_size_of_memory_working_set_in_bytes(
       int64_t working_set_size_in_bytes) {
-    metadata_.set_size_of_memory_working_set_in_bytes(
-        working_set_size_in_bytes);
+    UpdateMetadata([&](OpMetadata& metadata) {
+      metadata.set_size_of_memory_working_set_in_bytes(
+          working_set_size_in_bytes);
+    });
   }
   void set_creation_pass_id(int64_t pass_id) {
-    metadata_.set_creation_pass_id(pass_id);
+    UpdateMetadata(
+        [&](OpMetadata& metadata) { metadata.set_creation_pass_id(pass_id); });
   }
   void set_metadata_op_name(const std::string& name) {
-    metadata_.set_op_name(name);
+    UpdateMetadata([&](OpMetadata& metadata) { metadata.set_op_name(name); });
   }
   void set_logical_creation_pass_id(int64_t pass_id) {
-    metadata_.set_logical_creation_pass_id(pass_id);
+    UpdateMetadata([&](OpMetadata& metadata) {
+      metadata.set_logical_creation_pass_id(pass_id);
+    });
   }
   void set_metadata_deduplicated_name(std::string deduplicated_name) {
-    metadata_.set_deduplicated_name(std::move(deduplicated_name));
+    UpdateMetadata([&](OpMetadata& metadata) {
+      metadata.set_deduplicated_name(std::move(deduplicated_name));
+    });
+  }
+  const OpMetadata& metadata() const {
+    return metadata_ != nullptr ? *metadata_ : OpMetadata::default_instance();
   }
-  const OpMetadata& metadata() const { return metadata_; }
 
   // Set/get the computation containing this instruction. set_parent should only
   // be called by HloComputation methods which add/remove instructions to
@@ -2000,13 +2087,7 @@ class HloInstruction {
   HloInstruction* fused_expression_root() const;
 
   // Delegates to HloFusionInstruction::fused_instructions.
-  const tsl::gtl::iterator_range<UnwrappingIterator<
-      std::list<std::unique_ptr<HloInstruction>>::const_iterator>>
-  fused_instructions() const;
-
-  const tsl::gtl::iterator_range<
-      UnwrappingIterator<std::list<std::unique_ptr<HloInstruction>>::iterator>>
-  fused_instructions();
+  HloInstructionRange fused_instructions() const;
 
   // Delegates to HloFusionInstruction::fused_instruction_count.
   int64_t fused_instruction_count() const;
@@ -2296,6 +2377,47 @@ class HloInstruction {
     mutable std::string raw_string_;
   };
 
+  // The users of an instruction, in the order in which they were added except
+  // that removing a user moves the last user into its slot. Most instructions
+  // have only a handful of users, which are found by a linear scan of the
+  // vector. Once an instruction has more than kMapThreshold users, a map from
+  // each user to its index in the vector is built as well, so that membership
+  // tests and removals stay constant time.
+  class Users {
+   public:
+    static constexpr int64_t kMapThreshold = 16;
+
+    bool empty() const { return users_.empty(); }
+    int64_t size() const { return users_.size(); }
+    const std::vector<HloInstruction*>& vec() const { return users_; }
+
+    void Clear();
+    bool Contains(const HloInstruction* instruction) const;
+    // Adds `user`, unless it is already present.
+    void AddUser(HloInstruction* user);
+    // Precondition: `user` is present.
+    void RemoveUser(HloInstruction* user);
+    // Precondition: `user` is present.
+    int64_t UserId(const HloInstruction* user) const;
+    void SortInstructionUsers(
+        const MappedPtrContainerSorter<HloInstruction>::MapPtrFn& map_fn,
+        const Users& sorted_instruction_users);
+
+   private:
+    // Returns the index of `user` in users_, or -1 if it is not present.
+    int64_t Find(const HloInstruction* user) const;
+    void RebuildMap();
+
+    std::vector<HloInstruction*> users_;
+    // Maps each user to its index in users_. Null while there are few users.
+    std::unique_ptr<absl::flat_hash_map<const HloInstruction*, int64_t>>
+        user_map_;
+  };
+
+  // Replaces the metadata with a modified copy. The current metadata may be
+  // shared with other instructions, so it is never modified in place.
+  void UpdateMetadata(absl::FunctionRef<void(OpMetadata&)> update);
+
   bool IdenticalInternal(
       const HloInstruction& other,
       absl::FunctionRef<bool(const HloInstruction*, const HloInstruction*)>
@@ -2375,12 +2497,8 @@ class HloInstruction {
   std::vector<HloInstruction*> control_predecessors_;
 
   // The users of this instruction. Users are HLOs where this instruction is an
-  // operand. The vector users_ and the map user_map_ contain identical members.
-  // The map enables fast membership testing and the vector enables fast, stable
-  // iteration. The value in the map contains the index of the instruction in
-  // the vector what enables fast removal.
-  std::vector<HloInstruction*> users_;
-  absl::flat_hash_map<const HloInstruction*, int64_t> user_map_;
+  // operand.
+  Users users_;
 
   // The set of control successors of this instruction.
   std::vector<HloInstruction*> control_successors_;
@@ -2388,6 +2506,10 @@ class HloInstruction {
   // The computation in which this instruction is contained.
   HloComputation* parent_ = nullptr;
 
+  // Position of this instruction in the instruction list of parent_, or -1.
+  // Maintained by HloComputation.
+  int64_t index_in_parent_ = -1;
+
   // Result shape of this instruction.
   Shape shape_;
 
@@ -2414,13 +2536,17 @@ class HloInstruction {
   //    z = add(x,y), frontend_attributes={y}
   // Could be simplified to:
   //    z' = const(20), frontend_attributes={?}
-  FrontendAttributes frontend_attributes_;
+  // Null if there are no attributes. The attributes are shared between
+  // instructions derived from each other, so they are immutable: changes
+  // replace them with a new object.
+  std::shared_ptr<const FrontendAttributes> frontend_attributes_;
 
   // String identifier for instruction.
   std::string name_;
 
-  // Metadata for debugging.
-  OpMetadata metadata_;
+  // Metadata for debugging. Null if there is no metadata; shared and immutable
+  // like frontend_attributes_.
+  std::shared_ptr<const OpMetadata> metadata_;
 
   // This field is assigned to true when backend_config_ is assigned to
   // a default configuration.
@@ -1867,7 +1867,7 @@ HloFusionInstruction::HloFusionInstruction(const Shape& shape,
   CHECK(fused_root != nullptr);
   SetAndSanitizeName(HloOpcodeString(opcode()));
   set_parent(fused_root->parent());
-  set_metadata(fused_root->metadata());
+  CopyMetadataFrom(*fused_root);
   CHECK(fused_root->IsFusible()) << fused_root->ToString();
   CloneAndAppendInstructionIntoCalledComputation(fused_root);
 }
@@ -2137,16 +2137,7 @@ const std::vector<HloInstruction*>& HloFusionInstruction::fused_parameters()
   return fused_instructions_computation()->parameter_instructions();
 }
 
-const tsl::gtl::iterator_range<UnwrappingIterator<
-    std::list<std::unique_ptr<HloInstruction>>::const_iterator>>
-HloFusionInstruction::fused_instructions() const {
-  const HloComputation* subcomp = fused_instructions_computation();
-  return subcomp->instructions();
-}
-
-const tsl::gtl::iterator_range<
-    UnwrappingIterator<std::list<std::unique_ptr<HloInstruction>>::iterator>>
-HloFusionInstruction::fused_instructions() {
+HloInstructionRange HloFusionInstruction::fused_instructions() const {
   return fused_instructions_computation()->instructions();
 }
 
@@ -2225,7 +2216,7 @@ HloCallInstruction::HloCallInstruction(const Shape& shape,
   CHECK(called_computation_root != nullptr);
   SetAndSanitizeName(HloOpcodeString(opcode()));
   set_parent(called_computation_root->parent());
-  set_metadata(called_computation_root->metadata());
+  CopyMetadataFrom(*called_computation_root);
   CloneAndAppendInstructionIntoCalledComputation(called_computation_root);
 }
 
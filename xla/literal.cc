@@ -30,7 +30,9 @@ limitations under the License.
 #include <variant>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/base/casts.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/types/span.h"
@@ -46,6 +48,7 @@ limitations under the License.
 #include "tsl/platform/float8.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/mem.h"
+#include "tsl/platform/threadpool.h"
 #include "tsl/util/byte_swap_array.h"
 
 namespace xla {
@@ -219,6 +222,169 @@ StrideConfig::StrideConfig(const Shape& source_shape, const Shape& dest_shape,
   }
 }
 
+// Returns the distance, in elements, between consecutive indices of each
+// dimension of the dense array 'shape'.
+DimensionVector ElementStrides(const Shape& shape) {
+  DimensionVector strides(shape.rank());
+  int64_t stride = 1;
+  for (int64_t dim : LayoutUtil::MinorToMajor(shape)) {
+    strides[dim] = stride;
+    stride *= shape.dimensions(dim);
+  }
+  return strides;
+}
+
+// Copies smaller than this run on the calling thread even if a thread pool is
+// given.
+constexpr int64_t kMinParallelCopyBytes = 1 << 20;
+
+// A loop of a strided copy: 'size' iterations which advance the destination
+// and the source by 'dest_stride' and 'src_stride' elements.
+struct CopyLoop {
+  int64_t size;
+  int64_t dest_stride;
+  int64_t src_stride;
+};
+
+using CopyLoops = absl::InlinedVector<CopyLoop, InlineRank()>;
+
+// Runs the strided copy described by 'loops', which are ordered from the most
+// minor to the most major in the destination. The loop that is most minor in
+// the source is tiled with the innermost one, so that both arrays are accessed
+// a cache line at a time.
+template <typename NativeT>
+void RunCopyLoops(NativeT* dest, const NativeT* src,
+                  absl::Span<const CopyLoop> loops) {
+  // Tiles of kTileSize x kTileSize elements span a couple of kilobytes.
+  constexpr int64_t kTileSize =
+      std::max<int64_t>(8, 128 / static_cast<int64_t>(sizeof(NativeT)));
+  const CopyLoop& inner = loops[0];
+  int64_t tiled = 0;
+  for (int64_t i = 1; i < loops.size(); ++i) {
+    if (loops[i].src_stride < loops[tiled].src_stride) {
+      tiled = i;
+    }
+  }
+  CopyLoops outer;
+  for (int64_t i = 1; i < loops.size(); ++i) {
+    if (i != tiled) {
+      outer.push_back(loops[i]);
+    }
+  }
+
+  auto copy_block = [&](NativeT* block_dest, const NativeT* block_src) {
+    if (tiled == 0) {
+      if (inner.dest_stride == 1 && inner.src_stride == 1) {
+        std::copy_n(block_src, inner.size, block_dest);
+      } else {
+        StridedCopy(block_dest, inner.dest_stride, block_src, inner.src_stride,
+                    inner.size);
+      }
+      return;
+    }
+    const CopyLoop& row = loops[tiled];
+    for (int64_t i0 = 0; i0 < row.size; i0 += kTileSize) {
+      const int64_t i1 = std::min(i0 + kTileSize, row.size);
+      for (int64_t j0 = 0; j0 < inner.size; j0 += kTileSize) {
+        const int64_t j1 = std::min(j0 + kTileSize, inner.size);
+        for (int64_t i = i0; i < i1; ++i) {
+          NativeT* row_dest = block_dest + i * row.dest_stride;
+          const NativeT* row_src = block_src + i * row.src_stride;
+          for (int64_t j = j0; j < j1; ++j) {
+            row_dest[j * inner.dest_stride] = row_src[j * inner.src_stride];
+          }
+        }
+      }
+    }
+  };
+
+  // Walks the outer loops like an odometer, updating the offsets as it goes.
+  DimensionVector index(outer.size(), 0);
+  int64_t dest_offset = 0;
+  int64_t src_offset = 0;
+  while (true) {
+    copy_block(dest + dest_offset, src + src_offset);
+    int64_t i = 0;
+    for (; i < outer.size(); ++i) {
+      dest_offset += outer[i].dest_stride;
+      src_offset += outer[i].src_stride;
+      if (++index[i] < outer[i].size) {
+        break;
+      }
+      dest_offset -= outer[i].dest_stride * outer[i].size;
+      src_offset -= outer[i].src_stride * outer[i].size;
+      index[i] = 0;
+    }
+    if (i == outer.size()) {
+      return;
+    }
+  }
+}
+
+// Copies an array of the given dimensions from 'src' to 'dest', where
+// 'src_strides' and 'dest_strides' hold the distance, in elements, between
+// consecutive indices of each dimension. If 'thread_pool' is not null, copies
+// of at least kMinParallelCopyBytes are split along their most major dimension
+// and run on it.
+template <typename NativeT>
+void CopyStridedElements(NativeT* dest, absl::Span<const int64_t> dest_strides,
+                         const NativeT* src,
+                         absl::Span<const int64_t> src_strides,
+                         absl::Span<const int64_t> dimensions,
+                         tsl::thread::ThreadPool* thread_pool = nullptr) {
+  DCHECK_EQ(dest_strides.size(), dimensions.size());
+  DCHECK_EQ(src_strides.size(), dimensions.size());
+  CopyLoops loops;
+  int64_t element_count = 1;
+  for (int64_t i = 0; i < dimensions.size(); ++i) {
+    if (dimensions[i] == 0) {
+      return;
+    }
+    if (dimensions[i] != 1) {
+      loops.push_back({dimensions[i], dest_strides[i], src_strides[i]});
+      element_count *= dimensions[i];
+    }
+  }
+  if (loops.empty()) {
+    *dest = *src;
+    return;
+  }
+  // Order the loops from the most minor in the destination, and merge the
+  // ones that are contiguous in both arrays, e.g. all of them if the layouts
+  // agree.
+  absl::c_stable_sort(loops, [](const CopyLoop& a, const CopyLoop& b) {
+    return a.dest_stride < b.dest_stride;
+  });
+  int64_t num_loops = 1;
+  for (int64_t i = 1; i < loops.size(); ++i) {
+    CopyLoop& last = loops[num_loops - 1];
+    if (last.dest_stride * last.size == loops[i].dest_stride &&
+        last.src_stride * last.size == loops[i].src_stride) {
+      last.size *= loops[i].size;
+    } else {
+      loops[num_loops++] = loops[i];
+    }
+  }
+  loops.resize(num_loops);
+
+  const CopyLoop& outer = loops.back();
+  if (thread_pool == nullptr ||
+      element_count * static_cast<int64_t>(sizeof(NativeT)) <
+          kMinParallelCopyBytes ||
+      outer.size == 1) {
+    RunCopyLoops(dest, src, loops);
+    return;
+  }
+  thread_pool->ParallelFor(
+      outer.size, /*cost_per_unit=*/element_count / outer.size,
+      [&](int64_t begin, int64_t end) {
+        CopyLoops shard = loops;
+        shard.back().size = end - begin;
+        RunCopyLoops(dest + begin * outer.dest_stride,
+                     src + begin * outer.src_stride, shard);
+      });
+}
+
 }  // namespace
 
 LiteralBase::~LiteralBase() = default;
@@ -430,34 +596,12 @@ Status MutableLiteralBase::CopySliceFromInternal(
     TF_RET_CHECK(src_base.size() == dest_base.size());
     TF_RET_CHECK(src_base.size() == copy_size.size());
 
-    // Scan the source from minor, stepping in copy size blocks, then within
-    // the index enumeration functor, do a strided copy advancing source index
-    // by one (walking through the minor dimension), and destination index by
-    // proper stride size at the matching dimension.
-    DimensionVector src_indexes(src_base.size(), 0);
-    DimensionVector dest_indexes(dest_base.size(), 0);
-    StrideConfig stride_config(src_literal.shape(), shape(), copy_size);
-
-    auto copy_proc = [&](absl::Span<const int64_t> indexes) {
-      // Map from multi-dimensional index, to source index.
-      std::transform(indexes.begin(), indexes.end(), src_base.begin(),
-                     src_indexes.begin(), std::plus<int64_t>());
-      // Map from multi-dimensional index, to destination index.
-      std::transform(indexes.begin(), indexes.end(), dest_base.begin(),
-                     dest_indexes.begin(), std::plus<int64_t>());
-
-      int64_t src_index = linear_index(src_literal.shape(), src_indexes);
-      int64_t dest_index = linear_index(shape(), dest_indexes);
-
-      StridedCopy(dest_data + dest_index, stride_config.dest_stride,
-                  src_data + src_index, stride_config.source_stride,
-                  stride_config.minor_loop_size);
-      return true;
-    };
-
-    ShapeUtil::ForEachIndex(src_literal.shape(), stride_config.base,
-                            stride_config.dimensions, stride_config.step,
-                            copy_proc);
+    DimensionVector src_strides = ElementStrides(src_literal.shape());
+    DimensionVector dest_strides = ElementStrides(shape());
+    CopyStridedElements(dest_data + linear_index(shape(), dest_base),
+                        dest_strides,
+                        src_data + linear_index(src_literal.shape(), src_base),
+                        src_strides, copy_size);
   }
   return OkStatus();
 }
@@ -589,18 +733,17 @@ namespace {
 template <typename NativeT>
 void CopyElementsBetween(absl::Span<NativeT> dest,
                          absl::Span<const NativeT> src, const Shape& dest_shape,
-                         const Shape& src_shape) {
+                         const Shape& src_shape,
+                         tsl::thread::ThreadPool* thread_pool) {
   DCHECK(LayoutUtil::IsDenseArray(dest_shape));
   DCHECK(LayoutUtil::IsDenseArray(src_shape));
   DCHECK(ShapeUtil::Compatible(dest_shape, src_shape));
   if (ShapeUtil::IsZeroElementArray(dest_shape)) {
     return;
   }
-  std::vector<int64_t> index(dest_shape.rank());
-  do {
-    dest[IndexUtil::MultidimensionalIndexToLinearIndex(dest_shape, index)] =
-        src[IndexUtil::MultidimensionalIndexToLinearIndex(src_shape, index)];
-  } while (IndexUtil::BumpIndices(dest_shape, absl::MakeSpan(index)));
+  CopyStridedElements(dest.data(), ElementStrides(dest_shape), src.data(),
+                      ElementStrides(src_shape), dest_shape.dimensions(),
+                      thread_pool);
 }
 }  // namespace
 
@@ -639,7 +782,8 @@ void LiteralBase::Piece::DeallocateBuffers() {
 }
 
 Status LiteralBase::Piece::CopyFrom(const LiteralBase::Piece& src,
-                                    bool only_dynamic_bound) {
+                                    bool only_dynamic_bound,
+                                    tsl::thread::ThreadPool* thread_pool) {
   CHECK(subshape_ != nullptr);
   CHECK(src.subshape_ != nullptr);
   CHECK(LayoutUtil::IsDenseArray(subshape()))
@@ -677,7 +821,8 @@ Status LiteralBase::Piece::CopyFrom(const LiteralBase::Piece& src,
       CopyElementsWithDynamicBound<NATIVE_T>(src);                          \
     } else {                                                                \
       CopyElementsBetween<NATIVE_T>(data<NATIVE_T>(), src.data<NATIVE_T>(), \
-                                    subshape(), src.subshape());            \
+                                    subshape(), src.subshape(),             \
+                                    thread_pool);                           \
     }                                                                       \
     break;
       COPY_ELEMENTS(U4, u4);
@@ -735,7 +880,8 @@ void MutableLiteralBase::SetDynamicSize(int64_t dim_index,
 Status MutableLiteralBase::CopyFrom(const LiteralSlice& src_literal,
                                     const ShapeIndex& dest_shape_index,
                                     const ShapeIndex& src_shape_index,
-                                    bool only_dynamic_bound) {
+                                    bool only_dynamic_bound,
+                                    tsl::thread::ThreadPool* thread_pool) {
   const Shape& dest_subshape =
       ShapeUtil::GetSubshape(shape(), dest_shape_index);
   const Shape& src_subshape =
@@ -781,7 +927,8 @@ Status MutableLiteralBase::CopyFrom(const LiteralSlice& src_literal,
         }
         TF_RETURN_IF_ERROR(
             piece->CopyFrom(src_literal.piece(src_piece_index),
-                            /*only_dynamic_bound=*/only_dynamic_bound));
+                            /*only_dynamic_bound=*/only_dynamic_bound,
+                            thread_pool));
         return OkStatus();
       });
 }
@@ -979,18 +1126,22 @@ Status MutableLiteralBase::PopulateInplaceParallel(
 }
 
 Literal LiteralBase::Relayout(const Layout& new_layout,
-                              const ShapeIndex& shape_index) const {
+                              const ShapeIndex& shape_index,
+                              tsl::thread::ThreadPool* thread_pool) const {
   // Create new shape with 'new_layout' set at the given shape index.
   Shape new_shape = shape();
   Shape* subshape = ShapeUtil::GetMutableSubshape(&new_shape, shape_index);
   TF_CHECK_OK(LayoutUtil::ValidateLayoutForShape(new_layout, *subshape));
   *subshape->mutable_layout() = new_layout;
   Literal result(new_shape);
-  TF_CHECK_OK(result.CopyFrom(*this));
+  TF_CHECK_OK(result.CopyFrom(*this, /*dest_shape_index=*/{},
+                              /*src_shape_index=*/{},
+                              /*only_dynamic_bound=*/false, thread_pool));
   return result;
 }
 
-Literal LiteralBase::Relayout(const Shape& shape_with_layout) const {
+Literal LiteralBase::Relayout(const Shape& shape_with_layout,
+                              tsl::thread::ThreadPool* thread_pool) const {
   CHECK(ShapeUtil::Compatible(shape_with_layout, shape()))
       << "Given shape_with_layout " << ShapeUtil::HumanString(shape_with_layout)
       << " not compatible with literal shape "
@@ -998,11 +1149,14 @@ Literal LiteralBase::Relayout(const Shape& shape_with_layout) const {
   Literal result = CreateFromShape(shape_with_layout);
   ShapeUtil::ForEachSubshape(
       result.shape(),
-      [this, &result](const Shape& subshape, const ShapeIndex& index) {
+      [this, &result, thread_pool](const Shape& subshape,
+                                   const ShapeIndex& index) {
         if (subshape.IsArray()) {
           TF_CHECK_OK(result.CopyFrom(*this,
                                       /*dest_shape_index=*/index,
-                                      /*src_shape_index=*/index));
+                                      /*src_shape_index=*/index,
+                                      /*only_dynamic_bound=*/false,
+                                      thread_pool));
         }
       });
   return result;
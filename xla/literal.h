@@ -52,6 +52,12 @@ limitations under the License.
 #include "tsl/platform/protobuf.h"
 #include "tsl/platform/status.h"
 
+namespace tsl {
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+}  // namespace tsl
+
 namespace xla {
 
 // Forward declare Literal and LiteralSlice class to be used by the creation
@@ -362,12 +368,15 @@ class LiteralBase {
   // Note: this is useful when the client wants to ensure that a value placed in
   // the XLA allocation tracker has a particular layout; for efficiency
   // purposes or avoiding unimplemented operation/layout combinations.
-  Literal Relayout(const Layout& new_layout,
-                   const ShapeIndex& shape_index = {}) const;
+  //
+  // If 'thread_pool' is not null, large arrays are copied in parallel on it.
+  Literal Relayout(const Layout& new_layout, const ShapeIndex& shape_index = {},
+                   tsl::thread::ThreadPool* thread_pool = nullptr) const;
 
   // An overload of Relayout which changes the layout of the entire shape rather
   // than being limited to a single array within the shape.
-  Literal Relayout(const Shape& shape_with_layout) const;
+  Literal Relayout(const Shape& shape_with_layout,
+                   tsl::thread::ThreadPool* thread_pool = nullptr) const;
 
   // Generate a new literal whose static sizes are equal to the previous
   // literal's dynamic sizes.
@@ -661,8 +670,10 @@ class LiteralBase {
 
     // Copy the data from 'src' into this piece's buffer. Shapes of this piece
     // and src must be compatible. If only_dynamic_bound is true, only elements
-    // within dynamic bounds will be copied.
-    Status CopyFrom(const Piece& src, bool only_dynamic_bound);
+    // within dynamic bounds will be copied. Relayouts of large arrays run on
+    // 'thread_pool' if it is not null.
+    Status CopyFrom(const Piece& src, bool only_dynamic_bound,
+                    tsl::thread::ThreadPool* thread_pool = nullptr);
 
     // Copies the data from the given proto into this piece. The shape of this
     // piece must be equal (not just compatible) to the shape of the proto.
@@ -832,11 +843,14 @@ class MutableLiteralBase : public LiteralBase {
   // literal rooted at 'dest_shape_index'. The subshape of this literal rooted
   // at 'dest_shape_index' must be compatible with the subshape of 'src_literal'
   // rooted at 'src_shape_index', but need not be arrays. If only_dynamic_bound
-  // is true, only elements within dynamic bounds will be copied.
+  // is true, only elements within dynamic bounds will be copied. If
+  // 'thread_pool' is not null, large arrays whose layouts differ are copied in
+  // parallel on it; otherwise the copy runs on the calling thread.
   Status CopyFrom(const LiteralSlice& src_literal,
                   const ShapeIndex& dest_shape_index = {},
                   const ShapeIndex& src_shape_index = {},
-                  bool only_dynamic_bound = false);
+                  bool only_dynamic_bound = false,
+                  tsl::thread::ThreadPool* thread_pool = nullptr);
 
   // Copies the values from src_literal, starting at src_base shape indexes,
   // to this literal, starting at dest_base, where the copy size in each
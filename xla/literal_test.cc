@@ -15,12 +15,15 @@ limitations under the License.
 
 #include "xla/literal.h"
 
+#include <cmath>
 #include <cstdint>
 #include <limits>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/base/casts.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
@@ -33,8 +36,10 @@ limitations under the License.
 #include "xla/test.h"
 #include "xla/types.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/float8.h"
 #include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
@@ -821,6 +826,62 @@ TEST_F(LiteralUtilTest, TestR4RelayoutEquivalence) {
   EXPECT_EQ(literal_r4_2x2x3x3_dim0minor_, dim0major_relaid_to_dim0minor);
 }
 
+TEST_F(LiteralUtilTest, RelayoutBetweenAllLayoutsR4) {
+  // The minor dimension spans more than one tile of the blocked copy.
+  const int64_t dimensions[] = {3, 1, 20, 37};
+  std::vector<int64_t> minor_to_major = {0, 1, 2, 3};
+  std::vector<Layout> layouts;
+  do {
+    layouts.push_back(LayoutUtil::MakeLayout(minor_to_major));
+  } while (absl::c_next_permutation(minor_to_major));
+
+  for (const Layout& src_layout : layouts) {
+    Literal source(ShapeUtil::MakeShapeWithDenseLayout(
+        S32, dimensions, src_layout.minor_to_major()));
+    int32_t seqnr = 0;
+    TF_ASSERT_OK(source.Populate<int32_t>(
+        [&](absl::Span<const int64_t> /*indexes*/) { return ++seqnr; }));
+    for (const Layout& dest_layout : layouts) {
+      Literal relaid = source.Relayout(dest_layout);
+      ASSERT_TRUE(LayoutUtil::Equal(relaid.shape().layout(), dest_layout));
+      relaid.EachCell<int32_t>(
+          [&](absl::Span<const int64_t> indexes, int32_t value) {
+            ASSERT_EQ(value, source.Get<int32_t>(indexes))
+                << src_layout.ToString() << " to " << dest_layout.ToString();
+          });
+    }
+  }
+}
+
+TEST_F(LiteralUtilTest, RelayoutS4) {
+  auto original = LiteralUtil::CreateR2WithLayout<s4>(
+      {{s4(1), s4(-2), s4(3)}, {s4(-4), s4(5), s4(-6)}},
+      layout_r2_dim0major_);
+  Literal relaid = original.Relayout(layout_r2_dim0minor_);
+  EXPECT_THAT(relaid.data<s4>(), ElementsAre(s4(1), s4(-4), s4(-2), s4(5),
+                                             s4(3), s4(-6)));
+  EXPECT_EQ(original, relaid);
+}
+
+TEST_F(LiteralUtilTest, RelayoutLargeR2) {
+  // Large enough to be split across the threads of the pool.
+  Array2D<float> array(1000, 700);
+  array.FillIota(0.0f);
+  Literal original =
+      LiteralUtil::CreateR2FromArray2DWithLayout(array, layout_r2_dim0major_);
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "relayout", 4);
+  for (tsl::thread::ThreadPool* thread_pool : {nullptr, &pool}) {
+    Literal relaid = original.Relayout(layout_r2_dim0minor_,
+                                       /*shape_index=*/{}, thread_pool);
+    absl::Span<const float> data = relaid.data<float>();
+    for (int64_t i = 0; i < 1000; ++i) {
+      for (int64_t j = 0; j < 700; ++j) {
+        ASSERT_EQ(data[j * 1000 + i], array(i, j)) << i << " " << j;
+      }
+    }
+  }
+}
+
 TEST_F(LiteralUtilTest, TestR2LinearLayout) {
   // Test expected memory layout of R2 dim0-minor (column-major) literal.
   auto mat_dim0minor = LiteralUtil::CreateR2WithLayout<int32_t>(
@@ -2621,5 +2682,55 @@ BENCHMARK(BM_BroadcastVectorToMatrix)
     ->ArgPair(16, 1024)
     ->ArgPair(1024, 1024);
 
+// Relayouts a U32 literal of about 2^20 elements and rank state.range(0) from
+// the major-to-minor layout to the minor-to-major one, or, if state.range(1)
+// is set, to a layout that only swaps the two most minor dimensions.
+void BM_Relayout(::testing::benchmark::State& state) {
+  const int64_t rank = state.range(0);
+  const bool swap_minor = state.range(1);
+  const int64_t size = std::lround(std::pow(1 << 20, 1.0 / rank));
+  std::vector<int64_t> dimensions(rank, size);
+  Literal literal(ShapeUtil::MakeShape(U32, dimensions));
+  std::vector<int64_t> minor_to_major(rank);
+  absl::c_iota(minor_to_major, 0);
+  if (swap_minor) {
+    absl::c_reverse(minor_to_major);
+    std::swap(minor_to_major[0], minor_to_major[1]);
+  }
+  const Layout layout = LayoutUtil::MakeLayout(minor_to_major);
+  for (auto s : state) {
+    Literal relaid = literal.Relayout(layout);
+    ::testing::benchmark::DoNotOptimize(relaid);
+  }
+  state.SetBytesProcessed(state.iterations() * literal.size_bytes());
+}
+BENCHMARK(BM_Relayout)
+    ->ArgPair(2, 0)
+    ->ArgPair(3, 0)
+    ->ArgPair(3, 1)
+    ->ArgPair(4, 0)
+    ->ArgPair(4, 1);
+
+// Copies a slice of half the extent in each dimension between U32 literals of
+// rank 4, with the same layout if state.range(0) is set and with reversed
+// layouts otherwise.
+void BM_CopySliceFrom(::testing::benchmark::State& state) {
+  const bool same_layout = state.range(0);
+  const int64_t dimensions[] = {32, 32, 32, 32};
+  Literal source(
+      ShapeUtil::MakeShapeWithDenseLayout(U32, dimensions, {3, 2, 1, 0}));
+  Literal dest(ShapeUtil::MakeShapeWithDenseLayout(
+      U32, dimensions,
+      same_layout ? std::vector<int64_t>{3, 2, 1, 0}
+                  : std::vector<int64_t>{0, 1, 2, 3}));
+  const int64_t src_base[] = {16, 0, 16, 0};
+  const int64_t dest_base[] = {0, 16, 0, 16};
+  const int64_t copy_size[] = {16, 16, 16, 16};
+  for (auto s : state) {
+    TF_ASSERT_OK(dest.CopySliceFrom(source, src_base, dest_base, copy_size));
+  }
+}
+BENCHMARK(BM_CopySliceFrom)->Arg(0)->Arg(1);
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,86 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu_buffer_arena.h"
+
+#include <memory>
+#include <utility>
+
+#include "xla/pjrt/metrics.h"
+#include "xla/util.h"
+#include "tsl/platform/mem.h"
+
+namespace xla {
+
+CpuBufferArena::Slab::~Slab() {
+  if (arena_ != nullptr && data_ != nullptr) {
+    arena_->Release(std::move(data_));
+  }
+}
+
+CpuBufferArena::Slab& CpuBufferArena::Slab::operator=(Slab&& other) {
+  if (this != &other) {
+    if (arena_ != nullptr && data_ != nullptr) {
+      arena_->Release(std::move(data_));
+    }
+    arena_ = std::move(other.arena_);
+    data_ = std::move(other.data_);
+  }
+  return *this;
+}
+
+std::shared_ptr<CpuBufferArena> CpuBufferArena::Create(size_t slab_size,
+                                                       size_t alignment,
+                                                       int max_free_slabs) {
+  return std::make_shared<CpuBufferArena>(slab_size, alignment,
+                                          max_free_slabs);
+}
+
+StatusOr<CpuBufferArena::Slab> CpuBufferArena::Acquire() {
+  {
+    absl::MutexLock lock(&mu_);
+    if (!free_slabs_.empty()) {
+      MaybeOwningCpuMemory::OwnedDataPtr data = std::move(free_slabs_.back());
+      free_slabs_.pop_back();
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      ReportCpuBufferArenaHit();
+      return Slab(shared_from_this(), std::move(data));
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  ReportCpuBufferArenaMiss();
+  uint8_t* data =
+      static_cast<uint8_t*>(tsl::port::AlignedMalloc(slab_size_, alignment_));
+  if (!data) {
+    return ResourceExhausted("Out of memory allocating %d bytes.", slab_size_);
+  }
+  return Slab(shared_from_this(), MaybeOwningCpuMemory::OwnedDataPtr{
+                                      data, tsl::port::AlignedFree});
+}
+
+int CpuBufferArena::num_free_slabs() const {
+  absl::MutexLock lock(&mu_);
+  return free_slabs_.size();
+}
+
+void CpuBufferArena::Release(MaybeOwningCpuMemory::OwnedDataPtr data) {
+  absl::MutexLock lock(&mu_);
+  if (free_slabs_.size() < static_cast<size_t>(max_free_slabs_)) {
+    free_slabs_.push_back(std::move(data));
+  }
+  // Otherwise `data` is freed when it goes out of scope.
+}
+
+}  // namespace xla
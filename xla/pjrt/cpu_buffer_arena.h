@@ -0,0 +1,104 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_PJRT_CPU_BUFFER_ARENA_H_
+#define XLA_PJRT_CPU_BUFFER_ARENA_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/pjrt/tracked_tfrt_cpu_device_buffer.h"
+#include "xla/statusor.h"
+
+namespace xla {
+
+// A pool of fixed-size, aligned memory slabs. A TfrtCpuExecutable owns one
+// arena whose slab size is the sum of all of its (aligned) temporary buffer
+// allocations, so that each in-flight execution can carve all of its
+// temporaries out of a single slab instead of allocating each of them
+// separately. Slabs are returned to the arena when the execution that leased
+// them completes. This class is thread-safe.
+class CpuBufferArena : public std::enable_shared_from_this<CpuBufferArena> {
+ public:
+  // A slab leased from an arena. The slab is handed back to the arena (or
+  // freed, if the arena already caches enough free slabs) on destruction.
+  class Slab {
+   public:
+    Slab() = default;
+    ~Slab();
+
+    Slab(Slab&& other) = default;
+    Slab& operator=(Slab&& other);
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    uint8_t* data() const { return data_.get(); }
+
+   private:
+    friend class CpuBufferArena;
+    Slab(std::shared_ptr<CpuBufferArena> arena,
+         MaybeOwningCpuMemory::OwnedDataPtr data)
+        : arena_(std::move(arena)), data_(std::move(data)) {}
+
+    std::shared_ptr<CpuBufferArena> arena_;
+    MaybeOwningCpuMemory::OwnedDataPtr data_ = {nullptr, free};
+  };
+
+  // Creates an arena handing out slabs of `slab_size` bytes, aligned to
+  // `alignment`. At most `max_free_slabs` unused slabs are kept around.
+  static std::shared_ptr<CpuBufferArena> Create(size_t slab_size,
+                                                size_t alignment,
+                                                int max_free_slabs);
+
+  // Returns a cached slab if one is available (a hit) or allocates a new one
+  // (a miss).
+  StatusOr<Slab> Acquire();
+
+  size_t slab_size() const { return slab_size_; }
+
+  int64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  int64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+  // Number of slabs currently cached by the arena.
+  int num_free_slabs() const;
+
+  CpuBufferArena(size_t slab_size, size_t alignment, int max_free_slabs)
+      : slab_size_(slab_size),
+        alignment_(alignment),
+        max_free_slabs_(max_free_slabs) {}
+
+ private:
+  void Release(MaybeOwningCpuMemory::OwnedDataPtr data);
+
+  const size_t slab_size_;
+  const size_t alignment_;
+  const int max_free_slabs_;
+
+  mutable absl::Mutex mu_;
+  std::vector<MaybeOwningCpuMemory::OwnedDataPtr> free_slabs_
+      ABSL_GUARDED_BY(mu_);
+
+  std::atomic<int64_t> hits_{0};
+  std::atomic<int64_t> misses_{0};
+};
+
+}  // namespace xla
+
+#endif  // XLA_PJRT_CPU_BUFFER_ARENA_H_
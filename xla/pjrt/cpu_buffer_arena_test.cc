@@ -0,0 +1,110 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu_buffer_arena.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "xla/cpu_function_runtime.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace {
+
+TEST(CpuBufferArenaTest, ReusesReleasedSlabs) {
+  auto arena = CpuBufferArena::Create(/*slab_size=*/1024,
+                                      cpu_function_runtime::Align(),
+                                      /*max_free_slabs=*/2);
+  uint8_t* first_data;
+  {
+    TF_ASSERT_OK_AND_ASSIGN(CpuBufferArena::Slab slab, arena->Acquire());
+    first_data = slab.data();
+    ASSERT_NE(first_data, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first_data) %
+                  cpu_function_runtime::Align(),
+              0);
+    std::memset(slab.data(), 0xab, arena->slab_size());
+  }
+  EXPECT_EQ(arena->hits(), 0);
+  EXPECT_EQ(arena->misses(), 1);
+  EXPECT_EQ(arena->num_free_slabs(), 1);
+
+  TF_ASSERT_OK_AND_ASSIGN(CpuBufferArena::Slab slab, arena->Acquire());
+  EXPECT_EQ(slab.data(), first_data);
+  EXPECT_EQ(arena->hits(), 1);
+  EXPECT_EQ(arena->misses(), 1);
+  EXPECT_EQ(arena->num_free_slabs(), 0);
+}
+
+TEST(CpuBufferArenaTest, BoundsNumberOfFreeSlabs) {
+  auto arena = CpuBufferArena::Create(/*slab_size=*/64,
+                                      cpu_function_runtime::Align(),
+                                      /*max_free_slabs=*/2);
+  {
+    std::vector<CpuBufferArena::Slab> slabs;
+    for (int i = 0; i < 4; ++i) {
+      TF_ASSERT_OK_AND_ASSIGN(CpuBufferArena::Slab slab, arena->Acquire());
+      slabs.push_back(std::move(slab));
+    }
+    EXPECT_EQ(arena->misses(), 4);
+  }
+  EXPECT_EQ(arena->num_free_slabs(), 2);
+}
+
+TEST(CpuBufferArenaTest, SlabsOutliveArenaOwner) {
+  auto arena = CpuBufferArena::Create(/*slab_size=*/64,
+                                      cpu_function_runtime::Align(),
+                                      /*max_free_slabs=*/1);
+  TF_ASSERT_OK_AND_ASSIGN(CpuBufferArena::Slab slab, arena->Acquire());
+  std::weak_ptr<CpuBufferArena> weak_arena = arena;
+  arena.reset();
+  EXPECT_FALSE(weak_arena.expired());
+  slab = CpuBufferArena::Slab();
+  EXPECT_TRUE(weak_arena.expired());
+}
+
+TEST(CpuBufferArenaTest, ConcurrentAcquireAndRelease) {
+  auto arena = CpuBufferArena::Create(/*slab_size=*/256,
+                                      cpu_function_runtime::Align(),
+                                      /*max_free_slabs=*/4);
+  constexpr int kNumThreads = 8;
+  constexpr int kIterations = 100;
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "cpu_buffer_arena_test",
+                                 kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&arena, t]() {
+        for (int i = 0; i < kIterations; ++i) {
+          auto slab = arena->Acquire();
+          CHECK(slab.ok());
+          std::memset(slab->data(), t, arena->slab_size());
+        }
+      });
+    }
+  }
+  EXPECT_EQ(arena->hits() + arena->misses(), kNumThreads * kIterations);
+  EXPECT_LE(arena->misses(), kNumThreads * kIterations);
+  EXPECT_LE(arena->num_free_slabs(), 4);
+}
+
+}  // namespace
+}  // namespace xla
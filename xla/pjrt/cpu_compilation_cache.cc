@@ -0,0 +1,261 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu_compilation_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/TargetParser/Host.h"
+#include "xla/debug_options_flags.h"
+#include "xla/pjrt/compile_options.pb.h"
+#include "xla/pjrt/metrics.h"
+#include "xla/util.h"
+#include "xla/xla.pb.h"
+#include "tsl/lib/strings/proto_serialization.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/random.h"
+
+namespace xla {
+namespace {
+
+constexpr absl::string_view kEntrySuffix = ".xla_cpu";
+
+// Bumped whenever the format of the cached executables changes.
+constexpr int kCacheFormatVersion = 1;
+
+// Appends `piece` with a length prefix, so that the concatenation of pieces is
+// unambiguous.
+void AppendKeyPiece(std::string* key_material, absl::string_view piece) {
+  absl::StrAppend(key_material, piece.size(), ":", piece);
+}
+
+// The CPU name and features the JIT targets; see SimpleOrcJIT.
+std::string HostCpuDescription() {
+  std::string description = llvm::sys::getHostCPUName().str();
+  llvm::StringMap<bool> host_features;
+  if (llvm::sys::getHostCPUFeatures(host_features)) {
+    std::vector<std::string> features;
+    for (const auto& feature : host_features) {
+      features.push_back(absl::StrCat(feature.second ? "+" : "-",
+                                      feature.first().str()));
+    }
+    std::sort(features.begin(), features.end());
+    for (const std::string& feature : features) {
+      absl::StrAppend(&description, ",", feature);
+    }
+  }
+  return description;
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<CpuCompilationCache>> CpuCompilationCache::Create(
+    Options options) {
+  if (options.directory.empty()) {
+    return InvalidArgument("CPU compilation cache directory is empty");
+  }
+  TF_RETURN_IF_ERROR(
+      tsl::Env::Default()->RecursivelyCreateDir(options.directory));
+  std::unique_ptr<CpuCompilationCache> cache(
+      new CpuCompilationCache(std::move(options)));
+  TF_RETURN_IF_ERROR(cache->ScanDirectory());
+  return cache;
+}
+
+Status CpuCompilationCache::ScanDirectory() {
+  tsl::Env* env = tsl::Env::Default();
+  std::vector<std::string> children;
+  TF_RETURN_IF_ERROR(env->GetChildren(options_.directory, &children));
+
+  // (modification time, key, size) of every entry, oldest first.
+  std::vector<std::tuple<int64_t, std::string, int64_t>> existing;
+  for (const std::string& child : children) {
+    if (!absl::EndsWith(child, kEntrySuffix)) continue;
+    tsl::FileStatistics stat;
+    if (!env->Stat(tsl::io::JoinPath(options_.directory, child), &stat).ok()) {
+      continue;
+    }
+    existing.emplace_back(
+        stat.mtime_nsec,
+        child.substr(0, child.size() - kEntrySuffix.size()), stat.length);
+  }
+  std::sort(existing.begin(), existing.end());
+
+  absl::MutexLock lock(&mu_);
+  for (const auto& [mtime, key, size] : existing) {
+    TouchLocked(key, size);
+  }
+  EvictLocked();
+  return OkStatus();
+}
+
+StatusOr<std::string> CpuCompilationCache::ComputeKey(
+    const XlaComputation& computation, const CompileOptions& options) const {
+  std::string key_material;
+  absl::StrAppend(&key_material, "xla_cpu_compilation_cache_v",
+                  kCacheFormatVersion);
+  AppendKeyPiece(&key_material, options_.version);
+
+  std::string serialized;
+  if (!tsl::SerializeToStringDeterministic(computation.proto(), &serialized)) {
+    return InternalError("Failed to serialize the HLO module");
+  }
+  AppendKeyPiece(&key_material, serialized);
+
+  TF_ASSIGN_OR_RETURN(CompileOptionsProto options_proto, options.ToProto());
+  if (!tsl::SerializeToStringDeterministic(options_proto, &serialized)) {
+    return InternalError("Failed to serialize the compile options");
+  }
+  AppendKeyPiece(&key_material, serialized);
+
+  // Without explicit debug options the compiler reads them from XLA_FLAGS.
+  if (!options.executable_build_options.has_debug_options()) {
+    if (!tsl::SerializeToStringDeterministic(GetDebugOptionsFromFlags(),
+                                             &serialized)) {
+      return InternalError("Failed to serialize the debug options");
+    }
+    AppendKeyPiece(&key_material, serialized);
+  }
+
+  AppendKeyPiece(&key_material, HostCpuDescription());
+
+  tsl::Fprint128 fingerprint = tsl::Fingerprint128(key_material);
+  return absl::StrCat(absl::Hex(fingerprint.high64, absl::kZeroPad16),
+                      absl::Hex(fingerprint.low64, absl::kZeroPad16));
+}
+
+std::string CpuCompilationCache::EntryPath(absl::string_view key) const {
+  return tsl::io::JoinPath(options_.directory,
+                           absl::StrCat(key, kEntrySuffix));
+}
+
+std::unique_ptr<tsl::ReadOnlyMemoryRegion> CpuCompilationCache::Lookup(
+    absl::string_view key) {
+  std::unique_ptr<tsl::ReadOnlyMemoryRegion> region;
+  Status status =
+      tsl::Env::Default()->NewReadOnlyMemoryRegionFromFile(EntryPath(key),
+                                                           &region);
+
+  absl::MutexLock lock(&mu_);
+  if (!status.ok() || region == nullptr) {
+    ++misses_;
+    ReportCpuCompilationCacheMiss();
+    // The entry may have been evicted by another process.
+    EraseLocked(key);
+    return nullptr;
+  }
+  ++hits_;
+  ReportCpuCompilationCacheHit();
+  // The entry may also have been written by another process.
+  TouchLocked(key, region->length());
+  return region;
+}
+
+Status CpuCompilationCache::Insert(absl::string_view key,
+                                   absl::string_view serialized) {
+  tsl::Env* env = tsl::Env::Default();
+  const std::string path = EntryPath(key);
+  // Readers in other processes only ever see complete entries.
+  const std::string tmp_path =
+      absl::StrCat(path, ".tmp.", absl::Hex(tsl::random::New64()));
+  TF_RETURN_IF_ERROR(tsl::WriteStringToFile(env, tmp_path, serialized));
+  if (Status status = env->RenameFile(tmp_path, path); !status.ok()) {
+    env->DeleteFile(tmp_path).IgnoreError();
+    return status;
+  }
+
+  absl::MutexLock lock(&mu_);
+  TouchLocked(key, serialized.size());
+  EvictLocked();
+  return OkStatus();
+}
+
+void CpuCompilationCache::Erase(absl::string_view key) {
+  tsl::Env::Default()->DeleteFile(EntryPath(key)).IgnoreError();
+  absl::MutexLock lock(&mu_);
+  EraseLocked(key);
+}
+
+void CpuCompilationCache::TouchLocked(absl::string_view key, int64_t size) {
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    size_bytes_ += size - it->second.size;
+    it->second.size = size;
+    lru_.splice(lru_.end(), lru_, it->second.lru_position);
+    return;
+  }
+  lru_.emplace_back(key);
+  entries_[std::string(key)] = Entry{size, std::prev(lru_.end())};
+  size_bytes_ += size;
+}
+
+void CpuCompilationCache::EraseLocked(absl::string_view key) {
+  auto it = entries_.find(key);
+  if (it == entries_.end()) return;
+  size_bytes_ -= it->second.size;
+  lru_.erase(it->second.lru_position);
+  entries_.erase(it);
+}
+
+void CpuCompilationCache::EvictLocked() {
+  // The most recently used entry is kept even if it alone is too large, so
+  // that the entry that was just inserted can be loaded.
+  while (size_bytes_ > options_.max_size_bytes && lru_.size() > 1) {
+    const std::string key = lru_.front();
+    VLOG(1) << "Evicting CPU compilation cache entry " << key;
+    tsl::Env::Default()->DeleteFile(EntryPath(key)).IgnoreError();
+    EraseLocked(key);
+    ++evictions_;
+    ReportCpuCompilationCacheEviction();
+  }
+}
+
+int64_t CpuCompilationCache::hits() const {
+  absl::MutexLock lock(&mu_);
+  return hits_;
+}
+
+int64_t CpuCompilationCache::misses() const {
+  absl::MutexLock lock(&mu_);
+  return misses_;
+}
+
+int64_t CpuCompilationCache::evictions() const {
+  absl::MutexLock lock(&mu_);
+  return evictions_;
+}
+
+int64_t CpuCompilationCache::size_bytes() const {
+  absl::MutexLock lock(&mu_);
+  return size_bytes_;
+}
+
+}  // namespace xla
@@ -0,0 +1,119 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_PJRT_CPU_COMPILATION_CACHE_H_
+#define XLA_PJRT_CPU_COMPILATION_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/client/xla_computation.h"
+#include "xla/pjrt/pjrt_executable.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "tsl/platform/file_system.h"
+
+namespace xla {
+
+// A persistent, content-addressed cache of serialized CPU executables.
+//
+// Entries are files in a single directory, named after a key that fingerprints
+// the unoptimized HLO module, the compile options, the host CPU and the XLA
+// build. Entries are written atomically (to a temporary file that is then
+// renamed), so several processes can share a directory, and are read with
+// mmap. Once the entries exceed `max_size_bytes`, the least recently used ones
+// are deleted. Recency is tracked in memory and seeded from file modification
+// times when the cache is opened. This class is thread-safe.
+class CpuCompilationCache {
+ public:
+  struct Options {
+    // Directory holding the entries. Created if it does not exist.
+    std::string directory;
+
+    // Total size of the entries above which old entries are evicted.
+    int64_t max_size_bytes = int64_t{1} << 30;
+
+    // Identifies the XLA build, e.g. the version of the library embedding it.
+    // Entries written by a build with a different version are never loaded,
+    // because generated code depends on the runtime it was compiled against.
+    std::string version;
+  };
+
+  static StatusOr<std::unique_ptr<CpuCompilationCache>> Create(
+      Options options);
+
+  // Returns the key under which the executable for compiling `computation`
+  // with `options` on this host is cached.
+  StatusOr<std::string> ComputeKey(const XlaComputation& computation,
+                                   const CompileOptions& options) const;
+
+  // Maps the entry for `key` into memory. Returns nullptr on a miss.
+  std::unique_ptr<tsl::ReadOnlyMemoryRegion> Lookup(absl::string_view key);
+
+  // Stores `serialized` under `key`, replacing any existing entry, and evicts
+  // least recently used entries if the cache grew too large.
+  Status Insert(absl::string_view key, absl::string_view serialized);
+
+  // Deletes the entry for `key`, e.g. because it could not be loaded.
+  void Erase(absl::string_view key);
+
+  int64_t hits() const;
+  int64_t misses() const;
+  int64_t evictions() const;
+  int64_t size_bytes() const;
+
+ private:
+  explicit CpuCompilationCache(Options options)
+      : options_(std::move(options)) {}
+
+  struct Entry {
+    int64_t size;
+    std::list<std::string>::iterator lru_position;
+  };
+
+  // Loads the existing entries of the directory into the index.
+  Status ScanDirectory();
+
+  std::string EntryPath(absl::string_view key) const;
+
+  // Adds `key` to the index as the most recently used entry, or marks it as
+  // such if it is already present.
+  void TouchLocked(absl::string_view key, int64_t size)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void EraseLocked(absl::string_view key) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void EvictLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Options options_;
+
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mu_);
+  // Keys of `entries_`, from least to most recently used.
+  std::list<std::string> lru_ ABSL_GUARDED_BY(mu_);
+  int64_t size_bytes_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t hits_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t misses_ ABSL_GUARDED_BY(mu_) = 0;
+  int64_t evictions_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace xla
+
+#endif  // XLA_PJRT_CPU_COMPILATION_CACHE_H_
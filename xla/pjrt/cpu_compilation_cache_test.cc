@@ -0,0 +1,143 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu_compilation_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"
+#include "xla/client/xla_builder.h"
+#include "xla/client/xla_computation.h"
+#include "xla/pjrt/pjrt_executable.h"
+#include "xla/shape_util.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace {
+
+// Returns an empty directory for the current test.
+std::string TestDirectory() {
+  std::string dir = tsl::io::JoinPath(
+      tsl::testing::TmpDir(),
+      ::testing::UnitTest::GetInstance()->current_test_info()->name());
+  int64_t undeleted_files, undeleted_dirs;
+  tsl::Env::Default()
+      ->DeleteRecursively(dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  return dir;
+}
+
+std::string Read(CpuCompilationCache& cache, absl::string_view key) {
+  std::unique_ptr<tsl::ReadOnlyMemoryRegion> region = cache.Lookup(key);
+  if (region == nullptr) return "<miss>";
+  return std::string(static_cast<const char*>(region->data()),
+                     region->length());
+}
+
+TEST(CpuCompilationCacheTest, InsertAndLookup) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<CpuCompilationCache> cache,
+                          CpuCompilationCache::Create({TestDirectory()}));
+  EXPECT_EQ(Read(*cache, "a"), "<miss>");
+  TF_ASSERT_OK(cache->Insert("a", "executable"));
+  EXPECT_EQ(Read(*cache, "a"), "executable");
+  TF_ASSERT_OK(cache->Insert("a", "recompiled"));
+  EXPECT_EQ(Read(*cache, "a"), "recompiled");
+  EXPECT_EQ(cache->hits(), 2);
+  EXPECT_EQ(cache->misses(), 1);
+  EXPECT_EQ(cache->size_bytes(), 10);
+
+  cache->Erase("a");
+  EXPECT_EQ(Read(*cache, "a"), "<miss>");
+  EXPECT_EQ(cache->size_bytes(), 0);
+}
+
+TEST(CpuCompilationCacheTest, EvictsLeastRecentlyUsed) {
+  CpuCompilationCache::Options options;
+  options.directory = TestDirectory();
+  options.max_size_bytes = 10;
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<CpuCompilationCache> cache,
+                          CpuCompilationCache::Create(options));
+  TF_ASSERT_OK(cache->Insert("a", "aaaa"));
+  TF_ASSERT_OK(cache->Insert("b", "bbbb"));
+  EXPECT_EQ(Read(*cache, "a"), "aaaa");
+  TF_ASSERT_OK(cache->Insert("c", "cccc"));
+
+  EXPECT_EQ(cache->evictions(), 1);
+  EXPECT_EQ(cache->size_bytes(), 8);
+  EXPECT_EQ(Read(*cache, "b"), "<miss>");
+  EXPECT_EQ(Read(*cache, "a"), "aaaa");
+  EXPECT_EQ(Read(*cache, "c"), "cccc");
+
+  // An entry larger than the cache is kept until the next insertion.
+  TF_ASSERT_OK(cache->Insert("d", "dddddddddddd"));
+  EXPECT_EQ(Read(*cache, "d"), "dddddddddddd");
+  EXPECT_EQ(Read(*cache, "a"), "<miss>");
+  EXPECT_EQ(Read(*cache, "c"), "<miss>");
+}
+
+TEST(CpuCompilationCacheTest, EntriesPersist) {
+  const std::string dir = TestDirectory();
+  {
+    TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<CpuCompilationCache> cache,
+                            CpuCompilationCache::Create({dir}));
+    TF_ASSERT_OK(cache->Insert("a", "executable"));
+  }
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<CpuCompilationCache> cache,
+                          CpuCompilationCache::Create({dir}));
+  EXPECT_EQ(cache->size_bytes(), 10);
+  EXPECT_EQ(Read(*cache, "a"), "executable");
+}
+
+TEST(CpuCompilationCacheTest, KeyDependsOnComputationOptionsAndVersion) {
+  XlaBuilder add_builder("add");
+  Add(Parameter(&add_builder, 0, ShapeUtil::MakeShape(F32, {4}), "x"),
+      ConstantR0<float>(&add_builder, 1.0f));
+  TF_ASSERT_OK_AND_ASSIGN(XlaComputation add, add_builder.Build());
+  XlaBuilder mul_builder("mul");
+  Mul(Parameter(&mul_builder, 0, ShapeUtil::MakeShape(F32, {4}), "x"),
+      ConstantR0<float>(&mul_builder, 1.0f));
+  TF_ASSERT_OK_AND_ASSIGN(XlaComputation mul, mul_builder.Build());
+
+  const std::string dir = TestDirectory();
+  CpuCompilationCache::Options options;
+  options.directory = dir;
+  options.version = "1";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<CpuCompilationCache> cache,
+                          CpuCompilationCache::Create(options));
+  options.version = "2";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<CpuCompilationCache> other_version,
+                          CpuCompilationCache::Create(options));
+
+  CompileOptions compile_options;
+  CompileOptions two_replicas;
+  two_replicas.executable_build_options.set_num_replicas(2);
+
+  TF_ASSERT_OK_AND_ASSIGN(std::string key,
+                          cache->ComputeKey(add, compile_options));
+  EXPECT_EQ(cache->ComputeKey(add, compile_options).value(), key);
+  EXPECT_NE(cache->ComputeKey(mul, compile_options).value(), key);
+  EXPECT_NE(cache->ComputeKey(add, two_replicas).value(), key);
+  EXPECT_NE(other_version->ComputeKey(add, compile_options).value(), key);
+}
+
+}  // namespace
+}  // namespace xla
@@ -0,0 +1,725 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu_tcp_collectives.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/primitive_util.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/cpu/collective_reduction.h"
+#include "xla/util.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/host_info.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace {
+
+// Sent by the connecting participant to identify itself.
+struct Handshake {
+  static constexpr uint32_t kMagic = 0x58435043;  // "XCPC"
+  uint32_t magic;
+  uint32_t group_key_size;
+  int32_t source_rank;
+  int32_t target_rank;
+};
+
+// Larger handshakes are rejected.
+constexpr uint32_t kMaxGroupKeySize = 1 << 20;
+
+// How long the accepting side waits for the handshake of a new connection.
+constexpr int kHandshakeTimeoutSeconds = 10;
+
+// Owns a file descriptor.
+class Socket {
+ public:
+  Socket() = default;
+  explicit Socket(int fd) : fd_(fd) {}
+  Socket(Socket&& other) : fd_(std::exchange(other.fd_, -1)) {}
+  Socket& operator=(Socket&& other) {
+    if (this != &other) {
+      Reset();
+      fd_ = std::exchange(other.fd_, -1);
+    }
+    return *this;
+  }
+  ~Socket() { Reset(); }
+
+  int fd() const { return fd_; }
+  int release() { return std::exchange(fd_, -1); }
+
+ private:
+  void Reset() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+  }
+
+  int fd_ = -1;
+};
+
+// Blocking I/O of the connection handshake.
+Status WriteAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return tsl::errors::IOError("send", errno);
+    }
+    data += n;
+    size -= n;
+  }
+  return OkStatus();
+}
+
+Status ReadAll(int fd, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = recv(fd, data, size, 0);
+    if (n == 0) return InternalError("Connection closed during handshake");
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return tsl::errors::IOError("recv", errno);
+    }
+    data += n;
+    size -= n;
+  }
+  return OkStatus();
+}
+
+Status SendHandshake(int fd, const std::string& group_key, int source_rank,
+                     int target_rank) {
+  Handshake handshake;
+  handshake.magic = Handshake::kMagic;
+  handshake.group_key_size = group_key.size();
+  handshake.source_rank = source_rank;
+  handshake.target_rank = target_rank;
+  TF_RETURN_IF_ERROR(WriteAll(fd, reinterpret_cast<const char*>(&handshake),
+                              sizeof(handshake)));
+  return WriteAll(fd, group_key.data(), group_key.size());
+}
+
+// Prepares a connection for the data exchanges of TcpCommunicator.
+Status ConfigureConnection(int fd) {
+  int one = 1;
+  if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0) {
+    return tsl::errors::IOError("setsockopt(TCP_NODELAY)", errno);
+  }
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+    return tsl::errors::IOError("fcntl(O_NONBLOCK)", errno);
+  }
+  return OkStatus();
+}
+
+// Returns a socket listening on an ephemeral port of all interfaces, and the
+// port.
+StatusOr<std::pair<Socket, int>> Listen() {
+  Socket listener(socket(AF_INET6, SOCK_STREAM, 0));
+  if (listener.fd() >= 0) {
+    // Also accept IPv4 connections.
+    int off = 0;
+    setsockopt(listener.fd(), IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    sockaddr_in6 address = {};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    if (bind(listener.fd(), reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0) {
+      listener = Socket();
+    }
+  }
+  if (listener.fd() < 0) {
+    listener = Socket(socket(AF_INET, SOCK_STREAM, 0));
+    if (listener.fd() < 0) return tsl::errors::IOError("socket", errno);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener.fd(), reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0) {
+      return tsl::errors::IOError("bind", errno);
+    }
+  }
+  if (listen(listener.fd(), SOMAXCONN) != 0) {
+    return tsl::errors::IOError("listen", errno);
+  }
+  sockaddr_storage address;
+  socklen_t address_size = sizeof(address);
+  if (getsockname(listener.fd(), reinterpret_cast<sockaddr*>(&address),
+                  &address_size) != 0) {
+    return tsl::errors::IOError("getsockname", errno);
+  }
+  int port = address.ss_family == AF_INET6
+                 ? ntohs(reinterpret_cast<sockaddr_in6*>(&address)->sin6_port)
+                 : ntohs(reinterpret_cast<sockaddr_in*>(&address)->sin_port);
+  return std::make_pair(std::move(listener), port);
+}
+
+// Connects to `address`, "host:port", retrying until `deadline`.
+StatusOr<Socket> Connect(const std::string& address, absl::Time deadline) {
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    return InvalidArgument("Invalid address: %s", address);
+  }
+  std::string host = address.substr(0, colon);
+  std::string port = address.substr(colon + 1);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);
+  }
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  if (int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+      error != 0) {
+    return InternalError("Could not resolve %s: %s", address,
+                         gai_strerror(error));
+  }
+  std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> cleanup(addresses,
+                                                             &freeaddrinfo);
+  while (true) {
+    Status status;
+    for (addrinfo* ai = addresses; ai != nullptr; ai = ai->ai_next) {
+      Socket socket(::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+      if (socket.fd() < 0) {
+        status = tsl::errors::IOError("socket", errno);
+        continue;
+      }
+      if (connect(socket.fd(), ai->ai_addr, ai->ai_addrlen) == 0) {
+        return std::move(socket);
+      }
+      status = tsl::errors::IOError(absl::StrCat("connect to ", address),
+                                    errno);
+    }
+    if (absl::Now() > deadline) return status;
+    absl::SleepFor(absl::Milliseconds(100));
+  }
+}
+
+// The bytes sent to and received from one peer in an exchange.
+struct PeerTransfer {
+  const char* send_data = nullptr;
+  size_t send_size = 0;
+  char* recv_data = nullptr;
+  size_t recv_size = 0;
+};
+
+// A participant of a group, connected to every other participant. Collectives
+// are decomposed into exchanges, in which every participant sends to and
+// receives from any number of peers concurrently.
+class TcpCommunicator : public cpu::CollectivesCommunicator {
+ public:
+  TcpCommunicator(int rank, std::vector<Socket> sockets)
+      : rank_(rank), sockets_(std::move(sockets)) {}
+
+  Status AllReduce(const RendezvousKey& key, ReductionKind reduction_kind,
+                   PrimitiveType element_type, int64_t num_elements,
+                   const void* input_buffer, void* output_buffer,
+                   absl::Duration timeout) override;
+
+  Status CollectivePermute(const RendezvousKey& key, size_t num_bytes,
+                           std::optional<int> source_rank,
+                           absl::Span<const int> target_ranks,
+                           const void* input_buffer, void* output_buffer,
+                           absl::Duration timeout) override;
+
+  Status AllToAll(const RendezvousKey& key, size_t chunk_bytes,
+                  absl::Span<const void* const> input_buffers,
+                  absl::Span<void* const> output_buffers,
+                  absl::Duration timeout) override;
+
+  Status AllGather(const RendezvousKey& key, int64_t num_blocks,
+                   size_t block_bytes, const void* input_buffer,
+                   void* output_buffer, absl::Duration timeout) override;
+
+  Status ReduceScatter(const RendezvousKey& key, ReductionKind reduction_kind,
+                       PrimitiveType element_type, int64_t num_blocks,
+                       int64_t chunk_elements, const void* input_buffer,
+                       void* output_buffer, absl::Duration timeout) override;
+
+ private:
+  int num_ranks() const { return sockets_.size(); }
+
+  // Runs `transfers`, indexed by peer, until all are done.
+  Status Exchange(std::vector<PeerTransfer> transfers, absl::Time deadline)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int rank_;
+
+  // Collectives must not interleave on the connections.
+  absl::Mutex mu_;
+  // Indexed by rank; sockets_[rank_] is not connected.
+  std::vector<Socket> sockets_ ABSL_GUARDED_BY(mu_);
+};
+
+Status TcpCommunicator::Exchange(std::vector<PeerTransfer> transfers,
+                                 absl::Time deadline) {
+  std::vector<pollfd> fds;
+  std::vector<int> peers;
+  while (true) {
+    fds.clear();
+    peers.clear();
+    for (int peer = 0; peer < num_ranks(); ++peer) {
+      const PeerTransfer& transfer = transfers[peer];
+      int16_t events = 0;
+      if (transfer.send_size > 0) events |= POLLOUT;
+      if (transfer.recv_size > 0) events |= POLLIN;
+      if (events != 0) {
+        CHECK_NE(peer, rank_);
+        fds.push_back({sockets_[peer].fd(), events, 0});
+        peers.push_back(peer);
+      }
+    }
+    if (fds.empty()) return OkStatus();
+
+    absl::Duration remaining = deadline - absl::Now();
+    if (remaining <= absl::ZeroDuration()) {
+      return tsl::errors::DeadlineExceeded(
+          "Timed out waiting for the peers of rank ", rank_,
+          " of a CPU collective");
+    }
+    int timeout_ms = static_cast<int>(std::min<int64_t>(
+        absl::ToInt64Milliseconds(remaining) + 1, INT_MAX));
+    if (poll(fds.data(), fds.size(), timeout_ms) < 0) {
+      if (errno == EINTR) continue;
+      return tsl::errors::IOError("poll", errno);
+    }
+
+    for (size_t i = 0; i < fds.size(); ++i) {
+      const int peer = peers[i];
+      PeerTransfer& transfer = transfers[peer];
+      const int16_t revents = fds[i].revents;
+      if (revents & POLLNVAL) {
+        return InternalError("Invalid connection to rank %d", peer);
+      }
+      // Errors and hang-ups are reported by send and recv.
+      const bool failed = revents & (POLLERR | POLLHUP);
+      if ((revents & POLLOUT || failed) && transfer.send_size > 0) {
+        ssize_t n = send(fds[i].fd, transfer.send_data, transfer.send_size,
+                         MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+            errno != EINTR) {
+          return tsl::errors::IOError(absl::StrCat("send to rank ", peer),
+                                      errno);
+        }
+        if (n > 0) {
+          transfer.send_data += n;
+          transfer.send_size -= n;
+        }
+      }
+      if ((revents & POLLIN || failed) && transfer.recv_size > 0) {
+        ssize_t n = recv(fds[i].fd, transfer.recv_data, transfer.recv_size, 0);
+        if (n == 0) {
+          return InternalError("Connection to rank %d was closed", peer);
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+            errno != EINTR) {
+          return tsl::errors::IOError(absl::StrCat("recv from rank ", peer),
+                                      errno);
+        }
+        if (n > 0) {
+          transfer.recv_data += n;
+          transfer.recv_size -= n;
+        }
+      }
+    }
+  }
+}
+
+Status TcpCommunicator::AllReduce(const RendezvousKey& key,
+                                  ReductionKind reduction_kind,
+                                  PrimitiveType element_type,
+                                  int64_t num_elements,
+                                  const void* input_buffer,
+                                  void* output_buffer,
+                                  absl::Duration timeout) {
+  absl::MutexLock lock(&mu_);
+  const absl::Time deadline = absl::Now() + timeout;
+  const int64_t n = num_ranks();
+  const int64_t element_bytes = primitive_util::ByteWidth(element_type);
+  const char* input = static_cast<const char*>(input_buffer);
+  char* output = static_cast<char*>(output_buffer);
+
+  // Rank r reduces shard r of the buffer and sends the result to all others.
+  const int64_t shard_elements = CeilOfRatio<int64_t>(num_elements, n);
+  auto shard_begin = [&](int64_t r) {
+    return std::min(r * shard_elements, num_elements) * element_bytes;
+  };
+  auto shard_bytes = [&](int64_t r) {
+    return std::min((r + 1) * shard_elements, num_elements) * element_bytes -
+           shard_begin(r);
+  };
+  const int64_t own_begin = shard_begin(rank_);
+  const int64_t own_bytes = shard_bytes(rank_);
+
+  std::vector<char> received(n * own_bytes);
+  std::vector<PeerTransfer> scatter(n);
+  for (int64_t peer = 0; peer < n; ++peer) {
+    if (peer == rank_) continue;
+    scatter[peer] = {input + shard_begin(peer), size_t(shard_bytes(peer)),
+                     received.data() + peer * own_bytes, size_t(own_bytes)};
+  }
+  TF_RETURN_IF_ERROR(Exchange(std::move(scatter), deadline));
+
+  // Reduce in rank order, so that all shards are reduced alike.
+  std::vector<const void*> inputs(n);
+  for (int64_t r = 0; r < n; ++r) {
+    inputs[r] =
+        r == rank_ ? input + own_begin : received.data() + r * own_bytes;
+  }
+  cpu::ReduceBuffers(reduction_kind, element_type, inputs, output + own_begin,
+                     own_bytes / element_bytes);
+
+  std::vector<PeerTransfer> gather(n);
+  for (int64_t peer = 0; peer < n; ++peer) {
+    if (peer == rank_) continue;
+    gather[peer] = {output + own_begin, size_t(own_bytes),
+                    output + shard_begin(peer), size_t(shard_bytes(peer))};
+  }
+  return Exchange(std::move(gather), deadline);
+}
+
+Status TcpCommunicator::CollectivePermute(const RendezvousKey& key,
+                                          size_t num_bytes,
+                                          std::optional<int> source_rank,
+                                          absl::Span<const int> target_ranks,
+                                          const void* input_buffer,
+                                          void* output_buffer,
+                                          absl::Duration timeout) {
+  absl::MutexLock lock(&mu_);
+  const absl::Time deadline = absl::Now() + timeout;
+  std::vector<PeerTransfer> transfers(num_ranks());
+  for (int target : target_ranks) {
+    if (target == rank_) {
+      std::memcpy(output_buffer, input_buffer, num_bytes);
+    } else {
+      transfers[target].send_data = static_cast<const char*>(input_buffer);
+      transfers[target].send_size = num_bytes;
+    }
+  }
+  if (!source_rank.has_value()) {
+    std::memset(output_buffer, 0, num_bytes);
+  } else if (*source_rank != rank_) {
+    transfers[*source_rank].recv_data = static_cast<char*>(output_buffer);
+    transfers[*source_rank].recv_size = num_bytes;
+  }
+  return Exchange(std::move(transfers), deadline);
+}
+
+Status TcpCommunicator::AllToAll(const RendezvousKey& key, size_t chunk_bytes,
+                                 absl::Span<const void* const> input_buffers,
+                                 absl::Span<void* const> output_buffers,
+                                 absl::Duration timeout) {
+  absl::MutexLock lock(&mu_);
+  const absl::Time deadline = absl::Now() + timeout;
+  TF_RET_CHECK(input_buffers.size() == num_ranks());
+  TF_RET_CHECK(output_buffers.size() == num_ranks());
+  std::vector<PeerTransfer> transfers(num_ranks());
+  for (int peer = 0; peer < num_ranks(); ++peer) {
+    if (peer == rank_) continue;
+    transfers[peer] = {static_cast<const char*>(input_buffers[peer]),
+                       chunk_bytes, static_cast<char*>(output_buffers[peer]),
+                       chunk_bytes};
+  }
+  std::memcpy(output_buffers[rank_], input_buffers[rank_], chunk_bytes);
+  return Exchange(std::move(transfers), deadline);
+}
+
+Status TcpCommunicator::AllGather(const RendezvousKey& key, int64_t num_blocks,
+                                  size_t block_bytes, const void* input_buffer,
+                                  void* output_buffer, absl::Duration timeout) {
+  absl::MutexLock lock(&mu_);
+  const absl::Time deadline = absl::Now() + timeout;
+  const int64_t n = num_ranks();
+  const size_t input_bytes = num_blocks * block_bytes;
+  const char* input = static_cast<const char*>(input_buffer);
+  char* output = static_cast<char*>(output_buffer);
+  auto output_block = [&](int64_t block, int64_t rank) {
+    return output + (block * n + rank) * block_bytes;
+  };
+
+  // A single block is received in place; several are interleaved afterwards.
+  std::vector<char> received(num_blocks == 1 ? 0 : n * input_bytes);
+  std::vector<PeerTransfer> transfers(n);
+  for (int64_t peer = 0; peer < n; ++peer) {
+    if (peer == rank_) continue;
+    char* destination = num_blocks == 1 ? output_block(0, peer)
+                                        : received.data() + peer * input_bytes;
+    transfers[peer] = {input, input_bytes, destination, input_bytes};
+  }
+  TF_RETURN_IF_ERROR(Exchange(std::move(transfers), deadline));
+
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    std::memcpy(output_block(b, rank_), input + b * block_bytes, block_bytes);
+    if (num_blocks == 1) continue;
+    for (int64_t peer = 0; peer < n; ++peer) {
+      if (peer == rank_) continue;
+      std::memcpy(output_block(b, peer),
+                  received.data() + peer * input_bytes + b * block_bytes,
+                  block_bytes);
+    }
+  }
+  return OkStatus();
+}
+
+Status TcpCommunicator::ReduceScatter(const RendezvousKey& key,
+                                      ReductionKind reduction_kind,
+                                      PrimitiveType element_type,
+                                      int64_t num_blocks,
+                                      int64_t chunk_elements,
+                                      const void* input_buffer,
+                                      void* output_buffer,
+                                      absl::Duration timeout) {
+  absl::MutexLock lock(&mu_);
+  const absl::Time deadline = absl::Now() + timeout;
+  const int64_t n = num_ranks();
+  const size_t chunk_bytes =
+      chunk_elements * primitive_util::ByteWidth(element_type);
+  const size_t peer_bytes = num_blocks * chunk_bytes;
+  const char* input = static_cast<const char*>(input_buffer);
+  char* output = static_cast<char*>(output_buffer);
+  auto input_chunk = [&](int64_t block, int64_t rank) {
+    return input + (block * n + rank) * chunk_bytes;
+  };
+
+  // The chunks for one peer are contiguous if there is a single block.
+  std::vector<char> packed(num_blocks == 1 ? 0 : n * peer_bytes);
+  std::vector<char> received(n * peer_bytes);
+  std::vector<PeerTransfer> transfers(n);
+  for (int64_t peer = 0; peer < n; ++peer) {
+    if (peer == rank_) continue;
+    const char* source = input_chunk(0, peer);
+    if (num_blocks > 1) {
+      char* pack = packed.data() + peer * peer_bytes;
+      for (int64_t b = 0; b < num_blocks; ++b) {
+        std::memcpy(pack + b * chunk_bytes, input_chunk(b, peer), chunk_bytes);
+      }
+      source = pack;
+    }
+    transfers[peer] = {source, peer_bytes,
+                       received.data() + peer * peer_bytes, peer_bytes};
+  }
+  TF_RETURN_IF_ERROR(Exchange(std::move(transfers), deadline));
+
+  std::vector<const void*> inputs(n);
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    for (int64_t r = 0; r < n; ++r) {
+      inputs[r] = r == rank_ ? input_chunk(b, rank_)
+                             : received.data() + r * peer_bytes +
+                                   b * chunk_bytes;
+    }
+    cpu::ReduceBuffers(reduction_kind, element_type, inputs,
+                       output + b * chunk_bytes, chunk_elements);
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<CpuTcpCollectives>> CpuTcpCollectives::Create(
+    std::shared_ptr<DistributedRuntimeClient> distributed_client,
+    Options options) {
+  if (distributed_client == nullptr) {
+    return InvalidArgument("CpuTcpCollectives needs a distributed client");
+  }
+  if (options.hostname.empty()) {
+    options.hostname = tsl::port::Hostname();
+  }
+  TF_ASSIGN_OR_RETURN(auto listener, Listen());
+  auto [socket, port] = std::move(listener);
+  VLOG(1) << "CPU collectives listening on " << options.hostname << ":"
+          << port;
+  return absl::WrapUnique(new CpuTcpCollectives(std::move(distributed_client),
+                                                std::move(options),
+                                                socket.release(), port));
+}
+
+CpuTcpCollectives::CpuTcpCollectives(
+    std::shared_ptr<DistributedRuntimeClient> distributed_client,
+    Options options, int listen_fd, int port)
+    : distributed_client_(std::move(distributed_client)),
+      options_(std::move(options)),
+      listen_fd_(listen_fd),
+      port_(port) {
+  accept_thread_.reset(tsl::Env::Default()->StartThread(
+      tsl::ThreadOptions(), "CpuTcpCollectivesAccept",
+      [this] { AcceptConnections(); }));
+}
+
+CpuTcpCollectives::~CpuTcpCollectives() {
+  // Wakes up the accept thread.
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.reset();
+  close(listen_fd_);
+  absl::MutexLock lock(&mu_);
+  for (const auto& [key, fd] : pending_connections_) {
+    close(fd);
+  }
+}
+
+void CpuTcpCollectives::AcceptConnections() {
+  while (true) {
+    Socket socket(accept(listen_fd_, nullptr, nullptr));
+    if (socket.fd() < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      // EINVAL once the listening socket is shut down.
+      if (errno != EINVAL) {
+        LOG(ERROR) << "CPU collectives stopped accepting connections: "
+                   << strerror(errno);
+      }
+      return;
+    }
+    // A peer that does not complete its handshake must not stall the others.
+    timeval timeout = {kHandshakeTimeoutSeconds, 0};
+    setsockopt(socket.fd(), SOL_SOCKET, SO_RCVTIMEO, &timeout,
+               sizeof(timeout));
+    Handshake handshake;
+    Status status = ReadAll(socket.fd(), reinterpret_cast<char*>(&handshake),
+                            sizeof(handshake));
+    if (status.ok() && (handshake.magic != Handshake::kMagic ||
+                        handshake.group_key_size > kMaxGroupKeySize)) {
+      status = InternalError("Invalid handshake");
+    }
+    std::string group_key;
+    if (status.ok()) {
+      group_key.resize(handshake.group_key_size);
+      status = ReadAll(socket.fd(), group_key.data(), group_key.size());
+    }
+    if (!status.ok()) {
+      LOG(WARNING) << "Rejected CPU collectives connection: " << status;
+      continue;
+    }
+    timeval no_timeout = {0, 0};
+    setsockopt(socket.fd(), SOL_SOCKET, SO_RCVTIMEO, &no_timeout,
+               sizeof(no_timeout));
+
+    absl::MutexLock lock(&mu_);
+    auto key = std::make_tuple(std::move(group_key), handshake.target_rank,
+                               handshake.source_rank);
+    if (!pending_connections_.emplace(key, socket.fd()).second) {
+      LOG(WARNING) << "Rejected duplicate CPU collectives connection from rank "
+                   << handshake.source_rank << " to rank "
+                   << handshake.target_rank;
+      continue;
+    }
+    socket.release();
+  }
+}
+
+StatusOr<int> CpuTcpCollectives::AwaitConnection(const std::string& group_key,
+                                                 int target_rank,
+                                                 int source_rank,
+                                                 absl::Time deadline) {
+  auto key = std::make_tuple(group_key, target_rank, source_rank);
+  auto connected = [&]() {
+    mu_.AssertHeld();
+    return pending_connections_.contains(key);
+  };
+  absl::MutexLock lock(&mu_);
+  if (!mu_.AwaitWithDeadline(absl::Condition(&connected), deadline)) {
+    return tsl::errors::DeadlineExceeded(
+        "Timed out waiting for rank ", source_rank, " of CPU devices [",
+        group_key, "] to connect");
+  }
+  auto it = pending_connections_.find(key);
+  int fd = it->second;
+  pending_connections_.erase(it);
+  return fd;
+}
+
+StatusOr<std::shared_ptr<cpu::CollectivesCommunicator>>
+CpuTcpCollectives::GetCommunicator(absl::Span<const GlobalDeviceId> devices,
+                                   int rank) {
+  if (rank < 0 || rank >= devices.size()) {
+    return InvalidArgument("Invalid rank %d of %d devices", rank,
+                           devices.size());
+  }
+  std::string group_key = absl::StrJoin(
+      devices, ",", [](std::string* out, GlobalDeviceId device) {
+        absl::StrAppend(out, device.value());
+      });
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = communicators_.find(std::make_pair(group_key, rank));
+    if (it != communicators_.end()) return it->second;
+  }
+
+  const absl::Time deadline = absl::Now() + options_.connect_timeout;
+  auto address_key = [&](int r) {
+    return absl::StrCat(options_.key_prefix, "/", group_key, "/", r);
+  };
+  TF_RETURN_IF_ERROR(distributed_client_->KeyValueSet(
+      address_key(rank), absl::StrCat(options_.hostname, ":", port_)));
+
+  // Participants connect to those of lower rank and are connected to by those
+  // of higher rank.
+  std::vector<Socket> sockets(devices.size());
+  for (int peer = 0; peer < rank; ++peer) {
+    TF_ASSIGN_OR_RETURN(std::string address,
+                        distributed_client_->BlockingKeyValueGet(
+                            address_key(peer), deadline - absl::Now()));
+    TF_ASSIGN_OR_RETURN(sockets[peer], Connect(address, deadline));
+    TF_RETURN_IF_ERROR(
+        SendHandshake(sockets[peer].fd(), group_key, rank, peer));
+  }
+  for (int peer = rank + 1; peer < devices.size(); ++peer) {
+    TF_ASSIGN_OR_RETURN(int fd,
+                        AwaitConnection(group_key, rank, peer, deadline));
+    sockets[peer] = Socket(fd);
+  }
+  for (int peer = 0; peer < devices.size(); ++peer) {
+    if (peer != rank) {
+      TF_RETURN_IF_ERROR(ConfigureConnection(sockets[peer].fd()));
+    }
+  }
+  VLOG(1) << "Connected rank " << rank << " of CPU devices [" << group_key
+          << "]";
+
+  auto communicator =
+      std::make_shared<TcpCommunicator>(rank, std::move(sockets));
+  absl::MutexLock lock(&mu_);
+  return communicators_
+      .emplace(std::make_pair(std::move(group_key), rank),
+               std::move(communicator))
+      .first->second;
+}
+
+}  // namespace xla
@@ -0,0 +1,112 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_PJRT_CPU_TCP_COLLECTIVES_H_
+#define XLA_PJRT_CPU_TCP_COLLECTIVES_H_
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/pjrt/distributed/client.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/global_device_id.h"
+#include "xla/statusor.h"
+#include "tsl/platform/env.h"
+
+namespace xla {
+
+// Runs the collectives of XLA:CPU between processes over TCP. Every process of
+// a job creates one CpuTcpCollectives and passes it to its TfrtCpuClient, see
+// CpuClientOptions.
+//
+// Each instance listens on one port. The participants of a group of devices
+// publish that address in the key-value store of the distributed runtime and
+// connect to each other, so that every pair of participants of the group has
+// its own connection. Collectives then exchange data directly between pairs:
+// all-reduce, for instance, is a reduce-scatter followed by an all-gather,
+// where each participant reduces 1/n-th of the buffer.
+//
+// POSIX only.
+class CpuTcpCollectives : public cpu::CollectivesInterface {
+ public:
+  struct Options {
+    // The host name or address that other processes connect to. Defaults to
+    // the host name of this machine.
+    std::string hostname;
+
+    // Prefix of the keys in the key-value store. Processes that run several
+    // independent jobs over one distributed runtime need different prefixes.
+    std::string key_prefix = "cpu_tcp_collectives";
+
+    // How long GetCommunicator waits for the other participants of a group.
+    absl::Duration connect_timeout = absl::Minutes(5);
+  };
+
+  // `distributed_client` must be connected.
+  static StatusOr<std::unique_ptr<CpuTcpCollectives>> Create(
+      std::shared_ptr<DistributedRuntimeClient> distributed_client,
+      Options options);
+
+  ~CpuTcpCollectives() override;
+
+  // Returns the communicator of participant `rank` of `devices`. Communicators
+  // are created once and cached.
+  StatusOr<std::shared_ptr<cpu::CollectivesCommunicator>> GetCommunicator(
+      absl::Span<const GlobalDeviceId> devices, int rank) override;
+
+  // The port that other processes connect to.
+  int port() const { return port_; }
+
+ private:
+  CpuTcpCollectives(
+      std::shared_ptr<DistributedRuntimeClient> distributed_client,
+      Options options, int listen_fd, int port);
+
+  // Accepts the connections of other participants until the listening socket
+  // is shut down.
+  void AcceptConnections();
+
+  // Waits until the participant `source_rank` of the group `group_key` has
+  // connected to participant `target_rank`, and returns the connection.
+  StatusOr<int> AwaitConnection(const std::string& group_key, int target_rank,
+                                int source_rank, absl::Time deadline);
+
+  const std::shared_ptr<DistributedRuntimeClient> distributed_client_;
+  const Options options_;
+  const int listen_fd_;
+  const int port_;
+
+  absl::Mutex mu_;
+  // Accepted connections that their participant has not picked up yet, by
+  // group, target rank and source rank.
+  absl::flat_hash_map<std::tuple<std::string, int, int>, int>
+      pending_connections_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<std::pair<std::string, int>,
+                      std::shared_ptr<cpu::CollectivesCommunicator>>
+      communicators_ ABSL_GUARDED_BY(mu_);
+
+  std::unique_ptr<tsl::Thread> accept_thread_;
+};
+
+}  // namespace xla
+
+#endif  // XLA_PJRT_CPU_TCP_COLLECTIVES_H_
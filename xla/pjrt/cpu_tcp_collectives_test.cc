@@ -0,0 +1,338 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu_tcp_collectives.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "xla/client/xla_computation.h"
+#include "xla/pjrt/distributed/distributed.h"
+#include "xla/pjrt/tfrt_cpu_pjrt_client.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/shape_util.h"
+#include "xla/status_macros.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/subprocess.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/threadpool.h"
+#include "tsl/util/command_line_flags.h"
+
+namespace xla {
+namespace {
+
+// The name of this binary, which the multi-process test runs once per node.
+std::string binary_name;  // NOLINT
+
+constexpr int kNumNodes = 2;
+constexpr int kDevicesPerNode = 2;
+constexpr int kNumDevices = kNumNodes * kDevicesPerNode;
+constexpr absl::Duration kTimeout = absl::Seconds(60);
+
+std::unique_ptr<DistributedRuntimeService> StartService(int port) {
+  DistributedRuntimeServiceImpl::Options options;
+  options.num_nodes = kNumNodes;
+  auto service =
+      GetDistributedRuntimeService(absl::StrCat("[::]:", port), options,
+                                   /*use_coordination_service=*/false);
+  TF_CHECK_OK(service.status());
+  return std::move(service).value();
+}
+
+std::shared_ptr<DistributedRuntimeClient> ConnectedClient(int node_id,
+                                                          int port) {
+  DistributedRuntimeClient::Options options;
+  options.node_id = node_id;
+  auto client =
+      GetDistributedRuntimeClient(absl::StrCat("localhost:", port), options,
+                                  /*use_coordination_service=*/false);
+  TF_CHECK_OK(client->Connect());
+  return client;
+}
+
+// Runs every collective between kNumDevices ranks, kDevicesPerNode of which
+// share a CpuTcpCollectives.
+Status RunCollectives(CpuTcpCollectives& collectives, int rank) {
+  std::vector<GlobalDeviceId> devices;
+  for (int i = 0; i < kNumDevices; ++i) devices.push_back(GlobalDeviceId(i));
+  TF_ASSIGN_OR_RETURN(auto communicator,
+                      collectives.GetCommunicator(devices, rank));
+  RendezvousKey key(RunId(), devices, /*num_local_participants=*/1,
+                    RendezvousKey::kCrossReplica, /*op_id=*/0);
+
+  // Sizes that do not divide into the number of ranks.
+  for (int64_t size : {1, 5, 1001}) {
+    std::vector<int32_t> input(size), output(size);
+    for (int64_t i = 0; i < size; ++i) input[i] = rank * 1000 + i;
+    TF_RETURN_IF_ERROR(communicator->AllReduce(
+        key, ReductionKind::SUM, S32, size, input.data(), output.data(),
+        kTimeout));
+    for (int64_t i = 0; i < size; ++i) {
+      TF_RET_CHECK(output[i] == 6000 + kNumDevices * i) << i;
+    }
+  }
+
+  {
+    const int64_t num_blocks = 3;
+    std::vector<int32_t> input(num_blocks), output(num_blocks * kNumDevices);
+    for (int64_t b = 0; b < num_blocks; ++b) input[b] = rank * 10 + b;
+    TF_RETURN_IF_ERROR(communicator->AllGather(key, num_blocks,
+                                               sizeof(int32_t), input.data(),
+                                               output.data(), kTimeout));
+    for (int64_t b = 0; b < num_blocks; ++b) {
+      for (int r = 0; r < kNumDevices; ++r) {
+        TF_RET_CHECK(output[b * kNumDevices + r] == r * 10 + b);
+      }
+    }
+  }
+
+  {
+    const int64_t num_blocks = 2;
+    const int64_t chunk_elements = 3;
+    std::vector<float> input(num_blocks * kNumDevices * chunk_elements);
+    std::vector<float> output(num_blocks * chunk_elements);
+    for (int64_t i = 0; i < input.size(); ++i) input[i] = rank + i;
+    TF_RETURN_IF_ERROR(communicator->ReduceScatter(
+        key, ReductionKind::MAX, F32, num_blocks, chunk_elements, input.data(),
+        output.data(), kTimeout));
+    for (int64_t b = 0; b < num_blocks; ++b) {
+      for (int64_t e = 0; e < chunk_elements; ++e) {
+        int64_t i = (b * kNumDevices + rank) * chunk_elements + e;
+        TF_RET_CHECK(output[b * chunk_elements + e] == kNumDevices - 1 + i);
+      }
+    }
+  }
+
+  {
+    std::vector<int32_t> inputs(kNumDevices), outputs(kNumDevices);
+    std::vector<const void*> input_buffers;
+    std::vector<void*> output_buffers;
+    for (int r = 0; r < kNumDevices; ++r) {
+      inputs[r] = rank * 10 + r;
+      input_buffers.push_back(&inputs[r]);
+      output_buffers.push_back(&outputs[r]);
+    }
+    TF_RETURN_IF_ERROR(communicator->AllToAll(
+        key, sizeof(int32_t), input_buffers, output_buffers, kTimeout));
+    for (int r = 0; r < kNumDevices; ++r) {
+      TF_RET_CHECK(outputs[r] == r * 10 + rank);
+    }
+  }
+
+  {
+    // Shifts to the next rank; rank 0 has no source.
+    int32_t input = rank + 100;
+    int32_t output = -1;
+    std::vector<int> targets;
+    if (rank + 1 < kNumDevices) targets.push_back(rank + 1);
+    std::optional<int> source;
+    if (rank > 0) source = rank - 1;
+    TF_RETURN_IF_ERROR(communicator->CollectivePermute(
+        key, sizeof(int32_t), source, targets, &input, &output, kTimeout));
+    TF_RET_CHECK(output == (rank > 0 ? rank + 99 : 0));
+  }
+  return OkStatus();
+}
+
+TEST(CpuTcpCollectivesTest, AllCollectives) {
+  int port = tsl::testing::PickUnusedPortOrDie();
+  auto service = StartService(port);
+
+  std::vector<std::shared_ptr<DistributedRuntimeClient>> clients(kNumNodes);
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "connect", kNumNodes);
+    for (int node = 0; node < kNumNodes; ++node) {
+      pool.Schedule([&, node] { clients[node] = ConnectedClient(node, port); });
+    }
+  }
+  std::vector<std::unique_ptr<CpuTcpCollectives>> collectives;
+  for (int node = 0; node < kNumNodes; ++node) {
+    CpuTcpCollectives::Options options;
+    options.hostname = "localhost";
+    TF_ASSERT_OK_AND_ASSIGN(collectives.emplace_back(),
+                            CpuTcpCollectives::Create(clients[node], options));
+  }
+
+  std::vector<Status> statuses(kNumDevices);
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "ranks", kNumDevices);
+    for (int rank = 0; rank < kNumDevices; ++rank) {
+      pool.Schedule([&, rank] {
+        statuses[rank] =
+            RunCollectives(*collectives[rank / kDevicesPerNode], rank);
+      });
+    }
+  }
+  for (int rank = 0; rank < kNumDevices; ++rank) {
+    TF_EXPECT_OK(statuses[rank]) << "rank " << rank;
+  }
+
+  collectives.clear();
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "shutdown", kNumNodes);
+  for (int node = 0; node < kNumNodes; ++node) {
+    pool.Schedule([&, node] { TF_EXPECT_OK(clients[node]->Shutdown()); });
+  }
+}
+
+TEST(CpuTcpCollectivesTest, TimesOutWithoutPeers) {
+  int port = tsl::testing::PickUnusedPortOrDie();
+  DistributedRuntimeServiceImpl::Options service_options;
+  service_options.num_nodes = 1;
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto service,
+      GetDistributedRuntimeService(absl::StrCat("[::]:", port),
+                                   service_options,
+                                   /*use_coordination_service=*/false));
+  auto client = ConnectedClient(/*node_id=*/0, port);
+
+  CpuTcpCollectives::Options options;
+  options.hostname = "localhost";
+  options.connect_timeout = absl::Milliseconds(200);
+  TF_ASSERT_OK_AND_ASSIGN(auto collectives,
+                          CpuTcpCollectives::Create(client, options));
+  std::vector<GlobalDeviceId> devices = {GlobalDeviceId(0), GlobalDeviceId(1)};
+  EXPECT_FALSE(collectives->GetCommunicator(devices, /*rank=*/1).ok());
+}
+
+// Runs on node `node_id` of the multi-process test: an all-reduce over the
+// devices of all nodes, through TfrtCpuClient.
+Status RunNode(int node_id, int port) {
+  auto distributed_client = ConnectedClient(node_id, port);
+  CpuTcpCollectives::Options collectives_options;
+  collectives_options.hostname = "localhost";
+  TF_ASSIGN_OR_RETURN(
+      std::shared_ptr<CpuTcpCollectives> collectives,
+      CpuTcpCollectives::Create(distributed_client, collectives_options));
+
+  CpuClientOptions options;
+  options.cpu_device_count = kDevicesPerNode;
+  options.process_index = node_id;
+  options.num_processes = kNumNodes;
+  options.collectives = collectives;
+  TF_ASSIGN_OR_RETURN(auto client, GetTfrtCpuClient(options));
+  TF_RET_CHECK(client->device_count() == kNumDevices);
+  TF_RET_CHECK(client->addressable_device_count() == kDevicesPerNode);
+
+  constexpr char kProgram[] = R"(
+    HloModule all_reduce, replica_count=4
+
+    add {
+      x = f32[] parameter(0)
+      y = f32[] parameter(1)
+      ROOT add = f32[] add(x, y)
+    }
+
+    ENTRY all_reduce {
+      p = f32[5] parameter(0)
+      ROOT all-reduce = f32[5] all-reduce(p), replica_groups={}, to_apply=add
+    })";
+  TF_ASSIGN_OR_RETURN(auto hlo_module,
+                      ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  CompileOptions compile_options;
+  compile_options.executable_build_options.set_num_replicas(kNumDevices);
+  TF_ASSIGN_OR_RETURN(auto executable,
+                      client->Compile(xla_computation, compile_options));
+
+  Shape shape = ShapeUtil::MakeShape(F32, {5});
+  std::vector<std::unique_ptr<PjRtBuffer>> buffers;
+  std::vector<std::vector<PjRtBuffer*>> arguments;
+  for (PjRtDevice* device : executable->addressable_devices()) {
+    std::vector<float> data(5, device->id() + 1);
+    TF_ASSIGN_OR_RETURN(
+        buffers.emplace_back(),
+        client->BufferFromHostBuffer(
+            data.data(), shape.element_type(), shape.dimensions(),
+            /*byte_strides=*/std::nullopt,
+            PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+            nullptr, device));
+    arguments.push_back({buffers.back().get()});
+  }
+  TF_ASSIGN_OR_RETURN(auto results,
+                      executable->Execute(arguments, /*options=*/{}));
+  TF_RET_CHECK(results.size() == kDevicesPerNode);
+  for (const auto& result : results) {
+    TF_ASSIGN_OR_RETURN(auto literal, result[0]->ToLiteralSync());
+    for (float value : literal->data<float>()) {
+      // 1 + 2 + 3 + 4.
+      TF_RET_CHECK(value == 10) << value;
+    }
+  }
+  return distributed_client->Shutdown();
+}
+
+TEST(CpuTcpCollectivesTest, MultiProcessAllReduce) {
+  int port = tsl::testing::PickUnusedPortOrDie();
+  auto service = StartService(port);
+
+  std::vector<tsl::SubProcess> nodes(kNumNodes);
+  for (int node = 0; node < kNumNodes; ++node) {
+    std::vector<std::string> argv = {binary_name,
+                                     absl::StrCat("--node_id=", node),
+                                     absl::StrCat("--port=", port)};
+    nodes[node].SetProgram(binary_name, argv);
+    nodes[node].SetChannelAction(tsl::CHAN_STDOUT, tsl::ACTION_PIPE);
+    nodes[node].SetChannelAction(tsl::CHAN_STDERR, tsl::ACTION_PIPE);
+    ASSERT_TRUE(nodes[node].Start()) << "node " << node;
+  }
+  for (int node = 0; node < kNumNodes; ++node) {
+    std::string stdout_str;
+    std::string stderr_str;
+    int status = nodes[node].Communicate(nullptr, &stdout_str, &stderr_str);
+    EXPECT_EQ(status, 0) << "node " << node << "\nstdout:\n"
+                         << stdout_str << "\nstderr:\n"
+                         << stderr_str;
+  }
+}
+
+}  // namespace
+}  // namespace xla
+
+int main(int argc, char* argv[]) {
+  // Save the name of the binary so that it may invoke itself.
+  xla::binary_name = argv[0];
+  int node_id = -1;
+  int port = -1;
+  const std::vector<tsl::Flag> flag_list = {
+      tsl::Flag("node_id", &node_id,
+                "If set, runs node `node_id` of the multi-process test."),
+      tsl::Flag("port", &port, "Port of the distributed runtime service."),
+  };
+  std::string usage = tsl::Flags::Usage(argv[0], flag_list);
+  if (!tsl::Flags::Parse(&argc, argv, flag_list)) {
+    LOG(QFATAL) << usage;
+  }
+  if (node_id >= 0) {
+    xla::Status status = xla::RunNode(node_id, port);
+    if (!status.ok()) {
+      LOG(ERROR) << "Node " << node_id << " failed: " << status;
+      return 1;
+    }
+    return 0;
+  }
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
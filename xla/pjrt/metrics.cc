@@ -30,6 +30,31 @@ auto* pjrt_executable_execution_time_usecs = tsl::monitoring::Counter<0>::New(
     "The total time spent on PjRtExecutable::ExecuteHelper in "
     "microseconds.");
 
+auto* cpu_buffer_arena_hits = tsl::monitoring::Counter<0>::New(
+    "/jax/pjrt/cpu_buffer_arena_hits",
+    "The number of TfrtCpuExecutable executions whose temporary buffers were "
+    "served from a cached arena slab.");
+
+auto* cpu_buffer_arena_misses = tsl::monitoring::Counter<0>::New(
+    "/jax/pjrt/cpu_buffer_arena_misses",
+    "The number of TfrtCpuExecutable executions that had to allocate a new "
+    "arena slab for their temporary buffers.");
+
+auto* cpu_compilation_cache_hits = tsl::monitoring::Counter<0>::New(
+    "/jax/pjrt/cpu_compilation_cache_hits",
+    "The number of TfrtCpuClient compilations whose executable was found in "
+    "the persistent compilation cache.");
+
+auto* cpu_compilation_cache_misses = tsl::monitoring::Counter<0>::New(
+    "/jax/pjrt/cpu_compilation_cache_misses",
+    "The number of TfrtCpuClient compilations whose executable was not found "
+    "in the persistent compilation cache.");
+
+auto* cpu_compilation_cache_evictions = tsl::monitoring::Counter<0>::New(
+    "/jax/pjrt/cpu_compilation_cache_evictions",
+    "The number of entries evicted from the persistent CPU compilation "
+    "cache.");
+
 }  // namespace
 
 void ReportExecutableEnqueueTime(const uint64_t running_time_usecs) {
@@ -43,4 +68,33 @@ void ReportExecutableEnqueueTime(const uint64_t running_time_usecs) {
   }
 }
 
+void ReportCpuBufferArenaHit() {
+  static auto* cpu_buffer_arena_hits_cell = cpu_buffer_arena_hits->GetCell();
+  cpu_buffer_arena_hits_cell->IncrementBy(1);
+}
+
+void ReportCpuBufferArenaMiss() {
+  static auto* cpu_buffer_arena_misses_cell =
+      cpu_buffer_arena_misses->GetCell();
+  cpu_buffer_arena_misses_cell->IncrementBy(1);
+}
+
+void ReportCpuCompilationCacheHit() {
+  static auto* cpu_compilation_cache_hits_cell =
+      cpu_compilation_cache_hits->GetCell();
+  cpu_compilation_cache_hits_cell->IncrementBy(1);
+}
+
+void ReportCpuCompilationCacheMiss() {
+  static auto* cpu_compilation_cache_misses_cell =
+      cpu_compilation_cache_misses->GetCell();
+  cpu_compilation_cache_misses_cell->IncrementBy(1);
+}
+
+void ReportCpuCompilationCacheEviction() {
+  static auto* cpu_compilation_cache_evictions_cell =
+      cpu_compilation_cache_evictions->GetCell();
+  cpu_compilation_cache_evictions_cell->IncrementBy(1);
+}
+
 }  // namespace xla
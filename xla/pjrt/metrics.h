@@ -24,6 +24,16 @@ namespace xla {
 
 void ReportExecutableEnqueueTime(const uint64_t running_time_usecs);
 
+// Records whether a TfrtCpuExecutable found a cached temporary buffer slab in
+// its arena (a hit) or had to allocate a new one (a miss).
+void ReportCpuBufferArenaHit();
+void ReportCpuBufferArenaMiss();
+
+// Records lookups in, and evictions from, the persistent CPU compilation cache.
+void ReportCpuCompilationCacheHit();
+void ReportCpuCompilationCacheMiss();
+void ReportCpuCompilationCacheEviction();
+
 }
 
 #endif  // XLA_PJRT_METRICS_H_
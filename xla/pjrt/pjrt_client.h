@@ -683,6 +683,22 @@ class PjRtClient {
         platform_name());
   }
 
+  // Variant of BufferFromHostBuffer that converts the elements of `data`, of
+  // type `type`, to `device_type` as part of the transfer, e.g. f32 to bf16.
+  // The resulting buffer has element type `device_type`. Fusing the
+  // conversion into the transfer avoids a separate pass over the data.
+  virtual StatusOr<std::unique_ptr<PjRtBuffer>>
+  BufferFromHostBufferWithConversion(
+      const void* data, PrimitiveType type, PrimitiveType device_type,
+      absl::Span<int64_t const> dims,
+      std::optional<absl::Span<int64_t const>> byte_strides,
+      HostBufferSemantics host_buffer_semantics,
+      std::function<void()> on_done_with_host_buffer, PjRtDevice* device) {
+    return tsl::errors::Unimplemented(
+        "BufferFromHostBufferWithConversion is not implemented on platform: ",
+        platform_name());
+  }
+
   // Note that literal must remain in scope until the transfer has completed, so
   // the caller should, for example, wait for GetReadyFuture().Await()
   // completes on the return value before letting literal go out of scope.
@@ -258,6 +258,17 @@ class TfPjRtClient : public PjRtClient {
         data, type, dims, byte_strides, host_buffer_semantics,
         on_done_with_host_buffer, device, device_layout));
   }
+  StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostBufferWithConversion(
+      const void* data, PrimitiveType type, PrimitiveType device_type,
+      absl::Span<int64_t const> dims,
+      std::optional<absl::Span<int64_t const>> byte_strides,
+      HostBufferSemantics host_buffer_semantics,
+      std::function<void()> on_done_with_host_buffer,
+      PjRtDevice* device) override {
+    return WrapBuffer(wrapped_->BufferFromHostBufferWithConversion(
+        data, type, device_type, dims, byte_strides, host_buffer_semantics,
+        on_done_with_host_buffer, device));
+  }
   StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostLiteral(
       const LiteralSlice& literal, PjRtDevice* device) override {
     return WrapBuffer(wrapped_->BufferFromHostLiteral(literal, device));
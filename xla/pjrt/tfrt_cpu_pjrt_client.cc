@@ -17,12 +17,14 @@ limitations under the License.
 
 #include <algorithm>
 #include <cstring>
+#include <deque>
 #include <functional>
 #include <limits>
 #include <memory>
 #include <optional>
 #include <string>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "xla/literal_util.h"
@@ -32,8 +34,10 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include "absl/algorithm/container.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
@@ -41,6 +45,7 @@ limitations under the License.
 #include "xla/client/executable_build_options.h"
 #include "xla/client/xla_computation.h"
 #include "xla/literal.h"
+#include "xla/pjrt/cpu_buffer_arena.h"
 #include "xla/pjrt/mlir_to_hlo.h"
 #include "xla/pjrt/pjrt_client.h"
 #include "xla/pjrt/pjrt_future.h"
@@ -59,6 +64,8 @@ limitations under the License.
 #include "xla/statusor.h"
 #include "xla/xla_data.pb.h"
 #include "tsl/platform/denormal.h"
+#include "tsl/platform/file_system.h"
+#include "tsl/platform/fingerprint.h"
 #include "tsl/platform/setround.h"
 #include "tsl/profiler/lib/connected_traceme.h"
 #include "tfrt/host_context/async_value_ref.h"  // from @tf_runtime
@@ -125,11 +132,64 @@ static void EnqueueWorkWhenReady(
   });
 }
 
+// Executes `transpose` with its parallel work items spread over `pool`. The
+// calling thread runs every work item that no pool thread has picked up by the
+// time the last one is scheduled, so this never waits on queued work and is
+// safe to call from a thread of `pool`.
+static void ExecuteTransposeOnPool(const TransposePlan& transpose,
+                                   const void* a, void* b,
+                                   tsl::thread::ThreadPool* pool) {
+  if (transpose.Parallelism() <= 1) {
+    transpose.Execute(a, b);
+    return;
+  }
+  struct WorkQueue {
+    absl::Mutex mu;
+    std::deque<std::function<void()>> work ABSL_GUARDED_BY(mu);
+
+    bool RunOne() {
+      std::function<void()> fn;
+      {
+        absl::MutexLock lock(&mu);
+        if (work.empty()) return false;
+        fn = std::move(work.front());
+        work.pop_front();
+      }
+      fn();
+      return true;
+    }
+  };
+  auto queue = std::make_shared<WorkQueue>();
+  int num_scheduled = 0;
+  transpose.Execute(a, b, [&](std::function<void()> fn) {
+    {
+      absl::MutexLock lock(&queue->mu);
+      queue->work.push_back(std::move(fn));
+    }
+    if (++num_scheduled < transpose.Parallelism()) {
+      EnqueueWork(pool, [queue]() { queue->RunOne(); });
+    } else {
+      while (queue->RunOne()) {
+      }
+    }
+  });
+}
+
 TfrtCpuDevice::TfrtCpuDevice(int id, bool asynchronous)
+    : TfrtCpuDevice(id, /*process_index=*/0, /*local_hardware_id=*/id,
+                    asynchronous) {}
+
+TfrtCpuDevice::TfrtCpuDevice(int id, int process_index, int local_hardware_id,
+                             bool asynchronous)
     : id_(id),
+      process_index_(process_index),
+      local_hardware_id_(local_hardware_id),
       max_inflight_computations_semaphore_(/*capacity=*/asynchronous ? 32 : 1) {
   debug_string_ = absl::StrCat("TFRT_CPU_", id);
-  to_string_ = absl::StrCat("CpuDevice(id=", id, ")");
+  to_string_ = process_index == 0
+                   ? absl::StrCat("CpuDevice(id=", id, ")")
+                   : absl::StrCat("CpuDevice(id=", id,
+                                  ", process_index=", process_index, ")");
 }
 
 absl::string_view TfrtCpuDevice::device_kind() const {
@@ -141,11 +201,11 @@ absl::string_view TfrtCpuDevice::DebugString() const { return debug_string_; }
 absl::string_view TfrtCpuDevice::ToString() const { return to_string_; }
 
 Status TfrtCpuDevice::TransferToInfeed(const LiteralSlice& literal) {
-  return TransferLiteralToInfeedOnCpu(local_hardware_id(), literal);
+  return TransferLiteralToInfeedOnCpu(id(), literal);
 }
 
 Status TfrtCpuDevice::TransferFromOutfeed(MutableBorrowingLiteral literal) {
-  return TransferLiteralFromOutfeedOnCpu(local_hardware_id(), literal);
+  return TransferLiteralFromOutfeedOnCpu(id(), literal);
 }
 
 static int CpuDeviceCount() {
@@ -155,27 +215,60 @@ static int CpuDeviceCount() {
   return GetDebugOptionsFromFlags().xla_force_host_platform_device_count();
 }
 
+// Returns the devices of all `num_processes` processes.
 static StatusOr<std::vector<std::unique_ptr<TfrtCpuDevice>>> GetTfrtCpuDevices(
-    bool asynchronous, int cpu_device_count) {
+    bool asynchronous, int cpu_device_count, int num_processes) {
   std::vector<std::unique_ptr<TfrtCpuDevice>> devices;
-  for (int i = 0; i < cpu_device_count; ++i) {
-    auto device = std::make_unique<TfrtCpuDevice>(
-        /*id=*/i, asynchronous);
-    devices.push_back(std::move(device));
+  for (int process_index = 0; process_index < num_processes; ++process_index) {
+    for (int i = 0; i < cpu_device_count; ++i) {
+      auto device = std::make_unique<TfrtCpuDevice>(
+          /*id=*/process_index * cpu_device_count + i, process_index,
+          /*local_hardware_id=*/i, asynchronous);
+      devices.push_back(std::move(device));
+    }
   }
   return std::move(devices);
 }
 
 StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous,
                                                        int cpu_device_count) {
+  return GetTfrtCpuClient(asynchronous, cpu_device_count,
+                          /*compilation_cache=*/nullptr);
+}
+
+StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(
+    bool asynchronous, int cpu_device_count,
+    std::shared_ptr<CpuCompilationCache> compilation_cache) {
+  CpuClientOptions options;
+  options.asynchronous = asynchronous;
+  options.cpu_device_count = cpu_device_count;
+  options.compilation_cache = std::move(compilation_cache);
+  return GetTfrtCpuClient(options);
+}
+
+StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(
+    const CpuClientOptions& options) {
+  int cpu_device_count = options.cpu_device_count.value_or(CpuDeviceCount());
+  if (options.process_index < 0 ||
+      options.process_index >= options.num_processes) {
+    return InvalidArgument("Invalid process index %d of %d processes",
+                           options.process_index, options.num_processes);
+  }
+  if (options.num_processes > 1 && options.collectives == nullptr) {
+    return InvalidArgument(
+        "A CPU client of %d processes needs a CollectivesInterface",
+        options.num_processes);
+  }
   // Need at least CpuDeviceCount threads to launch one collective.
   size_t num_threads = std::max(DefaultThreadPoolSize(), cpu_device_count);
 
   TF_ASSIGN_OR_RETURN(std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
-                      GetTfrtCpuDevices(asynchronous, cpu_device_count));
+                      GetTfrtCpuDevices(options.asynchronous, cpu_device_count,
+                                        options.num_processes));
 
   return std::unique_ptr<PjRtClient>(std::make_unique<TfrtCpuClient>(
-      /*process_index=*/0, std::move(devices), num_threads));
+      options.process_index, std::move(devices), num_threads,
+      options.compilation_cache, options.collectives));
 }
 
 StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous) {
@@ -184,7 +277,8 @@ StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous) {
 
 TfrtCpuClient::TfrtCpuClient(
     int process_index, std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
-    size_t num_threads)
+    size_t num_threads, std::shared_ptr<CpuCompilationCache> compilation_cache,
+    std::shared_ptr<cpu::CollectivesInterface> collectives)
     : process_index_(process_index),
       owned_devices_(std::move(devices)),
       computation_placer_(std::make_unique<ComputationPlacer>()),
@@ -197,7 +291,10 @@ TfrtCpuClient::TfrtCpuClient(
                                       eigen_intraop_pool_->NumThreads())),
       last_collective_launch_event_(
           tfrt::MakeAvailableAsyncValueRef<CpuEvent>()),
-      transpose_cache_(1024) {
+      transpose_cache_(1024),
+      compilation_cache_(std::move(compilation_cache)),
+      collectives_(std::move(collectives)) {
+  cpu_executable_run_options_.set_collectives(collectives_.get());
   for (const std::unique_ptr<TfrtCpuDevice>& device : owned_devices_) {
     devices_.push_back(device.get());
     CHECK(id_to_device_.insert({device->id(), device.get()}).second)
@@ -253,7 +350,8 @@ StatusOr<std::unique_ptr<HloCostAnalysis>> TfrtCpuClient::GetHloCostAnalysis()
 
 StatusOr<std::optional<std::string>> TfrtCpuClient::ExecutableFingerprint(
     const PjRtLoadedExecutable& executable) const {
-  return std::optional<std::string>();
+  return tensorflow::down_cast<const TfrtCpuExecutable&>(executable)
+      .Fingerprint();
 }
 
 // Find the root instruction of the entry computation.
@@ -435,7 +533,7 @@ static StatusOr<std::unique_ptr<xla::Executable>> JitCompile(
     const XlaComputation& computation,
     const absl::Span<const Shape* const> argument_layouts,
     const ExecutableBuildOptions& build_options,
-    const ExecutionOptions& execution_options) {
+    const ExecutionOptions& execution_options, bool retain_object_files) {
   TF_ASSIGN_OR_RETURN(ProgramShape program_shape,
                       computation.GetProgramShape());
   // Unoptimized HloModuleConfig.
@@ -459,14 +557,16 @@ static StatusOr<std::unique_ptr<xla::Executable>> JitCompile(
   bool allow_sparse_shapes =
       hlo_module->config().debug_options().xla_cpu_use_xla_runtime();
   cpu::CpuCompiler compiler(allow_sparse_shapes);
-  xla::Compiler::CompileOptions dummy;
+  xla::Compiler::CompileOptions compile_options;
+  compile_options.retain_object_files = retain_object_files;
   TF_ASSIGN_OR_RETURN(hlo_module,
                       compiler.RunHloPasses(std::move(hlo_module),
-                                            /*stream_exec=*/nullptr, dummy));
+                                            /*stream_exec=*/nullptr,
+                                            compile_options));
 
   // Run backend.
   return compiler.RunBackend(std::move(hlo_module), /*stream_exec=*/nullptr,
-                             dummy);
+                             compile_options);
 }
 
 StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
@@ -475,6 +575,25 @@ StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
   auto input_options = options;
   ExecutableBuildOptions& build_options = options.executable_build_options;
 
+  std::string cache_key;
+  if (compilation_cache_ != nullptr) {
+    TF_ASSIGN_OR_RETURN(cache_key,
+                        compilation_cache_->ComputeKey(computation, options));
+    if (std::unique_ptr<tsl::ReadOnlyMemoryRegion> cached =
+            compilation_cache_->Lookup(cache_key)) {
+      StatusOr<std::unique_ptr<PjRtLoadedExecutable>> executable =
+          DeserializeExecutable(
+              absl::string_view(static_cast<const char*>(cached->data()),
+                                cached->length()),
+              input_options);
+      if (executable.ok()) return executable;
+      // E.g. an entry written for a different host; compile it again.
+      LOG(WARNING) << "Failed to load cached executable " << cache_key << ": "
+                   << executable.status();
+      compilation_cache_->Erase(cache_key);
+    }
+  }
+
   TF_RETURN_IF_ERROR(options.ApplyAllOptionOverrides());
 
   int num_replicas;
@@ -529,9 +648,12 @@ StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
                       computation.GetProgramShape());
   ExecutionOptions execution_options =
       CreateExecutionOptions(build_options, &program_shape);
+  // Only executables that go into the cache need to be serializable.
+  const bool retain_object_files = compilation_cache_ != nullptr;
   TF_ASSIGN_OR_RETURN(std::unique_ptr<Executable> cpu_executable,
                       JitCompile(computation, argument_layout_pointers,
-                                 build_options, execution_options));
+                                 build_options, execution_options,
+                                 retain_object_files));
   auto cpu_executable_ptr =
       tensorflow::down_cast<cpu::CpuExecutable*>(cpu_executable.get());
 
@@ -559,6 +681,18 @@ StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
   TF_RETURN_IF_ERROR(
       executable->SetUpDonation(options.parameter_is_tupled_arguments));
 
+  if (compilation_cache_ != nullptr) {
+    // Caching is best effort: failing to store an executable doesn't fail the
+    // compilation.
+    StatusOr<std::string> serialized = executable->SerializeExecutable();
+    Status status = serialized.ok()
+                        ? compilation_cache_->Insert(cache_key, *serialized)
+                        : serialized.status();
+    if (!status.ok()) {
+      VLOG(1) << "Failed to cache executable " << cache_key << ": " << status;
+    }
+  }
+
   return std::unique_ptr<PjRtLoadedExecutable>(std::move(executable));
 }
 
@@ -631,23 +765,60 @@ StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::CreateUninitializedBuffer(
       tensorflow::down_cast<TfrtCpuDevice*>(device), this);
 }
 
+// Returns the transformation that converts host elements of type `type` into
+// device elements of type `device_type` as part of a transpose.
+static StatusOr<TransposePlan::Transformation> HostToDeviceTransformation(
+    PrimitiveType type, PrimitiveType device_type) {
+  using Transformation = TransposePlan::Transformation;
+  if (type == device_type) {
+    return Transformation::kNone;
+  }
+  if (type == F32 && device_type == BF16) return Transformation::kF32ToBF16;
+  if (type == BF16 && device_type == F32) return Transformation::kBF16ToF32;
+  if (type == F32 && device_type == F16) return Transformation::kF32ToF16;
+  if (type == F16 && device_type == F32) return Transformation::kF16ToF32;
+  if (type == S64 && device_type == S32) return Transformation::kS64ToS32;
+  if (type == S32 && device_type == S64) return Transformation::kS32ToS64;
+  return Unimplemented(
+      "Conversion from %s to %s is not supported by BufferFromHostBuffer",
+      primitive_util::LowercasePrimitiveTypeName(type),
+      primitive_util::LowercasePrimitiveTypeName(device_type));
+}
+
 StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::BufferFromHostBuffer(
     const void* data, PrimitiveType type, absl::Span<int64_t const> dims,
     std::optional<absl::Span<int64_t const>> byte_strides,
     HostBufferSemantics host_buffer_semantics,
     std::function<void()> on_done_with_host_buffer, PjRtDevice* device) {
+  return BufferFromHostBufferWithConversion(
+      data, type, /*device_type=*/type, dims, byte_strides,
+      host_buffer_semantics, std::move(on_done_with_host_buffer), device);
+}
+
+StatusOr<std::unique_ptr<PjRtBuffer>>
+TfrtCpuClient::BufferFromHostBufferWithConversion(
+    const void* data, PrimitiveType type, PrimitiveType device_type,
+    absl::Span<int64_t const> dims,
+    std::optional<absl::Span<int64_t const>> byte_strides,
+    HostBufferSemantics host_buffer_semantics,
+    std::function<void()> on_done_with_host_buffer, PjRtDevice* device) {
   tsl::profiler::TraceMe traceme("TfrtCpuClient::BufferFromHostBuffer");
-  Shape shape = ShapeUtil::MakeShape(type, dims);
+  TF_ASSIGN_OR_RETURN(TransposePlan::Transformation transformation,
+                      HostToDeviceTransformation(type, device_type));
+  Shape shape = ShapeUtil::MakeShape(device_type, dims);
   VLOG(2) << "TfrtCpuClient::BufferFromHostBuffer: shape: " << shape.ToString()
+          << " host type: " << PrimitiveType_Name(type)
           << " device: " << device->DebugString();
   bool has_default_layout =
       !byte_strides || HasMajorToMinorLayout(type, dims, *byte_strides);
+  bool needs_conversion =
+      transformation != TransposePlan::Transformation::kNone;
   // If the input buffer has a default layout and is sufficiently aligned, we
   // can simply point to the input array's data without any further copies. At
   // the time of writing we require a 16-byte alignment because XLA may generate
   // code which requires it.
   bool can_use_zero_copy =
-      has_default_layout &&
+      has_default_layout && !needs_conversion &&
       host_buffer_semantics == HostBufferSemantics::kZeroCopy &&
       ((absl::bit_cast<std::uintptr_t>(data) &
         (cpu_function_runtime::MinAlign() - 1)) == 0);
@@ -665,26 +836,62 @@ StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::BufferFromHostBuffer(
                         MaybeOwningCpuMemory::AllocateShared(byte_size));
     auto dst_data_ptr = device_buffer->data();
     buffers.push_back(device_buffer);
-    if (!has_default_layout) {
+    if (!has_default_layout || needs_conversion) {
       // If the input array does not have a major-to-minor layout, transpose it
-      // into major-to-minor layout. Currently we choose to always do this
-      // synchronously.
-      // TODO(phawkins): consider performing the transpose asynchronously.
-      // TODO(phawkins): parallelize the transpose.
+      // into major-to-minor layout, in parallel on the client thread pool. Any
+      // element type conversion is fused into the transpose.
+      // Like the memcpy below, small transposes and those whose input must not
+      // be used after this call are performed synchronously.
       std::shared_ptr<TransposePlan> transpose;
       {
         absl::InlinedVector<int64_t, 4> permutation(dims.size());
         absl::c_iota(permutation, 0);
+        std::variant<TransposePlan::Tiling, TransposePlan::Striding>
+            input_layout = TransposePlan::Tiling{};
+        if (byte_strides) {
+          input_layout = TransposePlan::Striding{*byte_strides};
+        }
         absl::MutexLock lock(&transpose_mu_);
         TF_ASSIGN_OR_RETURN(
-            transpose, transpose_cache_.GetOrCreate(
-                           primitive_util::ByteWidth(type), dims, permutation,
-                           TransposePlan::Striding{*byte_strides}));
+            transpose,
+            transpose_cache_.GetOrCreate(
+                primitive_util::ByteWidth(type), dims, permutation,
+                input_layout, /*output_tiling=*/TransposePlan::Tiling{},
+                transformation,
+                /*num_threads=*/pjrt_client_thread_pool()->NumThreads()));
       }
-      transpose->Execute(data, dst_data_ptr);
-      if (on_done_with_host_buffer) {
-        on_done_with_host_buffer();
-        on_done_with_host_buffer = nullptr;
+      bool should_sync_transpose =
+          host_buffer_semantics ==
+              HostBufferSemantics::kImmutableOnlyDuringCall ||
+          (byte_size < kSmallDataTransferByteSize);
+      if (should_sync_transpose) {
+        ExecuteTransposeOnPool(*transpose, data, dst_data_ptr,
+                               pjrt_client_thread_pool());
+        if (on_done_with_host_buffer) {
+          on_done_with_host_buffer();
+          on_done_with_host_buffer = nullptr;
+        }
+      } else {
+        tfrt::AsyncValueRef<CpuEvent> copy_event =
+            tfrt::MakeConstructedAsyncValueRef<CpuEvent>();
+        definition_events.push_back(copy_event.CopyRef());
+        EnqueueWork(pjrt_client_thread_pool(),
+                    [pool = pjrt_client_thread_pool(),
+                     transpose = std::move(transpose),
+                     device_buffer = std::move(device_buffer), dst_data_ptr,
+                     data, copy_event = std::move(copy_event),
+                     on_done_with_host_buffer =
+                         std::move(on_done_with_host_buffer)]() mutable {
+                      tsl::profiler::TraceMe traceme("H2D Transpose");
+                      ExecuteTransposeOnPool(*transpose, data, dst_data_ptr,
+                                             pool);
+                      if (on_done_with_host_buffer) {
+                        on_done_with_host_buffer();
+                        on_done_with_host_buffer = nullptr;
+                      }
+                      // Signal copy is complete.
+                      copy_event.SetStateConcrete();
+                    });
       }
     } else {
       bool should_sync_copy =
@@ -1313,6 +1520,34 @@ TfrtCpuExecutable::TfrtCpuExecutable(
   // context switch time (~5us).
   cheap_computation_ = hlo_cost_analysis->flop_count() < 1000;
 
+  // Lay out all temporary buffer allocations back to back so that a single
+  // arena slab can back all of them for one execution.
+  const BufferAssignment& assignment =
+      tensorflow::down_cast<cpu::CpuExecutable*>(cpu_executable_.get())
+          ->buffer_assignment();
+  temp_buffer_offsets_.assign(assignment.Allocations().size(), -1);
+  size_t temp_buffer_bytes = 0;
+  for (const BufferAllocation& allocation : assignment.Allocations()) {
+    if (allocation.is_entry_computation_parameter() ||
+        allocation.is_constant() || allocation.is_thread_local() ||
+        allocation.maybe_live_out() ||
+        allocation.index() == result_buffer_index_ ||
+        absl::c_linear_search(result_buffer_indices_, allocation.index())) {
+      continue;
+    }
+    temp_buffer_offsets_[allocation.index()] = temp_buffer_bytes;
+    temp_buffer_bytes += RoundUpTo<size_t>(allocation.size(),
+                                           cpu_function_runtime::Align());
+  }
+  if (temp_buffer_bytes > 0) {
+    // Keep enough free slabs around for every addressable device to have one
+    // execution running and one being set up.
+    int max_free_slabs =
+        2 * std::max<int>(1, static_cast<int>(addressable_devices_.size()));
+    temp_buffer_arena_ = CpuBufferArena::Create(
+        temp_buffer_bytes, cpu_function_runtime::Align(), max_free_slabs);
+  }
+
   const auto& computation_layout =
       cpu_executable_->module().entry_computation_layout();
   if (computation_layout.parameter_count() == 0) {
@@ -1343,7 +1578,13 @@ void TfrtCpuExecutable::Delete() {}
 bool TfrtCpuExecutable::IsDeleted() { return false; }
 
 StatusOr<std::optional<std::string>> TfrtCpuExecutable::Fingerprint() const {
-  return std::optional<std::string>();
+  // Instruction ids change when a module is serialized and deserialized, so
+  // fingerprint the text of the module rather than its proto.
+  tsl::Fprint128 fingerprint = tsl::Fingerprint128(
+      cpu_executable_->module().ToString(HloPrintOptions::ModuleFingerprint()));
+  return std::optional<std::string>(
+      absl::StrCat(absl::Hex(fingerprint.high64, absl::kZeroPad16),
+                   absl::Hex(fingerprint.low64, absl::kZeroPad16)));
 }
 
 Status TfrtCpuExecutable::SetUpDonation(bool tuple_inputs) {
@@ -1394,15 +1635,27 @@ static StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> MemoryForAllocation(
   return out;
 }
 
+// Temporary allocations with a non-negative entry in `temp_buffer_offsets` are
+// carved out of `temp_slab` instead of being allocated individually.
 static StatusOr<std::vector<std::shared_ptr<MaybeOwningCpuMemory>>>
 CreateBufferTable(
     const BufferAssignment& assignment,
-    absl::Span<std::pair<bool, TrackedTfrtCpuDeviceBuffer*> const> arguments) {
+    absl::Span<std::pair<bool, TrackedTfrtCpuDeviceBuffer*> const> arguments,
+    absl::Span<const int64_t> temp_buffer_offsets,
+    const CpuBufferArena::Slab& temp_slab) {
   std::vector<std::shared_ptr<MaybeOwningCpuMemory>> buffers(
       assignment.Allocations().size());
   for (BufferAllocation::Index i = 0; i < assignment.Allocations().size();
        ++i) {
     const BufferAllocation& allocation = assignment.GetAllocation(i);
+    if (temp_slab.data() != nullptr && temp_buffer_offsets[i] >= 0) {
+      void* data = temp_slab.data() + temp_buffer_offsets[i];
+      // See MemoryForAllocation: the JITed code initializes temporaries.
+      ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(data, allocation.size());
+      buffers[i] =
+          std::make_shared<MaybeOwningCpuMemory>(data, allocation.size());
+      continue;
+    }
     TF_ASSIGN_OR_RETURN(buffers[i], MemoryForAllocation(allocation, arguments));
   }
   return std::move(buffers);
@@ -1593,9 +1846,16 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
 
   auto* cpu_executable =
       tensorflow::down_cast<cpu::CpuExecutable*>(cpu_executable_.get());
+  // The slab backs all temporaries in `buffer_table` and must outlive the
+  // execution; it returns to the arena once the execution is done.
+  CpuBufferArena::Slab temp_slab;
+  if (temp_buffer_arena_ != nullptr) {
+    TF_ASSIGN_OR_RETURN(temp_slab, temp_buffer_arena_->Acquire());
+  }
   TF_ASSIGN_OR_RETURN(
       std::vector<std::shared_ptr<MaybeOwningCpuMemory>> buffer_table,
-      CreateBufferTable(cpu_executable->buffer_assignment(), tracked_buffers));
+      CreateBufferTable(cpu_executable->buffer_assignment(), tracked_buffers,
+                        temp_buffer_offsets_, temp_slab));
   auto result_buffers =
       CreateResultShapedBuffer(result_buffer_indices_, buffer_table);
 
@@ -1617,10 +1877,12 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
 
   ExecutableRunOptions run_options;
   run_options.set_run_id(run_id);
-  run_options.set_device_ordinal(device->local_hardware_id());
+  run_options.set_device_ordinal(device->id());
   // Need to keep device_assignment alive until execution completes.
   run_options.set_device_assignment(device_assignment.get());
   run_options.set_intra_op_thread_pool(client_->eigen_intraop_device());
+  run_options.set_cpu_executable_run_options(
+      client_->cpu_executable_run_options());
 
   // Schedule only one collective at a time.
   bool is_a_collective_launch = !!last_collective_launch_event;
@@ -1687,6 +1949,7 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
         [cpu_executable, result_buffer,
          buffer_pointers = std::move(buffer_pointers),
          buffer_table = std::move(buffer_table),
+         temp_slab = std::move(temp_slab),
          run_options = std::move(run_options),
          cpu_executable_copy = cpu_executable_,
          device_assignment = std::move(device_assignment),
@@ -1864,10 +2127,17 @@ TfrtCpuExecutable::Execute(
     // Dump once before running, in case there's a crash.
     MaybeDumpHloSnapshot(cpu_executable_->module(), run_id, argument_handles[0],
                          {});
-    auto statusor = ExecuteHelper(
-        argument_handles[0], replica, partition, run_id, options,
-        /*last_collective_launch_event=*/tfrt::AsyncValueRef<CpuEvent>(),
-        returned_futures.has_value());
+    // Collectives with other processes run over connections that carry one
+    // collective at a time, so they are gang scheduled like the collectives
+    // between the devices of this process below.
+    tfrt::AsyncValueRef<CpuEvent> last_collective_launch_event;
+    if (client_->cpu_executable_run_options()->collectives() != nullptr) {
+      last_collective_launch_event = client_->GetLastCollectiveLaunchEvent();
+    }
+    auto statusor = ExecuteHelper(argument_handles[0], replica, partition,
+                                  run_id, options,
+                                  std::move(last_collective_launch_event),
+                                  returned_futures.has_value());
 
     if (!statusor.ok()) {
       return std::move(statusor).status();
@@ -29,6 +29,8 @@ limitations under the License.
 #include "xla/client/xla_computation.h"
 #include "xla/layout.h"
 #include "xla/literal.h"
+#include "xla/pjrt/cpu_buffer_arena.h"
+#include "xla/pjrt/cpu_compilation_cache.h"
 #include "xla/pjrt/pjrt_client.h"
 #include "xla/pjrt/pjrt_executable.h"
 #include "xla/pjrt/pjrt_future.h"
@@ -39,8 +41,10 @@ limitations under the License.
 #include "xla/runtime/cpu_event.h"
 #include "xla/service/buffer_assignment.h"
 #include "xla/service/computation_placer.h"
+#include "xla/service/cpu/collectives_interface.h"
 #include "xla/service/cpu/cpu_compiler.h"
 #include "xla/service/cpu/cpu_executable.h"
+#include "xla/service/cpu/cpu_executable_run_options.h"
 #include "xla/service/executable.h"
 #include "xla/service/hlo.pb.h"
 #include "xla/service/hlo_cost_analysis.h"
@@ -56,6 +60,11 @@ class TfrtCpuDevice final : public PjRtDevice {
  public:
   TfrtCpuDevice(int id, bool asynchronous);
 
+  // A device of process `process_index`, where it is the device with
+  // `local_hardware_id`. `id` is unique across all processes.
+  TfrtCpuDevice(int id, int process_index, int local_hardware_id,
+                bool asynchronous);
+
   void SetClient(PjRtClient* client) {
     CHECK(client_ == nullptr);
     client_ = client;
@@ -69,10 +78,11 @@ class TfrtCpuDevice final : public PjRtDevice {
 
   int id() const override { return id_; }
 
-  int process_index() const override { return 0; }
+  // `id` is used as `device_ordinal`, so that collectives can identify
+  // devices across processes.
+  int process_index() const override { return process_index_; }
 
-  // Used as `device_ordinal`.
-  int local_hardware_id() const override { return id_; }
+  int local_hardware_id() const override { return local_hardware_id_; }
 
   absl::string_view device_kind() const override;
 
@@ -101,6 +111,8 @@ class TfrtCpuDevice final : public PjRtDevice {
 
  private:
   int id_;
+  int process_index_;
+  int local_hardware_id_;
   PjRtClient* client_ = nullptr;
   std::string debug_string_;
   std::string to_string_;
@@ -116,9 +128,18 @@ class TfrtCpuExecutable;
 
 class TfrtCpuClient final : public PjRtClient {
  public:
-  TfrtCpuClient(int process_index,
-                std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
-                size_t num_threads);
+  // If `compilation_cache` is not null, Compile looks executables up in it
+  // before compiling them, and stores the ones it compiles. Without a cache,
+  // executables compiled by the default (non XLA Runtime) pipeline don't keep
+  // the object code that SerializeExecutable needs. If `collectives` is not
+  // null, executables run their collectives through it, which lets them
+  // communicate with the devices of other processes; `devices` must then
+  // include the devices of all processes.
+  TfrtCpuClient(
+      int process_index, std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
+      size_t num_threads,
+      std::shared_ptr<CpuCompilationCache> compilation_cache = nullptr,
+      std::shared_ptr<cpu::CollectivesInterface> collectives = nullptr);
   ~TfrtCpuClient() override;
 
   int process_index() const override { return process_index_; }
@@ -187,6 +208,16 @@ class TfrtCpuClient final : public PjRtClient {
       std::function<void()> on_done_with_host_buffer,
       PjRtDevice* device) override;
 
+  // Supports conversions between f32 and bf16 or f16, and between s64 and s32,
+  // which are fused into the relayout of the host buffer.
+  StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostBufferWithConversion(
+      const void* data, PrimitiveType type, PrimitiveType device_type,
+      absl::Span<int64_t const> dims,
+      std::optional<absl::Span<int64_t const>> byte_strides,
+      HostBufferSemantics host_buffer_semantics,
+      std::function<void()> on_done_with_host_buffer,
+      PjRtDevice* device) override;
+
   StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostLiteral(
       const LiteralSlice& literal, PjRtDevice* device) override;
 
@@ -231,6 +262,14 @@ class TfrtCpuClient final : public PjRtClient {
     return eigen_intraop_device_.get();
   }
 
+  CpuCompilationCache* compilation_cache() const {
+    return compilation_cache_.get();
+  }
+
+  const cpu::CpuExecutableRunOptions* cpu_executable_run_options() const {
+    return &cpu_executable_run_options_;
+  }
+
   tfrt::AsyncValueRef<runtime::CpuEvent> GetLastCollectiveLaunchEvent() {
     absl::MutexLock lock(&mu_);
     return last_collective_launch_event_.CopyRef();
@@ -280,6 +319,13 @@ class TfrtCpuClient final : public PjRtClient {
   // major-to-minor layout.
   absl::Mutex transpose_mu_;
   TransposePlanCache transpose_cache_ ABSL_GUARDED_BY(transpose_mu_);
+
+  // Persistent cache of compiled executables. May be null.
+  std::shared_ptr<CpuCompilationCache> compilation_cache_;
+
+  // Collectives across processes. May be null.
+  std::shared_ptr<cpu::CollectivesInterface> collectives_;
+  cpu::CpuExecutableRunOptions cpu_executable_run_options_;
 };
 
 class TfrtCpuBuffer final : public PjRtBuffer {
@@ -555,6 +601,9 @@ class TfrtCpuExecutable final : public PjRtLoadedExecutable {
 
   bool IsReturnedFutureSupported() const override { return true; }
 
+  // Fingerprints the optimized HLO module, so that executables compiled from
+  // the same computation and options, or deserialized from the same
+  // executable, have the same fingerprint.
   StatusOr<std::optional<std::string>> Fingerprint() const;
 
   std::shared_ptr<Executable> cpu_executable() const { return cpu_executable_; }
@@ -618,6 +667,17 @@ class TfrtCpuExecutable final : public PjRtLoadedExecutable {
   // Cached result of comparing HloCostAnalysis FLOP estimate for execute
   // critical path.
   bool cheap_computation_;
+
+  // Offset of each temporary buffer allocation inside a slab of
+  // `temp_buffer_arena_`, indexed by allocation index, or -1 if the allocation
+  // is not a temporary (parameters, constants, thread-local and live-out
+  // allocations are handled individually).
+  std::vector<int64_t> temp_buffer_offsets_;
+
+  // Arena from which each execution leases one slab holding all of its
+  // temporaries. Null if the executable has no temporaries. Shared with
+  // in-flight executions, which may outlive the executable.
+  std::shared_ptr<CpuBufferArena> temp_buffer_arena_;
 };
 
 // Creates a CPU client with one Device. For testing purposes, you can set the
@@ -630,6 +690,36 @@ StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous);
 StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous,
                                                        int cpu_device_count);
 
+// Similar to the function above, but executables are cached in
+// `compilation_cache`, which can be shared with other clients.
+StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(
+    bool asynchronous, int cpu_device_count,
+    std::shared_ptr<CpuCompilationCache> compilation_cache);
+
+struct CpuClientOptions {
+  bool asynchronous = true;
+
+  // The number of devices of each process. If not set, it is read from the
+  // --xla_force_host_platform_device_count flag.
+  std::optional<int> cpu_device_count;
+
+  // See TfrtCpuClient.
+  std::shared_ptr<CpuCompilationCache> compilation_cache;
+
+  // The processes of a multi-process client all have `cpu_device_count`
+  // devices. Device `i` of process `p` has the id p * cpu_device_count + i.
+  int process_index = 0;
+  int num_processes = 1;
+
+  // Runs the collectives between the devices of different processes; required
+  // if `num_processes` > 1. See cpu_tcp_collectives.h.
+  std::shared_ptr<cpu::CollectivesInterface> collectives;
+};
+
+// Creates a CPU client that may be one of several processes of a job.
+StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(
+    const CpuClientOptions& options);
+
 }  // namespace xla
 
 #endif  // XLA_PJRT_TFRT_CPU_PJRT_CLIENT_H_
@@ -15,17 +15,25 @@ limitations under the License.
 
 #include "xla/pjrt/tfrt_cpu_pjrt_client.h"
 
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/synchronization/notification.h"
+#include "xla/array2d.h"
 #include "xla/literal_util.h"
+#include "xla/pjrt/cpu_compilation_cache.h"
 #include "xla/service/custom_call_status.h"
 #include "xla/service/custom_call_target_registry.h"
 #include "xla/service/hlo_parser.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/file_system.h"
+#include "tsl/platform/path.h"
 #include "tsl/platform/test.h"
 
 namespace xla {
@@ -143,5 +151,155 @@ TEST(TfrtCpuClientTest, HloSnapshot) {
       LiteralUtil::CreateR2<float>({{11.0, 22.0}, {33.0, 44.0}, {55.0, 66.0}}));
 }
 
+TEST(TfrtCpuClientTest, CompilationCacheReusesExecutables) {
+  constexpr char kProgram[] = R"(
+    HloModule sum_rows
+    add {
+      a = f32[] parameter(0)
+      b = f32[] parameter(1)
+      ROOT sum = f32[] add(a, b)
+    }
+    ENTRY sum_rows {
+      x = f32[3,2] parameter(0)
+      zero = f32[] constant(0)
+      ROOT r = f32[3] reduce(x, zero), dimensions={1}, to_apply=add
+    })";
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  const std::string dir =
+      tsl::io::JoinPath(tsl::testing::TmpDir(), "compilation_cache");
+  int64_t undeleted_files, undeleted_dirs;
+  tsl::Env::Default()
+      ->DeleteRecursively(dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+
+  // Each client gets its own cache object, as if it ran in its own process.
+  auto compile_and_run = [&](std::shared_ptr<CpuCompilationCache> cache,
+                             std::string* fingerprint) -> Literal {
+    auto client = GetTfrtCpuClient(/*asynchronous=*/true,
+                                   /*cpu_device_count=*/1, std::move(cache));
+    CHECK_OK(client.status());
+    auto executable = (*client)->Compile(xla_computation, {});
+    CHECK_OK(executable.status());
+    auto executable_fingerprint =
+        (*client)->ExecutableFingerprint(**executable);
+    CHECK_OK(executable_fingerprint.status());
+    *fingerprint = executable_fingerprint->value();
+
+    std::vector<float> data{1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+    Shape shape = ShapeUtil::MakeShape(F32, {3, 2});
+    auto buffer = (*client)->BufferFromHostBuffer(
+        data.data(), shape.element_type(), shape.dimensions(),
+        /*byte_strides=*/std::nullopt,
+        PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+        (*client)->addressable_devices()[0]);
+    CHECK_OK(buffer.status());
+    auto result = (*executable)->Execute({{buffer->get()}}, /*options=*/{});
+    CHECK_OK(result.status());
+    auto literal = (*result)[0][0]->ToLiteralSync();
+    CHECK_OK(literal.status());
+    return std::move(**literal);
+  };
+
+  TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<CpuCompilationCache> first_cache,
+                          CpuCompilationCache::Create({dir}));
+  std::string first_fingerprint;
+  Literal first = compile_and_run(first_cache, &first_fingerprint);
+  EXPECT_EQ(first_cache->hits(), 0);
+  EXPECT_EQ(first_cache->misses(), 1);
+  EXPECT_GT(first_cache->size_bytes(), 0);
+
+  TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<CpuCompilationCache> second_cache,
+                          CpuCompilationCache::Create({dir}));
+  std::string second_fingerprint;
+  Literal second = compile_and_run(second_cache, &second_fingerprint);
+  EXPECT_EQ(second_cache->hits(), 1);
+  EXPECT_EQ(second_cache->misses(), 0);
+
+  EXPECT_EQ(first, LiteralUtil::CreateR1<float>({3.0, 7.0, 11.0}));
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(second_fingerprint, first_fingerprint);
+}
+
+TEST(TfrtCpuClientTest, BufferFromColumnMajorHostBuffer) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  // Large enough for the transpose to run asynchronously and in parallel.
+  constexpr int64_t kRows = 500;
+  constexpr int64_t kCols = 300;
+  std::vector<float> data(kRows * kCols);
+  for (int64_t i = 0; i < kRows * kCols; ++i) data[i] = i;
+  Array2D<float> expected(kRows, kCols);
+  expected.Each([&](int64_t row, int64_t col, float* value) {
+    *value = data[row + col * kRows];
+  });
+  std::vector<int64_t> byte_strides = {sizeof(float), kRows * sizeof(float)};
+
+  for (auto semantics :
+       {PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+        PjRtClient::HostBufferSemantics::kImmutableUntilTransferCompletes}) {
+    absl::Notification done_with_host_buffer;
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto buffer,
+        client->BufferFromHostBuffer(
+            data.data(), F32, {kRows, kCols}, byte_strides, semantics,
+            [&]() { done_with_host_buffer.Notify(); },
+            client->addressable_devices()[0]));
+    TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Literal> literal,
+                            buffer->ToLiteralSync());
+    EXPECT_EQ(*literal, LiteralUtil::CreateR2FromArray2D(expected));
+    done_with_host_buffer.WaitForNotification();
+  }
+}
+
+TEST(TfrtCpuClientTest, BufferFromHostBufferWithConversion) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  constexpr int64_t kRows = 500;
+  constexpr int64_t kCols = 300;
+  std::vector<float> data(kRows * kCols);
+  for (int64_t i = 0; i < kRows * kCols; ++i) data[i] = i * 0.25f;
+  Array2D<bfloat16> expected(kRows, kCols);
+  Array2D<bfloat16> expected_column_major(kRows, kCols);
+  expected.Each([&](int64_t row, int64_t col, bfloat16* value) {
+    *value = static_cast<bfloat16>(data[row * kCols + col]);
+  });
+  expected_column_major.Each([&](int64_t row, int64_t col, bfloat16* value) {
+    *value = static_cast<bfloat16>(data[row + col * kRows]);
+  });
+  std::vector<int64_t> column_major_byte_strides = {sizeof(float),
+                                                    kRows * sizeof(float)};
+
+  for (auto semantics :
+       {PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+        PjRtClient::HostBufferSemantics::kImmutableUntilTransferCompletes}) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto buffer, client->BufferFromHostBufferWithConversion(
+                         data.data(), F32, BF16, {kRows, kCols},
+                         /*byte_strides=*/std::nullopt, semantics, nullptr,
+                         client->addressable_devices()[0]));
+    EXPECT_EQ(buffer->on_device_shape().element_type(), BF16);
+    TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Literal> literal,
+                            buffer->ToLiteralSync());
+    EXPECT_EQ(*literal, LiteralUtil::CreateR2FromArray2D(expected));
+
+    TF_ASSERT_OK_AND_ASSIGN(
+        buffer, client->BufferFromHostBufferWithConversion(
+                    data.data(), F32, BF16, {kRows, kCols},
+                    column_major_byte_strides, semantics, nullptr,
+                    client->addressable_devices()[0]));
+    TF_ASSERT_OK_AND_ASSIGN(literal, buffer->ToLiteralSync());
+    EXPECT_EQ(*literal,
+              LiteralUtil::CreateR2FromArray2D(expected_column_major));
+  }
+
+  EXPECT_FALSE(client
+                   ->BufferFromHostBufferWithConversion(
+                       data.data(), F32, S32, {kRows, kCols},
+                       /*byte_strides=*/std::nullopt,
+                       PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+                       nullptr, client->addressable_devices()[0])
+                   .ok());
+}
+
 }  // namespace
 }  // namespace xla
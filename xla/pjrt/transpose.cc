@@ -70,8 +70,11 @@ limitations under the License.
 #include "xla/pjrt/transpose.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <numeric>
+#include <optional>
 #include <stack>
 #include <string>
 #include <utility>
@@ -82,10 +85,12 @@ limitations under the License.
 #include "absl/synchronization/blocking_counter.h"
 #include "absl/types/span.h"
 #include "absl/types/variant.h"
+#include "Eigen/Core"  // from @eigen_archive
 #include "xla/permutation_util.h"
 #include "xla/pjrt/transpose_kernels.h"
 #include "xla/status.h"
 #include "xla/util.h"
+#include "tsl/platform/cpu_info.h"
 #include "tsl/platform/logging.h"
 #include "tsl/profiler/lib/traceme.h"
 
@@ -124,8 +129,103 @@ void ConvertF64ToEf57(const double* input, float* output, int n) {
   }
 }
 
+// Element type conversions. `In` and `Out` are unsigned integer types of the
+// width of the source and destination types; elements are moved as bits.
+template <TransposePlan::Transformation transformation>
+struct ElementConversion;
+
+template <>
+struct ElementConversion<TransposePlan::Transformation::kF32ToBF16> {
+  using In = uint32_t;
+  using Out = uint16_t;
+  static Out Convert(In x) {
+    // NaNs are quieted rather than rounded, which could make them infinities.
+    // Written without branches so that loops over it vectorize.
+    In rounded = (x + 0x7fffu + ((x >> 16) & 1u)) >> 16;
+    In quiet_nan = (x >> 16) | 0x40u;
+    return static_cast<Out>((x & 0x7fffffffu) > 0x7f800000u ? quiet_nan
+                                                             : rounded);
+  }
+};
+
+template <>
+struct ElementConversion<TransposePlan::Transformation::kBF16ToF32> {
+  using In = uint16_t;
+  using Out = uint32_t;
+  static Out Convert(In x) { return static_cast<Out>(x) << 16; }
+};
+
+template <>
+struct ElementConversion<TransposePlan::Transformation::kF32ToF16> {
+  using In = uint32_t;
+  using Out = uint16_t;
+  static Out Convert(In x) {
+    return Eigen::numext::bit_cast<Out>(
+        static_cast<Eigen::half>(Eigen::numext::bit_cast<float>(x)));
+  }
+};
+
+template <>
+struct ElementConversion<TransposePlan::Transformation::kF16ToF32> {
+  using In = uint16_t;
+  using Out = uint32_t;
+  static Out Convert(In x) {
+    return Eigen::numext::bit_cast<Out>(
+        static_cast<float>(Eigen::numext::bit_cast<Eigen::half>(x)));
+  }
+};
+
+template <>
+struct ElementConversion<TransposePlan::Transformation::kS64ToS32> {
+  using In = uint64_t;
+  using Out = uint32_t;
+  static Out Convert(In x) { return static_cast<Out>(x); }
+};
+
+template <>
+struct ElementConversion<TransposePlan::Transformation::kS32ToS64> {
+  using In = uint32_t;
+  using Out = uint64_t;
+  static Out Convert(In x) {
+    return static_cast<Out>(static_cast<int64_t>(static_cast<int32_t>(x)));
+  }
+};
+
+// Converts `n` contiguous elements. Neither pointer need be aligned.
+template <TransposePlan::Transformation transformation>
+inline void ConvertElements(const char* __restrict input,
+                            char* __restrict output, int64_t n) {
+  using Conversion = ElementConversion<transformation>;
+  using In = typename Conversion::In;
+  using Out = typename Conversion::Out;
+  for (int64_t i = 0; i < n; ++i) {
+    In x;
+    std::memcpy(&x, input + i * sizeof(In), sizeof(In));
+    Out y = Conversion::Convert(x);
+    std::memcpy(output + i * sizeof(Out), &y, sizeof(Out));
+  }
+}
+
+constexpr bool IsElementConversion(
+    TransposePlan::Transformation transformation) {
+  return transformation != TransposePlan::Transformation::kNone &&
+         transformation != TransposePlan::Transformation::kF64ToEf57;
+}
+
+// Copies `n` contiguous elements of type T, converting them from the input
+// type first if `transformation` is an element conversion.
+template <typename T, TransposePlan::Transformation transformation>
+void CopyStride1(const char* __restrict a, char* __restrict b, int64_t n) {
+  if constexpr (IsElementConversion(transformation)) {
+    ConvertElements<transformation>(a, b, n);
+  } else {
+    std::memcpy(b, a, n * sizeof(T));
+  }
+}
+
 template <typename T, int inner_bs,
-          TransposePlan::Transformation transformation>
+          TransposePlan::Transformation transformation,
+          TransposePlan::Isa isa>
 void MacroKernel(const char* __restrict a, int64_t lda, int outer_bs_a,
                  char* __restrict b, int64_t ldb, int outer_bs_b,
                  void* __restrict scratch) {
@@ -146,10 +246,50 @@ void MacroKernel(const char* __restrict a, int64_t lda, int outer_bs_a,
     a = reinterpret_cast<const char*>(scratch);
     lda = outer_bs_a * inner_bs * sizeof(float);
   }
+  if constexpr (IsElementConversion(transformation)) {
+    // The microkernels operate on T, the wider of the input and output types.
+    // A widening conversion is applied to the input block before it is
+    // transposed and a narrowing one to the transposed block, in scratch. The
+    // conversions are applied to microkernel-sized pieces, whose constant
+    // length lets the compiler unroll and vectorize them.
+    using In = typename ElementConversion<transformation>::In;
+    using Out = typename ElementConversion<transformation>::Out;
+    char* p = reinterpret_cast<char*>(scratch);
+    if constexpr (sizeof(Out) > sizeof(In)) {
+      const int64_t row_bytes = outer_bs_a * inner_bs * sizeof(T);
+      for (int i = 0; i < outer_bs_b * inner_bs; ++i) {
+        for (int j = 0; j < outer_bs_a; ++j) {
+          ConvertElements<transformation>(
+              a + lda * i + j * inner_bs * sizeof(In),
+              p + row_bytes * i + j * inner_bs * sizeof(T), inner_bs);
+        }
+      }
+      a = p;
+      lda = row_bytes;
+    } else {
+      const int64_t row_bytes = outer_bs_b * inner_bs * sizeof(T);
+      for (int i = 0; i < outer_bs_a; ++i) {
+        for (int j = 0; j < outer_bs_b; ++j) {
+          TransposeMicroKernel<T, inner_bs, isa>::Apply(
+              a + inner_bs * j * lda + i * inner_bs * sizeof(T), lda,
+              p + inner_bs * i * row_bytes + j * inner_bs * sizeof(T),
+              row_bytes);
+        }
+      }
+      for (int i = 0; i < outer_bs_a * inner_bs; ++i) {
+        for (int j = 0; j < outer_bs_b; ++j) {
+          ConvertElements<transformation>(
+              p + row_bytes * i + j * inner_bs * sizeof(T),
+              b + ldb * i + j * inner_bs * sizeof(Out), inner_bs);
+        }
+      }
+      return;
+    }
+  }
 
   for (int i = 0; i < outer_bs_a; ++i) {
     for (int j = 0; j < outer_bs_b; ++j) {
-      TransposeMicroKernel<T, inner_bs>::Apply(
+      TransposeMicroKernel<T, inner_bs, isa>::Apply(
           a + inner_bs * j * lda + i * inner_bs * sizeof(T), lda,
           b + inner_bs * i * ldb + j * inner_bs * sizeof(T), ldb);
     }
@@ -159,7 +299,8 @@ void MacroKernel(const char* __restrict a, int64_t lda, int outer_bs_a,
 // Transpose() is a driver function that implements a multidimensional loop nest
 // following by iterating over the linked Node data structure.
 template <typename T, int inner_bs,
-          TransposePlan::Transformation transformation>
+          TransposePlan::Transformation transformation,
+          TransposePlan::Isa isa>
 void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
                int outer_bs_b, TransposePlan::Node const* __restrict node,
                void* __restrict scratch) {
@@ -181,9 +322,9 @@ void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
     const int64_t ldb_block = next_node->ldb;
     int64_t i;
     for (i = start; i < stop; i += inc) {
-      MacroKernel<T, inner_bs, transformation>(a + i * lda, lda_block,
-                                               outer_bs_a, b + i * ldb,
-                                               ldb_block, outer_bs_b, scratch);
+      MacroKernel<T, inner_bs, transformation, isa>(
+          a + i * lda, lda_block, outer_bs_a, b + i * ldb, ldb_block,
+          outer_bs_b, scratch);
     }
     // Handle trailing elements that didn't fit in a complete macrokernel.
     // Only the innermost dimensions have non-trivial outer_bs blocking.
@@ -193,7 +334,7 @@ void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
       if (node->is_inner_dim_in_a) {
         outer_bs_a = (end - i) / inner_bs;
         if (outer_bs_a > 0) {
-          MacroKernel<T, inner_bs, transformation>(
+          MacroKernel<T, inner_bs, transformation, isa>(
               a + i * lda, lda_block, outer_bs_a, b + i * ldb, ldb_block,
               outer_bs_b, scratch);
           i += outer_bs_a * inner_bs;
@@ -201,22 +342,22 @@ void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
         // If there are still trailing elements left over that don't fit in the
         // inner block size, handle them via an unvectorized transpose.
         if (i < end) {
-          MacroKernel<T, 1, transformation>(a + i * lda, lda_block, end - i,
-                                            b + i * ldb, ldb_block,
-                                            outer_bs_b * inner_bs, scratch);
+          MacroKernel<T, 1, transformation, isa>(
+              a + i * lda, lda_block, end - i, b + i * ldb, ldb_block,
+              outer_bs_b * inner_bs, scratch);
         }
       } else if (node->is_inner_dim_in_b) {
         outer_bs_b = (end - i) / inner_bs;
         if (outer_bs_b > 0) {
-          MacroKernel<T, inner_bs, transformation>(
+          MacroKernel<T, inner_bs, transformation, isa>(
               a + i * lda, lda_block, outer_bs_a, b + i * ldb, ldb_block,
               outer_bs_b, scratch);
           i += outer_bs_b * inner_bs;
         }
         if (i < end) {
-          MacroKernel<T, 1, transformation>(a + i * lda, lda_block,
-                                            outer_bs_a * inner_bs, b + i * ldb,
-                                            ldb_block, end - i, scratch);
+          MacroKernel<T, 1, transformation, isa>(
+              a + i * lda, lda_block, outer_bs_a * inner_bs, b + i * ldb,
+              ldb_block, end - i, scratch);
         }
       }
     } else if (node->trailing_tile_next_node_inc) {
@@ -230,13 +371,13 @@ void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
       if (trailing_next_node->inc < 0) {
         const int64_t lda_block = trailing_next_node->lda;
         const int64_t ldb_block = trailing_next_node->ldb;
-        MacroKernel<T, inner_bs, transformation>(
+        MacroKernel<T, inner_bs, transformation, isa>(
             a + i * lda, lda_block, outer_bs_a, b + i * ldb, ldb_block,
             outer_bs_b, scratch);
       } else {
-        Transpose<T, inner_bs, transformation>(a + i * lda, outer_bs_a,
-                                               b + i * ldb, outer_bs_b,
-                                               trailing_next_node, scratch);
+        Transpose<T, inner_bs, transformation, isa>(
+            a + i * lda, outer_bs_a, b + i * ldb, outer_bs_b,
+            trailing_next_node, scratch);
       }
     }
   } else {
@@ -245,7 +386,7 @@ void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
     // but we call Transpose() recursively instead of MacroKernel().
     int64_t i;
     for (i = start; i < stop; i += inc) {
-      Transpose<T, inner_bs, transformation>(
+      Transpose<T, inner_bs, transformation, isa>(
           a + i * lda, outer_bs_a, b + i * ldb, outer_bs_b, next_node, scratch);
     }
     if (i < end) {
@@ -254,28 +395,28 @@ void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
       if (node->is_inner_dim_in_a) {
         outer_bs_a = (end - i) / inner_bs;
         if (outer_bs_a > 0) {
-          Transpose<T, inner_bs, transformation>(a + i * lda, outer_bs_a,
-                                                 b + i * ldb, outer_bs_b,
-                                                 next_node, scratch);
+          Transpose<T, inner_bs, transformation, isa>(a + i * lda, outer_bs_a,
+                                                      b + i * ldb, outer_bs_b,
+                                                      next_node, scratch);
           i += outer_bs_a * inner_bs;
         }
         if (i < end) {
-          Transpose<T, 1, transformation>(a + i * lda, end - i, b + i * ldb,
-                                          outer_bs_b * inner_bs, next_node,
-                                          scratch);
+          Transpose<T, 1, transformation, isa>(
+              a + i * lda, end - i, b + i * ldb, outer_bs_b * inner_bs,
+              next_node, scratch);
         }
       } else if (node->is_inner_dim_in_b) {
         outer_bs_b = (end - i) / inner_bs;
         if (outer_bs_b > 0) {
-          Transpose<T, inner_bs, transformation>(a + i * lda, outer_bs_a,
-                                                 b + i * ldb, outer_bs_b,
-                                                 next_node, scratch);
+          Transpose<T, inner_bs, transformation, isa>(a + i * lda, outer_bs_a,
+                                                      b + i * ldb, outer_bs_b,
+                                                      next_node, scratch);
           i += outer_bs_b * inner_bs;
         }
         if (i < end) {
-          Transpose<T, 1, transformation>(a + i * lda, outer_bs_a * inner_bs,
-                                          b + i * ldb, end - i, next_node,
-                                          scratch);
+          Transpose<T, 1, transformation, isa>(
+              a + i * lda, outer_bs_a * inner_bs, b + i * ldb, end - i,
+              next_node, scratch);
         }
       }
     } else if (node->trailing_tile_next_node_inc) {
@@ -284,43 +425,43 @@ void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
       if (trailing_next_node->inc < 0) {
         const int64_t lda_block = trailing_next_node->lda;
         const int64_t ldb_block = trailing_next_node->ldb;
-        MacroKernel<T, inner_bs, transformation>(
+        MacroKernel<T, inner_bs, transformation, isa>(
             a + i * lda, lda_block, outer_bs_a, b + i * ldb, ldb_block,
             outer_bs_b, scratch);
       } else {
-        Transpose<T, inner_bs, transformation>(a + i * lda, outer_bs_a,
-                                               b + i * ldb, outer_bs_b,
-                                               trailing_next_node, scratch);
+        Transpose<T, inner_bs, transformation, isa>(
+            a + i * lda, outer_bs_a, b + i * ldb, outer_bs_b,
+            trailing_next_node, scratch);
       }
     }
   }
 }
 
-template <typename T>
+template <typename T, TransposePlan::Transformation transformation>
 void TransposeConstStride1(const char* __restrict a, char* __restrict b,
                            TransposePlan::Node const* __restrict node) {
   a += node[0].start * node[0].lda;
   b += node[0].start * node[0].ldb;
   if (node[0].is_inner_dim_in_a) {
-    int64_t num_bytes = (node->end - node->start) * sizeof(T);
-    std::memcpy(b, a, num_bytes);
+    CopyStride1<T, transformation>(a, b, node->end - node->start);
   } else if (node[1].is_inner_dim_in_a) {
     int64_t offset_a = node[1].start * node[1].lda;
     int64_t offset_b = node[1].start * node[1].ldb;
-    int64_t num_bytes = (node[1].end - node[1].start) * sizeof(T);
+    int64_t num_elems = node[1].end - node[1].start;
     a += offset_a;
     b += offset_b;
     for (int64_t i = node[0].start; i < node[0].end; ++i) {
-      std::memcpy(b, a, num_bytes);
+      CopyStride1<T, transformation>(a, b, num_elems);
       a += node[0].lda;
       b += node[0].ldb;
     }
     if (node[0].trailing_tile_next_node_inc) {
-      TransposeConstStride1<T>(a - offset_a, b - offset_b,
-                               node + node[0].trailing_tile_next_node_inc);
+      TransposeConstStride1<T, transformation>(
+          a - offset_a, b - offset_b,
+          node + node[0].trailing_tile_next_node_inc);
     }
   } else if (node[2].is_inner_dim_in_a) {
-    int64_t num_bytes = (node[2].end - node[2].start) * sizeof(T);
+    int64_t num_elems = node[2].end - node[2].start;
     int64_t offset_a1 = node[1].start * node[1].lda;
     int64_t offset_b1 = node[1].start * node[1].ldb;
     int64_t offset_a2 = node[2].start * node[2].lda;
@@ -331,12 +472,12 @@ void TransposeConstStride1(const char* __restrict a, char* __restrict b,
       const char* a1 = a;
       char* b1 = b;
       for (int64_t j = node[1].start; j < node[1].end; ++j) {
-        std::memcpy(b1, a1, num_bytes);
+        CopyStride1<T, transformation>(a1, b1, num_elems);
         a1 += node[1].lda;
         b1 += node[1].ldb;
       }
       if (node[1].trailing_tile_next_node_inc) {
-        TransposeConstStride1<T>(
+        TransposeConstStride1<T, transformation>(
             a1 - offset_a2, b1 - offset_b2,
             &node[1] + node[1].trailing_tile_next_node_inc);
       }
@@ -344,39 +485,91 @@ void TransposeConstStride1(const char* __restrict a, char* __restrict b,
       b += node[0].ldb;
     }
     if (node[0].trailing_tile_next_node_inc) {
-      TransposeConstStride1<T>(a - offset_a1 - offset_a2,
-                               b - offset_b1 - offset_b2,
-                               node + node[0].trailing_tile_next_node_inc);
+      TransposeConstStride1<T, transformation>(
+          a - offset_a1 - offset_a2, b - offset_b1 - offset_b2,
+          node + node[0].trailing_tile_next_node_inc);
     }
   } else {
     for (int64_t i = node[0].start; i < node[0].end; ++i) {
       const char* a1 = a + node[1].start * node[1].lda;
       char* b1 = b + node[1].start * node[1].ldb;
       for (int64_t j = node[1].start; j < node[1].end; ++j) {
-        TransposeConstStride1<T>(a1, b1, node + 2);
+        TransposeConstStride1<T, transformation>(a1, b1, node + 2);
         a1 += node[1].lda;
         b1 += node[1].ldb;
       }
       if (node[1].trailing_tile_next_node_inc) {
-        TransposeConstStride1<T>(
+        TransposeConstStride1<T, transformation>(
             a1, b1, &node[1] + node[1].trailing_tile_next_node_inc);
       }
       a += node[0].lda;
       b += node[0].ldb;
     }
     if (node[0].trailing_tile_next_node_inc) {
-      TransposeConstStride1<T>(a, b,
-                               node + node[0].trailing_tile_next_node_inc);
+      TransposeConstStride1<T, transformation>(
+          a, b, node + node[0].trailing_tile_next_node_inc);
     }
   }
 }
 
+// Runs the blocked transpose with the microkernels of `isa`. Instruction sets
+// without a microkernel of their own for T and inner_bs share the instantiation
+// of the instruction set whose microkernel they would use.
+template <typename T, int inner_bs,
+          TransposePlan::Transformation transformation,
+          TransposePlan::Isa isa>
+void TransposeBlocks(const char* a, int outer_bs_a, char* b, int outer_bs_b,
+                     absl::Span<TransposePlan::Node const> nodes,
+                     void* scratch) {
+  constexpr TransposePlan::Isa kernel_isa =
+      TransposeMicroKernel<T, inner_bs, isa>::kIsa;
+  if constexpr (kernel_isa != isa) {
+    TransposeBlocks<T, inner_bs, transformation, kernel_isa>(
+        a, outer_bs_a, b, outer_bs_b, nodes, scratch);
+  } else if (nodes.size() > 1) {
+    Transpose<T, inner_bs, transformation, isa>(a, outer_bs_a, b, outer_bs_b,
+                                                nodes.data(), scratch);
+  } else {
+    MacroKernel<T, inner_bs, transformation, isa>(
+        a, nodes.back().lda, outer_bs_a, b, nodes.back().ldb, outer_bs_b,
+        scratch);
+  }
+}
+
+template <typename T, int inner_bs,
+          TransposePlan::Transformation transformation>
+void TransposeBlocksForIsa(TransposePlan::Isa isa, const char* a,
+                           int outer_bs_a, char* b, int outer_bs_b,
+                           absl::Span<TransposePlan::Node const> nodes,
+                           void* scratch) {
+  switch (isa) {
+    case TransposePlan::Isa::kGeneric:
+      TransposeBlocks<T, inner_bs, transformation,
+                      TransposePlan::Isa::kGeneric>(a, outer_bs_a, b,
+                                                    outer_bs_b, nodes, scratch);
+      break;
+    case TransposePlan::Isa::kSse4:
+      TransposeBlocks<T, inner_bs, transformation, TransposePlan::Isa::kSse4>(
+          a, outer_bs_a, b, outer_bs_b, nodes, scratch);
+      break;
+    case TransposePlan::Isa::kAvx2:
+      TransposeBlocks<T, inner_bs, transformation, TransposePlan::Isa::kAvx2>(
+          a, outer_bs_a, b, outer_bs_b, nodes, scratch);
+      break;
+    case TransposePlan::Isa::kAvx512:
+      TransposeBlocks<T, inner_bs, transformation,
+                      TransposePlan::Isa::kAvx512>(a, outer_bs_a, b,
+                                                   outer_bs_b, nodes, scratch);
+      break;
+  }
+}
+
 template <typename T, TransposePlan::Transformation transformation>
 void TransposePlan::ExecuteTyped(const char* a, char* b,
                                  absl::Span<Node const> nodes) const {
   if (inner_kernel_is_memcpy_) {
-    DCHECK(transformation_ == Transformation::kNone);
-    TransposeConstStride1<T>(a, b, nodes.data());
+    DCHECK(transformation_ != Transformation::kF64ToEf57);
+    TransposeConstStride1<T, transformation>(a, b, nodes.data());
   } else {
     std::unique_ptr<char[]> scratch;
     if (scratch_size_ > 0) {
@@ -384,60 +577,29 @@ void TransposePlan::ExecuteTyped(const char* a, char* b,
     }
     switch (inner_block_elems_) {
       case 1:
-        if (nodes.size() > 1) {
-          Transpose<T, 1, transformation>(a, outer_block_elems_a_, b,
-                                          outer_block_elems_b_, nodes.data(),
-                                          scratch.get());
-        } else {
-          MacroKernel<T, 1, transformation>(
-              a, nodes.back().lda, outer_block_elems_a_, b, nodes.back().ldb,
-              outer_block_elems_b_, scratch.get());
-        }
+        TransposeBlocksForIsa<T, 1, transformation>(
+            isa_, a, outer_block_elems_a_, b, outer_block_elems_b_, nodes,
+            scratch.get());
         break;
       case 2:
-        if (nodes.size() > 1) {
-          Transpose<T, 2, transformation>(a, outer_block_elems_a_, b,
-                                          outer_block_elems_b_, nodes.data(),
-                                          scratch.get());
-        } else {
-          MacroKernel<T, 2, transformation>(
-              a, nodes.back().lda, outer_block_elems_a_, b, nodes.back().ldb,
-              outer_block_elems_b_, scratch.get());
-        }
+        TransposeBlocksForIsa<T, 2, transformation>(
+            isa_, a, outer_block_elems_a_, b, outer_block_elems_b_, nodes,
+            scratch.get());
         break;
       case 4:
-
-        if (nodes.size() > 1) {
-          Transpose<T, 4, transformation>(a, outer_block_elems_a_, b,
-                                          outer_block_elems_b_, nodes.data(),
-                                          scratch.get());
-        } else {
-          MacroKernel<T, 4, transformation>(
-              a, nodes.back().lda, outer_block_elems_a_, b, nodes.back().ldb,
-              outer_block_elems_b_, scratch.get());
-        }
+        TransposeBlocksForIsa<T, 4, transformation>(
+            isa_, a, outer_block_elems_a_, b, outer_block_elems_b_, nodes,
+            scratch.get());
         break;
       case 8:
-        if (nodes.size() > 1) {
-          Transpose<T, 8, transformation>(a, outer_block_elems_a_, b,
-                                          outer_block_elems_b_, nodes.data(),
-                                          scratch.get());
-        } else {
-          MacroKernel<T, 8, transformation>(
-              a, nodes.back().lda, outer_block_elems_a_, b, nodes.back().ldb,
-              outer_block_elems_b_, scratch.get());
-        }
+        TransposeBlocksForIsa<T, 8, transformation>(
+            isa_, a, outer_block_elems_a_, b, outer_block_elems_b_, nodes,
+            scratch.get());
         break;
       case 16:
-        if (nodes.size() > 1) {
-          Transpose<T, 16, transformation>(a, outer_block_elems_a_, b,
-                                           outer_block_elems_b_, nodes.data(),
-                                           scratch.get());
-        } else {
-          MacroKernel<T, 16, transformation>(
-              a, nodes.back().lda, outer_block_elems_a_, b, nodes.back().ldb,
-              outer_block_elems_b_, scratch.get());
-        }
+        TransposeBlocksForIsa<T, 16, transformation>(
+            isa_, a, outer_block_elems_a_, b, outer_block_elems_b_, nodes,
+            scratch.get());
         break;
       default:
         LOG(FATAL) << "Invalid inner_block_size " << inner_block_elems_;
@@ -487,10 +649,36 @@ void TransposePlan::Execute(
         LOG(FATAL) << "Unimplemented element size " << elem_size_in_bytes_;
     }
   };
+  // Element conversions are dispatched on the wider of the input and output
+  // types.
+  auto execute = [&](absl::Span<Node const> nodes) {
+    switch (transformation_) {
+      case Transformation::kF32ToBF16:
+        ExecuteTyped<uint32_t, Transformation::kF32ToBF16>(ac, bc, nodes);
+        break;
+      case Transformation::kBF16ToF32:
+        ExecuteTyped<uint32_t, Transformation::kBF16ToF32>(ac, bc, nodes);
+        break;
+      case Transformation::kF32ToF16:
+        ExecuteTyped<uint32_t, Transformation::kF32ToF16>(ac, bc, nodes);
+        break;
+      case Transformation::kF16ToF32:
+        ExecuteTyped<uint32_t, Transformation::kF16ToF32>(ac, bc, nodes);
+        break;
+      case Transformation::kS64ToS32:
+        ExecuteTyped<uint64_t, Transformation::kS64ToS32>(ac, bc, nodes);
+        break;
+      case Transformation::kS32ToS64:
+        ExecuteTyped<uint64_t, Transformation::kS32ToS64>(ac, bc, nodes);
+        break;
+      default:
+        execute_by_type(nodes);
+    }
+  };
 
   if (!schedule_work || nodes_.size() <= 1) {
     for (const auto& nodes : nodes_) {
-      execute_by_type(nodes);
+      execute(nodes);
     }
   } else {
     absl::BlockingCounter counter(nodes_.size());
@@ -498,7 +686,7 @@ void TransposePlan::Execute(
       schedule_work([&, nodes]() {
         tsl::profiler::TraceMe traceme("Transpose::Execute",
                                        /*level=*/2);
-        execute_by_type(nodes);
+        execute(nodes);
         counter.DecrementCount();
       });
     }
@@ -877,11 +1065,65 @@ void TransposePlan::BuildPlanNodes(
   }
 }
 
+static const char* TransformationToString(
+    TransposePlan::Transformation transformation) {
+  switch (transformation) {
+    case TransposePlan::Transformation::kNone:
+      return "none";
+    case TransposePlan::Transformation::kF64ToEf57:
+      return "ef57";
+    case TransposePlan::Transformation::kF32ToBF16:
+      return "f32_to_bf16";
+    case TransposePlan::Transformation::kBF16ToF32:
+      return "bf16_to_f32";
+    case TransposePlan::Transformation::kF32ToF16:
+      return "f32_to_f16";
+    case TransposePlan::Transformation::kF16ToF32:
+      return "f16_to_f32";
+    case TransposePlan::Transformation::kS64ToS32:
+      return "s64_to_s32";
+    case TransposePlan::Transformation::kS32ToS64:
+      return "s32_to_s64";
+  }
+  return "unknown";
+}
+
+/*static*/ TransposePlan::Isa TransposePlan::SupportedIsa() {
+#ifdef XLA_TRANSPOSE_X86_KERNELS
+  using tsl::port::CPUFeature;
+  if (tsl::port::TestCPUFeature(CPUFeature::AVX512F)) {
+    return Isa::kAvx512;
+  }
+  if (tsl::port::TestCPUFeature(CPUFeature::AVX2)) {
+    return Isa::kAvx2;
+  }
+  if (tsl::port::TestCPUFeature(CPUFeature::SSSE3) &&
+      tsl::port::TestCPUFeature(CPUFeature::SSE4_1)) {
+    return Isa::kSse4;
+  }
+#endif  // XLA_TRANSPOSE_X86_KERNELS
+  return Isa::kGeneric;
+}
+
+/*static*/ std::string TransposePlan::IsaToString(Isa isa) {
+  switch (isa) {
+    case Isa::kGeneric:
+      return "generic";
+    case Isa::kSse4:
+      return "sse4";
+    case Isa::kAvx2:
+      return "avx2";
+    case Isa::kAvx512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
 StatusOr<std::unique_ptr<TransposePlan>> TransposePlan::Create(
     size_t elem_size_in_bytes, absl::Span<int64_t const> dims,
     absl::Span<int64_t const> permutation,
     std::variant<Tiling, Striding> input_layout, Tiling output_tiling,
-    Transformation transformation, int num_threads) {
+    Transformation transformation, int num_threads, std::optional<Isa> isa) {
   auto is_negative = [](int d) { return d < 0; };
   if (absl::c_find_if(dims, is_negative) != dims.end()) {
     return InvalidArgument("dims must be non-negative, got %s",
@@ -901,10 +1143,16 @@ StatusOr<std::unique_ptr<TransposePlan>> TransposePlan::Create(
                            num_threads);
   }
 
+  if (isa && *isa > SupportedIsa()) {
+    return InvalidArgument("Transpose kernels for %s are not supported on %s",
+                           IsaToString(*isa), IsaToString(SupportedIsa()));
+  }
+
   int ndim = dims.size();
 
   auto plan = std::make_unique<TransposePlan>();
   plan->num_threads_requested_ = num_threads;
+  plan->isa_ = isa.value_or(SupportedIsa());
   plan->elem_size_in_bytes_ = elem_size_in_bytes;
   switch (elem_size_in_bytes) {
     case 1:
@@ -1002,9 +1250,35 @@ StatusOr<std::unique_ptr<TransposePlan>> TransposePlan::Create(
   }
 
   plan->transformation_ = transformation;
+  plan->output_elem_size_in_bytes_ = elem_size_in_bytes;
+  auto check_conversion = [&](size_t input_size,
+                              size_t output_size) -> Status {
+    if (elem_size_in_bytes != input_size) {
+      return InvalidArgument(
+          "Transformation %s requires an element size of %d bytes, got %d",
+          TransformationToString(transformation), input_size,
+          elem_size_in_bytes);
+    }
+    plan->output_elem_size_in_bytes_ = output_size;
+    return OkStatus();
+  };
   switch (transformation) {
     case Transformation::kNone:
       break;
+    case Transformation::kF32ToBF16:
+    case Transformation::kF32ToF16:
+      TF_RETURN_IF_ERROR(check_conversion(4, 2));
+      break;
+    case Transformation::kBF16ToF32:
+    case Transformation::kF16ToF32:
+      TF_RETURN_IF_ERROR(check_conversion(2, 4));
+      break;
+    case Transformation::kS64ToS32:
+      TF_RETURN_IF_ERROR(check_conversion(8, 4));
+      break;
+    case Transformation::kS32ToS64:
+      TF_RETURN_IF_ERROR(check_conversion(4, 8));
+      break;
     case Transformation::kF64ToEf57:
       if (elem_size_in_bytes != sizeof(float)) {
         return InvalidArgument(
@@ -1062,7 +1336,8 @@ void TransposePlan::Initialize() {
     ++ndim;
   }
   b_dims_ = Permute(a_dims_, permutation_);
-  ComputeStrides(elem_size_in_bytes_, b_dims_, b_tiling_, ldb_, ldb_tile_);
+  ComputeStrides(output_elem_size_in_bytes_, b_dims_, b_tiling_, ldb_,
+                 ldb_tile_);
 
   const int pos_stride1a = ndim - 1;
   const int pos_stride1b_in_a = permutation_.back();
@@ -1094,6 +1369,10 @@ void TransposePlan::Initialize() {
     b_stride1_size = std::min(b_stride1_size, b_dims_.back());
   }
 
+  // The transpose kernels operate on the wider of the input and output
+  // element types; see MacroKernel.
+  const int64_t kernel_elem_size_in_bytes =
+      std::max(elem_size_in_bytes_, output_elem_size_in_bytes_);
   if (inner_kernel_is_memcpy_) {
     inner_block_elems_ = -1;
     outer_block_elems_a_ = -1;
@@ -1103,29 +1382,32 @@ void TransposePlan::Initialize() {
     // vectorized kernel for this element size?
     int min_inner_block_elems;
     int max_inner_block_elems;
-    switch (elem_size_in_bytes_) {
+    // The SSE kernels are limited to 128-bit rows, and the 256-bit ones need
+    // AVX2; see transpose_kernels.h.
+    switch (kernel_elem_size_in_bytes) {
       case 1:
         min_inner_block_elems = 4;
         max_inner_block_elems = 16;
         break;
       case 2:
         min_inner_block_elems = 8;
-        max_inner_block_elems = 8;
+        max_inner_block_elems = isa_ >= Isa::kAvx2 ? 16 : 8;
         break;
       case 4:
         min_inner_block_elems = 4;
-        max_inner_block_elems = 8;
+        max_inner_block_elems = isa_ == Isa::kSse4 ? 4 : 8;
         break;
       case 8:
         min_inner_block_elems = 2;
-        max_inner_block_elems = 4;
+        max_inner_block_elems = isa_ == Isa::kSse4 ? 2 : 4;
         break;
       case 16:
         min_inner_block_elems = 1;
         max_inner_block_elems = 1;
         break;
       default:
-        LOG(FATAL) << "Unreachable: element size " << elem_size_in_bytes_;
+        LOG(FATAL) << "Unreachable: element size "
+                   << kernel_elem_size_in_bytes;
     }
     inner_block_elems_ = max_inner_block_elems;
     while (inner_block_elems_ > std::min(a_stride1_size, b_stride1_size)) {
@@ -1205,6 +1487,16 @@ void TransposePlan::Initialize() {
                       outer_block_elems_a_ * outer_block_elems_b_;
       DCHECK(!inner_kernel_is_memcpy_);
       break;
+    default:
+      // Element conversions need no scratch if the memcpy kernel converts
+      // directly into the output.
+      scratch_size_ =
+          inner_kernel_is_memcpy_
+              ? 0
+              : kernel_elem_size_in_bytes * inner_block_elems_ *
+                    inner_block_elems_ * outer_block_elems_a_ *
+                    outer_block_elems_b_;
+      break;
   }
 }
 
@@ -1298,22 +1590,14 @@ std::string TransposePlan::ToString() const {
     return absl::StrAppend(out, loop.dim_in_a,
                            loop.tile_interior ? "[tile]" : "");
   };
-  std::string transformation_str;
-  switch (transformation_) {
-    case Transformation::kNone:
-      transformation_str = "none";
-      break;
-    case Transformation::kF64ToEf57:
-      transformation_str = "ef57";
-      break;
-  }
   return absl::StrFormat(
-      "elem_size=%d a_dims=%s b_dims=%s permutation=%s a_tiling=%s b_tiling=%s "
-      "lda=%s lda_tile=%s ldb=%s ldb_tile=%s loop_order=%s "
-      "loop_parallelism=%s outer_bs=[%d,%d] inner_bs=%d "
-      "transformation=%s scratch_size=%d\n"
+      "elem_size=%d output_elem_size=%d a_dims=%s b_dims=%s permutation=%s "
+      "a_tiling=%s b_tiling=%s lda=%s lda_tile=%s ldb=%s ldb_tile=%s "
+      "loop_order=%s loop_parallelism=%s outer_bs=[%d,%d] inner_bs=%d "
+      "isa=%s transformation=%s scratch_size=%d\n"
       "nodes:\n%s",
-      elem_size_in_bytes_, absl::StrJoin(a_dims_, ","),
+      elem_size_in_bytes_, output_elem_size_in_bytes_,
+      absl::StrJoin(a_dims_, ","),
       absl::StrJoin(Permute(a_dims_, permutation_), ","),
       absl::StrJoin(permutation_, ","), absl::StrJoin(a_tiling_, ","),
       absl::StrJoin(b_tiling_, ","), absl::StrJoin(lda_, ","),
@@ -1321,8 +1605,8 @@ std::string TransposePlan::ToString() const {
       absl::StrJoin(ldb_tile_, ","),
       absl::StrJoin(loop_order_, ",", format_loop_order),
       absl::StrJoin(loop_parallelism_, ","), outer_block_elems_a_,
-      outer_block_elems_b_, inner_block_elems_, transformation_str,
-      scratch_size_, nodes_str);
+      outer_block_elems_b_, inner_block_elems_, IsaToString(isa_),
+      TransformationToString(transformation_), scratch_size_, nodes_str);
 }
 
 struct TransposePlanCacheKey {
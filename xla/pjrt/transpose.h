@@ -29,6 +29,7 @@ limitations under the License.
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -41,7 +42,7 @@ namespace xla {
 
 class TransposePlan {
  public:
-  // elem_size_in_bytes: size of each element in bytes.
+  // elem_size_in_bytes: size of each input element in bytes.
   // dims: the input shape, in elements.
   // permutation: for each output dimension, gives the number of the
   //   corresponding input dimension. Must be a permutation of [0..dims.size())
@@ -70,6 +71,9 @@ class TransposePlan {
   //
   // num_threads: is the number of threads requested. The actual number of
   //   threads used may be smaller if there isn't enough work per thread.
+  //
+  // isa: the instruction set of the transpose kernels. Defaults to the most
+  //   capable one the host supports; mostly useful for tests and benchmarks.
   struct Tiling {
     absl::Span<int64_t const> tiling;
   };
@@ -83,15 +87,45 @@ class TransposePlan {
     // Convert doubles into the ef57 extended precision pair-of-floats
     // representation used on TPU.
     kF64ToEf57 = 1,
+
+    // Convert the element type. The input elements have the source type and
+    // `elem_size_in_bytes` must be its size; the output elements have the
+    // destination type. Floating-point narrowing rounds to nearest even and
+    // integer narrowing truncates, as XLA's convert does.
+    kF32ToBF16 = 2,
+    kBF16ToF32 = 3,
+    kF32ToF16 = 4,
+    kF16ToF32 = 5,
+    kS64ToS32 = 6,
+    kS32ToS64 = 7,
+  };
+
+  // Instruction sets for which there are vectorized transpose kernels, from
+  // least to most capable. The kernels are selected at runtime, irrespective of
+  // the instruction set XLA was compiled for.
+  enum class Isa {
+    // Portable C++ kernels.
+    kGeneric = 0,
+    // x86 SSE4.1 (and SSSE3).
+    kSse4 = 1,
+    // x86 AVX2.
+    kAvx2 = 2,
+    // x86 AVX-512F.
+    kAvx512 = 3,
   };
 
+  // Returns the most capable instruction set supported by the host.
+  static Isa SupportedIsa();
+
+  static std::string IsaToString(Isa isa);
+
   static StatusOr<std::unique_ptr<TransposePlan>> Create(
       size_t elem_size_in_bytes, absl::Span<int64_t const> dims,
       absl::Span<int64_t const> permutation,
       std::variant<Tiling, Striding> input_layout = Tiling{},
       Tiling output_tiling = Tiling{},
       Transformation transformation = Transformation::kNone,
-      int num_threads = 1);
+      int num_threads = 1, std::optional<Isa> isa = std::nullopt);
 
   TransposePlan();
   ~TransposePlan();
@@ -109,6 +143,10 @@ class TransposePlan {
   std::string ToString() const;
 
   size_t ElemSizeInBytes() const { return elem_size_in_bytes_; }
+  Isa KernelIsa() const { return isa_; }
+  // Differs from ElemSizeInBytes() if the transformation converts the element
+  // type.
+  size_t OutputElemSizeInBytes() const { return output_elem_size_in_bytes_; }
 
   // Input and output size, in number of elements. Ignores any input striding,
   // but accounts for tiling.
@@ -165,8 +203,13 @@ class TransposePlan {
   // Number of threads requested.
   int num_threads_requested_ = 1;
 
-  // Size of each element in bytes.
+  // Instruction set of the microkernels.
+  Isa isa_ = Isa::kGeneric;
+
+  // Size of each input and output element in bytes. They differ if the
+  // transformation converts the element type.
   int64_t elem_size_in_bytes_;
+  int64_t output_elem_size_in_bytes_;
 
   // Number of elements in the input array.
   int64_t num_elems_;
@@ -227,10 +270,10 @@ class TransposePlan {
   int outer_block_elems_a_ = 4;
   int outer_block_elems_b_ = 4;
 
-  // Transformations to apply to the input before transposition.
-  // Currently the only supported transformation is EF57 conversion, which is
-  // a pair-of-floats extended precision representation used on TPU. We
-  // support fusing transformations with the transpose for two reasons:
+  // Transformations to apply to the input before transposition: either EF57
+  // conversion, which is a pair-of-floats extended precision representation
+  // used on TPU, or an element type conversion. We support fusing
+  // transformations with the transpose for two reasons:
   // (a) it makes sense to fuse cheap computations with a memory-bandwidth
   //     bound transformation, and
   // (b) it allows us to support non-trivial striding.
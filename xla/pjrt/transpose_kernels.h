@@ -18,22 +18,57 @@ limitations under the License.
 
 #include <cstdint>
 
-#include "Eigen/Core"  // from @eigen_archive
+#include "xla/pjrt/transpose.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define XLA_TRANSPOSE_X86_KERNELS 1
+#endif
+
+// Compiles a function for the given instruction set, regardless of the
+// instruction set the rest of the binary targets. The function must only be
+// called if the CPU supports the instruction set. MSVC allows intrinsics to be
+// used anywhere, so it needs no annotation.
+#if defined(__GNUC__) || defined(__clang__)
+#define XLA_TRANSPOSE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define XLA_TRANSPOSE_TARGET(isa)
+#endif
 
 namespace xla {
 
-// Generic transpose kernel.
-//
-// All of the kernels that follow in this file are optimized versions of this
-// generic kernel, specialized to particular block sizes and data types.
+// Returns the instruction set preceding `isa`, whose kernels `isa` falls back
+// to.
+constexpr TransposePlan::Isa PreviousIsa(TransposePlan::Isa isa) {
+  return static_cast<TransposePlan::Isa>(static_cast<int>(isa) - 1);
+}
+
+// Transposes a bs x bs block of elements of type T.
 //
 // The transpose kernel requires its input to be contiguous in one of the two
 // dimensions being transposed, and the output to be contiguous in the other
 // dimension.
 //
 // lda, ldb are strides in bytes.
+//
+// There is a specialization of this kernel for each instruction set that has a
+// faster way to transpose a particular block size and data type. The kernels
+// are compiled for their instruction set irrespective of the compiler flags,
+// and TransposePlan picks the instruction set at runtime, so that a binary
+// built for a baseline ISA still uses, say, AVX-512 on hosts that support it.
+// Kernels without a specialization for `isa` inherit that of the previous
+// instruction set. kIsa is the instruction set the kernel actually uses.
+template <typename T, int bs, TransposePlan::Isa isa>
+struct TransposeMicroKernel : TransposeMicroKernel<T, bs, PreviousIsa(isa)> {};
+
+// Generic transpose kernel.
+//
+// All of the kernels that follow in this file are optimized versions of this
+// generic kernel, specialized to particular block sizes and data types.
 template <typename T, int bs>
-struct TransposeMicroKernel {
+struct TransposeMicroKernel<T, bs, TransposePlan::Isa::kGeneric> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kGeneric;
+
   static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
                     int64_t ldb) {
     for (int i = 0; i < bs; ++i) {
@@ -45,14 +80,16 @@ struct TransposeMicroKernel {
   }
 };
 
-// TODO(phawkins): it would be nice to remove the use of Eigen here, and instead
-// allow for runtime dispatch of, say, AVX or AVX2 kernels where they are
-// supported. On the other hand, using Eigen makes for easier cross-platform
-// portability.
-#ifdef EIGEN_VECTORIZE_AVX
+#ifdef XLA_TRANSPOSE_X86_KERNELS
+
+// SSE4.1 kernels. Apart from the 4x4 byte transpose, which uses SSSE3 and
+// SSE4.1 shuffles, these kernels only need SSE2.
 
 template <>
-struct TransposeMicroKernel<uint8_t, /*bs=*/4> {
+struct TransposeMicroKernel<uint8_t, /*bs=*/4, TransposePlan::Isa::kSse4> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kSse4;
+
+  XLA_TRANSPOSE_TARGET("sse4.1")
   static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
                     int64_t ldb) {
     __m128i x = _mm_set_epi32(*reinterpret_cast<const uint32_t*>(a + lda * 0),
@@ -71,13 +108,14 @@ struct TransposeMicroKernel<uint8_t, /*bs=*/4> {
 
 // TODO(phawkins): add an 8x8 byte transpose kernel.
 
-// TODO(phawkins): Eigen doesn't have a SSE/AVX byte Packet16c type. Add one
-// and call it here rather than using AVX intrinsics.
 template <>
-struct TransposeMicroKernel<uint8_t, /*bs=*/16> {
+struct TransposeMicroKernel<uint8_t, /*bs=*/16, TransposePlan::Isa::kSse4> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kSse4;
+
+  XLA_TRANSPOSE_TARGET("sse4.1")
   static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
                     int64_t ldb) {
-    std::array<__m128i, 16> packet;
+    __m128i packet[16];
     for (int i = 0; i < 16; ++i) {
       packet[i] =
           _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lda * i));
@@ -186,106 +224,302 @@ struct TransposeMicroKernel<uint8_t, /*bs=*/16> {
 // TODO(phawkins): add an 4x4 uint16_t transpose kernel.
 
 template <>
-struct TransposeMicroKernel<uint16_t, /*bs=*/8> {
+struct TransposeMicroKernel<uint16_t, /*bs=*/8, TransposePlan::Isa::kSse4> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kSse4;
+
+  XLA_TRANSPOSE_TARGET("sse4.1")
   static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
                     int64_t ldb) {
-    using Eigen::internal::Packet8h;
-    using Eigen::internal::PacketBlock;
-    constexpr int bs = 8;
-    PacketBlock<Packet8h, bs> block;
-    for (int i = 0; i < bs; ++i) {
-      block.packet[i] = Eigen::internal::ploadu<Packet8h>(
-          reinterpret_cast<const Eigen::half*>(a + lda * i));
+    __m128i r[8];
+    for (int i = 0; i < 8; ++i) {
+      r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lda * i));
     }
-    Eigen::internal::ptranspose(block);
-    for (int i = 0; i < bs; ++i) {
-      Eigen::internal::pstoreu<Eigen::half>(
-          reinterpret_cast<Eigen::half*>(b + ldb * i), block.packet[i]);
+    // 00 10 01 11 02 12 03 13
+    __m128i t0 = _mm_unpacklo_epi16(r[0], r[1]);
+    // 04 14 05 15 06 16 07 17
+    __m128i t1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i t2 = _mm_unpacklo_epi16(r[2], r[3]);
+    __m128i t3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i t4 = _mm_unpacklo_epi16(r[4], r[5]);
+    __m128i t5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i t6 = _mm_unpacklo_epi16(r[6], r[7]);
+    __m128i t7 = _mm_unpackhi_epi16(r[6], r[7]);
+    // 00 10 20 30 01 11 21 31
+    __m128i s0 = _mm_unpacklo_epi32(t0, t2);
+    // 02 12 22 32 03 13 23 33
+    __m128i s1 = _mm_unpackhi_epi32(t0, t2);
+    __m128i s2 = _mm_unpacklo_epi32(t1, t3);
+    __m128i s3 = _mm_unpackhi_epi32(t1, t3);
+    // 40 50 60 70 41 51 61 71
+    __m128i s4 = _mm_unpacklo_epi32(t4, t6);
+    __m128i s5 = _mm_unpackhi_epi32(t4, t6);
+    __m128i s6 = _mm_unpacklo_epi32(t5, t7);
+    __m128i s7 = _mm_unpackhi_epi32(t5, t7);
+    // 00 10 20 30 40 50 60 70
+    r[0] = _mm_unpacklo_epi64(s0, s4);
+    r[1] = _mm_unpackhi_epi64(s0, s4);
+    r[2] = _mm_unpacklo_epi64(s1, s5);
+    r[3] = _mm_unpackhi_epi64(s1, s5);
+    r[4] = _mm_unpacklo_epi64(s2, s6);
+    r[5] = _mm_unpackhi_epi64(s2, s6);
+    r[6] = _mm_unpacklo_epi64(s3, s7);
+    r[7] = _mm_unpackhi_epi64(s3, s7);
+    for (int i = 0; i < 8; ++i) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(b + ldb * i), r[i]);
     }
   }
 };
 
 template <>
-struct TransposeMicroKernel<uint32_t, /*bs=*/4> {
+struct TransposeMicroKernel<uint32_t, /*bs=*/4, TransposePlan::Isa::kSse4> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kSse4;
+
+  XLA_TRANSPOSE_TARGET("sse4.1")
   static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
                     int64_t ldb) {
-    using Eigen::internal::Packet4f;
-    using Eigen::internal::PacketBlock;
-    constexpr int bs = 4;
-    PacketBlock<Packet4f, bs> block;
-    for (int i = 0; i < bs; ++i) {
-      block.packet[i] = Eigen::internal::ploadu<Packet4f>(
-          reinterpret_cast<const float*>(a + lda * i));
-    }
-    Eigen::internal::ptranspose(block);
-    for (int i = 0; i < bs; ++i) {
-      Eigen::internal::pstoreu<float>(reinterpret_cast<float*>(b + ldb * i),
-                                      block.packet[i]);
-    }
+    __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lda * 0));
+    __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lda * 1));
+    __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lda * 2));
+    __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lda * 3));
+    // 00 10 01 11
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    // 02 12 03 13
+    __m128i t1 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t2 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + ldb * 0),
+                     _mm_unpacklo_epi64(t0, t2));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + ldb * 1),
+                     _mm_unpackhi_epi64(t0, t2));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + ldb * 2),
+                     _mm_unpacklo_epi64(t1, t3));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + ldb * 3),
+                     _mm_unpackhi_epi64(t1, t3));
   }
 };
 
 template <>
-struct TransposeMicroKernel<uint32_t, /*bs=*/8> {
+struct TransposeMicroKernel<uint64_t, /*bs=*/2, TransposePlan::Isa::kSse4> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kSse4;
+
+  XLA_TRANSPOSE_TARGET("sse4.1")
   static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
                     int64_t ldb) {
-    using Eigen::internal::Packet8f;
-    using Eigen::internal::PacketBlock;
-    constexpr int bs = 8;
-    PacketBlock<Packet8f, bs> block;
-    for (int i = 0; i < bs; ++i) {
-      block.packet[i] = Eigen::internal::ploadu<Packet8f>(
-          reinterpret_cast<const float*>(a + lda * i));
+    __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lda * 0));
+    __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + lda * 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + ldb * 0),
+                     _mm_unpacklo_epi64(r0, r1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + ldb * 1),
+                     _mm_unpackhi_epi64(r0, r1));
+  }
+};
+
+// AVX2 kernels. The unpack instructions operate within 128-bit lanes, so these
+// kernels transpose the lanes of pairs of rows, and then exchange lanes with
+// permutes.
+
+template <>
+struct TransposeMicroKernel<uint16_t, /*bs=*/16, TransposePlan::Isa::kAvx2> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kAvx2;
+
+  XLA_TRANSPOSE_TARGET("avx2")
+  static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
+                    int64_t ldb) {
+    __m256i r[16];
+    for (int i = 0; i < 16; ++i) {
+      r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lda * i));
     }
-    Eigen::internal::ptranspose(block);
-    for (int i = 0; i < bs; ++i) {
-      Eigen::internal::pstoreu<float>(reinterpret_cast<float*>(b + ldb * i),
-                                      block.packet[i]);
+    // Transposes the 8x8 blocks within the lanes of rows [8h, 8h + 8), so that
+    // lane 0 of u[h][k] holds column k and lane 1 column k + 8 of those rows.
+    __m256i u[2][8];
+    for (int h = 0; h < 2; ++h) {
+      const __m256i* x = r + 8 * h;
+      __m256i t0 = _mm256_unpacklo_epi16(x[0], x[1]);
+      __m256i t1 = _mm256_unpackhi_epi16(x[0], x[1]);
+      __m256i t2 = _mm256_unpacklo_epi16(x[2], x[3]);
+      __m256i t3 = _mm256_unpackhi_epi16(x[2], x[3]);
+      __m256i t4 = _mm256_unpacklo_epi16(x[4], x[5]);
+      __m256i t5 = _mm256_unpackhi_epi16(x[4], x[5]);
+      __m256i t6 = _mm256_unpacklo_epi16(x[6], x[7]);
+      __m256i t7 = _mm256_unpackhi_epi16(x[6], x[7]);
+      __m256i s0 = _mm256_unpacklo_epi32(t0, t2);
+      __m256i s1 = _mm256_unpackhi_epi32(t0, t2);
+      __m256i s2 = _mm256_unpacklo_epi32(t1, t3);
+      __m256i s3 = _mm256_unpackhi_epi32(t1, t3);
+      __m256i s4 = _mm256_unpacklo_epi32(t4, t6);
+      __m256i s5 = _mm256_unpackhi_epi32(t4, t6);
+      __m256i s6 = _mm256_unpacklo_epi32(t5, t7);
+      __m256i s7 = _mm256_unpackhi_epi32(t5, t7);
+      u[h][0] = _mm256_unpacklo_epi64(s0, s4);
+      u[h][1] = _mm256_unpackhi_epi64(s0, s4);
+      u[h][2] = _mm256_unpacklo_epi64(s1, s5);
+      u[h][3] = _mm256_unpackhi_epi64(s1, s5);
+      u[h][4] = _mm256_unpacklo_epi64(s2, s6);
+      u[h][5] = _mm256_unpackhi_epi64(s2, s6);
+      u[h][6] = _mm256_unpacklo_epi64(s3, s7);
+      u[h][7] = _mm256_unpackhi_epi64(s3, s7);
+    }
+    for (int k = 0; k < 8; ++k) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb * k),
+                          _mm256_permute2x128_si256(u[0][k], u[1][k], 0x20));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb * (k + 8)),
+                          _mm256_permute2x128_si256(u[0][k], u[1][k], 0x31));
     }
   }
 };
 
 template <>
-struct TransposeMicroKernel<uint64_t, /*bs=*/2> {
+struct TransposeMicroKernel<uint32_t, /*bs=*/8, TransposePlan::Isa::kAvx2> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kAvx2;
+
+  XLA_TRANSPOSE_TARGET("avx2")
   static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
                     int64_t ldb) {
-    using Eigen::internal::Packet2d;
-    using Eigen::internal::PacketBlock;
-    constexpr int bs = 2;
-    PacketBlock<Packet2d, bs> block;
-    for (int i = 0; i < bs; ++i) {
-      block.packet[i] = Eigen::internal::ploadu<Packet2d>(
-          reinterpret_cast<const double*>(a + lda * i));
+    __m256i r[8];
+    for (int i = 0; i < 8; ++i) {
+      r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lda * i));
     }
-    Eigen::internal::ptranspose(block);
-    for (int i = 0; i < bs; ++i) {
-      Eigen::internal::pstoreu<double>(reinterpret_cast<double*>(b + ldb * i),
-                                       block.packet[i]);
+    // Transposes the 4x4 blocks within the lanes of rows [4h, 4h + 4), so that
+    // lane 0 of u[h][k] holds column k and lane 1 column k + 4 of those rows.
+    __m256i u[2][4];
+    for (int h = 0; h < 2; ++h) {
+      const __m256i* x = r + 4 * h;
+      __m256i t0 = _mm256_unpacklo_epi32(x[0], x[1]);
+      __m256i t1 = _mm256_unpackhi_epi32(x[0], x[1]);
+      __m256i t2 = _mm256_unpacklo_epi32(x[2], x[3]);
+      __m256i t3 = _mm256_unpackhi_epi32(x[2], x[3]);
+      u[h][0] = _mm256_unpacklo_epi64(t0, t2);
+      u[h][1] = _mm256_unpackhi_epi64(t0, t2);
+      u[h][2] = _mm256_unpacklo_epi64(t1, t3);
+      u[h][3] = _mm256_unpackhi_epi64(t1, t3);
+    }
+    for (int k = 0; k < 4; ++k) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb * k),
+                          _mm256_permute2x128_si256(u[0][k], u[1][k], 0x20));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb * (k + 4)),
+                          _mm256_permute2x128_si256(u[0][k], u[1][k], 0x31));
     }
   }
 };
 
 template <>
-struct TransposeMicroKernel<uint64_t, /*bs=*/4> {
+struct TransposeMicroKernel<uint64_t, /*bs=*/4, TransposePlan::Isa::kAvx2> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kAvx2;
+
+  XLA_TRANSPOSE_TARGET("avx2")
   static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
                     int64_t ldb) {
-    using Eigen::internal::Packet4d;
-    using Eigen::internal::PacketBlock;
-    constexpr int bs = 4;
-    PacketBlock<Packet4d, bs> block;
-    for (int i = 0; i < bs; ++i) {
-      block.packet[i] = Eigen::internal::ploadu<Packet4d>(
-          reinterpret_cast<const double*>(a + lda * i));
+    __m256i r0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lda * 0));
+    __m256i r1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lda * 1));
+    __m256i r2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lda * 2));
+    __m256i r3 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lda * 3));
+    // 00 10 | 02 12
+    __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+    // 01 11 | 03 13
+    __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb * 0),
+                        _mm256_permute2x128_si256(t0, t2, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb * 1),
+                        _mm256_permute2x128_si256(t1, t3, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb * 2),
+                        _mm256_permute2x128_si256(t0, t2, 0x31));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb * 3),
+                        _mm256_permute2x128_si256(t1, t3, 0x31));
+  }
+};
+
+// AVX-512 kernels. These transpose the same blocks as the AVX2 kernels, but
+// hold two rows in each 512-bit register and use two-source permutes, which
+// needs half as many shuffles. Rows are still loaded and stored 256 bits at a
+// time: wider accesses are slower unless the arrays are 64-byte aligned, which
+// PjRt buffers need not be.
+
+// Loads rows `a` and `a + lda` into the halves of a 512-bit register.
+XLA_TRANSPOSE_TARGET("avx512f")
+inline __m512i LoadRowPair(const char* a, int64_t lda) {
+  return _mm512_inserti64x4(
+      _mm512_castsi256_si512(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a))),
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + lda)), 1);
+}
+
+// Stores the halves of `x` to rows `b` and `b + ldb`.
+XLA_TRANSPOSE_TARGET("avx512f")
+inline void StoreRowPair(__m512i x, char* b, int64_t ldb) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(b),
+                      _mm512_castsi512_si256(x));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + ldb),
+                      _mm512_extracti64x4_epi64(x, 1));
+}
+
+template <>
+struct TransposeMicroKernel<uint32_t, /*bs=*/8, TransposePlan::Isa::kAvx512> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kAvx512;
+
+  XLA_TRANSPOSE_TARGET("avx512f")
+  static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
+                    int64_t ldb) {
+    // r[p] holds rows 2p and 2p + 1.
+    __m512i r[4];
+    for (int p = 0; p < 4; ++p) {
+      r[p] = LoadRowPair(a + lda * 2 * p, lda);
     }
-    Eigen::internal::ptranspose(block);
-    for (int i = 0; i < bs; ++i) {
-      Eigen::internal::pstoreu<double>(reinterpret_cast<double*>(b + ldb * i),
-                                       block.packet[i]);
+    // t[h][q] holds the 4x4 block of rows [4h, 4h + 4) and columns
+    // [4q, 4q + 4), in column-major order.
+    const __m512i column_block[2] = {
+        _mm512_setr_epi32(0, 8, 16, 24, 1, 9, 17, 25, 2, 10, 18, 26, 3, 11, 19,
+                          27),
+        _mm512_setr_epi32(4, 12, 20, 28, 5, 13, 21, 29, 6, 14, 22, 30, 7, 15,
+                          23, 31),
+    };
+    __m512i t[2][2];
+    for (int h = 0; h < 2; ++h) {
+      for (int q = 0; q < 2; ++q) {
+        t[h][q] = _mm512_permutex2var_epi32(r[2 * h], column_block[q],
+                                            r[2 * h + 1]);
+      }
     }
+    // Columns 2s and 2s + 1 are the even or odd column pair of t[.][s / 2].
+    const __m512i column_pair[2] = {
+        _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 18, 19, 4, 5, 6, 7, 20, 21, 22,
+                          23),
+        _mm512_setr_epi32(8, 9, 10, 11, 24, 25, 26, 27, 12, 13, 14, 15, 28, 29,
+                          30, 31),
+    };
+    for (int s = 0; s < 4; ++s) {
+      StoreRowPair(_mm512_permutex2var_epi32(t[0][s / 2], column_pair[s % 2],
+                                             t[1][s / 2]),
+                   b + ldb * 2 * s, ldb);
+    }
+  }
+};
+
+template <>
+struct TransposeMicroKernel<uint64_t, /*bs=*/4, TransposePlan::Isa::kAvx512> {
+  static constexpr TransposePlan::Isa kIsa = TransposePlan::Isa::kAvx512;
+
+  XLA_TRANSPOSE_TARGET("avx512f")
+  static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
+                    int64_t ldb) {
+    // r0 holds rows 0 and 1, r1 rows 2 and 3.
+    __m512i r0 = LoadRowPair(a, lda);
+    __m512i r1 = LoadRowPair(a + lda * 2, lda);
+    StoreRowPair(_mm512_permutex2var_epi64(
+                     r0, _mm512_setr_epi64(0, 4, 8, 12, 1, 5, 9, 13), r1),
+                 b, ldb);
+    StoreRowPair(_mm512_permutex2var_epi64(
+                     r0, _mm512_setr_epi64(2, 6, 10, 14, 3, 7, 11, 15), r1),
+                 b + ldb * 2, ldb);
   }
 };
 
-#endif  // EIGEN_VECTORIZE_AVX
+#endif  // XLA_TRANSPOSE_X86_KERNELS
 
 }  // namespace xla
 
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <functional>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -191,7 +192,7 @@ int64_t IndexToLinearIndex(absl::Span<int64_t const> shape,
 // tiled layout.
 template <typename T>
 std::vector<T> TileArray(const Array<T>& in, absl::Span<int64_t const> tiling) {
-  std::vector<T> out(SizeOfTiledArray(in.dimensions(), tiling), -1);
+  std::vector<T> out(SizeOfTiledArray(in.dimensions(), tiling), T(-1));
   if (in.num_elements() == 0) {
     return out;
   }
@@ -352,17 +353,19 @@ std::vector<TransposeTestCase> GetTransposeTestCases() {
 class TransposeTest : public ::testing::TestWithParam<TransposeTestCase> {
  protected:
   template <typename T>
-  void TestTranspose(int parallelism) {
+  void TestTranspose(int parallelism,
+                     std::optional<TransposePlan::Isa> isa = std::nullopt) {
     const TransposeTestCase test = GetParam();
     tsl::thread::ThreadPool threadpool(tsl::Env::Default(), "Transpose",
                                        parallelism);
     std::vector<int64_t> output_dims = Permute(test.dims, test.permutation);
     TF_ASSERT_OK_AND_ASSIGN(
-        auto plan, TransposePlan::Create(
-                       sizeof(T), test.dims, test.permutation,
-                       TransposePlan::Tiling{test.input_tiling},
-                       TransposePlan::Tiling{test.output_tiling},
-                       TransposePlan::Transformation::kNone, parallelism));
+        auto plan,
+        TransposePlan::Create(sizeof(T), test.dims, test.permutation,
+                              TransposePlan::Tiling{test.input_tiling},
+                              TransposePlan::Tiling{test.output_tiling},
+                              TransposePlan::Transformation::kNone,
+                              parallelism, isa));
     VLOG(1) << plan->ToString();
     xla::Array<T> untiled_input(test.dims);
     untiled_input.FillIota(0);
@@ -384,6 +387,51 @@ class TransposeTest : public ::testing::TestWithParam<TransposeTestCase> {
   }
 };
 
+// Runs a transpose that converts elements of type In to type Out, and compares
+// it with a transpose followed by a static_cast.
+template <typename In, typename Out>
+void TestTransposeWithConversion(const TransposeTestCase& test,
+                                 TransposePlan::Transformation transformation,
+                                 int parallelism) {
+  tsl::thread::ThreadPool threadpool(tsl::Env::Default(), "Transpose",
+                                     parallelism);
+  std::vector<int64_t> output_dims = Permute(test.dims, test.permutation);
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto plan,
+      TransposePlan::Create(sizeof(In), test.dims, test.permutation,
+                            TransposePlan::Tiling{test.input_tiling},
+                            TransposePlan::Tiling{test.output_tiling},
+                            transformation, parallelism));
+  EXPECT_EQ(plan->OutputElemSizeInBytes(), sizeof(Out));
+  xla::Array<In> untiled_input(test.dims);
+  // Alternating signs and fractions exercise sign extension and rounding.
+  int64_t i = 0;
+  untiled_input.Each([&](absl::Span<const int64_t>, In* value) {
+    *value = static_cast<In>((i % 2 ? -1.0 : 1.0) * (i + 1) / 3.0);
+    ++i;
+  });
+  xla::Array<In> transposed_input(output_dims);
+  TransposeUsingEigen(untiled_input.data(), transposed_input.data(), test.dims,
+                      output_dims, test.permutation);
+  xla::Array<Out> expected_untiled_output(output_dims);
+  expected_untiled_output.Each(
+      [&](absl::Span<const int64_t> indices, Out* value) {
+        *value = static_cast<Out>(transposed_input(indices));
+      });
+
+  auto tiled_input = TileArray(untiled_input, test.input_tiling);
+  auto expected_tiled_output =
+      TileArray(expected_untiled_output, test.output_tiling);
+
+  std::vector<Out> output(
+      SizeOfTiledArray(plan->OutputDims(), test.output_tiling), Out(-1));
+  plan->Execute(
+      tiled_input.data(), output.data(),
+      [&](std::function<void()> fn) { threadpool.Schedule(std::move(fn)); });
+
+  EXPECT_EQ(expected_tiled_output, output);
+}
+
 TEST_P(TransposeTest, TransposeInt8) { TestTranspose<int8_t>(1); }
 TEST_P(TransposeTest, TransposeInt16) { TestTranspose<int16_t>(1); }
 TEST_P(TransposeTest, TransposeInt32) { TestTranspose<int32_t>(1); }
@@ -393,9 +441,73 @@ TEST_P(TransposeTest, TransposeInt128) { TestTranspose<absl::int128>(1); }
 TEST_P(TransposeTest, ParallelTransposeInt8) { TestTranspose<int8_t>(16); }
 TEST_P(TransposeTest, ParallelTransposeInt32) { TestTranspose<int32_t>(16); }
 
+// Tests the kernels of each instruction set the host supports, not just the
+// most capable one.
+TEST_P(TransposeTest, TransposeWithEachIsa) {
+  for (int i = 0; i <= static_cast<int>(TransposePlan::SupportedIsa()); ++i) {
+    auto isa = static_cast<TransposePlan::Isa>(i);
+    SCOPED_TRACE(TransposePlan::IsaToString(isa));
+    TestTranspose<int8_t>(1, isa);
+    TestTranspose<int16_t>(1, isa);
+    TestTranspose<int32_t>(1, isa);
+    TestTranspose<int64_t>(1, isa);
+  }
+}
+
+TEST_P(TransposeTest, TransposeF32ToBF16) {
+  TestTransposeWithConversion<float, Eigen::bfloat16>(
+      GetParam(), TransposePlan::Transformation::kF32ToBF16, 1);
+}
+TEST_P(TransposeTest, TransposeBF16ToF32) {
+  TestTransposeWithConversion<Eigen::bfloat16, float>(
+      GetParam(), TransposePlan::Transformation::kBF16ToF32, 1);
+}
+TEST_P(TransposeTest, TransposeF32ToF16) {
+  TestTransposeWithConversion<float, Eigen::half>(
+      GetParam(), TransposePlan::Transformation::kF32ToF16, 1);
+}
+TEST_P(TransposeTest, TransposeF16ToF32) {
+  TestTransposeWithConversion<Eigen::half, float>(
+      GetParam(), TransposePlan::Transformation::kF16ToF32, 1);
+}
+TEST_P(TransposeTest, TransposeS64ToS32) {
+  TestTransposeWithConversion<int64_t, int32_t>(
+      GetParam(), TransposePlan::Transformation::kS64ToS32, 1);
+}
+TEST_P(TransposeTest, TransposeS32ToS64) {
+  TestTransposeWithConversion<int32_t, int64_t>(
+      GetParam(), TransposePlan::Transformation::kS32ToS64, 1);
+}
+TEST_P(TransposeTest, ParallelTransposeF32ToBF16) {
+  TestTransposeWithConversion<float, Eigen::bfloat16>(
+      GetParam(), TransposePlan::Transformation::kF32ToBF16, 16);
+}
+
 INSTANTIATE_TEST_SUITE_P(TransposeTestInstance, TransposeTest,
                          ::testing::ValuesIn(GetTransposeTestCases()));
 
+TEST(TransposeTest, ConversionRoundsToNearestEvenAndQuietsNaNs) {
+  std::vector<uint32_t> input = {0x3f808000u, 0x3f818000u, 0x3f808001u,
+                                 0x7f7fffffu, 0x7f800001u, 0xffc00000u};
+  std::vector<uint16_t> expected = {0x3f80u, 0x3f82u, 0x3f81u,
+                                    0x7f80u, 0x7fc0u, 0xffc0u};
+  std::vector<uint16_t> output(input.size());
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto plan,
+      TransposePlan::Create(sizeof(float), {6}, /*permutation=*/{0},
+                            TransposePlan::Tiling{}, TransposePlan::Tiling{},
+                            TransposePlan::Transformation::kF32ToBF16));
+  plan->Execute(input.data(), output.data());
+  EXPECT_EQ(expected, output);
+}
+
+TEST(TransposeTest, ConversionRequiresMatchingElementSize) {
+  auto plan = TransposePlan::Create(
+      sizeof(int32_t), {4}, /*permutation=*/{0}, TransposePlan::Tiling{},
+      TransposePlan::Tiling{}, TransposePlan::Transformation::kS64ToS32);
+  EXPECT_EQ(plan.status().code(), tsl::error::INVALID_ARGUMENT);
+}
+
 TEST(TransposeTest, NegativeStrides1D) {
   int64_t n = 10;
   std::vector<int32_t> input(n);
@@ -411,6 +523,20 @@ TEST(TransposeTest, NegativeStrides1D) {
   EXPECT_EQ(expected, output);
 }
 
+TEST(TransposeTest, DefaultsToSupportedIsa) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto plan, TransposePlan::Create(sizeof(float), {64, 64},
+                                       /*permutation=*/{1, 0}));
+  EXPECT_EQ(plan->KernelIsa(), TransposePlan::SupportedIsa());
+  TF_ASSERT_OK_AND_ASSIGN(
+      plan,
+      TransposePlan::Create(sizeof(float), {64, 64}, /*permutation=*/{1, 0},
+                            TransposePlan::Tiling{}, TransposePlan::Tiling{},
+                            TransposePlan::Transformation::kNone,
+                            /*num_threads=*/1, TransposePlan::Isa::kGeneric));
+  EXPECT_EQ(plan->KernelIsa(), TransposePlan::Isa::kGeneric);
+}
+
 TEST(TransposeTest, NegativeStrides2D) {
   xla::Array<int16_t> input = {
       {1, 2, 3, 4},
@@ -493,12 +619,14 @@ static void BM_Eigen_float(const TransposeTestCase& bm, int parallelism,
 
 template <typename T>
 void BM_Transpose(const TransposeTestCase& bm, int parallelism,
-                  ::testing::benchmark::State& state) {
+                  ::testing::benchmark::State& state,
+                  std::optional<TransposePlan::Isa> isa = std::nullopt) {
   TF_ASSERT_OK_AND_ASSIGN(
       auto plan,
       TransposePlan::Create(sizeof(T), bm.dims, bm.permutation,
                             TransposePlan::Tiling{}, TransposePlan::Tiling{},
-                            TransposePlan::Transformation::kNone, parallelism));
+                            TransposePlan::Transformation::kNone, parallelism,
+                            isa));
   Array<T> input(bm.dims);
   input.FillIota(0);
   std::vector<int64_t> output_dims = Permute(bm.dims, bm.permutation);
@@ -516,10 +644,25 @@ static void BM_Transpose_uint8(const TransposeTestCase& bm, int parallelism,
                                ::testing::benchmark::State& state) {
   BM_Transpose<uint8_t>(bm, parallelism, state);
 }
+static void BM_Transpose_uint16(const TransposeTestCase& bm, int parallelism,
+                                ::testing::benchmark::State& state) {
+  BM_Transpose<uint16_t>(bm, parallelism, state);
+}
 static void BM_Transpose_float(const TransposeTestCase& bm, int parallelism,
                                ::testing::benchmark::State& state) {
   BM_Transpose<float>(bm, parallelism, state);
 }
+static void BM_Transpose_uint64(const TransposeTestCase& bm, int parallelism,
+                                ::testing::benchmark::State& state) {
+  BM_Transpose<uint64_t>(bm, parallelism, state);
+}
+
+// Single-threaded transposes with the kernels of a given instruction set.
+template <typename T>
+void BM_TransposeIsa(const TransposeTestCase& bm, TransposePlan::Isa isa,
+                     ::testing::benchmark::State& state) {
+  BM_Transpose<T>(bm, /*parallelism=*/1, state, isa);
+}
 
 static void* benchmarks = []() {
   using BenchmarkFn =
@@ -528,11 +671,36 @@ static void* benchmarks = []() {
       {
           {"BM_Eigen_uint8", BM_Eigen_uint8, {1}},
           {"BM_Transpose_uint8", BM_Transpose_uint8, {1, 4, 8}},  //
+          {"BM_Transpose_uint16", BM_Transpose_uint16, {1, 4, 8}},  //
           {"BM_Eigen_float", BM_Eigen_float, {1}},
           {"BM_Transpose_float", BM_Transpose_float, {1, 4, 8}},  //
+          {"BM_Transpose_uint64", BM_Transpose_uint64, {1, 4, 8}},  //
+  };
+  using IsaBenchmarkFn = void (*)(const TransposeTestCase&, TransposePlan::Isa,
+                                  testing::benchmark::State&);
+  std::vector<std::pair<std::string, IsaBenchmarkFn>> isa_variants = {
+      {"BM_TransposeIsa_uint8", BM_TransposeIsa<uint8_t>},
+      {"BM_TransposeIsa_uint16", BM_TransposeIsa<uint16_t>},
+      {"BM_TransposeIsa_float", BM_TransposeIsa<float>},
+      {"BM_TransposeIsa_uint64", BM_TransposeIsa<uint64_t>},
   };
   auto benchmark_cases = BenchmarkCases();
   for (const auto& benchmark_case : benchmark_cases) {
+    for (const auto& [variant_name, fn] : isa_variants) {
+      for (int i = 0; i <= static_cast<int>(TransposePlan::SupportedIsa());
+           ++i) {
+        auto isa = static_cast<TransposePlan::Isa>(i);
+        std::string name = absl::StrCat(
+            variant_name, "_", TransposePlan::IsaToString(isa), "_",
+            absl::StrJoin(benchmark_case.dims, "_"), "_perm_",
+            absl::StrJoin(benchmark_case.permutation, "_"));
+        benchmark::RegisterBenchmark(
+            name.c_str(),
+            [fn = fn, isa, testcase = benchmark_case](benchmark::State& state) {
+              fn(testcase, isa, state);
+            });
+      }
+    }
     for (const auto& variant : variants) {
       for (int num_threads : std::get<2>(variant)) {
         std::string name =
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef XLA_SERVICE_CHOLESKY_EXPANDER_H_
 #define XLA_SERVICE_CHOLESKY_EXPANDER_H_
 
+#include <utility>
+
 #include "absl/container/flat_hash_map.h"
 #include "xla/client/xla_builder.h"
 #include "xla/service/op_expander_pass.h"
@@ -24,6 +26,9 @@ namespace xla {
 
 class CholeskyExpander : public OpExpanderPass {
  public:
+  explicit CholeskyExpander(HloPredicate extra_filter = nullptr)
+      : OpExpanderPass(std::move(extra_filter)) {}
+
   absl::string_view name() const override { return "cholesky_expander"; }
 
  protected:
@@ -34,6 +34,8 @@ class NoopStats : public CompilationStats {
 
   void EndPass(absl::string_view pass_name) override {}
 
+  void RecordPass(absl::string_view pass_name, double duration_ms) override {}
+
   void CompilationReport() override {}
 
   int GetPassesSize() override { return 0; }
@@ -50,6 +52,8 @@ class Stats : public CompilationStats {
 
   void EndPass(absl::string_view pass_name) override;
 
+  void RecordPass(absl::string_view pass_name, double duration_ms) override;
+
   void CompilationReport() override;
 
   int GetPassesSize() override;
@@ -103,6 +107,10 @@ void Stats::EndPass(absl::string_view pass_name) {
   passes_.push_back(PassInfo(current_pass_, duration_ms));
 }
 
+void Stats::RecordPass(absl::string_view pass_name, double duration_ms) {
+  passes_.push_back(PassInfo(pass_name, duration_ms));
+}
+
 void Stats::CompilationReport() {
   CHECK(!pass_running_) << "EndPass never called for " << current_pass_;
   absl::flat_hash_map<std::string, PassInfo> summary;
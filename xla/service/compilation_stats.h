@@ -41,6 +41,11 @@ class CompilationStats {
 
   virtual void EndPass(absl::string_view pass_name) = 0;
 
+  // Records a run of a pass that took `duration_ms` and was timed by the
+  // caller instead of between StartPass and EndPass, e.g. because it ran
+  // concurrently with other passes.
+  virtual void RecordPass(absl::string_view pass_name, double duration_ms) = 0;
+
   virtual void CompilationReport() = 0;
 
   virtual int GetPassesSize() = 0;
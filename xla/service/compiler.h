@@ -36,6 +36,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_module_group.h"
 #include "xla/service/buffer_assignment.h"
 #include "xla/service/buffer_value.h"
+#include "xla/service/compilation_stats.h"
 #include "xla/service/computation_placer.h"
 #include "xla/service/executable.h"
 #include "xla/service/hlo_module_config.h"
@@ -241,6 +242,16 @@ class Compiler {
     // An optional thread pool for parallel compilation.
     tsl::thread::ThreadPool* thread_pool = nullptr;
 
+    // If not null, backends record the time spent in stages of compilation
+    // that run outside of HLO pass pipelines, such as the codegen of each
+    // module shard on CPU, in it.
+    CompilationStats* compilation_stats = nullptr;
+
+    // If true, backends that JIT object code keep a copy of it in the
+    // executable so that Export can serialize it. It is dropped otherwise,
+    // since most executables are never exported.
+    bool retain_object_files = false;
+
     std::function<StatusOr<std::pair<std::vector<Shape>, Shape>>(
         const HloModule& module)>
         layout_canonicalization_callback = {};
@@ -0,0 +1,233 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Element-wise reductions of the buffers of CPU collectives, shared by the
+// in-process collectives in cpu_runtime.cc and the CollectivesInterface
+// implementations.
+
+#ifndef XLA_SERVICE_CPU_COLLECTIVE_REDUCTION_H_
+#define XLA_SERVICE_CPU_COLLECTIVE_REDUCTION_H_
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "absl/base/casts.h"
+#include "absl/types/span.h"
+#include "Eigen/Core"  // from @eigen_archive
+#include "xla/primitive_util.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/float8.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace internal {
+
+template <class T>
+struct is_complex : std::false_type {};
+template <class T>
+struct is_complex<std::complex<T>> : std::true_type {};
+
+template <typename T>
+struct is_low_precision_float : std::false_type {};
+template <>
+struct is_low_precision_float<Eigen::half> : std::true_type {};
+template <>
+struct is_low_precision_float<Eigen::bfloat16> : std::true_type {};
+template <>
+struct is_low_precision_float<tsl::float8_e5m2> : std::true_type {};
+template <>
+struct is_low_precision_float<tsl::float8_e4m3fn> : std::true_type {};
+
+template <typename T, bool kIsSignedIntegralType>
+struct SumProductTypeForReductionStep {
+  using type = T;
+};
+
+template <typename T>
+struct SumProductTypeForReductionStep<T, /*kIsSignedIntegralType=*/true> {
+  using type = typename std::make_unsigned_t<T>;
+};
+
+template <ReductionKind kReductionKind, typename T>
+T ReductionStep(T a, T b) {
+  // Signed integers are reduced as unsigned integers so that overflow wraps
+  // around instead of being undefined behavior.
+  using SumProductType = typename SumProductTypeForReductionStep<
+      T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
+  if constexpr (kReductionKind == ReductionKind::SUM) {
+    return absl::bit_cast<T>(
+        static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) +
+                                    absl::bit_cast<SumProductType>(b)));
+  } else if constexpr (kReductionKind == ReductionKind::PRODUCT) {
+    return absl::bit_cast<T>(
+        static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) *
+                                    absl::bit_cast<SumProductType>(b)));
+  } else if constexpr (kReductionKind == ReductionKind::MIN) {
+    return std::min(a, b);
+  } else {
+    return std::max(a, b);
+  }
+}
+
+// Low-precision floats are accumulated in F32, but every reduction step is
+// rounded back to T so that the result is identical to reducing in T.
+template <typename T>
+using AccumulatorType =
+    std::conditional_t<is_low_precision_float<T>::value, float, T>;
+
+template <ReductionKind kReductionKind, typename T>
+AccumulatorType<T> Accumulate(AccumulatorType<T> acc, T value) {
+  if constexpr (is_low_precision_float<T>::value) {
+    return static_cast<float>(static_cast<T>(
+        ReductionStep<kReductionKind, float>(acc, static_cast<float>(value))));
+  } else {
+    return ReductionStep<kReductionKind, T>(acc, value);
+  }
+}
+
+// Reduces elements [begin, end) of all `inputs` and writes the result to the
+// same elements of all `outputs`. The work is done in small blocks that stay
+// in L1: every input block is read before any output block is written, so
+// inputs may alias outputs (in-place all-reduce). The inner loops run over
+// contiguous arrays with a compile-time reduction kind and are vectorized by
+// the compiler.
+template <ReductionKind kReductionKind, typename T>
+void ReduceShardImpl(absl::Span<const T* const> inputs,
+                     absl::Span<T* const> outputs, int64_t begin,
+                     int64_t end) {
+  using Acc = AccumulatorType<T>;
+  constexpr int64_t kBlockSize = 512;
+  Acc acc[kBlockSize];
+  for (int64_t block_begin = begin; block_begin < end;
+       block_begin += kBlockSize) {
+    const int64_t n = std::min(kBlockSize, end - block_begin);
+    const T* first = inputs[0] + block_begin;
+    for (int64_t i = 0; i < n; ++i) {
+      acc[i] = static_cast<Acc>(first[i]);
+    }
+    for (size_t p = 1; p < inputs.size(); ++p) {
+      const T* in = inputs[p] + block_begin;
+      for (int64_t i = 0; i < n; ++i) {
+        acc[i] = Accumulate<kReductionKind, T>(acc[i], in[i]);
+      }
+    }
+    for (T* output : outputs) {
+      T* out = output + block_begin;
+      for (int64_t i = 0; i < n; ++i) {
+        out[i] = static_cast<T>(acc[i]);
+      }
+    }
+  }
+}
+
+}  // namespace internal
+
+template <typename T>
+void ReduceShard(ReductionKind reduction_kind,
+                 absl::Span<const T* const> inputs,
+                 absl::Span<T* const> outputs, int64_t begin, int64_t end) {
+  switch (reduction_kind) {
+    case ReductionKind::SUM:
+      return internal::ReduceShardImpl<ReductionKind::SUM, T>(
+          inputs, outputs, begin, end);
+    case ReductionKind::PRODUCT:
+      return internal::ReduceShardImpl<ReductionKind::PRODUCT, T>(
+          inputs, outputs, begin, end);
+    case ReductionKind::MIN:
+    case ReductionKind::MAX:
+      if constexpr (internal::is_complex<T>::value) {
+        LOG(FATAL) << "min/max not valid for complex types";
+      } else if (reduction_kind == ReductionKind::MIN) {
+        return internal::ReduceShardImpl<ReductionKind::MIN, T>(
+            inputs, outputs, begin, end);
+      } else {
+        return internal::ReduceShardImpl<ReductionKind::MAX, T>(
+            inputs, outputs, begin, end);
+      }
+  }
+}
+
+// Calls `fn` with a std::integral_constant holding the PrimitiveType whose
+// native type is used to reduce buffers of type `type`.
+template <typename F>
+void ReductionTypeSwitch(PrimitiveType type, F&& fn) {
+  switch (type) {
+    case S8:
+      return fn(std::integral_constant<PrimitiveType, S8>());
+    case PRED:
+    case U8:
+      return fn(std::integral_constant<PrimitiveType, U8>());
+    case S16:
+      return fn(std::integral_constant<PrimitiveType, S16>());
+    case U16:
+      return fn(std::integral_constant<PrimitiveType, U16>());
+    case S32:
+      return fn(std::integral_constant<PrimitiveType, S32>());
+    case U32:
+      return fn(std::integral_constant<PrimitiveType, U32>());
+    case S64:
+      return fn(std::integral_constant<PrimitiveType, S64>());
+    case U64:
+      return fn(std::integral_constant<PrimitiveType, U64>());
+    case F16:
+      return fn(std::integral_constant<PrimitiveType, F16>());
+    case BF16:
+      return fn(std::integral_constant<PrimitiveType, BF16>());
+    case F8E5M2:
+      return fn(std::integral_constant<PrimitiveType, F8E5M2>());
+    case F8E4M3FN:
+      return fn(std::integral_constant<PrimitiveType, F8E4M3FN>());
+    case F32:
+      return fn(std::integral_constant<PrimitiveType, F32>());
+    case F64:
+      return fn(std::integral_constant<PrimitiveType, F64>());
+    case C64:
+      return fn(std::integral_constant<PrimitiveType, C64>());
+    case C128:
+      return fn(std::integral_constant<PrimitiveType, C128>());
+    default:
+      LOG(FATAL) << "Unexpected datatype;";
+  }
+}
+
+// Reduces `num_elements` elements of `inputs`, in the order of `inputs`, into
+// `output`. `output` may alias any of the inputs.
+inline void ReduceBuffers(ReductionKind reduction_kind,
+                          PrimitiveType element_type,
+                          absl::Span<const void* const> inputs, void* output,
+                          int64_t num_elements) {
+  ReductionTypeSwitch(element_type, [&](auto primitive_type) {
+    using T = typename primitive_util::PrimitiveTypeToNative<
+        decltype(primitive_type)::value>::type;
+    std::vector<const T*> typed_inputs(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      typed_inputs[i] = static_cast<const T*>(inputs[i]);
+    }
+    T* typed_output = static_cast<T*>(output);
+    ReduceShard<T>(reduction_kind, typed_inputs,
+                   absl::MakeConstSpan(&typed_output, 1), 0, num_elements);
+  });
+}
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_COLLECTIVE_REDUCTION_H_
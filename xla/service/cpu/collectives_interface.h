@@ -0,0 +1,105 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_COLLECTIVES_INTERFACE_H_
+#define XLA_SERVICE_CPU_COLLECTIVES_INTERFACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/global_device_id.h"
+#include "xla/statusor.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace cpu {
+
+// A communicator for one participant, identified by its rank, of a group of
+// devices. The devices may live in different processes. All participants of a
+// group must issue the same collectives in the same order; the collectives of
+// one communicator are not issued concurrently.
+//
+// `key` identifies the collective op; implementations may use it to check
+// that the participants agree on the op. Input and output buffers may alias
+// unless stated otherwise.
+class CollectivesCommunicator {
+ public:
+  virtual ~CollectivesCommunicator() = default;
+
+  // Reduces `num_elements` elements of `input_buffer` over all ranks into
+  // `output_buffer` of every rank.
+  virtual Status AllReduce(const RendezvousKey& key,
+                           ReductionKind reduction_kind,
+                           PrimitiveType element_type, int64_t num_elements,
+                           const void* input_buffer, void* output_buffer,
+                           absl::Duration timeout) = 0;
+
+  // Sends `input_buffer` to every rank of `target_ranks` and receives
+  // `output_buffer` from `source_rank`. If there is no source rank,
+  // `output_buffer` is zeroed. The buffers must not alias.
+  virtual Status CollectivePermute(const RendezvousKey& key, size_t num_bytes,
+                                   std::optional<int> source_rank,
+                                   absl::Span<const int> target_ranks,
+                                   const void* input_buffer,
+                                   void* output_buffer,
+                                   absl::Duration timeout) = 0;
+
+  // Sends `input_buffers[i]` to rank i and receives `output_buffers[i]` from
+  // rank i. Every buffer has `chunk_bytes` bytes. The buffers must not alias.
+  virtual Status AllToAll(const RendezvousKey& key, size_t chunk_bytes,
+                          absl::Span<const void* const> input_buffers,
+                          absl::Span<void* const> output_buffers,
+                          absl::Duration timeout) = 0;
+
+  // `input_buffer` holds `num_blocks` blocks of `block_bytes` bytes. Block b of
+  // rank r is written to block b * num_ranks + r of every `output_buffer`. The
+  // buffers must not alias.
+  virtual Status AllGather(const RendezvousKey& key, int64_t num_blocks,
+                           size_t block_bytes, const void* input_buffer,
+                           void* output_buffer, absl::Duration timeout) = 0;
+
+  // `input_buffer` holds num_blocks * num_ranks chunks of `chunk_elements`
+  // elements. Chunk b of `output_buffer` of rank r is the reduction of chunk
+  // b * num_ranks + r over all ranks. The buffers must not alias.
+  virtual Status ReduceScatter(const RendezvousKey& key,
+                               ReductionKind reduction_kind,
+                               PrimitiveType element_type, int64_t num_blocks,
+                               int64_t chunk_elements,
+                               const void* input_buffer, void* output_buffer,
+                               absl::Duration timeout) = 0;
+};
+
+// Creates the communicators of the devices of this process. Implementations
+// must be thread-safe.
+class CollectivesInterface {
+ public:
+  virtual ~CollectivesInterface() = default;
+
+  // Returns the communicator of the participant `rank` of the group of
+  // `devices`, which are global device ids in the order of their ranks.
+  // Blocks until the communicator is connected to all other participants.
+  virtual StatusOr<std::shared_ptr<CollectivesCommunicator>> GetCommunicator(
+      absl::Span<const GlobalDeviceId> devices, int rank) = 0;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_COLLECTIVES_INTERFACE_H_
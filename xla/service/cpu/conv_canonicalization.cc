@@ -35,9 +35,12 @@ StatusOr<bool> ConvCanonicalization::Run(
   bool changed = false;
   for (HloInstruction* hlo :
        module->entry_computation()->MakeInstructionPostOrder()) {
+    // Direct convolutions support any dimension numbers, so they are left
+    // alone.
     if (hlo->opcode() == HloOpcode::kConvolution &&
         !PotentiallyImplementedAsEigenConvolution(*hlo,
-                                                  target_machine_features_)) {
+                                                  target_machine_features_) &&
+        !PotentiallyImplementedAsDirectConvolution(*hlo)) {
       const ConvolutionDimensionNumbers& dnums =
           hlo->convolution_dimension_numbers();
       auto input_batch_dim = dnums.input_batch_dimension();
@@ -160,5 +160,28 @@ TEST_F(ConvCanonicalizationTest, CanonicalStaysTheSame) {
   EXPECT_FALSE(conv_canonicalization.Run(module.get()).value());
 }
 
+TEST_F(ConvCanonicalizationTest, DirectConvolutionStaysTheSame) {
+  // A depthwise convolution in NCHW order runs in the direct kernels, which
+  // take any dimension numbers.
+  const char* const hlo_string = R"(
+HloModule DirectConvolution
+
+ENTRY entry {
+  input = f32[8,32,28,28] parameter(0)
+  kernel = f32[32,1,5,5] parameter(1)
+  ROOT conv = f32[8,32,24,24] convolution(input, kernel), window={size=5x5},
+    dim_labels=bf01_oi01->bf01, feature_group_count=32
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+
+  cpu::TargetMachineFeaturesWithFakeAlignmentLogic target_machine_features(
+      [](int64_t shape_size) {
+        return cpu::TargetMachineFeatures::kEigenExpectedTensorAlignment;
+      });
+  ConvCanonicalization conv_canonicalization(&target_machine_features);
+  EXPECT_FALSE(conv_canonicalization.Run(module.get()).value());
+}
+
 }  // namespace cpu
 }  // namespace xla
@@ -18,6 +18,8 @@ limitations under the License.
 #include <stddef.h>
 #include <string.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
@@ -33,13 +35,25 @@ limitations under the License.
 
 #include <optional>
 
+#include "absl/algorithm/container.h"
 #include "absl/base/call_once.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/Module.h"
@@ -48,11 +62,14 @@ limitations under the License.
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/TargetParser/Host.h"
 #include "llvm/TargetParser/Triple.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 #include "mlir/Conversion/AffineToStandard/AffineToStandard.h"  // from @llvm-project
 #include "mlir/Conversion/ReconcileUnrealizedCasts/ReconcileUnrealizedCasts.h"  // from @llvm-project
 #include "mlir/Dialect/Affine/IR/AffineOps.h"  // from @llvm-project
@@ -106,11 +123,13 @@ limitations under the License.
 #include "xla/service/change_op_data_type.h"
 #include "xla/service/cholesky_expander.h"
 #include "xla/service/comparison_expander.h"
+#include "xla/service/compilation_stats.h"
 #include "xla/service/conditional_canonicalizer.h"
 #include "xla/service/conditional_simplifier.h"
 #include "xla/service/conditional_to_select.h"
 #include "xla/service/convolution_group_converter.h"
 #include "xla/service/copy_insertion.h"
+#include "xla/service/cpu/backend_config.pb.h"
 #include "xla/service/cpu/buffer_info_util.h"
 #include "xla/service/cpu/compiler_functor.h"
 #include "xla/service/cpu/conv_canonicalization.h"
@@ -121,6 +140,7 @@ limitations under the License.
 #include "xla/service/cpu/cpu_shape_verifier.h"
 #include "xla/service/cpu/dot_op_emitter.h"
 #include "xla/service/cpu/hlo_xla_runtime_pipeline.h"
+#include "xla/service/cpu/ir_emission_utils.h"
 #include "xla/service/cpu/ir_emitter.h"
 #include "xla/service/cpu/parallel_task_assignment.h"
 #include "xla/service/cpu/runtime/collectives.h"
@@ -129,6 +149,8 @@ limitations under the License.
 #include "xla/service/cpu/runtime/rng.h"
 #include "xla/service/cpu/runtime/xfeed.h"
 #include "xla/service/cpu/simple_orc_jit.h"
+#include "xla/service/cpu/task_graph.h"
+#include "xla/service/cpu/task_outliner.h"
 #include "xla/service/cpu/xla_framework.h"
 #include "xla/service/dot_decomposer.h"
 #include "xla/service/dump.h"
@@ -138,6 +160,7 @@ limitations under the License.
 #include "xla/service/eigh_expander.h"
 #include "xla/service/flatten_call_graph.h"
 #include "xla/service/float_normalization.h"
+#include "xla/service/float_support.h"
 #include "xla/service/gather_expander.h"
 #include "xla/service/hlo.pb.h"
 #include "xla/service/hlo_constant_folding.h"
@@ -188,8 +211,12 @@ limitations under the License.
 #include "xla/translate/hlo_to_mhlo/hlo_to_mlir_hlo.h"
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/platform/blocking_counter.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
+#include "tsl/platform/fingerprint.h"
 #include "tsl/platform/status.h"
+#include "tsl/platform/threadpool.h"
 
 namespace {
 
@@ -553,6 +580,39 @@ void AddHloVerifier(HloPassPipeline* pipeline, bool allow_sparse_shapes,
   }
 }
 
+// BF16 support of the CPU backend: only the operands of dots that are emitted
+// as calls to the bf16 x bf16 -> f32 runtime matmul are kept in BF16. Such
+// dots still produce F32, followed by a convert if the dot produced BF16.
+class CpuBF16Support : public FloatSupport {
+ public:
+  CpuBF16Support(bool is_mlir_compile,
+                 const TargetMachineFeatures* target_machine_features)
+      : FloatSupport(BF16),
+        is_mlir_compile_(is_mlir_compile),
+        target_machine_features_(target_machine_features) {}
+
+  bool SupportsLowPrecisionOperand(const HloInstruction& hlo,
+                                   int64_t operand_index) const override {
+    return IsMixedPrecisionRuntimeDot(hlo) ||
+           FloatSupport::SupportsLowPrecisionOperand(hlo, operand_index);
+  }
+
+  bool SupportsMixedPrecisions(const HloInstruction& hlo) const override {
+    return IsMixedPrecisionRuntimeDot(hlo) ||
+           FloatSupport::SupportsMixedPrecisions(hlo);
+  }
+
+ private:
+  bool IsMixedPrecisionRuntimeDot(const HloInstruction& hlo) const {
+    return !is_mlir_compile_ &&
+           CanEmitMixedPrecisionDotAsRuntimeCall(hlo, F32,
+                                                 *target_machine_features_);
+  }
+
+  bool is_mlir_compile_;
+  const TargetMachineFeatures* target_machine_features_;
+};
+
 }  // namespace
 
 Status CpuCompiler::RunHloPassesThroughLayoutAssn(
@@ -591,13 +651,26 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   HloPassPipeline pipeline("HLO passes through layout assignment");
   AddHloVerifier(&pipeline, allow_sparse_shapes_);
 
-  pipeline.AddPass<OperandUpcaster>();
-  pipeline.AddPass<ResultCaster>();
+  // s8 x s8 -> s32 GEMMs are emitted as calls to a mixed-precision runtime
+  // matmul, so their operands are not upcast.
+  auto upcast_operands = [is_mlir_compile, target_machine_features](
+                             const HloInstruction* instruction) {
+    return is_mlir_compile ||
+           !CanEmitMixedPrecisionDotAsRuntimeCall(
+               *instruction, instruction->shape().element_type(),
+               *target_machine_features);
+  };
+  pipeline.AddPass<OperandUpcaster>(upcast_operands);
+  pipeline.AddPass<ResultCaster>(upcast_operands);
 
   // Expand random number generation.
   pipeline.AddPass<RngExpander>();
   if (!is_mlir_compile) {
-    pipeline.AddPass<RngBitGeneratorExpander>(RandomAlgorithm::RNG_PHILOX);
+    // Bit generators the IR emitter can call the runtime for are left alone.
+    pipeline.AddPass<RngBitGeneratorExpander>(
+        RandomAlgorithm::RNG_PHILOX, [](const HloInstruction* instruction) {
+          return !CanEmitRngBitGeneratorAsRuntimeCall(*instruction);
+        });
   }
 
   // Remove zero-sized HLO from the input so that other passes don't have to
@@ -610,13 +683,29 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   pipeline.AddPass<MapInliner>();
 
   pipeline.AddPass<ComparisonExpander>();
-  pipeline.AddPass<CholeskyExpander>();
-  pipeline.AddPass<QrExpander>();
-  pipeline.AddPass<EighExpander>();
-  pipeline.AddPass<TriangularSolveExpander>();
-  pipeline.AddPass<AllGatherDecomposer>();
+  // Linear algebra the IR emitter can call Eigen for is left alone; the
+  // expanders are the fallback for everything else.
+  auto expand_linalg = [is_mlir_compile](const HloInstruction* instruction) {
+    return is_mlir_compile || !CanEmitLinalgAsRuntimeCall(*instruction);
+  };
+  pipeline.AddPass<CholeskyExpander>(expand_linalg);
+  pipeline.AddPass<QrExpander>(expand_linalg);
+  pipeline.AddPass<EighExpander>(expand_linalg);
+  pipeline.AddPass<TriangularSolveExpander>(/*block_size=*/128, expand_linalg);
+  // The IR emitter calls into the runtime for all-gathers and reduce-scatters
+  // it supports; the rest (and all of them on the XLA runtime path) are
+  // rewritten into all-reduces.
+  pipeline.AddPass<AllGatherDecomposer>(
+      [is_mlir_compile](const HloAllGatherInstruction& all_gather) {
+        return is_mlir_compile || !CanEmitAllGatherAsRuntimeCall(all_gather);
+      });
   pipeline.AddPass<AllToAllDecomposer>();
-  pipeline.AddPass<ReduceScatterDecomposer>();
+  pipeline.AddPass<ReduceScatterDecomposer>(
+      /*update_layout=*/nullptr,
+      [is_mlir_compile](const HloReduceScatterInstruction& reduce_scatter) {
+        return is_mlir_compile ||
+               !CanEmitReduceScatterAsRuntimeCall(reduce_scatter);
+      });
   pipeline.AddPass<StochasticConvertDecomposer>();
 
   // Inline computations with a single call site.
@@ -630,7 +719,7 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   // Convert BF16 and F8 operations to F32 and F16 respectively so that the CPU
   // backend can support BF16/F8 operations without directly implementing a
   // BF16/F8 lowering for most ops.
-  FloatSupport bf16_support(BF16);
+  CpuBF16Support bf16_support(is_mlir_compile, target_machine_features);
   pipeline.AddPass<FloatNormalization>(&bf16_support);
   FloatSupport f8e5m2_support(F8E5M2);
   pipeline.AddPass<FloatNormalization>(&f8e5m2_support);
@@ -647,6 +736,9 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
       /*should_expand=*/[](HloInstruction* conv) { return true; }, cost_model,
       /*convert_batch_groups_only=*/true);
   auto feature_group_should_expand = [](HloInstruction* conv) {
+    if (PotentiallyImplementedAsDirectConvolution(*conv)) {
+      return false;
+    }
     switch (conv->shape().element_type()) {
       case F16:
       case F32:
@@ -672,7 +764,14 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   pipeline.AddPass<DynamicPadder>(dynamic_padder_options);
   if (!is_mlir_compile) {
     pipeline.AddPass<SelectAndScatterExpander>();
-    pipeline.AddPass<ScatterExpander>(ScatterExpander::kEliminateAllScatters);
+    // Single-operand scatters are emitted natively by the IrEmitter; only
+    // variadic ones are still lowered to while loops.
+    pipeline.AddPass<ScatterExpander>(
+        ScatterExpander::kEliminateAllScatters,
+        [](const HloInstruction* instruction) {
+          return Cast<HloScatterInstruction>(instruction)
+                     ->scatter_operand_count() > 1;
+        });
   }
   pipeline.AddPass<ConvCanonicalization>(target_machine_features);
 
@@ -737,7 +836,16 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   // support libcalls. Disable this for now.
   if (!is_mlir_compile) {
     pipeline.AddPass<TopkRewriter>([](const HloSortInstruction* sort, int64_t) {
-      return sort->operand(0)->shape().element_type() == F32;
+      switch (sort->operand(0)->shape().element_type()) {
+        case F32:
+        case F64:
+        case F16:
+        case BF16:
+        case S32:
+          return true;
+        default:
+          return false;
+      }
     });
   }
   pipeline.AddPass<IndexedArrayAnalysisPrinterPass>();
@@ -849,6 +957,16 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
   pipeline.AddPass<HloDCE>();
   pipeline.AddPass<CopyInsertion>();
   pipeline.AddPass<HloDCE>();
+  // Outline the entry computation into tasks that run concurrently. Like the
+  // ParallelTaskAssigner this needs a thread pool, so it is not run for AOT.
+  if (!is_aot_compile && !is_mlir_compile &&
+      module->config()
+          .debug_options()
+          .xla_cpu_enable_inter_op_parallelism() &&
+      !module->config().hlo_profiling_enabled()) {
+    pipeline.AddPass<TaskOutliner>();
+    pipeline.AddPass<HloDCE>();
+  }
   return pipeline.Run(module).status();
 }
 
@@ -896,7 +1014,8 @@ llvm::CodeGenOpt::Level CodeGenOptLevel(const HloModuleConfig& module_config) {
 std::pair<LLVMCompiler::ModuleHook, LLVMCompiler::ModuleHook> GetIRModuleHooks(
     const HloModule& hlo_module,
     const LLVMCompiler::ModuleHook& user_pre_optimization_hook,
-    const LLVMCompiler::ModuleHook& user_post_optimization_hook) {
+    const LLVMCompiler::ModuleHook& user_post_optimization_hook,
+    std::string dump_filename_suffix = "") {
   // Create the IR hooks. If applicable, each IR hook does the following:
   //
   //  * Calls the user supplied module hook.
@@ -904,14 +1023,15 @@ std::pair<LLVMCompiler::ModuleHook, LLVMCompiler::ModuleHook> GetIRModuleHooks(
   //    --xla_dump_to
   const HloModule* hlo_module_ptr = &hlo_module;
   auto hook = [user_pre_optimization_hook, user_post_optimization_hook,
-               hlo_module_ptr](bool optimized,
-                               const llvm::Module& llvm_module) {
+               hlo_module_ptr, dump_filename_suffix](
+                  bool optimized, const llvm::Module& llvm_module) {
     const auto& user_hook =
         !optimized ? user_pre_optimization_hook : user_post_optimization_hook;
     if (user_hook) {
       user_hook(llvm_module);
     }
-    llvm_ir::DumpIrIfEnabled(*hlo_module_ptr, llvm_module, optimized);
+    llvm_ir::DumpIrIfEnabled(*hlo_module_ptr, llvm_module, optimized,
+                             dump_filename_suffix);
   };
   return {[hook](const llvm::Module& llvm_module) {
             return hook(/*optimized=*/false, llvm_module);
@@ -1018,10 +1138,11 @@ namespace {
 struct OrcJITPostCompilationHook {
   // Gets an std::function that implements this hook.
   static std::function<void(const llvm::object::ObjectFile& obj_file)> Create(
-      const HloModule* module) {
+      const HloModule* module, std::string file_suffix = "o") {
     // This struct is not copyable, but std::functions must be.  So to create an
     // std::function out of this struct, we have to wrap it in a shared_ptr.
-    auto wrapped = std::make_shared<OrcJITPostCompilationHook>(module);
+    auto wrapped = std::make_shared<OrcJITPostCompilationHook>(
+        module, std::move(file_suffix));
     return [wrapped](const llvm::object::ObjectFile& obj_file) {
       (*wrapped)(obj_file);
     };
@@ -1029,20 +1150,21 @@ struct OrcJITPostCompilationHook {
 
   // Constructor can't be private because we want to call it from
   // std::make_shared, but users should call Create() instead.
-  explicit OrcJITPostCompilationHook(const HloModule* module)
-      : module(module) {}
+  OrcJITPostCompilationHook(const HloModule* module, std::string file_suffix)
+      : module(module), file_suffix(std::move(file_suffix)) {}
 
  private:
   void operator()(const llvm::object::ObjectFile& obj_file) {
     if (!DumpingEnabledForHloModule(*module)) {
       return;
     }
-    DumpToFileInDir(*module, /*file_prefix=*/"", /*file_suffix=*/"o",
+    DumpToFileInDir(*module, /*file_prefix=*/"", file_suffix,
                     absl::string_view(obj_file.getData().data(),
                                       obj_file.getData().size()));
   }
 
   const HloModule* module;
+  std::string file_suffix;
 };
 
 void InitializeLLVMCommandLineOptions(const HloModuleConfig& config) {
@@ -1240,10 +1362,250 @@ std::vector<ComputationToEmit> SubcomputationEmissionOrder(
   return postorder;
 }
 
+// Gives the functions and constants of `llvm_module` that may be compiled in a
+// different shard from their users external, hidden linkage, and returns the
+// number of functions that can be compiled independently. llvm::SplitModule
+// keeps local symbols in the shard of their users, and every embedded
+// computation is an internal function reachable from the entry computation, so
+// without this the whole module would end up in a single shard.
+//
+// Small functions that are called directly, e.g. reducers, stay internal so
+// that they are still inlined into their callers.
+int ExposeSymbolsForSplitting(llvm::Module& llvm_module) {
+  constexpr unsigned kMinInstructionsToSplit = 256;
+  int num_split_functions = 0;
+  for (llvm::Function& function : llvm_module.functions()) {
+    if (function.isDeclaration()) {
+      continue;
+    }
+    if (function.hasLocalLinkage() &&
+        (function.hasAddressTaken() ||
+         function.getInstructionCount() >= kMinInstructionsToSplit)) {
+      function.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      function.setVisibility(llvm::GlobalValue::HiddenVisibility);
+    }
+    if (!function.hasLocalLinkage()) {
+      ++num_split_functions;
+    }
+  }
+  for (llvm::GlobalVariable& global : llvm_module.globals()) {
+    if (!global.hasLocalLinkage()) {
+      continue;
+    }
+    if (!global.hasName()) {
+      global.setName("__xla_cpu_global");
+    }
+    global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    global.setVisibility(llvm::GlobalValue::HiddenVisibility);
+  }
+  return num_split_functions;
+}
+
+// Splits `llvm_module` into `num_shards` modules and returns them as bitcode,
+// so that each shard can be loaded into its own LLVMContext and compiled on a
+// different thread.
+std::vector<std::string> SplitModuleToBitcode(llvm::Module& llvm_module,
+                                              int num_shards) {
+  // Small constants are copied into every shard that uses them, so that loads
+  // from them can still be constant-folded. Larger ones, e.g. weights, are
+  // defined in one shard and referenced by the others.
+  constexpr uint64_t kMaxCopiedConstantBytes = 1024;
+  const llvm::DataLayout& data_layout = llvm_module.getDataLayout();
+  llvm::DenseMap<llvm::StringRef, llvm::Constant*> copied_constants;
+  for (llvm::GlobalVariable& global : llvm_module.globals()) {
+    if (global.isConstant() && global.hasInitializer() &&
+        !global.getInitializer()->needsRelocation() &&
+        data_layout.getTypeAllocSize(global.getValueType()).getFixedValue() <=
+            kMaxCopiedConstantBytes) {
+      copied_constants[global.getName()] = global.getInitializer();
+    }
+  }
+
+  std::vector<std::string> shards;
+  llvm::SplitModule(
+      llvm_module, num_shards,
+      [&](std::unique_ptr<llvm::Module> shard) {
+        for (llvm::GlobalVariable& global : shard->globals()) {
+          auto it = copied_constants.find(global.getName());
+          if (!global.hasInitializer() && it != copied_constants.end()) {
+            global.setInitializer(it->second);
+            global.setLinkage(llvm::GlobalValue::InternalLinkage);
+          }
+        }
+        std::string bitcode;
+        llvm::raw_string_ostream stream(bitcode);
+        llvm::WriteBitcodeToFile(*shard, stream);
+        stream.flush();
+        shards.push_back(std::move(bitcode));
+      },
+      /*PreserveLocals=*/true);
+  return shards;
+}
+
+// Splits `llvm_module` into `num_shards` shards, optimizes and compiles them to
+// object files in parallel on `thread_pool`, or on a pool of its own if that is
+// null, and adds the object files to `jit`. Records the time spent on each
+// shard in `compilation_stats`.
+Status CompileShardsInParallel(
+    const HloModule& hlo_module, llvm::Module& llvm_module, int num_shards,
+    const LLVMCompiler::ModuleHook& pre_optimization_ir_hook,
+    const LLVMCompiler::ModuleHook& user_post_optimization_hook,
+    tsl::thread::ThreadPool* thread_pool, SimpleOrcJIT& jit,
+    CompilationStats* compilation_stats) {
+  XLA_SCOPED_LOGGING_TIMER("CpuCompiler - Compiling LLVM module shards");
+  // Unoptimized IR is dumped for the whole module, before it is split.
+  pre_optimization_ir_hook(llvm_module);
+  std::vector<std::string> shards =
+      SplitModuleToBitcode(llvm_module, num_shards);
+
+  std::optional<tsl::thread::ThreadPool> own_thread_pool;
+  if (thread_pool == nullptr) {
+    own_thread_pool.emplace(tsl::Env::Default(), "xla_cpu_codegen",
+                            shards.size());
+    thread_pool = &*own_thread_pool;
+  }
+
+  // User hooks are not required to be thread-safe, so they see one optimized
+  // shard at a time.
+  absl::Mutex user_hook_mutex;
+  LLVMCompiler::ModuleHook serialized_user_hook;
+  if (user_post_optimization_hook) {
+    serialized_user_hook = [&](const llvm::Module& shard) {
+      absl::MutexLock lock(&user_hook_mutex);
+      user_post_optimization_hook(shard);
+    };
+  }
+
+  const HloModuleConfig& config = hlo_module.config();
+  auto compile_shard =
+      [&](int shard_number) -> StatusOr<std::unique_ptr<llvm::MemoryBuffer>> {
+    // Each shard gets its own context and target machine, since neither is
+    // thread-safe.
+    llvm::LLVMContext context;
+    llvm::Expected<std::unique_ptr<llvm::Module>> shard =
+        llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef(shards[shard_number], "shard"), context);
+    if (!shard) {
+      return InternalError("Loading LLVM module shard %d failed: %s",
+                           shard_number, llvm::toString(shard.takeError()));
+    }
+    std::unique_ptr<llvm::TargetMachine> target_machine =
+        SimpleOrcJIT::InferTargetMachineForJIT(CompilerTargetOptions(config),
+                                               CodeGenOptLevel(config));
+    CompilerFunctor compiler(
+        target_machine.get(), CodeGenOptLevel(config),
+        options::OptimizeForSizeRequested(config),
+        config.debug_options().xla_llvm_disable_expensive_passes(),
+        llvm_ir::GetCpuFastMathFlags(config),
+        /*pre_optimization_hook=*/nullptr,
+        GetIRModuleHooks(hlo_module, /*user_pre_optimization_hook=*/nullptr,
+                         serialized_user_hook,
+                         absl::StrCat("shard-", shard_number))
+            .second,
+        OrcJITPostCompilationHook::Create(&hlo_module,
+                                          absl::StrCat(shard_number, ".o")));
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> obj_file =
+        compiler(**shard);
+    if (!obj_file) {
+      return InternalError("Compiling LLVM module shard %d failed: %s",
+                           shard_number, llvm::toString(obj_file.takeError()));
+    }
+    return std::move(*obj_file);
+  };
+
+  std::vector<StatusOr<std::unique_ptr<llvm::MemoryBuffer>>> obj_files(
+      shards.size());
+  std::vector<double> compile_times_ms(shards.size());
+  tsl::BlockingCounter counter(shards.size());
+  for (int i = 0; i < shards.size(); ++i) {
+    thread_pool->Schedule([&, i] {
+      uint64_t start_micros = tsl::Env::Default()->NowMicros();
+      obj_files[i] = compile_shard(i);
+      compile_times_ms[i] =
+          (tsl::Env::Default()->NowMicros() - start_micros) / 1000.0;
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+
+  for (int i = 0; i < shards.size(); ++i) {
+    compilation_stats->RecordPass(absl::StrCat("llvm-codegen-shard-", i),
+                                  compile_times_ms[i]);
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<llvm::MemoryBuffer> obj_file,
+                        std::move(obj_files[i]));
+    if (llvm::Error error = jit.AddObjFile(std::move(obj_file))) {
+      return InternalError("Adding LLVM module shard %d to the JIT failed: %s",
+                           i, llvm::toString(std::move(error)));
+    }
+  }
+  return OkStatus();
+}
+
+// Returns the calls of the entry computation of `module` in the order of its
+// schedule if TaskOutliner has split the entry computation into them, so that
+// they can run as a task graph, and an empty vector otherwise.
+std::vector<const HloInstruction*> GetTaskCalls(const HloModule& module) {
+  if (!module.config().debug_options().xla_cpu_enable_inter_op_parallelism() ||
+      module.config().hlo_profiling_enabled()) {
+    return {};
+  }
+  std::vector<const HloInstruction*> calls;
+  absl::flat_hash_set<const HloComputation*> callees;
+  for (const HloInstruction* instruction :
+       module.schedule().sequence(module.entry_computation()).instructions()) {
+    if (instruction->opcode() == HloOpcode::kParameter) {
+      continue;
+    }
+    if (instruction->opcode() != HloOpcode::kCall ||
+        !callees.insert(instruction->to_apply()).second) {
+      return {};
+    }
+    // Calls outlined by the ParallelTaskAssigner take loop bounds and can't be
+    // called as tasks.
+    auto backend_config = instruction->to_apply()
+                              ->root_instruction()
+                              ->backend_config<BackendConfig>();
+    if (backend_config.ok() &&
+        !backend_config->outer_dimension_partitions().empty()) {
+      return {};
+    }
+    calls.push_back(instruction);
+  }
+  return calls;
+}
+
+// Builds the task graph of `calls`, see GetTaskCalls. A call depends on the
+// calls that produce its operands and on its control predecessors.
+TaskGraph BuildTaskGraph(
+    absl::Span<const HloInstruction* const> calls,
+    absl::FunctionRef<std::string(const HloComputation*)> function_name) {
+  absl::flat_hash_map<const HloInstruction*, int64_t> task_of;
+  for (int64_t i = 0; i < calls.size(); ++i) {
+    task_of[calls[i]] = i;
+  }
+  TaskGraph graph;
+  graph.tasks.resize(calls.size());
+  for (int64_t i = 0; i < calls.size(); ++i) {
+    graph.tasks[i].function_name = function_name(calls[i]->to_apply());
+    absl::flat_hash_set<int64_t> predecessors;
+    auto add_predecessor = [&](const HloInstruction* predecessor) {
+      auto it = task_of.find(predecessor);
+      if (it != task_of.end() && predecessors.insert(it->second).second) {
+        graph.tasks[it->second].successors.push_back(i);
+        ++graph.tasks[i].num_predecessors;
+      }
+    };
+    absl::c_for_each(calls[i]->operands(), add_predecessor);
+    absl::c_for_each(calls[i]->control_predecessors(), add_predecessor);
+  }
+  return graph;
+}
+
 }  // namespace
 
 StatusOr<std::unique_ptr<CpuExecutable>>
-CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
+CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module,
+                                        const CompileOptions& options) {
   ModuleHook pre_optimization_ir_hook;
   ModuleHook post_optimization_ir_hook;
   std::tie(pre_optimization_ir_hook, post_optimization_ir_hook) =
@@ -1264,7 +1626,8 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
       module->config().debug_options().xla_llvm_disable_expensive_passes(),
       llvm_ir::GetCpuFastMathFlags(module->config()), pre_optimization_ir_hook,
       post_optimization_ir_hook,
-      OrcJITPostCompilationHook::Create(module.get()));
+      OrcJITPostCompilationHook::Create(module.get()),
+      options.retain_object_files);
   if (!jit) {
     return InternalError("Creating JIT failed: %s",
                          llvm::toString(jit.takeError()));
@@ -1297,12 +1660,25 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
                       ScheduleModule(module.get(), BufferSizeBytesFunction(),
                                      ComputationSchedulerToModuleScheduler(
                                          DFSMemoryScheduler)));
+  // Keep the schedule in the module, so that the buffer assignment can be
+  // reproduced when a serialized executable is loaded.
+  TF_RETURN_IF_ERROR(module->set_schedule(schedule));
+
+  // The tasks of the entry computation, if any, run in any order that their
+  // dependencies allow, so only buffers of ordered instructions can share an
+  // allocation.
+  const std::vector<const HloInstruction*> task_calls = GetTaskCalls(*module);
+  std::unique_ptr<HloOrdering> hlo_ordering;
+  if (task_calls.empty()) {
+    hlo_ordering = std::make_unique<SequentialHloOrdering>(schedule);
+  } else {
+    hlo_ordering = std::make_unique<DependencyHloOrdering>(module.get());
+  }
 
   // Run buffer allocation on the HLO graph.
   TF_ASSIGN_OR_RETURN(
       std::unique_ptr<BufferAssignment> assignment,
-      BufferAssigner::Run(module.get(),
-                          std::make_unique<SequentialHloOrdering>(schedule),
+      BufferAssigner::Run(module.get(), std::move(hlo_ordering),
                           BufferSizeBytesFunction(), memory_alignment,
                           /*allocate_buffers_for_constants=*/true));
   DumpHloModuleIfEnabled(*module, *assignment,
@@ -1329,19 +1705,26 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
 
   TF_RETURN_IF_ERROR(ir_emitter.EmitConstantGlobals());
 
+  absl::flat_hash_map<const HloComputation*, llvm::Function*> task_functions;
+  for (const HloInstruction* call : task_calls) {
+    task_functions[call->to_apply()] = nullptr;
+  }
   for (ComputationToEmit subcomputation :
        SubcomputationEmissionOrder(entry_computation)) {
     if (subcomputation.computation->IsFusionComputation()) {
       continue;
     }
-    TF_RETURN_IF_ERROR(
-        ir_emitter
-            .EmitComputation(
-                subcomputation.computation, subcomputation.computation->name(),
-                /*is_top_level_computation=*/false,
-                schedule.sequence(subcomputation.computation).instructions(),
-                subcomputation.allow_reassociation)
-            .status());
+    TF_ASSIGN_OR_RETURN(
+        llvm::Function * function,
+        ir_emitter.EmitComputation(
+            subcomputation.computation, subcomputation.computation->name(),
+            /*is_top_level_computation=*/false,
+            schedule.sequence(subcomputation.computation).instructions(),
+            subcomputation.allow_reassociation));
+    auto task_function = task_functions.find(subcomputation.computation);
+    if (task_function != task_functions.end()) {
+      task_function->second = function;
+    }
   }
   absl::string_view function_name_prefix = entry_computation->name().empty()
                                                ? "__compute"
@@ -1353,13 +1736,23 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
                           schedule.sequence(entry_computation).instructions(),
                           /*allow_reassociation=*/false));
 
-  function_name = [&]() {
+  auto mangled_name = [&](const llvm::Function* function) {
     llvm::SmallVector<char, 40> function_name_vector;
     llvm::Mangler::getNameWithPrefix(
-        function_name_vector, entry_function->getName(), (*jit)->data_layout());
+        function_name_vector, function->getName(), (*jit)->data_layout());
     return std::string(function_name_vector.begin(),
                        function_name_vector.end());
-  }();
+  };
+  function_name = mangled_name(entry_function);
+
+  // The entry function calls the tasks one after the other; the executable
+  // can also call them directly, so they must be visible in the JIT.
+  TaskGraph task_graph =
+      BuildTaskGraph(task_calls, [&](const HloComputation* callee) {
+        llvm::Function* function = task_functions.at(callee);
+        function->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        return mangled_name(function);
+      });
 
   std::string ir_module_string;
   if (embed_ir_in_executable) {
@@ -1368,14 +1761,41 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
 
   TF_RETURN_IF_ERROR(VerifyLlvmModule(*llvm_module));
 
-  // JIT compile the LLVM IR module to in-memory machine code.
-  llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
-                                                 std::move(llvm_context));
-  cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  // JIT compile the LLVM IR module to in-memory machine code, in parallel
+  // shards if requested and there is more than one function to compile.
+  const int split_count =
+      module->config().debug_options().xla_cpu_parallel_codegen_split_count();
+  int num_shards = 1;
+  if (split_count > 1) {
+    num_shards =
+        std::min(split_count, ExposeSymbolsForSplitting(*llvm_module));
+  }
+  if (num_shards > 1) {
+    // The shard timings go to the caller's stats; without them they are only
+    // logged.
+    std::unique_ptr<CompilationStats> own_compilation_stats;
+    CompilationStats* compilation_stats = options.compilation_stats;
+    if (compilation_stats == nullptr) {
+      own_compilation_stats = CompilationStats::MakeStats();
+      compilation_stats = own_compilation_stats.get();
+    }
+    TF_RETURN_IF_ERROR(CompileShardsInParallel(
+        *module, *llvm_module, num_shards, pre_optimization_ir_hook,
+        user_post_optimization_hook_, options.thread_pool, **jit,
+        compilation_stats));
+    if (own_compilation_stats != nullptr && VLOG_IS_ON(1)) {
+      own_compilation_stats->CompilationReport();
+    }
+  } else {
+    llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
+                                                   std::move(llvm_context));
+    cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  }
 
   auto cpu_executable = std::make_unique<CpuExecutable>(
       std::move(*jit), std::move(assignment), std::move(module), function_name,
-      std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map));
+      std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map),
+      std::move(task_graph));
 
   if (embed_ir_in_executable) {
     cpu_executable->set_ir_module_string(ir_module_string);
@@ -1486,7 +1906,7 @@ CpuCompiler::CompileXlaRuntimeCpuExecutable(
 StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
     std::unique_ptr<HloModule> module,
     [[maybe_unused]] se::StreamExecutor* stream_exec,
-    [[maybe_unused]] const CompileOptions& options) {
+    const CompileOptions& options) {
   VLOG(1) << "Compiling: " << module->name();
   XLA_SCOPED_LOGGING_TIMER(
       absl::StrFormat("Compiling [%s] for CPU using JIT", module->name()));
@@ -1503,7 +1923,7 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
                         CompileXlaRuntimeCpuExecutable(std::move(module)));
   } else {
     TF_ASSIGN_OR_RETURN(cpu_executable,
-                        CompileLegacyCpuExecutable(std::move(module)));
+                        CompileLegacyCpuExecutable(std::move(module), options));
   }
 
   cpu_executable->set_debug_info(
@@ -1794,6 +2214,129 @@ HloCostAnalysis::ShapeSizeFunction CpuCompiler::ShapeSizeBytesFunction() const {
                               : CpuExecutable::ShapeSizeBytes;
 }
 
+namespace {
+
+// Fingerprints where every HLO value lives in the buffer table. Values are
+// identified by instruction name, which unlike instruction ids survives an
+// HloModuleProto round trip.
+uint64_t BufferAssignmentFingerprint(const BufferAssignment& assignment) {
+  std::string description;
+  for (const BufferAllocation& allocation : assignment.Allocations()) {
+    std::vector<std::string> values;
+    for (const auto& [value, offset_size] : allocation.assigned_buffers()) {
+      values.push_back(absl::StrCat(value->instruction()->name(),
+                                    value->index().ToString(), "@",
+                                    offset_size.offset, "+", offset_size.size));
+    }
+    absl::c_sort(values);
+    absl::StrAppend(&description, allocation.index(), ":", allocation.size(),
+                    ":", absl::StrJoin(values, ","), ";");
+  }
+  return tsl::Fingerprint64(description);
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<Executable>>
+CpuLegacyAotCompilationResult::LoadExecutable(
+    Compiler* compiler, se::StreamExecutor* executor) const {
+  const HloModuleProto& module_proto =
+      legacy_cpu_executable_.hlo_module_proto();
+  TF_ASSIGN_OR_RETURN(HloModuleConfig hlo_module_config,
+                      HloModule::CreateModuleConfigFromProto(
+                          module_proto, GetDebugOptionsFromFlags()));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloModule> hlo_module,
+      HloModule::CreateFromProto(module_proto, hlo_module_config));
+  TF_RET_CHECK(hlo_module->has_schedule());
+
+  const HloModuleConfig& config = hlo_module->config();
+  auto jit = SimpleOrcJIT::Create(
+      CompilerTargetOptions(config), CodeGenOptLevel(config),
+      options::OptimizeForSizeRequested(config),
+      config.debug_options().xla_llvm_disable_expensive_passes(),
+      llvm_ir::GetCpuFastMathFlags(config),
+      /*pre_optimization_hook=*/nullptr, /*post_optimization_hook=*/nullptr,
+      /*post_codegen_hook=*/nullptr, /*retain_obj_files=*/false);
+  if (!jit) {
+    return InternalError("Creating JIT failed: %s",
+                         llvm::toString(jit.takeError()));
+  }
+  const llvm::TargetMachine* target_machine = (*jit)->target_machine();
+  if (target_machine->getTargetTriple().str() !=
+          legacy_cpu_executable_.target_triple() ||
+      target_machine->getTargetCPU() != legacy_cpu_executable_.target_cpu() ||
+      target_machine->getTargetFeatureString() !=
+          legacy_cpu_executable_.target_features()) {
+    return FailedPrecondition(
+        "Serialized executable was compiled for %s (%s), but this host is %s "
+        "(%s)",
+        legacy_cpu_executable_.target_triple(),
+        legacy_cpu_executable_.target_cpu(),
+        target_machine->getTargetTriple().str(),
+        target_machine->getTargetCPU().str());
+  }
+
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<BufferAssignment> assignment,
+      BufferAssigner::Run(
+          hlo_module.get(),
+          std::make_unique<SequentialHloOrdering>(hlo_module->schedule()),
+          compiler->BufferSizeBytesFunction(), memory_alignment,
+          /*allocate_buffers_for_constants=*/true));
+  if (BufferAssignmentFingerprint(*assignment) !=
+      legacy_cpu_executable_.buffer_assignment_fingerprint()) {
+    return FailedPrecondition(
+        "Buffer assignment of the deserialized module %s does not match the "
+        "one its code was compiled against",
+        hlo_module->name());
+  }
+
+  for (const std::string& obj_file : legacy_cpu_executable_.obj_files()) {
+    // The JIT keeps a copy of every object it loads, so the buffer doesn't
+    // need to outlive this call.
+    if (llvm::Error error = (*jit)->AddObjFile(
+            llvm::MemoryBuffer::getMemBufferCopy(obj_file))) {
+      return InternalError("Loading object file failed: %s",
+                           llvm::toString(std::move(error)));
+    }
+  }
+
+  // Linking happens on the first lookup, which CpuExecutable treats as
+  // infallible, e.g. objects may refer to a runtime function that this build
+  // doesn't have.
+  llvm::Expected<llvm::orc::ExecutorSymbolDef> entry_function =
+      (*jit)->FindCompiledSymbol(legacy_cpu_executable_.entry_function_name());
+  if (!entry_function) {
+    return InternalError("Linking deserialized executable failed: %s",
+                         llvm::toString(entry_function.takeError()));
+  }
+
+  auto cpu_executable = std::make_unique<CpuExecutable>(
+      std::move(*jit), std::move(assignment), std::move(hlo_module),
+      legacy_cpu_executable_.entry_function_name(),
+      /*hlo_profile_printer_data=*/nullptr,
+      /*hlo_profile_index_map=*/nullptr);
+  auto hlo_proto = std::make_unique<HloProto>();
+  *hlo_proto->mutable_hlo_module() = cpu_executable->module().ToProto();
+  *hlo_proto->mutable_buffer_assignment() =
+      cpu_executable->buffer_assignment().ToProto();
+  cpu_executable->set_hlo_proto(std::move(hlo_proto));
+  return std::unique_ptr<Executable>(std::move(cpu_executable));
+}
+
+StatusOr<std::unique_ptr<AotCompilationResult>>
+CpuCompiler::LoadAotCompilationResult(
+    const std::string& serialized_aot_result) {
+  LegacyCpuExecutableProto legacy_cpu_executable;
+  if (legacy_cpu_executable.ParseFromString(serialized_aot_result) &&
+      legacy_cpu_executable.has_hlo_module_proto()) {
+    return std::make_unique<CpuLegacyAotCompilationResult>(
+        std::move(legacy_cpu_executable));
+  }
+  return CpuXlaRuntimeAotCompilationResult::FromString(serialized_aot_result);
+}
+
 StatusOr<std::unique_ptr<AotCompilationResult>> CpuCompiler::Export(
     Executable* executable) const {
   auto* cpu_executable = tensorflow::down_cast<CpuExecutable*>(executable);
@@ -1801,6 +2344,42 @@ StatusOr<std::unique_ptr<AotCompilationResult>> CpuCompiler::Export(
     return Internal("Could not downcast Executable to CpuExecutable");
 
   HloModuleProto module_proto = cpu_executable->module().ToProto();
+  if (!cpu_executable->IsXlaRuntime()) {
+    if (cpu_executable->hlo_profiling_enabled()) {
+      return Unimplemented(
+          "Exporting CPU executables with HLO profiling is not supported");
+    }
+    if (cpu_executable->has_task_graph()) {
+      return Unimplemented(
+          "Exporting CPU executables with inter-op parallelism is not "
+          "supported");
+    }
+    TF_RET_CHECK(cpu_executable->module().has_schedule());
+    if (!cpu_executable->retains_legacy_obj_files()) {
+      return FailedPrecondition(
+          "The CPU executable did not keep its object files; compile it with "
+          "CompileOptions::retain_object_files to export it");
+    }
+    TF_ASSIGN_OR_RETURN(absl::Span<const std::string> obj_files,
+                        cpu_executable->GetLegacyObjFiles());
+    LegacyCpuExecutableProto proto;
+    *proto.mutable_hlo_module_proto() = std::move(module_proto);
+    for (const std::string& obj_file : obj_files) {
+      proto.add_obj_files(obj_file);
+    }
+    proto.set_entry_function_name(cpu_executable->entry_function_name());
+    std::unique_ptr<llvm::TargetMachine> target_machine =
+        SimpleOrcJIT::InferTargetMachineForJIT(
+            CompilerTargetOptions(cpu_executable->module().config()),
+            CodeGenOptLevel(cpu_executable->module().config()));
+    proto.set_target_triple(target_machine->getTargetTriple().str());
+    proto.set_target_cpu(target_machine->getTargetCPU().str());
+    proto.set_target_features(target_machine->getTargetFeatureString().str());
+    proto.set_buffer_assignment_fingerprint(
+        BufferAssignmentFingerprint(cpu_executable->buffer_assignment()));
+    return std::make_unique<CpuLegacyAotCompilationResult>(std::move(proto));
+  }
+
   TF_ASSIGN_OR_RETURN(auto obj_file, cpu_executable->GetObjFile());
   TF_ASSIGN_OR_RETURN(auto mlir_module, cpu_executable->GetMlirModule());
   TF_ASSIGN_OR_RETURN(XlaFrameworkMapping xla_framework_mapping,
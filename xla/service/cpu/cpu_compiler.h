@@ -19,6 +19,7 @@ limitations under the License.
 #include <memory>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include "llvm/Target/TargetMachine.h"
@@ -119,6 +120,24 @@ class CpuXlaRuntimeAotCompilationResult : public AotCompilationResult {
   XlaRuntimeCpuExecutableProto xla_runtime_cpu_executable_;
 };
 
+// A legacy CpuExecutable in serialized form: its HLO module and the object
+// files its JIT loaded. Loading it skips all of HLO optimization and codegen.
+class CpuLegacyAotCompilationResult : public AotCompilationResult {
+ public:
+  explicit CpuLegacyAotCompilationResult(LegacyCpuExecutableProto executable)
+      : legacy_cpu_executable_(std::move(executable)) {}
+
+  StatusOr<std::string> SerializeAsString() const override {
+    return legacy_cpu_executable_.SerializeAsString();
+  }
+
+  StatusOr<std::unique_ptr<Executable>> LoadExecutable(
+      Compiler* compiler, se::StreamExecutor* executor) const override;
+
+ private:
+  LegacyCpuExecutableProto legacy_cpu_executable_;
+};
+
 class CpuAotCompilationResult : public AotCompilationResult {
  public:
   CpuAotCompilationResult(
@@ -197,9 +216,7 @@ class CpuCompiler : public LLVMCompiler {
   // Returns a (deserialized) AotCompilationResult from a serialized
   // AotCompilationResult.
   StatusOr<std::unique_ptr<AotCompilationResult>> LoadAotCompilationResult(
-      const std::string& serialized_aot_result) override {
-    return CpuXlaRuntimeAotCompilationResult::FromString(serialized_aot_result);
-  }
+      const std::string& serialized_aot_result) override;
 
   StatusOr<std::unique_ptr<CpuExecutable>> CompileXlaRuntimeCpuExecutable(
       std::unique_ptr<HloModule> module);
@@ -226,7 +243,7 @@ class CpuCompiler : public LLVMCompiler {
       LLVMTargetMachineFeatures* target_machine_features, bool is_mlir_compile);
 
   StatusOr<std::unique_ptr<CpuExecutable>> CompileLegacyCpuExecutable(
-      std::unique_ptr<HloModule> module);
+      std::unique_ptr<HloModule> module, const CompileOptions& options);
 
   CpuCompiler(const CpuCompiler&) = delete;
   CpuCompiler& operator=(const CpuCompiler&) = delete;
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "xla/service/cpu/cpu_executable.h"
 
+#define EIGEN_USE_THREADS
+
 #include <stdint.h>
 
 #include <algorithm>
@@ -33,11 +35,14 @@ limitations under the License.
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"  // from @llvm-project
 #include "mlir/Parser/Parser.h"  // from @llvm-project
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/mlir/runtime/transforms/compiler.h"
 #include "xla/service/buffer_assignment.h"
 #include "xla/service/computation_layout.h"
+#include "xla/service/cpu/roofline_profile.h"
+#include "xla/service/dump.h"
 #include "xla/service/logical_buffer.h"
 #include "xla/service/maybe_owning_device_memory.h"
 #include "xla/service/shaped_buffer.h"
@@ -52,6 +57,7 @@ limitations under the License.
 #include "xla/xla_data.pb.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/logging.h"
+#include "tsl/platform/profile_utils/cpu_utils.h"
 
 namespace xla {
 namespace cpu {
@@ -64,12 +70,15 @@ CpuExecutable::CpuExecutable(
     std::unique_ptr<HloModule> hlo_module,
     const std::string& entry_function_name,
     std::unique_ptr<HloProfilePrinterData> hlo_profile_printer_data,
-    std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map)
+    std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map,
+    TaskGraph task_graph)
     : Executable(std::move(hlo_module), std::move(hlo_profile_printer_data),
                  std::move(hlo_profile_index_map)),
       jit_(std::move(jit)),
       assignment_(std::move(assignment)),
-      module_name_(entry_function_name) {
+      module_name_(entry_function_name),
+      entry_function_name_(entry_function_name),
+      task_graph_(std::move(task_graph)) {
   if (assignment_) {
     buffer_assignment_ =
         std::make_shared<BufferAssignmentProto>(assignment_->ToProto());
@@ -92,6 +101,14 @@ CpuExecutable::CpuExecutable(
       reinterpret_cast<ComputeFunctionType>(sym->getAddress().getValue());
   VLOG(1) << "compute_function_ at address "
           << reinterpret_cast<void*>(compute_function_);
+  for (const TaskGraph::Task& task : task_graph_.tasks) {
+    llvm::Expected<llvm::orc::ExecutorSymbolDef> task_sym =
+        jit_->FindCompiledSymbol(task.function_name);
+    CHECK(task_sym->getAddress())
+        << "Symbol " << task.function_name << " not found.";
+    task_functions_.push_back(
+        reinterpret_cast<TaskFunction>(task_sym->getAddress().getValue()));
+  }
   jit_->DoneCompiling();
 }
 
@@ -244,6 +261,15 @@ Status CpuExecutable::ExecuteComputeFunction(
     if (!status.ok()) {
       return status;
     }
+  } else if (has_task_graph() && run_options->intra_op_thread_pool() &&
+             profile_counters == nullptr) {
+    // The tasks take the buffer table only, like the entry function.
+    Status status = RunTaskGraph(task_graph_, task_functions_, run_options,
+                                 buffer_pointers.data());
+    record_profile();
+    if (!status.ok()) {
+      return status;
+    }
   } else {
     XlaCustomCallStatus status;
     // For the entry computation (like all global computations), all inputs and
@@ -257,11 +283,37 @@ Status CpuExecutable::ExecuteComputeFunction(
     if (error_message) {
       return InternalError("CustomCall failed: %s", *error_message);
     }
+    if (hlo_execution_profile) {
+      ReportRooflineProfile(*run_options, *hlo_execution_profile);
+    }
   }
 
   return OkStatus();
 }
 
+void CpuExecutable::ReportRooflineProfile(
+    const ExecutableRunOptions& run_options,
+    const HloExecutionProfile& hlo_execution_profile) const {
+  // The HLOs run on the intra-op thread pool, so that is the roof.
+  const int num_threads = run_options.intra_op_thread_pool()
+                              ? run_options.intra_op_thread_pool()->numThreads()
+                              : 1;
+  // The profile counters count cycles of the same counter as the host
+  // executor's nominal clock rate.
+  const double clock_rate_ghz =
+      tsl::profile_utils::CpuUtils::GetCycleCounterFrequency() / 1e9;
+  RooflineProfile profile = BuildRooflineProfile(
+      hlo_profile_printer_data(), hlo_execution_profile.profile_counters(),
+      clock_rate_ghz, GetHostPeaks(num_threads), num_threads);
+  std::string text = RooflineProfileToString(profile);
+  XLA_LOG_LINES(tsl::INFO, text);
+  DumpToFileInDir(module(), /*file_prefix=*/"",
+                  /*file_suffix=*/"cpu_roofline_profile.txt", text);
+  DumpToFileInDir(module(), /*file_prefix=*/"",
+                  /*file_suffix=*/"cpu_roofline_profile.pb",
+                  profile.SerializeAsString());
+}
+
 StatusOr<std::unique_ptr<Executable>> CpuExecutable::LoadFromObjFile(
     std::unique_ptr<HloModule> hlo_module, absl::string_view obj_file,
     absl::string_view mlir_module,
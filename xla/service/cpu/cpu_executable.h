@@ -32,6 +32,7 @@ limitations under the License.
 #include "xla/runtime/jit_executable.h"
 #include "xla/service/buffer_assignment.h"
 #include "xla/service/cpu/simple_orc_jit.h"
+#include "xla/service/cpu/task_graph.h"
 #include "xla/service/cpu/xla_framework.h"
 #include "xla/service/custom_call_status_internal.h"
 #include "xla/service/executable.h"
@@ -154,7 +155,8 @@ class CpuExecutable : public Executable {
                 std::unique_ptr<HloModule> hlo_module,
                 const std::string& entry_function_name,
                 std::unique_ptr<HloProfilePrinterData> hlo_profile_printer_data,
-                std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map);
+                std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map,
+                TaskGraph task_graph = {});
   // XLA Runtime constructor.
   CpuExecutable(
       std::unique_ptr<HloModule> hlo_module,
@@ -231,6 +233,27 @@ class CpuExecutable : public Executable {
     return xla_runtime_executable_->xla_framework_mapping();
   }
 
+  // Whether this is a legacy (non XLA Runtime) executable that kept its object
+  // files, i.e. was compiled with CompileOptions::retain_object_files.
+  bool retains_legacy_obj_files() const {
+    return !IsXlaRuntime() && jit_->retains_obj_files();
+  }
+
+  // Returns the object files of a legacy (non XLA Runtime) executable, which
+  // together define the entry function.
+  StatusOr<absl::Span<const std::string>> GetLegacyObjFiles() const {
+    if (IsXlaRuntime()) return InternalError("Not a legacy CPU executable");
+    return absl::Span<const std::string>(jit_->obj_files());
+  }
+
+  const std::string& entry_function_name() const {
+    return entry_function_name_;
+  }
+
+  // Returns true if the entry computation also runs as a graph of tasks, see
+  // TaskOutliner.
+  bool has_task_graph() const { return !task_graph_.tasks.empty(); }
+
  private:
   // Creates an array suitable for passing as the "buffer_table" argument to the
   // JIT compiled function pointer.
@@ -266,6 +289,12 @@ class CpuExecutable : public Executable {
   // computation. Uses dataflow analysis from buffer assignment.
   const InstructionValueSet& GetRootValueSet() const;
 
+  // Logs the roofline profile of an execution with HLO profiling and dumps it,
+  // as text and as a RooflineProfile proto, to the dump directory, if any.
+  void ReportRooflineProfile(
+      const ExecutableRunOptions& run_options,
+      const HloExecutionProfile& hlo_execution_profile) const;
+
   // The JIT containing compiled modules.
   const std::unique_ptr<SimpleOrcJIT> jit_;
 
@@ -288,6 +317,12 @@ class CpuExecutable : public Executable {
   // Entry function name for the computation.
   const std::string entry_function_name_;
 
+  // The tasks of the entry computation, if any, and their compiled functions.
+  // When an intra-op thread pool is available, they run in place of
+  // compute_function_, which calls them one after the other.
+  const TaskGraph task_graph_;
+  std::vector<TaskFunction> task_functions_;
+
   // If not null, XLA Runtime is enabled.
   std::unique_ptr<XlaRuntimeCpuExecutable> xla_runtime_executable_;
 
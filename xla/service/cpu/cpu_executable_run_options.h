@@ -0,0 +1,45 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_CPU_EXECUTABLE_RUN_OPTIONS_H_
+#define XLA_SERVICE_CPU_CPU_EXECUTABLE_RUN_OPTIONS_H_
+
+namespace xla {
+namespace cpu {
+
+class CollectivesInterface;
+
+// CPU-specific executable options.
+// We keep these separate from ExecutableRunOptions to avoid adding
+// dependencies to ExecutableRunOptions.
+class CpuExecutableRunOptions {
+ public:
+  // If set, collectives are run through `collectives`, which may connect
+  // devices of different processes. Otherwise they are run between the devices
+  // of this process only. Does not take ownership.
+  CpuExecutableRunOptions& set_collectives(CollectivesInterface* collectives) {
+    collectives_ = collectives;
+    return *this;
+  }
+  CollectivesInterface* collectives() const { return collectives_; }
+
+ private:
+  CollectivesInterface* collectives_ = nullptr;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_CPU_EXECUTABLE_RUN_OPTIONS_H_
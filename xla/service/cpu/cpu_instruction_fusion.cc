@@ -42,10 +42,19 @@ bool CanBeLoopFused(const HloInstruction& hlo) {
          hlo.opcode() == HloOpcode::kTranspose;
 }
 
+// Mixed-precision dots (e.g. s8 x s8 -> s32) are excluded: the fused dot
+// emitters expect the operands to have the result type.
+bool IsSameTypeDot(const HloInstruction* hlo) {
+  return hlo->opcode() == HloOpcode::kDot &&
+         absl::c_all_of(hlo->operands(), [&](const HloInstruction* operand) {
+           return ShapeUtil::SameElementType(operand->shape(), hlo->shape());
+         });
+}
+
 bool IsNonComplexNonBatchedMatrixVectorDot(const HloInstruction* hlo) {
   const Shape& hlo_shape = hlo->shape();
-  return !ShapeUtil::ElementIsComplex(hlo_shape) &&
-         hlo->opcode() == HloOpcode::kDot && hlo_shape.dimensions_size() <= 1 &&
+  return !ShapeUtil::ElementIsComplex(hlo_shape) && IsSameTypeDot(hlo) &&
+         hlo_shape.dimensions_size() <= 1 &&
          hlo->dot_dimension_numbers().lhs_batch_dimensions_size() == 0;
 }
 
@@ -141,7 +150,7 @@ FusionDecision CpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
     // fusion can easily be overshadowed by the overhead of a naive GEMM
     // algorithm in the IR.
     const Shape& output_shape = consumer->shape();
-    if (output_shape.dimensions_size() <= 1) {
+    if (output_shape.dimensions_size() <= 1 && IsSameTypeDot(consumer)) {
       // We fuse in cases where we have a matrix*vector or vector*matrix dot and
       // fusion can get rid of the larger tensor.  We assume that a naive
       // traversal of a small enough (to fit in L1) column or row tensor is
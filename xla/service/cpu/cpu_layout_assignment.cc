@@ -21,6 +21,7 @@ limitations under the License.
 #include "xla/map_util.h"
 #include "xla/service/cpu/dot_op_emitter.h"
 #include "xla/service/cpu/ir_emission_utils.h"
+#include "xla/shape_util.h"
 #include "tsl/platform/errors.h"
 
 namespace xla {
@@ -80,9 +81,15 @@ static optional<int64_t> ShouldMakeOperandColumnMajor(
 
 static Shape RowMajorShape(const Shape& old_shape) {
   Shape new_shape(old_shape);
-  std::vector<int64_t> dimension_order(new_shape.dimensions_size());
-  std::iota(dimension_order.rbegin(), dimension_order.rend(), 0);
-  *new_shape.mutable_layout() = LayoutUtil::MakeLayout(dimension_order);
+  ShapeUtil::ForEachMutableSubshape(
+      &new_shape, [](Shape* subshape, const ShapeIndex& /*index*/) {
+        if (!subshape->IsArray()) {
+          return;
+        }
+        std::vector<int64_t> dimension_order(subshape->dimensions_size());
+        std::iota(dimension_order.rbegin(), dimension_order.rend(), 0);
+        *subshape->mutable_layout() = LayoutUtil::MakeLayout(dimension_order);
+      });
   return new_shape;
 }
 
@@ -103,8 +110,14 @@ static bool OperandsAndResultMustHaveRowMajorLayout(
   } else if (instr.opcode() == HloOpcode::kDot) {
     return DotOperandsAndResultMustHaveRowMajorLayout(instr,
                                                       target_machine_features);
+  } else if (instr.opcode() == HloOpcode::kAllGather ||
+             instr.opcode() == HloOpcode::kReduceScatter) {
+    // The runtime functions require the operand and the result to share a
+    // layout.
+    return instr.shape().IsArray();
   }
-  return false;
+  return CanEmitLinalgAsRuntimeCall(instr) ||
+         CanEmitRngBitGeneratorAsRuntimeCall(instr);
 }
 
 Status CpuLayoutAssignment::AddBackendConstraints(
@@ -29,23 +29,32 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/base/dynamic_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "xla/executable_run_options.h"
 #include "xla/layout_util.h"
 #include "xla/primitive_util.h"
 #include "xla/refcounting_hash_map.h"
 #include "xla/service/collective_ops_utils.h"
 #include "xla/service/computation_placer.h"
+#include "xla/service/cpu/collective_reduction.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/cpu/cpu_executable_run_options.h"
 #include "xla/service/cpu/xfeed_manager.h"
 #include "xla/service/hlo_parser.h"
 #include "xla/shape_util.h"
 #include "xla/statusor.h"
 #include "xla/stream_executor/device_memory.h"
 #include "xla/stream_executor/stream_executor.h"
+#include "xla/types.h"
+#include "xla/util.h"
+#include "tsl/platform/float8.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/status.h"
 #include "tsl/profiler/lib/traceme.h"
@@ -78,6 +87,10 @@ extern const char* const kEigenMatMulC128SymbolName =
     "__xla_cpu_runtime_EigenMatMulC128";
 extern const char* const kEigenMatMulS32SymbolName =
     "__xla_cpu_runtime_EigenMatMulS32";
+extern const char* const kEigenMatMulS8S32SymbolName =
+    "__xla_cpu_runtime_EigenMatMulS8S32";
+extern const char* const kEigenMatMulBF16F32SymbolName =
+    "__xla_cpu_runtime_EigenMatMulBF16F32";
 extern const char* const kEigenBatchMatMulF32SymbolName =
     "__xla_cpu_runtime_EigenBatchMatMulF32";
 extern const char* const kMKLConv2DF32SymbolName =
@@ -104,9 +117,35 @@ extern const char* const kEigenConv3DF16SymbolName =
     "__xla_cpu_runtime_EigenConv3DF16";
 extern const char* const kEigenConv3DF32SymbolName =
     "__xla_cpu_runtime_EigenConv3DF32";
+extern const char* const kDirectConvF16SymbolName =
+    "__xla_cpu_runtime_DirectConvF16";
+extern const char* const kDirectConvF32SymbolName =
+    "__xla_cpu_runtime_DirectConvF32";
+extern const char* const kDirectConvS8S32SymbolName =
+    "__xla_cpu_runtime_DirectConvS8S32";
+extern const char* const kDirectConvS8S8SymbolName =
+    "__xla_cpu_runtime_DirectConvS8S8";
+extern const char* const kPhiloxBitGeneratorSymbolName =
+    "__xla_cpu_runtime_PhiloxBitGenerator";
+extern const char* const kThreeFryBitGeneratorSymbolName =
+    "__xla_cpu_runtime_ThreeFryBitGenerator";
 extern const char* const kEigenFftSymbolName = "__xla_cpu_runtime_EigenFft";
 extern const char* const kEigenSingleThreadedFftSymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedFft";
+extern const char* const kEigenCholeskySymbolName =
+    "__xla_cpu_runtime_EigenCholesky";
+extern const char* const kEigenTriangularSolveSymbolName =
+    "__xla_cpu_runtime_EigenTriangularSolve";
+extern const char* const kEigenQrSymbolName = "__xla_cpu_runtime_EigenQr";
+extern const char* const kEigenEighSymbolName = "__xla_cpu_runtime_EigenEigh";
+extern const char* const kEigenSingleThreadedCholeskySymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedCholesky";
+extern const char* const kEigenSingleThreadedTriangularSolveSymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedTriangularSolve";
+extern const char* const kEigenSingleThreadedQrSymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedQr";
+extern const char* const kEigenSingleThreadedEighSymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedEigh";
 extern const char* const kEigenSingleThreadedMatMulF16SymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedMatMulF16";
 extern const char* const kEigenSingleThreadedMatMulF32SymbolName =
@@ -119,6 +158,10 @@ extern const char* const kEigenSingleThreadedMatMulC128SymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedMatMulC128";
 extern const char* const kEigenSingleThreadedMatMulS32SymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedMatMulS32";
+extern const char* const kEigenSingleThreadedMatMulS8S32SymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedMatMulS8S32";
+extern const char* const kEigenSingleThreadedMatMulBF16F32SymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedMatMulBF16F32";
 extern const char* const kEigenSingleThreadedConv2DF16SymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedConv2DF16";
 extern const char* const kEigenSingleThreadedConv2DF32SymbolName =
@@ -143,13 +186,22 @@ extern const char* const kStatusIsSuccessSymbolName =
     "__xla_cpu_runtime_StatusIsSuccess";
 extern const char* const kKeyValueSortSymbolName =
     "__xla_cpu_runtime_KeyValueSort";
+extern const char* const kKeyValueRadixSortSymbolName =
+    "__xla_cpu_runtime_KeyValueRadixSort";
 extern const char* const kTopKF32SymbolName = "__xla_cpu_runtime_TopKF32";
+extern const char* const kTopKF64SymbolName = "__xla_cpu_runtime_TopKF64";
+extern const char* const kTopKF16SymbolName = "__xla_cpu_runtime_TopKF16";
+extern const char* const kTopKBF16SymbolName = "__xla_cpu_runtime_TopKBF16";
+extern const char* const kTopKS32SymbolName = "__xla_cpu_runtime_TopKS32";
 extern const char* const kTracingStartSymbolName =
     "__xla_cpu_runtime_TracingStart";
 extern const char* const kTracingEndSymbolName = "__xla_cpu_runtime_TracingEnd";
 extern const char* const kXlaCpuRuntimeSymbolNamePrefix = "__xla_cpu_runtime_";
 extern const char* const kAllReduceSymbolName = "__xla_cpu_runtime_AllReduce";
 extern const char* const kAllToAllSymbolName = "__xla_cpu_runtime_AllToAll";
+extern const char* const kAllGatherSymbolName = "__xla_cpu_runtime_AllGather";
+extern const char* const kReduceScatterSymbolName =
+    "__xla_cpu_runtime_ReduceScatter";
 extern const char* const kCollectivePermuteSymbolName =
     "__xla_cpu_runtime_CollectivePermute";
 extern const char* const kPartitionIdSymbolName =
@@ -158,11 +210,6 @@ extern const char* const kReplicaIdSymbolName = "__xla_cpu_runtime_ReplicaId";
 
 namespace {
 
-template <class T>
-struct is_complex : std::false_type {};
-template <class T>
-struct is_complex<std::complex<T>> : std::true_type {};
-
 struct CollectivePermuteParticipantData : ParticipantData {
   CollectivePermuteParticipantData(const RendezvousKey& rendezvous_key_p,
                                    int64_t device_ordinal_p,
@@ -226,6 +273,61 @@ struct AllToAllParticipantData : ParticipantData {
   }
 };
 
+struct AllGatherParticipantData : ParticipantData {
+  AllGatherParticipantData(const RendezvousKey& rendezvous_key_p,
+                           int64_t device_ordinal_p, se::Stream* stream_p)
+      : ParticipantData(rendezvous_key_p),
+        device_ordinal(device_ordinal_p),
+        stream(stream_p) {}
+
+  int64_t device_ordinal;
+  se::Stream* stream;
+  // Position of the participant in its replica group.
+  int rank;
+  int64_t num_blocks;
+  int64_t block_size;
+  se::DeviceMemoryBase source_buffer;
+  se::DeviceMemoryBase destination_buffer;
+
+  std::string ToString() const override {
+    return absl::StrFormat(
+        "AllGatherParticipantData{rank=%d, num_blocks=%d, block_size=%d, "
+        "source_buffer=%p, destination_buffer=%p, device_ordinal=%d, "
+        "stream=%p}",
+        rank, num_blocks, block_size, source_buffer.opaque(),
+        destination_buffer.opaque(), device_ordinal, stream);
+  }
+};
+
+struct ReduceScatterParticipantData : ParticipantData {
+  ReduceScatterParticipantData(const RendezvousKey& rendezvous_key_p,
+                               int64_t device_ordinal_p, se::Stream* stream_p)
+      : ParticipantData(rendezvous_key_p),
+        device_ordinal(device_ordinal_p),
+        stream(stream_p) {}
+
+  int64_t device_ordinal;
+  se::Stream* stream;
+  // Position of the participant in its replica group.
+  int rank;
+  ReductionKind reduction_kind;
+  PrimitiveType element_type;
+  int64_t num_blocks;
+  int64_t chunk_elements;
+  se::DeviceMemoryBase source_buffer;
+  se::DeviceMemoryBase destination_buffer;
+
+  std::string ToString() const override {
+    return absl::StrFormat(
+        "ReduceScatterParticipantData{rank=%d, element_type=%s, "
+        "num_blocks=%d, chunk_elements=%d, source_buffer=%p, "
+        "destination_buffer=%p, device_ordinal=%d, stream=%p}",
+        rank, primitive_util::LowercasePrimitiveTypeName(element_type),
+        num_blocks, chunk_elements, source_buffer.opaque(),
+        destination_buffer.opaque(), device_ordinal, stream);
+  }
+};
+
 // Inverses the encoding of a Shape protobuf into an LLVM global variable.
 StatusOr<Shape> DecodeSelfDescribingShapeConstant(const void* shape_ptr,
                                                   int32_t size_bytes) {
@@ -363,6 +465,12 @@ class CpuCollectivePermuteRendezvous
   }
 };
 
+// All-reduce implemented as a reduce-scatter followed by an all-gather: every
+// buffer is split into one contiguous shard per participant, each participant
+// thread reduces its own shard over all inputs and writes the result straight
+// into the corresponding shard of every participant's output. All participant
+// threads thus do an equal share of the work concurrently, and every input
+// element is read exactly once.
 class CpuAllReduceRendezvous
     : public Rendezvous<AllReduceParticipantData, std::nullptr_t> {
  public:
@@ -373,184 +481,168 @@ class CpuAllReduceRendezvous
   StatusOr<std::nullptr_t> RunCollectiveOp(
       const AllReduceParticipantData& participant) override {
     PrimitiveType datatype = participant.buffers.front().primitive_type;
-    bool primary = InitializationBarrier();
-
-    if (primary) {
-      switch (datatype) {
-        case S8:
-          DoAllReduce<S8>(participant);
-          break;
-        case PRED:
-        case U8:
-          DoAllReduce<U8>(participant);
-          break;
-        case S16:
-          DoAllReduce<S16>(participant);
-          break;
-        case U16:
-          DoAllReduce<U16>(participant);
-          break;
-        case S32:
-          DoAllReduce<S32>(participant);
-          break;
-        case U32:
-          DoAllReduce<U32>(participant);
-          break;
-        case S64:
-          DoAllReduce<S64>(participant);
-          break;
-        case U64:
-          DoAllReduce<U64>(participant);
-          break;
-        case F16:
-          DoAllReduce<F16>(participant);
-          break;
-        case F32:
-          DoAllReduce<F32>(participant);
-          break;
-        case F64:
-          DoAllReduce<F64>(participant);
-          break;
-        case C64:
-          DoAllReduce<C64>(participant);
-          break;
-        case C128:
-          DoAllReduce<C128>(participant);
-          break;
-        default:
-          LOG(FATAL) << "Unexpected datatype;";
-      }
-    }
+    ReductionTypeSwitch(datatype, [&](auto primitive_type) {
+      DoAllReduce<decltype(primitive_type)::value>(participant);
+    });
+    // The Rendezvous only lets participants return once every participant has
+    // finished RunCollectiveOp, so all shards of our outputs are written by
+    // then.
     return nullptr;
   }
 
  private:
   template <PrimitiveType PT>
-  void DoAllReduce(AllReduceParticipantData participant) {
+  void DoAllReduce(const AllReduceParticipantData& participant) {
     using T = typename primitive_util::PrimitiveTypeToNative<PT>::type;
-    absl::MutexLock lock(&mu_);
-    CHECK(!participants_.empty());
-    ReductionKind reduction_kind = participant.reduction_kind;
-    for (const auto& p : participants_) {
-      CHECK(p.reduction_kind == reduction_kind);
-    }
-    int num_participants = participants_.size();
 
-    // participant_idx -> buffer_idx -> buffer.
-    std::vector<std::vector<absl::Span<T>>> input_buffers;
-    std::vector<std::vector<absl::Span<T>>> output_buffers;
-    input_buffers.reserve(num_participants);
-    output_buffers.reserve(num_participants);
-    const AllReduceParticipantData& first_participant = participants_.front();
+    // All participants have arrived, so `participants_` no longer changes. Take
+    // a snapshot so that the reduction itself runs without holding `mu_`.
+    std::vector<AllReduceParticipantData> participants;
+    {
+      absl::MutexLock lock(&mu_);
+      participants = participants_;
+    }
+    CHECK(!participants.empty());
+    // Participants arrive in no particular order. Order them by device so
+    // that every element is reduced in the same, deterministic order.
+    absl::c_sort(participants, [](const AllReduceParticipantData& a,
+                                  const AllReduceParticipantData& b) {
+      return a.device_ordinal < b.device_ordinal;
+    });
 
+    ReductionKind reduction_kind = participant.reduction_kind;
+    int num_participants = participants.size();
+    int rank = -1;
+    const AllReduceParticipantData& first_participant = participants.front();
     int buffers_per_participant = first_participant.buffers.size();
-    for (AllReduceParticipantData& p : participants_) {
+    for (int i = 0; i < num_participants; ++i) {
+      const AllReduceParticipantData& p = participants[i];
+      CHECK(p.reduction_kind == reduction_kind);
       CHECK_EQ(p.buffers.size(), buffers_per_participant);
-
-      input_buffers.emplace_back();
-      output_buffers.emplace_back();
-      std::vector<absl::Span<T>>& participant_input_buffers =
-          input_buffers.back();
-      std::vector<absl::Span<T>>& participant_output_buffers =
-          output_buffers.back();
-      participant_input_buffers.reserve(p.buffers.size());
-      participant_output_buffers.reserve(p.buffers.size());
-
-      for (int buffer_idx = 0; buffer_idx < buffers_per_participant;
-           buffer_idx++) {
-        auto& participant_buffer = p.buffers[buffer_idx];
-        participant_input_buffers.emplace_back(
-            static_cast<T*>(participant_buffer.source_data.opaque()),
-            participant_buffer.element_count);
-        participant_output_buffers.emplace_back(
-            static_cast<T*>(participant_buffer.destination_data.opaque()),
-            participant_buffer.element_count);
-        CHECK_EQ(participant_buffer.element_count,
-                 first_participant.buffers[buffer_idx].element_count);
+      if (p.device_ordinal == participant.device_ordinal) {
+        rank = i;
       }
     }
+    CHECK_GE(rank, 0);
 
+    // Align shard boundaries to cache lines so that participants never write
+    // to the same cache line.
+    constexpr int64_t kElementsPerCacheLine =
+        std::max<int64_t>(1, 64 / sizeof(T));
+
+    std::vector<const T*> inputs(num_participants);
+    std::vector<T*> outputs(num_participants);
     for (int buffer_idx = 0; buffer_idx < buffers_per_participant;
          buffer_idx++) {
-      int element_count = first_participant.buffers[buffer_idx].element_count;
-      for (int idx = 0; idx < element_count; idx++) {
-        T out = GetInitialValue<T>(reduction_kind);
-        for (int participant_idx = 0; participant_idx < participants_.size();
-             participant_idx++) {
-          out = PerformReductionStep<T>(
-              reduction_kind, out,
-              input_buffers[participant_idx][buffer_idx][idx]);
-        }
-        for (int participant_idx = 0; participant_idx < participants_.size();
-             participant_idx++) {
-          output_buffers[participant_idx][buffer_idx][idx] = out;
-        }
+      int64_t element_count =
+          first_participant.buffers[buffer_idx].element_count;
+      for (int i = 0; i < num_participants; ++i) {
+        const AllReduceParticipantData::Buffer& buffer =
+            participants[i].buffers[buffer_idx];
+        CHECK_EQ(buffer.element_count, element_count);
+        inputs[i] = static_cast<const T*>(buffer.source_data.opaque());
+        outputs[i] = static_cast<T*>(buffer.destination_data.opaque());
       }
+
+      int64_t shard_size = RoundUpTo<int64_t>(
+          CeilOfRatio<int64_t>(element_count, num_participants),
+          kElementsPerCacheLine);
+      int64_t begin = std::min(rank * shard_size, element_count);
+      int64_t end = std::min(begin + shard_size, element_count);
+      ReduceShard<T>(reduction_kind, inputs, outputs, begin, end);
     }
   }
+};
+
+// Every participant copies its own source buffer into its chunk of every
+// participant's destination buffer, so all copies run concurrently.
+class CpuAllGatherRendezvous
+    : public Rendezvous<AllGatherParticipantData, std::nullptr_t> {
+ public:
+  explicit CpuAllGatherRendezvous(const RendezvousKey& k)
+      : Rendezvous<AllGatherParticipantData, std::nullptr_t>(k) {}
 
-  template <typename T>
-  T GetInitialValue(ReductionKind reduction_kind) {
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return static_cast<T>(0);
-      case ReductionKind::PRODUCT:
-        return static_cast<T>(1);
-      case ReductionKind::MIN:
-        return std::numeric_limits<T>::max();
-      case ReductionKind::MAX:
-        return std::numeric_limits<T>::min();
+ protected:
+  StatusOr<std::nullptr_t> RunCollectiveOp(
+      const AllGatherParticipantData& participant) override {
+    std::vector<AllGatherParticipantData> participants;
+    {
+      absl::MutexLock lock(&mu_);
+      participants = participants_;
     }
+    int64_t num_participants = participants.size();
+    int64_t block_size = participant.block_size;
+    const char* source =
+        static_cast<const char*>(participant.source_buffer.opaque());
+    for (const AllGatherParticipantData& p : participants) {
+      CHECK_EQ(p.num_blocks, participant.num_blocks);
+      CHECK_EQ(p.block_size, block_size);
+      char* destination = static_cast<char*>(p.destination_buffer.opaque());
+      for (int64_t b = 0; b < participant.num_blocks; ++b) {
+        std::memcpy(
+            destination + (b * num_participants + participant.rank) *
+                              block_size,
+            source + b * block_size, block_size);
+      }
+    }
+    return nullptr;
   }
+};
 
-  template <typename T, bool kIsSignedIntegralType>
-  struct SumProductTypeForReductionStep {
-    using type = T;
-  };
+// Every participant reduces its own chunk over all participants' inputs
+// straight into its output buffer.
+class CpuReduceScatterRendezvous
+    : public Rendezvous<ReduceScatterParticipantData, std::nullptr_t> {
+ public:
+  explicit CpuReduceScatterRendezvous(const RendezvousKey& k)
+      : Rendezvous<ReduceScatterParticipantData, std::nullptr_t>(k) {}
 
-  template <typename T>
-  struct SumProductTypeForReductionStep<T, /*kIsSignedIntegralType=*/true> {
-    using type = typename std::make_unsigned_t<T>;
-  };
+ protected:
+  StatusOr<std::nullptr_t> RunCollectiveOp(
+      const ReduceScatterParticipantData& participant) override {
+    ReductionTypeSwitch(participant.element_type, [&](auto primitive_type) {
+      DoReduceScatter<decltype(primitive_type)::value>(participant);
+    });
+    return nullptr;
+  }
 
-  template <typename T,
-            typename std::enable_if<!is_complex<T>::value>::type* = nullptr>
-  T PerformReductionStep(ReductionKind reduction_kind, T a, T b) {
-    using SumProductType = typename SumProductTypeForReductionStep<
-        T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) +
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::PRODUCT:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) *
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::MIN:
-        return std::min(a, b);
-      case ReductionKind::MAX:
-        return std::max(a, b);
+ private:
+  template <PrimitiveType PT>
+  void DoReduceScatter(const ReduceScatterParticipantData& participant) {
+    using T = typename primitive_util::PrimitiveTypeToNative<PT>::type;
+    std::vector<ReduceScatterParticipantData> participants;
+    {
+      absl::MutexLock lock(&mu_);
+      participants = participants_;
+    }
+    // Reduce in replica group order, which is the same for every chunk.
+    absl::c_sort(participants, [](const ReduceScatterParticipantData& a,
+                                  const ReduceScatterParticipantData& b) {
+      return a.rank < b.rank;
+    });
+    int64_t num_participants = participants.size();
+    int64_t chunk_elements = participant.chunk_elements;
+    for (const ReduceScatterParticipantData& p : participants) {
+      CHECK(p.reduction_kind == participant.reduction_kind);
+      CHECK_EQ(p.element_type, participant.element_type);
+      CHECK_EQ(p.num_blocks, participant.num_blocks);
+      CHECK_EQ(p.chunk_elements, chunk_elements);
     }
-  }
 
-  template <typename T,
-            typename std::enable_if<is_complex<T>::value>::type* = nullptr>
-  T PerformReductionStep(ReductionKind reduction_kind, T a, T b) {
-    using SumProductType = typename SumProductTypeForReductionStep<
-        T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) +
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::PRODUCT:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) *
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::MIN:
-      case ReductionKind::MAX:
-        LOG(FATAL) << "min/max not valid for complex types";
+    std::vector<const T*> inputs(num_participants);
+    T* output = static_cast<T*>(participant.destination_buffer.opaque());
+    for (int64_t b = 0; b < participant.num_blocks; ++b) {
+      int64_t offset = (b * num_participants + participant.rank) *
+                       chunk_elements;
+      for (int64_t i = 0; i < num_participants; ++i) {
+        inputs[i] =
+            static_cast<const T*>(participants[i].source_buffer.opaque()) +
+            offset;
+      }
+      T* block_output = output + b * chunk_elements;
+      ReduceShard<T>(participant.reduction_kind, inputs,
+                     absl::MakeConstSpan(&block_output, 1), 0,
+                     chunk_elements);
     }
   }
 };
@@ -576,6 +668,20 @@ GlobalAllToAllRendezvousMap() {
   return m;
 }
 
+RefcountingHashMap<RendezvousKey, CpuAllGatherRendezvous>&
+GlobalAllGatherRendezvousMap() {
+  static auto& m =
+      *new RefcountingHashMap<RendezvousKey, CpuAllGatherRendezvous>;
+  return m;
+}
+
+RefcountingHashMap<RendezvousKey, CpuReduceScatterRendezvous>&
+GlobalReduceScatterRendezvousMap() {
+  static auto& m =
+      *new RefcountingHashMap<RendezvousKey, CpuReduceScatterRendezvous>;
+  return m;
+}
+
 RendezvousKey GetRendezvousKey(const ExecutableRunOptions* run_options,
                                std::vector<ReplicaGroup> group,
                                int32_t channel_id_present,
@@ -598,6 +704,37 @@ RendezvousKey GetRendezvousKey(const ExecutableRunOptions* run_options,
                        num_local_participants, op_kind, op_id};
 }
 
+// Returns the position of the calling device in the rendezvous' participating
+// devices, i.e. in its replica group.
+int GetRankInGroup(const ExecutableRunOptions* run_options,
+                   const RendezvousKey& rendezvous_key) {
+  GlobalDeviceId device_id(GetDeviceOrdinal(run_options));
+  auto it = absl::c_find(rendezvous_key.global_devices, device_id);
+  CHECK(it != rendezvous_key.global_devices.end());
+  return it - rendezvous_key.global_devices.begin();
+}
+
+// How long a participant waits for the other participants of a collective that
+// runs through a CollectivesInterface.
+constexpr absl::Duration kCollectiveTimeout = absl::Minutes(30);
+
+// Returns the communicator of the calling device for the devices of
+// `rendezvous_key` if the collectives run through a CollectivesInterface, or
+// nullptr if they run between the devices of this process.
+std::shared_ptr<CollectivesCommunicator> GetCommunicator(
+    const ExecutableRunOptions* run_options,
+    const RendezvousKey& rendezvous_key) {
+  const CpuExecutableRunOptions* cpu_run_options =
+      run_options->cpu_executable_run_options();
+  if (cpu_run_options == nullptr || cpu_run_options->collectives() == nullptr) {
+    return nullptr;
+  }
+  return cpu_run_options->collectives()
+      ->GetCommunicator(rendezvous_key.global_devices,
+                        GetRankInGroup(run_options, rendezvous_key))
+      .value();
+}
+
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
 void* AcquireInfeedBufferForDequeueImpl(const ExecutableRunOptions* run_options,
                                         int32_t buffer_length,
@@ -690,6 +827,16 @@ void AllToAllImpl(const ExecutableRunOptions* run_options,
   RendezvousKey rendezvous_key =
       GetRendezvousKey(run_options, group, channel_id_present,
                        /*use_global_device_ids=*/std::nullopt, op_id);
+  if (std::shared_ptr<CollectivesCommunicator> communicator =
+          GetCommunicator(run_options, rendezvous_key)) {
+    std::vector<const void*> inputs(source_buffers,
+                                    source_buffers + num_buffers);
+    TF_CHECK_OK(communicator->AllToAll(
+        rendezvous_key, buffer_size, inputs,
+        absl::MakeConstSpan(destination_buffers, num_buffers),
+        kCollectiveTimeout));
+    return;
+  }
 
   AllToAllParticipantData participant(rendezvous_key, device_ordinal,
                                       run_options->stream());
@@ -743,6 +890,18 @@ void AllReduceImpl(const ExecutableRunOptions* run_options,
   CHECK((num_buffers > 1 && shape.IsTuple()) ||
         (num_buffers == 1 && LayoutUtil::IsDenseArray(shape)));
 
+  if (std::shared_ptr<CollectivesCommunicator> communicator =
+          GetCommunicator(run_options, rendezvous_key)) {
+    for (int i = 0; i < num_buffers; i++) {
+      Shape subshape = num_buffers == 1 ? shape : shape.tuple_shapes(i);
+      TF_CHECK_OK(communicator->AllReduce(
+          rendezvous_key, static_cast<ReductionKind>(reduction_kind),
+          subshape.element_type(), ShapeUtil::ElementsIn(subshape),
+          input_buffers[i], output_buffers[i], kCollectiveTimeout));
+    }
+    return;
+  }
+
   AllReduceParticipantData participant(rendezvous_key, device_ordinal,
                                        run_options->stream());
   participant.reduction_kind = static_cast<ReductionKind>(reduction_kind);
@@ -771,6 +930,105 @@ void AllReduceImpl(const ExecutableRunOptions* run_options,
                   .status());
 }
 
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
+void AllGatherImpl(const ExecutableRunOptions* run_options,
+                   int32_t channel_id_present, int32_t use_global_device_ids,
+                   int64_t op_id, const void* replica_groups_str,
+                   int32_t replica_groups_str_size, int64_t num_blocks,
+                   int64_t block_size, void* source_buffer,
+                   void* destination_buffer) {
+  int device_ordinal = GetDeviceOrdinal(run_options);
+  absl::string_view replica_groups_serialized(
+      static_cast<const char*>(replica_groups_str), replica_groups_str_size);
+  std::vector<ReplicaGroup> group =
+      ParseReplicaGroupsOnly(replica_groups_serialized).value();
+  RendezvousKey rendezvous_key = GetRendezvousKey(
+      run_options, group, channel_id_present, use_global_device_ids, op_id);
+  int64_t num_participants = rendezvous_key.global_devices.size();
+  if (std::shared_ptr<CollectivesCommunicator> communicator =
+          GetCommunicator(run_options, rendezvous_key)) {
+    TF_CHECK_OK(communicator->AllGather(rendezvous_key, num_blocks, block_size,
+                                        source_buffer, destination_buffer,
+                                        kCollectiveTimeout));
+    return;
+  }
+
+  AllGatherParticipantData participant(rendezvous_key, device_ordinal,
+                                       run_options->stream());
+  participant.rank = GetRankInGroup(run_options, rendezvous_key);
+  participant.num_blocks = num_blocks;
+  participant.block_size = block_size;
+  participant.source_buffer =
+      se::DeviceMemoryBase(source_buffer, num_blocks * block_size);
+  participant.destination_buffer = se::DeviceMemoryBase(
+      destination_buffer, num_blocks * num_participants * block_size);
+
+  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
+    return std::make_unique<CpuAllGatherRendezvous>(k);
+  };
+  TF_CHECK_OK(CpuAllGatherRendezvous::SubmitParticipant(
+                  [&] {
+                    return GlobalAllGatherRendezvousMap().GetOrCreateIfAbsent(
+                        rendezvous_key, make_cpu_rendezvous);
+                  },
+                  participant)
+                  .status());
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
+void ReduceScatterImpl(const ExecutableRunOptions* run_options,
+                       const void* replica_groups_str,
+                       int32_t replica_groups_str_size,
+                       int32_t channel_id_present,
+                       int32_t use_global_device_ids, int64_t op_id,
+                       int32_t reduction_kind, int32_t element_type,
+                       int64_t num_blocks, int64_t chunk_elements,
+                       void* input_buffer, void* output_buffer) {
+  int device_ordinal = GetDeviceOrdinal(run_options);
+  absl::string_view replica_groups_serialized(
+      static_cast<const char*>(replica_groups_str), replica_groups_str_size);
+  std::vector<ReplicaGroup> group =
+      ParseReplicaGroupsOnly(replica_groups_serialized).value();
+  RendezvousKey rendezvous_key = GetRendezvousKey(
+      run_options, group, channel_id_present, use_global_device_ids, op_id);
+  int64_t num_participants = rendezvous_key.global_devices.size();
+  PrimitiveType type = static_cast<PrimitiveType>(element_type);
+  int64_t chunk_bytes =
+      chunk_elements * ShapeUtil::ByteSizeOfPrimitiveType(type);
+  if (std::shared_ptr<CollectivesCommunicator> communicator =
+          GetCommunicator(run_options, rendezvous_key)) {
+    TF_CHECK_OK(communicator->ReduceScatter(
+        rendezvous_key, static_cast<ReductionKind>(reduction_kind), type,
+        num_blocks, chunk_elements, input_buffer, output_buffer,
+        kCollectiveTimeout));
+    return;
+  }
+
+  ReduceScatterParticipantData participant(rendezvous_key, device_ordinal,
+                                           run_options->stream());
+  participant.rank = GetRankInGroup(run_options, rendezvous_key);
+  participant.reduction_kind = static_cast<ReductionKind>(reduction_kind);
+  participant.element_type = type;
+  participant.num_blocks = num_blocks;
+  participant.chunk_elements = chunk_elements;
+  participant.source_buffer = se::DeviceMemoryBase(
+      input_buffer, num_blocks * num_participants * chunk_bytes);
+  participant.destination_buffer =
+      se::DeviceMemoryBase(output_buffer, num_blocks * chunk_bytes);
+
+  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
+    return std::make_unique<CpuReduceScatterRendezvous>(k);
+  };
+  TF_CHECK_OK(
+      CpuReduceScatterRendezvous::SubmitParticipant(
+          [&] {
+            return GlobalReduceScatterRendezvousMap().GetOrCreateIfAbsent(
+                rendezvous_key, make_cpu_rendezvous);
+          },
+          participant)
+          .status());
+}
+
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
 void ReplicaIdImpl(const ExecutableRunOptions* run_options,
                    void* output_buffer) {
@@ -810,6 +1068,7 @@ void CollectivePermuteImpl(const ExecutableRunOptions* run_options,
       channel_id_present ? logical_id.computation_id : logical_id.replica_id;
 
   std::vector<int> copy_to;
+  std::optional<int> copy_from;
   for (auto& p : pairs) {
     std::vector<std::string> mapping = absl::StrSplit(p, '=');
     CHECK_EQ(mapping.size(), 2);
@@ -818,10 +1077,22 @@ void CollectivePermuteImpl(const ExecutableRunOptions* run_options,
     if (from == logical_device_id) {
       copy_to.push_back(to);
     }
+    if (to == logical_device_id) {
+      copy_from = from;
+    }
   }
   RendezvousKey rendezvous_key =
       GetRendezvousKey(run_options, {}, channel_id_present,
                        /*use_global_device_ids=*/std::nullopt, op_id);
+  // The participating devices are all replicas (or partitions) in order, so
+  // the rank of a device is its logical id.
+  if (std::shared_ptr<CollectivesCommunicator> communicator =
+          GetCommunicator(run_options, rendezvous_key)) {
+    TF_CHECK_OK(communicator->CollectivePermute(
+        rendezvous_key, byte_size, copy_from, copy_to, input_buffer,
+        output_buffer, kCollectiveTimeout));
+    return;
+  }
 
   CollectivePermuteParticipantData participant(rendezvous_key, device_ordinal,
                                                run_options->stream());
@@ -927,6 +1198,32 @@ void __xla_cpu_runtime_AllReduce(const xla::ExecutableRunOptions* run_options,
       shape_ptr, shape_length, num_buffers, input_buffers, output_buffers);
 }
 
+void __xla_cpu_runtime_AllGather(const xla::ExecutableRunOptions* run_options,
+                                 int32_t channel_id_present,
+                                 int32_t use_global_device_ids, int64_t op_id,
+                                 const void* replica_groups_str,
+                                 int32_t replica_groups_str_size,
+                                 int64_t num_blocks, int64_t block_size,
+                                 void* source_buffer,
+                                 void* destination_buffer) {
+  return xla::cpu::runtime::AllGatherImpl(
+      run_options, channel_id_present, use_global_device_ids, op_id,
+      replica_groups_str, replica_groups_str_size, num_blocks, block_size,
+      source_buffer, destination_buffer);
+}
+
+void __xla_cpu_runtime_ReduceScatter(
+    const xla::ExecutableRunOptions* run_options,
+    const void* replica_groups_str, int32_t replica_groups_str_size,
+    int32_t channel_id_present, int32_t use_global_device_ids, int64_t op_id,
+    int32_t reduction_kind, int32_t element_type, int64_t num_blocks,
+    int64_t chunk_elements, void* input_buffer, void* output_buffer) {
+  return xla::cpu::runtime::ReduceScatterImpl(
+      run_options, replica_groups_str, replica_groups_str_size,
+      channel_id_present, use_global_device_ids, op_id, reduction_kind,
+      element_type, num_blocks, chunk_elements, input_buffer, output_buffer);
+}
+
 void __xla_cpu_runtime_ReplicaId(const xla::ExecutableRunOptions* run_options,
                                  void* output_buffer) {
   return xla::cpu::runtime::ReplicaIdImpl(run_options, output_buffer);
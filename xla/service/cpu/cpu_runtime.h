@@ -47,6 +47,8 @@ extern const char* const kEigenMatMulF64SymbolName;
 extern const char* const kEigenMatMulC64SymbolName;
 extern const char* const kEigenMatMulC128SymbolName;
 extern const char* const kEigenMatMulS32SymbolName;
+extern const char* const kEigenMatMulS8S32SymbolName;
+extern const char* const kEigenMatMulBF16F32SymbolName;
 extern const char* const kEigenBatchMatMulF32SymbolName;
 extern const char* const kMKLConv2DF32SymbolName;
 extern const char* const kACLConv2DF32SymbolName;
@@ -60,14 +62,30 @@ extern const char* const kEigenConv2DF16SymbolName;
 extern const char* const kEigenConv2DF32SymbolName;
 extern const char* const kEigenConv3DF16SymbolName;
 extern const char* const kEigenConv3DF32SymbolName;
+extern const char* const kDirectConvF16SymbolName;
+extern const char* const kDirectConvF32SymbolName;
+extern const char* const kDirectConvS8S32SymbolName;
+extern const char* const kDirectConvS8S8SymbolName;
+extern const char* const kPhiloxBitGeneratorSymbolName;
+extern const char* const kThreeFryBitGeneratorSymbolName;
 extern const char* const kEigenFftSymbolName;
 extern const char* const kEigenSingleThreadedFftSymbolName;
+extern const char* const kEigenCholeskySymbolName;
+extern const char* const kEigenTriangularSolveSymbolName;
+extern const char* const kEigenQrSymbolName;
+extern const char* const kEigenEighSymbolName;
+extern const char* const kEigenSingleThreadedCholeskySymbolName;
+extern const char* const kEigenSingleThreadedTriangularSolveSymbolName;
+extern const char* const kEigenSingleThreadedQrSymbolName;
+extern const char* const kEigenSingleThreadedEighSymbolName;
 extern const char* const kEigenSingleThreadedMatMulF16SymbolName;
 extern const char* const kEigenSingleThreadedMatMulF32SymbolName;
 extern const char* const kEigenSingleThreadedMatMulF64SymbolName;
 extern const char* const kEigenSingleThreadedMatMulC64SymbolName;
 extern const char* const kEigenSingleThreadedMatMulC128SymbolName;
 extern const char* const kEigenSingleThreadedMatMulS32SymbolName;
+extern const char* const kEigenSingleThreadedMatMulS8S32SymbolName;
+extern const char* const kEigenSingleThreadedMatMulBF16F32SymbolName;
 extern const char* const kEigenSingleThreadedConv2DF16SymbolName;
 extern const char* const kEigenSingleThreadedConv2DF32SymbolName;
 extern const char* const kEigenSingleThreadedConv3DF16SymbolName;
@@ -80,7 +98,12 @@ extern const char* const kParallelForkJoinSymbolName;
 extern const char* const kPrintfToStderrSymbolName;
 extern const char* const kStatusIsSuccessSymbolName;
 extern const char* const kKeyValueSortSymbolName;
+extern const char* const kKeyValueRadixSortSymbolName;
 extern const char* const kTopKF32SymbolName;
+extern const char* const kTopKF64SymbolName;
+extern const char* const kTopKF16SymbolName;
+extern const char* const kTopKBF16SymbolName;
+extern const char* const kTopKS32SymbolName;
 extern const char* const kAllReduceSymbolName;
 extern const char* const kCollectivePermuteSymbolName;
 extern const char* const kPartitionIdSymbolName;
@@ -88,6 +111,8 @@ extern const char* const kReplicaIdSymbolName;
 extern const char* const kTracingStartSymbolName;
 extern const char* const kTracingEndSymbolName;
 extern const char* const kAllToAllSymbolName;
+extern const char* const kAllGatherSymbolName;
+extern const char* const kReduceScatterSymbolName;
 
 // All symbol names for XLA CPU runtime functions need to start with this
 // prefix.
@@ -198,6 +223,35 @@ extern void __xla_cpu_runtime_AllToAll(
     int32_t replica_groups_str_size, int32_t num_buffers, int64_t buffer_size,
     void** source_buffers, void** destination_buffers);
 
+// Perform all gather on a CPU.
+//
+// The destination buffer is made of `num_blocks` blocks, each holding one
+// `block_size`-byte chunk per participant in replica group order. Participant
+// `i` copies block `b` of its source buffer into chunk `i` of block `b` of
+// every participant's destination buffer. `num_blocks` is the product of the
+// dimensions that are more major than the all-gather dimension.
+extern void __xla_cpu_runtime_AllGather(
+    const xla::ExecutableRunOptions* run_options, int32_t channel_id_present,
+    int32_t use_global_device_ids, int64_t op_id,
+    const void* replica_groups_str, int32_t replica_groups_str_size,
+    int64_t num_blocks, int64_t block_size, void* source_buffer,
+    void* destination_buffer);
+
+// Perform reduce scatter on a CPU.
+//
+// The input buffer is made of `num_blocks` blocks, each holding one
+// `chunk_elements`-element chunk per participant in replica group order.
+// Participant `i` reduces chunk `i` of every block over all participants'
+// input buffers into the corresponding block of its output buffer.
+// reduction_kind: operator used for a reduction, cf. ReductionKind.
+// element_type: the PrimitiveType of the input and output buffers.
+extern void __xla_cpu_runtime_ReduceScatter(
+    const xla::ExecutableRunOptions* run_options,
+    const void* replica_groups_str, int32_t replica_groups_str_size,
+    int32_t channel_id_present, int32_t use_global_device_ids, int64_t op_id,
+    int32_t reduction_kind, int32_t element_type, int64_t num_blocks,
+    int64_t chunk_elements, void* input_buffer, void* output_buffer);
+
 // Write the partition ID into the output buffer.
 extern void __xla_cpu_runtime_PartitionId(
     const xla::ExecutableRunOptions* run_options, void* output_buffer);
@@ -15,24 +15,34 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 #include "xla/service/cpu/cpu_runtime.h"
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "absl/strings/str_format.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "xla/array2d.h"
 #include "xla/client/local_client.h"
+#include "xla/executable_run_options.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/computation_placer.h"
 #include "xla/service/cpu/runtime_custom_call_status.h"
 #include "xla/service/cpu/runtime_matmul.h"
 #include "xla/service/cpu/runtime_matmul_acl.h"
 #include "xla/service/cpu/runtime_matmul_mkl.h"
 #include "xla/service/cpu/runtime_single_threaded_matmul.h"
 #include "xla/service/custom_call_status_internal.h"
+#include "xla/shape_util.h"
 #include "xla/types.h"
+#include "tsl/platform/blocking_counter.h"
 #include "tsl/platform/env.h"
+#include "tsl/platform/float8.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
@@ -169,6 +179,114 @@ INSTANTIATE_TEST_SUITE_P(EigenMatMulTestInstantiaion, EigenMatMulTest,
                                             ::testing::Bool()),
                          EigenMatMulTest::Name);
 
+// Runs the s8 x s8 -> s32 or bf16 x bf16 -> f32 runtime matmul on column-major
+// operands that are transposed in memory if requested.
+void MixedPrecisionMatMul(int32_t* out, int8_t* lhs, int8_t* rhs, int64_t m,
+                          int64_t n, int64_t k, bool transpose_lhs,
+                          bool transpose_rhs, bool single_threaded) {
+  if (single_threaded) {
+    __xla_cpu_runtime_EigenSingleThreadedMatMulS8S32(
+        nullptr, out, lhs, rhs, m, n, k, transpose_lhs, transpose_rhs);
+    return;
+  }
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "XLAEigen", 2);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  __xla_cpu_runtime_EigenMatMulS8S32(&run_options, out, lhs, rhs, m, n, k,
+                                     transpose_lhs, transpose_rhs);
+}
+
+void MixedPrecisionMatMul(float* out, Eigen::bfloat16* lhs,
+                          Eigen::bfloat16* rhs, int64_t m, int64_t n,
+                          int64_t k, bool transpose_lhs, bool transpose_rhs,
+                          bool single_threaded) {
+  if (single_threaded) {
+    __xla_cpu_runtime_EigenSingleThreadedMatMulBF16F32(
+        nullptr, out, lhs, rhs, m, n, k, transpose_lhs, transpose_rhs);
+    return;
+  }
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "XLAEigen", 2);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  __xla_cpu_runtime_EigenMatMulBF16F32(&run_options, out, lhs, rhs, m, n, k,
+                                       transpose_lhs, transpose_rhs);
+}
+
+// Multiplies small integers, which both result types represent exactly, and
+// compares against a reference computed in the result type.
+template <typename Input, typename Output>
+void CheckMixedPrecisionMatMul(const MatMulShape& shape, bool transpose_lhs,
+                               bool transpose_rhs, bool single_threaded) {
+  const int64_t m = shape.m, n = shape.n, k = shape.k;
+  std::vector<Input> lhs(m * k), rhs(k * n);
+  for (int64_t i = 0; i < m * k; ++i) {
+    lhs[i] = static_cast<Input>(static_cast<int>(i * 7 % 255) - 127);
+  }
+  for (int64_t i = 0; i < k * n; ++i) {
+    rhs[i] = static_cast<Input>(static_cast<int>(i * 13 % 256) - 128);
+  }
+  std::vector<Output> out(m * n, Output{-1});
+  MixedPrecisionMatMul(out.data(), lhs.data(), rhs.data(), m, n, k,
+                       transpose_lhs, transpose_rhs, single_threaded);
+
+  for (int64_t i = 0; i < m; ++i) {
+    for (int64_t j = 0; j < n; ++j) {
+      Output expected{0};
+      for (int64_t p = 0; p < k; ++p) {
+        Input a = transpose_lhs ? lhs[p + i * k] : lhs[i + p * m];
+        Input b = transpose_rhs ? rhs[j + p * n] : rhs[p + j * k];
+        expected += static_cast<Output>(a) * static_cast<Output>(b);
+      }
+      ASSERT_EQ(out[i + j * m], expected) << "at (" << i << ", " << j << ")";
+    }
+  }
+}
+
+MatMulShape MixedPrecisionMatMulShapes[] = {
+    MatMulShape{2, 2, 3},     MatMulShape{70, 200, 33},
+    MatMulShape{128, 128, 1}, MatMulShape{1, 128, 128},
+    MatMulShape{65, 1, 67},   MatMulShape{3, 0, 5},
+};
+
+class MixedPrecisionMatMulTest
+    : public CpuRuntimeTest,
+      public ::testing::WithParamInterface<MatMulTestParam> {
+ public:
+  static std::string Name(
+      const ::testing::TestParamInfo<MatMulTestParam>& info) {
+    MatMulShape shape = std::get<0>(info.param);
+    bool transpose_lhs = std::get<1>(info.param);
+    bool transpose_rhs = std::get<2>(info.param);
+    bool single_threaded = std::get<3>(info.param);
+
+    return absl::StrFormat("MixedPrecisionMatMul_%d_%d_%d_%s%s%s_threaded",
+                           shape.m, shape.k, shape.n,
+                           transpose_lhs ? "Tlhs_" : "",
+                           transpose_rhs ? "Trhs_" : "",
+                           single_threaded ? "single" : "multi");
+  }
+};
+
+TEST_P(MixedPrecisionMatMulTest, S8S32) {
+  auto [shape, transpose_lhs, transpose_rhs, single_threaded] = GetParam();
+  CheckMixedPrecisionMatMul<int8_t, int32_t>(shape, transpose_lhs,
+                                             transpose_rhs, single_threaded);
+}
+
+TEST_P(MixedPrecisionMatMulTest, BF16F32) {
+  auto [shape, transpose_lhs, transpose_rhs, single_threaded] = GetParam();
+  CheckMixedPrecisionMatMul<Eigen::bfloat16, float>(
+      shape, transpose_lhs, transpose_rhs, single_threaded);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    MixedPrecisionMatMulTestInstantiation, MixedPrecisionMatMulTest,
+    ::testing::Combine(::testing::ValuesIn(MixedPrecisionMatMulShapes),
+                       ::testing::Bool(), ::testing::Bool(), ::testing::Bool()),
+    MixedPrecisionMatMulTest::Name);
+
 #ifdef ENABLE_MKL
 class MKLMatMulTest : public CpuRuntimeTest,
                       public ::testing::WithParamInterface<MatMulTestParam> {
@@ -251,5 +369,253 @@ TEST_F(CpuRuntimeTest, FailureStatus) {
   ASSERT_FALSE(__xla_cpu_runtime_StatusIsSuccess(&success_status));
 }
 
+// Calls `fn(i, run_options)` for each of `num_participants` participants on
+// its own thread, with run options set up for a collective over devices
+// 0..num_participants-1, and waits for all of them to return.
+template <typename F>
+void RunCollective(tsl::thread::ThreadPool* pool, int num_participants,
+                   F&& fn) {
+  DeviceAssignment device_assignment(num_participants, 1);
+  for (int i = 0; i < num_participants; ++i) {
+    device_assignment(i, 0) = i;
+  }
+  RunId run_id;
+  tsl::BlockingCounter done(num_participants);
+  for (int i = 0; i < num_participants; ++i) {
+    pool->Schedule([&, i]() {
+      ExecutableRunOptions run_options;
+      run_options.set_device_ordinal(i);
+      run_options.set_device_assignment(&device_assignment);
+      run_options.set_run_id(run_id);
+      fn(i, run_options);
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+}
+
+int64_t NextOpId() {
+  static std::atomic<int64_t> op_id{0};
+  return op_id++;
+}
+
+// Runs an all-reduce over `inputs.size()` participants, one thread each, and
+// returns every participant's output.
+template <typename T>
+std::vector<std::vector<T>> RunAllReduce(
+    tsl::thread::ThreadPool* pool, PrimitiveType type,
+    ReductionKind reduction_kind,
+    const std::vector<std::vector<T>>& inputs) {
+  int num_participants = inputs.size();
+  int64_t element_count = inputs[0].size();
+  Shape shape = ShapeUtil::MakeShape(type, {element_count});
+  std::string shape_str = shape.ToProto().SerializeAsString();
+  std::string replica_groups = "{}";
+  int64_t op_id = NextOpId();
+
+  std::vector<std::vector<T>> outputs(num_participants,
+                                      std::vector<T>(element_count));
+  RunCollective(pool, num_participants,
+                [&](int i, const ExecutableRunOptions& run_options) {
+                  void* input_buffer = const_cast<T*>(inputs[i].data());
+                  void* output_buffer = outputs[i].data();
+                  __xla_cpu_runtime_AllReduce(
+                      &run_options, replica_groups.data(),
+                      replica_groups.size(),
+                      /*channel_id_present=*/0, /*use_global_device_ids=*/0,
+                      op_id, static_cast<int32_t>(reduction_kind),
+                      shape_str.data(), shape_str.size(), /*num_buffers=*/1,
+                      &input_buffer, &output_buffer);
+                });
+  return outputs;
+}
+
+TEST_F(CpuRuntimeTest, AllReduceF32Sum) {
+  constexpr int kNumParticipants = 4;
+  constexpr int kElementCount = 1001;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_test",
+                               kNumParticipants);
+  std::vector<std::vector<float>> inputs(kNumParticipants,
+                                         std::vector<float>(kElementCount));
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kElementCount; ++i) {
+      inputs[p][i] = p * 1000 + i;
+    }
+  }
+  auto outputs = RunAllReduce<float>(&pool, F32, ReductionKind::SUM, inputs);
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kElementCount; ++i) {
+      ASSERT_EQ(outputs[p][i], 6000 + 4 * i) << "participant " << p;
+    }
+  }
+}
+
+TEST_F(CpuRuntimeTest, AllReduceS32Max) {
+  constexpr int kNumParticipants = 3;
+  constexpr int kElementCount = 100;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_test",
+                               kNumParticipants);
+  std::vector<std::vector<int32_t>> inputs(
+      kNumParticipants, std::vector<int32_t>(kElementCount));
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kElementCount; ++i) {
+      inputs[p][i] = (i % kNumParticipants == p) ? -i : -1000;
+    }
+  }
+  auto outputs = RunAllReduce<int32_t>(&pool, S32, ReductionKind::MAX, inputs);
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kElementCount; ++i) {
+      ASSERT_EQ(outputs[p][i], -i);
+    }
+  }
+}
+
+TEST_F(CpuRuntimeTest, AllReduceBF16Sum) {
+  constexpr int kNumParticipants = 2;
+  constexpr int kElementCount = 64;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_test",
+                               kNumParticipants);
+  std::vector<std::vector<bfloat16>> inputs(
+      kNumParticipants, std::vector<bfloat16>(kElementCount));
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kElementCount; ++i) {
+      inputs[p][i] = static_cast<bfloat16>(static_cast<float>(i + p));
+    }
+  }
+  auto outputs =
+      RunAllReduce<bfloat16>(&pool, BF16, ReductionKind::SUM, inputs);
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kElementCount; ++i) {
+      ASSERT_EQ(static_cast<float>(outputs[p][i]),
+                static_cast<float>(static_cast<bfloat16>(2.0f * i + 1.0f)));
+    }
+  }
+}
+
+TEST_F(CpuRuntimeTest, AllReduceF8E5M2Min) {
+  constexpr int kNumParticipants = 2;
+  constexpr int kElementCount = 16;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_test",
+                               kNumParticipants);
+  std::vector<std::vector<tsl::float8_e5m2>> inputs(
+      kNumParticipants, std::vector<tsl::float8_e5m2>(kElementCount));
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kElementCount; ++i) {
+      inputs[p][i] =
+          static_cast<tsl::float8_e5m2>(static_cast<float>(p == 0 ? i : -i));
+    }
+  }
+  auto outputs =
+      RunAllReduce<tsl::float8_e5m2>(&pool, F8E5M2, ReductionKind::MIN, inputs);
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kElementCount; ++i) {
+      ASSERT_EQ(static_cast<float>(outputs[p][i]),
+                static_cast<float>(static_cast<tsl::float8_e5m2>(-1.0f * i)));
+    }
+  }
+}
+
+TEST_F(CpuRuntimeTest, AllGather) {
+  constexpr int kNumParticipants = 3;
+  constexpr int kNumBlocks = 2;
+  constexpr int kChunkElements = 5;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_gather_test",
+                               kNumParticipants);
+  // Participant p holds a [kNumBlocks, kChunkElements] array; the result is a
+  // [kNumBlocks, kNumParticipants * kChunkElements] array.
+  std::vector<std::vector<int32_t>> inputs(
+      kNumParticipants, std::vector<int32_t>(kNumBlocks * kChunkElements));
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kNumBlocks * kChunkElements; ++i) {
+      inputs[p][i] = p * 100 + i;
+    }
+  }
+  std::vector<std::vector<int32_t>> outputs(
+      kNumParticipants,
+      std::vector<int32_t>(kNumBlocks * kNumParticipants * kChunkElements));
+  std::string replica_groups = "{}";
+  int64_t op_id = NextOpId();
+  RunCollective(&pool, kNumParticipants,
+                [&](int i, const ExecutableRunOptions& run_options) {
+                  __xla_cpu_runtime_AllGather(
+                      &run_options, /*channel_id_present=*/0,
+                      /*use_global_device_ids=*/0, op_id,
+                      replica_groups.data(), replica_groups.size(),
+                      kNumBlocks, kChunkElements * sizeof(int32_t),
+                      inputs[i].data(), outputs[i].data());
+                });
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int b = 0; b < kNumBlocks; ++b) {
+      for (int q = 0; q < kNumParticipants; ++q) {
+        for (int e = 0; e < kChunkElements; ++e) {
+          ASSERT_EQ(outputs[p][(b * kNumParticipants + q) * kChunkElements + e],
+                    inputs[q][b * kChunkElements + e]);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(CpuRuntimeTest, ReduceScatterF32Sum) {
+  constexpr int kNumParticipants = 4;
+  constexpr int kNumBlocks = 3;
+  constexpr int kChunkElements = 7;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "reduce_scatter_test",
+                               kNumParticipants);
+  // Participant p holds a [kNumBlocks, kNumParticipants * kChunkElements]
+  // array; the result is a [kNumBlocks, kChunkElements] array.
+  constexpr int kInputElements = kNumBlocks * kNumParticipants * kChunkElements;
+  std::vector<std::vector<float>> inputs(kNumParticipants,
+                                         std::vector<float>(kInputElements));
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int i = 0; i < kInputElements; ++i) {
+      inputs[p][i] = p * 1000 + i;
+    }
+  }
+  std::vector<std::vector<float>> outputs(
+      kNumParticipants, std::vector<float>(kNumBlocks * kChunkElements));
+  std::string replica_groups = "{}";
+  int64_t op_id = NextOpId();
+  RunCollective(&pool, kNumParticipants,
+                [&](int i, const ExecutableRunOptions& run_options) {
+                  __xla_cpu_runtime_ReduceScatter(
+                      &run_options, replica_groups.data(),
+                      replica_groups.size(), /*channel_id_present=*/0,
+                      /*use_global_device_ids=*/0, op_id,
+                      static_cast<int32_t>(ReductionKind::SUM), F32,
+                      kNumBlocks, kChunkElements, inputs[i].data(),
+                      outputs[i].data());
+                });
+  for (int p = 0; p < kNumParticipants; ++p) {
+    for (int b = 0; b < kNumBlocks; ++b) {
+      for (int e = 0; e < kChunkElements; ++e) {
+        int i = (b * kNumParticipants + p) * kChunkElements + e;
+        ASSERT_EQ(outputs[p][b * kChunkElements + e], 6000 + 4 * i)
+            << "participant " << p;
+      }
+    }
+  }
+}
+
+// Sweeps the number of participants (range(0)) and the number of F32 elements
+// per participant (range(1)).
+void BM_AllReduce(::testing::benchmark::State& state) {
+  const int num_participants = state.range(0);
+  const int64_t element_count = state.range(1);
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_benchmark",
+                               num_participants);
+  std::vector<std::vector<float>> inputs(
+      num_participants, std::vector<float>(element_count, 1.0f));
+  for (auto s : state) {
+    RunAllReduce<float>(&pool, F32, ReductionKind::SUM, inputs);
+  }
+  state.SetBytesProcessed(state.iterations() * num_participants *
+                          element_count * sizeof(float));
+}
+
+BENCHMARK(BM_AllReduce)
+    ->ArgsProduct({{2, 4, 8, 16}, {1 << 10, 1 << 16, 1 << 20, 1 << 24}})
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace xla
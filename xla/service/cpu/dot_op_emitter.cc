@@ -198,6 +198,11 @@ class DotOpEmitter {
   // one element at a time.
   void EmitNaiveLlvmIrGemm();
 
+  // Converts an element loaded from one of the operands to the result type.
+  // This is a no-op unless the operands are narrower than the result, e.g. for
+  // s8 x s8 -> s32 dots.
+  llvm::Value* WidenOperandElement(llvm::Value* element);
+
   // When doing a tiled GEMV in LLVM IR, a "tile" consists of this many vector
   // registers.
   int64_t GetGemvTilingFactor() const {
@@ -694,8 +699,10 @@ void DotOpEmitter::EmitNaiveLlvmIrGemm() {
   // - Store sum back into accumulator.
   SetToFirstInsertPoint(reduction_loop->GetBodyBasicBlock(), b_);
 
-  llvm::Value* lhs_element = lhs_array_.EmitReadArrayElement(lhs_index, b_);
-  llvm::Value* rhs_element = rhs_array_.EmitReadArrayElement(rhs_index, b_);
+  llvm::Value* lhs_element =
+      WidenOperandElement(lhs_array_.EmitReadArrayElement(lhs_index, b_));
+  llvm::Value* rhs_element =
+      WidenOperandElement(rhs_array_.EmitReadArrayElement(rhs_index, b_));
 
   llvm::Value* accum = b_->CreateLoad(accum_type, accum_address);
   llvm::Value* updated_accum;
@@ -762,10 +769,10 @@ Status DotOpEmitter::EmitScalarDot() {
   // Use the same index_type for all tensor accesses in the same kernel.
   llvm::Type* index_type = b_->getInt64Ty();
   llvm_ir::IrArray::Index element_index(index_type);
-  llvm::Value* lhs_value =
-      lhs_array_.EmitReadArrayElement(/*index=*/element_index, b_);
-  llvm::Value* rhs_value =
-      rhs_array_.EmitReadArrayElement(/*index=*/element_index, b_);
+  llvm::Value* lhs_value = WidenOperandElement(
+      lhs_array_.EmitReadArrayElement(/*index=*/element_index, b_));
+  llvm::Value* rhs_value = WidenOperandElement(
+      rhs_array_.EmitReadArrayElement(/*index=*/element_index, b_));
   if (ShapeUtil::ElementIsComplex(lhs_array_.GetShape())) {
     auto get_real = [&](llvm::Value* x) {
       return b_->CreateExtractValue(x, {0});
@@ -784,6 +791,8 @@ Status DotOpEmitter::EmitScalarDot() {
     result = llvm::ConstantAggregateZero::get(lhs_array_.GetElementLlvmType());
     result = b_->CreateInsertValue(result, real, {0});
     result = b_->CreateInsertValue(result, imag, {1});
+  } else if (ShapeUtil::ElementIsIntegral(target_array_.GetShape())) {
+    result = b_->CreateMul(lhs_value, rhs_value);
   } else {
     result = b_->CreateFMul(lhs_value, rhs_value);
   }
@@ -791,6 +800,31 @@ Status DotOpEmitter::EmitScalarDot() {
   return OkStatus();
 }
 
+llvm::Value* DotOpEmitter::WidenOperandElement(llvm::Value* element) {
+  PrimitiveType operand_type = dot_info_.lhs_shape.element_type();
+  PrimitiveType result_type = dot_info_.result_shape.element_type();
+  if (operand_type == result_type) {
+    return element;
+  }
+  llvm::Type* result_ir_type = llvm_ir::PrimitiveTypeToIrType(
+      result_type, b_->GetInsertBlock()->getModule());
+  if (primitive_util::IsIntegralType(operand_type)) {
+    return b_->CreateIntCast(
+        element, result_ir_type,
+        primitive_util::IsSignedIntegralType(operand_type));
+  }
+  if (operand_type == BF16) {
+    // BF16 is stored as an i16 holding the upper half of an F32.
+    llvm::Value* f32_bits = b_->CreateShl(
+        b_->CreateZExt(b_->CreateBitCast(element, b_->getInt16Ty()),
+                       b_->getInt32Ty()),
+        16);
+    return b_->CreateFPCast(b_->CreateBitCast(f32_bits, b_->getFloatTy()),
+                            result_ir_type);
+  }
+  return b_->CreateFPCast(element, result_ir_type);
+}
+
 Status DotOpEmitter::EmitCallToRuntime() {
   // The signature of the Eigen runtime matmul function is:
   //
@@ -858,13 +892,35 @@ Status DotOpEmitter::EmitCallToRuntime() {
                            PrimitiveType_Name(type));
   }
 
+  // Dots whose operands are narrower than the result call the mixed-precision
+  // variants, which take pointers to the narrow operand type.
+  PrimitiveType operand_type = lhs_array_.GetShape().element_type();
+  llvm::Type* operand_float_type = float_type;
+  if (operand_type != type) {
+    if (operand_type == S8 && type == S32) {
+      fn_name = multi_threaded
+                    ? runtime::kEigenMatMulS8S32SymbolName
+                    : runtime::kEigenSingleThreadedMatMulS8S32SymbolName;
+    } else if (operand_type == BF16 && type == F32) {
+      fn_name = multi_threaded
+                    ? runtime::kEigenMatMulBF16F32SymbolName
+                    : runtime::kEigenSingleThreadedMatMulBF16F32SymbolName;
+    } else {
+      return Unimplemented(
+          "Invalid operand type %s for dot operation of type %s",
+          PrimitiveType_Name(operand_type), PrimitiveType_Name(type));
+    }
+    operand_float_type = llvm_ir::PrimitiveTypeToIrType(operand_type, module);
+  }
+
   llvm::Type* float_ptr_type = float_type->getPointerTo();
+  llvm::Type* operand_ptr_type = operand_float_type->getPointerTo();
   llvm::Type* int64_type = b_->getInt64Ty();
   llvm::Type* int32_type = b_->getInt32Ty();
   llvm::Type* int8_ptr_type = b_->getInt8Ty()->getPointerTo();
   llvm::FunctionType* matmul_type = llvm::FunctionType::get(
       b_->getVoidTy(),
-      {int8_ptr_type, float_ptr_type, float_ptr_type, float_ptr_type,
+      {int8_ptr_type, float_ptr_type, operand_ptr_type, operand_ptr_type,
        int64_type, int64_type, int64_type, int32_type, int32_type},
       /*isVarArg=*/false);
 
@@ -906,8 +962,8 @@ Status DotOpEmitter::EmitCallToRuntime() {
       matmul_func,
       {b_->CreateBitCast(executable_run_options_value_, int8_ptr_type),
        b_->CreateBitCast(target_array_.GetBasePointer(), float_ptr_type),
-       b_->CreateBitCast(lhs->GetBasePointer(), float_ptr_type),
-       b_->CreateBitCast(rhs->GetBasePointer(), float_ptr_type),
+       b_->CreateBitCast(lhs->GetBasePointer(), operand_ptr_type),
+       b_->CreateBitCast(rhs->GetBasePointer(), operand_ptr_type),
        b_->getInt64(mat_mult_dims.m), b_->getInt64(mat_mult_dims.n),
        b_->getInt64(mat_mult_dims.k), b_->getInt32(transpose_lhs),
        b_->getInt32(transpose_rhs)});
@@ -1193,10 +1249,30 @@ bool CanEmitTiledLlvmIrGemm(
   return true;
 }
 
+// Returns true if there is a runtime matmul for operands of type
+// `operand_type` and a result of type `result_type`.
+bool IsMixedPrecisionRuntimeMatmulType(PrimitiveType operand_type,
+                                       PrimitiveType result_type) {
+  return (operand_type == S8 && result_type == S32) ||
+         (operand_type == BF16 && result_type == F32);
+}
+
 DotImplementationStrategy GetDotImplementationStrategy(
     const HloModuleConfig& config, const DotInfo& dot_info,
     const TargetMachineFeatures& target_machine_features) {
   PrimitiveType element_type = dot_info.result_shape.element_type();
+  // Dots whose operands are narrower than the result are only supported by the
+  // mixed-precision runtime matmuls and by the naive loop, which widens every
+  // operand element it loads.
+  if (dot_info.lhs_shape.element_type() != element_type) {
+    if (IsMixedPrecisionRuntimeMatmulType(dot_info.lhs_shape.element_type(),
+                                          element_type) &&
+        IsAlignedGemm(dot_info, target_machine_features)) {
+      return DotImplementationStrategy::kEigen;
+    }
+    return DotImplementationStrategy::kNaiveLlvmIr;
+  }
+
   // Any Matrix-Vector product of floating point or integral type, or
   // a transpose-dot fusion of the same can be lowered to a tiled LLVM
   // IR implementation.
@@ -1361,7 +1437,7 @@ bool PotentiallyImplementedAsEigenMatmul(
       0, dot_info.dim_nums.rhs_contracting_dimensions(0) - num_batch_dims);
 
   PrimitiveType type = target_array.GetShape().element_type();
-  if (F32 != type) return false;
+  if (F32 != type || lhs_array.GetShape().element_type() != type) return false;
 
   if (ShapeUtil::IsScalar(dot_info.lhs_shape) ||
       ShapeUtil::IsScalar(dot_info.rhs_shape)) {
@@ -1499,6 +1575,32 @@ bool DotOperandsAndResultMustHaveRowMajorLayout(
          impl_strategy == DotImplementationStrategy::kEigen;
 }
 
+bool CanEmitMixedPrecisionDotAsRuntimeCall(
+    const HloInstruction& hlo, PrimitiveType result_type,
+    const TargetMachineFeatures& target_machine_features) {
+  if (hlo.opcode() != HloOpcode::kDot || IsBatchDot(hlo) ||
+      hlo.operand(0)->shape().element_type() !=
+          hlo.operand(1)->shape().element_type() ||
+      !IsMixedPrecisionRuntimeMatmulType(hlo.operand(0)->shape().element_type(),
+                                         result_type) ||
+      hlo.dot_dimension_numbers().lhs_contracting_dimensions_size() != 1 ||
+      hlo.dot_dimension_numbers().rhs_contracting_dimensions_size() != 1) {
+    return false;
+  }
+
+  // Only take over the dots that would be emitted as GEMMs after widening their
+  // operands. Matrix-vector products and tiny matrices are better served by the
+  // LLVM IR emitters.
+  DotInfo widened_dot_info(hlo);
+  widened_dot_info.lhs_shape.set_element_type(result_type);
+  widened_dot_info.rhs_shape.set_element_type(result_type);
+  widened_dot_info.result_shape.set_element_type(result_type);
+  DotImplementationStrategy impl_strategy = GetDotImplementationStrategy(
+      hlo.GetModule()->config(), widened_dot_info, target_machine_features);
+  return impl_strategy == DotImplementationStrategy::kTiledLlvmIrGemm ||
+         impl_strategy == DotImplementationStrategy::kEigen;
+}
+
 Status EmitDotOperation(const HloInstruction& dot,
                         const llvm_ir::IrArray& target_array,
                         const llvm_ir::IrArray& lhs_array,
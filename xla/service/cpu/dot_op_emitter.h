@@ -42,6 +42,15 @@ bool DotImplementationCanHandleTranspose(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features);
 
+// Returns true if `hlo` is a dot with s8 operands and an s32 `result_type`, or
+// with bf16 operands and an f32 `result_type`, that is emitted as a call to a
+// mixed-precision runtime matmul. `result_type` may differ from the type of
+// `hlo` for passes that are about to change it. Such dots must not have their
+// operands converted to the result type.
+bool CanEmitMixedPrecisionDotAsRuntimeCall(
+    const HloInstruction& hlo, PrimitiveType result_type,
+    const TargetMachineFeatures& target_machine_features);
+
 // Returns the index for an operand to `hlo` that should ideally be column
 // major.  Returns nullopt if there is no such operand or if `hlo` is not a dot
 // or a fusion containing a dot.
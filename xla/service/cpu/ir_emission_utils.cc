@@ -15,8 +15,10 @@ limitations under the License.
 
 #include "xla/service/cpu/ir_emission_utils.h"
 
+#include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/layout_util.h"
+#include "xla/service/collective_ops_utils.h"
 #include "xla/service/cpu/cpu_runtime.h"
 #include "xla/shape_util.h"
 #include "xla/window_util.h"
@@ -110,5 +112,175 @@ bool PotentiallyImplementedAsEigenConvolution(
              kernel_shape.dimensions_size() - 1;
 }
 
+bool PotentiallyImplementedAsDirectConvolution(
+    const HloInstruction& convolution) {
+  // Grouped convolutions with more input channels per group than this are
+  // dense enough for the Eigen contraction to be faster.
+  constexpr int64_t kMaxDirectConvolutionChannelsPerGroup = 32;
+
+  if (convolution.opcode() != HloOpcode::kConvolution ||
+      convolution.batch_group_count() != 1) {
+    return false;
+  }
+  const Shape& input_shape = convolution.operand(0)->shape();
+  const Shape& kernel_shape = convolution.operand(1)->shape();
+  const Shape& output_shape = convolution.shape();
+  if (ShapeUtil::IsZeroElementArray(input_shape) ||
+      ShapeUtil::IsZeroElementArray(kernel_shape) ||
+      ShapeUtil::IsZeroElementArray(output_shape)) {
+    return false;
+  }
+  const ConvolutionDimensionNumbers& dnums =
+      convolution.convolution_dimension_numbers();
+  const int64_t num_spatial_dims = dnums.output_spatial_dimensions_size();
+  if (num_spatial_dims < 1 || num_spatial_dims > 2) {
+    return false;
+  }
+
+  PrimitiveType input_type = input_shape.element_type();
+  PrimitiveType output_type = output_shape.element_type();
+  if (input_type != kernel_shape.element_type()) {
+    return false;
+  }
+  if (input_type == S8) {
+    return output_type == S8 || output_type == S32;
+  }
+  if ((input_type != F16 && input_type != F32) || output_type != input_type) {
+    return false;
+  }
+  const int64_t feature_group_count = convolution.feature_group_count();
+  const int64_t channels_per_group =
+      input_shape.dimensions(dnums.input_feature_dimension()) /
+      feature_group_count;
+  return feature_group_count > 1 &&
+         channels_per_group <= kMaxDirectConvolutionChannelsPerGroup;
+}
+
+bool IsCollectiveReductionTypeSupported(PrimitiveType type) {
+  switch (type) {
+    case PRED:
+    case S8:
+    case U8:
+    case S16:
+    case U16:
+    case S32:
+    case U32:
+    case S64:
+    case U64:
+    case F16:
+    case BF16:
+    case F8E5M2:
+    case F8E4M3FN:
+    case F32:
+    case F64:
+    case C64:
+    case C128:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The runtime functions exchange one contiguous chunk per participant and
+// derive the participant's chunk from its position in the replica group. In
+// kCrossReplicaAndPartition mode the group spans several partitions that each
+// gather or scatter independently, which does not fit that scheme.
+static bool IsSupportedCollectiveGroupMode(const HloCollectiveInstruction& hlo,
+                                           bool use_global_device_ids) {
+  StatusOr<CollectiveOpGroupMode> group_mode = GetCollectiveOpGroupMode(
+      hlo.channel_id().has_value(), use_global_device_ids);
+  return group_mode.ok() &&
+         *group_mode != CollectiveOpGroupMode::kCrossReplicaAndPartition;
+}
+
+bool CanEmitAllGatherAsRuntimeCall(const HloAllGatherInstruction& all_gather) {
+  return all_gather.operand_count() == 1 && all_gather.shape().IsArray() &&
+         IsSupportedCollectiveGroupMode(all_gather,
+                                        all_gather.use_global_device_ids());
+}
+
+bool CanEmitReduceScatterAsRuntimeCall(
+    const HloReduceScatterInstruction& reduce_scatter) {
+  return reduce_scatter.operand_count() == 1 &&
+         reduce_scatter.shape().IsArray() &&
+         IsCollectiveReductionTypeSupported(
+             reduce_scatter.shape().element_type()) &&
+         MatchReductionComputation(reduce_scatter.to_apply()).has_value() &&
+         IsSupportedCollectiveGroupMode(reduce_scatter,
+                                        reduce_scatter.use_global_device_ids());
+}
+
+bool CanEmitLinalgAsRuntimeCall(const HloInstruction& instruction) {
+  switch (instruction.opcode()) {
+    case HloOpcode::kCholesky:
+      break;
+    case HloOpcode::kTriangularSolve:
+      if (instruction.triangular_solve_options().transpose_a() ==
+          TriangularSolveOptions::TRANSPOSE_INVALID) {
+        return false;
+      }
+      break;
+    case HloOpcode::kCustomCall:
+      if ((instruction.custom_call_target() != "Qr" &&
+           instruction.custom_call_target() != "Eigh") ||
+          instruction.operand_count() != 1) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  const Shape& shape = instruction.operand(0)->shape();
+  if (!shape.IsArray() || shape.rank() < 2) {
+    return false;
+  }
+  switch (shape.element_type()) {
+    case F32:
+    case F64:
+    case C64:
+    case C128:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool CanEmitRngBitGeneratorAsRuntimeCall(
+    const HloInstruction& rng_bit_generator) {
+  if (rng_bit_generator.opcode() != HloOpcode::kRngBitGenerator) {
+    return false;
+  }
+  const Shape& state_shape = rng_bit_generator.operand(0)->shape();
+  if (state_shape.element_type() != U64 || state_shape.rank() != 1) {
+    return false;
+  }
+  const auto* rng = Cast<HloRngBitGeneratorInstruction>(&rng_bit_generator);
+  switch (rng->algorithm()) {
+    case RandomAlgorithm::RNG_THREE_FRY:
+      if (state_shape.dimensions(0) != 2) {
+        return false;
+      }
+      break;
+    // The CPU compiler expands RNG_DEFAULT as Philox.
+    case RandomAlgorithm::RNG_DEFAULT:
+    case RandomAlgorithm::RNG_PHILOX:
+      if (state_shape.dimensions(0) != 2 && state_shape.dimensions(0) != 3) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  switch (rng->shape().tuple_shapes(1).element_type()) {
+    case U8:
+    case U16:
+    case U32:
+    case U64:
+      return true;
+    default:
+      return false;
+  }
+}
+
 }  // namespace cpu
 }  // namespace xla
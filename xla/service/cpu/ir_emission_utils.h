@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "llvm/IR/Value.h"
 #include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/service/cpu/target_machine_features.h"
 
 namespace xla {
@@ -27,11 +28,44 @@ bool PotentiallyImplementedAsEigenConvolution(
     const HloInstruction& convolution,
     const TargetMachineFeatures& target_machine_features);
 
+// Returns true if `convolution` is emitted as a call to one of the direct
+// convolution runtime kernels: a 1D or 2D depthwise or narrow grouped F16/F32
+// convolution, or an S8 convolution with an S8 or S32 result, in any layout.
+// Depends only on the shapes and dimension numbers, so it can be used before
+// layout assignment.
+bool PotentiallyImplementedAsDirectConvolution(
+    const HloInstruction& convolution);
+
 // Computes the minimum alignment guaranteed for a tensor of shape `shape` on
 // the target machine.
 int64_t GetMinimumAlignmentForArray(
     const Shape& shape, const TargetMachineFeatures& target_machine_features);
 
+// Returns true if the CPU runtime collectives can reduce buffers of `type`.
+bool IsCollectiveReductionTypeSupported(PrimitiveType type);
+
+// Returns true if `all_gather` can be emitted as a call to the AllGather
+// runtime function. Otherwise it has to be decomposed into an all-reduce.
+bool CanEmitAllGatherAsRuntimeCall(const HloAllGatherInstruction& all_gather);
+
+// Returns true if `reduce_scatter` can be emitted as a call to the
+// ReduceScatter runtime function. Otherwise it has to be decomposed into an
+// all-reduce.
+bool CanEmitReduceScatterAsRuntimeCall(
+    const HloReduceScatterInstruction& reduce_scatter);
+
+// Returns true if `instruction` is a cholesky, a triangular-solve or a "Qr" or
+// "Eigh" custom call that can be emitted as a call to an Eigen linear algebra
+// runtime function. Otherwise it has to be expanded into HLO loops.
+bool CanEmitLinalgAsRuntimeCall(const HloInstruction& instruction);
+
+// Returns true if `rng_bit_generator` can be emitted as a call to the Philox
+// or ThreeFry runtime function, which produce the same bits as
+// RngBitGeneratorExpander with the Philox default algorithm. Otherwise it has
+// to be expanded into HLO.
+bool CanEmitRngBitGeneratorAsRuntimeCall(
+    const HloInstruction& rng_bit_generator);
+
 // Dynamic loop bounds are specified as an array of dimension index
 // [start, limit) pairs of ir values (one for each partitioned outer dimension).
 //
@@ -19,11 +19,13 @@ limitations under the License.
 #include <stdint.h>
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 #include <limits>
 #include <map>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -32,9 +34,11 @@ limitations under the License.
 #include "absl/cleanup/cleanup.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "llvm/IR/BasicBlock.h"
@@ -63,6 +67,9 @@ limitations under the License.
 #include "xla/service/cpu/ir_emission_utils.h"
 #include "xla/service/cpu/ir_function.h"
 #include "xla/service/cpu/parallel_loop_emitter.h"
+#include "xla/service/cpu/runtime_direct_conv.h"
+#include "xla/service/cpu/runtime_key_value_sort.h"
+#include "xla/service/cpu/runtime_linalg.h"
 #include "xla/service/elemental_ir_emitter.h"
 #include "xla/service/llvm_ir/buffer_assignment_util.h"
 #include "xla/service/llvm_ir/dynamic_update_slice_util.h"
@@ -555,6 +562,68 @@ Status IrEmitter::HandleOutfeed(HloInstruction* outfeed) {
   return OkStatus();
 }
 
+// The radix sort takes its key type as a PrimitiveType value.
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kS8) == S8);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kS16) == S16);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kS32) == S32);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kS64) == S64);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kU8) == U8);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kU16) == U16);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kU32) == U32);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kU64) == U64);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kF16) == F16);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kF32) == F32);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kF64) == F64);
+static_assert(static_cast<int32_t>(runtime::RadixSortKeyType::kBF16) == BF16);
+
+// If the comparator of 'sort' is a plain LT or GT comparison of its keys with
+// a type the runtime can radix sort, returns whether the sort order is
+// descending.
+static std::optional<bool> MatchRadixSortComparator(
+    const HloSortInstruction& sort) {
+  switch (sort.keys()->shape().element_type()) {
+    case S8:
+    case S16:
+    case S32:
+    case S64:
+    case U8:
+    case U16:
+    case U32:
+    case U64:
+    case F16:
+    case BF16:
+    case F32:
+    case F64:
+      break;
+    default:
+      return std::nullopt;
+  }
+  const HloInstruction* root = sort.to_apply()->root_instruction();
+  if (root->opcode() != HloOpcode::kCompare ||
+      root->operand(0)->opcode() != HloOpcode::kParameter ||
+      root->operand(1)->opcode() != HloOpcode::kParameter) {
+    return std::nullopt;
+  }
+  int64_t lhs_number = root->operand(0)->parameter_number();
+  int64_t rhs_number = root->operand(1)->parameter_number();
+  bool swapped;
+  if (lhs_number == 0 && rhs_number == 1) {
+    swapped = false;
+  } else if (lhs_number == 1 && rhs_number == 0) {
+    swapped = true;
+  } else {
+    return std::nullopt;
+  }
+  switch (Cast<HloCompareInstruction>(root)->direction()) {
+    case ComparisonDirection::kLt:
+      return swapped;
+    case ComparisonDirection::kGt:
+      return !swapped;
+    default:
+      return std::nullopt;
+  }
+}
+
 Status IrEmitter::HandleSort(HloInstruction* hlo) {
   const HloSortInstruction* sort = Cast<HloSortInstruction>(hlo);
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(sort));
@@ -634,17 +703,31 @@ Status IrEmitter::HandleSort(HloInstruction* hlo) {
     Store(size, slot_in_sizes_alloca);
   }
 
-  auto less_than_function =
-      FindOrDie(emitted_functions_,
-                ComputationToEmit{sort->to_apply(), allow_reassociation_});
-  EmitCallToFunc(
-      runtime::kKeyValueSortSymbolName,
-      {b_.getInt64(higher_dimensions), b_.getInt64(sort_dimension_elements),
-       b_.getInt64(lower_dimensions), values,
-       b_.getInt32(sort->operand_count()), sizes, b_.getInt1(sort->is_stable()),
-       GetExecutableRunOptionsArgument(), GetProfileCountersArgument(),
-       less_than_function},
-      b_.getVoidTy());
+  if (std::optional<bool> descending = MatchRadixSortComparator(*sort)) {
+    bool is_total_order =
+        Cast<HloCompareInstruction>(sort->to_apply()->root_instruction())
+            ->order() == Comparison::Order::kTotal;
+    EmitCallToFunc(
+        runtime::kKeyValueRadixSortSymbolName,
+        {b_.getInt64(higher_dimensions), b_.getInt64(sort_dimension_elements),
+         b_.getInt64(lower_dimensions), values,
+         b_.getInt32(sort->operand_count()), sizes, b_.getInt32(keys_type),
+         b_.getInt1(*descending), b_.getInt1(is_total_order),
+         GetExecutableRunOptionsArgument()},
+        b_.getVoidTy());
+  } else {
+    auto less_than_function =
+        FindOrDie(emitted_functions_,
+                  ComputationToEmit{sort->to_apply(), allow_reassociation_});
+    EmitCallToFunc(
+        runtime::kKeyValueSortSymbolName,
+        {b_.getInt64(higher_dimensions), b_.getInt64(sort_dimension_elements),
+         b_.getInt64(lower_dimensions), values,
+         b_.getInt32(sort->operand_count()), sizes,
+         b_.getInt1(sort->is_stable()), GetExecutableRunOptionsArgument(),
+         GetProfileCountersArgument(), less_than_function},
+        b_.getVoidTy());
+  }
 
   if (sort->values_count() > 0) {
     llvm_ir::EmitTuple(GetIrArrayFor(sort), destination_addresses, &b_);
@@ -868,10 +951,13 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
 Status IrEmitter::HandleDot(HloInstruction* dot) {
   auto lhs = dot->operand(0);
   auto rhs = dot->operand(1);
+  // BF16 operands are only left in place for mixed-precision dots; see
+  // CanEmitMixedPrecisionDotAsRuntimeCall.
   TF_RETURN_IF_ERROR(ElementTypesSameAndSupported(
       /*instruction=*/*dot, /*operands=*/{lhs, rhs},
       /*supported_types=*/
-      {PRED, S8, U8, S16, U16, S32, U32, S64, U64, F16, F32, F64, C64, C128}));
+      {PRED, S8, U8, S16, U16, S32, U32, S64, U64, F16, BF16, F32, F64, C64,
+       C128}));
   const DotDimensionNumbers& dnums = dot->dot_dimension_numbers();
 
   if (dnums.lhs_contracting_dimensions_size() != 1) {
@@ -909,6 +995,12 @@ Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
       /*supported_types=*/
       {PRED, S8, U8, S16, U16, S32, U32, S64, U64, F16, F32, F64, C64, C128}));
 
+  // Depthwise, narrow grouped and int8 convolutions go to the direct kernels
+  // even when Eigen could run them: Eigen would do one contraction per group.
+  if (PotentiallyImplementedAsDirectConvolution(*convolution)) {
+    return HandleDirectConvolution(convolution);
+  }
+
   // TODO(tonywy): Add PotentiallyImplementedAsMKLConvolution to support
   // different data layouts.
   if (PotentiallyImplementedAsEigenConvolution(*convolution,
@@ -1089,6 +1181,153 @@ Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
   return DefaultAction(convolution);
 }
 
+Status IrEmitter::HandleDirectConvolution(HloInstruction* convolution) {
+  const HloInstruction* lhs = convolution->operand(0);
+  const HloInstruction* rhs = convolution->operand(1);
+  const Shape& input_shape = lhs->shape();
+  const Shape& kernel_shape = rhs->shape();
+  const Shape& output_shape = convolution->shape();
+  const ConvolutionDimensionNumbers& dnums =
+      convolution->convolution_dimension_numbers();
+
+  const char* fn_name;
+  switch (input_shape.element_type()) {
+    case F16:
+      fn_name = runtime::kDirectConvF16SymbolName;
+      break;
+    case F32:
+      fn_name = runtime::kDirectConvF32SymbolName;
+      break;
+    case S8:
+      fn_name = output_shape.element_type() == S32
+                    ? runtime::kDirectConvS8S32SymbolName
+                    : runtime::kDirectConvS8S8SymbolName;
+      break;
+    default:
+      return Unimplemented("Direct convolution of %s is not supported.",
+                           PrimitiveType_Name(input_shape.element_type()));
+  }
+
+  // The kernels address every tensor through the strides of its logical
+  // dimensions, so the layouts need not be canonical.
+  auto element_strides =
+      [](const Shape& shape) -> StatusOr<std::vector<int64_t>> {
+    std::vector<int64_t> strides(shape.rank());
+    TF_RETURN_IF_ERROR(ShapeUtil::ByteStrides(shape, absl::MakeSpan(strides)));
+    for (int64_t& stride : strides) {
+      stride /= ShapeUtil::ByteSizeOfPrimitiveType(shape.element_type());
+    }
+    return strides;
+  };
+  TF_ASSIGN_OR_RETURN(std::vector<int64_t> input_strides,
+                      element_strides(input_shape));
+  TF_ASSIGN_OR_RETURN(std::vector<int64_t> kernel_strides,
+                      element_strides(kernel_shape));
+  TF_ASSIGN_OR_RETURN(std::vector<int64_t> output_strides,
+                      element_strides(output_shape));
+
+  DirectConvolutionParams params;
+  params.input_batch = input_shape.dimensions(dnums.input_batch_dimension());
+  params.input_channels =
+      input_shape.dimensions(dnums.input_feature_dimension());
+  params.input_batch_stride = input_strides[dnums.input_batch_dimension()];
+  params.input_channel_stride = input_strides[dnums.input_feature_dimension()];
+  params.kernel_channels =
+      kernel_shape.dimensions(dnums.kernel_input_feature_dimension());
+  params.kernel_filters =
+      kernel_shape.dimensions(dnums.kernel_output_feature_dimension());
+  params.kernel_channel_stride =
+      kernel_strides[dnums.kernel_input_feature_dimension()];
+  params.kernel_filter_stride =
+      kernel_strides[dnums.kernel_output_feature_dimension()];
+  params.output_batch_stride = output_strides[dnums.output_batch_dimension()];
+  params.output_filter_stride =
+      output_strides[dnums.output_feature_dimension()];
+  params.feature_group_count = convolution->feature_group_count();
+
+  // A 1D convolution is a 2D convolution with a single row.
+  params.input_rows = 1;
+  params.input_row_stride = 0;
+  params.kernel_rows = 1;
+  params.kernel_row_stride = 0;
+  params.output_rows = 1;
+  params.output_row_stride = 0;
+  params.row_stride = 1;
+  params.padding_top = 0;
+  params.lhs_row_dilation = 1;
+  params.rhs_row_dilation = 1;
+  params.row_reversal = 0;
+  const int64_t num_spatial_dims = dnums.input_spatial_dimensions_size();
+  TF_RET_CHECK(num_spatial_dims == 1 || num_spatial_dims == 2);
+  for (int64_t i = 0; i < num_spatial_dims; ++i) {
+    const bool is_col = i == num_spatial_dims - 1;
+    const int64_t input_dim = dnums.input_spatial_dimensions(i);
+    const int64_t kernel_dim = dnums.kernel_spatial_dimensions(i);
+    const int64_t output_dim = dnums.output_spatial_dimensions(i);
+    const WindowDimension& window_dim = convolution->window().dimensions(i);
+    (is_col ? params.input_cols : params.input_rows) =
+        input_shape.dimensions(input_dim);
+    (is_col ? params.input_col_stride : params.input_row_stride) =
+        input_strides[input_dim];
+    (is_col ? params.kernel_cols : params.kernel_rows) =
+        kernel_shape.dimensions(kernel_dim);
+    (is_col ? params.kernel_col_stride : params.kernel_row_stride) =
+        kernel_strides[kernel_dim];
+    (is_col ? params.output_cols : params.output_rows) =
+        output_shape.dimensions(output_dim);
+    (is_col ? params.output_col_stride : params.output_row_stride) =
+        output_strides[output_dim];
+    (is_col ? params.col_stride : params.row_stride) = window_dim.stride();
+    (is_col ? params.padding_left : params.padding_top) =
+        window_dim.padding_low();
+    (is_col ? params.lhs_col_dilation : params.lhs_row_dilation) =
+        window_dim.base_dilation();
+    (is_col ? params.rhs_col_dilation : params.rhs_row_dilation) =
+        window_dim.window_dilation();
+    (is_col ? params.col_reversal : params.row_reversal) =
+        window_dim.window_reversal();
+  }
+
+  // The parameters are passed as a constant array of int64s.
+  static_assert(sizeof(DirectConvolutionParams) % sizeof(int64_t) == 0);
+  std::vector<int64_t> params_array(sizeof(params) / sizeof(int64_t));
+  std::memcpy(params_array.data(), &params, sizeof(params));
+  llvm::Constant* params_initializer =
+      llvm::ConstantDataArray::get(module_->getContext(), params_array);
+  llvm::GlobalVariable* params_global = new llvm::GlobalVariable(
+      /*Module=*/*module_,
+      /*Type=*/params_initializer->getType(),
+      /*isConstant=*/true,
+      /*Linkage=*/llvm::GlobalValue::PrivateLinkage,
+      /*Initializer=*/params_initializer,
+      /*Name=*/IrName(convolution, "params"));
+  params_global->setUnnamedAddr(llvm::GlobalVariable::UnnamedAddr::Global);
+
+  // Without run options the kernel runs on the calling thread.
+  llvm::Value* run_options = GetExecutableRunOptionsArgument();
+  if (!hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen()) {
+    run_options = llvm::Constant::getNullValue(run_options->getType());
+  }
+
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(convolution));
+  llvm::Type* input_ptr_type =
+      llvm_ir::PrimitiveTypeToIrType(input_shape.element_type(), module_)
+          ->getPointerTo();
+  llvm::Type* output_ptr_type =
+      llvm_ir::PrimitiveTypeToIrType(output_shape.element_type(), module_)
+          ->getPointerTo();
+  VLOG(1) << "Ir emitter emitted Convolution to runtime:" << fn_name;
+  EmitCallToFunc(fn_name,
+                 {run_options,
+                  BitCast(params_global, b_.getInt64Ty()->getPointerTo()),
+                  BitCast(GetEmittedValueFor(convolution), output_ptr_type),
+                  BitCast(GetEmittedValueFor(lhs), input_ptr_type),
+                  BitCast(GetEmittedValueFor(rhs), input_ptr_type)},
+                 b_.getVoidTy(), /*does_not_throw=*/true,
+                 /*only_accesses_arg_memory=*/true);
+  return OkStatus();
+}
+
 Status IrEmitter::HandleFft(HloInstruction* fft) {
   auto operand = fft->operand(0);
   TF_RETURN_IF_ERROR(ElementTypesSameAndSupported(
@@ -1174,28 +1413,7 @@ Status IrEmitter::HandleAllReduceMultipleReplica(HloInstruction* crs) {
   PrimitiveType datatype = crs->operand(0)->shape().element_type();
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(crs));
 
-  bool is_datatype_supported = [&] {
-    // TODO(cheshire): Fix duplication wrt. cpu_runtime
-    switch (datatype) {
-      case PRED:
-      case S8:
-      case U8:
-      case S16:
-      case U16:
-      case S32:
-      case U32:
-      case S64:
-      case U64:
-      case F16:
-      case F32:
-      case F64:
-      case C64:
-      case C128:
-        return true;
-      default:
-        return false;
-    }
-  }();
+  bool is_datatype_supported = IsCollectiveReductionTypeSupported(datatype);
 
   if (!is_datatype_supported) {
     return Unimplemented("AllReduce for datatype '%s' is not supported",
@@ -1340,6 +1558,147 @@ Status IrEmitter::HandleAllToAll(HloInstruction* instruction) {
   return OkStatus();
 }
 
+// Returns the number of elements in the dimensions of `shape` that are more
+// major than `dimension` in its layout. The runtime collectives treat the
+// buffer as that many blocks of contiguous data.
+static int64_t ElementsInMoreMajorDimensions(const Shape& shape,
+                                             int64_t dimension) {
+  int64_t elements = 1;
+  for (int64_t dim : LayoutUtil::MinorToMajor(shape)) {
+    if (dim == dimension) {
+      elements = 1;
+    } else {
+      elements *= shape.dimensions(dim);
+    }
+  }
+  return elements;
+}
+
+Status IrEmitter::HandleAllGather(HloInstruction* instruction) {
+  auto* all_gather = Cast<HloAllGatherInstruction>(instruction);
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(all_gather));
+  if (hlo_module_config_.replica_count() == 1 &&
+      hlo_module_config_.num_partitions() == 1) {
+    // A single participant gathers only its own operand.
+    return EmitMemcpy(*all_gather->operand(0), *all_gather);
+  }
+  TF_RET_CHECK(CanEmitAllGatherAsRuntimeCall(*all_gather))
+      << "All-gather should have been decomposed: "
+      << all_gather->ToString();
+
+  const Shape& operand_shape = all_gather->operand(0)->shape();
+  const Shape& shape = all_gather->shape();
+  TF_RET_CHECK(LayoutUtil::Equal(operand_shape.layout(), shape.layout()))
+      << "All-gather operand and result must have the same layout: "
+      << all_gather->ToString();
+  if (ShapeUtil::IsZeroElementArray(operand_shape)) {
+    return OkStatus();
+  }
+  int64_t num_blocks = ElementsInMoreMajorDimensions(
+      operand_shape, all_gather->all_gather_dimension());
+  int64_t block_size = ShapeUtil::ByteSizeOf(operand_shape) / num_blocks;
+
+  std::string replica_groups =
+      ReplicaGroupsToString(all_gather->replica_groups());
+  int32_t replica_groups_size = replica_groups.size();
+  llvm::Value* replica_groups_v = b_.CreateGlobalStringPtr(replica_groups);
+
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice input_slice,
+                      assignment_.GetUniqueSlice(all_gather->operand(0), {}));
+  llvm::Value* input_buffer = EmitBufferPointer(input_slice, operand_shape);
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice output_slice,
+                      assignment_.GetUniqueSlice(all_gather, {}));
+  llvm::Value* output_buffer = EmitBufferPointer(output_slice, shape);
+
+  llvm::Type* i8_ptr_type = llvm::Type::getInt8PtrTy(module_->getContext());
+  EmitCallToFunc(
+      runtime::kAllGatherSymbolName,
+      {/*run_options=*/GetExecutableRunOptionsArgument(),
+       /*channel_id_present=*/
+       b_.getInt32(static_cast<int32_t>(all_gather->channel_id().has_value())),
+       /*use_global_device_ids=*/
+       b_.getInt32(static_cast<int32_t>(all_gather->use_global_device_ids())),
+       /*op_id=*/
+       b_.getInt64(all_gather->channel_id().has_value()
+                       ? *all_gather->channel_id()
+                       : all_gather->GetModule()->unique_id()),
+       /*replica_groups=*/replica_groups_v,
+       /*replica_groups_size=*/b_.getInt32(replica_groups_size),
+       /*num_blocks=*/b_.getInt64(num_blocks),
+       /*block_size=*/b_.getInt64(block_size),
+       /*source_buffer=*/b_.CreateBitCast(input_buffer, i8_ptr_type),
+       /*destination_buffer=*/b_.CreateBitCast(output_buffer, i8_ptr_type)},
+      b_.getVoidTy());
+
+  return OkStatus();
+}
+
+Status IrEmitter::HandleReduceScatter(HloInstruction* instruction) {
+  auto* reduce_scatter = Cast<HloReduceScatterInstruction>(instruction);
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(reduce_scatter));
+  if (hlo_module_config_.replica_count() == 1 &&
+      hlo_module_config_.num_partitions() == 1) {
+    // A single participant keeps its whole operand.
+    return EmitMemcpy(*reduce_scatter->operand(0), *reduce_scatter);
+  }
+  TF_RET_CHECK(CanEmitReduceScatterAsRuntimeCall(*reduce_scatter))
+      << "Reduce-scatter should have been decomposed: "
+      << reduce_scatter->ToString();
+
+  const Shape& operand_shape = reduce_scatter->operand(0)->shape();
+  const Shape& shape = reduce_scatter->shape();
+  TF_RET_CHECK(LayoutUtil::Equal(operand_shape.layout(), shape.layout()))
+      << "Reduce-scatter operand and result must have the same layout: "
+      << reduce_scatter->ToString();
+  if (ShapeUtil::IsZeroElementArray(shape)) {
+    return OkStatus();
+  }
+  int64_t num_blocks = ElementsInMoreMajorDimensions(
+      shape, reduce_scatter->scatter_dimension());
+  int64_t chunk_elements = ShapeUtil::ElementsIn(shape) / num_blocks;
+
+  std::string replica_groups =
+      ReplicaGroupsToString(reduce_scatter->replica_groups());
+  int32_t replica_groups_size = replica_groups.size();
+  llvm::Value* replica_groups_v = b_.CreateGlobalStringPtr(replica_groups);
+
+  TF_ASSIGN_OR_RETURN(
+      BufferAllocation::Slice input_slice,
+      assignment_.GetUniqueSlice(reduce_scatter->operand(0), {}));
+  llvm::Value* input_buffer = EmitBufferPointer(input_slice, operand_shape);
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice output_slice,
+                      assignment_.GetUniqueSlice(reduce_scatter, {}));
+  llvm::Value* output_buffer = EmitBufferPointer(output_slice, shape);
+
+  llvm::Type* i8_ptr_type = llvm::Type::getInt8PtrTy(module_->getContext());
+  EmitCallToFunc(
+      runtime::kReduceScatterSymbolName,
+      {/*run_options=*/GetExecutableRunOptionsArgument(),
+       /*replica_groups=*/replica_groups_v,
+       /*replica_groups_size=*/b_.getInt32(replica_groups_size),
+       /*channel_id_present=*/
+       b_.getInt32(
+           static_cast<int32_t>(reduce_scatter->channel_id().has_value())),
+       /*use_global_device_ids=*/
+       b_.getInt32(
+           static_cast<int32_t>(reduce_scatter->use_global_device_ids())),
+       /*op_id=*/
+       b_.getInt64(reduce_scatter->channel_id().has_value()
+                       ? *reduce_scatter->channel_id()
+                       : reduce_scatter->GetModule()->unique_id()),
+       /*reduction_kind=*/
+       b_.getInt32(static_cast<int32_t>(
+           *MatchReductionComputation(reduce_scatter->to_apply()))),
+       /*element_type=*/b_.getInt32(shape.element_type()),
+       /*num_blocks=*/b_.getInt64(num_blocks),
+       /*chunk_elements=*/b_.getInt64(chunk_elements),
+       /*input_buffer=*/b_.CreateBitCast(input_buffer, i8_ptr_type),
+       /*output_buffer=*/b_.CreateBitCast(output_buffer, i8_ptr_type)},
+      b_.getVoidTy());
+
+  return OkStatus();
+}
+
 Status IrEmitter::HandleCollectivePermute(HloInstruction* crs) {
   auto* instr = Cast<HloCollectivePermuteInstruction>(crs);
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(instr));
@@ -1937,8 +2296,161 @@ Status IrEmitter::HandleSendDone(HloInstruction* send_done) {
   return Unimplemented("Send-done is not implemented on CPU.");
 }
 
-Status IrEmitter::HandleScatter(HloInstruction*) {
-  return Unimplemented("Scatter is not implemented on CPUs.");
+Status IrEmitter::HandleScatter(HloInstruction* hlo) {
+  auto* scatter = Cast<HloScatterInstruction>(hlo);
+  if (scatter->scatter_operand_count() != 1) {
+    return Unimplemented(
+        "Variadic scatter is not implemented on CPU; it should have been "
+        "expanded by ScatterExpander.");
+  }
+  const HloInstruction* operand = scatter->scatter_operands()[0];
+  const HloInstruction* indices = scatter->scatter_indices();
+  const HloInstruction* updates = scatter->scatter_updates()[0];
+  const ScatterDimensionNumbers& dim_numbers =
+      scatter->scatter_dimension_numbers();
+  const Shape& updates_shape = updates->shape();
+  const int64_t rank = operand->shape().rank();
+
+  // Pseudo code for scatter:
+  //
+  // output = operand
+  // for (coordinates U in updates) {
+  //   split U into window dims W and scatter dims S
+  //   I = W with inserted_window_dims set to 0
+  //   for (i, operand_dim in scatter_dims_to_operand_dims) {
+  //     start = indices(S with index_vector_dim = i)
+  //     I[operand_dim] += start
+  //     in_bounds &= 0 <= start <= operand_dim_size - window_size
+  //   }
+  //   if in_bounds and I is in this partition:
+  //     output(I) = to_apply(output(I), updates(U))
+  // }
+  //
+  // When the scatter is split into parallel tasks, every task walks all of
+  // the updates but only applies the ones landing in its own partition of the
+  // output. Each output element is thus owned by a single task and sees its
+  // updates in order, so no atomics are needed. The updates can't be split
+  // between the tasks instead, since a task could then write into the
+  // partition of another before that task has copied the operand there.
+  // ParallelTaskAssignment bounds the number of tasks by the ratio of operand
+  // to update elements to keep the repeated walks cheap.
+
+  // The scatter updates its output in place, so first copy the operand into
+  // the output buffer if they are not the same.
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(scatter));
+  if (GetAllocationSlice(*scatter) != GetAllocationSlice(*operand)) {
+    TF_RETURN_IF_ERROR(EmitTargetElementLoop(
+        scatter, /*desc=*/IrName(scatter, "copy"),
+        [&](const llvm_ir::IrArray::Index& target_index) {
+          return GetIrArrayFor(operand).EmitReadArrayElement(target_index,
+                                                              &b_);
+        }));
+  }
+
+  std::vector<std::pair<llvm::Value*, llvm::Value*>> dynamic_loop_bounds;
+  if (ShouldEmitParallelLoopFor(*scatter)) {
+    dynamic_loop_bounds = compute_function_->GetDynamicLoopBounds();
+  }
+
+  // Window sizes of the operand, with inserted window dimensions of size 1.
+  std::vector<int64_t> window_sizes(rank, 1);
+  for (int64_t i = 0, window_dim = 0; i < rank; ++i) {
+    if (!absl::c_linear_search(dim_numbers.inserted_window_dims(), i)) {
+      window_sizes[i] = updates_shape.dimensions(
+          dim_numbers.update_window_dims(window_dim++));
+    }
+  }
+
+  // Treat an implicit trailing index vector dimension as a dimension of size 1.
+  Shape indices_shape = indices->shape();
+  if (dim_numbers.index_vector_dim() == indices_shape.rank()) {
+    indices_shape.add_dimensions(1);
+    indices_shape.mutable_layout()->add_minor_to_major(
+        dim_numbers.index_vector_dim());
+  }
+  const bool indices_are_signed =
+      primitive_util::IsSignedIntegralType(indices->shape().element_type());
+
+  llvm_ir::IrArray indices_array(GetIrArrayFor(indices));
+  llvm_ir::IrArray updates_array(GetIrArrayFor(updates));
+  llvm_ir::IrArray output_array(GetIrArrayFor(scatter));
+  auto loop_body_emitter =
+      [&](const llvm_ir::IrArray::Index& update_index) -> Status {
+    // Partition the update index into window and scatter dimensions.
+    std::vector<llvm::Value*> window_multi_index;
+    std::vector<llvm::Value*> indices_multi_index;
+    for (int64_t i = 0; i < update_index.size(); ++i) {
+      if (absl::c_linear_search(dim_numbers.update_window_dims(), i)) {
+        window_multi_index.push_back(update_index[i]);
+      } else {
+        indices_multi_index.push_back(update_index[i]);
+      }
+    }
+    std::vector<llvm::Value*> output_multi_index(rank);
+    for (int64_t i = 0, window_dim = 0; i < rank; ++i) {
+      output_multi_index[i] =
+          absl::c_linear_search(dim_numbers.inserted_window_dims(), i)
+              ? update_index.GetConstantWithIndexType(0)
+              : window_multi_index[window_dim++];
+    }
+
+    // Offset the window by the scatter indices, checking that the whole
+    // window fits into the operand. The unsigned comparison includes checking
+    // whether the start index is >= 0. The start indices are widened to the
+    // 64-bit loop index type, never narrowed, so wide out-of-bounds indices
+    // can't wrap into bounds. The offset may overflow for such indices, so it
+    // must not be NSW, whose poison would reach the partition checks below.
+    indices_multi_index.insert(
+        indices_multi_index.begin() + dim_numbers.index_vector_dim(), nullptr);
+    llvm::Value* in_bounds = b_.getTrue();
+    for (int64_t i = 0; i < dim_numbers.scatter_dims_to_operand_dims_size();
+         ++i) {
+      indices_multi_index[dim_numbers.index_vector_dim()] =
+          update_index.GetConstantWithIndexType(i);
+      llvm_ir::IrArray::Index index_vector_index(
+          indices_multi_index, indices_shape, update_index.GetType());
+      llvm::Value* start = IntCast(
+          indices_array.EmitReadArrayElement(
+              index_vector_index.SourceIndexOfReshape(
+                  indices_shape, indices->shape(), &b_),
+              &b_),
+          update_index.GetType(), indices_are_signed);
+      const int64_t operand_dim = dim_numbers.scatter_dims_to_operand_dims(i);
+      output_multi_index[operand_dim] =
+          Add(output_multi_index[operand_dim], start);
+      in_bounds = And(
+          in_bounds,
+          ICmpULT(start, update_index.GetConstantWithIndexType(
+                             operand->shape().dimensions(operand_dim) -
+                             window_sizes[operand_dim] + 1)));
+    }
+
+    // Skip the updates that belong to other parallel tasks; bounds_index i
+    // partitions the i-th most major dimension, as in ParallelLoopEmitter.
+    for (int64_t i = 0; i < dynamic_loop_bounds.size(); ++i) {
+      llvm::Value* dim_index =
+          output_multi_index[LayoutUtil::Major(scatter->shape().layout(), i)];
+      in_bounds = And(in_bounds,
+                      And(ICmpSGE(dim_index, dynamic_loop_bounds[i].first),
+                          ICmpSLT(dim_index, dynamic_loop_bounds[i].second)));
+    }
+
+    llvm_ir::LlvmIfData if_in_bounds = llvm_ir::EmitIfThenElse(
+        in_bounds, "scatter.in_bounds", &b_, /*emit_else=*/false);
+    SetToFirstInsertPoint(if_in_bounds.true_block, &b_);
+    llvm_ir::IrArray::Index output_index(
+        output_multi_index, output_array.GetShape(), update_index.GetType());
+    llvm::Value* result = EmitScalarReturningThreadLocalCall(
+        *scatter->to_apply(),
+        {output_array.EmitReadArrayElement(output_index, &b_),
+         updates_array.EmitReadArrayElement(update_index, &b_)},
+        "scatter_combiner");
+    output_array.EmitWriteArrayElement(output_index, result, &b_);
+    SetToFirstInsertPoint(if_in_bounds.after_block, &b_);
+    return OkStatus();
+  };
+  return llvm_ir::LoopEmitter(loop_body_emitter, updates_shape, &b_)
+      .EmitLoop(IrName(scatter, "updates"), b_.getInt64Ty());
 }
 
 Status IrEmitter::HandleSlice(HloInstruction* slice) {
@@ -2394,7 +2906,28 @@ Status IrEmitter::HandleTopK(HloInstruction* hlo) {
   const HloInstruction* input = hlo->operand(0);
   const int64_t k = hlo->shape().tuple_shapes(0).dimensions().back();
   const bool has_batch = hlo->shape().tuple_shapes(0).dimensions_size() == 2;
-  TF_RET_CHECK(input->shape().element_type() == F32);
+  const PrimitiveType element_type = input->shape().element_type();
+  const char* symbol_name;
+  switch (element_type) {
+    case F32:
+      symbol_name = runtime::kTopKF32SymbolName;
+      break;
+    case F64:
+      symbol_name = runtime::kTopKF64SymbolName;
+      break;
+    case F16:
+      symbol_name = runtime::kTopKF16SymbolName;
+      break;
+    case BF16:
+      symbol_name = runtime::kTopKBF16SymbolName;
+      break;
+    case S32:
+      symbol_name = runtime::kTopKS32SymbolName;
+      break;
+    default:
+      return Unimplemented("TopK is not supported for element type %s on CPU.",
+                           PrimitiveType_Name(element_type));
+  }
   TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(
       hlo->shape().tuple_shapes(0).layout()));
   TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(
@@ -2414,12 +2947,15 @@ Status IrEmitter::HandleTopK(HloInstruction* hlo) {
       EmitBufferPointer(out_values_slice, hlo->shape().tuple_shapes(0));
   llvm::Value* out_indices_ptr =
       EmitBufferPointer(out_indices_slice, hlo->shape().tuple_shapes(1));
+  llvm::Type* element_ptr_type =
+      llvm_ir::PrimitiveTypeToIrType(element_type, module_)->getPointerTo();
   EmitCallToFunc(
-      runtime::kTopKF32SymbolName,
-      {b_.getInt64(has_batch ? input->shape().dimensions(0) : 1),
+      symbol_name,
+      {GetExecutableRunOptionsArgument(),
+       b_.getInt64(has_batch ? input->shape().dimensions(0) : 1),
        b_.getInt64(input->shape().dimensions().back()), b_.getInt64(k),
-       BitCast(values_ptr, b_.getFloatTy()->getPointerTo()),
-       BitCast(out_values_ptr, b_.getFloatTy()->getPointerTo()),
+       BitCast(values_ptr, element_ptr_type),
+       BitCast(out_values_ptr, element_ptr_type),
        BitCast(out_indices_ptr, b_.getInt32Ty()->getPointerTo())},
       b_.getVoidTy());
 
@@ -2428,6 +2964,156 @@ Status IrEmitter::HandleTopK(HloInstruction* hlo) {
   return OkStatus();
 }
 
+// The linear algebra runtime takes PrimitiveType and
+// TriangularSolveOptions::Transpose values.
+static_assert(static_cast<int32_t>(runtime::LinalgType::F32) == F32);
+static_assert(static_cast<int32_t>(runtime::LinalgType::F64) == F64);
+static_assert(static_cast<int32_t>(runtime::LinalgType::C64) == C64);
+static_assert(static_cast<int32_t>(runtime::LinalgType::C128) == C128);
+static_assert(static_cast<int32_t>(runtime::LinalgTranspose::NO_TRANSPOSE) ==
+              TriangularSolveOptions::NO_TRANSPOSE);
+static_assert(static_cast<int32_t>(runtime::LinalgTranspose::TRANSPOSE) ==
+              TriangularSolveOptions::TRANSPOSE);
+static_assert(static_cast<int32_t>(runtime::LinalgTranspose::ADJOINT) ==
+              TriangularSolveOptions::ADJOINT);
+
+// Returns the number of matrices in the trailing two dimensions of `shape`.
+static int64_t MatrixBatchSize(const Shape& shape) {
+  int64_t batch = 1;
+  for (int64_t i = 0; i < shape.rank() - 2; ++i) {
+    batch *= shape.dimensions(i);
+  }
+  return batch;
+}
+
+Status IrEmitter::HandleCholesky(HloInstruction* cholesky) {
+  const HloInstruction* operand = cholesky->operand(0);
+  if (!CanEmitLinalgAsRuntimeCall(*cholesky)) {
+    return Unimplemented("Cholesky of %s is not implemented on CPU.",
+                         ShapeUtil::HumanString(operand->shape()));
+  }
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(operand->shape().layout()));
+  TF_RET_CHECK(
+      LayoutUtil::IsMonotonicWithDim0Major(cholesky->shape().layout()));
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(cholesky));
+
+  llvm::Type* int8_ptr_type = b_.getInt8Ty()->getPointerTo();
+  bool multi_threaded_eigen =
+      hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen();
+  EmitCallToFunc(
+      multi_threaded_eigen ? runtime::kEigenCholeskySymbolName
+                           : runtime::kEigenSingleThreadedCholeskySymbolName,
+      {GetExecutableRunOptionsArgument(),
+       BitCast(GetEmittedValueFor(cholesky), int8_ptr_type),
+       BitCast(GetEmittedValueFor(operand), int8_ptr_type),
+       b_.getInt32(operand->shape().element_type()),
+       b_.getInt64(MatrixBatchSize(operand->shape())),
+       b_.getInt64(operand->shape().dimensions().back()),
+       b_.getInt32(cholesky->cholesky_options().lower())},
+      b_.getVoidTy(), /*does_not_throw=*/true,
+      /*only_accesses_arg_memory=*/false,
+      /*only_accesses_inaccessible_mem_or_arg_mem=*/true);
+  return OkStatus();
+}
+
+Status IrEmitter::HandleTriangularSolve(HloInstruction* triangular_solve) {
+  const HloInstruction* a = triangular_solve->operand(0);
+  const HloInstruction* b = triangular_solve->operand(1);
+  if (!CanEmitLinalgAsRuntimeCall(*triangular_solve)) {
+    return Unimplemented("Triangular solve of %s is not implemented on CPU.",
+                         ShapeUtil::HumanString(a->shape()));
+  }
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(a->shape().layout()));
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(b->shape().layout()));
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(
+      triangular_solve->shape().layout()));
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(triangular_solve));
+
+  const TriangularSolveOptions& options =
+      triangular_solve->triangular_solve_options();
+  const int64_t rank = b->shape().rank();
+  llvm::Type* int8_ptr_type = b_.getInt8Ty()->getPointerTo();
+  bool multi_threaded_eigen =
+      hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen();
+  EmitCallToFunc(
+      multi_threaded_eigen
+          ? runtime::kEigenTriangularSolveSymbolName
+          : runtime::kEigenSingleThreadedTriangularSolveSymbolName,
+      {GetExecutableRunOptionsArgument(),
+       BitCast(GetEmittedValueFor(triangular_solve), int8_ptr_type),
+       BitCast(GetEmittedValueFor(a), int8_ptr_type),
+       BitCast(GetEmittedValueFor(b), int8_ptr_type),
+       b_.getInt32(b->shape().element_type()),
+       b_.getInt64(MatrixBatchSize(b->shape())),
+       b_.getInt64(b->shape().dimensions(rank - 2)),
+       b_.getInt64(b->shape().dimensions(rank - 1)),
+       b_.getInt32(options.left_side()), b_.getInt32(options.lower()),
+       b_.getInt32(options.unit_diagonal()),
+       b_.getInt32(options.transpose_a())},
+      b_.getVoidTy(), /*does_not_throw=*/true,
+      /*only_accesses_arg_memory=*/false,
+      /*only_accesses_inaccessible_mem_or_arg_mem=*/true);
+  return OkStatus();
+}
+
+// Emits a call to the Eigen runtime function for a "Qr" or "Eigh" custom
+// call, whose result is a tuple of two arrays.
+Status IrEmitter::HandleLinalgCustomCall(HloInstruction* custom_call) {
+  const HloInstruction* operand = custom_call->operand(0);
+  const Shape& shape = operand->shape();
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(shape.layout()));
+  for (const Shape& tuple_shape : custom_call->shape().tuple_shapes()) {
+    TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(tuple_shape.layout()));
+  }
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(custom_call));
+  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice out0_slice,
+                      assignment_.GetUniqueSlice(custom_call, {0}));
+  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice out1_slice,
+                      assignment_.GetUniqueSlice(custom_call, {1}));
+  llvm::Value* out0_ptr =
+      EmitBufferPointer(out0_slice, custom_call->shape().tuple_shapes(0));
+  llvm::Value* out1_ptr =
+      EmitBufferPointer(out1_slice, custom_call->shape().tuple_shapes(1));
+
+  llvm::Type* int8_ptr_type = b_.getInt8Ty()->getPointerTo();
+  bool multi_threaded_eigen =
+      hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen();
+  std::vector<llvm::Value*> args = {
+      GetExecutableRunOptionsArgument(), BitCast(out0_ptr, int8_ptr_type),
+      BitCast(out1_ptr, int8_ptr_type),
+      BitCast(GetEmittedValueFor(operand), int8_ptr_type),
+      b_.getInt32(shape.element_type()), b_.getInt64(MatrixBatchSize(shape))};
+  const char* symbol_name;
+  if (custom_call->custom_call_target() == "Qr") {
+    symbol_name = multi_threaded_eigen
+                      ? runtime::kEigenQrSymbolName
+                      : runtime::kEigenSingleThreadedQrSymbolName;
+    args.push_back(b_.getInt64(shape.dimensions(shape.rank() - 2)));
+    args.push_back(b_.getInt64(shape.dimensions(shape.rank() - 1)));
+  } else {
+    // The backend config is "lower,sort_eigenvalues,max_iter,tol". Eigen
+    // always sorts the eigenvalues and iterates until convergence.
+    std::vector<std::string> config_strs =
+        absl::StrSplit(custom_call->raw_backend_config_string(), ',');
+    int lower;
+    if (config_strs.size() != 4 || !absl::SimpleAtoi(config_strs[0], &lower)) {
+      return Internal("Unable to parse arguments to Eigh custom call, got: %s",
+                      custom_call->raw_backend_config_string());
+    }
+    symbol_name = multi_threaded_eigen
+                      ? runtime::kEigenEighSymbolName
+                      : runtime::kEigenSingleThreadedEighSymbolName;
+    args.push_back(b_.getInt64(shape.dimensions().back()));
+    args.push_back(b_.getInt32(lower));
+  }
+  EmitCallToFunc(symbol_name, args, b_.getVoidTy(), /*does_not_throw=*/true,
+                 /*only_accesses_arg_memory=*/false,
+                 /*only_accesses_inaccessible_mem_or_arg_mem=*/true);
+
+  llvm_ir::EmitTuple(GetIrArrayFor(custom_call), {out0_ptr, out1_ptr}, &b_);
+  return OkStatus();
+}
+
 Status IrEmitter::HandleCustomCall(HloInstruction* custom_call) {
   if (custom_call->custom_call_target() == "PadToStatic") {
     return HandlePadToStatic(custom_call);
@@ -2438,6 +3124,9 @@ Status IrEmitter::HandleCustomCall(HloInstruction* custom_call) {
   if (custom_call->custom_call_target() == "TopK") {
     return HandleTopK(custom_call);
   }
+  if (CanEmitLinalgAsRuntimeCall(*custom_call)) {
+    return HandleLinalgCustomCall(custom_call);
+  }
 
   absl::Span<HloInstruction* const> operands(custom_call->operands());
   llvm::Type* i8_ptr_type = b_.getInt8PtrTy();
@@ -2942,6 +3631,93 @@ Status IrEmitter::HandleRng(HloInstruction* rng) {
   return Unimplemented("Rng should be expanded for CPU.");
 }
 
+Status IrEmitter::HandleRngBitGenerator(HloInstruction* rng) {
+  if (!CanEmitRngBitGeneratorAsRuntimeCall(*rng)) {
+    return Unimplemented("RngBitGenerator %s should be expanded for CPU.",
+                         rng->ToString());
+  }
+  const HloInstruction* state = rng->operand(0);
+  const Shape& data_shape = rng->shape().tuple_shapes(1);
+  TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(data_shape.layout()));
+
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(rng));
+  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice state_slice,
+                      assignment_.GetUniqueSlice(state, {}));
+  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice out_state_slice,
+                      assignment_.GetUniqueSlice(rng, {0}));
+  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice out_slice,
+                      assignment_.GetUniqueSlice(rng, {1}));
+  llvm::Value* state_ptr = EmitBufferPointer(state_slice, state->shape());
+  llvm::Value* out_state_ptr =
+      EmitBufferPointer(out_state_slice, rng->shape().tuple_shapes(0));
+  llvm::Value* out_ptr = EmitBufferPointer(out_slice, data_shape);
+  llvm::Type* u64_ptr_type = b_.getInt64Ty()->getPointerTo();
+
+  // Without run options the bits are generated on the calling thread.
+  llvm::Value* run_options = GetExecutableRunOptionsArgument();
+  if (!hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen()) {
+    run_options = llvm::Constant::getNullValue(run_options->getType());
+  }
+  const int64_t bit_width =
+      primitive_util::BitWidth(data_shape.element_type());
+
+  if (Cast<HloRngBitGeneratorInstruction>(rng)->algorithm() !=
+      RandomAlgorithm::RNG_THREE_FRY) {
+    EmitCallToFunc(
+        runtime::kPhiloxBitGeneratorSymbolName,
+        {run_options, BitCast(state_ptr, u64_ptr_type),
+         b_.getInt64(state->shape().dimensions(0)),
+         BitCast(out_state_ptr, u64_ptr_type), b_.getInt64(bit_width),
+         b_.getInt64(ShapeUtil::ElementsIn(data_shape)),
+         BitCast(out_ptr, b_.getInt8PtrTy())},
+        b_.getVoidTy());
+  } else {
+    // Narrow ThreeFry bits use both words of every output by splitting one
+    // dimension into halves, picked as in SplitShapeIntoHalves in
+    // xla/client/lib/prng.cc: the first even dimension, or else the first of
+    // the largest ones.
+    int64_t split_dim = 0;
+    if (data_shape.rank() > 0) {
+      split_dim = -1;
+      for (int64_t i = 0; i < data_shape.rank(); ++i) {
+        if (data_shape.dimensions(i) % 2 == 0) {
+          split_dim = i;
+          break;
+        }
+      }
+      if (split_dim == -1) {
+        split_dim = 0;
+        for (int64_t i = 1; i < data_shape.rank(); ++i) {
+          if (data_shape.dimensions(i) > data_shape.dimensions(split_dim)) {
+            split_dim = i;
+          }
+        }
+      }
+    }
+    int64_t outer_size = 1;
+    int64_t split_size =
+        data_shape.rank() > 0 ? data_shape.dimensions(split_dim) : 1;
+    int64_t inner_size = 1;
+    for (int64_t i = 0; i < data_shape.rank(); ++i) {
+      if (i < split_dim) {
+        outer_size *= data_shape.dimensions(i);
+      } else if (i > split_dim) {
+        inner_size *= data_shape.dimensions(i);
+      }
+    }
+    EmitCallToFunc(
+        runtime::kThreeFryBitGeneratorSymbolName,
+        {run_options, BitCast(state_ptr, u64_ptr_type),
+         BitCast(out_state_ptr, u64_ptr_type), b_.getInt64(bit_width),
+         b_.getInt64(outer_size), b_.getInt64(split_size),
+         b_.getInt64(inner_size), BitCast(out_ptr, b_.getInt8PtrTy())},
+        b_.getVoidTy());
+  }
+
+  llvm_ir::EmitTuple(GetIrArrayFor(rng), {out_state_ptr, out_ptr}, &b_);
+  return OkStatus();
+}
+
 Status IrEmitter::HandleRngGetAndUpdateState(HloInstruction* rng_state) {
   VLOG(2) << "RngGetAndUpdateState: " << rng_state->ToString();
   llvm::Value* old_state = llvm_ir::RngGetAndUpdateState(
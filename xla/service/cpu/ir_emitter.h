@@ -143,7 +143,11 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   Status HandleDot(HloInstruction* dot) override;
   Status HandleConvolution(HloInstruction* convolution) override;
   Status HandleFft(HloInstruction* fft) override;
+  Status HandleCholesky(HloInstruction* cholesky) override;
+  Status HandleTriangularSolve(HloInstruction* triangular_solve) override;
   Status HandleAllReduce(HloInstruction* crs) override;
+  Status HandleAllGather(HloInstruction* instruction) override;
+  Status HandleReduceScatter(HloInstruction* instruction) override;
   Status HandleCollectivePermute(HloInstruction* crs) override;
   Status HandleInfeed(HloInstruction* instruction) override;
   Status HandleOutfeed(HloInstruction* outfeed) override;
@@ -174,6 +178,7 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   Status HandlePartitionId(HloInstruction* hlo) override;
   Status HandleReplicaId(HloInstruction* hlo) override;
   Status HandleRng(HloInstruction* rng) override;
+  Status HandleRngBitGenerator(HloInstruction* rng) override;
   Status HandleRngGetAndUpdateState(HloInstruction* rng_state) override;
   Status FinishVisit(HloInstruction* root) override;
 
@@ -190,6 +195,8 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   Status HandleSliceToDynamic(HloInstruction* hlo);
   Status HandlePadToStatic(HloInstruction* hlo);
   Status HandleTopK(HloInstruction* hlo);
+  Status HandleDirectConvolution(HloInstruction* convolution);
+  Status HandleLinalgCustomCall(HloInstruction* custom_call);
   Status HandleAllReduceSingleReplica(HloInstruction* crs);
   Status HandleAllReduceMultipleReplica(HloInstruction* crs);
 
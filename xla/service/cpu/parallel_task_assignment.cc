@@ -19,16 +19,53 @@ limitations under the License.
 #include <memory>
 
 #include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/service/cpu/backend_config.pb.h"
 #include "xla/service/cpu/ir_emission_utils.h"
 #include "xla/service/cpu/shape_partition.h"
 #include "xla/service/llvm_ir/dynamic_update_slice_util.h"
+#include "xla/shape_util.h"
 
 namespace xla {
 namespace cpu {
+namespace {
+
+// The fork/join runtime balances partitions dynamically over the threads that
+// are free, see runtime_fork_join.cc, so each thread that an instruction is
+// worth gets a few of them. A partition then still costs at least this
+// fraction of the minimum per-thread cost.
+constexpr int64_t kPartitionsPerThread = 4;
+
+// Returns the number of partitions for an instruction of 'instruction_cost',
+// which is worth one thread per 'min_cost_per_thread', up to
+// 'max_parallelism' threads.
+int64_t GetPartitionCount(int64_t instruction_cost, int64_t min_cost_per_thread,
+                          int64_t max_parallelism) {
+  const int64_t thread_count = std::min(
+      max_parallelism,
+      std::max(int64_t{1}, instruction_cost / min_cost_per_thread));
+  return thread_count > 1 ? thread_count * kPartitionsPerThread : 1;
+}
+
+// Returns true if the indices of 'scatter' are unique or its combiner is a
+// commutative operation of its two parameters.
+bool HasUniqueIndicesOrCommutativeCombiner(
+    const HloScatterInstruction& scatter) {
+  if (scatter.unique_indices()) {
+    return true;
+  }
+  const HloInstruction* root = scatter.to_apply()->root_instruction();
+  return HloOpcodeIsBinaryCommutative(root->opcode()) &&
+         root->operand(0)->opcode() == HloOpcode::kParameter &&
+         root->operand(1)->opcode() == HloOpcode::kParameter &&
+         root->operand(0) != root->operand(1);
+}
+
+}  // namespace
 
 class SimpleCostModel : public ParallelCostModel {
  public:
@@ -41,10 +78,8 @@ class SimpleCostModel : public ParallelCostModel {
     // Simple cost model based on hlo size and typical L2 cache size.
     const int64_t instruction_cost = shape_size_(instruction->shape());
     const int64_t min_cost_per_thread = 256LL << 10;  // 256KB L2 Cache size.
-    // Return target parallel task count in [1, max_parallelism_].
-    return std::min(
-        max_parallelism_,
-        std::max(int64_t{1}, instruction_cost / min_cost_per_thread));
+    return GetPartitionCount(instruction_cost, min_cost_per_thread,
+                             max_parallelism_);
   }
 
  private:
@@ -97,10 +132,8 @@ class DefaultCostModel : public ParallelCostModel {
       // Minimum per-thread cost is 100us of work on a 2GHz core.
       min_cost_per_thread = 100000;
     }
-    // Return target parallel task count in [1, max_parallelism_].
-    return std::min(
-        max_parallelism,
-        std::max(int64_t{1}, instruction_cost / min_cost_per_thread));
+    return GetPartitionCount(instruction_cost, min_cost_per_thread,
+                             max_parallelism);
   }
 
  private:
@@ -151,6 +184,25 @@ int64_t ParallelTaskAssignment::GetTargetParallelTaskCount(
     return 1;
   }
 
+  // Every parallel task of a scatter copies its partition of the operand into
+  // the output and then walks all of the updates, applying the ones that land
+  // in its partition (see IrEmitter::HandleScatter). Only do this when the
+  // order of the updates does not matter, and with few enough tasks that
+  // reading the updates once per task costs no more than copying the operand.
+  if (opcode == HloOpcode::kScatter) {
+    const auto* scatter = Cast<HloScatterInstruction>(instruction);
+    if (!HasUniqueIndicesOrCommutativeCombiner(*scatter)) {
+      return 1;
+    }
+    const int64_t max_task_count =
+        ShapeUtil::ElementsIn(scatter->scatter_operands()[0]->shape()) /
+        std::max<int64_t>(
+            1, ShapeUtil::ElementsIn(scatter->scatter_updates()[0]->shape()));
+    return std::max<int64_t>(
+        1, std::min(max_task_count,
+                    cost_model_->GetParallelTaskCount(instruction)));
+  }
+
   // Only allow instructions that can be trivially parallelized (where all
   // outputs can be computed independently of each other).
   if (instruction->IsElementwise() || instruction->IsLoopFusion() ||
@@ -164,7 +216,8 @@ int64_t ParallelTaskAssignment::GetTargetParallelTaskCount(
       opcode == HloOpcode::kTranspose ||
       (opcode == HloOpcode::kConvolution &&
        !PotentiallyImplementedAsEigenConvolution(*instruction,
-                                                 target_machine_features_))) {
+                                                 target_machine_features_) &&
+       !PotentiallyImplementedAsDirectConvolution(*instruction))) {
     // Consult 'cost_model_' to compute target parallel task count.
     return cost_model_->GetParallelTaskCount(instruction);
   }
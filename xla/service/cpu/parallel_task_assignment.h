@@ -29,6 +29,9 @@ namespace cpu {
 class ParallelCostModel {
  public:
   virtual ~ParallelCostModel() = default;
+  // Returns the number of partitions to split 'instruction' into, which may
+  // exceed the number of threads it is worth: the runtime hands partitions to
+  // threads as they become free.
   virtual int64_t GetParallelTaskCount(HloInstruction* instruction) = 0;
 };
 
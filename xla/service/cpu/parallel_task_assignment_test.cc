@@ -15,6 +15,14 @@ limitations under the License.
 
 #include "xla/service/cpu/parallel_task_assignment.h"
 
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/cpu/backend_config.pb.h"
 #include "xla/service/cpu/cpu_executable.h"
 #include "xla/service/cpu/target_machine_features_fake.h"
 #include "xla/test.h"
@@ -206,5 +214,202 @@ TEST_F(ParallelTaskAssignmentTest, ConstantNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest, ScatterParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_scatter
+    add {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT add = f32[] add(lhs, rhs)
+    }
+
+    ENTRY Scatter {
+      operand = f32[1234567,4] parameter(0)
+      indices = s32[1000] parameter(1)
+      updates = f32[1000,4] parameter(2)
+      ROOT scatter = f32[1234567,4] scatter(operand, indices, updates),
+          to_apply=add, update_window_dims={1}, inserted_window_dims={0},
+          scatter_dims_to_operand_dims={0}, index_vector_dim=1
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, ScatterWithUniqueIndicesParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_scatter_unique_indices
+    assign {
+      lhs = f32[] parameter(0)
+      ROOT rhs = f32[] parameter(1)
+    }
+
+    ENTRY Scatter {
+      operand = f32[1234567,4] parameter(0)
+      indices = s32[1000] parameter(1)
+      updates = f32[1000,4] parameter(2)
+      ROOT scatter = f32[1234567,4] scatter(operand, indices, updates),
+          to_apply=assign, update_window_dims={1}, inserted_window_dims={0},
+          scatter_dims_to_operand_dims={0}, index_vector_dim=1,
+          unique_indices=true
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest,
+       ScatterWithNonCommutativeCombinerNotParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_scatter_non_commutative
+    subtract {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT subtract = f32[] subtract(lhs, rhs)
+    }
+
+    ENTRY Scatter {
+      operand = f32[1234567,4] parameter(0)
+      indices = s32[1000] parameter(1)
+      updates = f32[1000,4] parameter(2)
+      ROOT scatter = f32[1234567,4] scatter(operand, indices, updates),
+          to_apply=subtract, update_window_dims={1}, inserted_window_dims={0},
+          scatter_dims_to_operand_dims={0}, index_vector_dim=1
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, ScatterWithLargeUpdatesNotParallelized) {
+  // Every task would read as many updates as the operand has elements.
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_scatter_large_updates
+    add {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT add = f32[] add(lhs, rhs)
+    }
+
+    ENTRY Scatter {
+      operand = f32[1234567,4] parameter(0)
+      indices = s32[1234567] parameter(1)
+      updates = f32[1234567,4] parameter(2)
+      ROOT scatter = f32[1234567,4] scatter(operand, indices, updates),
+          to_apply=add, update_window_dims={1}, inserted_window_dims={0},
+          scatter_dims_to_operand_dims={0}, index_vector_dim=1
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, VariadicScatterNotParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_variadic_scatter
+    add {
+      lhs.0 = f32[] parameter(0)
+      lhs.1 = f32[] parameter(1)
+      rhs.0 = f32[] parameter(2)
+      rhs.1 = f32[] parameter(3)
+      sum.0 = f32[] add(lhs.0, rhs.0)
+      sum.1 = f32[] add(lhs.1, rhs.1)
+      ROOT tuple = (f32[], f32[]) tuple(sum.0, sum.1)
+    }
+
+    ENTRY Scatter {
+      operand.0 = f32[1234567,4] parameter(0)
+      operand.1 = f32[1234567,4] parameter(1)
+      indices = s32[1000] parameter(2)
+      updates.0 = f32[1000,4] parameter(3)
+      updates.1 = f32[1000,4] parameter(4)
+      ROOT scatter = (f32[1234567,4], f32[1234567,4]) scatter(operand.0,
+          operand.1, indices, updates.0, updates.1), to_apply=add,
+          update_window_dims={1}, inserted_window_dims={0},
+          scatter_dims_to_operand_dims={0}, index_vector_dim=1
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+// Returns a module whose root is a loop fusion of 'num_elements' elements that
+// does 32 multiplies per element, which makes it compute bound.
+std::string ComputeBoundFusionModule(int64_t num_elements) {
+  const std::string shape = absl::StrCat("f32[", num_elements, "]");
+  std::string fused = absl::StrCat("      m0 = ", shape, " parameter(0)\n");
+  for (int i = 1; i <= 32; ++i) {
+    absl::StrAppend(&fused, "      ", i == 32 ? "ROOT " : "", "m", i, " = ",
+                    shape, " multiply(m", i - 1, ", m", i - 1, ")\n");
+  }
+  return absl::StrCat(R"(
+  HloModule TestTaskParallel_compute_bound_fusion
+    fused_computation {
+)",
+                      fused, R"(    }
+
+    ENTRY ComputeBound {
+      p = )",
+                      shape, R"( parameter(0)
+      ROOT fusion = )",
+                      shape,
+                      R"( fusion(p), kind=kLoop, calls=fused_computation
+    }
+  )");
+}
+
+TEST_F(ParallelTaskAssignmentTest, FourPartitionsPerThread) {
+  // Returns the partitions the root of a compute bound fusion of
+  // 'num_elements' elements is split into, or 1 if it is not split.
+  auto partition_count = [&](int64_t num_elements) -> StatusOr<int64_t> {
+    TF_ASSIGN_OR_RETURN(
+        std::unique_ptr<HloModule> m,
+        ParseAndReturnVerifiedModule(ComputeBoundFusionModule(num_elements)));
+    TF_ASSIGN_OR_RETURN(bool changed, RunParallelTaskAssigner(m.get()));
+    if (!changed) {
+      return 1;
+    }
+    const HloInstruction* call = m->entry_computation()->root_instruction();
+    TF_RET_CHECK(call->opcode() == HloOpcode::kCall);
+    TF_ASSIGN_OR_RETURN(auto backend_config,
+                        call->to_apply()
+                            ->root_instruction()
+                            ->backend_config<cpu::BackendConfig>());
+    // The fusion is 1-D, so all of its partitions are in that dimension.
+    TF_RET_CHECK(backend_config.outer_dimension_partitions_size() == 1);
+    return backend_config.outer_dimension_partitions(0);
+  };
+
+  // Worth a single thread: not split.
+  TF_ASSERT_OK_AND_ASSIGN(int64_t small, partition_count(16));
+  EXPECT_EQ(small, 1);
+
+  // Worth a few threads: four partitions for each of them.
+  TF_ASSERT_OK_AND_ASSIGN(int64_t medium, partition_count(4096));
+  EXPECT_GT(medium, 4);
+  EXPECT_LT(medium, 4 * max_parallelism_);
+  EXPECT_EQ(medium % 4, 0);
+
+  // Worth more threads than max_parallelism_: capped at four partitions for
+  // each of max_parallelism_ threads.
+  TF_ASSERT_OK_AND_ASSIGN(int64_t large, partition_count(1 << 22));
+  EXPECT_EQ(large, 4 * max_parallelism_);
+}
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,330 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/roofline_profile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/base/attributes.h"
+#include "absl/base/const_init.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// The work done by a calibration kernel on one thread, in floating-point
+// operations or bytes, and the time it took.
+struct KernelRun {
+  double work = 0;
+  double seconds = 0;
+};
+
+// Runs multiply-adds on kLanes independent accumulators, which the compiler
+// turns into kLanes / (vector width) independent vector FMA chains. There must
+// be enough of them to hide the latency of the FMAs, but few enough to stay in
+// registers.
+template <int kLanes>
+ABSL_ATTRIBUTE_ALWAYS_INLINE inline KernelRun ComputeKernelBody() {
+  constexpr int64_t kIterations = (1 << 26) / kLanes;
+  volatile float seed = 1.0f;
+  const float scale = seed * 0.999999f;
+  const float offset = seed * 1e-6f;
+  float accumulators[kLanes];
+  for (int i = 0; i < kLanes; ++i) {
+    accumulators[i] = seed + i;
+  }
+  const uint64_t start_nanos = tsl::Env::Default()->NowNanos();
+  for (int64_t iteration = 0; iteration < kIterations; ++iteration) {
+    for (int i = 0; i < kLanes; ++i) {
+      accumulators[i] = accumulators[i] * scale + offset;
+    }
+  }
+  const uint64_t end_nanos = tsl::Env::Default()->NowNanos();
+  volatile float sink = 0;
+  for (int i = 0; i < kLanes; ++i) {
+    sink = sink + accumulators[i];
+  }
+  return {2.0 * kLanes * kIterations, (end_nanos - start_nanos) * 1e-9};
+}
+
+// Scales a buffer too large for the caches into another one, a few times, and
+// returns the fastest pass. As in HloCostAnalysis, both the bytes read and the
+// bytes written count as accessed.
+ABSL_ATTRIBUTE_ALWAYS_INLINE inline KernelRun MemoryKernelBody(
+    int64_t num_elements) {
+  constexpr int kPasses = 4;
+  std::vector<float> src(num_elements, 1.0f);
+  std::vector<float> dest(num_elements, 0.0f);
+  volatile float seed = 1.0f;
+  const float scale = seed;
+  KernelRun best;
+  for (int pass = 0; pass < kPasses; ++pass) {
+    const uint64_t start_nanos = tsl::Env::Default()->NowNanos();
+    for (int64_t i = 0; i < num_elements; ++i) {
+      dest[i] = src[i] * scale;
+    }
+    const uint64_t end_nanos = tsl::Env::Default()->NowNanos();
+    const double seconds = (end_nanos - start_nanos) * 1e-9;
+    if (pass == 0 || seconds < best.seconds) {
+      best = {2.0 * sizeof(float) * num_elements, seconds};
+    }
+    std::swap(src, dest);
+  }
+  volatile float sink = src[num_elements / 2];
+  (void)sink;
+  return best;
+}
+
+// The kernels are compiled for the baseline ISA of the build, while the
+// compiled HLOs use all the vector units of the host, so x86 hosts get
+// versions of them for the wider ones.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("avx512f"))) KernelRun ComputeKernelAvx512() {
+  return ComputeKernelBody<128>();
+}
+__attribute__((target("avx2,fma"))) KernelRun ComputeKernelAvx2() {
+  return ComputeKernelBody<64>();
+}
+__attribute__((target("avx512f"))) KernelRun MemoryKernelAvx512(
+    int64_t num_elements) {
+  return MemoryKernelBody(num_elements);
+}
+__attribute__((target("avx2,fma"))) KernelRun MemoryKernelAvx2(
+    int64_t num_elements) {
+  return MemoryKernelBody(num_elements);
+}
+#endif
+
+KernelRun RunComputeKernel() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  if (tsl::port::TestCPUFeature(tsl::port::CPUFeature::AVX512F)) {
+    return ComputeKernelAvx512();
+  }
+  if (tsl::port::TestCPUFeature(tsl::port::CPUFeature::AVX2) &&
+      tsl::port::TestCPUFeature(tsl::port::CPUFeature::FMA)) {
+    return ComputeKernelAvx2();
+  }
+#endif
+  return ComputeKernelBody<32>();
+}
+
+KernelRun RunMemoryKernel(int64_t num_elements) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  if (tsl::port::TestCPUFeature(tsl::port::CPUFeature::AVX512F)) {
+    return MemoryKernelAvx512(num_elements);
+  }
+  if (tsl::port::TestCPUFeature(tsl::port::CPUFeature::AVX2) &&
+      tsl::port::TestCPUFeature(tsl::port::CPUFeature::FMA)) {
+    return MemoryKernelAvx2(num_elements);
+  }
+#endif
+  return MemoryKernelBody(num_elements);
+}
+
+// Runs `kernel` on `num_threads` threads at once, a few times, and returns the
+// best throughput of all of them together.
+template <typename Kernel>
+double MeasureThroughput(int num_threads, Kernel kernel) {
+  constexpr int kRepetitions = 3;
+  double best = 0;
+  for (int repetition = 0; repetition < kRepetitions; ++repetition) {
+    std::vector<KernelRun> runs(num_threads);
+    {
+      tsl::thread::ThreadPool pool(tsl::Env::Default(), "roofline_calibration",
+                                   num_threads);
+      for (int i = 0; i < num_threads; ++i) {
+        pool.Schedule([&runs, &kernel, i] { runs[i] = kernel(); });
+      }
+    }
+    double work = 0;
+    double seconds = 0;
+    for (const KernelRun& run : runs) {
+      work += run.work;
+      seconds = std::max(seconds, run.seconds);
+    }
+    if (seconds > 0) {
+      best = std::max(best, work / seconds);
+    }
+  }
+  return best;
+}
+
+HostPeaks MeasureHostPeaks(int num_threads) {
+  // The buffers of the memory kernel add up to 128MiB, but to at least 2MiB
+  // per thread.
+  const int64_t num_elements =
+      std::max<int64_t>((64 << 20) / num_threads, 1 << 20) / sizeof(float);
+  HostPeaks peaks;
+  peaks.flops_per_second = MeasureThroughput(num_threads, RunComputeKernel);
+  peaks.bytes_per_second = MeasureThroughput(
+      num_threads, [&] { return RunMemoryKernel(num_elements); });
+  VLOG(1) << "Host peaks with " << num_threads
+          << " threads: " << peaks.flops_per_second << " FLOP/s, "
+          << peaks.bytes_per_second << " B/s";
+  return peaks;
+}
+
+// Guards the peaks measured by GetHostPeaks, so that calibrations do not run
+// concurrently.
+ABSL_CONST_INIT absl::Mutex peaks_mu(absl::kConstInit);
+
+const char* BoundToString(RooflineProfile::Bound bound) {
+  switch (bound) {
+    case RooflineProfile::COMPUTE_BOUND:
+      return "compute";
+    case RooflineProfile::MEMORY_BOUND:
+      return "memory";
+    default:
+      return "";
+  }
+}
+
+}  // namespace
+
+HostPeaks GetHostPeaks(int num_threads) {
+  static auto* peaks_by_num_threads =
+      new absl::flat_hash_map<int, HostPeaks>();
+  num_threads = std::max(num_threads, 1);
+  absl::MutexLock lock(&peaks_mu);
+  auto it = peaks_by_num_threads->find(num_threads);
+  if (it == peaks_by_num_threads->end()) {
+    it = peaks_by_num_threads
+             ->emplace(num_threads, MeasureHostPeaks(num_threads))
+             .first;
+  }
+  return it->second;
+}
+
+RooflineProfile BuildRooflineProfile(
+    const HloProfilePrinterData& hlo_profile_printer_data,
+    absl::Span<const int64_t> counters, double clock_rate_ghz,
+    const HostPeaks& peaks, int num_threads) {
+  RooflineProfile profile;
+  profile.set_clock_rate_ghz(clock_rate_ghz);
+  profile.set_peak_flops_per_second(peaks.flops_per_second);
+  profile.set_peak_bytes_per_second(peaks.bytes_per_second);
+  profile.set_num_threads(num_threads);
+
+  const bool has_peaks = peaks.flops_per_second > 0 &&
+                         peaks.bytes_per_second > 0 && clock_rate_ghz > 0;
+  for (const auto& computation_info :
+       hlo_profile_printer_data.computation_infos()) {
+    for (const auto& instruction_info : computation_info.instruction_infos()) {
+      CHECK_LT(instruction_info.profile_index(), counters.size());
+      const int64_t cycles = counters[instruction_info.profile_index()];
+      if (cycles <= 0) {
+        continue;
+      }
+      RooflineProfile::Instruction* instruction = profile.add_instructions();
+      instruction->set_long_name(instruction_info.long_name());
+      instruction->set_short_name(instruction_info.short_name());
+      instruction->set_category(instruction_info.category());
+      instruction->set_computation(computation_info.name());
+      instruction->set_cycles(cycles);
+      instruction->set_flop_count(instruction_info.flop_count());
+      instruction->set_transcendental_count(
+          instruction_info.transcendental_count());
+      instruction->set_bytes_accessed(instruction_info.bytes_accessed());
+      if (!has_peaks) {
+        continue;
+      }
+
+      const double seconds = cycles / clock_rate_ghz / 1e9;
+      const double flops = std::max<double>(instruction_info.flop_count(), 0);
+      const double bytes =
+          std::max<double>(instruction_info.bytes_accessed(), 0);
+      instruction->set_seconds(seconds);
+      instruction->set_flops_per_second(flops / seconds);
+      instruction->set_bytes_per_second(bytes / seconds);
+      if (flops == 0 && bytes == 0) {
+        continue;
+      }
+      const double intensity = bytes > 0
+                                   ? flops / bytes
+                                   : std::numeric_limits<double>::infinity();
+      instruction->set_arithmetic_intensity(intensity);
+      if (intensity * peaks.bytes_per_second < peaks.flops_per_second) {
+        instruction->set_attainable_flops_per_second(intensity *
+                                                     peaks.bytes_per_second);
+        instruction->set_bound(RooflineProfile::MEMORY_BOUND);
+        // The same as the FLOP/s over the roof, but also meaningful for HLOs
+        // that only move data.
+        instruction->set_fraction_of_roofline(instruction->bytes_per_second() /
+                                              peaks.bytes_per_second);
+      } else {
+        instruction->set_attainable_flops_per_second(peaks.flops_per_second);
+        instruction->set_bound(RooflineProfile::COMPUTE_BOUND);
+        instruction->set_fraction_of_roofline(instruction->flops_per_second() /
+                                              peaks.flops_per_second);
+      }
+    }
+  }
+
+  absl::c_stable_sort(*profile.mutable_instructions(),
+                      [](const RooflineProfile::Instruction& a,
+                         const RooflineProfile::Instruction& b) {
+                        return a.cycles() > b.cycles();
+                      });
+  return profile;
+}
+
+std::string RooflineProfileToString(const RooflineProfile& profile) {
+  std::string s;
+  absl::StrAppendFormat(
+      &s,
+      "Roofline profile: peak %.1f GFLOP/s and %.1f GB/s with %d threads, "
+      "ridge point at %.2f FLOP/byte\n",
+      profile.peak_flops_per_second() / 1e9,
+      profile.peak_bytes_per_second() / 1e9, profile.num_threads(),
+      profile.peak_bytes_per_second() > 0
+          ? profile.peak_flops_per_second() / profile.peak_bytes_per_second()
+          : 0.0);
+  absl::StrAppendFormat(&s, "%15s %12s %10s %10s %10s %7s %8s  %s\n", "cycles",
+                        "usec", "GFLOP/s", "GB/s", "FLOP/byte", "% roof",
+                        "bound", "hlo");
+  for (const RooflineProfile::Instruction& instruction :
+       profile.instructions()) {
+    const bool has_bound = instruction.bound() != RooflineProfile::BOUND_UNKNOWN;
+    absl::StrAppendFormat(
+        &s, "%15d %12.1f %10.2f %10.2f %10s %7s %8s  %s\n",
+        instruction.cycles(), instruction.seconds() * 1e6,
+        instruction.flops_per_second() / 1e9,
+        instruction.bytes_per_second() / 1e9,
+        has_bound && instruction.bytes_accessed() > 0
+            ? absl::StrFormat("%.2f", instruction.arithmetic_intensity())
+            : "",
+        has_bound
+            ? absl::StrFormat("%.1f", instruction.fraction_of_roofline() * 100)
+            : "",
+        BoundToString(instruction.bound()), instruction.short_name());
+  }
+  return s;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,53 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_ROOFLINE_PROFILE_H_
+#define XLA_SERVICE_CPU_ROOFLINE_PROFILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/types/span.h"
+#include "xla/service/cpu/roofline_profile.pb.h"
+#include "xla/service/hlo_profile_printer_data.pb.h"
+
+namespace xla {
+namespace cpu {
+
+// The peak throughput of the host: the roof of the roofline model.
+struct HostPeaks {
+  double flops_per_second = 0;
+  double bytes_per_second = 0;
+};
+
+// Returns the peak throughput of the host with `num_threads` threads, measured
+// by small compute-bound and memory-bound calibration kernels the first time
+// it is called for that number of threads.
+HostPeaks GetHostPeaks(int num_threads);
+
+// Builds the roofline profile of one execution from its profile counters, the
+// frequency of the cycle counter that filled them and the peaks of the host.
+RooflineProfile BuildRooflineProfile(
+    const HloProfilePrinterData& hlo_profile_printer_data,
+    absl::Span<const int64_t> counters, double clock_rate_ghz,
+    const HostPeaks& peaks, int num_threads);
+
+// Returns a table of the profiled HLOs, slowest first.
+std::string RooflineProfileToString(const RooflineProfile& profile);
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_ROOFLINE_PROFILE_H_
@@ -0,0 +1,121 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/roofline_profile.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "xla/service/hlo_profile_printer_data.pb.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+using ::testing::HasSubstr;
+
+// A computation whose counter is at index 0, with instructions that have the
+// given flop counts and bytes accessed and whose counters follow it.
+HloProfilePrinterData MakePrinterData(
+    const std::vector<std::pair<float, int64_t>>& costs) {
+  HloProfilePrinterData data;
+  data.set_entry_computation("entry");
+  auto* computation = data.add_computation_infos();
+  computation->set_name("entry");
+  computation->set_profile_index(0);
+  for (int64_t i = 0; i < costs.size(); ++i) {
+    auto* instruction = computation->add_instruction_infos();
+    instruction->set_long_name("%op" + std::to_string(i) + " = f32[] op()");
+    instruction->set_short_name("%op" + std::to_string(i));
+    instruction->set_category("category");
+    instruction->set_flop_count(costs[i].first);
+    instruction->set_bytes_accessed(costs[i].second);
+    instruction->set_profile_index(i + 1);
+  }
+  data.set_profile_counters_size(costs.size() + 1);
+  return data;
+}
+
+TEST(RooflineProfileTest, ClassifiesInstructions) {
+  // With these peaks the ridge point is at 10 FLOP/byte.
+  HostPeaks peaks;
+  peaks.flops_per_second = 1e10;
+  peaks.bytes_per_second = 1e9;
+  // At 1GHz, 1000 cycles take a microsecond.
+  HloProfilePrinterData data = MakePrinterData({
+      {/*flop_count=*/5e3, /*bytes_accessed=*/100},  // 50 FLOP/byte.
+      {/*flop_count=*/100, /*bytes_accessed=*/500},  // 0.2 FLOP/byte.
+      {/*flop_count=*/0, /*bytes_accessed=*/250},    // A copy.
+      {/*flop_count=*/0, /*bytes_accessed=*/0},      // Free.
+      {/*flop_count=*/1, /*bytes_accessed=*/1},      // Not profiled.
+  });
+  std::vector<int64_t> counters = {5000, 1000, 2000, 3000, 4000, 0};
+  RooflineProfile profile =
+      BuildRooflineProfile(data, counters, /*clock_rate_ghz=*/1.0, peaks,
+                           /*num_threads=*/2);
+  EXPECT_EQ(profile.num_threads(), 2);
+  EXPECT_DOUBLE_EQ(profile.peak_flops_per_second(), 1e10);
+  ASSERT_EQ(profile.instructions_size(), 4);
+
+  // Sorted by decreasing cycles.
+  const RooflineProfile::Instruction& free = profile.instructions(0);
+  EXPECT_EQ(free.short_name(), "%op3");
+  EXPECT_EQ(free.computation(), "entry");
+  EXPECT_EQ(free.bound(), RooflineProfile::BOUND_UNKNOWN);
+
+  const RooflineProfile::Instruction& copy = profile.instructions(1);
+  EXPECT_EQ(copy.short_name(), "%op2");
+  EXPECT_EQ(copy.bound(), RooflineProfile::MEMORY_BOUND);
+  EXPECT_DOUBLE_EQ(copy.seconds(), 3e-6);
+  EXPECT_DOUBLE_EQ(copy.fraction_of_roofline(), 250 / 3e-6 / 1e9);
+
+  const RooflineProfile::Instruction& memory_bound = profile.instructions(2);
+  EXPECT_EQ(memory_bound.short_name(), "%op1");
+  EXPECT_EQ(memory_bound.bound(), RooflineProfile::MEMORY_BOUND);
+  EXPECT_DOUBLE_EQ(memory_bound.arithmetic_intensity(), 0.2);
+  EXPECT_DOUBLE_EQ(memory_bound.attainable_flops_per_second(), 2e8);
+  EXPECT_DOUBLE_EQ(memory_bound.bytes_per_second(), 2.5e8);
+  EXPECT_DOUBLE_EQ(memory_bound.fraction_of_roofline(), 0.25);
+
+  const RooflineProfile::Instruction& compute_bound = profile.instructions(3);
+  EXPECT_EQ(compute_bound.short_name(), "%op0");
+  EXPECT_EQ(compute_bound.bound(), RooflineProfile::COMPUTE_BOUND);
+  EXPECT_DOUBLE_EQ(compute_bound.arithmetic_intensity(), 50);
+  EXPECT_DOUBLE_EQ(compute_bound.attainable_flops_per_second(), 1e10);
+  EXPECT_DOUBLE_EQ(compute_bound.flops_per_second(), 5e9);
+  EXPECT_DOUBLE_EQ(compute_bound.fraction_of_roofline(), 0.5);
+
+  std::string text = RooflineProfileToString(profile);
+  EXPECT_THAT(text, HasSubstr("peak 10.0 GFLOP/s and 1.0 GB/s with 2 threads"));
+  EXPECT_THAT(text, HasSubstr("ridge point at 10.00 FLOP/byte"));
+  EXPECT_THAT(text, HasSubstr("50.0  compute  %op0"));
+  EXPECT_THAT(text, HasSubstr("25.0   memory  %op1"));
+}
+
+TEST(RooflineProfileTest, MeasuresHostPeaksOnce) {
+  HostPeaks peaks = GetHostPeaks(/*num_threads=*/1);
+  EXPECT_GT(peaks.flops_per_second, 0);
+  EXPECT_GT(peaks.bytes_per_second, 0);
+  HostPeaks cached_peaks = GetHostPeaks(/*num_threads=*/1);
+  EXPECT_EQ(cached_peaks.flops_per_second, peaks.flops_per_second);
+  EXPECT_EQ(cached_peaks.bytes_per_second, peaks.bytes_per_second);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,288 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_direct_conv.h"
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "absl/base/dynamic_annotations.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+
+namespace {
+
+using xla::cpu::DirectConvolutionParams;
+
+// Products of two inputs are computed in Product<T> and summed in
+// Accumulator<T>. Integer sums are unsigned so that they wrap around like the
+// elemental convolution does.
+template <typename T>
+using Product = std::conditional_t<std::is_integral_v<T>, int32_t, float>;
+template <typename T>
+using Accumulator = std::conditional_t<std::is_integral_v<T>, uint32_t, float>;
+
+template <typename T>
+Accumulator<T> Multiply(T a, T b) {
+  return static_cast<Accumulator<T>>(static_cast<Product<T>>(a) *
+                                     static_cast<Product<T>>(b));
+}
+
+// Returns the index of the input element that position `window_index` of the
+// window of output element `output_index` reads, or -1 if it reads padding or
+// a hole left by `lhs_dilation`.
+int64_t InputIndex(int64_t output_index, int64_t window_index, int64_t stride,
+                   int64_t padding, int64_t lhs_dilation,
+                   int64_t rhs_dilation, int64_t input_size) {
+  int64_t dilated_index =
+      output_index * stride + window_index * rhs_dilation - padding;
+  if (dilated_index < 0 || dilated_index % lhs_dilation != 0) {
+    return -1;
+  }
+  int64_t index = dilated_index / lhs_dilation;
+  return index < input_size ? index : -1;
+}
+
+// Adds the products of one input pixel and one kernel tap to the accumulators
+// of one output pixel, which are contiguous in filter order. The loops over
+// filters vectorize when the filters of the kernel (and, for depthwise
+// convolutions, the channels of the input) are contiguous.
+template <typename T>
+void AccumulatePixel(const DirectConvolutionParams& p, const T* input,
+                     const T* kernel, Accumulator<T>* acc) {
+  const int64_t channels = p.kernel_channels;
+  const int64_t filters = p.kernel_filters / p.feature_group_count;
+  const int64_t input_stride = p.input_channel_stride;
+  const int64_t kernel_stride = p.kernel_filter_stride;
+  if (channels == 1 && filters == 1) {
+    // Depthwise: filter f only reads input channel f.
+    if (input_stride == 1 && kernel_stride == 1) {
+      for (int64_t f = 0; f < p.kernel_filters; ++f) {
+        acc[f] += Multiply(input[f], kernel[f]);
+      }
+    } else {
+      for (int64_t f = 0; f < p.kernel_filters; ++f) {
+        acc[f] += Multiply(input[f * input_stride], kernel[f * kernel_stride]);
+      }
+    }
+    return;
+  }
+  for (int64_t g = 0; g < p.feature_group_count; ++g) {
+    Accumulator<T>* acc_group = acc + g * filters;
+    const T* kernel_group = kernel + g * filters * kernel_stride;
+    for (int64_t c = 0; c < channels; ++c) {
+      const T value = input[(g * channels + c) * input_stride];
+      const T* kernel_channel = kernel_group + c * p.kernel_channel_stride;
+      if (kernel_stride == 1) {
+        for (int64_t f = 0; f < filters; ++f) {
+          acc_group[f] += Multiply(value, kernel_channel[f]);
+        }
+      } else {
+        for (int64_t f = 0; f < filters; ++f) {
+          acc_group[f] += Multiply(value, kernel_channel[f * kernel_stride]);
+        }
+      }
+    }
+  }
+}
+
+// Accumulates output row `output_row` of `batch` into `acc`, laid out as
+// [col][filter]. This handles every convolution and is fast when channels are
+// the minor dimension of the input.
+template <typename T>
+void AccumulateRowChannelsLast(const DirectConvolutionParams& p,
+                               const T* lhs, const T* rhs, int64_t batch,
+                               int64_t output_row, Accumulator<T>* acc) {
+  for (int64_t ky = 0; ky < p.kernel_rows; ++ky) {
+    int64_t iy = InputIndex(output_row, ky, p.row_stride, p.padding_top,
+                            p.lhs_row_dilation, p.rhs_row_dilation,
+                            p.input_rows);
+    if (iy < 0) {
+      continue;
+    }
+    const T* input_row =
+        lhs + batch * p.input_batch_stride + iy * p.input_row_stride;
+    const T* kernel_row =
+        rhs + (p.row_reversal ? p.kernel_rows - 1 - ky : ky) *
+                  p.kernel_row_stride;
+    for (int64_t ox = 0; ox < p.output_cols; ++ox) {
+      for (int64_t kx = 0; kx < p.kernel_cols; ++kx) {
+        int64_t ix = InputIndex(ox, kx, p.col_stride, p.padding_left,
+                                p.lhs_col_dilation, p.rhs_col_dilation,
+                                p.input_cols);
+        if (ix < 0) {
+          continue;
+        }
+        const T* kernel_tap =
+            kernel_row + (p.col_reversal ? p.kernel_cols - 1 - kx : kx) *
+                             p.kernel_col_stride;
+        AccumulatePixel(p, input_row + ix * p.input_col_stride, kernel_tap,
+                        acc + ox * p.kernel_filters);
+      }
+    }
+  }
+}
+
+// Accumulates output row `output_row` of `batch` into `acc`, laid out as
+// [filter][col], by sweeping every kernel tap over a whole input row. Requires
+// contiguous input columns, a unit column stride and no column lhs dilation,
+// as in NCHW convolutions.
+template <typename T>
+void AccumulateRowChannelsFirst(const DirectConvolutionParams& p,
+                                const T* lhs, const T* rhs, int64_t batch,
+                                int64_t output_row, Accumulator<T>* acc) {
+  const int64_t channels = p.kernel_channels;
+  const int64_t filters = p.kernel_filters / p.feature_group_count;
+  for (int64_t ky = 0; ky < p.kernel_rows; ++ky) {
+    int64_t iy = InputIndex(output_row, ky, p.row_stride, p.padding_top,
+                            p.lhs_row_dilation, p.rhs_row_dilation,
+                            p.input_rows);
+    if (iy < 0) {
+      continue;
+    }
+    const T* input_row =
+        lhs + batch * p.input_batch_stride + iy * p.input_row_stride;
+    const T* kernel_row =
+        rhs + (p.row_reversal ? p.kernel_rows - 1 - ky : ky) *
+                  p.kernel_row_stride;
+    for (int64_t f = 0; f < p.kernel_filters; ++f) {
+      const int64_t group = f / filters;
+      Accumulator<T>* acc_filter = acc + f * p.output_cols;
+      for (int64_t c = 0; c < channels; ++c) {
+        const T* input_channel =
+            input_row + (group * channels + c) * p.input_channel_stride;
+        const T* kernel_channel = kernel_row + c * p.kernel_channel_stride +
+                                  f * p.kernel_filter_stride;
+        for (int64_t kx = 0; kx < p.kernel_cols; ++kx) {
+          const T weight =
+              kernel_channel[(p.col_reversal ? p.kernel_cols - 1 - kx : kx) *
+                             p.kernel_col_stride];
+          // Output column ox reads input column ox + offset.
+          const int64_t offset = kx * p.rhs_col_dilation - p.padding_left;
+          const int64_t begin = std::max<int64_t>(0, -offset);
+          const int64_t end = std::min(p.output_cols, p.input_cols - offset);
+          for (int64_t ox = begin; ox < end; ++ox) {
+            acc_filter[ox] += Multiply(weight, input_channel[ox + offset]);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Converts the accumulators of one output row, with the given strides, to the
+// output type and stores them.
+template <typename T, typename OutT>
+void StoreRow(const DirectConvolutionParams& p, const Accumulator<T>* acc,
+              int64_t acc_col_stride, int64_t acc_filter_stride, OutT* out) {
+  for (int64_t ox = 0; ox < p.output_cols; ++ox) {
+    const Accumulator<T>* acc_col = acc + ox * acc_col_stride;
+    OutT* out_col = out + ox * p.output_col_stride;
+    if (acc_filter_stride == 1 && p.output_filter_stride == 1) {
+      for (int64_t f = 0; f < p.kernel_filters; ++f) {
+        out_col[f] = static_cast<OutT>(acc_col[f]);
+      }
+    } else {
+      for (int64_t f = 0; f < p.kernel_filters; ++f) {
+        out_col[f * p.output_filter_stride] =
+            static_cast<OutT>(acc_col[f * acc_filter_stride]);
+      }
+    }
+  }
+}
+
+template <typename T, typename OutT>
+void DirectConvolution(const void* run_options_ptr,
+                       const DirectConvolutionParams* params, OutT* out,
+                       const T* lhs, const T* rhs) {
+  const DirectConvolutionParams& p = *params;
+  const bool channels_first = p.input_col_stride == 1 &&
+                              p.input_channel_stride != 1 &&
+                              p.col_stride == 1 && p.lhs_col_dilation == 1;
+  const int64_t acc_col_stride = channels_first ? 1 : p.kernel_filters;
+  const int64_t acc_filter_stride = channels_first ? p.output_cols : 1;
+
+  // Every (batch, output row) pair is computed independently.
+  auto compute_rows = [&](int64_t begin, int64_t end) {
+    std::vector<Accumulator<T>> acc(p.output_cols * p.kernel_filters);
+    for (int64_t row = begin; row < end; ++row) {
+      const int64_t batch = row / p.output_rows;
+      const int64_t output_row = row % p.output_rows;
+      std::fill(acc.begin(), acc.end(), Accumulator<T>(0));
+      if (channels_first) {
+        AccumulateRowChannelsFirst(p, lhs, rhs, batch, output_row, acc.data());
+      } else {
+        AccumulateRowChannelsLast(p, lhs, rhs, batch, output_row, acc.data());
+      }
+      StoreRow<T>(p, acc.data(), acc_col_stride, acc_filter_stride,
+                  out + batch * p.output_batch_stride +
+                      output_row * p.output_row_stride);
+    }
+  };
+
+  const int64_t rows = p.input_batch * p.output_rows;
+  const Eigen::ThreadPoolDevice* device =
+      run_options_ptr == nullptr
+          ? nullptr
+          : static_cast<const xla::ExecutableRunOptions*>(run_options_ptr)
+                ->intra_op_thread_pool();
+  if (device == nullptr || rows <= 1) {
+    compute_rows(0, rows);
+    return;
+  }
+  const double outputs_per_row = p.output_cols * p.kernel_filters;
+  const double taps_per_output =
+      p.kernel_rows * p.kernel_cols * p.kernel_channels;
+  device->parallelFor(
+      rows,
+      Eigen::TensorOpCost(outputs_per_row * taps_per_output * sizeof(T),
+                          outputs_per_row * sizeof(OutT),
+                          outputs_per_row * taps_per_output),
+      [&](Eigen::Index begin, Eigen::Index end) { compute_rows(begin, end); });
+}
+
+}  // namespace
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_DirectConvF32(
+    const void* run_options_ptr,
+    const xla::cpu::DirectConvolutionParams* params, float* out,
+    const float* lhs, const float* rhs) {
+  DirectConvolution(run_options_ptr, params, out, lhs, rhs);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_DirectConvF16(
+    const void* run_options_ptr,
+    const xla::cpu::DirectConvolutionParams* params, Eigen::half* out,
+    const Eigen::half* lhs, const Eigen::half* rhs) {
+  DirectConvolution(run_options_ptr, params, out, lhs, rhs);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_DirectConvS8S32(
+    const void* run_options_ptr,
+    const xla::cpu::DirectConvolutionParams* params, int32_t* out,
+    const int8_t* lhs, const int8_t* rhs) {
+  DirectConvolution(run_options_ptr, params, out, lhs, rhs);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_DirectConvS8S8(
+    const void* run_options_ptr,
+    const xla::cpu::DirectConvolutionParams* params, int8_t* out,
+    const int8_t* lhs, const int8_t* rhs) {
+  DirectConvolution(run_options_ptr, params, out, lhs, rhs);
+}
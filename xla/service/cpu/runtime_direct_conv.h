@@ -0,0 +1,110 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_RUNTIME_DIRECT_CONV_H_
+#define XLA_SERVICE_CPU_RUNTIME_DIRECT_CONV_H_
+
+#include <stdint.h>
+
+#include "Eigen/Core"  // from @eigen_archive
+
+namespace xla {
+namespace cpu {
+
+// Describes a 2D convolution for the direct convolution kernels below. A 1D
+// convolution is a 2D convolution with a single row. Every tensor is addressed
+// through the element strides of its logical dimensions, so any layout is
+// supported. The IR emitter passes this as a constant array of int64s, so all
+// fields must stay int64_t.
+struct DirectConvolutionParams {
+  // Input, in (batch, row, col, channel) order.
+  int64_t input_batch;
+  int64_t input_rows;
+  int64_t input_cols;
+  int64_t input_channels;
+  int64_t input_batch_stride;
+  int64_t input_row_stride;
+  int64_t input_col_stride;
+  int64_t input_channel_stride;
+
+  // Kernel, in (row, col, input channel, filter) order. `kernel_channels` is
+  // the number of input channels of one feature group.
+  int64_t kernel_rows;
+  int64_t kernel_cols;
+  int64_t kernel_channels;
+  int64_t kernel_filters;
+  int64_t kernel_row_stride;
+  int64_t kernel_col_stride;
+  int64_t kernel_channel_stride;
+  int64_t kernel_filter_stride;
+
+  // Output, in (batch, row, col, filter) order.
+  int64_t output_rows;
+  int64_t output_cols;
+  int64_t output_batch_stride;
+  int64_t output_row_stride;
+  int64_t output_col_stride;
+  int64_t output_filter_stride;
+
+  // Window.
+  int64_t row_stride;
+  int64_t col_stride;
+  int64_t padding_top;
+  int64_t padding_left;
+  int64_t lhs_row_dilation;
+  int64_t lhs_col_dilation;
+  int64_t rhs_row_dilation;
+  int64_t rhs_col_dilation;
+  int64_t row_reversal;
+  int64_t col_reversal;
+
+  int64_t feature_group_count;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+extern "C" {
+
+// Computes the convolution described by `params` without lowering it to a
+// matrix multiplication. This is meant for depthwise and grouped convolutions,
+// whose groups are too narrow for a contraction to pay off, and for int8
+// convolutions. Floating point convolutions accumulate in F32 and int8
+// convolutions in 32-bit integers that wrap around. Rows of the output are
+// spread over the intra-op thread pool of `run_options_ptr`; if it is null the
+// convolution runs on the calling thread.
+extern void __xla_cpu_runtime_DirectConvF32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    const xla::cpu::DirectConvolutionParams* params, float* out,
+    const float* lhs, const float* rhs);
+
+extern void __xla_cpu_runtime_DirectConvF16(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    const xla::cpu::DirectConvolutionParams* params, Eigen::half* out,
+    const Eigen::half* lhs, const Eigen::half* rhs);
+
+extern void __xla_cpu_runtime_DirectConvS8S32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    const xla::cpu::DirectConvolutionParams* params, int32_t* out,
+    const int8_t* lhs, const int8_t* rhs);
+
+extern void __xla_cpu_runtime_DirectConvS8S8(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    const xla::cpu::DirectConvolutionParams* params, int8_t* out,
+    const int8_t* lhs, const int8_t* rhs);
+
+}  // extern "C"
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_DIRECT_CONV_H_
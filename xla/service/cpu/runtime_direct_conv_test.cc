@@ -0,0 +1,372 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "xla/service/cpu/runtime_direct_conv.h"
+
+#define EIGEN_USE_THREADS
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns the element strides of a tensor with logical dimensions `dims`,
+// named by the characters of `logical_order`, that is laid out major to minor
+// in `physical_order`.
+std::array<int64_t, 4> Strides(const std::array<int64_t, 4>& dims,
+                               const std::string& logical_order,
+                               const std::string& physical_order) {
+  std::array<int64_t, 4> strides;
+  int64_t stride = 1;
+  for (int i = 3; i >= 0; --i) {
+    int64_t dim = logical_order.find(physical_order[i]);
+    strides[dim] = stride;
+    stride *= dims[dim];
+  }
+  return strides;
+}
+
+struct ConvSpec {
+  int64_t batch = 2;
+  int64_t rows = 7;
+  int64_t cols = 9;
+  int64_t channels = 8;
+  int64_t kernel_rows = 3;
+  int64_t kernel_cols = 3;
+  int64_t filters = 8;
+  int64_t feature_group_count = 8;
+  int64_t row_stride = 1;
+  int64_t col_stride = 1;
+  int64_t padding = 1;
+  int64_t lhs_dilation = 1;
+  int64_t rhs_dilation = 1;
+  bool reversal = false;
+  // Major to minor.
+  std::string input_layout = "NHWC";
+  std::string kernel_layout = "HWIO";
+  std::string output_layout = "NHWC";
+};
+
+DirectConvolutionParams MakeParams(const ConvSpec& spec) {
+  DirectConvolutionParams p;
+  p.input_batch = spec.batch;
+  p.input_rows = spec.rows;
+  p.input_cols = spec.cols;
+  p.input_channels = spec.channels;
+  auto input_strides =
+      Strides({spec.batch, spec.rows, spec.cols, spec.channels}, "NHWC",
+              spec.input_layout);
+  p.input_batch_stride = input_strides[0];
+  p.input_row_stride = input_strides[1];
+  p.input_col_stride = input_strides[2];
+  p.input_channel_stride = input_strides[3];
+
+  p.kernel_rows = spec.kernel_rows;
+  p.kernel_cols = spec.kernel_cols;
+  p.kernel_channels = spec.channels / spec.feature_group_count;
+  p.kernel_filters = spec.filters;
+  auto kernel_strides = Strides({spec.kernel_rows, spec.kernel_cols,
+                                 p.kernel_channels, spec.filters},
+                                "HWIO", spec.kernel_layout);
+  p.kernel_row_stride = kernel_strides[0];
+  p.kernel_col_stride = kernel_strides[1];
+  p.kernel_channel_stride = kernel_strides[2];
+  p.kernel_filter_stride = kernel_strides[3];
+
+  auto output_size = [&](int64_t input, int64_t kernel, int64_t stride) {
+    int64_t dilated_input = (input - 1) * spec.lhs_dilation + 1;
+    int64_t dilated_kernel = (kernel - 1) * spec.rhs_dilation + 1;
+    return (dilated_input + 2 * spec.padding - dilated_kernel) / stride + 1;
+  };
+  p.output_rows = output_size(spec.rows, spec.kernel_rows, spec.row_stride);
+  p.output_cols = output_size(spec.cols, spec.kernel_cols, spec.col_stride);
+  auto output_strides =
+      Strides({spec.batch, p.output_rows, p.output_cols, spec.filters}, "NHWC",
+              spec.output_layout);
+  p.output_batch_stride = output_strides[0];
+  p.output_row_stride = output_strides[1];
+  p.output_col_stride = output_strides[2];
+  p.output_filter_stride = output_strides[3];
+
+  p.row_stride = spec.row_stride;
+  p.col_stride = spec.col_stride;
+  p.padding_top = spec.padding;
+  p.padding_left = spec.padding;
+  p.lhs_row_dilation = spec.lhs_dilation;
+  p.lhs_col_dilation = spec.lhs_dilation;
+  p.rhs_row_dilation = spec.rhs_dilation;
+  p.rhs_col_dilation = spec.rhs_dilation;
+  p.row_reversal = spec.reversal;
+  p.col_reversal = spec.reversal;
+  p.feature_group_count = spec.feature_group_count;
+  return p;
+}
+
+// A straightforward convolution over the dilated and padded input, in
+// double for floating point types and with wrapping int32 sums for integers.
+template <typename T, typename OutT>
+std::vector<double> ReferenceConvolution(const DirectConvolutionParams& p,
+                                         const std::vector<T>& lhs,
+                                         const std::vector<T>& rhs) {
+  std::vector<double> out(p.input_batch * p.output_rows * p.output_cols *
+                          p.kernel_filters);
+  const int64_t filters_per_group = p.kernel_filters / p.feature_group_count;
+  for (int64_t n = 0; n < p.input_batch; ++n) {
+    for (int64_t oy = 0; oy < p.output_rows; ++oy) {
+      for (int64_t ox = 0; ox < p.output_cols; ++ox) {
+        for (int64_t f = 0; f < p.kernel_filters; ++f) {
+          double sum = 0;
+          uint32_t int_sum = 0;
+          for (int64_t ky = 0; ky < p.kernel_rows; ++ky) {
+            for (int64_t kx = 0; kx < p.kernel_cols; ++kx) {
+              int64_t y = oy * p.row_stride + ky * p.rhs_row_dilation -
+                          p.padding_top;
+              int64_t x = ox * p.col_stride + kx * p.rhs_col_dilation -
+                          p.padding_left;
+              if (y < 0 || x < 0 || y % p.lhs_row_dilation != 0 ||
+                  x % p.lhs_col_dilation != 0 ||
+                  y / p.lhs_row_dilation >= p.input_rows ||
+                  x / p.lhs_col_dilation >= p.input_cols) {
+                continue;
+              }
+              y /= p.lhs_row_dilation;
+              x /= p.lhs_col_dilation;
+              int64_t kernel_y =
+                  p.row_reversal ? p.kernel_rows - 1 - ky : ky;
+              int64_t kernel_x =
+                  p.col_reversal ? p.kernel_cols - 1 - kx : kx;
+              for (int64_t c = 0; c < p.kernel_channels; ++c) {
+                int64_t input_c =
+                    (f / filters_per_group) * p.kernel_channels + c;
+                T a = lhs[n * p.input_batch_stride + y * p.input_row_stride +
+                          x * p.input_col_stride +
+                          input_c * p.input_channel_stride];
+                T b = rhs[kernel_y * p.kernel_row_stride +
+                          kernel_x * p.kernel_col_stride +
+                          c * p.kernel_channel_stride +
+                          f * p.kernel_filter_stride];
+                if constexpr (std::is_integral_v<T>) {
+                  int_sum += static_cast<uint32_t>(static_cast<int32_t>(a) *
+                                                   static_cast<int32_t>(b));
+                } else {
+                  sum += static_cast<double>(a) * static_cast<double>(b);
+                }
+              }
+            }
+          }
+          double& result =
+              out[((n * p.output_rows + oy) * p.output_cols + ox) *
+                      p.kernel_filters +
+                  f];
+          if constexpr (std::is_integral_v<OutT>) {
+            result = static_cast<OutT>(int_sum);
+          } else {
+            result = sum;
+          }
+        }
+      }
+    }
+  }
+  return out;
+}
+
+template <typename T, typename OutT>
+using DirectConvFunction = void (*)(const void*,
+                                    const DirectConvolutionParams*, OutT*,
+                                    const T*, const T*);
+
+template <typename T, typename OutT>
+void ExpectMatchesReference(DirectConvFunction<T, OutT> conv,
+                            const ConvSpec& spec, double tolerance) {
+  DirectConvolutionParams p = MakeParams(spec);
+  std::minstd_rand0 generator(0);
+  std::uniform_int_distribution<int> distribution(-128, 127);
+  auto random_values = [&](int64_t size) {
+    std::vector<T> values(size);
+    for (T& value : values) {
+      value = static_cast<T>(std::is_integral_v<T>
+                                 ? distribution(generator)
+                                 : distribution(generator) / 64.0f);
+    }
+    return values;
+  };
+  std::vector<T> lhs =
+      random_values(spec.batch * spec.rows * spec.cols * spec.channels);
+  std::vector<T> rhs = random_values(spec.kernel_rows * spec.kernel_cols *
+                                     p.kernel_channels * spec.filters);
+  std::vector<double> expected = ReferenceConvolution<T, OutT>(p, lhs, rhs);
+
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  for (const ExecutableRunOptions* options :
+       std::vector<const ExecutableRunOptions*>{&run_options, nullptr}) {
+    std::vector<OutT> out(expected.size());
+    conv(options, &p, out.data(), lhs.data(), rhs.data());
+    for (int64_t n = 0; n < spec.batch; ++n) {
+      for (int64_t oy = 0; oy < p.output_rows; ++oy) {
+        for (int64_t ox = 0; ox < p.output_cols; ++ox) {
+          for (int64_t f = 0; f < spec.filters; ++f) {
+            double actual = static_cast<double>(
+                out[n * p.output_batch_stride + oy * p.output_row_stride +
+                    ox * p.output_col_stride + f * p.output_filter_stride]);
+            ASSERT_NEAR(
+                actual,
+                expected[((n * p.output_rows + oy) * p.output_cols + ox) *
+                             spec.filters +
+                         f],
+                tolerance)
+                << "at (" << n << ", " << oy << ", " << ox << ", " << f
+                << ") multi-threaded " << (options != nullptr);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Depthwise, grouped and ordinary convolutions, with and without a depth
+// multiplier.
+std::vector<ConvSpec> GroupingSpecs() {
+  std::vector<ConvSpec> specs;
+  for (auto [channels, filters, groups] :
+       std::vector<std::array<int64_t, 3>>{
+           {8, 8, 8}, {8, 16, 8}, {12, 6, 3}, {8, 12, 4}, {4, 5, 1}}) {
+    ConvSpec spec;
+    spec.channels = channels;
+    spec.filters = filters;
+    spec.feature_group_count = groups;
+    specs.push_back(spec);
+  }
+  return specs;
+}
+
+// Every grouping in every layout and with every window feature.
+std::vector<ConvSpec> AllSpecs() {
+  std::vector<ConvSpec> specs;
+  for (const ConvSpec& grouping : GroupingSpecs()) {
+    for (auto [input_layout, kernel_layout, output_layout] :
+         std::vector<std::array<std::string, 3>>{{"NHWC", "HWIO", "NHWC"},
+                                                 {"NCHW", "OIHW", "NCHW"},
+                                                 {"NCHW", "HWIO", "NHWC"},
+                                                 {"HWNC", "IOHW", "CNHW"}}) {
+      ConvSpec spec = grouping;
+      spec.input_layout = input_layout;
+      spec.kernel_layout = kernel_layout;
+      spec.output_layout = output_layout;
+      specs.push_back(spec);
+      ConvSpec strided = spec;
+      strided.row_stride = 2;
+      strided.col_stride = 2;
+      strided.padding = 2;
+      specs.push_back(strided);
+      ConvSpec dilated = spec;
+      dilated.rhs_dilation = 2;
+      dilated.reversal = true;
+      specs.push_back(dilated);
+      ConvSpec lhs_dilated = spec;
+      lhs_dilated.lhs_dilation = 2;
+      lhs_dilated.padding = 0;
+      specs.push_back(lhs_dilated);
+    }
+  }
+  ConvSpec one_dimensional;
+  one_dimensional.rows = 1;
+  one_dimensional.kernel_rows = 1;
+  one_dimensional.padding = 0;
+  specs.push_back(one_dimensional);
+  return specs;
+}
+
+TEST(RuntimeDirectConvTest, F32) {
+  for (const ConvSpec& spec : AllSpecs()) {
+    ExpectMatchesReference<float, float>(__xla_cpu_runtime_DirectConvF32, spec,
+                                         1e-4);
+  }
+}
+
+TEST(RuntimeDirectConvTest, F16) {
+  for (const ConvSpec& spec : AllSpecs()) {
+    ExpectMatchesReference<Eigen::half, Eigen::half>(
+        __xla_cpu_runtime_DirectConvF16, spec, 0.1);
+  }
+}
+
+TEST(RuntimeDirectConvTest, S8S32) {
+  for (const ConvSpec& spec : AllSpecs()) {
+    ExpectMatchesReference<int8_t, int32_t>(__xla_cpu_runtime_DirectConvS8S32,
+                                            spec, 0);
+  }
+}
+
+TEST(RuntimeDirectConvTest, S8S8Wraps) {
+  for (const ConvSpec& spec : AllSpecs()) {
+    ExpectMatchesReference<int8_t, int8_t>(__xla_cpu_runtime_DirectConvS8S8,
+                                           spec, 0);
+  }
+}
+
+// Runs a 3x3 depthwise convolution over 8x56x56 images with range(0) channels,
+// in NHWC if range(1) is 0 and in NCHW otherwise.
+void BM_DepthwiseConvF32(::testing::benchmark::State& state) {
+  ConvSpec spec;
+  spec.batch = 8;
+  spec.rows = 56;
+  spec.cols = 56;
+  spec.channels = state.range(0);
+  spec.filters = state.range(0);
+  spec.feature_group_count = state.range(0);
+  if (state.range(1) != 0) {
+    spec.input_layout = "NCHW";
+    spec.kernel_layout = "OIHW";
+    spec.output_layout = "NCHW";
+  }
+  DirectConvolutionParams p = MakeParams(spec);
+  std::vector<float> lhs(spec.batch * spec.rows * spec.cols * spec.channels,
+                         1.0f);
+  std::vector<float> rhs(spec.kernel_rows * spec.kernel_cols * spec.filters,
+                         1.0f);
+  std::vector<float> out(spec.batch * p.output_rows * p.output_cols *
+                         spec.filters);
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  for (auto s : state) {
+    __xla_cpu_runtime_DirectConvF32(&run_options, &p, out.data(), lhs.data(),
+                                    rhs.data());
+  }
+}
+
+BENCHMARK(BM_DepthwiseConvF32)
+    ->ArgPair(32, 0)
+    ->ArgPair(32, 1)
+    ->ArgPair(256, 0)
+    ->ArgPair(256, 1);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -17,21 +17,185 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
 #include "absl/base/dynamic_annotations.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/fixed_array.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "xla/executable_run_options.h"
 #include "xla/service/custom_call_status_internal.h"
-#include "tsl/platform/blocking_counter.h"
 #include "tsl/platform/logging.h"
 
 using ComputeFunctionType = void (*)(void*, const void*, const void**, void**,
                                      void*, int64_t*, uint64_t*);
 
-// Dispatches 'num_partitions - 1' calls to 'function_ptr' in parallel.
-// Calls 'function_ptr' for first partition inline.
-// Uses blocking counter to synchronize threads after parallel calls complete.
+namespace {
+
+// The state of one fork/join call. The worker threads share its ownership:
+// a worker that the pool only starts after all partitions have run finds no
+// work, and must not touch the stack of the call that has returned by then.
+struct ForkJoinState {
+  // A range [begin, end) of partitions, packed into one word with 'begin' in
+  // the low half. Its worker runs partitions from the front, and the other
+  // workers steal halves from the back.
+  struct alignas(64) Queue {
+    std::atomic<uint64_t> range{0};
+  };
+
+  ForkJoinState(ComputeFunctionType function, void* result_ptr,
+                const void* run_options_ptr, void** buffer_table,
+                uint64_t* prof_counters, int64_t* partitions, int64_t stride,
+                int32_t num_partitions, int32_t num_workers)
+      : function(function),
+        result_ptr(result_ptr),
+        run_options_ptr(run_options_ptr),
+        buffer_table(buffer_table),
+        prof_counters(prof_counters),
+        partitions(partitions),
+        stride(stride),
+        queues(num_workers),
+        num_unfinished(num_partitions) {}
+
+  const ComputeFunctionType function;
+  void* const result_ptr;
+  const void* const run_options_ptr;
+  void** const buffer_table;
+  uint64_t* const prof_counters;
+  int64_t* const partitions;
+  const int64_t stride;
+
+  absl::FixedArray<Queue, 16> queues;
+  std::atomic<int32_t> num_unfinished;
+  // Once a partition has failed, the remaining ones are skipped.
+  std::atomic<bool> failed{false};
+  absl::Notification done;
+
+  absl::Mutex mu;
+  std::vector<std::pair<int32_t, std::string>> errors ABSL_GUARDED_BY(mu);
+};
+
+uint64_t PackRange(uint32_t begin, uint32_t end) {
+  return (static_cast<uint64_t>(end) << 32) | begin;
+}
+
+std::pair<uint32_t, uint32_t> UnpackRange(uint64_t range) {
+  return {static_cast<uint32_t>(range), static_cast<uint32_t>(range >> 32)};
+}
+
+// Takes the first partition of 'queue', if any.
+std::optional<int32_t> PopFront(ForkJoinState::Queue& queue) {
+  uint64_t range = queue.range.load(std::memory_order_acquire);
+  while (true) {
+    auto [begin, end] = UnpackRange(range);
+    if (begin >= end) {
+      return std::nullopt;
+    }
+    if (queue.range.compare_exchange_weak(range, PackRange(begin + 1, end),
+                                          std::memory_order_acq_rel)) {
+      return begin;
+    }
+  }
+}
+
+// Moves the back half of the longest queue of another worker into the queue
+// of 'worker', which is empty, and returns the first partition of that half.
+// Returns nullopt once all queues are empty.
+std::optional<int32_t> Steal(ForkJoinState& state, int32_t worker) {
+  const int32_t num_workers = state.queues.size();
+  while (true) {
+    int32_t victim = -1;
+    uint64_t victim_range = 0;
+    uint32_t victim_size = 0;
+    for (int32_t i = 1; i < num_workers; ++i) {
+      const int32_t candidate = (worker + i) % num_workers;
+      uint64_t range =
+          state.queues[candidate].range.load(std::memory_order_acquire);
+      auto [begin, end] = UnpackRange(range);
+      if (begin < end && end - begin > victim_size) {
+        victim = candidate;
+        victim_range = range;
+        victim_size = end - begin;
+      }
+    }
+    if (victim < 0) {
+      return std::nullopt;
+    }
+    auto [begin, end] = UnpackRange(victim_range);
+    const uint32_t middle = begin + (end - begin) / 2;
+    if (state.queues[victim].range.compare_exchange_strong(
+            victim_range, PackRange(begin, middle),
+            std::memory_order_acq_rel)) {
+      // Nobody else changes an empty queue, so a plain store suffices.
+      state.queues[worker].range.store(PackRange(middle + 1, end),
+                                       std::memory_order_release);
+      return middle;
+    }
+  }
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void RunPartition(ForkJoinState& state,
+                                                    int32_t partition) {
+  if (!state.failed.load(std::memory_order_relaxed)) {
+    XlaCustomCallStatus status;
+    state.function(state.result_ptr, state.run_options_ptr, nullptr,
+                   state.buffer_table, &status,
+                   &state.partitions[partition * state.stride],
+                   state.prof_counters);
+    if (std::optional<absl::string_view> msg =
+            xla::CustomCallStatusGetMessage(&status)) {
+      state.failed.store(true, std::memory_order_relaxed);
+      absl::MutexLock lock(&state.mu);
+      state.errors.emplace_back(partition, std::string(*msg));
+    }
+  }
+  VLOG(3) << "ParallelForkJoin partition " << partition << " done.";
+  if (state.num_unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    state.done.Notify();
+  }
+}
+
+// Runs the partitions of 'worker', then steals from the other workers until
+// no partitions are left.
+void Work(ForkJoinState& state, int32_t worker) {
+  ForkJoinState::Queue& queue = state.queues[worker];
+  while (true) {
+    std::optional<int32_t> partition = PopFront(queue);
+    if (!partition.has_value()) {
+      partition = Steal(state, worker);
+    }
+    if (!partition.has_value()) {
+      return;
+    }
+    RunPartition(state, *partition);
+  }
+}
+
+}  // namespace
+
+// Dispatches calls to 'function_ptr' for the 'num_partitions' partitions of
+// the iteration space to the intra-op thread pool, and returns once all of
+// them have run.
+//
+// The partitions are split evenly into contiguous ranges, one for the calling
+// thread and one for each thread of the pool, up to one partition per thread.
+// A thread that runs out of partitions steals the back half of the largest
+// remaining range, so skewed partitions and threads that are busy with other
+// work don't hold up the call. Partitions are therefore best made a few times
+// finer than the available parallelism, see ParallelTaskAssignment.
 //
 // The 'partitions' array has a total number of elements equal to
 // 'num_partitions * num_partitioned_dims * 2' (the '2' is necessary to specify
@@ -73,55 +237,43 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_ParallelForkJoin(
   const xla::ExecutableRunOptions* run_options =
       static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
   CHECK_NE(run_options, nullptr);
-  CHECK_NE(run_options->intra_op_thread_pool(), nullptr);
-
-  ComputeFunctionType function =
-      reinterpret_cast<ComputeFunctionType>(function_ptr);
-  // Compute partition stride in 'partitions' array.
-  const int64_t stride = 2 * num_partitioned_dims;
-
-  std::vector<XlaCustomCallStatus> statuses(num_partitions);
-
-  // Dispatch 'num_partitions - 1' compute functions to run in parallel.
-  tsl::BlockingCounter bc(num_partitions - 1);
-  for (int32_t i = 1; i < num_partitions; ++i) {
-    const int64_t offset = i * stride;
-    run_options->intra_op_thread_pool()->enqueueNoNotification(
-        [i, function, result_ptr, run_options_ptr, buffer_table, prof_counters,
-         partitions, offset, &bc, &statuses]() {
-          function(result_ptr, run_options_ptr, nullptr, buffer_table,
-                   &statuses[i], &partitions[offset], prof_counters);
-          bc.DecrementCount();
-          VLOG(3) << "ParallelForkJoin partition " << i << " done.";
-        });
+  const Eigen::ThreadPoolDevice* pool = run_options->intra_op_thread_pool();
+  CHECK_NE(pool, nullptr);
+
+  // The calling thread takes part unless it is one of the pool's threads
+  // already.
+  const int32_t num_threads =
+      pool->numThreads() + (pool->currentThreadId() < 0 ? 1 : 0);
+  const int32_t num_workers = std::min(num_partitions, num_threads);
+
+  auto state = std::make_shared<ForkJoinState>(
+      reinterpret_cast<ComputeFunctionType>(function_ptr), result_ptr,
+      run_options_ptr, buffer_table, prof_counters, partitions,
+      /*stride=*/2 * num_partitioned_dims, num_partitions, num_workers);
+  for (int32_t i = 0; i < num_workers; ++i) {
+    state->queues[i].range.store(
+        PackRange(int64_t{num_partitions} * i / num_workers,
+                  int64_t{num_partitions} * (i + 1) / num_workers),
+        std::memory_order_relaxed);
   }
 
-  // Call first compute function inline.
-  function(result_ptr, run_options_ptr, params, buffer_table, &statuses[0],
-           &partitions[0], prof_counters);
-  VLOG(3) << "ParallelForkJoin partition 0 done.";
-  bc.Wait();
-
-  // Collect all error messages (if any).
-  std::vector<std::pair<int32_t, absl::string_view>> error_messages;
-  for (int32_t i = 0; i < num_partitions; ++i) {
-    std::optional<absl::string_view> msg =
-        xla::CustomCallStatusGetMessage(&statuses[i]);
-    if (msg) {
-      error_messages.emplace_back(i, *msg);
-    }
+  // Worker 0 is the calling thread.
+  for (int32_t i = 1; i < num_workers; ++i) {
+    pool->enqueueNoNotification([state, i]() { Work(*state, i); });
   }
+  Work(*state, 0);
+  state->done.WaitForNotification();
 
-  if (!error_messages.empty()) {
+  absl::MutexLock lock(&state->mu);
+  if (!state->errors.empty()) {
     // Join all error messages into a single string to serve as the message for
     // the returned status.
+    absl::c_sort(state->errors);
     std::string error_message = absl::StrJoin(
-        error_messages, "\n",
-        [](std::string* out, std::pair<int32_t, absl::string_view> p) {
-          int32_t idx = p.first;
-          absl::string_view msg = p.second;
-          absl::StrAppend(out,
-                          absl::StrFormat("Partition %d error: %s", idx, msg));
+        state->errors, "\n",
+        [](std::string* out, const std::pair<int32_t, std::string>& p) {
+          absl::StrAppend(out, absl::StrFormat("Partition %d error: %s",
+                                               p.first, p.second));
         });
     XlaCustomCallStatusSetFailure(
         reinterpret_cast<XlaCustomCallStatus*>(status), error_message.data(),
@@ -0,0 +1,142 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_fork_join.h"
+
+#define EIGEN_USE_THREADS
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/service/custom_call_status.h"
+#include "xla/service/custom_call_status_internal.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+constexpr int64_t kNumElements = 1000;
+
+// Counts the visits of each element of its partition in the array of counters
+// in the first buffer of the buffer table. Partitions that start at a multiple
+// of 100 spin for a while, and the one that starts at 500 fails.
+void CountVisits(void* /*result*/, const void* /*run_options*/,
+                 const void** /*params*/, void** buffer_table, void* status,
+                 int64_t* partition, uint64_t* /*prof_counters*/) {
+  auto* counters = static_cast<std::atomic<int64_t>*>(buffer_table[0]);
+  const int64_t start = partition[0];
+  const int64_t limit = partition[1];
+  if (start % 100 == 0) {
+    volatile int64_t sink = 0;
+    for (int64_t i = 0; i < 1000000; ++i) {
+      sink = sink + i;
+    }
+  }
+  for (int64_t i = start; i < limit; ++i) {
+    counters[i].fetch_add(1, std::memory_order_relaxed);
+  }
+  if (start == 500) {
+    const char kMessage[] = "failed";
+    XlaCustomCallStatusSetFailure(static_cast<XlaCustomCallStatus*>(status),
+                                  kMessage, strlen(kMessage));
+  }
+}
+
+class RuntimeForkJoinTest : public ::testing::Test {
+ protected:
+  RuntimeForkJoinTest() : pool_(4), device_(&pool_, pool_.NumThreads()) {
+    run_options_.set_intra_op_thread_pool(&device_);
+  }
+
+  // Runs CountVisits on 'num_partitions' even partitions of the elements and
+  // returns the error message, if any.
+  std::optional<std::string> ForkJoin(
+      int32_t num_partitions, std::vector<std::atomic<int64_t>>* counters) {
+    std::vector<int64_t> partitions;
+    for (int32_t i = 0; i < num_partitions; ++i) {
+      partitions.push_back(kNumElements * i / num_partitions);
+      partitions.push_back(kNumElements * (i + 1) / num_partitions);
+    }
+    void* buffer_table[] = {counters->data()};
+    XlaCustomCallStatus status;
+    __xla_cpu_runtime_ParallelForkJoin(
+        /*result_ptr=*/nullptr, &run_options_, /*params=*/nullptr,
+        buffer_table, &status, /*prof_counters=*/nullptr, num_partitions,
+        partitions.data(), /*num_partitioned_dims=*/1,
+        reinterpret_cast<void*>(&CountVisits));
+    std::optional<absl::string_view> message =
+        CustomCallStatusGetMessage(&status);
+    if (!message.has_value()) {
+      return std::nullopt;
+    }
+    return std::string(*message);
+  }
+
+  Eigen::ThreadPool pool_;
+  Eigen::ThreadPoolDevice device_;
+  ExecutableRunOptions run_options_;
+};
+
+TEST_F(RuntimeForkJoinTest, RunsEachPartitionOnce) {
+  for (int32_t num_partitions : {2, 3, 4, 5, 16, 20, 1000}) {
+    std::vector<std::atomic<int64_t>> counters(kNumElements);
+    // Partitions that start at 500 only exist for even partition counts.
+    std::optional<std::string> error = ForkJoin(num_partitions, &counters);
+    EXPECT_EQ(error.has_value(), num_partitions % 2 == 0) << num_partitions;
+    for (int64_t i = 0; i < kNumElements; ++i) {
+      if (error.has_value()) {
+        // Partitions after the failure may be skipped.
+        EXPECT_LE(counters[i], 1) << num_partitions << " " << i;
+      } else {
+        EXPECT_EQ(counters[i], 1) << num_partitions << " " << i;
+      }
+    }
+  }
+}
+
+TEST_F(RuntimeForkJoinTest, RunsFromThreadOfPool) {
+  std::vector<std::atomic<int64_t>> counters(kNumElements);
+  std::optional<std::string> error;
+  Eigen::Barrier barrier(1);
+  pool_.Schedule([&]() {
+    error = ForkJoin(/*num_partitions=*/25, &counters);
+    barrier.Notify();
+  });
+  barrier.Wait();
+  EXPECT_FALSE(error.has_value());
+  for (int64_t i = 0; i < kNumElements; ++i) {
+    EXPECT_EQ(counters[i], 1) << i;
+  }
+}
+
+TEST_F(RuntimeForkJoinTest, ReportsFailedPartition) {
+  std::vector<std::atomic<int64_t>> counters(kNumElements);
+  std::optional<std::string> error =
+      ForkJoin(/*num_partitions=*/10, &counters);
+  ASSERT_TRUE(error.has_value());
+  EXPECT_EQ(*error, "Partition 5 error: failed");
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
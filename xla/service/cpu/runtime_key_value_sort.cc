@@ -14,14 +14,247 @@ limitations under the License.
 ==============================================================================*/
 #include "xla/service/cpu/runtime_key_value_sort.h"
 
+#define EIGEN_USE_THREADS
+
 #include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <numeric>
-#include <string>
+#include <type_traits>
 
 #include "absl/base/dynamic_annotations.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/service/cpu/runtime_lightweight_check.h"
+
+namespace {
+
+// Conceptually every sorted buffer has the 3-dimensional shape [a, b, c]. b
+// corresponds to the dimension to sort, c is the product of the more minor
+// dimensions (set to 1 if b is the most minor dimension), and a is the product
+// of the more major dimensions (set to 1 if b is the most major dimension).
+// There are a * c many rows that we need to sort. The 'i'-th element of row
+// 'index' lives at RowBaseOffset(index, b, c) + i * c.
+//
+// 'index' can be split into two values which index into the 'c' dimension and
+// the 'a' dimension, respectively. 'index' % 'c' is the index into the 'c'
+// dimension, 'index' / 'c' is the index into the 'a' dimension. When
+// calculating the base offset, we need to multiply the index into the 'a'
+// dimension with 'b' * 'c'.
+// 'index' / 'c' * 'c' * 'b' = ('index' - 'index' % 'c') * 'b'.
+int64_t RowBaseOffset(int64_t index, int64_t b, int64_t c) {
+  return index % c + (index - index % c) * b;
+}
+
+// Calls 'fn(begin, end)' on ranges of rows that together cover [0, num_rows).
+// The ranges are spread over the intra-op thread pool of 'run_options' if
+// there is one and 'cycles_per_row' * 'num_rows' makes it worthwhile.
+void ForEachRowRange(const char* run_options, int64_t num_rows,
+                     double bytes_per_row, double cycles_per_row,
+                     const std::function<void(int64_t, int64_t)>& fn) {
+  const Eigen::ThreadPoolDevice* device =
+      run_options == nullptr
+          ? nullptr
+          : reinterpret_cast<const xla::ExecutableRunOptions*>(run_options)
+                ->intra_op_thread_pool();
+  if (device == nullptr || num_rows <= 1 || device->numThreads() <= 1) {
+    fn(0, num_rows);
+    return;
+  }
+  device->parallelFor(
+      num_rows, Eigen::TensorOpCost(bytes_per_row, bytes_per_row,
+                                    cycles_per_row),
+      [&](Eigen::Index begin, Eigen::Index end) { fn(begin, end); });
+}
+
+template <typename T>
+void PermuteRow(char* buffer, int64_t base_offset, int64_t b, int64_t c,
+                const int64_t* indices, char* scratch) {
+  T* row = reinterpret_cast<T*>(buffer) + base_offset;
+  T* reordered = reinterpret_cast<T*>(scratch);
+  for (int64_t i = 0; i < b; ++i) {
+    reordered[i] = row[indices[i] * c];
+  }
+  if (c == 1) {
+    std::memcpy(row, reordered, b * sizeof(T));
+    return;
+  }
+  for (int64_t i = 0; i < b; ++i) {
+    row[i * c] = reordered[i];
+  }
+}
+
+// Reorders the row starting at element 'base_offset' of 'buffer' so that its
+// 'i'-th element becomes the element that was at position 'indices[i]'.
+// 'scratch' must hold at least 'b' * 'size_in_bytes' bytes.
+void PermuteRow(char* buffer, int32_t size_in_bytes, int64_t base_offset,
+                int64_t b, int64_t c, const int64_t* indices, char* scratch) {
+  switch (size_in_bytes) {
+    case 1:
+      return PermuteRow<uint8_t>(buffer, base_offset, b, c, indices, scratch);
+    case 2:
+      return PermuteRow<uint16_t>(buffer, base_offset, b, c, indices, scratch);
+    case 4:
+      return PermuteRow<uint32_t>(buffer, base_offset, b, c, indices, scratch);
+    case 8:
+      return PermuteRow<uint64_t>(buffer, base_offset, b, c, indices, scratch);
+  }
+  for (int64_t i = 0; i < b; ++i) {
+    std::memcpy(scratch + i * size_in_bytes,
+                buffer + (base_offset + indices[i] * c) * size_in_bytes,
+                size_in_bytes);
+  }
+  for (int64_t i = 0; i < b; ++i) {
+    std::memcpy(buffer + (base_offset + i * c) * size_in_bytes,
+                scratch + i * size_in_bytes, size_in_bytes);
+  }
+}
+
+// Holds the per-thread buffers needed to reorder the rows of all 'values'.
+class RowPermuter {
+ public:
+  RowPermuter(int64_t b, char** values, int32_t values_count,
+              const int32_t* values_primitive_type_size_in_bytes)
+      : values_(values),
+        values_count_(values_count),
+        sizes_(values_primitive_type_size_in_bytes) {
+    int32_t max_size = *std::max_element(sizes_, sizes_ + values_count_);
+    scratch_.reset(new char[b * max_size]);
+  }
+
+  void Permute(int64_t base_offset, int64_t b, int64_t c,
+               const int64_t* indices) {
+    for (int32_t i = 0; i < values_count_; ++i) {
+      PermuteRow(values_[i], sizes_[i], base_offset, b, c, indices,
+                 scratch_.get());
+    }
+  }
+
+ private:
+  char** values_;
+  int32_t values_count_;
+  const int32_t* sizes_;
+  std::unique_ptr<char[]> scratch_;
+};
+
+enum class KeyEncoding { kUnsigned, kSigned, kFloat };
+
+// Maps the bits of a key to an unsigned integer that orders the same way.
+// Floats are ordered like a TOTALORDER comparison, i.e. -NaN < -Inf < ... <
+// -0 < +0 < ... < +Inf < +NaN. Partial order comparisons treat -0 and +0 as
+// equal, so unless 'is_total_order' is set both are mapped to the same value
+// to keep a stable sort stable.
+template <typename U, KeyEncoding kEncoding>
+U ToRadixKey(U bits, bool is_total_order, bool descending) {
+  constexpr U kSignBit = U{1} << (sizeof(U) * 8 - 1);
+  if constexpr (kEncoding == KeyEncoding::kSigned) {
+    bits = static_cast<U>(bits ^ kSignBit);
+  } else if constexpr (kEncoding == KeyEncoding::kFloat) {
+    if (!is_total_order && static_cast<U>(bits & ~kSignBit) == 0) {
+      bits = 0;
+    }
+    bits = (bits & kSignBit) ? static_cast<U>(~bits)
+                             : static_cast<U>(bits | kSignBit);
+  }
+  return descending ? static_cast<U>(~bits) : bits;
+}
+
+// Rows shorter than this are sorted with std::stable_sort on the radix keys;
+// the histogram setup of a radix sort does not pay off for them.
+constexpr int64_t kMinRadixSortRowLength = 256;
+
+// Sorts 'indices' [0, n) by 'keys', keeping the relative order of equal keys.
+// 'key_scratch' and 'index_scratch' must hold 'n' elements each. Uses a least
+// significant digit radix sort with 8-bit digits; digits on which all keys
+// agree are skipped.
+template <typename U>
+void RadixSortIndices(int64_t n, U* keys, int64_t* indices, U* key_scratch,
+                      int64_t* index_scratch) {
+  std::iota(indices, indices + n, 0);
+  if (n < kMinRadixSortRowLength) {
+    std::stable_sort(indices, indices + n,
+                     [&](int64_t a, int64_t b) { return keys[a] < keys[b]; });
+    return;
+  }
+
+  constexpr int kNumDigits = sizeof(U);
+  int64_t counts[kNumDigits][256] = {};
+  for (int64_t i = 0; i < n; ++i) {
+    U key = keys[i];
+    for (int d = 0; d < kNumDigits; ++d) {
+      ++counts[d][(key >> (d * 8)) & 0xff];
+    }
+  }
+
+  U* src_keys = keys;
+  int64_t* src_indices = indices;
+  U* dst_keys = key_scratch;
+  int64_t* dst_indices = index_scratch;
+  for (int d = 0; d < kNumDigits; ++d) {
+    int64_t* digit_counts = counts[d];
+    int shift = d * 8;
+    if (digit_counts[(src_keys[0] >> shift) & 0xff] == n) {
+      continue;
+    }
+    int64_t offset = 0;
+    for (int v = 0; v < 256; ++v) {
+      int64_t count = digit_counts[v];
+      digit_counts[v] = offset;
+      offset += count;
+    }
+    for (int64_t i = 0; i < n; ++i) {
+      U key = src_keys[i];
+      int64_t position = digit_counts[(key >> shift) & 0xff]++;
+      dst_keys[position] = key;
+      dst_indices[position] = src_indices[i];
+    }
+    std::swap(src_keys, dst_keys);
+    std::swap(src_indices, dst_indices);
+  }
+  if (src_indices != indices) {
+    std::memcpy(indices, src_indices, n * sizeof(int64_t));
+  }
+}
+
+template <typename U, KeyEncoding kEncoding>
+void RadixKeyValueSort(int64_t a, int64_t b, int64_t c, char** values,
+                       int32_t values_count,
+                       int32_t* values_primitive_type_size_in_bytes,
+                       bool descending, bool is_total_order,
+                       char* run_options) {
+  XLA_LIGHTWEIGHT_CHECK(values_primitive_type_size_in_bytes[0] == sizeof(U));
+  int64_t num_rows = a * c;
+  double bytes_per_row = 0;
+  for (int32_t i = 0; i < values_count; ++i) {
+    bytes_per_row += b * values_primitive_type_size_in_bytes[i];
+  }
+  double cycles_per_row = b * (2 + sizeof(U)) * 4.0;
+  ForEachRowRange(
+      run_options, num_rows, bytes_per_row, cycles_per_row,
+      [&](int64_t begin, int64_t end) {
+        std::unique_ptr<U[]> keys(new U[b]);
+        std::unique_ptr<U[]> key_scratch(new U[b]);
+        std::unique_ptr<int64_t[]> indices(new int64_t[b]);
+        std::unique_ptr<int64_t[]> index_scratch(new int64_t[b]);
+        RowPermuter permuter(b, values, values_count,
+                             values_primitive_type_size_in_bytes);
+        const U* key_buffer = reinterpret_cast<const U*>(values[0]);
+        for (int64_t index = begin; index < end; ++index) {
+          int64_t base_offset = RowBaseOffset(index, b, c);
+          for (int64_t i = 0; i < b; ++i) {
+            keys[i] = ToRadixKey<U, kEncoding>(
+                key_buffer[base_offset + i * c], is_total_order, descending);
+          }
+          RadixSortIndices(b, keys.get(), indices.get(), key_scratch.get(),
+                           index_scratch.get());
+          permuter.Permute(base_offset, b, c, indices.get());
+        }
+      });
+}
+
+}  // namespace
 
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
     int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
@@ -34,78 +267,115 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
   ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values_primitive_type_size_in_bytes,
                                       values_count * sizeof(int32_t));
 
-  // High-level idea of the iteration/sorting logic:
-  // Conceptually we have a 3-dimensional shape [a, b, c]. b corresponds to the
-  // dimension to sort, c is the product of the more minor dimensions (set to 1
-  // if b is the most minor dimension), and a is the product of the more major
-  // dimensions (set to 1 if b is the most major dimension). There are a * c
-  // many rows that we need to sort. We iterate through these, calculate a
-  // 'base_offset' value which points to the first element in that row, and add
-  // i * c for accessing the 'i'-th element in that row.
-
   int64_t sort_dimension_elements = b;
   int64_t num_iteration_elements = a * c;
   int64_t sort_dimension_offset = c;
 
-  std::unique_ptr<int64_t[]> indices(new int64_t[sort_dimension_elements]);
-  std::unique_ptr<char*[]> comparison_values(new char*[2 * values_count]);
-  std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-  std::unique_ptr<std::string[]> reordered_values(
-      new std::string[sort_dimension_elements]);
-  for (int64_t index = 0; index < num_iteration_elements; ++index) {
-    // If the sort should be stable, we have to reinitialize indices to iota to
-    // guarantee that we still keep the relative order in case of ties.
-    if (is_stable && index > 0) {
+  double bytes_per_row = 0;
+  for (int32_t i = 0; i < values_count; ++i) {
+    bytes_per_row +=
+        sort_dimension_elements * values_primitive_type_size_in_bytes[i];
+  }
+  // Assume every comparison costs on the order of a few dozen cycles, as it
+  // goes through 'less_than'.
+  double cycles_per_row = 30.0 * sort_dimension_elements *
+                          std::max(1.0, std::log2(sort_dimension_elements));
+
+  auto sort_rows = [&](int64_t begin, int64_t end) {
+    std::unique_ptr<int64_t[]> indices(new int64_t[sort_dimension_elements]);
+    std::unique_ptr<char*[]> comparison_values(new char*[2 * values_count]);
+    RowPermuter permuter(sort_dimension_elements, values, values_count,
+                         values_primitive_type_size_in_bytes);
+    for (int64_t index = begin; index < end; ++index) {
+      // Reinitialize indices to iota for every row; a stable sort relies on it
+      // to keep the relative order in case of ties.
       std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-    }
-    // 'index' can be split into two values which index into the 'c' dimension
-    // and the 'a' dimension, respectively. 'index' % 'c' is the index into the
-    // 'c' dimension, 'index' / 'c' is the index into the 'a' dimension. When
-    // calculating the base offset, we need to multiply the index into the 'a'
-    // dimension with 'b' * 'c'.
-    // 'index' / 'c' * 'c' * 'b' = ('index' - 'index' % 'c') * 'b'.
-    int64_t base_offset =
-        index % sort_dimension_offset +
-        (index - index % sort_dimension_offset) * sort_dimension_elements;
-    auto compare_function = [&](int64_t a, int64_t b) -> bool {
-      for (int32_t i = 0; i < values_count; ++i) {
-        int64_t memory_index_lhs = (base_offset + a * sort_dimension_offset) *
-                                   values_primitive_type_size_in_bytes[i];
-        int64_t memory_index_rhs = (base_offset + b * sort_dimension_offset) *
-                                   values_primitive_type_size_in_bytes[i];
-        comparison_values[i * 2] = values[i] + memory_index_lhs;
-        comparison_values[i * 2 + 1] = values[i] + memory_index_rhs;
+      int64_t base_offset =
+          RowBaseOffset(index, sort_dimension_elements, sort_dimension_offset);
+      auto compare_function = [&](int64_t a, int64_t b) -> bool {
+        for (int32_t i = 0; i < values_count; ++i) {
+          int64_t memory_index_lhs = (base_offset + a * sort_dimension_offset) *
+                                     values_primitive_type_size_in_bytes[i];
+          int64_t memory_index_rhs = (base_offset + b * sort_dimension_offset) *
+                                     values_primitive_type_size_in_bytes[i];
+          comparison_values[i * 2] = values[i] + memory_index_lhs;
+          comparison_values[i * 2 + 1] = values[i] + memory_index_rhs;
+        }
+        char result = 0;  // Overwritten by less_than.
+        less_than(&result, run_options, comparison_values.get(), nullptr,
+                  prof_counters);
+        return result != 0u;
+      };
+      if (is_stable) {
+        std::stable_sort(indices.get(),
+                         indices.get() + sort_dimension_elements,
+                         compare_function);
+      } else {
+        std::sort(indices.get(), indices.get() + sort_dimension_elements,
+                  compare_function);
       }
-      char result = 0;  // Overwritten by less_than.
-      less_than(&result, run_options, comparison_values.get(), nullptr,
-                prof_counters);
-      return result != 0u;
-    };
-    if (is_stable) {
-      std::stable_sort(indices.get(), indices.get() + sort_dimension_elements,
-                       compare_function);
-    } else {
-      std::sort(indices.get(), indices.get() + sort_dimension_elements,
-                compare_function);
+
+      // Reorder the values according to the order defined by 'indices'.
+      permuter.Permute(base_offset, sort_dimension_elements,
+                       sort_dimension_offset, indices.get());
     }
+  };
 
-    // Reorder the values according to the order defined by 'indices'.
-    for (int32_t idx = 0; idx < values_count; ++idx) {
-      for (int64_t i = 0; i < sort_dimension_elements; ++i) {
-        int64_t memory_index =
-            (base_offset + indices[i] * sort_dimension_offset) *
-            values_primitive_type_size_in_bytes[idx];
+  // 'less_than' is thread-compatible, but it bumps the profile counters
+  // without synchronization, so only sort rows in parallel when not profiling.
+  if (prof_counters != nullptr) {
+    sort_rows(0, num_iteration_elements);
+    return;
+  }
+  ForEachRowRange(run_options, num_iteration_elements, bytes_per_row,
+                  cycles_per_row, sort_rows);
+}
 
-        reordered_values[i] =
-            std::string(values[idx] + memory_index,
-                        values_primitive_type_size_in_bytes[idx]);
-      }
-      for (int64_t i = 0; i < sort_dimension_elements; ++i) {
-        int64_t memory_index = (base_offset + i * sort_dimension_offset) *
-                               values_primitive_type_size_in_bytes[idx];
-        memcpy(values[idx] + memory_index, reordered_values[i].c_str(),
-               values_primitive_type_size_in_bytes[idx]);
-      }
-    }
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueRadixSort(
+    int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
+    int32_t* values_primitive_type_size_in_bytes, int32_t key_type,
+    bool descending, bool is_total_order, char* run_options) {
+  // 'values' and 'values_primitive_type_size_in_bytes' are managed by the JIT
+  // code, so msan can't tell they are initialized.
+  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values, values_count * sizeof(char*));
+  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values_primitive_type_size_in_bytes,
+                                      values_count * sizeof(int32_t));
+
+  auto radix_sort = [&](auto* unsigned_type, auto encoding) {
+    using U = std::remove_pointer_t<decltype(unsigned_type)>;
+    RadixKeyValueSort<U, decltype(encoding)::value>(
+        a, b, c, values, values_count, values_primitive_type_size_in_bytes,
+        descending, is_total_order, run_options);
+  };
+  using Unsigned =
+      std::integral_constant<KeyEncoding, KeyEncoding::kUnsigned>;
+  using Signed = std::integral_constant<KeyEncoding, KeyEncoding::kSigned>;
+  using Float = std::integral_constant<KeyEncoding, KeyEncoding::kFloat>;
+  using xla::cpu::runtime::RadixSortKeyType;
+  switch (static_cast<RadixSortKeyType>(key_type)) {
+    case RadixSortKeyType::kU8:
+      return radix_sort(static_cast<uint8_t*>(nullptr), Unsigned());
+    case RadixSortKeyType::kU16:
+      return radix_sort(static_cast<uint16_t*>(nullptr), Unsigned());
+    case RadixSortKeyType::kU32:
+      return radix_sort(static_cast<uint32_t*>(nullptr), Unsigned());
+    case RadixSortKeyType::kU64:
+      return radix_sort(static_cast<uint64_t*>(nullptr), Unsigned());
+    case RadixSortKeyType::kS8:
+      return radix_sort(static_cast<uint8_t*>(nullptr), Signed());
+    case RadixSortKeyType::kS16:
+      return radix_sort(static_cast<uint16_t*>(nullptr), Signed());
+    case RadixSortKeyType::kS32:
+      return radix_sort(static_cast<uint32_t*>(nullptr), Signed());
+    case RadixSortKeyType::kS64:
+      return radix_sort(static_cast<uint64_t*>(nullptr), Signed());
+    case RadixSortKeyType::kF16:
+    case RadixSortKeyType::kBF16:
+      return radix_sort(static_cast<uint16_t*>(nullptr), Float());
+    case RadixSortKeyType::kF32:
+      return radix_sort(static_cast<uint32_t*>(nullptr), Float());
+    case RadixSortKeyType::kF64:
+      return radix_sort(static_cast<uint64_t*>(nullptr), Float());
   }
+  XLA_LIGHTWEIGHT_CHECK(false && "unsupported radix sort key type");
 }
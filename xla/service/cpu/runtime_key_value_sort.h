@@ -20,6 +20,32 @@ limitations under the License.
 
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+// The types of keys that __xla_cpu_runtime_KeyValueRadixSort can sort. They
+// have the values of the corresponding xla::PrimitiveType, which the IR emitter
+// checks, without the runtime depending on xla_data.proto.
+enum class RadixSortKeyType : int32_t {
+  kS8 = 2,
+  kS16 = 3,
+  kS32 = 4,
+  kS64 = 5,
+  kU8 = 6,
+  kU16 = 7,
+  kU32 = 8,
+  kU64 = 9,
+  kF16 = 10,
+  kF32 = 11,
+  kF64 = 12,
+  kBF16 = 16,
+};
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
 extern "C" {
 
 // Each entry in 'values' represents a 3-dimensional shape with dimensions
@@ -41,6 +67,18 @@ extern void __xla_cpu_runtime_KeyValueSort(
     int32_t* values_primitive_type_size_in_bytes, bool is_stable,
     char* run_options, int64_t* prof_counters,
     void (*less_than)(char*, char*, char**, char**, int64_t*));
+
+// Like __xla_cpu_runtime_KeyValueSort, but for sorts whose comparator is a
+// plain LT (or, if 'descending', GT) comparison of the elements of 'values[0]'.
+// 'key_type' is the xla::cpu::runtime::RadixSortKeyType of 'values[0]';
+// 'is_total_order' tells whether floating point keys are compared with a
+// TOTALORDER comparison. Rows are sorted with a stable LSD radix sort on the
+// keys, which also satisfies unstable sorts. 'run_options' provides the
+// intra-op thread pool that the rows are spread over.
+extern void __xla_cpu_runtime_KeyValueRadixSort(
+    int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
+    int32_t* values_primitive_type_size_in_bytes, int32_t key_type,
+    bool descending, bool is_total_order, char* run_options);
 }
 
 #endif  // XLA_SERVICE_CPU_RUNTIME_KEY_VALUE_SORT_H_
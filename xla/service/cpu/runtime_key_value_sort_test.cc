@@ -0,0 +1,252 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "xla/service/cpu/runtime_key_value_sort.h"
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+using runtime::RadixSortKeyType;
+
+template <typename T>
+void LessThan(char* result, char* /*run_options*/, char** params,
+              char** /*buffer_table*/, int64_t* /*prof_counters*/) {
+  *result = *reinterpret_cast<T*>(params[0]) < *reinterpret_cast<T*>(params[1]);
+}
+
+// Sorts the [a, b, c] arrays 'keys' and 'values' along b with the radix sort.
+template <typename K>
+void RadixSort(int64_t a, int64_t b, int64_t c, RadixSortKeyType key_type,
+               bool descending, bool is_total_order, std::vector<K>* keys,
+               std::vector<int32_t>* values,
+               const ExecutableRunOptions* run_options = nullptr) {
+  char* buffers[] = {reinterpret_cast<char*>(keys->data()),
+                     reinterpret_cast<char*>(values->data())};
+  int32_t sizes[] = {sizeof(K), sizeof(int32_t)};
+  __xla_cpu_runtime_KeyValueRadixSort(
+      a, b, c, buffers, 2, sizes, static_cast<int32_t>(key_type), descending,
+      is_total_order,
+      reinterpret_cast<char*>(const_cast<ExecutableRunOptions*>(run_options)));
+}
+
+// Sorts 'keys' and 'values', both with 'n' elements, with std::stable_sort.
+template <typename K, typename Less>
+void ReferenceSort(Less less, std::vector<K>* keys,
+                   std::vector<int32_t>* values) {
+  std::vector<int64_t> indices(keys->size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::stable_sort(indices.begin(), indices.end(), [&](int64_t a, int64_t b) {
+    return less((*keys)[a], (*keys)[b]);
+  });
+  std::vector<K> sorted_keys;
+  std::vector<int32_t> sorted_values;
+  for (int64_t i : indices) {
+    sorted_keys.push_back((*keys)[i]);
+    sorted_values.push_back((*values)[i]);
+  }
+  *keys = sorted_keys;
+  *values = sorted_values;
+}
+
+std::vector<int32_t> Iota(int64_t n) {
+  std::vector<int32_t> values(n);
+  std::iota(values.begin(), values.end(), 0);
+  return values;
+}
+
+TEST(RuntimeKeyValueSortTest, RadixSortF32MatchesStableSort) {
+  // Long enough to take the radix path; few distinct keys to get many ties.
+  constexpr int64_t kN = 5000;
+  std::minstd_rand0 generator(42);
+  std::uniform_int_distribution<int> distribution(-50, 50);
+  for (bool descending : {false, true}) {
+    std::vector<float> keys(kN);
+    for (float& key : keys) {
+      key = distribution(generator) / 4.0f;
+    }
+    keys[17] = -0.0f;
+    keys[18] = 0.0f;
+    keys[19] = -0.0f;
+    std::vector<int32_t> values = Iota(kN);
+    std::vector<float> expected_keys = keys;
+    std::vector<int32_t> expected_values = values;
+    if (descending) {
+      ReferenceSort([](float a, float b) { return a > b; }, &expected_keys,
+                    &expected_values);
+    } else {
+      ReferenceSort([](float a, float b) { return a < b; }, &expected_keys,
+                    &expected_values);
+    }
+
+    RadixSort<float>(1, kN, 1, RadixSortKeyType::kF32, descending,
+                     /*is_total_order=*/false, &keys, &values);
+    EXPECT_EQ(values, expected_values);
+    for (int64_t i = 0; i < kN; ++i) {
+      EXPECT_EQ(keys[i], expected_keys[i]);
+    }
+  }
+}
+
+TEST(RuntimeKeyValueSortTest, RadixSortF32TotalOrder) {
+  const float kNaN = std::numeric_limits<float>::quiet_NaN();
+  const float kInf = std::numeric_limits<float>::infinity();
+  std::vector<float> keys = {kNaN, 1.0f, 0.0f, -kInf, -0.0f, kInf, -1.0f};
+  std::vector<int32_t> values = Iota(keys.size());
+  RadixSort<float>(1, keys.size(), 1, RadixSortKeyType::kF32,
+                   /*descending=*/false, /*is_total_order=*/true, &keys,
+                   &values);
+  EXPECT_EQ(values, (std::vector<int32_t>{3, 6, 4, 2, 1, 5, 0}));
+  EXPECT_TRUE(std::signbit(keys[2]));
+  EXPECT_TRUE(std::isnan(keys[6]));
+}
+
+TEST(RuntimeKeyValueSortTest, RadixSortS32InnerDimension) {
+  // [a, b, c] = [2, 300, 3], sorted along b.
+  constexpr int64_t kA = 2, kB = 300, kC = 3;
+  std::minstd_rand0 generator(7);
+  std::uniform_int_distribution<int32_t> distribution(-1000000, 1000000);
+  std::vector<int32_t> keys(kA * kB * kC);
+  for (int32_t& key : keys) {
+    key = distribution(generator);
+  }
+  std::vector<int32_t> values = Iota(keys.size());
+  std::vector<int32_t> original_keys = keys;
+
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  RadixSort<int32_t>(kA, kB, kC, RadixSortKeyType::kS32, /*descending=*/false,
+                     /*is_total_order=*/true, &keys, &values, &run_options);
+
+  for (int64_t a = 0; a < kA; ++a) {
+    for (int64_t c = 0; c < kC; ++c) {
+      std::vector<int32_t> row;
+      for (int64_t b = 0; b < kB; ++b) {
+        row.push_back(original_keys[(a * kB + b) * kC + c]);
+      }
+      std::sort(row.begin(), row.end());
+      for (int64_t b = 0; b < kB; ++b) {
+        int64_t i = (a * kB + b) * kC + c;
+        ASSERT_EQ(keys[i], row[b]);
+        ASSERT_EQ(original_keys[values[i]], keys[i]);
+      }
+    }
+  }
+}
+
+TEST(RuntimeKeyValueSortTest, ComparatorSortRowsInParallel) {
+  constexpr int64_t kA = 64, kB = 100;
+  std::minstd_rand0 generator(3);
+  std::uniform_int_distribution<int32_t> distribution(0, 20);
+  std::vector<int32_t> keys(kA * kB);
+  for (int32_t& key : keys) {
+    key = distribution(generator);
+  }
+  std::vector<int32_t> values = Iota(keys.size());
+  std::vector<int32_t> expected_keys = keys;
+  std::vector<int32_t> expected_values = values;
+  for (int64_t a = 0; a < kA; ++a) {
+    std::vector<int32_t> row_keys(expected_keys.begin() + a * kB,
+                                  expected_keys.begin() + (a + 1) * kB);
+    std::vector<int32_t> row_values(expected_values.begin() + a * kB,
+                                    expected_values.begin() + (a + 1) * kB);
+    ReferenceSort([](int32_t x, int32_t y) { return x < y; }, &row_keys,
+                  &row_values);
+    std::copy(row_keys.begin(), row_keys.end(), expected_keys.begin() + a * kB);
+    std::copy(row_values.begin(), row_values.end(),
+              expected_values.begin() + a * kB);
+  }
+
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  char* buffers[] = {reinterpret_cast<char*>(keys.data()),
+                     reinterpret_cast<char*>(values.data())};
+  int32_t sizes[] = {sizeof(int32_t), sizeof(int32_t)};
+  __xla_cpu_runtime_KeyValueSort(kA, kB, 1, buffers, 2, sizes,
+                                 /*is_stable=*/true,
+                                 reinterpret_cast<char*>(&run_options),
+                                 /*prof_counters=*/nullptr, LessThan<int32_t>);
+  EXPECT_EQ(keys, expected_keys);
+  EXPECT_EQ(values, expected_values);
+}
+
+// Sorts range(0) rows of range(1) F32 keys, each with an S32 value, through
+// the comparator (range(2) == 0) or the radix sort (range(2) == 1).
+void BM_KeyValueSort(::testing::benchmark::State& state) {
+  const int64_t num_rows = state.range(0);
+  const int64_t row_length = state.range(1);
+  const bool radix = state.range(2);
+  std::minstd_rand0 generator(0);
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  std::vector<float> input(num_rows * row_length);
+  for (float& key : input) {
+    key = distribution(generator);
+  }
+
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  std::vector<float> keys(input.size());
+  std::vector<int32_t> values(input.size());
+  char* buffers[] = {reinterpret_cast<char*>(keys.data()),
+                     reinterpret_cast<char*>(values.data())};
+  int32_t sizes[] = {sizeof(float), sizeof(int32_t)};
+  for (auto s : state) {
+    state.PauseTiming();
+    keys = input;
+    state.ResumeTiming();
+    if (radix) {
+      __xla_cpu_runtime_KeyValueRadixSort(
+          num_rows, row_length, 1, buffers, 2, sizes,
+          static_cast<int32_t>(RadixSortKeyType::kF32),
+          /*descending=*/false, /*is_total_order=*/false,
+          reinterpret_cast<char*>(&run_options));
+    } else {
+      __xla_cpu_runtime_KeyValueSort(
+          num_rows, row_length, 1, buffers, 2, sizes, /*is_stable=*/false,
+          reinterpret_cast<char*>(&run_options), /*prof_counters=*/nullptr,
+          LessThan<float>);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_rows * row_length);
+}
+
+BENCHMARK(BM_KeyValueSort)
+    ->ArgsProduct({{1, 64}, {1 << 10, 1 << 14, 1 << 18}, {0, 1}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
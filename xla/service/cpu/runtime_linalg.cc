@@ -0,0 +1,71 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_linalg.h"
+
+#define EIGEN_USE_THREADS
+
+#include "absl/base/dynamic_annotations.h"
+#include "xla/executable_run_options.h"
+#include "xla/service/cpu/runtime_lightweight_check.h"
+#include "xla/service/cpu/runtime_linalg_impl.h"
+
+namespace {
+
+const Eigen::ThreadPoolDevice& IntraOpThreadPool(const void* run_options_ptr) {
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  XLA_LIGHTWEIGHT_CHECK(run_options->intra_op_thread_pool() != nullptr);
+  return *run_options->intra_op_thread_pool();
+}
+
+}  // namespace
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenCholesky(
+    const void* run_options_ptr, void* out, void* a, int32_t element_type,
+    int64_t batch, int64_t n, int32_t lower) {
+  xla::EigenCholeskyImpl(IntraOpThreadPool(run_options_ptr), out, a,
+                         static_cast<xla::internal::LinalgType>(element_type),
+                         batch, n, static_cast<bool>(lower));
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenTriangularSolve(
+    const void* run_options_ptr, void* out, void* a, void* b,
+    int32_t element_type, int64_t batch, int64_t m, int64_t n,
+    int32_t left_side, int32_t lower, int32_t unit_diagonal,
+    int32_t transpose_a) {
+  xla::EigenTriangularSolveImpl(
+      IntraOpThreadPool(run_options_ptr), out, a, b,
+      static_cast<xla::internal::LinalgType>(element_type), batch, m, n,
+      static_cast<bool>(left_side), static_cast<bool>(lower),
+      static_cast<bool>(unit_diagonal),
+      static_cast<xla::internal::LinalgTranspose>(transpose_a));
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenQr(
+    const void* run_options_ptr, void* out, void* taus, void* a,
+    int32_t element_type, int64_t batch, int64_t m, int64_t n) {
+  xla::EigenQrImpl(IntraOpThreadPool(run_options_ptr), out, taus, a,
+                   static_cast<xla::internal::LinalgType>(element_type), batch,
+                   m, n);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenEigh(
+    const void* run_options_ptr, void* v, void* w, void* a,
+    int32_t element_type, int64_t batch, int64_t n, int32_t lower) {
+  xla::EigenEighImpl(IntraOpThreadPool(run_options_ptr), v, w, a,
+                     static_cast<xla::internal::LinalgType>(element_type),
+                     batch, n, static_cast<bool>(lower));
+}
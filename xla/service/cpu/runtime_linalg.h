@@ -0,0 +1,86 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_RUNTIME_LINALG_H_
+#define XLA_SERVICE_CPU_RUNTIME_LINALG_H_
+
+#include <stdint.h>
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+// The element types of the linear algebra functions below. They have the
+// values of the corresponding xla::PrimitiveType, which the IR emitter checks,
+// without the runtime depending on xla_data.proto.
+enum class LinalgType : int32_t {
+  F32 = 11,
+  F64 = 12,
+  C64 = 15,
+  C128 = 18,
+};
+
+// Like xla::TriangularSolveOptions::Transpose, whose values it has.
+enum class LinalgTranspose : int32_t {
+  NO_TRANSPOSE = 1,
+  TRANSPOSE = 2,
+  ADJOINT = 3,
+};
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+extern "C" {
+
+// Batched linear algebra on row-major matrices with Eigen, processing the
+// batch on the intra-op thread pool. 'element_type' is the
+// xla::cpu::runtime::LinalgType of the matrices; 'out' may alias the matrix
+// that is updated in place.
+
+// Cholesky decomposition of the [batch, n, n] matrices in 'a'. The other
+// triangle of 'out' is zeroed; matrices that are not positive definite are
+// filled with NaNs.
+extern void __xla_cpu_runtime_EigenCholesky(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* out,
+    void* a, int32_t element_type, int64_t batch, int64_t n, int32_t lower);
+
+// Solves op(a) x = b ('left_side') or x op(a) = b for the [batch, m, n]
+// matrices in 'b'. 'transpose_a' is an xla::cpu::runtime::LinalgTranspose.
+extern void __xla_cpu_runtime_EigenTriangularSolve(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* out,
+    void* a, void* b, int32_t element_type, int64_t batch, int64_t m, int64_t n,
+    int32_t left_side, int32_t lower, int32_t unit_diagonal,
+    int32_t transpose_a);
+
+// QR decomposition of the [batch, m, n] matrices in 'a', in the format of
+// LAPACK's geqrf: 'out' holds R and the Householder vectors, 'taus' the
+// [batch, min(m, n)] Householder scale factors.
+extern void __xla_cpu_runtime_EigenQr(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* out,
+    void* taus, void* a, int32_t element_type, int64_t batch, int64_t m,
+    int64_t n);
+
+// Eigendecomposition of the [batch, n, n] Hermitian matrices in 'a', read from
+// their lower or upper triangle. 'v' gets the eigenvectors as columns and 'w'
+// the [batch, n] real eigenvalues in ascending order.
+extern void __xla_cpu_runtime_EigenEigh(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* v,
+    void* w, void* a, int32_t element_type, int64_t batch, int64_t n,
+    int32_t lower);
+
+}  // extern "C"
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_LINALG_H_
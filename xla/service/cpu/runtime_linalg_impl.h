@@ -0,0 +1,361 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef XLA_SERVICE_CPU_RUNTIME_LINALG_IMPL_H_
+#define XLA_SERVICE_CPU_RUNTIME_LINALG_IMPL_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
+
+#include "Eigen/Cholesky"  // from @eigen_archive
+#include "Eigen/Core"  // from @eigen_archive
+#include "Eigen/Eigenvalues"  // from @eigen_archive
+#include "Eigen/QR"  // from @eigen_archive
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/service/cpu/runtime_linalg.h"
+#include "xla/types.h"
+
+// Batched dense linear algebra on row-major matrices, backed by Eigen's
+// blocked decompositions. Batches are processed in parallel when the device
+// has a thread pool; every matrix is factorized on a single thread.
+
+namespace xla {
+
+namespace internal {
+
+using ::xla::cpu::runtime::LinalgTranspose;
+using ::xla::cpu::runtime::LinalgType;
+
+template <typename T>
+using RowMajorMatrix =
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+template <typename T>
+T LinalgNaN() {
+  using Real = typename Eigen::NumTraits<T>::Real;
+  return T(std::numeric_limits<Real>::quiet_NaN());
+}
+
+// Runs `fn(i)` for every matrix i in [0, batch). `cycles_per_matrix` is the
+// estimated cost of one call, used to size the parallel blocks.
+template <typename EigenDevice, typename Fn>
+void ForEachMatrix(const EigenDevice& device, int64_t batch,
+                   double cycles_per_matrix, int64_t bytes_per_matrix,
+                   const Fn& fn) {
+  if constexpr (std::is_same_v<EigenDevice, Eigen::DefaultDevice>) {
+    for (int64_t i = 0; i < batch; ++i) {
+      fn(i);
+    }
+  } else {
+    device.parallelFor(
+        batch,
+        Eigen::TensorOpCost(bytes_per_matrix, bytes_per_matrix,
+                            cycles_per_matrix),
+        [&](Eigen::Index begin, Eigen::Index end) {
+          for (Eigen::Index i = begin; i < end; ++i) {
+            fn(i);
+          }
+        });
+  }
+}
+
+template <typename EigenDevice, typename T>
+void EigenCholesky(const EigenDevice& device, T* out, const T* a,
+                   int64_t batch, int64_t n, bool lower) {
+  const int64_t matrix_size = n * n;
+  ForEachMatrix(
+      device, batch, /*cycles_per_matrix=*/n * n * n / 3.0,
+      matrix_size * sizeof(T), [&](int64_t i) {
+        Eigen::Map<RowMajorMatrix<T>> output(out + i * matrix_size, n, n);
+        if (out != a) {
+          output =
+              Eigen::Map<const RowMajorMatrix<T>>(a + i * matrix_size, n, n);
+        }
+        bool ok;
+        if (lower) {
+          Eigen::LLT<Eigen::Ref<RowMajorMatrix<T>>, Eigen::Lower> llt(output);
+          ok = llt.info() == Eigen::Success;
+          output.template triangularView<Eigen::StrictlyUpper>().setZero();
+        } else {
+          Eigen::LLT<Eigen::Ref<RowMajorMatrix<T>>, Eigen::Upper> llt(output);
+          ok = llt.info() == Eigen::Success;
+          output.template triangularView<Eigen::StrictlyLower>().setZero();
+        }
+        // Like the HLO expansion, matrices that are not positive definite
+        // produce NaNs.
+        if (!ok) {
+          output.setConstant(LinalgNaN<T>());
+        }
+      });
+}
+
+template <int Mode, typename AType, typename XType>
+void TriangularSolveInPlace(const AType& a, bool left_side, XType& x) {
+  if (left_side) {
+    a.template triangularView<Mode>().template solveInPlace<Eigen::OnTheLeft>(
+        x);
+  } else {
+    a.template triangularView<Mode>().template solveInPlace<Eigen::OnTheRight>(
+        x);
+  }
+}
+
+// Solves op(a) x = b or x op(a) = b in place, where `op_a` is op(a) and
+// `lower` refers to the triangle of op(a).
+template <typename AType, typename XType>
+void TriangularSolveInPlace(const AType& op_a, bool left_side, bool lower,
+                            bool unit_diagonal, XType& x) {
+  if (lower) {
+    if (unit_diagonal) {
+      TriangularSolveInPlace<Eigen::UnitLower>(op_a, left_side, x);
+    } else {
+      TriangularSolveInPlace<Eigen::Lower>(op_a, left_side, x);
+    }
+  } else {
+    if (unit_diagonal) {
+      TriangularSolveInPlace<Eigen::UnitUpper>(op_a, left_side, x);
+    } else {
+      TriangularSolveInPlace<Eigen::Upper>(op_a, left_side, x);
+    }
+  }
+}
+
+// `b` and `out` are [batch, m, n]; `a` is [batch, m, m] if `left_side` and
+// [batch, n, n] otherwise.
+template <typename EigenDevice, typename T>
+void EigenTriangularSolve(const EigenDevice& device, T* out, const T* a,
+                          const T* b, int64_t batch, int64_t m, int64_t n,
+                          bool left_side, bool lower, bool unit_diagonal,
+                          LinalgTranspose transpose_a) {
+  const int64_t k = left_side ? m : n;
+  ForEachMatrix(
+      device, batch, /*cycles_per_matrix=*/k * k * (left_side ? n : m),
+      (k * k + 2 * m * n) * sizeof(T), [&](int64_t i) {
+        Eigen::Map<const RowMajorMatrix<T>> a_matrix(a + i * k * k, k, k);
+        Eigen::Map<RowMajorMatrix<T>> x(out + i * m * n, m, n);
+        if (out != b) {
+          x = Eigen::Map<const RowMajorMatrix<T>>(b + i * m * n, m, n);
+        }
+        switch (transpose_a) {
+          case LinalgTranspose::NO_TRANSPOSE:
+            TriangularSolveInPlace(a_matrix, left_side, lower, unit_diagonal,
+                                   x);
+            break;
+          case LinalgTranspose::TRANSPOSE:
+            TriangularSolveInPlace(a_matrix.transpose(), left_side, !lower,
+                                   unit_diagonal, x);
+            break;
+          case LinalgTranspose::ADJOINT:
+            TriangularSolveInPlace(a_matrix.adjoint(), left_side, !lower,
+                                   unit_diagonal, x);
+            break;
+          default:
+            // Unsupported transpose type
+            abort();
+        }
+      });
+}
+
+// Computes the QR decomposition of the [batch, m, n] matrices in `a` in the
+// LAPACK geqrf format: R in the upper triangle of `out`, the Householder
+// vectors below it, and their scale factors in the [batch, min(m, n)] `taus`.
+template <typename EigenDevice, typename T>
+void EigenQr(const EigenDevice& device, T* out, T* taus, const T* a,
+             int64_t batch, int64_t m, int64_t n) {
+  const int64_t k = std::min(m, n);
+  ForEachMatrix(
+      device, batch, /*cycles_per_matrix=*/2.0 * m * n * k,
+      m * n * sizeof(T), [&](int64_t i) {
+        Eigen::Map<RowMajorMatrix<T>> output(out + i * m * n, m, n);
+        if (out != a) {
+          output = Eigen::Map<const RowMajorMatrix<T>>(a + i * m * n, m, n);
+        }
+        Eigen::HouseholderQR<Eigen::Ref<RowMajorMatrix<T>>> qr(output);
+        // Eigen stores the conjugates of the LAPACK scale factors.
+        Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, 1>>(taus + i * k, k) =
+            qr.hCoeffs().conjugate();
+      });
+}
+
+// Computes the eigenvectors `v` ([batch, n, n], one per column) and the
+// ascending eigenvalues `w` ([batch, n]) of the Hermitian matrices in `a`,
+// reading only their `lower` or upper triangle.
+template <typename EigenDevice, typename T>
+void EigenEigh(const EigenDevice& device, T* v,
+               typename Eigen::NumTraits<T>::Real* w, const T* a,
+               int64_t batch, int64_t n, bool lower) {
+  using Real = typename Eigen::NumTraits<T>::Real;
+  ForEachMatrix(
+      device, batch, /*cycles_per_matrix=*/9.0 * n * n * n,
+      2 * n * n * sizeof(T), [&](int64_t i) {
+        Eigen::Map<const RowMajorMatrix<T>> input(a + i * n * n, n, n);
+        Eigen::Map<RowMajorMatrix<T>> eigenvectors(v + i * n * n, n, n);
+        Eigen::Map<Eigen::Matrix<Real, Eigen::Dynamic, 1>> eigenvalues(
+            w + i * n, n);
+        // The solver only reads the lower triangle; the lower triangle of the
+        // adjoint holds the upper triangle of the input.
+        Eigen::SelfAdjointEigenSolver<
+            Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>
+            solver;
+        if (lower) {
+          solver.compute(input);
+        } else {
+          solver.compute(input.adjoint());
+        }
+        if (solver.info() == Eigen::Success) {
+          eigenvectors = solver.eigenvectors();
+          eigenvalues = solver.eigenvalues();
+        } else {
+          eigenvectors.setConstant(LinalgNaN<T>());
+          eigenvalues.setConstant(LinalgNaN<Real>());
+        }
+      });
+}
+
+}  // namespace internal
+
+template <typename EigenDevice>
+void EigenCholeskyImpl(const EigenDevice& device, void* out, void* a,
+                       internal::LinalgType type, int64_t batch, int64_t n,
+                       bool lower) {
+  switch (type) {
+    case internal::LinalgType::F32:
+      internal::EigenCholesky(device, static_cast<float*>(out),
+                              static_cast<const float*>(a), batch, n, lower);
+      break;
+    case internal::LinalgType::F64:
+      internal::EigenCholesky(device, static_cast<double*>(out),
+                              static_cast<const double*>(a), batch, n, lower);
+      break;
+    case internal::LinalgType::C64:
+      internal::EigenCholesky(device, static_cast<complex64*>(out),
+                              static_cast<const complex64*>(a), batch, n,
+                              lower);
+      break;
+    case internal::LinalgType::C128:
+      internal::EigenCholesky(device, static_cast<complex128*>(out),
+                              static_cast<const complex128*>(a), batch, n,
+                              lower);
+      break;
+    default:
+      // Unsupported element type
+      abort();
+  }
+}
+
+template <typename EigenDevice>
+void EigenTriangularSolveImpl(const EigenDevice& device, void* out, void* a,
+                              void* b, internal::LinalgType type,
+                              int64_t batch, int64_t m, int64_t n,
+                              bool left_side, bool lower, bool unit_diagonal,
+                              internal::LinalgTranspose transpose_a) {
+  switch (type) {
+    case internal::LinalgType::F32:
+      internal::EigenTriangularSolve(
+          device, static_cast<float*>(out), static_cast<const float*>(a),
+          static_cast<const float*>(b), batch, m, n, left_side, lower,
+          unit_diagonal, transpose_a);
+      break;
+    case internal::LinalgType::F64:
+      internal::EigenTriangularSolve(
+          device, static_cast<double*>(out), static_cast<const double*>(a),
+          static_cast<const double*>(b), batch, m, n, left_side, lower,
+          unit_diagonal, transpose_a);
+      break;
+    case internal::LinalgType::C64:
+      internal::EigenTriangularSolve(
+          device, static_cast<complex64*>(out),
+          static_cast<const complex64*>(a), static_cast<const complex64*>(b),
+          batch, m, n, left_side, lower, unit_diagonal, transpose_a);
+      break;
+    case internal::LinalgType::C128:
+      internal::EigenTriangularSolve(
+          device, static_cast<complex128*>(out),
+          static_cast<const complex128*>(a), static_cast<const complex128*>(b),
+          batch, m, n, left_side, lower, unit_diagonal, transpose_a);
+      break;
+    default:
+      // Unsupported element type
+      abort();
+  }
+}
+
+template <typename EigenDevice>
+void EigenQrImpl(const EigenDevice& device, void* out, void* taus, void* a,
+                 internal::LinalgType type, int64_t batch, int64_t m,
+                 int64_t n) {
+  switch (type) {
+    case internal::LinalgType::F32:
+      internal::EigenQr(device, static_cast<float*>(out),
+                        static_cast<float*>(taus), static_cast<const float*>(a),
+                        batch, m, n);
+      break;
+    case internal::LinalgType::F64:
+      internal::EigenQr(device, static_cast<double*>(out),
+                        static_cast<double*>(taus),
+                        static_cast<const double*>(a), batch, m, n);
+      break;
+    case internal::LinalgType::C64:
+      internal::EigenQr(device, static_cast<complex64*>(out),
+                        static_cast<complex64*>(taus),
+                        static_cast<const complex64*>(a), batch, m, n);
+      break;
+    case internal::LinalgType::C128:
+      internal::EigenQr(device, static_cast<complex128*>(out),
+                        static_cast<complex128*>(taus),
+                        static_cast<const complex128*>(a), batch, m, n);
+      break;
+    default:
+      // Unsupported element type
+      abort();
+  }
+}
+
+template <typename EigenDevice>
+void EigenEighImpl(const EigenDevice& device, void* v, void* w, void* a,
+                   internal::LinalgType type, int64_t batch, int64_t n,
+                   bool lower) {
+  switch (type) {
+    case internal::LinalgType::F32:
+      internal::EigenEigh(device, static_cast<float*>(v),
+                          static_cast<float*>(w), static_cast<const float*>(a),
+                          batch, n, lower);
+      break;
+    case internal::LinalgType::F64:
+      internal::EigenEigh(device, static_cast<double*>(v),
+                          static_cast<double*>(w),
+                          static_cast<const double*>(a), batch, n, lower);
+      break;
+    case internal::LinalgType::C64:
+      internal::EigenEigh(device, static_cast<complex64*>(v),
+                          static_cast<float*>(w),
+                          static_cast<const complex64*>(a), batch, n, lower);
+      break;
+    case internal::LinalgType::C128:
+      internal::EigenEigh(device, static_cast<complex128*>(v),
+                          static_cast<double*>(w),
+                          static_cast<const complex128*>(a), batch, n, lower);
+      break;
+    default:
+      // Unsupported element type
+      abort();
+  }
+}
+
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_LINALG_IMPL_H_
@@ -0,0 +1,335 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "xla/service/cpu/runtime_linalg.h"
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"  // from @eigen_archive
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/service/cpu/runtime_single_threaded_linalg.h"
+#include "xla/types.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+template <typename T>
+using Matrix =
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+template <typename T>
+Matrix<T> RandomMatrix(int64_t m, int64_t n, std::minstd_rand0* generator) {
+  std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+  Matrix<T> matrix(m, n);
+  for (int64_t i = 0; i < m; ++i) {
+    for (int64_t j = 0; j < n; ++j) {
+      if constexpr (Eigen::NumTraits<T>::IsComplex) {
+        matrix(i, j) = T(distribution(*generator), distribution(*generator));
+      } else {
+        matrix(i, j) = T(distribution(*generator));
+      }
+    }
+  }
+  return matrix;
+}
+
+// Returns a well-conditioned Hermitian positive definite matrix.
+template <typename T>
+Matrix<T> RandomPositiveDefinite(int64_t n, std::minstd_rand0* generator) {
+  Matrix<T> a = RandomMatrix<T>(n, n, generator);
+  return a * a.adjoint() + Matrix<T>::Identity(n, n) * T(n);
+}
+
+template <typename T>
+double Tolerance() {
+  return std::is_same_v<typename Eigen::NumTraits<T>::Real, float> ? 1e-3
+                                                                   : 1e-9;
+}
+
+class RuntimeLinalgTest : public ::testing::TestWithParam<bool> {
+ protected:
+  RuntimeLinalgTest() : pool_(4), device_(&pool_, pool_.NumThreads()) {
+    run_options_.set_intra_op_thread_pool(&device_);
+  }
+
+  bool multi_threaded() const { return GetParam(); }
+
+  template <typename T>
+  void TestCholesky(PrimitiveType type) {
+    constexpr int64_t kBatch = 3, kN = 37;
+    std::minstd_rand0 generator(1);
+    for (bool lower : {true, false}) {
+      std::vector<Matrix<T>> inputs;
+      std::vector<T> buffer;
+      for (int64_t i = 0; i < kBatch; ++i) {
+        inputs.push_back(RandomPositiveDefinite<T>(kN, &generator));
+        buffer.insert(buffer.end(), inputs.back().data(),
+                      inputs.back().data() + kN * kN);
+      }
+      // Decompose in place.
+      if (multi_threaded()) {
+        __xla_cpu_runtime_EigenCholesky(&run_options_, buffer.data(),
+                                        buffer.data(), type, kBatch, kN, lower);
+      } else {
+        __xla_cpu_runtime_EigenSingleThreadedCholesky(
+            &run_options_, buffer.data(), buffer.data(), type, kBatch, kN,
+            lower);
+      }
+      for (int64_t i = 0; i < kBatch; ++i) {
+        Eigen::Map<Matrix<T>> factor(buffer.data() + i * kN * kN, kN, kN);
+        Matrix<T> product = lower ? Matrix<T>(factor * factor.adjoint())
+                                  : Matrix<T>(factor.adjoint() * factor);
+        EXPECT_LT((product - inputs[i]).norm(),
+                  Tolerance<T>() * inputs[i].norm());
+        if (lower) {
+          EXPECT_TRUE(factor.isLowerTriangular());
+        } else {
+          EXPECT_TRUE(factor.isUpperTriangular());
+        }
+      }
+    }
+  }
+
+  template <typename T>
+  void TestTriangularSolve(PrimitiveType type) {
+    constexpr int64_t kBatch = 2, kM = 19, kN = 11;
+    std::minstd_rand0 generator(2);
+    for (bool left_side : {true, false}) {
+      for (bool lower : {true, false}) {
+        for (bool unit_diagonal : {true, false}) {
+          for (TriangularSolveOptions::Transpose transpose_a :
+               {TriangularSolveOptions::NO_TRANSPOSE,
+                TriangularSolveOptions::TRANSPOSE,
+                TriangularSolveOptions::ADJOINT}) {
+            const int64_t k = left_side ? kM : kN;
+            std::vector<T> a, b, x(kBatch * kM * kN);
+            std::vector<Matrix<T>> op_as, bs;
+            for (int64_t i = 0; i < kBatch; ++i) {
+              // Garbage in the other triangle must be ignored.
+              Matrix<T> a_i = RandomMatrix<T>(k, k, &generator) +
+                              Matrix<T>::Identity(k, k) * T(2 * k);
+              Matrix<T> triangle;
+              if (lower) {
+                triangle = a_i.template triangularView<Eigen::Lower>();
+              } else {
+                triangle = a_i.template triangularView<Eigen::Upper>();
+              }
+              if (unit_diagonal) {
+                triangle.diagonal().setOnes();
+              }
+              switch (transpose_a) {
+                case TriangularSolveOptions::TRANSPOSE:
+                  triangle.transposeInPlace();
+                  break;
+                case TriangularSolveOptions::ADJOINT:
+                  triangle.adjointInPlace();
+                  break;
+                default:
+                  break;
+              }
+              op_as.push_back(triangle);
+              bs.push_back(RandomMatrix<T>(kM, kN, &generator));
+              a.insert(a.end(), a_i.data(), a_i.data() + k * k);
+              b.insert(b.end(), bs.back().data(), bs.back().data() + kM * kN);
+            }
+            if (multi_threaded()) {
+              __xla_cpu_runtime_EigenTriangularSolve(
+                  &run_options_, x.data(), a.data(), b.data(), type, kBatch, kM,
+                  kN, left_side, lower, unit_diagonal, transpose_a);
+            } else {
+              __xla_cpu_runtime_EigenSingleThreadedTriangularSolve(
+                  &run_options_, x.data(), a.data(), b.data(), type, kBatch, kM,
+                  kN, left_side, lower, unit_diagonal, transpose_a);
+            }
+            for (int64_t i = 0; i < kBatch; ++i) {
+              Eigen::Map<Matrix<T>> x_i(x.data() + i * kM * kN, kM, kN);
+              Matrix<T> product = left_side ? Matrix<T>(op_as[i] * x_i)
+                                            : Matrix<T>(x_i * op_as[i]);
+              EXPECT_LT((product - bs[i]).norm(), Tolerance<T>() * bs[i].norm())
+                  << "left_side=" << left_side << " lower=" << lower
+                  << " unit_diagonal=" << unit_diagonal
+                  << " transpose_a=" << transpose_a;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  template <typename T>
+  void TestQr(PrimitiveType type) {
+    std::minstd_rand0 generator(3);
+    for (auto [m, n] :
+         {std::pair<int64_t, int64_t>{23, 9}, {9, 23}, {16, 16}}) {
+      const int64_t k = std::min(m, n);
+      Matrix<T> a = RandomMatrix<T>(m, n, &generator);
+      Matrix<T> qr(m, n);
+      std::vector<T> taus(k);
+      if (multi_threaded()) {
+        __xla_cpu_runtime_EigenQr(&run_options_, qr.data(), taus.data(),
+                                  a.data(), type, 1, m, n);
+      } else {
+        __xla_cpu_runtime_EigenSingleThreadedQr(
+            &run_options_, qr.data(), taus.data(), a.data(), type, 1, m, n);
+      }
+      // Q = H(0) H(1) ... H(k-1) with H(i) = I - taus[i] v(i) v(i)^H, as in
+      // LAPACK's geqrf.
+      Matrix<T> q = Matrix<T>::Identity(m, m);
+      for (int64_t i = 0; i < k; ++i) {
+        Eigen::Matrix<T, Eigen::Dynamic, 1> v =
+            Eigen::Matrix<T, Eigen::Dynamic, 1>::Zero(m);
+        v(i) = T(1);
+        v.tail(m - i - 1) = qr.col(i).tail(m - i - 1);
+        q = q * (Matrix<T>::Identity(m, m) - taus[i] * v * v.adjoint());
+      }
+      Matrix<T> r = qr.template triangularView<Eigen::Upper>();
+      EXPECT_LT((q * r - a).norm(), Tolerance<T>() * a.norm())
+          << "m=" << m << " n=" << n;
+    }
+  }
+
+  template <typename T>
+  void TestEigh(PrimitiveType type) {
+    using Real = typename Eigen::NumTraits<T>::Real;
+    constexpr int64_t kBatch = 3, kN = 17;
+    std::minstd_rand0 generator(4);
+    for (bool lower : {true, false}) {
+      std::vector<Matrix<T>> inputs;
+      std::vector<T> a, v(kBatch * kN * kN);
+      std::vector<Real> w(kBatch * kN);
+      for (int64_t i = 0; i < kBatch; ++i) {
+        Matrix<T> random = RandomMatrix<T>(kN, kN, &generator);
+        inputs.push_back(random + random.adjoint());
+        // Only the requested triangle must be read.
+        Matrix<T> garbage = inputs.back();
+        if (lower) {
+          garbage.template triangularView<Eigen::StrictlyUpper>().setZero();
+        } else {
+          garbage.template triangularView<Eigen::StrictlyLower>().setZero();
+        }
+        a.insert(a.end(), garbage.data(), garbage.data() + kN * kN);
+      }
+      if (multi_threaded()) {
+        __xla_cpu_runtime_EigenEigh(&run_options_, v.data(), w.data(),
+                                    a.data(), type, kBatch, kN, lower);
+      } else {
+        __xla_cpu_runtime_EigenSingleThreadedEigh(&run_options_, v.data(),
+                                                  w.data(), a.data(), type,
+                                                  kBatch, kN, lower);
+      }
+      for (int64_t i = 0; i < kBatch; ++i) {
+        Eigen::Map<Matrix<T>> v_i(v.data() + i * kN * kN, kN, kN);
+        Eigen::Map<Eigen::Matrix<Real, Eigen::Dynamic, 1>> w_i(
+            w.data() + i * kN, kN);
+        Matrix<T> product =
+            v_i * w_i.template cast<T>().asDiagonal() * v_i.adjoint();
+        EXPECT_LT((product - inputs[i]).norm(),
+                  Tolerance<T>() * inputs[i].norm());
+        for (int64_t j = 1; j < kN; ++j) {
+          EXPECT_LE(w_i(j - 1), w_i(j));
+        }
+      }
+    }
+  }
+
+ private:
+  Eigen::ThreadPool pool_;
+  Eigen::ThreadPoolDevice device_;
+  ExecutableRunOptions run_options_;
+};
+
+TEST_P(RuntimeLinalgTest, Cholesky) {
+  TestCholesky<float>(F32);
+  TestCholesky<double>(F64);
+  TestCholesky<complex64>(C64);
+  TestCholesky<complex128>(C128);
+}
+
+TEST(RuntimeLinalgCholeskyTest, NotPositiveDefinite) {
+  std::vector<float> a = {1.0f, 2.0f, 2.0f, 1.0f};
+  std::vector<float> out(a.size());
+  __xla_cpu_runtime_EigenSingleThreadedCholesky(nullptr, out.data(), a.data(),
+                                                F32, 1, 2, /*lower=*/true);
+  for (float x : out) {
+    EXPECT_TRUE(std::isnan(x));
+  }
+}
+
+TEST_P(RuntimeLinalgTest, TriangularSolve) {
+  TestTriangularSolve<float>(F32);
+  TestTriangularSolve<double>(F64);
+  TestTriangularSolve<complex64>(C64);
+  TestTriangularSolve<complex128>(C128);
+}
+
+TEST_P(RuntimeLinalgTest, Qr) {
+  TestQr<float>(F32);
+  TestQr<double>(F64);
+  TestQr<complex64>(C64);
+  TestQr<complex128>(C128);
+}
+
+TEST_P(RuntimeLinalgTest, Eigh) {
+  TestEigh<float>(F32);
+  TestEigh<double>(F64);
+  TestEigh<complex64>(C64);
+  TestEigh<complex128>(C128);
+}
+
+INSTANTIATE_TEST_SUITE_P(RuntimeLinalgTestInstantiation, RuntimeLinalgTest,
+                         ::testing::Bool());
+
+// Factorizes range(0) F32 matrices of size range(1) x range(1).
+void BM_CholeskyF32(::testing::benchmark::State& state) {
+  const int64_t batch = state.range(0);
+  const int64_t n = state.range(1);
+  std::minstd_rand0 generator(0);
+  std::vector<float> input;
+  for (int64_t i = 0; i < batch; ++i) {
+    Matrix<float> a = RandomPositiveDefinite<float>(n, &generator);
+    input.insert(input.end(), a.data(), a.data() + n * n);
+  }
+  std::vector<float> out(input.size());
+
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  for (auto s : state) {
+    __xla_cpu_runtime_EigenCholesky(&run_options, out.data(), input.data(), F32,
+                                    batch, n, /*lower=*/true);
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+
+BENCHMARK(BM_CholeskyF32)
+    ->ArgsProduct({{1, 64}, {16, 128, 512}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -21,6 +21,7 @@ limitations under the License.
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "xla/executable_run_options.h"
 #include "xla/service/cpu/runtime_lightweight_check.h"
+#include "xla/service/cpu/runtime_mixed_precision_matmul_impl.h"
 
 #if defined(TENSORFLOW_USE_CUSTOM_CONTRACTION_KERNEL)
 #include "tsl/framework/contraction/eigen_contraction_kernel.h"
@@ -195,6 +196,30 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenMatMulS32(
                           transpose_lhs, transpose_rhs);
 }
 
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenMatMulS8S32(
+    const void* run_options_ptr, int32_t* out, int8_t* lhs, int8_t* rhs,
+    int64_t m, int64_t n, int64_t k, int32_t transpose_lhs,
+    int32_t transpose_rhs) {
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  XLA_LIGHTWEIGHT_CHECK(run_options->intra_op_thread_pool() != nullptr);
+  xla::MixedPrecisionMatMulS8S32Impl(*run_options->intra_op_thread_pool(), out,
+                                     lhs, rhs, m, n, k, transpose_lhs,
+                                     transpose_rhs);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenMatMulBF16F32(
+    const void* run_options_ptr, float* out, Eigen::bfloat16* lhs,
+    Eigen::bfloat16* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs) {
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  XLA_LIGHTWEIGHT_CHECK(run_options->intra_op_thread_pool() != nullptr);
+  xla::MixedPrecisionMatMulBF16F32Impl(*run_options->intra_op_thread_pool(),
+                                       out, lhs, rhs, m, n, k, transpose_lhs,
+                                       transpose_rhs);
+}
+
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenBatchMatMulF32(
     const void* run_options_ptr, float* out, float* lhs, float* rhs, int64_t m,
     int64_t n, int64_t k, int64_t batch_size, int32_t transpose_lhs,
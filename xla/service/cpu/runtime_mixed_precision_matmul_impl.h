@@ -0,0 +1,392 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef XLA_SERVICE_CPU_RUNTIME_MIXED_PRECISION_MATMUL_IMPL_H_
+#define XLA_SERVICE_CPU_RUNTIME_MIXED_PRECISION_MATMUL_IMPL_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include "Eigen/Core"  // from @eigen_archive
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+
+#if defined(__x86_64__) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 10))
+#include <immintrin.h>
+#define XLA_CPU_MIXED_PRECISION_MATMUL_AVX512 1
+#endif
+
+// Matrix multiplications whose operands are narrower than their result:
+// s8 x s8 -> s32 and bf16 x bf16 -> f32. Like the other runtime matmuls, the
+// operands and the result are column-major.
+//
+// The lhs rows and rhs columns are first packed into contiguous, zero-padded
+// panels, so that each result element is a dot product of two contiguous
+// vectors; the result is then computed in independent tiles. The dot products
+// use AVX512-VNNI or AVX512-BF16 instructions when the host CPU supports them.
+// Otherwise s8 dot products use portable loops that compilers vectorize, and
+// bf16 operands are widened to f32 and multiplied by Eigen, whose f32 kernels
+// are faster than a portable bf16 kernel.
+
+namespace xla {
+
+namespace internal {
+
+// Result tile sizes, in elements.
+inline constexpr int64_t kMixedMatMulTileRows = 64;
+inline constexpr int64_t kMixedMatMulTileCols = 64;
+
+// The dot product kernels compute this many result columns at a time, so that
+// every load from the lhs panel is used several times.
+inline constexpr int64_t kMixedMatMulKernelCols = 4;
+
+inline int64_t MixedMatMulRoundUp(int64_t value, int64_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+// s8 x s8 -> s32. The lhs is packed as u8 (x + 128) so that VNNI's u8 x s8
+// multiply-add applies; the extra 128 * sum(rhs column) is subtracted after
+// the dot product. Sums wrap around like XLA's s32 arithmetic.
+struct S8MatMulTraits {
+  using Input = int8_t;
+  using Output = int32_t;
+  using LhsPanel = uint8_t;
+  using RhsPanel = int8_t;
+  using DotFn = void (*)(const uint8_t* lhs_row, const int8_t* rhs_columns,
+                         int64_t depth, int32_t* result);
+
+  static constexpr bool kNeedsRhsSums = true;
+  // Bytes in a 512-bit register.
+  static constexpr int64_t kDepthAlignment = 64;
+
+  static uint8_t PackLhs(int8_t x) { return static_cast<uint8_t>(x) ^ 0x80; }
+  static int8_t PackRhs(int8_t x) { return x; }
+
+  static int32_t Finish(int32_t dot, int32_t rhs_sum) {
+    return static_cast<int32_t>(static_cast<uint32_t>(dot) -
+                                128u * static_cast<uint32_t>(rhs_sum));
+  }
+};
+
+// The inner loop has one accumulator per lane, so that it is vectorized into
+// 16-bit multiply-adds.
+inline void DotS8Portable(const uint8_t* lhs_row, const int8_t* rhs_columns,
+                          int64_t depth, int32_t* result) {
+  constexpr int64_t kLanes = 16;
+  int32_t acc[kMixedMatMulKernelCols][kLanes] = {};
+  for (int64_t p = 0; p < depth; p += kLanes) {
+    for (int64_t c = 0; c < kMixedMatMulKernelCols; ++c) {
+      const int8_t* column = rhs_columns + c * depth + p;
+      for (int64_t l = 0; l < kLanes; ++l) {
+        // |u8 x s8| < 2^15, so only the accumulation can wrap around.
+        acc[c][l] = static_cast<int32_t>(
+            static_cast<uint32_t>(acc[c][l]) +
+            static_cast<uint32_t>(int16_t{lhs_row[p + l]} *
+                                  int16_t{column[l]}));
+      }
+    }
+  }
+  for (int64_t c = 0; c < kMixedMatMulKernelCols; ++c) {
+    uint32_t sum = 0;
+    for (int64_t l = 0; l < kLanes; ++l) {
+      sum += static_cast<uint32_t>(acc[c][l]);
+    }
+    result[c] = static_cast<int32_t>(sum);
+  }
+}
+
+// bf16 x bf16 -> f32 with AVX512-BF16: the panels hold the raw bf16 bits.
+struct BF16Avx512MatMulTraits {
+  using Input = Eigen::bfloat16;
+  using Output = float;
+  using LhsPanel = uint16_t;
+  using RhsPanel = uint16_t;
+  using DotFn = void (*)(const uint16_t* lhs_row, const uint16_t* rhs_columns,
+                         int64_t depth, float* result);
+
+  static constexpr bool kNeedsRhsSums = false;
+  // bf16 values in a 512-bit register.
+  static constexpr int64_t kDepthAlignment = 32;
+
+  static uint16_t PackLhs(Eigen::bfloat16 x) {
+    return Eigen::numext::bit_cast<uint16_t>(x);
+  }
+  static uint16_t PackRhs(Eigen::bfloat16 x) {
+    return Eigen::numext::bit_cast<uint16_t>(x);
+  }
+
+  static float Finish(float dot, int32_t rhs_sum) { return dot; }
+};
+
+#if defined(XLA_CPU_MIXED_PRECISION_MATMUL_AVX512)
+
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) inline void DotS8Vnni(
+    const uint8_t* lhs_row, const int8_t* rhs_columns, int64_t depth,
+    int32_t* result) {
+  __m512i acc0 = _mm512_setzero_si512();
+  __m512i acc1 = _mm512_setzero_si512();
+  __m512i acc2 = _mm512_setzero_si512();
+  __m512i acc3 = _mm512_setzero_si512();
+  for (int64_t p = 0; p < depth; p += 64) {
+    __m512i lhs = _mm512_loadu_si512(lhs_row + p);
+    acc0 = _mm512_dpbusd_epi32(acc0, lhs,
+                               _mm512_loadu_si512(rhs_columns + p));
+    acc1 = _mm512_dpbusd_epi32(acc1, lhs,
+                               _mm512_loadu_si512(rhs_columns + depth + p));
+    acc2 = _mm512_dpbusd_epi32(
+        acc2, lhs, _mm512_loadu_si512(rhs_columns + 2 * depth + p));
+    acc3 = _mm512_dpbusd_epi32(
+        acc3, lhs, _mm512_loadu_si512(rhs_columns + 3 * depth + p));
+  }
+  result[0] = _mm512_reduce_add_epi32(acc0);
+  result[1] = _mm512_reduce_add_epi32(acc1);
+  result[2] = _mm512_reduce_add_epi32(acc2);
+  result[3] = _mm512_reduce_add_epi32(acc3);
+}
+
+__attribute__((target("avx512f,avx512bf16"))) inline __m512bh LoadBF16(
+    const uint16_t* data) {
+  __m512bh result;
+  std::memcpy(&result, data, sizeof(result));
+  return result;
+}
+
+__attribute__((target("avx512f,avx512bf16"))) inline void DotBF16Avx512(
+    const uint16_t* lhs_row, const uint16_t* rhs_columns, int64_t depth,
+    float* result) {
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  __m512 acc2 = _mm512_setzero_ps();
+  __m512 acc3 = _mm512_setzero_ps();
+  for (int64_t p = 0; p < depth; p += 32) {
+    __m512bh lhs = LoadBF16(lhs_row + p);
+    acc0 = _mm512_dpbf16_ps(acc0, lhs, LoadBF16(rhs_columns + p));
+    acc1 = _mm512_dpbf16_ps(acc1, lhs, LoadBF16(rhs_columns + depth + p));
+    acc2 = _mm512_dpbf16_ps(acc2, lhs, LoadBF16(rhs_columns + 2 * depth + p));
+    acc3 = _mm512_dpbf16_ps(acc3, lhs, LoadBF16(rhs_columns + 3 * depth + p));
+  }
+  result[0] = _mm512_reduce_add_ps(acc0);
+  result[1] = _mm512_reduce_add_ps(acc1);
+  result[2] = _mm512_reduce_add_ps(acc2);
+  result[3] = _mm512_reduce_add_ps(acc3);
+}
+
+#endif  // XLA_CPU_MIXED_PRECISION_MATMUL_AVX512
+
+inline bool HostHasAvx512Vnni() {
+#if defined(XLA_CPU_MIXED_PRECISION_MATMUL_AVX512)
+  static const bool has_vnni = __builtin_cpu_supports("avx512bw") &&
+                               __builtin_cpu_supports("avx512vnni");
+  return has_vnni;
+#else
+  return false;
+#endif
+}
+
+inline bool HostHasAvx512BF16() {
+#if defined(XLA_CPU_MIXED_PRECISION_MATMUL_AVX512)
+  static const bool has_bf16 = __builtin_cpu_supports("avx512bf16");
+  return has_bf16;
+#else
+  return false;
+#endif
+}
+
+// Runs `fn(begin, end)` over blocks of [0, size) on `device`; one unit of work
+// costs `cost`.
+template <typename EigenDevice, typename Fn>
+void MixedMatMulParallelFor(const EigenDevice& device, int64_t size,
+                            const Eigen::TensorOpCost& cost, const Fn& fn) {
+  if constexpr (std::is_same_v<EigenDevice, Eigen::DefaultDevice>) {
+    fn(0, size);
+  } else {
+    device.parallelFor(size, cost, [&](Eigen::Index begin, Eigen::Index end) {
+      fn(begin, end);
+    });
+  }
+}
+
+// Packs rows [begin, end) of a `depth` deep operand into `panel`, one
+// contiguous zero-padded row of `padded_depth` elements per operand row.
+// Element (r, p) of the operand is src[r * row_stride + p * depth_stride].
+// When `sums` is not null, also stores the sum of every row into it.
+template <typename Input, typename Panel, typename PackFn>
+void PackMixedMatMulPanel(const Input* src, int64_t begin, int64_t end,
+                          int64_t depth, int64_t row_stride,
+                          int64_t depth_stride, int64_t padded_depth,
+                          PackFn pack, Panel* panel, int32_t* sums) {
+  // Blocks of the depth dimension, so that transposing reads stay in cache.
+  constexpr int64_t kDepthBlock = 64;
+  for (int64_t p0 = 0; p0 < depth; p0 += kDepthBlock) {
+    const int64_t p1 = std::min(depth, p0 + kDepthBlock);
+    for (int64_t r = begin; r < end; ++r) {
+      const Input* row = src + r * row_stride;
+      Panel* dst = panel + r * padded_depth;
+      for (int64_t p = p0; p < p1; ++p) {
+        dst[p] = pack(row[p * depth_stride]);
+      }
+      if (sums != nullptr) {
+        int32_t sum = p0 == 0 ? 0 : sums[r];
+        for (int64_t p = p0; p < p1; ++p) {
+          sum += static_cast<int32_t>(row[p * depth_stride]);
+        }
+        sums[r] = sum;
+      }
+    }
+  }
+  for (int64_t r = begin; r < end; ++r) {
+    std::fill(panel + r * padded_depth + depth, panel + (r + 1) * padded_depth,
+              Panel{0});
+  }
+}
+
+// Computes out = lhs x rhs, where lhs is m x k and rhs is k x n (or their
+// transposes), on `device`.
+template <typename Traits, typename EigenDevice>
+void MixedPrecisionMatMul(const EigenDevice& device,
+                          typename Traits::Output* out,
+                          const typename Traits::Input* lhs,
+                          const typename Traits::Input* rhs, int64_t m,
+                          int64_t n, int64_t k, bool transpose_lhs,
+                          bool transpose_rhs, typename Traits::DotFn dot) {
+  using Input = typename Traits::Input;
+  using Output = typename Traits::Output;
+  using LhsPanel = typename Traits::LhsPanel;
+  using RhsPanel = typename Traits::RhsPanel;
+
+  if (m == 0 || n == 0) {
+    return;
+  }
+
+  // Every lhs row and rhs column is packed once, into a contiguous row of the
+  // lhs or rhs panel. The rhs panel has a multiple of kMixedMatMulKernelCols
+  // rows; the results for its zero padding rows are dropped.
+  const int64_t padded_depth =
+      std::max(MixedMatMulRoundUp(k, Traits::kDepthAlignment),
+               Traits::kDepthAlignment);
+  const int64_t panel_columns = MixedMatMulRoundUp(n, kMixedMatMulKernelCols);
+  std::unique_ptr<LhsPanel[]> lhs_panel(new LhsPanel[m * padded_depth]);
+  std::unique_ptr<RhsPanel[]> rhs_panel(
+      new RhsPanel[panel_columns * padded_depth]);
+  std::unique_ptr<int32_t[]> rhs_sums(new int32_t[panel_columns]());
+  std::fill(rhs_panel.get() + n * padded_depth,
+            rhs_panel.get() + panel_columns * padded_depth, RhsPanel{0});
+
+  const Eigen::TensorOpCost pack_cost(k * sizeof(Input),
+                                      padded_depth * sizeof(LhsPanel), k);
+  MixedMatMulParallelFor(device, m, pack_cost, [&](int64_t begin, int64_t end) {
+    PackMixedMatMulPanel(lhs, begin, end, k,
+                         /*row_stride=*/transpose_lhs ? k : 1,
+                         /*depth_stride=*/transpose_lhs ? 1 : m, padded_depth,
+                         Traits::PackLhs, lhs_panel.get(), nullptr);
+  });
+  MixedMatMulParallelFor(device, n, pack_cost, [&](int64_t begin, int64_t end) {
+    PackMixedMatMulPanel(rhs, begin, end, k,
+                         /*row_stride=*/transpose_rhs ? 1 : k,
+                         /*depth_stride=*/transpose_rhs ? n : 1, padded_depth,
+                         Traits::PackRhs, rhs_panel.get(),
+                         Traits::kNeedsRhsSums ? rhs_sums.get() : nullptr);
+  });
+
+  const int64_t row_tiles =
+      (m + kMixedMatMulTileRows - 1) / kMixedMatMulTileRows;
+  const int64_t column_tiles =
+      (n + kMixedMatMulTileCols - 1) / kMixedMatMulTileCols;
+  auto compute_tiles = [&](int64_t begin, int64_t end) {
+    for (int64_t tile = begin; tile < end; ++tile) {
+      const int64_t i0 = (tile % row_tiles) * kMixedMatMulTileRows;
+      const int64_t j0 = (tile / row_tiles) * kMixedMatMulTileCols;
+      const int64_t i1 = std::min(m, i0 + kMixedMatMulTileRows);
+      const int64_t j1 = std::min(n, j0 + kMixedMatMulTileCols);
+      for (int64_t j = j0; j < j1; j += kMixedMatMulKernelCols) {
+        const RhsPanel* rhs_columns = rhs_panel.get() + j * padded_depth;
+        const int64_t kernel_columns = std::min(kMixedMatMulKernelCols, j1 - j);
+        for (int64_t i = i0; i < i1; ++i) {
+          Output result[kMixedMatMulKernelCols];
+          dot(lhs_panel.get() + i * padded_depth, rhs_columns, padded_depth,
+              result);
+          for (int64_t c = 0; c < kernel_columns; ++c) {
+            out[i + (j + c) * m] = Traits::Finish(result[c], rhs_sums[j + c]);
+          }
+        }
+      }
+    }
+  };
+  MixedMatMulParallelFor(
+      device, row_tiles * column_tiles,
+      Eigen::TensorOpCost(
+          (kMixedMatMulTileRows + kMixedMatMulTileCols) * padded_depth *
+              sizeof(LhsPanel),
+          kMixedMatMulTileRows * kMixedMatMulTileCols * sizeof(Output),
+          kMixedMatMulTileRows * kMixedMatMulTileCols * padded_depth),
+      compute_tiles);
+}
+
+}  // namespace internal
+
+template <typename EigenDevice>
+void MixedPrecisionMatMulS8S32Impl(const EigenDevice& device, int32_t* out,
+                                   const int8_t* lhs, const int8_t* rhs,
+                                   int64_t m, int64_t n, int64_t k,
+                                   bool transpose_lhs, bool transpose_rhs) {
+  internal::S8MatMulTraits::DotFn dot = internal::DotS8Portable;
+#if defined(XLA_CPU_MIXED_PRECISION_MATMUL_AVX512)
+  if (internal::HostHasAvx512Vnni()) {
+    dot = internal::DotS8Vnni;
+  }
+#endif
+  internal::MixedPrecisionMatMul<internal::S8MatMulTraits>(
+      device, out, lhs, rhs, m, n, k, transpose_lhs, transpose_rhs, dot);
+}
+
+template <typename EigenDevice>
+void MixedPrecisionMatMulBF16F32Impl(const EigenDevice& device, float* out,
+                                     const Eigen::bfloat16* lhs,
+                                     const Eigen::bfloat16* rhs, int64_t m,
+                                     int64_t n, int64_t k, bool transpose_lhs,
+                                     bool transpose_rhs) {
+#if defined(XLA_CPU_MIXED_PRECISION_MATMUL_AVX512)
+  if (internal::HostHasAvx512BF16()) {
+    internal::MixedPrecisionMatMul<internal::BF16Avx512MatMulTraits>(
+        device, out, lhs, rhs, m, n, k, transpose_lhs, transpose_rhs,
+        internal::DotBF16Avx512);
+    return;
+  }
+#endif
+  using ConstBF16Matrix =
+      Eigen::TensorMap<Eigen::Tensor<const Eigen::bfloat16, 2>,
+                       Eigen::Unaligned>;
+  const ConstBF16Matrix lhs_bf16(lhs, transpose_lhs ? k : m,
+                                 transpose_lhs ? m : k);
+  const ConstBF16Matrix rhs_bf16(rhs, transpose_rhs ? n : k,
+                                 transpose_rhs ? k : n);
+  Eigen::Tensor<float, 2> lhs_f32(lhs_bf16.dimensions());
+  Eigen::Tensor<float, 2> rhs_f32(rhs_bf16.dimensions());
+  lhs_f32.device(device) = lhs_bf16.template cast<float>();
+  rhs_f32.device(device) = rhs_bf16.template cast<float>();
+
+  using DimPair = Eigen::Tensor<float, 2>::DimensionPair;
+  const Eigen::array<DimPair, 1> dims(
+      {DimPair(transpose_lhs ? 0 : 1, transpose_rhs ? 1 : 0)});
+  Eigen::TensorMap<Eigen::Tensor<float, 2>, Eigen::Unaligned> result(out, m,
+                                                                      n);
+  result.device(device) = lhs_f32.contract(rhs_f32, dims);
+}
+
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_MIXED_PRECISION_MATMUL_IMPL_H_
@@ -0,0 +1,273 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_rng_bit_generator.h"
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cstdint>
+
+#include "absl/base/dynamic_annotations.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/service/cpu/runtime_lightweight_check.h"
+
+namespace {
+
+// Number of counters that are encrypted together. Every round of the ciphers
+// below is a loop over the lanes of a block, which the compiler vectorizes.
+constexpr int64_t kBlockSize = 16;
+
+using Block = uint32_t[kBlockSize];
+
+// Philox4x32 with 10 rounds, as in Philox4x32 in xla/client/lib/prng.cc.
+void Philox4x32(uint32_t key0, uint32_t key1, Block x[4]) {
+  // The widening multiplications are kept in a loop of their own so that they
+  // can be lowered to 32x32->64-bit vector multiplies.
+  uint64_t product0[kBlockSize];
+  uint64_t product1[kBlockSize];
+  for (int round = 0; round < 10; ++round) {
+    for (int64_t j = 0; j < kBlockSize; ++j) {
+      product0[j] = uint64_t{0xD2511F53} * x[0][j];
+      product1[j] = uint64_t{0xCD9E8D57} * x[2][j];
+    }
+    for (int64_t j = 0; j < kBlockSize; ++j) {
+      x[0][j] = static_cast<uint32_t>(product1[j] >> 32) ^ x[1][j] ^ key0;
+      x[1][j] = static_cast<uint32_t>(product1[j]);
+      x[2][j] = static_cast<uint32_t>(product0[j] >> 32) ^ x[3][j] ^ key1;
+      x[3][j] = static_cast<uint32_t>(product0[j]);
+    }
+    key0 += 0x9E3779B9;
+    key1 += 0xBB67AE85;
+  }
+}
+
+// ThreeFry2x32 with 20 rounds, as in ThreeFry2x32 in xla/client/lib/prng.cc.
+void ThreeFry2x32(uint32_t key0, uint32_t key1, Block x[2]) {
+  constexpr int kRotations[2][4] = {{13, 15, 26, 6}, {17, 29, 16, 24}};
+  const uint32_t ks[3] = {key0, key1, key0 ^ key1 ^ 0x1BD11BDA};
+  for (int64_t j = 0; j < kBlockSize; ++j) {
+    x[0][j] += ks[0];
+    x[1][j] += ks[1];
+  }
+  for (int i = 0; i < 5; ++i) {
+    for (int rotation : kRotations[i % 2]) {
+      for (int64_t j = 0; j < kBlockSize; ++j) {
+        x[0][j] += x[1][j];
+        x[1][j] = (x[1][j] << rotation) | (x[1][j] >> (32 - rotation));
+        x[1][j] ^= x[0][j];
+      }
+    }
+    const uint32_t k0 = ks[(i + 1) % 3];
+    const uint32_t k1 = ks[(i + 2) % 3] + i + 1;
+    for (int64_t j = 0; j < kBlockSize; ++j) {
+      x[0][j] += k0;
+      x[1][j] += k1;
+    }
+  }
+}
+
+// Calls `generate(begin, end)` for ranges of [0, num_counters) that together
+// cover it, on the intra-op thread pool of `run_options_ptr` if it has one.
+template <typename Generate>
+void ParallelForCounters(const void* run_options_ptr, int64_t num_counters,
+                         int64_t bytes_per_counter, double cycles_per_counter,
+                         Generate generate) {
+  const Eigen::ThreadPoolDevice* device =
+      run_options_ptr == nullptr
+          ? nullptr
+          : static_cast<const xla::ExecutableRunOptions*>(run_options_ptr)
+                ->intra_op_thread_pool();
+  if (device == nullptr || num_counters <= kBlockSize) {
+    generate(0, num_counters);
+    return;
+  }
+  device->parallelFor(
+      num_counters,
+      Eigen::TensorOpCost(0, bytes_per_counter, cycles_per_counter),
+      [&](Eigen::Index begin, Eigen::Index end) { generate(begin, end); });
+}
+
+// Fills `out` with the Philox bits of the counters starting at the 128-bit
+// counter (`counter_low`, `counter_high`) and returns the number of counters
+// used. Every counter yields four 32-bit values, truncated to T, or two 64-bit
+// values.
+template <typename T>
+int64_t PhiloxFill(const void* run_options_ptr, uint64_t key,
+                   uint64_t counter_low, uint64_t counter_high,
+                   int64_t num_elements, T* out) {
+  constexpr int64_t kValuesPerCounter = sizeof(T) == 8 ? 2 : 4;
+  const int64_t num_counters =
+      (num_elements + kValuesPerCounter - 1) / kValuesPerCounter;
+  auto generate = [&](int64_t begin, int64_t end) {
+    Block x[4];
+    for (int64_t start = begin; start < end; start += kBlockSize) {
+      for (int64_t j = 0; j < kBlockSize; ++j) {
+        uint64_t low = counter_low + static_cast<uint64_t>(start + j);
+        uint64_t high = counter_high + (low < counter_low ? 1 : 0);
+        x[0][j] = static_cast<uint32_t>(low);
+        x[1][j] = static_cast<uint32_t>(low >> 32);
+        x[2][j] = static_cast<uint32_t>(high);
+        x[3][j] = static_cast<uint32_t>(high >> 32);
+      }
+      Philox4x32(static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32),
+                 x);
+      const int64_t lanes = std::min(kBlockSize, end - start);
+      for (int64_t j = 0; j < lanes; ++j) {
+        const int64_t first = (start + j) * kValuesPerCounter;
+        const int64_t count =
+            std::min(kValuesPerCounter, num_elements - first);
+        for (int64_t k = 0; k < count; ++k) {
+          if constexpr (sizeof(T) == 8) {
+            out[first + k] = x[2 * k][j] | uint64_t{x[2 * k + 1][j]} << 32;
+          } else {
+            out[first + k] = static_cast<T>(x[k][j]);
+          }
+        }
+      }
+    }
+  };
+  ParallelForCounters(run_options_ptr, num_counters,
+                      kValuesPerCounter * sizeof(T), /*cycles_per_counter=*/80,
+                      generate);
+  return num_counters;
+}
+
+// Fills `out` with the ThreeFry bits of the counters starting at `counter` and
+// returns the number of counters used. 64-bit values take both words of one
+// counter. Narrower values take one word each: the counter of element
+// (a, 2 * h + w, b) of the [outer_size, split_size, inner_size] array is the
+// linear index of (a, h, b) in [outer_size, ceil(split_size / 2), inner_size],
+// and w picks the word.
+template <typename T>
+int64_t ThreeFryFill(const void* run_options_ptr, uint64_t key,
+                     uint64_t counter, int64_t outer_size, int64_t split_size,
+                     int64_t inner_size, T* out) {
+  constexpr bool kWide = sizeof(T) == 8;
+  const int64_t half_size = kWide ? split_size : (split_size + 1) / 2;
+  const int64_t num_counters = outer_size * half_size * inner_size;
+  auto generate = [&](int64_t begin, int64_t end) {
+    Block x[2];
+    for (int64_t start = begin; start < end; start += kBlockSize) {
+      for (int64_t j = 0; j < kBlockSize; ++j) {
+        uint64_t value = counter + static_cast<uint64_t>(start + j);
+        x[0][j] = static_cast<uint32_t>(value);
+        x[1][j] = static_cast<uint32_t>(value >> 32);
+      }
+      ThreeFry2x32(static_cast<uint32_t>(key),
+                   static_cast<uint32_t>(key >> 32), x);
+      const int64_t lanes = std::min(kBlockSize, end - start);
+      if constexpr (kWide) {
+        for (int64_t j = 0; j < lanes; ++j) {
+          out[start + j] = x[0][j] | uint64_t{x[1][j]} << 32;
+        }
+      } else {
+        for (int64_t j = 0; j < lanes; ++j) {
+          const int64_t i = start + j;
+          const int64_t row = i / inner_size;
+          const int64_t b = i % inner_size;
+          const int64_t a = row / half_size;
+          const int64_t h = row % half_size;
+          out[(a * split_size + 2 * h) * inner_size + b] =
+              static_cast<T>(x[0][j]);
+          if (2 * h + 1 < split_size) {
+            out[(a * split_size + 2 * h + 1) * inner_size + b] =
+                static_cast<T>(x[1][j]);
+          }
+        }
+      }
+    }
+  };
+  ParallelForCounters(run_options_ptr, num_counters, 2 * sizeof(T),
+                      /*cycles_per_counter=*/100, generate);
+  return num_counters;
+}
+
+}  // namespace
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_PhiloxBitGenerator(
+    const void* run_options_ptr, const uint64_t* state, int64_t state_size,
+    uint64_t* out_state, int64_t bit_width, int64_t num_elements, void* out) {
+  XLA_LIGHTWEIGHT_CHECK(state_size == 2 || state_size == 3);
+  const uint64_t key = state[0];
+  const uint64_t counter_low = state[1];
+  const uint64_t counter_high = state_size == 3 ? state[2] : state[0];
+  int64_t num_counters;
+  switch (bit_width) {
+    case 8:
+      num_counters =
+          PhiloxFill(run_options_ptr, key, counter_low, counter_high,
+                     num_elements, static_cast<uint8_t*>(out));
+      break;
+    case 16:
+      num_counters =
+          PhiloxFill(run_options_ptr, key, counter_low, counter_high,
+                     num_elements, static_cast<uint16_t*>(out));
+      break;
+    case 32:
+      num_counters =
+          PhiloxFill(run_options_ptr, key, counter_low, counter_high,
+                     num_elements, static_cast<uint32_t*>(out));
+      break;
+    default:
+      XLA_LIGHTWEIGHT_CHECK(bit_width == 64);
+      num_counters =
+          PhiloxFill(run_options_ptr, key, counter_low, counter_high,
+                     num_elements, static_cast<uint64_t*>(out));
+      break;
+  }
+  const uint64_t new_counter_low =
+      counter_low + static_cast<uint64_t>(num_counters);
+  out_state[0] = key;
+  out_state[1] = new_counter_low;
+  if (state_size == 3) {
+    out_state[2] = counter_high + (new_counter_low < counter_low ? 1 : 0);
+  }
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_ThreeFryBitGenerator(
+    const void* run_options_ptr, const uint64_t* state, uint64_t* out_state,
+    int64_t bit_width, int64_t outer_size, int64_t split_size,
+    int64_t inner_size, void* out) {
+  const uint64_t key = state[0];
+  const uint64_t counter = state[1];
+  int64_t num_counters;
+  switch (bit_width) {
+    case 8:
+      num_counters =
+          ThreeFryFill(run_options_ptr, key, counter, outer_size, split_size,
+                       inner_size, static_cast<uint8_t*>(out));
+      break;
+    case 16:
+      num_counters =
+          ThreeFryFill(run_options_ptr, key, counter, outer_size, split_size,
+                       inner_size, static_cast<uint16_t*>(out));
+      break;
+    case 32:
+      num_counters =
+          ThreeFryFill(run_options_ptr, key, counter, outer_size, split_size,
+                       inner_size, static_cast<uint32_t*>(out));
+      break;
+    default:
+      XLA_LIGHTWEIGHT_CHECK(bit_width == 64);
+      num_counters =
+          ThreeFryFill(run_options_ptr, key, counter, outer_size, split_size,
+                       inner_size, static_cast<uint64_t*>(out));
+      break;
+  }
+  out_state[0] = key;
+  out_state[1] = counter + static_cast<uint64_t>(num_counters);
+}
@@ -0,0 +1,49 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_RUNTIME_RNG_BIT_GENERATOR_H_
+#define XLA_SERVICE_CPU_RUNTIME_RNG_BIT_GENERATOR_H_
+
+#include <stdint.h>
+
+extern "C" {
+
+// Implements RngBitGenerator with the Philox4x32-10 algorithm, producing the
+// same bits and output state as RngBitGeneratorExpander. `state` holds the key
+// followed by the 128-bit counter; with `state_size` == 2 the high half of the
+// counter is the key. `out` is a row-major array of `num_elements` unsigned
+// integers of `bit_width` bits (8, 16, 32 or 64). `state` and `out_state` may
+// alias. Counters are spread over the intra-op thread pool of
+// `run_options_ptr`; if it is null the bits are generated on the calling
+// thread.
+extern void __xla_cpu_runtime_PhiloxBitGenerator(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    const uint64_t* state, int64_t state_size, uint64_t* out_state,
+    int64_t bit_width, int64_t num_elements, void* out);
+
+// Implements RngBitGenerator with the ThreeFry2x32-20 algorithm, producing the
+// same bits and output state as RngBitGeneratorExpander. `state` holds the key
+// and the 64-bit counter. `out` is a row-major array of [outer_size,
+// split_size, inner_size] unsigned integers of `bit_width` bits, where the
+// middle dimension is the one the expander splits in halves to use both words
+// of every ThreeFry output. 64-bit outputs are not split.
+extern void __xla_cpu_runtime_ThreeFryBitGenerator(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    const uint64_t* state, uint64_t* out_state, int64_t bit_width,
+    int64_t outer_size, int64_t split_size, int64_t inner_size, void* out);
+
+}  // extern "C"
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_RNG_BIT_GENERATOR_H_
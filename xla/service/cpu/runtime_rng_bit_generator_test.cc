@@ -0,0 +1,290 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "xla/service/cpu/runtime_rng_bit_generator.h"
+
+#define EIGEN_USE_THREADS
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Straightforward versions of the ciphers in xla/client/lib/prng.cc.
+std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> x,
+                                   std::array<uint32_t, 2> key) {
+  for (int round = 0; round < 10; ++round) {
+    uint64_t product0 = uint64_t{0xD2511F53} * x[0];
+    uint64_t product1 = uint64_t{0xCD9E8D57} * x[2];
+    x = {static_cast<uint32_t>(product1 >> 32) ^ x[1] ^ key[0],
+         static_cast<uint32_t>(product1),
+         static_cast<uint32_t>(product0 >> 32) ^ x[3] ^ key[1],
+         static_cast<uint32_t>(product0)};
+    key[0] += 0x9E3779B9;
+    key[1] += 0xBB67AE85;
+  }
+  return x;
+}
+
+std::array<uint32_t, 2> ThreeFry2x32(std::array<uint32_t, 2> x,
+                                     std::array<uint32_t, 2> key) {
+  const std::array<int, 8> rotations = {13, 15, 26, 6, 17, 29, 16, 24};
+  const std::array<uint32_t, 3> ks = {key[0], key[1],
+                                      key[0] ^ key[1] ^ 0x1BD11BDA};
+  auto rounds = [&](int first_rotation) {
+    for (int r = first_rotation; r < first_rotation + 4; ++r) {
+      x[0] += x[1];
+      x[1] = (x[1] << rotations[r]) | (x[1] >> (32 - rotations[r]));
+      x[1] ^= x[0];
+    }
+  };
+  x[0] += ks[0];
+  x[1] += ks[1];
+  rounds(0);
+  x[0] += ks[1];
+  x[1] += ks[2] + 1;
+  rounds(4);
+  x[0] += ks[2];
+  x[1] += ks[0] + 2;
+  rounds(0);
+  x[0] += ks[0];
+  x[1] += ks[1] + 3;
+  rounds(4);
+  x[0] += ks[1];
+  x[1] += ks[2] + 4;
+  rounds(0);
+  x[0] += ks[2];
+  x[1] += ks[0] + 5;
+  return x;
+}
+
+std::array<uint32_t, 2> Split(uint64_t value) {
+  return {static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32)};
+}
+
+// The 32-bit words of PhiloxRngBit32, or the 64-bit words of PhiloxRngBit64.
+std::vector<uint64_t> ReferencePhilox(uint64_t key, uint64_t counter_low,
+                                      uint64_t counter_high,
+                                      int64_t num_elements, bool wide) {
+  std::vector<uint64_t> values;
+  for (uint64_t i = 0; values.size() < num_elements; ++i) {
+    uint64_t low = counter_low + i;
+    uint64_t high = counter_high + (low < counter_low);
+    std::array<uint32_t, 2> l = Split(low);
+    std::array<uint32_t, 2> h = Split(high);
+    std::array<uint32_t, 4> bits = Philox4x32({l[0], l[1], h[0], h[1]},
+                                              Split(key));
+    if (wide) {
+      values.push_back(bits[0] | uint64_t{bits[1]} << 32);
+      values.push_back(bits[2] | uint64_t{bits[3]} << 32);
+    } else {
+      values.insert(values.end(), bits.begin(), bits.end());
+    }
+  }
+  values.resize(num_elements);
+  return values;
+}
+
+// The 32-bit words of ThreeFryRngBit32: the bits of a [outer, half, 1, inner]
+// array of counters are concatenated along the unit dimension, reshaped to
+// [outer, 2 * half, inner] and sliced to [outer, split, inner].
+std::vector<uint64_t> ReferenceThreeFry32(uint64_t key, uint64_t counter,
+                                          int64_t outer, int64_t split,
+                                          int64_t inner) {
+  const int64_t half = (split + 1) / 2;
+  std::vector<uint64_t> concat(outer * half * 2 * inner);
+  for (int64_t a = 0; a < outer; ++a) {
+    for (int64_t h = 0; h < half; ++h) {
+      for (int64_t b = 0; b < inner; ++b) {
+        uint64_t index = (a * half + h) * inner + b;
+        std::array<uint32_t, 2> bits =
+            ThreeFry2x32(Split(counter + index), Split(key));
+        for (int64_t w = 0; w < 2; ++w) {
+          concat[((a * half + h) * 2 + w) * inner + b] = bits[w];
+        }
+      }
+    }
+  }
+  std::vector<uint64_t> values;
+  for (int64_t a = 0; a < outer; ++a) {
+    for (int64_t s = 0; s < split; ++s) {
+      for (int64_t b = 0; b < inner; ++b) {
+        values.push_back(concat[(a * 2 * half + s) * inner + b]);
+      }
+    }
+  }
+  return values;
+}
+
+template <typename T>
+std::vector<uint64_t> Widen(const std::vector<T>& values) {
+  return std::vector<uint64_t>(values.begin(), values.end());
+}
+
+template <typename T>
+std::vector<uint64_t> Truncate(std::vector<uint64_t> values) {
+  for (uint64_t& value : values) {
+    value = static_cast<T>(value);
+  }
+  return values;
+}
+
+class RuntimeRngBitGeneratorTest : public ::testing::Test {
+ protected:
+  RuntimeRngBitGeneratorTest()
+      : pool_(4), device_(&pool_, pool_.NumThreads()) {
+    run_options_.set_intra_op_thread_pool(&device_);
+  }
+
+  // Runs with and without the thread pool.
+  std::vector<const ExecutableRunOptions*> AllRunOptions() const {
+    return {&run_options_, nullptr};
+  }
+
+  template <typename T>
+  void ExpectPhilox(std::vector<uint64_t> state, int64_t num_elements) {
+    const uint64_t counter_high = state.size() == 3 ? state[2] : state[0];
+    std::vector<uint64_t> expected = ReferencePhilox(
+        state[0], state[1], counter_high, num_elements, sizeof(T) == 8);
+    if (sizeof(T) < 8) {
+      expected = Truncate<T>(expected);
+    }
+    const uint64_t num_counters =
+        (num_elements + (sizeof(T) == 8 ? 1 : 3)) / (sizeof(T) == 8 ? 2 : 4);
+    std::vector<uint64_t> expected_state = state;
+    expected_state[1] += num_counters;
+    if (state.size() == 3 && expected_state[1] < state[1]) {
+      ++expected_state[2];
+    }
+    for (const ExecutableRunOptions* run_options : AllRunOptions()) {
+      std::vector<T> out(num_elements);
+      std::vector<uint64_t> out_state(state.size());
+      __xla_cpu_runtime_PhiloxBitGenerator(run_options, state.data(),
+                                           state.size(), out_state.data(),
+                                           sizeof(T) * 8, num_elements,
+                                           out.data());
+      EXPECT_EQ(Widen(out), expected) << "bits " << sizeof(T) * 8;
+      EXPECT_EQ(out_state, expected_state);
+    }
+  }
+
+  template <typename T>
+  void ExpectThreeFry(std::vector<uint64_t> state, int64_t outer,
+                      int64_t split, int64_t inner) {
+    std::vector<uint64_t> expected;
+    uint64_t num_counters;
+    if (sizeof(T) == 8) {
+      num_counters = outer * split * inner;
+      for (uint64_t i = 0; i < num_counters; ++i) {
+        std::array<uint32_t, 2> bits =
+            ThreeFry2x32(Split(state[1] + i), Split(state[0]));
+        expected.push_back(bits[0] | uint64_t{bits[1]} << 32);
+      }
+    } else {
+      num_counters = outer * ((split + 1) / 2) * inner;
+      expected = Truncate<T>(
+          ReferenceThreeFry32(state[0], state[1], outer, split, inner));
+    }
+    for (const ExecutableRunOptions* run_options : AllRunOptions()) {
+      std::vector<T> out(outer * split * inner);
+      std::vector<uint64_t> out_state(2);
+      __xla_cpu_runtime_ThreeFryBitGenerator(run_options, state.data(),
+                                             out_state.data(), sizeof(T) * 8,
+                                             outer, split, inner, out.data());
+      EXPECT_EQ(Widen(out), expected) << "bits " << sizeof(T) * 8;
+      EXPECT_EQ(out_state,
+                (std::vector<uint64_t>{state[0], state[1] + num_counters}));
+    }
+  }
+
+ private:
+  Eigen::ThreadPool pool_;
+  Eigen::ThreadPoolDevice device_;
+  ExecutableRunOptions run_options_;
+};
+
+// Known answers from the Random123 test vectors.
+TEST(RngCipherTest, KnownAnswers) {
+  EXPECT_EQ(Philox4x32({0, 0, 0, 0}, {0, 0}),
+            (std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+                                     0x9b00dbd8}));
+  EXPECT_EQ(Philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                       {0xa4093822, 0x299f31d0}),
+            (std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420,
+                                     0x24126ea1}));
+  EXPECT_EQ(ThreeFry2x32({0, 0}, {0, 0}),
+            (std::array<uint32_t, 2>{0x6b200159, 0x99ba4efe}));
+  EXPECT_EQ(ThreeFry2x32({0x243f6a88, 0x85a308d3}, {0x13198a2e, 0x03707344}),
+            (std::array<uint32_t, 2>{0xc4923a9c, 0x483df7a0}));
+}
+
+TEST_F(RuntimeRngBitGeneratorTest, Philox) {
+  for (int64_t num_elements : {0, 1, 3, 4, 5, 63, 64, 65, 1000}) {
+    for (std::vector<uint64_t> state :
+         {std::vector<uint64_t>{42, 7, 3}, std::vector<uint64_t>{42, 7}}) {
+      ExpectPhilox<uint8_t>(state, num_elements);
+      ExpectPhilox<uint16_t>(state, num_elements);
+      ExpectPhilox<uint32_t>(state, num_elements);
+      ExpectPhilox<uint64_t>(state, num_elements);
+    }
+  }
+}
+
+TEST_F(RuntimeRngBitGeneratorTest, PhiloxCounterCarries) {
+  ExpectPhilox<uint32_t>({1, ~uint64_t{0} - 5, 9}, 100);
+  ExpectPhilox<uint64_t>({1, ~uint64_t{0} - 5, ~uint64_t{0}}, 100);
+}
+
+TEST_F(RuntimeRngBitGeneratorTest, ThreeFry) {
+  for (std::array<int64_t, 3> dims : std::vector<std::array<int64_t, 3>>{
+           {1, 1, 1}, {1, 2, 1}, {1, 7, 1}, {3, 4, 5}, {2, 5, 3}, {1, 1000, 1},
+           {10, 9, 1}, {1, 4, 300}}) {
+    ExpectThreeFry<uint8_t>({42, 7}, dims[0], dims[1], dims[2]);
+    ExpectThreeFry<uint16_t>({42, 7}, dims[0], dims[1], dims[2]);
+    ExpectThreeFry<uint32_t>({42, 7}, dims[0], dims[1], dims[2]);
+    ExpectThreeFry<uint64_t>({42, 7}, dims[0], dims[1], dims[2]);
+  }
+  ExpectThreeFry<uint32_t>({42, ~uint64_t{0} - 5}, 1, 100, 1);
+}
+
+// Generates range(0) 32-bit values with Philox.
+void BM_PhiloxU32(::testing::benchmark::State& state) {
+  const int64_t num_elements = state.range(0);
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  std::vector<uint32_t> out(num_elements);
+  std::vector<uint64_t> rng_state = {42, 0, 0};
+  for (auto s : state) {
+    __xla_cpu_runtime_PhiloxBitGenerator(&run_options, rng_state.data(), 3,
+                                         rng_state.data(), 32, num_elements,
+                                         out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * num_elements * sizeof(uint32_t));
+}
+
+BENCHMARK(BM_PhiloxU32)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
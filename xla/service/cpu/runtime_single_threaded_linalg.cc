@@ -0,0 +1,62 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_single_threaded_linalg.h"
+
+#include "absl/base/dynamic_annotations.h"
+#include "xla/service/cpu/runtime_linalg_impl.h"
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void
+__xla_cpu_runtime_EigenSingleThreadedCholesky(const void* run_options_ptr,
+                                              void* out, void* a,
+                                              int32_t element_type,
+                                              int64_t batch, int64_t n,
+                                              int32_t lower) {
+  xla::EigenCholeskyImpl(Eigen::DefaultDevice(), out, a,
+                         static_cast<xla::internal::LinalgType>(element_type),
+                         batch, n, static_cast<bool>(lower));
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void
+__xla_cpu_runtime_EigenSingleThreadedTriangularSolve(
+    const void* run_options_ptr, void* out, void* a, void* b,
+    int32_t element_type, int64_t batch, int64_t m, int64_t n,
+    int32_t left_side, int32_t lower, int32_t unit_diagonal,
+    int32_t transpose_a) {
+  xla::EigenTriangularSolveImpl(
+      Eigen::DefaultDevice(), out, a, b,
+      static_cast<xla::internal::LinalgType>(element_type), batch, m, n,
+      static_cast<bool>(left_side), static_cast<bool>(lower),
+      static_cast<bool>(unit_diagonal),
+      static_cast<xla::internal::LinalgTranspose>(transpose_a));
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_EigenSingleThreadedQr(
+    const void* run_options_ptr, void* out, void* taus, void* a,
+    int32_t element_type, int64_t batch, int64_t m, int64_t n) {
+  xla::EigenQrImpl(Eigen::DefaultDevice(), out, taus, a,
+                   static_cast<xla::internal::LinalgType>(element_type), batch,
+                   m, n);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void
+__xla_cpu_runtime_EigenSingleThreadedEigh(const void* run_options_ptr, void* v,
+                                          void* w, void* a,
+                                          int32_t element_type, int64_t batch,
+                                          int64_t n, int32_t lower) {
+  xla::EigenEighImpl(Eigen::DefaultDevice(), v, w, a,
+                     static_cast<xla::internal::LinalgType>(element_type),
+                     batch, n, static_cast<bool>(lower));
+}
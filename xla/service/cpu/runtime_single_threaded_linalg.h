@@ -0,0 +1,47 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_RUNTIME_SINGLE_THREADED_LINALG_H_
+#define XLA_SERVICE_CPU_RUNTIME_SINGLE_THREADED_LINALG_H_
+
+#include <stdint.h>
+
+extern "C" {
+
+// Single-threaded versions of the functions in runtime_linalg.h.
+
+extern void __xla_cpu_runtime_EigenSingleThreadedCholesky(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* out,
+    void* a, int32_t element_type, int64_t batch, int64_t n, int32_t lower);
+
+extern void __xla_cpu_runtime_EigenSingleThreadedTriangularSolve(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* out,
+    void* a, void* b, int32_t element_type, int64_t batch, int64_t m, int64_t n,
+    int32_t left_side, int32_t lower, int32_t unit_diagonal,
+    int32_t transpose_a);
+
+extern void __xla_cpu_runtime_EigenSingleThreadedQr(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* out,
+    void* taus, void* a, int32_t element_type, int64_t batch, int64_t m,
+    int64_t n);
+
+extern void __xla_cpu_runtime_EigenSingleThreadedEigh(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* v,
+    void* w, void* a, int32_t element_type, int64_t batch, int64_t n,
+    int32_t lower);
+
+}  // extern "C"
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_SINGLE_THREADED_LINALG_H_
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "absl/base/attributes.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/service/cpu/runtime_mixed_precision_matmul_impl.h"
 
 #if defined(TENSORFLOW_USE_CUSTOM_CONTRACTION_KERNEL)
 #include "tsl/framework/contraction/eigen_contraction_kernel.h"
@@ -139,3 +140,21 @@ __xla_cpu_runtime_EigenSingleThreadedMatMulS32(const void* run_options_ptr,
   SingleThreadedMatMulDispatch<int32_t>(run_options_ptr, out, lhs, rhs, m, n, k,
                                         transpose_lhs, transpose_rhs);
 }
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void
+__xla_cpu_runtime_EigenSingleThreadedMatMulS8S32(
+    const void* run_options_ptr, int32_t* out, int8_t* lhs, int8_t* rhs,
+    int64_t m, int64_t n, int64_t k, int32_t transpose_lhs,
+    int32_t transpose_rhs) {
+  xla::MixedPrecisionMatMulS8S32Impl(Eigen::DefaultDevice(), out, lhs, rhs, m,
+                                     n, k, transpose_lhs, transpose_rhs);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void
+__xla_cpu_runtime_EigenSingleThreadedMatMulBF16F32(
+    const void* run_options_ptr, float* out, Eigen::bfloat16* lhs,
+    Eigen::bfloat16* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs) {
+  xla::MixedPrecisionMatMulBF16F32Impl(Eigen::DefaultDevice(), out, lhs, rhs,
+                                       m, n, k, transpose_lhs, transpose_rhs);
+}
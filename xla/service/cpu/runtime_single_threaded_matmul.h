@@ -59,6 +59,18 @@ extern void __xla_cpu_runtime_EigenSingleThreadedMatMulS32(
     int32_t* lhs, int32_t* rhs, int64_t m, int64_t n, int64_t k,
     int32_t transpose_lhs, int32_t transpose_rhs);
 
+// Mixed-precision variants, whose operands are narrower than the result. See
+// runtime_mixed_precision_matmul_impl.h.
+extern void __xla_cpu_runtime_EigenSingleThreadedMatMulS8S32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, int32_t* out,
+    int8_t* lhs, int8_t* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs);
+
+extern void __xla_cpu_runtime_EigenSingleThreadedMatMulBF16F32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* out,
+    Eigen::bfloat16* lhs, Eigen::bfloat16* rhs, int64_t m, int64_t n,
+    int64_t k, int32_t transpose_lhs, int32_t transpose_rhs);
+
 }  // extern "C"
 
 #endif  // XLA_SERVICE_CPU_RUNTIME_SINGLE_THREADED_MATMUL_H_
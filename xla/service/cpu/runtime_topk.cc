@@ -15,61 +15,183 @@ limitations under the License.
 
 #include "xla/service/cpu/runtime_topk.h"
 
+#define EIGEN_USE_THREADS
+
 #include <algorithm>
 #include <cstring>
 #include <limits>
-#include <memory>
-#include <numeric>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "absl/base/dynamic_annotations.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+
+namespace {
+
+// Signed integer type that TopK compares values of type T as.
+template <typename T>
+using TopKKey = std::conditional_t<sizeof(T) == 8, int64_t, int32_t>;
+
+// Maps 'value' to an integer that orders the same way. For floating point
+// types this enforces a total order of -NaN < -Inf < -0 < +0 < +Inf < +NaN.
+template <typename T>
+TopKKey<T> ToTopKKey(T value) {
+  if constexpr (std::is_integral_v<T>) {
+    return value;
+  } else {
+    using Signed =
+        std::conditional_t<sizeof(T) == 8, int64_t,
+                           std::conditional_t<sizeof(T) == 4, int32_t,
+                                              int16_t>>;
+    Signed x;
+    std::memcpy(&x, &value, sizeof(x));
+    return x < 0 ? x ^ std::numeric_limits<Signed>::max() : x;
+  }
+}
+
+template <typename T>
+struct TopKEntry {
+  TopKKey<T> key;
+  int32_t index;
+};
 
+// Whether 'a' comes before 'b' in the output: larger keys first, ties broken
+// in favor of the smaller index. This is a strict total order, so every
+// selection strategy below produces the same result.
 template <typename T>
-static void TopK(int64_t batch_size, int64_t input_size, int64_t k,
-                 const T* values, T* out_values, int32_t* out_indices) {
+bool Precedes(const TopKEntry<T>& a, const TopKEntry<T>& b) {
+  return a.key > b.key || (a.key == b.key && a.index < b.index);
+}
+
+// Selects the top 'k' entries of 'values_batch' with a heap of the best 'k'
+// entries seen so far. Most inputs are rejected by a single comparison with
+// the worst entry of the heap, so this is the fast path for small 'k'.
+template <typename T>
+void TopKWithHeap(int64_t input_size, int64_t k, const T* values_batch,
+                  std::vector<TopKEntry<T>>& entries) {
+  entries.clear();
+  for (int64_t i = 0; i < k; ++i) {
+    entries.push_back({ToTopKKey(values_batch[i]), static_cast<int32_t>(i)});
+  }
+  // With Precedes as the comparator the front of the heap is the worst entry.
+  std::make_heap(entries.begin(), entries.end(), Precedes<T>);
+  for (int64_t i = k; i < input_size; ++i) {
+    TopKKey<T> key = ToTopKKey(values_batch[i]);
+    // Later inputs have larger indices and so lose ties.
+    if (key <= entries.front().key) {
+      continue;
+    }
+    std::pop_heap(entries.begin(), entries.end(), Precedes<T>);
+    entries.back() = {key, static_cast<int32_t>(i)};
+    std::push_heap(entries.begin(), entries.end(), Precedes<T>);
+  }
+  std::sort_heap(entries.begin(), entries.end(), Precedes<T>);
+}
+
+// Selects the top 'k' entries of 'values_batch' by partitioning all of them
+// around the 'k'-th one and sorting the ones before it.
+template <typename T>
+void TopKWithSelection(int64_t input_size, int64_t k, const T* values_batch,
+                       std::vector<TopKEntry<T>>& entries) {
+  entries.resize(input_size);
+  for (int64_t i = 0; i < input_size; ++i) {
+    entries[i] = {ToTopKKey(values_batch[i]), static_cast<int32_t>(i)};
+  }
+  std::nth_element(entries.begin(), entries.begin() + k, entries.end(),
+                   Precedes<T>);
+  std::sort(entries.begin(), entries.begin() + k, Precedes<T>);
+}
+
+template <typename T>
+void TopK(const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+          int64_t k, const T* values, T* out_values, int32_t* out_indices) {
   // 'values' is managed by the JIT code, so msan can't tell they are
   // initialized.
   ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values,
                                       input_size * batch_size * sizeof(T));
+  if (k == 0) {
+    return;
+  }
+
+  // The heap only pays off while it stays small compared to the input.
+  const bool use_heap = k * 8 <= input_size;
+  auto top_k_batches = [&](int64_t begin, int64_t end) {
+    std::vector<TopKEntry<T>> entries;
+    entries.reserve(use_heap ? k : input_size);
+    for (int64_t batch = begin; batch != end; ++batch) {
+      const T* values_batch = values + batch * input_size;
+      if (use_heap) {
+        TopKWithHeap(input_size, k, values_batch, entries);
+      } else {
+        TopKWithSelection(input_size, k, values_batch, entries);
+      }
 
-  std::vector<int32_t> temp_indices(input_size);
-  for (int64_t batch = 0; batch != batch_size; ++batch) {
-    std::iota(temp_indices.begin(), temp_indices.end(), 0);
-
-    const T* values_batch = values + batch * input_size;
-
-    auto convert_to_int = [](T value) {
-      uint32_t x;
-      std::memcpy(&x, &value, sizeof(x));
-      return static_cast<int32_t>(x) < 0
-                 ? std::numeric_limits<int32_t>::max() - x
-                 : x;
-    };
-
-    auto kth_element = temp_indices.begin() + k;
-    std::partial_sort(temp_indices.begin(), kth_element, temp_indices.end(),
-                      [&](size_t i1, size_t i2) {
-                        // Do the comparison in integers to enforce a total
-                        // order of -NaN < -Inf < -0 < +0 < +Inf < +NaN.
-                        int32_t v1 = convert_to_int(values_batch[i1]);
-                        int32_t v2 = convert_to_int(values_batch[i2]);
-                        if (v1 == v2) {
-                          return i1 < i2;  // Stabilize sorting.
-                        }
-                        return v1 > v2;
-                      });
-
-    T* out_values_batch = out_values + batch * k;
-    int32_t* out_indices_batch = out_indices + batch * k;
-    std::copy(temp_indices.begin(), kth_element, out_indices_batch);
-    for (int64_t i = 0; i < k; i++) {
-      out_values_batch[i] = values_batch[temp_indices[i]];
+      T* out_values_batch = out_values + batch * k;
+      int32_t* out_indices_batch = out_indices + batch * k;
+      for (int64_t i = 0; i < k; i++) {
+        out_indices_batch[i] = entries[i].index;
+        out_values_batch[i] = values_batch[entries[i].index];
+      }
     }
+  };
+
+  const Eigen::ThreadPoolDevice* device =
+      run_options_ptr == nullptr
+          ? nullptr
+          : static_cast<const xla::ExecutableRunOptions*>(run_options_ptr)
+                ->intra_op_thread_pool();
+  if (device == nullptr || batch_size <= 1) {
+    top_k_batches(0, batch_size);
+    return;
   }
+  double bytes_per_batch = input_size * sizeof(T);
+  double cycles_per_batch = use_heap ? input_size * 2.0 : input_size * 10.0;
+  device->parallelFor(
+      batch_size,
+      Eigen::TensorOpCost(bytes_per_batch, k * (sizeof(T) + sizeof(int32_t)),
+                          cycles_per_batch),
+      [&](Eigen::Index begin, Eigen::Index end) { top_k_batches(begin, end); });
 }
 
+}  // namespace
+
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKF32(
-    int64_t batch_size, int64_t input_size, int64_t k, const float* values,
-    float* out_values, int32_t* out_indices) {
-  TopK(batch_size, input_size, k, values, out_values, out_indices);
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const float* values, float* out_values, int32_t* out_indices) {
+  TopK(run_options_ptr, batch_size, input_size, k, values, out_values,
+       out_indices);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKF64(
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const double* values, double* out_values,
+    int32_t* out_indices) {
+  TopK(run_options_ptr, batch_size, input_size, k, values, out_values,
+       out_indices);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKF16(
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const Eigen::half* values, Eigen::half* out_values,
+    int32_t* out_indices) {
+  TopK(run_options_ptr, batch_size, input_size, k, values, out_values,
+       out_indices);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKBF16(
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const Eigen::bfloat16* values, Eigen::bfloat16* out_values,
+    int32_t* out_indices) {
+  TopK(run_options_ptr, batch_size, input_size, k, values, out_values,
+       out_indices);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKS32(
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const int32_t* values, int32_t* out_values,
+    int32_t* out_indices) {
+  TopK(run_options_ptr, batch_size, input_size, k, values, out_values,
+       out_indices);
 }
@@ -18,13 +18,41 @@ limitations under the License.
 
 #include <stdint.h>
 
+#include "Eigen/Core"  // from @eigen_archive
+
 extern "C" {
 
 // Calculates `batch_size` topk operations with `input_size` inputs each. The
-// outputs are written to `out_values` and `out_indices`.
-extern void __xla_cpu_runtime_TopKF32(int64_t batch_size, int64_t input_size,
-                                      int64_t k, const float* values,
-                                      float* out_values, int32_t* out_indices);
+// outputs are written to `out_values` and `out_indices`. Values are ordered
+// from largest to smallest, with floating point values compared in the total
+// order -NaN < -Inf < -0 < +0 < +Inf < +NaN, and ties broken in favor of the
+// smaller index. Batches are spread over the intra-op thread pool of
+// `run_options_ptr`.
+extern void __xla_cpu_runtime_TopKF32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    int64_t batch_size, int64_t input_size, int64_t k, const float* values,
+    float* out_values, int32_t* out_indices);
+
+extern void __xla_cpu_runtime_TopKF64(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    int64_t batch_size, int64_t input_size, int64_t k, const double* values,
+    double* out_values, int32_t* out_indices);
+
+extern void __xla_cpu_runtime_TopKF16(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    int64_t batch_size, int64_t input_size, int64_t k,
+    const Eigen::half* values, Eigen::half* out_values, int32_t* out_indices);
+
+extern void __xla_cpu_runtime_TopKBF16(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    int64_t batch_size, int64_t input_size, int64_t k,
+    const Eigen::bfloat16* values, Eigen::bfloat16* out_values,
+    int32_t* out_indices);
+
+extern void __xla_cpu_runtime_TopKS32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    int64_t batch_size, int64_t input_size, int64_t k, const int32_t* values,
+    int32_t* out_values, int32_t* out_indices);
 }
 
 #endif  // XLA_SERVICE_CPU_RUNTIME_TOPK_H_
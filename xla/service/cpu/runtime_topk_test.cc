@@ -0,0 +1,144 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "xla/service/cpu/runtime_topk.h"
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+template <typename T>
+using TopKFunction = void (*)(const void*, int64_t, int64_t, int64_t, const T*,
+                              T*, int32_t*);
+
+// Checks `top_k` against a stable sort of every batch of `values`, which must
+// not contain NaNs or negative zeros.
+template <typename T>
+void ExpectTopKMatchesStableSort(TopKFunction<T> top_k, int64_t batch_size,
+                                 int64_t input_size, int64_t k,
+                                 const std::vector<T>& values,
+                                 const ExecutableRunOptions* run_options) {
+  std::vector<T> out_values(batch_size * k);
+  std::vector<int32_t> out_indices(batch_size * k);
+  top_k(run_options, batch_size, input_size, k, values.data(),
+        out_values.data(), out_indices.data());
+  for (int64_t batch = 0; batch < batch_size; ++batch) {
+    const T* batch_values = values.data() + batch * input_size;
+    std::vector<int32_t> expected(input_size);
+    std::iota(expected.begin(), expected.end(), 0);
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](int32_t a, int32_t b) {
+                       return batch_values[a] > batch_values[b];
+                     });
+    for (int64_t i = 0; i < k; ++i) {
+      ASSERT_EQ(out_indices[batch * k + i], expected[i])
+          << "batch " << batch << " position " << i << " k " << k;
+      ASSERT_EQ(out_values[batch * k + i], batch_values[expected[i]]);
+    }
+  }
+}
+
+template <typename T>
+std::vector<T> RandomValues(int64_t size) {
+  // Few distinct values, so that there are many ties.
+  std::minstd_rand0 generator(size);
+  std::uniform_int_distribution<int> distribution(-100, 100);
+  std::vector<T> values(size);
+  for (T& value : values) {
+    value = static_cast<T>(distribution(generator) / 4.0f);
+  }
+  return values;
+}
+
+template <typename T>
+void TestAllTopKPaths(TopKFunction<T> top_k) {
+  constexpr int64_t kBatchSize = 7;
+  constexpr int64_t kInputSize = 400;
+  std::vector<T> values = RandomValues<T>(kBatchSize * kInputSize);
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  // Small k takes the heap path, large k the selection path.
+  for (int64_t k : {1, 5, 50, 300, 400}) {
+    ExpectTopKMatchesStableSort(top_k, kBatchSize, kInputSize, k, values,
+                                &run_options);
+  }
+}
+
+TEST(RuntimeTopKTest, F32) { TestAllTopKPaths(__xla_cpu_runtime_TopKF32); }
+TEST(RuntimeTopKTest, F64) { TestAllTopKPaths(__xla_cpu_runtime_TopKF64); }
+TEST(RuntimeTopKTest, F16) { TestAllTopKPaths(__xla_cpu_runtime_TopKF16); }
+TEST(RuntimeTopKTest, BF16) { TestAllTopKPaths(__xla_cpu_runtime_TopKBF16); }
+TEST(RuntimeTopKTest, S32) { TestAllTopKPaths(__xla_cpu_runtime_TopKS32); }
+
+TEST(RuntimeTopKTest, F32TotalOrder) {
+  const float kNaN = std::numeric_limits<float>::quiet_NaN();
+  const float kInf = std::numeric_limits<float>::infinity();
+  std::vector<float> values = {-0.0f, 1.0f, kNaN, 0.0f, -kInf, -kNaN};
+  std::vector<float> out_values(values.size());
+  std::vector<int32_t> out_indices(values.size());
+  __xla_cpu_runtime_TopKF32(/*run_options_ptr=*/nullptr, 1, values.size(),
+                            values.size(), values.data(), out_values.data(),
+                            out_indices.data());
+  EXPECT_EQ(out_indices, (std::vector<int32_t>{2, 1, 3, 0, 4, 5}));
+}
+
+// Runs range(0) batches of 2^16 F32 values with k = range(1).
+void BM_TopKF32(::testing::benchmark::State& state) {
+  const int64_t batch_size = state.range(0);
+  const int64_t input_size = 1 << 16;
+  const int64_t k = state.range(1);
+  std::minstd_rand0 generator(0);
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  std::vector<float> values(batch_size * input_size);
+  for (float& value : values) {
+    value = distribution(generator);
+  }
+  std::vector<float> out_values(batch_size * k);
+  std::vector<int32_t> out_indices(batch_size * k);
+
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  for (auto s : state) {
+    __xla_cpu_runtime_TopKF32(&run_options, batch_size, input_size, k,
+                              values.data(), out_values.data(),
+                              out_indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size * input_size);
+}
+
+BENCHMARK(BM_TopKF32)
+    ->ArgsProduct({{1, 16, 128}, {1, 8, 64, 1024, 16384}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
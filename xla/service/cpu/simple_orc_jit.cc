@@ -21,6 +21,7 @@ limitations under the License.
 #include <cstdio>
 #include <list>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
@@ -39,17 +40,21 @@ limitations under the License.
 #include "xla/service/cpu/runtime_conv2d_mkl.h"
 #include "xla/service/cpu/runtime_conv3d.h"
 #include "xla/service/cpu/runtime_custom_call_status.h"
+#include "xla/service/cpu/runtime_direct_conv.h"
 #include "xla/service/cpu/runtime_fft.h"
 #include "xla/service/cpu/runtime_fork_join.h"
 #include "xla/service/cpu/runtime_fp16.h"
 #include "xla/service/cpu/runtime_key_value_sort.h"
+#include "xla/service/cpu/runtime_linalg.h"
 #include "xla/service/cpu/runtime_matmul.h"
 #include "xla/service/cpu/runtime_matmul_acl.h"
 #include "xla/service/cpu/runtime_matmul_mkl.h"
 #include "xla/service/cpu/runtime_pow.h"
+#include "xla/service/cpu/runtime_rng_bit_generator.h"
 #include "xla/service/cpu/runtime_single_threaded_conv2d.h"
 #include "xla/service/cpu/runtime_single_threaded_conv3d.h"
 #include "xla/service/cpu/runtime_single_threaded_fft.h"
+#include "xla/service/cpu/runtime_single_threaded_linalg.h"
 #include "xla/service/cpu/runtime_single_threaded_matmul.h"
 #include "xla/service/cpu/runtime_topk.h"
 #include "xla/service/cpu/windows_compatibility.h"
@@ -105,7 +110,8 @@ SimpleOrcJIT::SimpleOrcJIT(
     bool disable_expensive_passes, llvm::FastMathFlags fast_math_flags,
     LLVMCompiler::ModuleHook pre_optimization_hook,
     LLVMCompiler::ModuleHook post_optimization_hook,
-    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook)
+    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+    bool retain_obj_files)
     : target_machine_(InferTargetMachineForJIT(target_options, opt_level)),
       target_triple_(target_machine_->getTargetTriple()),
       data_layout_(target_machine_->createDataLayout()),
@@ -124,6 +130,7 @@ SimpleOrcJIT::SimpleOrcJIT(
               std::move(pre_optimization_hook),
               std::move(post_optimization_hook), std::move(post_codegen_hook))),
       main_jit_dylib_(&execution_session_->createBareJITDylib("<main>")),
+      retain_obj_files_(retain_obj_files),
       gdb_jit_event_listener_(
           llvm::JITEventListener::createGDBRegistrationListener()),
       perf_jit_event_listener_(
@@ -181,7 +188,8 @@ llvm::Expected<std::unique_ptr<SimpleOrcJIT>> SimpleOrcJIT::Create(
     bool disable_expensive_passes, llvm::FastMathFlags fast_math_flags,
     LLVMCompiler::ModuleHook pre_optimization_hook,
     LLVMCompiler::ModuleHook post_optimization_hook,
-    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook) {
+    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+    bool retain_obj_files) {
   auto SSP = std::make_shared<llvm::orc::SymbolStringPool>();
   auto target_process_control =
       llvm::orc::SelfExecutorProcessControl::Create(std::move(SSP));
@@ -195,7 +203,8 @@ llvm::Expected<std::unique_ptr<SimpleOrcJIT>> SimpleOrcJIT::Create(
       std::move(*target_process_control), std::move(execution_session),
       target_options, opt_level, optimize_for_size, disable_expensive_passes,
       fast_math_flags, std::move(pre_optimization_hook),
-      std::move(post_optimization_hook), std::move(post_codegen_hook));
+      std::move(post_optimization_hook), std::move(post_codegen_hook),
+      retain_obj_files);
 }
 
 llvm::orc::ExecutorSymbolDef SimpleOrcJIT::ResolveRuntimeSymbol(
@@ -230,6 +239,9 @@ void SimpleOrcJIT::notifyObjectLoaded(
     const llvm::RuntimeDyld::LoadedObjectInfo& object_info) {
   gdb_jit_event_listener_->notifyObjectLoaded(key, object, object_info);
   size_of_generated_code_in_bytes_ += object.getData().size();
+  if (retain_obj_files_) {
+    obj_files_.emplace_back(object.getData());
+  }
 }
 
 void SimpleOrcJIT::notifyFreeingObject(llvm::JITEventListener::ObjectKey key) {
@@ -240,6 +252,11 @@ llvm::Error SimpleOrcJIT::AddModule(llvm::orc::ThreadSafeModule module) {
   return compile_layer_.add(*main_jit_dylib_, std::move(module));
 }
 
+llvm::Error SimpleOrcJIT::AddObjFile(
+    std::unique_ptr<llvm::MemoryBuffer> obj_file) {
+  return object_layer_.add(*main_jit_dylib_, std::move(obj_file));
+}
+
 void SimpleOrcJIT::DoneCompiling() {
   // The target machine takes a non-trivial amount of memory, so once we are
   // done compiling throw it away.
@@ -280,6 +297,8 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(AllReduce);
   REGISTER_CPU_RUNTIME_SYMBOL(CollectivePermute);
   REGISTER_CPU_RUNTIME_SYMBOL(AllToAll);
+  REGISTER_CPU_RUNTIME_SYMBOL(AllGather);
+  REGISTER_CPU_RUNTIME_SYMBOL(ReduceScatter);
   REGISTER_CPU_RUNTIME_SYMBOL(PartitionId);
   REGISTER_CPU_RUNTIME_SYMBOL(ReplicaId);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLConv2DF32);
@@ -287,13 +306,25 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(EigenConv2DF32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenConv3DF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenConv3DF32);
+  REGISTER_CPU_RUNTIME_SYMBOL(DirectConvF16);
+  REGISTER_CPU_RUNTIME_SYMBOL(DirectConvF32);
+  REGISTER_CPU_RUNTIME_SYMBOL(DirectConvS8S32);
+  REGISTER_CPU_RUNTIME_SYMBOL(DirectConvS8S8);
+  REGISTER_CPU_RUNTIME_SYMBOL(PhiloxBitGenerator);
+  REGISTER_CPU_RUNTIME_SYMBOL(ThreeFryBitGenerator);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenFft);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenCholesky);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenTriangularSolve);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenQr);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenEigh);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulF64);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulC64);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulC128);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulS32);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulS8S32);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulBF16F32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenBatchMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLMatMulF64);
@@ -307,19 +338,30 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedConv3DF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedConv3DF32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedFft);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedCholesky);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedTriangularSolve);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedQr);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedEigh);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulF64);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulC64);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulC128);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulS32);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulS8S32);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulBF16F32);
   REGISTER_CPU_RUNTIME_SYMBOL(ParallelForkJoin);
   REGISTER_CPU_RUNTIME_SYMBOL(PrintfToStderr);
   REGISTER_CPU_RUNTIME_SYMBOL(ReleaseInfeedBufferAfterDequeue);
   REGISTER_CPU_RUNTIME_SYMBOL(ReleaseOutfeedBufferAfterPopulation);
   REGISTER_CPU_RUNTIME_SYMBOL(StatusIsSuccess);
   REGISTER_CPU_RUNTIME_SYMBOL(KeyValueSort);
+  REGISTER_CPU_RUNTIME_SYMBOL(KeyValueRadixSort);
   REGISTER_CPU_RUNTIME_SYMBOL(TopKF32);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKF64);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKF16);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKBF16);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKS32);
   REGISTER_CPU_RUNTIME_SYMBOL(TracingStart);
   REGISTER_CPU_RUNTIME_SYMBOL(TracingEnd);
 
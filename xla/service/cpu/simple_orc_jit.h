@@ -27,6 +27,7 @@ limitations under the License.
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/SymbolStringPool.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/TargetParser/Triple.h"
 #include "xla/service/cpu/compiler_functor.h"
@@ -61,7 +62,8 @@ class SimpleOrcJIT : public llvm::JITEventListener {
       bool disable_expensive_passes, llvm::FastMathFlags fast_math_flags,
       LLVMCompiler::ModuleHook pre_optimization_hook,
       LLVMCompiler::ModuleHook post_optimization_hook,
-      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook);
+      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+      bool retain_obj_files);
 
   static llvm::Expected<std::unique_ptr<SimpleOrcJIT>> Create(
       const llvm::TargetOptions& target_options,
@@ -69,7 +71,8 @@ class SimpleOrcJIT : public llvm::JITEventListener {
       bool disable_expensive_passes, llvm::FastMathFlags fast_math_flags,
       LLVMCompiler::ModuleHook pre_optimization_hook,
       LLVMCompiler::ModuleHook post_optimization_hook,
-      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook);
+      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+      bool retain_obj_files);
 
   ~SimpleOrcJIT() override;
 
@@ -79,6 +82,11 @@ class SimpleOrcJIT : public llvm::JITEventListener {
 
   llvm::Error AddModule(llvm::orc::ThreadSafeModule module);
 
+  // Adds an object file that was already compiled for target_machine(), e.g.
+  // one shard of a module that was split and compiled in parallel. Objects can
+  // reference each other's symbols, including hidden ones.
+  llvm::Error AddObjFile(std::unique_ptr<llvm::MemoryBuffer> obj_file);
+
   // Discards objects we no longer need once we are done compiling.
   void DoneCompiling();
 
@@ -99,6 +107,13 @@ class SimpleOrcJIT : public llvm::JITEventListener {
     return size_of_generated_code_in_bytes_;
   }
 
+  // Relocatable object files that were loaded into the JIT, in load order.
+  // Loading them into another SimpleOrcJIT for the same target reproduces the
+  // compiled code, which is what executable serialization relies on. Only
+  // recorded if the JIT was created with `retain_obj_files`.
+  bool retains_obj_files() const { return retain_obj_files_; }
+  const std::vector<std::string>& obj_files() const { return obj_files_; }
+
  private:
   llvm::orc::ExecutorSymbolDef ResolveRuntimeSymbol(llvm::StringRef name);
 
@@ -117,6 +132,8 @@ class SimpleOrcJIT : public llvm::JITEventListener {
   CompileLayerT compile_layer_;
   llvm::orc::JITDylib* main_jit_dylib_;
   int64_t size_of_generated_code_in_bytes_ = 0;
+  const bool retain_obj_files_;
+  std::vector<std::string> obj_files_;
 
   // Non owning pointer to a JIT event listener that registers the JIT events
   // with an attached GDB.
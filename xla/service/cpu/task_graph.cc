@@ -0,0 +1,171 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/task_graph.h"
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/service/custom_call_status_internal.h"
+#include "xla/util.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// The state of one run of a task graph. Workers on the thread pool share
+// ownership, so that the state outlives the last of them.
+struct RunState {
+  RunState(const TaskGraph& graph, absl::Span<const TaskFunction> functions,
+           const ExecutableRunOptions* run_options, void** buffer_table)
+      : graph(graph),
+        functions(functions),
+        run_options(run_options),
+        buffer_table(buffer_table),
+        statuses(graph.tasks.size()),
+        pending_predecessors(graph.tasks.size()),
+        num_unfinished(graph.tasks.size()) {
+    const Eigen::ThreadPoolDevice* pool = run_options->intra_op_thread_pool();
+    max_workers = pool == nullptr ? 0 : std::max(pool->numThreads() - 1, 0);
+    for (int64_t i = 0; i < graph.tasks.size(); ++i) {
+      pending_predecessors[i] = graph.tasks[i].num_predecessors;
+      if (pending_predecessors[i] == 0) {
+        ready.push_back(i);
+      }
+    }
+    // Tasks are taken from the back; start with the first one in program
+    // order.
+    std::reverse(ready.begin(), ready.end());
+  }
+
+  // Returns true once the caller of RunTaskGraph can return.
+  bool Done() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    return (num_unfinished == 0 || (failed && num_running == 0)) &&
+           num_workers == 0;
+  }
+
+  const TaskGraph& graph;
+  const absl::Span<const TaskFunction> functions;
+  const ExecutableRunOptions* const run_options;
+  void** const buffer_table;
+  int max_workers;
+
+  // Written by the thread that runs the task.
+  std::vector<XlaCustomCallStatus> statuses;
+
+  absl::Mutex mu;
+  std::vector<int64_t> pending_predecessors ABSL_GUARDED_BY(mu);
+  // Tasks whose predecessors have all run.
+  std::vector<int64_t> ready ABSL_GUARDED_BY(mu);
+  int64_t num_unfinished ABSL_GUARDED_BY(mu);
+  int64_t num_running ABSL_GUARDED_BY(mu) = 0;
+  // Workers scheduled on the thread pool that have not exited yet.
+  int num_workers ABSL_GUARDED_BY(mu) = 0;
+  bool failed ABSL_GUARDED_BY(mu) = false;
+};
+
+void Work(std::shared_ptr<RunState> state, bool is_caller);
+
+// Schedules workers for the ready tasks that the current thread won't run.
+void MaybeAddWorkers(const std::shared_ptr<RunState>& state)
+    ABSL_EXCLUSIVE_LOCKS_REQUIRED(state->mu) {
+  int64_t num_new_workers =
+      std::min<int64_t>(state->ready.size(),
+                        state->max_workers - state->num_workers);
+  for (int64_t i = 0; i < num_new_workers; ++i) {
+    ++state->num_workers;
+    state->run_options->intra_op_thread_pool()->enqueueNoNotification(
+        [state]() { Work(state, /*is_caller=*/false); });
+  }
+}
+
+// Runs ready tasks. Workers on the thread pool exit when there are none; the
+// caller of RunTaskGraph waits for more until the graph is done.
+void Work(std::shared_ptr<RunState> state, bool is_caller) {
+  RunState& s = *state;
+  auto can_continue = [&s, is_caller]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(s.mu) {
+    return (!s.failed && !s.ready.empty()) || !is_caller || s.Done();
+  };
+  std::optional<int64_t> finished;
+  while (true) {
+    int64_t task;
+    {
+      absl::MutexLock lock(&s.mu);
+      if (finished.has_value()) {
+        --s.num_running;
+        --s.num_unfinished;
+        if (CustomCallStatusGetMessage(&s.statuses[*finished]).has_value()) {
+          s.failed = true;
+        }
+        for (int64_t successor : s.graph.tasks[*finished].successors) {
+          if (--s.pending_predecessors[successor] == 0) {
+            s.ready.push_back(successor);
+          }
+        }
+      }
+      s.mu.Await(absl::Condition(&can_continue));
+      if (s.failed || s.ready.empty()) {
+        if (!is_caller) {
+          --s.num_workers;
+        }
+        return;
+      }
+      task = s.ready.back();
+      s.ready.pop_back();
+      ++s.num_running;
+      MaybeAddWorkers(state);
+    }
+    VLOG(3) << "Running task " << task << ": "
+            << s.graph.tasks[task].function_name;
+    s.functions[task](/*result=*/nullptr, s.run_options, /*args=*/nullptr,
+                      s.buffer_table, &s.statuses[task],
+                      /*profile_counters=*/nullptr);
+    finished = task;
+  }
+}
+
+}  // namespace
+
+Status RunTaskGraph(const TaskGraph& graph,
+                    absl::Span<const TaskFunction> functions,
+                    const ExecutableRunOptions* run_options,
+                    void** buffer_table) {
+  CHECK_EQ(graph.tasks.size(), functions.size());
+  auto state =
+      std::make_shared<RunState>(graph, functions, run_options, buffer_table);
+  Work(state, /*is_caller=*/true);
+
+  // Report the failure of the first task in program order, like a sequential
+  // execution would.
+  for (const XlaCustomCallStatus& status : state->statuses) {
+    if (std::optional<absl::string_view> error_message =
+            CustomCallStatusGetMessage(&status)) {
+      return InternalError("CustomCall failed: %s", *error_message);
+    }
+  }
+  return OkStatus();
+}
+
+}  // namespace cpu
+}  // namespace xla
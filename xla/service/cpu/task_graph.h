@@ -0,0 +1,72 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_TASK_GRAPH_H_
+#define XLA_SERVICE_CPU_TASK_GRAPH_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "xla/executable_run_options.h"
+#include "xla/service/custom_call_status.h"
+#include "xla/status.h"
+
+namespace xla {
+namespace cpu {
+
+// The entry computation of a CPU executable as a graph of tasks, see
+// TaskOutliner. Each task is a compiled function with the signature of
+// CpuExecutable::ComputeFunctionType that reads and writes the buffer table
+// only.
+struct TaskGraph {
+  struct Task {
+    // The symbol of the compiled function.
+    std::string function_name;
+
+    // The tasks that can only run after this one.
+    std::vector<int64_t> successors;
+
+    int64_t num_predecessors = 0;
+  };
+
+  // In a topological order.
+  std::vector<Task> tasks;
+};
+
+using TaskFunction = void (*)(void* /*result*/,
+                              const ExecutableRunOptions* /*run_options*/,
+                              const void** /*args*/, void** /*buffer_table*/,
+                              XlaCustomCallStatus* /*status*/,
+                              int64_t* /*profile_counters*/);
+
+// Runs the tasks of `graph`, where task i calls `functions[i]`, and returns
+// once all of them have run or one of them has failed.
+//
+// Ready tasks run on the calling thread and on up to n - 1 threads of the
+// intra-op thread pool of `run_options`, which has n threads: the tasks
+// themselves block on work they hand to that pool, so one of its threads must
+// remain free. A thread that completes a task continues with one of the tasks
+// that became ready, and leaves the others to idle threads.
+Status RunTaskGraph(const TaskGraph& graph,
+                    absl::Span<const TaskFunction> functions,
+                    const ExecutableRunOptions* run_options,
+                    void** buffer_table);
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_TASK_GRAPH_H_
@@ -0,0 +1,165 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/task_graph.h"
+
+#define EIGEN_USE_THREADS
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/service/custom_call_status.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// The tasks of the tests find this through the first entry of the buffer
+// table.
+struct Log {
+  absl::Mutex mu;
+  std::vector<int64_t> finished ABSL_GUARDED_BY(mu);
+  int64_t num_started ABSL_GUARDED_BY(mu) = 0;
+  // If set, each task waits for this many tasks to start before it finishes.
+  int64_t wait_for_started = 0;
+  // The task that fails, if any.
+  int64_t failing_task = -1;
+  // Set if a task gave up waiting for the others to start.
+  bool timed_out ABSL_GUARDED_BY(mu) = false;
+
+  bool AllStarted() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    return num_started >= wait_for_started;
+  }
+};
+
+template <int64_t kTask>
+void RunTask(void* /*result*/, const ExecutableRunOptions* /*run_options*/,
+             const void** /*args*/, void** buffer_table,
+             XlaCustomCallStatus* status, int64_t* /*profile_counters*/) {
+  Log& log = *static_cast<Log*>(buffer_table[0]);
+  absl::MutexLock lock(&log.mu);
+  ++log.num_started;
+  if (!log.mu.AwaitWithTimeout(absl::Condition(&log, &Log::AllStarted),
+                               absl::Seconds(10))) {
+    log.timed_out = true;
+  }
+  if (kTask == log.failing_task) {
+    const char kMessage[] = "task failed";
+    XlaCustomCallStatusSetFailure(status, kMessage, strlen(kMessage));
+  }
+  log.finished.push_back(kTask);
+}
+
+constexpr TaskFunction kTaskFunctions[] = {
+    RunTask<0>, RunTask<1>, RunTask<2>, RunTask<3>, RunTask<4>, RunTask<5>};
+
+// Returns a graph of `num_tasks` tasks with the given edges.
+TaskGraph MakeGraph(int64_t num_tasks,
+                    std::vector<std::pair<int64_t, int64_t>> edges) {
+  TaskGraph graph;
+  graph.tasks.resize(num_tasks);
+  for (int64_t i = 0; i < num_tasks; ++i) {
+    graph.tasks[i].function_name = absl::StrCat("task", i);
+  }
+  for (auto [from, to] : edges) {
+    graph.tasks[from].successors.push_back(to);
+    ++graph.tasks[to].num_predecessors;
+  }
+  return graph;
+}
+
+class TaskGraphTest : public ::testing::Test {
+ protected:
+  TaskGraphTest() : pool_(4), device_(&pool_, pool_.NumThreads()) {
+    run_options_.set_intra_op_thread_pool(&device_);
+  }
+
+  Status Run(const TaskGraph& graph, Log* log) {
+    void* buffer_table[] = {log};
+    return RunTaskGraph(
+        graph, absl::MakeConstSpan(kTaskFunctions, graph.tasks.size()),
+        &run_options_, buffer_table);
+  }
+
+  Eigen::ThreadPool pool_;
+  Eigen::ThreadPoolDevice device_;
+  ExecutableRunOptions run_options_;
+};
+
+TEST_F(TaskGraphTest, RunsTasksAfterTheirPredecessors) {
+  // A diamond followed by a chain.
+  TaskGraph graph =
+      MakeGraph(6, {{0, 1}, {0, 2}, {1, 3}, {2, 3}, {3, 4}, {4, 5}});
+  for (int iteration = 0; iteration < 100; ++iteration) {
+    Log log;
+    TF_ASSERT_OK(Run(graph, &log));
+    absl::MutexLock lock(&log.mu);
+    ASSERT_EQ(log.finished.size(), 6);
+    EXPECT_EQ(log.finished[0], 0);
+    EXPECT_THAT(std::vector<int64_t>(log.finished.begin() + 1,
+                                     log.finished.begin() + 3),
+                ::testing::UnorderedElementsAre(1, 2));
+    EXPECT_THAT(std::vector<int64_t>(log.finished.begin() + 3,
+                                     log.finished.end()),
+                ::testing::ElementsAre(3, 4, 5));
+  }
+}
+
+TEST_F(TaskGraphTest, RunsIndependentTasksConcurrently) {
+  // The calling thread and three of the four threads of the pool can run
+  // tasks; each task waits until all of them have started.
+  TaskGraph graph = MakeGraph(4, {});
+  Log log;
+  log.wait_for_started = 4;
+  TF_ASSERT_OK(Run(graph, &log));
+  absl::MutexLock lock(&log.mu);
+  EXPECT_FALSE(log.timed_out);
+  EXPECT_THAT(log.finished, ::testing::UnorderedElementsAre(0, 1, 2, 3));
+}
+
+TEST_F(TaskGraphTest, RunsOnCallingThreadWithoutThreadPool) {
+  TaskGraph graph = MakeGraph(3, {{0, 2}, {1, 2}});
+  run_options_.set_intra_op_thread_pool(nullptr);
+  Log log;
+  TF_ASSERT_OK(Run(graph, &log));
+  absl::MutexLock lock(&log.mu);
+  EXPECT_THAT(log.finished, ::testing::ElementsAre(0, 1, 2));
+}
+
+TEST_F(TaskGraphTest, StopsAtFailure) {
+  TaskGraph graph = MakeGraph(4, {{0, 1}, {1, 2}, {2, 3}});
+  Log log;
+  log.failing_task = 1;
+  Status status = Run(graph, &log);
+  EXPECT_FALSE(status.ok());
+  EXPECT_THAT(status.message(), ::testing::HasSubstr("task failed"));
+  absl::MutexLock lock(&log.mu);
+  EXPECT_THAT(log.finished, ::testing::ElementsAre(0, 1));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,148 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/task_outliner.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/hlo_query.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns true if `instruction` must run in the same order relative to other
+// such instructions as in a sequential execution, e.g. because other devices
+// wait for its collectives in that order.
+bool IsOrdered(const HloInstruction* instruction) {
+  return instruction->HasSideEffect() ||
+         hlo_query::IsCollectiveCommunicationOp(instruction->opcode());
+}
+
+}  // namespace
+
+StatusOr<bool> TaskOutliner::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  HloComputation* entry = module->entry_computation();
+  std::vector<HloInstruction*> post_order = entry->MakeInstructionPostOrder();
+
+  // Partition the instructions into chains. An operand joins the chain of its
+  // user if that user is its only successor, so that the chain has a single
+  // output and contracting it cannot create a cycle.
+  std::vector<std::vector<HloInstruction*>> chains;
+  absl::flat_hash_map<const HloInstruction*, int64_t> chain_of;
+  for (HloInstruction* instruction : post_order) {
+    if (instruction->opcode() == HloOpcode::kParameter) {
+      continue;
+    }
+    int64_t chain = -1;
+    for (const HloInstruction* operand : instruction->operands()) {
+      auto it = chain_of.find(operand);
+      if (it != chain_of.end() && operand->user_count() == 1 &&
+          operand->control_successors().empty() &&
+          operand != entry->root_instruction()) {
+        chain = it->second;
+        break;
+      }
+    }
+    if (chain < 0) {
+      chain = chains.size();
+      chains.emplace_back();
+    }
+    chains[chain].push_back(instruction);
+    chain_of[instruction] = chain;
+  }
+  if (chains.empty()) {
+    return false;
+  }
+
+  // Only the last instruction of a chain has successors outside of it, so
+  // ordering the chains by their last instruction is a topological order.
+  absl::flat_hash_map<const HloInstruction*, int64_t> position;
+  for (int64_t i = 0; i < post_order.size(); ++i) {
+    position[post_order[i]] = i;
+  }
+  std::vector<int64_t> chain_order(chains.size());
+  for (int64_t i = 0; i < chains.size(); ++i) {
+    chain_order[i] = i;
+  }
+  absl::c_sort(chain_order, [&](int64_t a, int64_t b) {
+    return position[chains[a].back()] < position[chains[b].back()];
+  });
+
+  // Outlining drops control dependencies; record them by chain, or for
+  // parameters by instruction, and add them back between the calls.
+  using Endpoint = std::pair<HloInstruction*, int64_t>;
+  auto endpoint = [&](HloInstruction* instruction) -> Endpoint {
+    auto it = chain_of.find(instruction);
+    return it == chain_of.end() ? Endpoint(instruction, -1)
+                                : Endpoint(nullptr, it->second);
+  };
+  std::vector<std::pair<Endpoint, Endpoint>> control_edges;
+  for (HloInstruction* instruction : post_order) {
+    for (HloInstruction* successor : instruction->control_successors()) {
+      control_edges.emplace_back(endpoint(instruction), endpoint(successor));
+    }
+  }
+  for (HloInstruction* instruction : post_order) {
+    TF_RETURN_IF_ERROR(instruction->DropAllControlDeps());
+  }
+
+  std::vector<HloInstruction*> calls(chains.size());
+  HloInstruction* last_ordered_call = nullptr;
+  for (int64_t chain : chain_order) {
+    const bool ordered = absl::c_any_of(chains[chain], IsOrdered);
+    calls[chain] = module->OutlineExpressionFromComputation(
+        chains[chain], absl::StrCat(chains[chain].back()->name(), ".task"),
+        entry);
+    if (ordered) {
+      if (last_ordered_call != nullptr) {
+        TF_RETURN_IF_ERROR(
+            last_ordered_call->AddControlDependencyTo(calls[chain]));
+      }
+      last_ordered_call = calls[chain];
+    }
+  }
+
+  auto resolve = [&](const Endpoint& endpoint) {
+    return endpoint.first != nullptr ? endpoint.first : calls[endpoint.second];
+  };
+  for (const auto& [from, to] : control_edges) {
+    HloInstruction* from_instruction = resolve(from);
+    HloInstruction* to_instruction = resolve(to);
+    if (from_instruction != to_instruction) {
+      TF_RETURN_IF_ERROR(
+          from_instruction->AddControlDependencyTo(to_instruction));
+    }
+  }
+
+  VLOG(2) << "Outlined " << chain_of.size() << " instructions of "
+          << entry->name() << " into " << chains.size() << " tasks";
+  return true;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,55 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_TASK_OUTLINER_H_
+#define XLA_SERVICE_CPU_TASK_OUTLINER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+#include "xla/statusor.h"
+
+namespace xla {
+namespace cpu {
+
+// Outlines every instruction of the entry computation other than parameters
+// into a kCall of its own embedded computation, which the IrEmitter compiles to
+// its own function. Each call is a task of the executable's task graph: the
+// tasks run concurrently once their operands and control predecessors have
+// run, see task_graph.h.
+//
+// To keep the number of tasks down, chains of instructions are outlined
+// together: an instruction whose only user is the next instruction of the
+// chain joins that user's task. Each user takes at most one such operand, so
+// independent producers of a join still run in parallel.
+//
+// This runs after copy insertion. Outlining preserves the HLO values, so the
+// buffer assignment needs no new copies; it must however use an ordering that
+// allows concurrency, e.g. DependencyHloOrdering.
+class TaskOutliner : public HloModulePass {
+ public:
+  absl::string_view name() const override { return "cpu-task-outliner"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_TASK_OUTLINER_H_
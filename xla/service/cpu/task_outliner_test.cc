@@ -0,0 +1,167 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/task_outliner.h"
+
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/hlo/utils/hlo_matchers.h"
+#include "xla/test.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+namespace op = ::xla::testing::opcode_matchers;
+
+using TaskOutlinerTest = HloTestBase;
+
+TEST_F(TaskOutlinerTest, OutlinesChainIntoOneTask) {
+  const char* const hlo_string = R"(
+    HloModule OutlinesChainIntoOneTask
+    ENTRY main {
+      p0 = f32[16] parameter(0)
+      negate = f32[16] negate(p0)
+      ROOT exp = f32[16] exponential(negate)
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskOutliner().Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Call(op::Parameter(0)));
+  EXPECT_THAT(root->to_apply()->root_instruction(),
+              op::Exp(op::Negate(op::Parameter(0))));
+}
+
+TEST_F(TaskOutlinerTest, KeepsIndependentProducersApart) {
+  const char* const hlo_string = R"(
+    HloModule KeepsIndependentProducersApart
+    ENTRY main {
+      p0 = f32[16] parameter(0)
+      p1 = f32[16] parameter(1)
+      negate = f32[16] negate(p0)
+      exp = f32[16] exponential(p1)
+      ROOT add = f32[16] add(negate, exp)
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskOutliner().Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  // The add joins the task of its first operand; the exponential runs in a
+  // task of its own.
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Call(op::Parameter(0), op::Call(op::Parameter(1))));
+  EXPECT_THAT(root->to_apply()->root_instruction(),
+              op::Add(op::Negate(op::Parameter(0)), op::Parameter(1)));
+}
+
+TEST_F(TaskOutlinerTest, DoesNotMergeOperandWithSeveralUsers) {
+  const char* const hlo_string = R"(
+    HloModule DoesNotMergeOperandWithSeveralUsers
+    ENTRY main {
+      p0 = f32[16] parameter(0)
+      negate = f32[16] negate(p0)
+      exp = f32[16] exponential(negate)
+      log = f32[16] log(negate)
+      ROOT tuple = (f32[16], f32[16]) tuple(exp, log)
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskOutliner().Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  // The negate is shared by the tasks of the exponential and the log.
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  ASSERT_THAT(root, op::Call(op::Call(op::Parameter(0)),
+                             op::Call(op::Call(op::Parameter(0)))));
+  EXPECT_EQ(root->operand(1)->operand(0), root->operand(0));
+  for (const HloInstruction* instruction :
+       module->entry_computation()->instructions()) {
+    EXPECT_THAT(instruction, ::testing::AnyOf(op::Parameter(), op::Call()));
+  }
+}
+
+TEST_F(TaskOutlinerTest, OrdersSideEffectingTasks) {
+  const char* const hlo_string = R"(
+    HloModule OrdersSideEffectingTasks
+    ENTRY main {
+      p0 = f32[16] parameter(0)
+      p1 = f32[16] parameter(1)
+      first = f32[16] custom-call(p0), custom_call_target="first",
+        custom_call_has_side_effect=true
+      ROOT second = f32[16] custom-call(p1), custom_call_target="second",
+        custom_call_has_side_effect=true
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskOutliner().Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  // The tasks share no data, but one of them must still run after the other.
+  HloInstruction* second = module->entry_computation()->root_instruction();
+  ASSERT_THAT(second, op::Call(op::Parameter(1)));
+  HloInstruction* first = nullptr;
+  for (HloInstruction* instruction :
+       module->entry_computation()->instructions()) {
+    if (instruction->opcode() == HloOpcode::kCall && instruction != second) {
+      first = instruction;
+    }
+  }
+  ASSERT_THAT(first, op::Call(op::Parameter(0)));
+  EXPECT_EQ(first->control_predecessors().size() +
+                second->control_predecessors().size(),
+            1);
+  EXPECT_TRUE(first->control_predecessors().empty()
+                  ? second->control_predecessors()[0] == first
+                  : first->control_predecessors()[0] == second);
+}
+
+TEST_F(TaskOutlinerTest, KeepsControlDependencies) {
+  const char* const hlo_string = R"(
+    HloModule KeepsControlDependencies
+    ENTRY main {
+      p0 = f32[16] parameter(0)
+      p1 = f32[16] parameter(1)
+      negate = f32[16] negate(p0)
+      exp = f32[16] exponential(p1), control-predecessors={negate}
+      ROOT add = f32[16] add(negate, exp)
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskOutliner().Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  // The negate has a control successor, so it stays out of the task of the
+  // add, which inherits the control dependency of the exponential.
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  ASSERT_THAT(root, op::Call(op::Parameter(1), op::Call(op::Parameter(0))));
+  EXPECT_THAT(root->control_predecessors(),
+              ::testing::ElementsAre(root->operand(1)));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,148 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/hlo/ir/hlo_reachability.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/service/compiler.h"
+#include "xla/service/cpu/cpu_executable.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/executable.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// The dot, the sort and the reduce are independent of each other, so they are
+// outlined into tasks that can run concurrently. The shapes are small enough
+// for the ParallelTaskAssigner to leave the ops alone, which would otherwise
+// keep the entry computation from running as a task graph.
+constexpr char kHloText[] = R"(
+HloModule InterOpParallelism
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT sum = f32[] add(a, b)
+}
+
+less {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT lt = pred[] compare(a, b), direction=LT
+}
+
+ENTRY main {
+  x = f32[32,32] parameter(0)
+  y = f32[32,32] parameter(1)
+  d = f32[32,32] dot(x, y), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  t = f32[32,32] tanh(d)
+  s = f32[32,32] sort(y), dimensions={1}, to_apply=less
+  c = f32[] constant(0)
+  r = f32[32] reduce(x, c), dimensions={1}, to_apply=add
+  b = f32[32,32] broadcast(r), dimensions={0}
+  ts = f32[32,32] add(t, s)
+  out = f32[32,32] add(ts, b)
+  ROOT tuple = (f32[32,32], f32[32,32]) tuple(out, d)
+}
+)";
+
+class CpuInterOpParallelismTest : public CpuCodegenTest {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = CpuCodegenTest::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_enable_inter_op_parallelism(true);
+    return debug_options;
+  }
+};
+
+// The test runner has an intra-op thread pool, so the executable runs its
+// tasks with RunTaskGraph.
+TEST_F(CpuInterOpParallelismTest, MatchesInterpreter) {
+  EXPECT_TRUE(RunAndCompare(kHloText, ErrorSpec{1e-4, 1e-4}));
+}
+
+TEST_F(CpuInterOpParallelismTest, ConcurrentTasksDoNotShareBuffers) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHloText));
+  Compiler::CompileOptions options;
+  Compiler* compiler = backend().compiler();
+  se::StreamExecutor* executor = backend().default_stream_executor();
+  TF_ASSERT_OK_AND_ASSIGN(
+      module, compiler->RunHloPasses(std::move(module), executor, options));
+  // Creating the executable looks the task functions up in the JIT, which
+  // fails unless they were emitted with external linkage.
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<Executable> executable,
+      compiler->RunBackend(std::move(module), executor, options));
+  auto* cpu_executable = static_cast<CpuExecutable*>(executable.get());
+  ASSERT_TRUE(cpu_executable->has_task_graph());
+
+  const HloComputation* entry = cpu_executable->module().entry_computation();
+  std::vector<const HloInstruction*> calls;
+  for (const HloInstruction* instruction : entry->instructions()) {
+    if (instruction->opcode() != HloOpcode::kParameter) {
+      ASSERT_EQ(instruction->opcode(), HloOpcode::kCall)
+          << instruction->ToString();
+      calls.push_back(instruction);
+    }
+  }
+
+  // Buffer assignment orders the tasks by their dependencies only, so it must
+  // not reuse a buffer between two tasks that may run at the same time.
+  const BufferAssignment& assignment = cpu_executable->buffer_assignment();
+  auto slices_of = [&](const HloInstruction* call) {
+    std::set<BufferAllocation::Slice> slices;
+    ShapeUtil::ForEachSubshape(
+        call->shape(), [&](const Shape& /*subshape*/, const ShapeIndex& index) {
+          std::set<BufferAllocation::Slice> index_slices =
+              assignment.GetAllSlices(call, index);
+          slices.insert(index_slices.begin(), index_slices.end());
+        });
+    return slices;
+  };
+  std::unique_ptr<HloReachabilityMap> reachability =
+      HloReachabilityMap::Build(entry);
+  int concurrent_pairs = 0;
+  for (size_t i = 0; i < calls.size(); ++i) {
+    for (size_t j = i + 1; j < calls.size(); ++j) {
+      if (reachability->IsConnected(calls[i], calls[j])) {
+        continue;
+      }
+      ++concurrent_pairs;
+      for (const BufferAllocation::Slice& a : slices_of(calls[i])) {
+        for (const BufferAllocation::Slice& b : slices_of(calls[j])) {
+          EXPECT_FALSE(a.OverlapsWith(b))
+              << calls[i]->name() << " and " << calls[j]->name()
+              << " share " << a.ToString();
+        }
+      }
+    }
+  }
+  EXPECT_GT(concurrent_pairs, 0);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
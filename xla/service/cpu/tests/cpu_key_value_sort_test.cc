@@ -43,7 +43,79 @@ ENTRY main {
 )";
 
   std::string filecheck_pattern = R"(
-CHECK: call void @__xla_cpu_runtime_KeyValueSort
+CHECK: call void @__xla_cpu_runtime_KeyValueRadixSort
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+
+  CpuAotCompilationOptions options{
+      /*triple=*/kTargetTripleForHost, /*cpu_name=*/kTargetCpuForHost,
+      /*features=*/"",
+      /*entry_point_name=*/"entry",
+      /*relocation_model=*/CpuAotCompilationOptions::RelocationModel::Static};
+
+  CompileAheadOfTimeAndVerifyIr(std::move(module), options, filecheck_pattern,
+                                /*match_optimized_ir=*/true);
+}
+
+TEST_F(CpuKeyValueSortTest, SortR1WithCustomComparator) {
+  const std::string hlo_text = R"(
+HloModule KeyValueSort
+
+compare {
+  p.0.lhs = f32[] parameter(0)
+  p.0.rhs = f32[] parameter(1)
+  lhs.abs = f32[] abs(p.0.lhs)
+  rhs.abs = f32[] abs(p.0.rhs)
+  ROOT lt = pred[] compare(lhs.abs, rhs.abs), direction=LT
+}
+
+ENTRY main {
+  a = f32[10] parameter(0)
+
+  ROOT result = f32[10] sort(f32[10] a), dimensions={0}, to_apply=compare
+}
+)";
+
+  std::string filecheck_pattern = R"(
+CHECK: call void @__xla_cpu_runtime_KeyValueSort(
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+
+  CpuAotCompilationOptions options{
+      /*triple=*/kTargetTripleForHost, /*cpu_name=*/kTargetCpuForHost,
+      /*features=*/"",
+      /*entry_point_name=*/"entry",
+      /*relocation_model=*/CpuAotCompilationOptions::RelocationModel::Static};
+
+  CompileAheadOfTimeAndVerifyIr(std::move(module), options, filecheck_pattern,
+                                /*match_optimized_ir=*/true);
+}
+
+TEST_F(CpuKeyValueSortTest, ArgSortDescending) {
+  const std::string hlo_text = R"(
+HloModule KeyValueSort
+
+compare {
+  p.0.lhs = s32[] parameter(0)
+  p.0.rhs = s32[] parameter(1)
+  p.1.lhs = s32[] parameter(2)
+  p.1.rhs = s32[] parameter(3)
+  ROOT gt = pred[] compare(p.0.lhs, p.0.rhs), direction=GT
+}
+
+ENTRY main {
+  keys = s32[4,1000] parameter(0)
+  iota = s32[4,1000] iota(), iota_dimension=1
+
+  ROOT result = (s32[4,1000], s32[4,1000]) sort(keys, iota), dimensions={1},
+      to_apply=compare
+}
+)";
+
+  std::string filecheck_pattern = R"(
+CHECK: call void @__xla_cpu_runtime_KeyValueRadixSort(i64 4, i64 1000, i64 1, {{.*}}, i32 2, {{.*}}, i32 4, i1 true, i1 true
 )";
 
   TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
@@ -0,0 +1,117 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class CpuLinalgTest : public CpuCodegenTest {
+ protected:
+  void CompileAndCheck(const std::string& hlo_text,
+                       const std::string& filecheck_pattern) {
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(hlo_text));
+    CompileAndVerifyIr(std::move(module), filecheck_pattern,
+                       /*match_optimized_ir=*/false);
+  }
+};
+
+TEST_F(CpuLinalgTest, Cholesky) {
+  CompileAndCheck(R"(
+HloModule Cholesky
+
+ENTRY main {
+  a = f32[4,16,16] parameter(0)
+  ROOT cholesky = f32[4,16,16] cholesky(a), lower=true
+}
+)",
+                  R"(
+CHECK-NOT: while
+CHECK: call void @__xla_cpu_runtime_Eigen{{(SingleThreaded)?}}Cholesky(ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, i32 11, i64 4, i64 16, i32 1)
+)");
+}
+
+TEST_F(CpuLinalgTest, TriangularSolve) {
+  CompileAndCheck(R"(
+HloModule TriangularSolve
+
+ENTRY main {
+  a = f64[8,8] parameter(0)
+  b = f64[8,3] parameter(1)
+  ROOT solve = f64[8,3] triangular-solve(a, b), left_side=true, lower=false,
+      unit_diagonal=true, transpose_a=TRANSPOSE
+}
+)",
+                  R"(
+CHECK-NOT: while
+CHECK: call void @__xla_cpu_runtime_Eigen{{(SingleThreaded)?}}TriangularSolve(ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, i32 12, i64 1, i64 8, i64 3, i32 1, i32 0, i32 1, i32 2)
+)");
+}
+
+TEST_F(CpuLinalgTest, Qr) {
+  CompileAndCheck(R"(
+HloModule Qr
+
+ENTRY main {
+  a = c64[2,6,4] parameter(0)
+  ROOT qr = (c64[2,6,4], c64[2,4]) custom-call(a), custom_call_target="Qr"
+}
+)",
+                  R"(
+CHECK-NOT: while
+CHECK: call void @__xla_cpu_runtime_Eigen{{(SingleThreaded)?}}Qr(ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, i32 15, i64 2, i64 6, i64 4)
+)");
+}
+
+TEST_F(CpuLinalgTest, Eigh) {
+  CompileAndCheck(R"(
+HloModule Eigh
+
+ENTRY main {
+  a = f32[5,5] parameter(0)
+  ROOT eigh = (f32[5,5], f32[5]) custom-call(a), custom_call_target="Eigh",
+      backend_config="0,1,15,0.000001"
+}
+)",
+                  R"(
+CHECK-NOT: while
+CHECK: call void @__xla_cpu_runtime_Eigen{{(SingleThreaded)?}}Eigh(ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, i32 11, i64 1, i64 5, i32 0)
+)");
+}
+
+TEST_F(CpuLinalgTest, UnsupportedTypeIsExpanded) {
+  CompileAndCheck(R"(
+HloModule Cholesky
+
+ENTRY main {
+  a = f16[16,16] parameter(0)
+  ROOT cholesky = f16[16,16] cholesky(a), lower=true
+}
+)",
+                  R"(
+CHECK-NOT: Cholesky
+)");
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
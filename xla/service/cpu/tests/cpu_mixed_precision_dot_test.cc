@@ -0,0 +1,91 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Tests that s8 and bf16 dots call the mixed-precision runtime matmuls instead
+// of upcasting their operands.
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class CpuMixedPrecisionDotTest : public CpuCodegenTest {
+ protected:
+  void CompileAndCheck(const std::string& hlo_text,
+                       const std::string& filecheck_pattern) {
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(hlo_text));
+    CompileAndVerifyIr(std::move(module), filecheck_pattern,
+                       /*match_optimized_ir=*/false);
+  }
+};
+
+TEST_F(CpuMixedPrecisionDotTest, S8DotWithS32Result) {
+  CompileAndCheck(R"(
+HloModule S8Dot
+
+ENTRY main {
+  a = s8[64,128] parameter(0)
+  b = s8[128,96] parameter(1)
+  ROOT dot = s32[64,96] dot(a, b), lhs_contracting_dims={1},
+      rhs_contracting_dims={0}
+}
+)",
+                  R"(
+CHECK: call void @__xla_cpu_runtime_Eigen{{(SingleThreaded)?}}MatMulS8S32(ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, i64 96, i64 64, i64 128, i32 0, i32 0)
+)");
+}
+
+TEST_F(CpuMixedPrecisionDotTest, BF16Dot) {
+  CompileAndCheck(R"(
+HloModule BF16Dot
+
+ENTRY main {
+  a = bf16[64,128] parameter(0)
+  b = bf16[128,96] parameter(1)
+  ROOT dot = bf16[64,96] dot(a, b), lhs_contracting_dims={1},
+      rhs_contracting_dims={0}
+}
+)",
+                  R"(
+CHECK: call void @__xla_cpu_runtime_Eigen{{(SingleThreaded)?}}MatMulBF16F32(ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, i64 96, i64 64, i64 128, i32 0, i32 0)
+)");
+}
+
+TEST_F(CpuMixedPrecisionDotTest, S8MatrixVectorDotIsUpcast) {
+  CompileAndCheck(R"(
+HloModule S8MatrixVectorDot
+
+ENTRY main {
+  a = s8[64,128] parameter(0)
+  b = s8[128] parameter(1)
+  ROOT dot = s32[64] dot(a, b), lhs_contracting_dims={1},
+      rhs_contracting_dims={0}
+}
+)",
+                  R"(
+CHECK-NOT: MatMulS8S32
+)");
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
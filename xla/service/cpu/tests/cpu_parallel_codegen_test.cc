@@ -0,0 +1,119 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <utility>
+
+#include "xla/service/compilation_stats.h"
+#include "xla/service/compiler.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// The sort comparator is called through a function pointer, so it can be
+// compiled in a different shard from the entry computation. The small reducer
+// stays in the shard of its caller.
+constexpr char kHloText[] = R"(
+HloModule ParallelCodegen
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT sum = f32[] add(a, b)
+}
+
+less {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT lt = pred[] compare(a, b), direction=LT
+}
+
+cond {
+  p = (s32[], f32[64,64]) parameter(0)
+  i = s32[] get-tuple-element(p), index=0
+  n = s32[] constant(4)
+  ROOT lt = pred[] compare(i, n), direction=LT
+}
+
+body {
+  p = (s32[], f32[64,64]) parameter(0)
+  i = s32[] get-tuple-element(p), index=0
+  x = f32[64,64] get-tuple-element(p), index=1
+  one = s32[] constant(1)
+  next = s32[] add(i, one)
+  d = f32[64,64] dot(x, x), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  scale = f32[] constant(0.125)
+  s = f32[64,64] broadcast(scale), dimensions={}
+  m = f32[64,64] multiply(d, s)
+  y = f32[64,64] tanh(m)
+  ROOT r = (s32[], f32[64,64]) tuple(next, y)
+}
+
+ENTRY main {
+  x = f32[64,64] parameter(0)
+  zero = s32[] constant(0)
+  init = (s32[], f32[64,64]) tuple(zero, x)
+  loop = (s32[], f32[64,64]) while(init), condition=cond, body=body
+  y = f32[64,64] get-tuple-element(loop), index=1
+  sorted = f32[64,64] sort(y), dimensions={1}, to_apply=less
+  c = f32[] constant(0)
+  reduced = f32[64] reduce(sorted, c), dimensions={1}, to_apply=add
+  ROOT out = (f32[64,64], f32[64]) tuple(sorted, reduced)
+}
+)";
+
+class CpuParallelCodegenTest : public CpuCodegenTest,
+                               public ::testing::WithParamInterface<int> {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = CpuCodegenTest::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_parallel_codegen_split_count(GetParam());
+    return debug_options;
+  }
+};
+
+TEST_P(CpuParallelCodegenTest, MatchesInterpreter) {
+  EXPECT_TRUE(RunAndCompare(kHloText, ErrorSpec{1e-4, 1e-4}));
+}
+
+TEST_P(CpuParallelCodegenTest, RecordsShardCompileTimes) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHloText));
+  std::unique_ptr<CompilationStats> compilation_stats =
+      CompilationStats::MakeStats();
+  Compiler::CompileOptions options;
+  options.compilation_stats = compilation_stats.get();
+  Compiler* compiler = backend().compiler();
+  se::StreamExecutor* executor = backend().default_stream_executor();
+  TF_ASSERT_OK_AND_ASSIGN(
+      module, compiler->RunHloPasses(std::move(module), executor, options));
+  TF_ASSERT_OK(
+      compiler->RunBackend(std::move(module), executor, options).status());
+  if (GetParam() > 1) {
+    EXPECT_GT(compilation_stats->GetPassesSize(), 1);
+  } else {
+    EXPECT_EQ(compilation_stats->GetPassesSize(), 0);
+  }
+}
+
+// 64 is more than the number of functions that can be compiled separately.
+INSTANTIATE_TEST_SUITE_P(SplitCounts, CpuParallelCodegenTest,
+                         ::testing::Values(1, 2, 64));
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,200 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "xla/literal.h"
+#include "xla/literal_util.h"
+#include "xla/service/cpu/ir_emission_utils.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/rng_bit_generator_expander.h"
+#include "xla/tests/literal_test_util.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class CpuRngBitGeneratorTest : public CpuCodegenTest {
+ protected:
+  void CompileAndCheck(const std::string& hlo_text,
+                       const std::string& filecheck_pattern) {
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(hlo_text));
+    CompileAndVerifyIr(std::move(module), filecheck_pattern,
+                       /*match_optimized_ir=*/false);
+  }
+};
+
+TEST_F(CpuRngBitGeneratorTest, Philox) {
+  CompileAndCheck(R"(
+HloModule Philox
+
+ENTRY main {
+  state = u64[3] parameter(0)
+  ROOT rng = (u64[3], u32[16,128]) rng-bit-generator(state),
+      algorithm=rng_philox
+}
+)",
+                  R"(
+CHECK-NOT: while
+CHECK: call void @__xla_cpu_runtime_PhiloxBitGenerator(ptr {{.*}}, ptr {{.*}}, i64 3, ptr {{.*}}, i64 32, i64 2048, ptr {{.*}})
+)");
+}
+
+TEST_F(CpuRngBitGeneratorTest, DefaultAlgorithmIsPhilox) {
+  CompileAndCheck(R"(
+HloModule Default
+
+ENTRY main {
+  state = u64[2] parameter(0)
+  ROOT rng = (u64[2], u64[7]) rng-bit-generator(state), algorithm=rng_default
+}
+)",
+                  R"(
+CHECK: call void @__xla_cpu_runtime_PhiloxBitGenerator(ptr {{.*}}, ptr {{.*}}, i64 2, ptr {{.*}}, i64 64, i64 7, ptr {{.*}})
+)");
+}
+
+TEST_F(CpuRngBitGeneratorTest, ThreeFrySplitsFirstEvenDimension) {
+  CompileAndCheck(R"(
+HloModule ThreeFry
+
+ENTRY main {
+  state = u64[2] parameter(0)
+  ROOT rng = (u64[2], u8[3,6,5]) rng-bit-generator(state),
+      algorithm=rng_three_fry
+}
+)",
+                  R"(
+CHECK-NOT: while
+CHECK: call void @__xla_cpu_runtime_ThreeFryBitGenerator(ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, i64 8, i64 3, i64 6, i64 5, ptr {{.*}})
+)");
+}
+
+TEST_F(CpuRngBitGeneratorTest, ThreeFrySplitsLargestOddDimension) {
+  CompileAndCheck(R"(
+HloModule ThreeFry
+
+ENTRY main {
+  state = u64[2] parameter(0)
+  ROOT rng = (u64[2], u16[3,7,5]) rng-bit-generator(state),
+      algorithm=rng_three_fry
+}
+)",
+                  R"(
+CHECK: call void @__xla_cpu_runtime_ThreeFryBitGenerator(ptr {{.*}}, ptr {{.*}}, ptr {{.*}}, i64 16, i64 3, i64 7, i64 5, ptr {{.*}})
+)");
+}
+
+struct ExpanderComparisonCase {
+  std::string algorithm;
+  std::vector<uint64_t> state;
+  std::string data_shape;
+};
+
+class CpuRngBitGeneratorExpanderTest
+    : public CpuCodegenTest,
+      public ::testing::WithParamInterface<ExpanderComparisonCase> {};
+
+// Runs the bit generator through the runtime kernels and through the HLO that
+// RngBitGeneratorExpander produces for it, which must agree bit for bit on
+// both the output state and the generated bits.
+TEST_P(CpuRngBitGeneratorExpanderTest, MatchesExpander) {
+  const ExpanderComparisonCase& param = GetParam();
+  const std::string hlo_text = absl::StrReplaceAll(
+      R"(
+HloModule RngBitGenerator
+
+ENTRY main {
+  state = u64[$state_size] parameter(0)
+  ROOT rng = (u64[$state_size], $data_shape) rng-bit-generator(state),
+      algorithm=$algorithm
+}
+)",
+      {{"$state_size", absl::StrCat(param.state.size())},
+       {"$data_shape", param.data_shape},
+       {"$algorithm", param.algorithm}});
+  TF_ASSERT_OK_AND_ASSIGN(auto native_module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  ASSERT_TRUE(CanEmitRngBitGeneratorAsRuntimeCall(
+      *native_module->entry_computation()->root_instruction()));
+
+  TF_ASSERT_OK_AND_ASSIGN(auto expanded_module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  RngBitGeneratorExpander expander(RandomAlgorithm::RNG_PHILOX);
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunHloPass(&expander, expanded_module.get()));
+  ASSERT_TRUE(changed);
+
+  Literal state = LiteralUtil::CreateR1<uint64_t>(param.state);
+  TF_ASSERT_OK_AND_ASSIGN(Literal native,
+                          Execute(std::move(native_module), {&state}));
+  TF_ASSERT_OK_AND_ASSIGN(Literal expanded,
+                          Execute(std::move(expanded_module), {&state}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expanded, native));
+}
+
+// The Philox states make the low word of the 128-bit counter wrap around.
+constexpr uint64_t kKey = 0x0123456789ABCDEF;
+constexpr uint64_t kAlmostWrapped = 0xFFFFFFFFFFFFFFF0;
+
+INSTANTIATE_TEST_SUITE_P(
+    Philox3, CpuRngBitGeneratorExpanderTest,
+    ::testing::Values(
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped, 7},
+                               "u8[7,13]"},
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped, 7},
+                               "u16[3,5,9]"},
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped, 7},
+                               "u32[1001]"},
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped, 7},
+                               "u64[3,11]"},
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped, 7},
+                               "u32[]"}));
+
+INSTANTIATE_TEST_SUITE_P(
+    Philox2, CpuRngBitGeneratorExpanderTest,
+    ::testing::Values(
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped}, "u8[255]"},
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped},
+                               "u16[6,7]"},
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped},
+                               "u32[17,3]"},
+        ExpanderComparisonCase{"rng_philox", {kKey, kAlmostWrapped}, "u64[5]"},
+        ExpanderComparisonCase{"rng_default", {kKey, 42}, "u32[33]"}));
+
+INSTANTIATE_TEST_SUITE_P(
+    ThreeFry, CpuRngBitGeneratorExpanderTest,
+    ::testing::Values(
+        ExpanderComparisonCase{"rng_three_fry", {kKey, 42}, "u8[2,3]"},
+        ExpanderComparisonCase{"rng_three_fry", {kKey, 42}, "u8[64,129]"},
+        ExpanderComparisonCase{"rng_three_fry", {kKey, 42}, "u16[7,5]"},
+        ExpanderComparisonCase{"rng_three_fry", {kKey, 42}, "u32[3,6,5]"},
+        ExpanderComparisonCase{"rng_three_fry", {kKey, 42}, "u32[5,1,3]"},
+        ExpanderComparisonCase{"rng_three_fry", {kKey, 42}, "u32[]"},
+        ExpanderComparisonCase{"rng_three_fry", {kKey, kAlmostWrapped},
+                               "u64[9,7]"}));
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
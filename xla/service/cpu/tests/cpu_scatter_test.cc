@@ -0,0 +1,232 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_replace.h"
+#include "absl/strings/string_view.h"
+#include "xla/array2d.h"
+#include "xla/array3d.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/literal.h"
+#include "xla/literal_util.h"
+#include "xla/service/cpu/backend_config.pb.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+using CpuScatterTest = CpuCodegenTest;
+
+TEST_F(CpuScatterTest, ScatterEmittedNatively) {
+  const std::string hlo_text = R"(
+HloModule Scatter
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY main {
+  operand = f32[100,4] parameter(0)
+  indices = s32[8] parameter(1)
+  updates = f32[8,4] parameter(2)
+  ROOT scatter = f32[100,4] scatter(operand, indices, updates),
+      to_apply=add, update_window_dims={1}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1
+}
+)";
+
+  // The scatter is emitted as a single loop nest over the updates rather than
+  // expanded into a while loop of dynamic-update-slices.
+  std::string filecheck_pattern = R"(
+CHECK-NOT: while
+CHECK: scatter.in_bounds-true
+CHECK-NOT: while
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+  CompileAndVerifyIr(std::move(module), filecheck_pattern,
+                     /*match_optimized_ir=*/false);
+}
+
+TEST_F(CpuScatterTest, VariadicScatterExpanded) {
+  const std::string hlo_text = R"(
+HloModule VariadicScatter
+
+add {
+  lhs.0 = f32[] parameter(0)
+  lhs.1 = f32[] parameter(1)
+  rhs.0 = f32[] parameter(2)
+  rhs.1 = f32[] parameter(3)
+  sum.0 = f32[] add(lhs.0, rhs.0)
+  sum.1 = f32[] add(lhs.1, rhs.1)
+  ROOT tuple = (f32[], f32[]) tuple(sum.0, sum.1)
+}
+
+ENTRY main {
+  operand.0 = f32[100,4] parameter(0)
+  operand.1 = f32[100,4] parameter(1)
+  indices = s32[8] parameter(2)
+  updates.0 = f32[8,4] parameter(3)
+  updates.1 = f32[8,4] parameter(4)
+  ROOT scatter = (f32[100,4], f32[100,4]) scatter(operand.0, operand.1,
+      indices, updates.0, updates.1), to_apply=add, update_window_dims={1},
+      inserted_window_dims={0}, scatter_dims_to_operand_dims={0},
+      index_vector_dim=1
+}
+)";
+
+  std::string filecheck_pattern = R"(
+CHECK-NOT: scatter.in_bounds
+CHECK: while
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+  CompileAndVerifyIr(std::move(module), filecheck_pattern,
+                     /*match_optimized_ir=*/false);
+}
+
+TEST_F(CpuScatterTest, WideIndicesOutOfBounds) {
+  const std::string hlo_text = R"(
+HloModule WideIndices
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY main {
+  operand = f32[100,4] parameter(0)
+  indices = s64[8] parameter(1)
+  updates = f32[8,2,4] parameter(2)
+  ROOT scatter = f32[100,4] scatter(operand, indices, updates),
+      to_apply=add, update_window_dims={1,2}, inserted_window_dims={},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1
+}
+)";
+
+  // Only 3 and 98 are in bounds. The others would be in bounds if they were
+  // truncated to 32 bits, and the window offset overflows for the largest.
+  Literal operand = LiteralUtil::CreateR2FromArray2D(Array2D<float>(100, 4));
+  Literal indices = LiteralUtil::CreateR1<int64_t>(
+      {3, int64_t{1} << 32, (int64_t{1} << 32) + 5, -(int64_t{1} << 32) + 7,
+       int64_t{1} << 31, std::numeric_limits<int64_t>::max(),
+       std::numeric_limits<int64_t>::min(), 98});
+  Array3D<float> update_values(8, 2, 4);
+  update_values.FillIota(1.0f);
+  Literal updates = LiteralUtil::CreateR3FromArray3D(update_values);
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+  EXPECT_TRUE(RunAndCompare(std::move(module), {&operand, &indices, &updates},
+                            /*error=*/std::nullopt));
+}
+
+// The operand of this scatter is large enough for it to be split into parallel
+// tasks by rows, each of which applies the updates landing in its own rows.
+constexpr char kPartitionedScatterHlo[] = R"(
+HloModule PartitionedScatter
+
+combiner {
+  lhs = s32[] parameter(0)
+  rhs = s32[] parameter(1)
+  ROOT result = s32[] $combiner
+}
+
+ENTRY main {
+  operand = s32[65536,8] parameter(0)
+  indices = s32[1024] parameter(1)
+  updates = s32[1024,8] parameter(2)
+  ROOT scatter = s32[65536,8] scatter(operand, indices, updates),
+      to_apply=combiner, update_window_dims={1}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1,
+      unique_indices=$unique_indices
+}
+)";
+
+class CpuPartitionedScatterTest : public CpuCodegenTest {
+ protected:
+  // Runs the scatter with the given combiner and row indices on the CPU and
+  // on the interpreter and compares the results.
+  void RunAndCompareScatter(absl::string_view combiner,
+                            const std::vector<int32_t>& row_indices,
+                            bool unique_indices) {
+    const std::string hlo_text = absl::StrReplaceAll(
+        kPartitionedScatterHlo,
+        {{"$combiner", combiner},
+         {"$unique_indices", unique_indices ? "true" : "false"}});
+
+    // The I/O bound scatter gets about the square root of the available
+    // threads, so only expect it to be partitioned if that is at least two.
+    TF_ASSERT_OK_AND_ASSIGN(auto optimized_module,
+                            GetOptimizedModule(hlo_text));
+    const HloInstruction* scatter =
+        FindInstruction(optimized_module.get(), HloOpcode::kScatter);
+    ASSERT_NE(scatter, nullptr);
+    TF_ASSERT_OK_AND_ASSIGN(BackendConfig backend_config,
+                            scatter->backend_config<BackendConfig>());
+    if (tsl::port::MaxParallelism() >= 4) {
+      EXPECT_GT(backend_config.outer_dimension_partitions_size(), 0);
+    }
+
+    Array2D<int32_t> operand_values(65536, 8);
+    operand_values.FillIota(0);
+    Array2D<int32_t> update_values(1024, 8);
+    update_values.FillIota(1);
+    Literal operand = LiteralUtil::CreateR2FromArray2D(operand_values);
+    Literal indices = LiteralUtil::CreateR1<int32_t>(row_indices);
+    Literal updates = LiteralUtil::CreateR2FromArray2D(update_values);
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(hlo_text));
+    EXPECT_TRUE(RunAndCompare(std::move(module),
+                              {&operand, &indices, &updates},
+                              /*error=*/std::nullopt));
+  }
+};
+
+TEST_F(CpuPartitionedScatterTest, DuplicateAndOutOfBoundsIndices) {
+  // Every row index appears twice, and some are negative or past the end.
+  std::vector<int32_t> row_indices;
+  for (int32_t i = 0; i < 1024; ++i) {
+    row_indices.push_back((i % 512) * 131 - 100);
+  }
+  RunAndCompareScatter("add(lhs, rhs)", row_indices,
+                       /*unique_indices=*/false);
+}
+
+TEST_F(CpuPartitionedScatterTest, UniqueAndOutOfBoundsIndices) {
+  // With unique indices, the combiner need not be commutative.
+  std::vector<int32_t> row_indices;
+  for (int32_t i = 0; i < 1024; ++i) {
+    row_indices.push_back(i * 67 - 100);
+  }
+  RunAndCompareScatter("subtract(lhs, rhs)", row_indices,
+                       /*unique_indices=*/true);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -41,7 +41,7 @@ TEST_F(CpuTopKTest, CallRuntimeUnbatched) {
       auto module, HloModule::CreateFromProto(xla_computation.proto(), config));
 
   constexpr char filecheck_pattern[] = R"(
-    CHECK: call void @__xla_cpu_runtime_TopKF32(i64 1, i64 100, i64 10,
+    CHECK: call void @__xla_cpu_runtime_TopKF32(ptr {{.*}}, i64 1, i64 100, i64 10,
   )";
 
   CpuAotCompilationOptions options{
@@ -68,7 +68,34 @@ TEST_F(CpuTopKTest, CallRuntimeBatched) {
       auto module, HloModule::CreateFromProto(xla_computation.proto(), config));
 
   constexpr char filecheck_pattern[] = R"(
-    CHECK: call void @__xla_cpu_runtime_TopKF32(i64 5, i64 100, i64 10,
+    CHECK: call void @__xla_cpu_runtime_TopKF32(ptr {{.*}}, i64 5, i64 100, i64 10,
+  )";
+
+  CpuAotCompilationOptions options{
+      /*triple=*/kTargetTripleForHost, /*cpu_name=*/kTargetCpuForHost,
+      /*features=*/"",
+      /*entry_point_name=*/"entry",
+      /*relocation_model=*/CpuAotCompilationOptions::RelocationModel::Static};
+
+  CompileAheadOfTimeAndVerifyIr(std::move(module), options, filecheck_pattern,
+                                /*match_optimized_ir=*/true);
+}
+
+TEST_F(CpuTopKTest, CallRuntimeBatchedS32) {
+  XlaBuilder builder(TestName());
+  XlaOp input =
+      Parameter(&builder, 0, ShapeUtil::MakeShape(S32, {5, 100}), "input");
+  TopK(input, 10);
+  TF_ASSERT_OK_AND_ASSIGN(XlaComputation xla_computation, builder.Build());
+
+  TF_ASSERT_OK_AND_ASSIGN(ProgramShape program_shape,
+                          xla_computation.GetProgramShape());
+  HloModuleConfig config(program_shape);
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module, HloModule::CreateFromProto(xla_computation.proto(), config));
+
+  constexpr char filecheck_pattern[] = R"(
+    CHECK: call void @__xla_cpu_runtime_TopKS32(ptr {{.*}}, i64 5, i64 100, i64 10,
   )";
 
   CpuAotCompilationOptions options{
@@ -24,9 +24,14 @@ limitations under the License.
 #include "absl/container/flat_hash_set.h"
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
 #include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/hlo/utils/hlo_matchers.h"
 #include "xla/literal.h"
+#include "xla/service/hlo_cse.h"
+#include "xla/service/hlo_dce.h"
+#include "xla/service/hlo_module_config.h"
+#include "xla/service/hlo_pass_pipeline.h"
 #include "xla/service/pattern_matcher.h"
 #include "xla/service/pattern_matcher_gmock.h"
 #include "xla/shape_util.h"
@@ -34,6 +39,7 @@ limitations under the License.
 #include "xla/test_helpers.h"
 #include "xla/tests/hlo_test_base.h"
 #include "tsl/platform/statusor.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 
@@ -753,5 +759,121 @@ TEST_F(HloComputationTest, ComparisonWithCustomComparator) {
   EXPECT_TRUE(comp_a->Equal(*comp_b, false, compare_func));
 }
 
+TEST_F(HloComputationTest, InstructionsAddedWhileIteratingAreVisited) {
+  auto builder = HloComputation::Builder(TestName());
+  auto param = builder.AddInstruction(
+      HloInstruction::CreateParameter(0, r0f32_, "param0"));
+  builder.AddInstruction(
+      HloInstruction::CreateUnary(r0f32_, HloOpcode::kNegate, param));
+  auto module = CreateNewVerifiedModule();
+  auto computation = module->AddEntryComputation(builder.Build());
+
+  std::vector<HloOpcode> visited;
+  for (HloInstruction* instruction : computation->instructions()) {
+    visited.push_back(instruction->opcode());
+    if (instruction->opcode() == HloOpcode::kNegate) {
+      computation->AddInstruction(
+          HloInstruction::CreateUnary(r0f32_, HloOpcode::kExp, instruction));
+    }
+  }
+  EXPECT_THAT(visited, ElementsAre(HloOpcode::kParameter, HloOpcode::kNegate,
+                                   HloOpcode::kExp));
+}
+
+TEST_F(HloComputationTest, RemovedInstructionsAreSkippedUntilCleanup) {
+  auto builder = HloComputation::Builder(TestName());
+  auto param = builder.AddInstruction(
+      HloInstruction::CreateParameter(0, r0f32_, "param0"));
+  auto dead = builder.AddInstruction(
+      HloInstruction::CreateUnary(r0f32_, HloOpcode::kNegate, param));
+  auto exp = builder.AddInstruction(
+      HloInstruction::CreateUnary(r0f32_, HloOpcode::kExp, param));
+  auto module = CreateNewVerifiedModule();
+  auto computation = module->AddEntryComputation(builder.Build());
+
+  std::vector<HloInstruction*> visited;
+  for (HloInstruction* instruction : computation->instructions()) {
+    visited.push_back(instruction);
+    if (instruction == param) {
+      TF_ASSERT_OK(computation->RemoveInstruction(dead));
+    }
+  }
+  EXPECT_THAT(visited, ElementsAre(param, exp));
+  EXPECT_EQ(computation->instruction_count(), 2);
+
+  auto log = computation->AddInstruction(
+      HloInstruction::CreateUnary(r0f32_, HloOpcode::kLog, param));
+  computation->Cleanup();
+  EXPECT_THAT(std::vector<HloInstruction*>(computation->instructions().begin(),
+                                           computation->instructions().end()),
+              ElementsAre(param, exp, log));
+
+  // The instructions moved by Cleanup can still be found and removed.
+  TF_ASSERT_OK(computation->RemoveInstruction(log));
+  EXPECT_EQ(computation->instruction_count(), 2);
+  EXPECT_EQ(computation->root_instruction(), exp);
+}
+
+// Builds a module of `num_blocks` blocks of four instructions: an add, a copy
+// of it for CSE to remove, a dead negate for DCE to remove and a multiply that
+// feeds the next block.
+std::unique_ptr<HloModule> MakeLargeModule(int64_t num_blocks) {
+  const Shape shape = ShapeUtil::MakeShape(F32, {16});
+  auto builder = HloComputation::Builder("entry");
+  HloInstruction* param =
+      builder.AddInstruction(HloInstruction::CreateParameter(0, shape, "p"));
+  HloInstruction* value = param;
+  for (int64_t i = 0; i < num_blocks; ++i) {
+    HloInstruction* add = builder.AddInstruction(
+        HloInstruction::CreateBinary(shape, HloOpcode::kAdd, value, param));
+    HloInstruction* duplicate = builder.AddInstruction(
+        HloInstruction::CreateBinary(shape, HloOpcode::kAdd, value, param));
+    builder.AddInstruction(
+        HloInstruction::CreateUnary(shape, HloOpcode::kNegate, add));
+    value = builder.AddInstruction(HloInstruction::CreateBinary(
+        shape, HloOpcode::kMultiply, add, duplicate));
+  }
+  auto module = std::make_unique<HloModule>("large", HloModuleConfig());
+  module->AddEntryComputation(builder.Build());
+  return module;
+}
+
+void BM_BuildLargeComputation(::testing::benchmark::State& state) {
+  const int64_t num_blocks = state.range(0);
+  for (auto s : state) {
+    std::unique_ptr<HloModule> module = MakeLargeModule(num_blocks);
+    state.PauseTiming();
+    module.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * 4 * num_blocks);
+}
+
+void BM_DceCseOnLargeComputation(::testing::benchmark::State& state) {
+  const int64_t num_blocks = state.range(0);
+  for (auto s : state) {
+    state.PauseTiming();
+    std::unique_ptr<HloModule> module = MakeLargeModule(num_blocks);
+    state.ResumeTiming();
+    HloPassPipeline pipeline("dce-cse");
+    pipeline.AddPass<HloDCE>();
+    pipeline.AddPass<HloCSE>(/*is_layout_sensitive=*/false);
+    pipeline.AddPass<HloDCE>();
+    CHECK(pipeline.Run(module.get()).value());
+    state.PauseTiming();
+    CHECK_EQ(module->entry_computation()->instruction_count(),
+             2 * num_blocks + 1);
+    module.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * 4 * num_blocks);
+}
+
+BENCHMARK(BM_BuildLargeComputation)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17);
+BENCHMARK(BM_DceCseOnLargeComputation)
+    ->Arg(1 << 10)
+    ->Arg(1 << 14)
+    ->Arg(1 << 17);
+
 }  // namespace
 }  // namespace xla
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "xla/hlo/ir/hlo_instruction.h"
 
+#include <cstdint>
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
@@ -22,10 +24,13 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/hlo/ir/hlo_module.h"
 #include "xla/literal.h"
 #include "xla/protobuf_util.h"
 #include "xla/service/gpu/backend_configs.pb.h"
@@ -36,6 +41,9 @@ limitations under the License.
 #include "xla/util.h"
 #include "xla/window_util.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
@@ -234,6 +242,53 @@ TEST_F(HloInstructionTest, RepeatedUser) {
   EXPECT_EQ(2, add->operand_count());
 }
 
+TEST_F(HloInstructionTest, ManyUsers) {
+  // Enough users that the instruction switches to indexing them, and back.
+  constexpr int kNumUsers = 40;
+  HloComputation::Builder builder(TestName());
+  auto foo =
+      builder.AddInstruction(HloInstruction::CreateParameter(0, r0f32_, "foo"));
+  auto bar =
+      builder.AddInstruction(HloInstruction::CreateParameter(1, r0f32_, "bar"));
+  std::vector<HloInstruction*> negates;
+  for (int i = 0; i < kNumUsers; ++i) {
+    negates.push_back(builder.AddInstruction(
+        HloInstruction::CreateUnary(r0f32_, HloOpcode::kNegate, foo)));
+  }
+  builder.AddInstruction(HloInstruction::CreateTuple(negates));
+  auto module = CreateNewVerifiedModule();
+  module->AddEntryComputation(builder.Build());
+
+  ASSERT_EQ(foo->user_count(), kNumUsers);
+  EXPECT_EQ(foo->users(), negates);
+  for (int i = 0; i < kNumUsers; ++i) {
+    EXPECT_TRUE(negates[i]->IsUserOf(foo));
+    EXPECT_FALSE(negates[i]->IsUserOf(bar));
+    EXPECT_EQ(foo->UserId(negates[i]), i);
+  }
+
+  // Removing a user moves the last user into its slot.
+  for (int i = 0; i < kNumUsers - 2; ++i) {
+    TF_ASSERT_OK(foo->ReplaceUseWith(negates[i], bar));
+    EXPECT_FALSE(negates[i]->IsUserOf(foo));
+    EXPECT_TRUE(negates[i]->IsUserOf(bar));
+    EXPECT_EQ(foo->user_count(), kNumUsers - i - 1);
+    for (int64_t j = 0; j < foo->user_count(); ++j) {
+      EXPECT_EQ(foo->UserId(foo->users()[j]), j);
+    }
+  }
+  EXPECT_THAT(foo->users(),
+              UnorderedElementsAre(negates[kNumUsers - 2], negates.back()));
+  EXPECT_EQ(bar->user_count(), kNumUsers - 2);
+
+  TF_ASSERT_OK(bar->ReplaceAllUsesWith(foo));
+  EXPECT_EQ(bar->user_count(), 0);
+  EXPECT_EQ(foo->user_count(), kNumUsers);
+  for (HloInstruction* negate : negates) {
+    EXPECT_TRUE(negate->IsUserOf(foo));
+  }
+}
+
 TEST_F(HloInstructionTest, MultipleUsersAndOperands) {
   //        [param0]          [param1]
   //           |                 |
@@ -711,6 +766,81 @@ TEST_F(HloInstructionTest, PreserveMetadataInFusionAndClone) {
   EXPECT_TRUE(protobuf_util::ProtobufEquals(metadata, fusion->metadata()));
 }
 
+TEST_F(HloInstructionTest, ClonesShareMetadataUntilModified) {
+  auto constant =
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(1.1f));
+  auto exp = HloInstruction::CreateUnary(r0f32_, HloOpcode::kExp,
+                                         constant.get());
+  EXPECT_EQ(&exp->metadata(), &OpMetadata::default_instance());
+  EXPECT_EQ(&exp->frontend_attributes(),
+            &FrontendAttributes::default_instance());
+
+  OpMetadata metadata;
+  metadata.set_op_name("tf_op");
+  exp->set_metadata(metadata);
+  FrontendAttributes attributes;
+  (*attributes.mutable_map())["key"] = "value";
+  exp->set_frontend_attributes(attributes);
+
+  auto clone = exp->Clone();
+  EXPECT_EQ(&clone->metadata(), &exp->metadata());
+  EXPECT_EQ(&clone->frontend_attributes(), &exp->frontend_attributes());
+
+  clone->set_metadata_op_name("other_op");
+  EXPECT_EQ(clone->metadata().op_name(), "other_op");
+  EXPECT_EQ(exp->metadata().op_name(), "tf_op");
+
+  FrontendAttributes more_attributes;
+  (*more_attributes.mutable_map())["other_key"] = "other_value";
+  clone->add_frontend_attributes(more_attributes);
+  EXPECT_EQ(clone->frontend_attributes().map().size(), 2);
+  EXPECT_EQ(exp->frontend_attributes().map().size(), 1);
+
+  // The creation pass id is never copied.
+  clone->set_creation_pass_id(42);
+  exp->set_metadata(clone->metadata());
+  EXPECT_EQ(exp->metadata().op_name(), "other_op");
+  EXPECT_EQ(exp->metadata().creation_pass_id(), 0);
+  EXPECT_EQ(clone->metadata().creation_pass_id(), 42);
+}
+
+TEST_F(HloInstructionTest, ConcurrentlyModifiedClonesKeepSharedMetadata) {
+  auto constant =
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(1.1f));
+  auto exp = HloInstruction::CreateUnary(r0f32_, HloOpcode::kExp,
+                                         constant.get());
+  OpMetadata metadata;
+  metadata.set_op_name("tf_op");
+  exp->set_metadata(metadata);
+  const OpMetadata* shared_metadata = &exp->metadata();
+
+  std::vector<std::unique_ptr<HloInstruction>> clones;
+  for (int i = 0; i < 8; ++i) {
+    clones.push_back(exp->Clone());
+  }
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "clones", clones.size());
+    for (int i = 0; i < clones.size(); ++i) {
+      pool.Schedule([&, i] {
+        for (int j = 0; j < 100; ++j) {
+          clones[i]->set_metadata_op_name(absl::StrCat("op_", i));
+          clones[i]->set_creation_pass_id(j);
+          EXPECT_EQ(exp->metadata().op_name(), "tf_op");
+        }
+      });
+    }
+  }
+
+  // Every clone got its own copy; the shared object was left alone.
+  EXPECT_EQ(&exp->metadata(), shared_metadata);
+  EXPECT_EQ(shared_metadata->op_name(), "tf_op");
+  EXPECT_EQ(shared_metadata->creation_pass_id(), 0);
+  for (int i = 0; i < clones.size(); ++i) {
+    EXPECT_EQ(clones[i]->metadata().op_name(), absl::StrCat("op_", i));
+    EXPECT_EQ(clones[i]->metadata().creation_pass_id(), 99);
+  }
+}
+
 TEST_F(HloInstructionTest, BinaryCallOp) {
   HloComputation::Builder builder(TestName());
   // Create a call instruction containing a single binary operation.
@@ -2202,5 +2332,85 @@ TEST_F(HloInstructionTest, BackendConfigCanContainNonFiniteFloats) {
   EXPECT_NE(new_config.alpha_imag(), new_config.alpha_imag());
 }
 
+// Builds a module of `num_layers` layers of elementwise instructions with
+// metadata, each of which also uses the parameter, so that the parameter has a
+// user for every instruction.
+std::unique_ptr<HloModule> MakeLargeSyntheticModule(int num_layers) {
+  const Shape shape = ShapeUtil::MakeShape(F32, {8});
+  HloModuleConfig config;
+  auto module = std::make_unique<HloModule>("large_synthetic_module", config);
+  HloComputation::Builder builder("entry");
+  HloInstruction* param =
+      builder.AddInstruction(HloInstruction::CreateParameter(0, shape, "p"));
+  OpMetadata metadata;
+  metadata.set_op_type("Add");
+  metadata.set_source_file("model.py");
+  HloInstruction* prev = param;
+  for (int i = 0; i < num_layers; ++i) {
+    metadata.set_op_name(absl::StrCat("layer_", i, "/add"));
+    metadata.set_source_line(i);
+    HloInstruction* add = builder.AddInstruction(
+        HloInstruction::CreateBinary(shape, HloOpcode::kAdd, prev, param));
+    add->set_metadata(metadata);
+    prev = builder.AddInstruction(
+        HloInstruction::CreateUnary(shape, HloOpcode::kNegate, add));
+    prev->set_metadata(metadata);
+  }
+  module->AddEntryComputation(builder.Build());
+  return module;
+}
+
+void BM_BuildAndCloneLargeModule(::testing::benchmark::State& state) {
+  const int num_layers = state.range(0);
+  int64_t metadata_bytes = 0;
+  int64_t instruction_count = 0;
+  for (auto s : state) {
+    std::unique_ptr<HloModule> module = MakeLargeSyntheticModule(num_layers);
+    std::unique_ptr<HloModule> clone = module->Clone();
+    state.PauseTiming();
+    // Metadata shared between instructions is only counted once.
+    absl::flat_hash_set<const OpMetadata*> seen;
+    metadata_bytes = 0;
+    instruction_count = 0;
+    for (const HloModule* m : {module.get(), clone.get()}) {
+      for (const HloInstruction* instruction :
+           m->entry_computation()->instructions()) {
+        ++instruction_count;
+        if (seen.insert(&instruction->metadata()).second) {
+          metadata_bytes += instruction->metadata().SpaceUsedLong();
+        }
+      }
+    }
+    state.ResumeTiming();
+  }
+  state.counters["metadata_bytes_per_instruction"] =
+      static_cast<double>(metadata_bytes) / instruction_count;
+}
+BENCHMARK(BM_BuildAndCloneLargeModule)->Arg(1 << 10)->Arg(1 << 14);
+
+void BM_ReplaceAllUsesOfWidelyUsedInstruction(
+    ::testing::benchmark::State& state) {
+  std::unique_ptr<HloModule> module = MakeLargeSyntheticModule(state.range(0));
+  HloComputation* entry = module->entry_computation();
+  HloInstruction* param = entry->parameter_instruction(0);
+  HloInstruction* other = entry->AddInstruction(
+      HloInstruction::CreateUnary(param->shape(), HloOpcode::kCopy, param));
+  for (auto s : state) {
+    // Moves every use of the parameter to `other` and back, which removes and
+    // adds each user once per direction.
+    std::vector<HloInstruction*> users;
+    for (HloInstruction* user : param->users()) {
+      if (user != other) {
+        users.push_back(user);
+      }
+    }
+    TF_CHECK_OK(param->ReplaceUsesWith(users, other));
+    TF_CHECK_OK(other->ReplaceAllUsesWith(param));
+  }
+}
+BENCHMARK(BM_ReplaceAllUsesOfWidelyUsedInstruction)
+    ->Arg(1 << 10)
+    ->Arg(1 << 14);
+
 }  // namespace
 }  // namespace xla
@@ -15,13 +15,23 @@ limitations under the License.
 
 #include "xla/hlo/ir/hlo_reachability.h"
 
+#include <cstdint>
+#include <memory>
+#include <random>
 #include <set>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_chain_reachability.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/service/computation_placer.h"
 #include "xla/test.h"
 #include "xla/test_helpers.h"
 #include "xla/tests/hlo_test_base.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 
@@ -240,6 +250,203 @@ TEST_F(HloReachabilityTest, ReplaceInstructions) {
   EXPECT_TRUE(reachability->IsReachable(p0, fusion));
 }
 
+TEST_F(HloReachabilityTest, ChainReachabilityChannelAndReplace) {
+  const Shape shape = ShapeUtil::MakeShape(F32, {5, 7});
+  HloComputation::Builder builder(TestName());
+  auto param = builder.AddInstruction(
+      HloInstruction::CreateParameter(0, shape, "param"));
+  auto token0 = builder.AddInstruction(HloInstruction::CreateToken());
+  auto send =
+      builder.AddInstruction(HloInstruction::CreateSend(param, token0, 1));
+  auto send_done = builder.AddInstruction(HloInstruction::CreateSendDone(send));
+  auto token1 = builder.AddInstruction(HloInstruction::CreateToken());
+  auto recv =
+      builder.AddInstruction(HloInstruction::CreateRecv(shape, token1, 1));
+  auto recv_done = builder.AddInstruction(HloInstruction::CreateRecvDone(recv));
+
+  auto module = CreateNewVerifiedModule();
+  module->config().set_use_spmd_partitioning(false);
+  module->config().set_static_device_assignment(DeviceAssignment(1, 2));
+  auto computation = module->AddEntryComputation(builder.Build(recv_done));
+  auto reachability = HloChainReachabilityMap::Build(computation);
+  EXPECT_TRUE(reachability->IsReachable(param, recv_done));
+  EXPECT_FALSE(reachability->IsReachable(send, recv));
+  EXPECT_FALSE(reachability->IsReachable(send_done, recv));
+  EXPECT_TRUE(reachability->IsConnected(recv_done, token1));
+  EXPECT_FALSE(reachability->IsConnected(token0, token1));
+
+  auto* copy = computation->AddInstruction(
+      HloInstruction::CreateUnary(shape, HloOpcode::kCopy, param));
+  EXPECT_FALSE(reachability->IsPresent(copy));
+  reachability->Replace(send, copy);
+  EXPECT_FALSE(reachability->IsPresent(send));
+  EXPECT_TRUE(reachability->IsReachable(param, copy));
+  EXPECT_TRUE(reachability->IsReachable(copy, send_done));
+}
+
+// Builds a random computation of scalar additions and negations, with a few
+// control dependencies, and checks that HloChainReachabilityMap agrees with
+// HloReachabilityMap before and after changing the graph.
+TEST_F(HloReachabilityTest, ChainReachabilityMatchesDenseReachability) {
+  const Shape r0f32 = ShapeUtil::MakeShape(F32, {});
+  std::minstd_rand0 engine;
+  for (int64_t max_label_size : {1, 3, 64}) {
+    HloComputation::Builder builder(TestName());
+    std::vector<HloInstruction*> instructions;
+    for (int i = 0; i < 4; ++i) {
+      instructions.push_back(builder.AddInstruction(
+          HloInstruction::CreateParameter(i, r0f32, absl::StrCat("p", i))));
+    }
+    auto random_instruction = [&](int64_t limit) {
+      return instructions[engine() % limit];
+    };
+    while (instructions.size() < 100) {
+      const int64_t size = instructions.size();
+      if (engine() % 3 == 0) {
+        instructions.push_back(
+            builder.AddInstruction(HloInstruction::CreateUnary(
+                r0f32, HloOpcode::kNegate, random_instruction(size))));
+      } else {
+        instructions.push_back(
+            builder.AddInstruction(HloInstruction::CreateBinary(
+                r0f32, HloOpcode::kAdd, random_instruction(size),
+                random_instruction(size))));
+      }
+    }
+    auto module = CreateNewVerifiedModule();
+    HloComputation* computation = module->AddEntryComputation(builder.Build());
+    // Control dependencies, like operands, point to earlier instructions.
+    for (int i = 0; i < 5; ++i) {
+      const int64_t successor = 1 + engine() % (instructions.size() - 1);
+      TF_ASSERT_OK(random_instruction(successor)->AddControlDependencyTo(
+          instructions[successor]));
+    }
+
+    auto dense = HloReachabilityMap::Build(computation);
+    auto chain = HloChainReachabilityMap::Build(computation, max_label_size);
+    auto expect_same_reachability = [&] {
+      for (const HloInstruction* a : instructions) {
+        for (const HloInstruction* b : instructions) {
+          ASSERT_EQ(chain->IsReachable(a, b), dense->IsReachable(a, b))
+              << a->name() << " -> " << b->name()
+              << ", max_label_size=" << max_label_size;
+        }
+      }
+    };
+    expect_same_reachability();
+
+    // Rewire operands to earlier instructions, which may both remove and add
+    // paths.
+    for (int i = 0; i < 20; ++i) {
+      const int64_t position = 4 + engine() % (instructions.size() - 4);
+      HloInstruction* instruction = instructions[position];
+      TF_ASSERT_OK(instruction->ReplaceOperandWith(
+          engine() % instruction->operand_count(),
+          random_instruction(position)));
+      dense->UpdateReachabilityThroughInstruction(instruction);
+      chain->UpdateReachabilityThroughInstruction(instruction);
+      expect_same_reachability();
+    }
+  }
+}
+
+// Builds a computation of `num_streams` chains of instructions that
+// occasionally combine with the neighbouring stream, and where every other
+// instruction reads its own parameter, like weights in a layered model.
+std::unique_ptr<HloModule> MakeLayeredModule(int64_t num_instructions,
+                                             int64_t num_streams) {
+  const Shape r0f32 = ShapeUtil::MakeShape(F32, {});
+  auto module = std::make_unique<HloModule>("layered", HloModuleConfig());
+  HloComputation::Builder builder("entry");
+  int64_t parameter_number = 0;
+  auto add_parameter = [&] {
+    return builder.AddInstruction(HloInstruction::CreateParameter(
+        parameter_number, r0f32, absl::StrCat("p", parameter_number++)));
+  };
+  std::vector<HloInstruction*> layer;
+  for (int64_t i = 0; i < num_streams; ++i) {
+    layer.push_back(add_parameter());
+  }
+  for (int64_t i = num_streams; i < num_instructions;) {
+    std::vector<HloInstruction*> next_layer;
+    for (int64_t j = 0; j < num_streams; ++j, ++i) {
+      HloInstruction* rhs = (i / num_streams + j) % 4 == 0
+                                ? layer[(j + 1) % num_streams]
+                                : add_parameter();
+      next_layer.push_back(builder.AddInstruction(HloInstruction::CreateBinary(
+          r0f32, HloOpcode::kAdd, layer[j], rhs)));
+    }
+    layer = std::move(next_layer);
+  }
+  builder.AddInstruction(HloInstruction::CreateTuple(layer));
+  module->AddEntryComputation(builder.Build());
+  return module;
+}
+
+// The queries of instruction fusion: whether an operand of an instruction
+// reaches another operand of the same instruction.
+std::vector<std::pair<const HloInstruction*, const HloInstruction*>>
+MakeOperandQueries(const HloComputation* computation) {
+  std::vector<std::pair<const HloInstruction*, const HloInstruction*>> queries;
+  for (const HloInstruction* instruction : computation->instructions()) {
+    for (const HloInstruction* a : instruction->operands()) {
+      for (const HloInstruction* b : instruction->operands()) {
+        queries.push_back({a, b});
+      }
+    }
+  }
+  return queries;
+}
+
+template <typename ReachabilityMap>
+void BM_BuildReachability(::testing::benchmark::State& state) {
+  std::unique_ptr<HloModule> module =
+      MakeLayeredModule(state.range(0), /*num_streams=*/32);
+  for (auto s : state) {
+    auto reachability = ReachabilityMap::Build(module->entry_computation());
+    ::testing::benchmark::DoNotOptimize(reachability);
+  }
+}
+BENCHMARK_TEMPLATE(BM_BuildReachability, HloReachabilityMap)
+    ->Arg(1 << 12)
+    ->Arg(1 << 15);
+BENCHMARK_TEMPLATE(BM_BuildReachability, HloChainReachabilityMap)
+    ->Arg(1 << 12)
+    ->Arg(1 << 15)
+    ->Arg(1 << 18);
+
+template <typename ReachabilityMap>
+void BM_QueryReachability(::testing::benchmark::State& state) {
+  std::unique_ptr<HloModule> module =
+      MakeLayeredModule(state.range(0), /*num_streams=*/state.range(1));
+  const HloComputation* computation = module->entry_computation();
+  auto reachability = ReachabilityMap::Build(computation);
+  auto queries = MakeOperandQueries(computation);
+  for (auto s : state) {
+    for (const auto& [a, b] : queries) {
+      ::testing::benchmark::DoNotOptimize(reachability->IsReachable(a, b));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+  const int64_t num_instructions = computation->instruction_count();
+  if constexpr (std::is_same_v<ReachabilityMap, HloReachabilityMap>) {
+    // The bit sets alone.
+    state.counters["bytes"] =
+        num_instructions * ((num_instructions + 63) / 64) * 8;
+  } else {
+    state.counters["bytes"] = reachability->SizeInBytes();
+  }
+}
+BENCHMARK_TEMPLATE(BM_QueryReachability, HloReachabilityMap)
+    ->ArgPair(1 << 12, 32)
+    ->ArgPair(1 << 15, 32)
+    ->ArgPair(1 << 15, 256);
+BENCHMARK_TEMPLATE(BM_QueryReachability, HloChainReachabilityMap)
+    ->ArgPair(1 << 12, 32)
+    ->ArgPair(1 << 15, 32)
+    ->ArgPair(1 << 15, 256)
+    ->ArgPair(1 << 18, 32);
+
 }  // namespace
 
 }  // namespace xla
@@ -28,9 +28,9 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "xla/debug_options_flags.h"
+#include "xla/hlo/ir/hlo_chain_reachability.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_opcode.h"
-#include "xla/hlo/ir/hlo_reachability.h"
 #include "xla/map_util.h"
 #include "xla/service/fusion_queue.h"
 #include "xla/service/hlo_dataflow_analysis.h"
@@ -237,7 +237,7 @@ bool InstructionFusion::EffectivelyAtMostUnary(HloInstruction* hlo) {
 bool InstructionFusion::CanFuseOnAllPaths(
     HloInstruction* producer, HloInstruction* consumer,
     const HloInstructionSet& do_not_fuse,
-    const HloReachabilityMap& reachability,
+    const HloChainReachabilityMap& reachability,
     absl::flat_hash_map<std::pair<HloInstruction*, HloInstruction*>, bool>*
         result_cache) {
   if (consumer == producer) {
@@ -280,7 +280,7 @@ bool InstructionFusion::CanFuseOnAllPaths(
 InstructionFusion::HloInstructionSet
 InstructionFusion::ComputeGloballyUnfusible(
     absl::Span<HloInstruction* const> post_order,
-    const HloReachabilityMap& reachability) {
+    const HloChainReachabilityMap& reachability) {
   // Forbid fusion of producers that:
   // a) Need to be duplicated, unless they can be fused into all consumers
   //    via all paths.
@@ -514,8 +514,8 @@ StatusOr<bool> InstructionFusion::Run(
 
   for (auto* computation : GetFusionComputations(module, execution_threads)) {
     CHECK(!computation->IsFusionComputation());
-    std::unique_ptr<HloReachabilityMap> reachability =
-        HloReachabilityMap::Build(computation);
+    std::unique_ptr<HloChainReachabilityMap> reachability =
+        HloChainReachabilityMap::Build(computation);
 
     HloInstructionSet do_not_duplicate;
     // If we allow duplications, we need to compute which instructions we do not
@@ -782,7 +782,7 @@ HloInstruction* InstructionFusion::FuseIntoMultiOutput(
 
 bool InstructionFusion::MultiOutputFusionCreatesCycle(
     HloInstruction* producer, HloInstruction* consumer,
-    const HloReachabilityMap& reachability) {
+    const HloChainReachabilityMap& reachability) {
   absl::flat_hash_set<int> operands;
   for (const HloInstruction* operand : consumer->operands()) {
     if (operand == producer) {
@@ -23,10 +23,10 @@ limitations under the License.
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "xla/hlo/ir/hlo_chain_reachability.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_module.h"
-#include "xla/hlo/ir/hlo_reachability.h"
 #include "xla/service/fusion_queue.h"
 #include "xla/service/hlo_pass_interface.h"
 
@@ -264,9 +264,9 @@ class InstructionFusion : public HloModulePass {
   }
 
   // Whether multi-output fusion would introduce a cycle into the HLO graph.
-  bool MultiOutputFusionCreatesCycle(HloInstruction* producer,
-                                     HloInstruction* consumer,
-                                     const HloReachabilityMap& reachability);
+  bool MultiOutputFusionCreatesCycle(
+      HloInstruction* producer, HloInstruction* consumer,
+      const HloChainReachabilityMap& reachability);
 
   FusionConfigCollection config_collection_mode() {
     return config_collection_mode_;
@@ -284,7 +284,7 @@ class InstructionFusion : public HloModulePass {
   // consumers based on a global analysis of the HLO graph.
   virtual HloInstructionSet ComputeGloballyUnfusible(
       absl::Span<HloInstruction* const> post_order,
-      const HloReachabilityMap& reachability);
+      const HloChainReachabilityMap& reachability);
 
  private:
   // Returns the reused operands of `instruction` from reused_fusion_operands_,
@@ -313,7 +313,7 @@ class InstructionFusion : public HloModulePass {
   bool CanFuseOnAllPaths(
       HloInstruction* producer, HloInstruction* consumer,
       const HloInstructionSet& do_not_fuse,
-      const HloReachabilityMap& reachability,
+      const HloChainReachabilityMap& reachability,
       absl::flat_hash_map<std::pair<HloInstruction*, HloInstruction*>, bool>*
           result_cache);
 
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef XLA_SERVICE_QR_EXPANDER_H_
 #define XLA_SERVICE_QR_EXPANDER_H_
 
+#include <utility>
+
 #include "absl/container/flat_hash_map.h"
 #include "xla/client/lib/qr.h"
 #include "xla/client/xla_builder.h"
@@ -25,6 +27,9 @@ namespace xla {
 
 class QrExpander : public OpExpanderPass {
  public:
+  explicit QrExpander(HloPredicate extra_filter = nullptr)
+      : OpExpanderPass(std::move(extra_filter)) {}
+
   absl::string_view name() const override { return "qr_expander"; }
 
  protected:
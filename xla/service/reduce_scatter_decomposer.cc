@@ -45,7 +45,8 @@ StatusOr<bool> ReduceScatterDecomposer::Run(
     for (HloInstruction *instruction :
          computation->MakeInstructionPostOrder()) {
       auto *rs = DynCast<HloReduceScatterInstruction>(instruction);
-      if (!rs || !rs->shape().IsArray()) {
+      if (!rs || !rs->shape().IsArray() ||
+          (should_decompose_ && !should_decompose_(*rs))) {
         continue;
       }
 
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef XLA_SERVICE_RNG_BIT_GENERATOR_EXPANDER_H_
 #define XLA_SERVICE_RNG_BIT_GENERATOR_EXPANDER_H_
 
+#include <utility>
+
 #include "absl/container/flat_hash_map.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_module.h"
@@ -28,8 +30,10 @@ namespace xla {
 
 class RngBitGeneratorExpander : public OpExpanderPass {
  public:
-  explicit RngBitGeneratorExpander(RandomAlgorithm default_algorithm)
-      : default_algorithm_(default_algorithm) {
+  explicit RngBitGeneratorExpander(RandomAlgorithm default_algorithm,
+                                   HloPredicate extra_filter = nullptr)
+      : OpExpanderPass(std::move(extra_filter)),
+        default_algorithm_(default_algorithm) {
     CHECK_NE(default_algorithm_, RandomAlgorithm::RNG_DEFAULT);
   }
 
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef XLA_SERVICE_SCATTER_EXPANDER_H_
 #define XLA_SERVICE_SCATTER_EXPANDER_H_
 
+#include <utility>
+
 #include "xla/service/op_expander_pass.h"
 
 namespace xla {
@@ -41,6 +43,9 @@ namespace xla {
 // Note that even in kEliminateSimpleScatters mode, this pass may still expand a
 // scatter into a loop (with a trip-count of 1).  It's up to other
 // simplification passes to remove the loop.
+//
+// An optional `extra_filter` further restricts which scatters are expanded, so
+// that backends can keep the scatters they emit natively.
 class ScatterExpander : public OpExpanderPass {
  public:
   enum Mode {
@@ -49,7 +54,8 @@ class ScatterExpander : public OpExpanderPass {
     kEliminateIndeterminisitcScatters,
   };
 
-  explicit ScatterExpander(Mode m) : mode_(m) {}
+  explicit ScatterExpander(Mode m, HloPredicate extra_filter = nullptr)
+      : OpExpanderPass(std::move(extra_filter)), mode_(m) {}
 
   absl::string_view name() const override { return "scatter_expander"; }
 
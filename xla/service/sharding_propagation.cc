@@ -30,6 +30,7 @@ limitations under the License.
 #include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/numeric/bits.h"
 #include "absl/strings/str_join.h"
 #include "absl/types/span.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
@@ -1229,6 +1230,59 @@ bool IsCSEPreventionSharding(const HloSharding& sharding) {
          "_sharding_propagation_cse_prevention";
 }
 
+// A set of positions in the post order of a computation, which can be visited
+// in either direction in time proportional to the number of words scanned.
+class PositionSet {
+ public:
+  // Creates a set containing all positions in [0, size).
+  explicit PositionSet(int64_t size)
+      : words_(CeilOfRatio<int64_t>(size, 64), ~uint64_t{0}) {
+    if (size % 64 != 0) {
+      words_.back() = (uint64_t{1} << (size % 64)) - 1;
+    }
+  }
+
+  void Insert(int64_t i) { words_[i / 64] |= uint64_t{1} << (i % 64); }
+  void Erase(int64_t i) { words_[i / 64] &= ~(uint64_t{1} << (i % 64)); }
+
+  // Returns the smallest position in the set greater than `i`, or -1.
+  int64_t Next(int64_t i) const {
+    ++i;
+    int64_t w = i / 64;
+    if (w >= words_.size()) {
+      return -1;
+    }
+    uint64_t word = words_[w] & (~uint64_t{0} << (i % 64));
+    while (word == 0) {
+      if (++w == words_.size()) {
+        return -1;
+      }
+      word = words_[w];
+    }
+    return w * 64 + absl::countr_zero(word);
+  }
+
+  // Returns the largest position in the set smaller than `i`, or -1.
+  int64_t Previous(int64_t i) const {
+    if (i <= 0) {
+      return -1;
+    }
+    --i;
+    int64_t w = i / 64;
+    uint64_t word = words_[w] & (~uint64_t{0} >> (63 - i % 64));
+    while (word == 0) {
+      if (w-- == 0) {
+        return -1;
+      }
+      word = words_[w];
+    }
+    return w * 64 + 63 - absl::countl_zero(word);
+  }
+
+ private:
+  std::vector<uint64_t> words_;
+};
+
 }  // namespace
 
 std::optional<HloSharding> InferBroadcastOperandSharding(
@@ -2695,45 +2749,76 @@ StatusOr<bool> ShardingPropagation::Run(
   int64_t iterations = 0;
 
   std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module);
+
+  // Propagation only changes shardings, so the post orders are computed once.
+  // Instead of the instructions themselves, the passes below track their
+  // positions in these post orders: an instruction needs to be visited again
+  // only if the sharding of one of its neighbors changed, and with positions
+  // each pass can skip to the next such instruction in post order.
+  std::vector<const HloComputation*> computations;
+  std::vector<std::vector<HloInstruction*>> post_orders;
+  absl::flat_hash_map<const HloInstruction*, std::pair<int64_t, int64_t>>
+      positions;
+  for (const HloComputation* computation :
+       module->computations(execution_threads)) {
+    const int64_t computation_index = computations.size();
+    computations.push_back(computation);
+    post_orders.push_back(computation->MakeInstructionPostOrder());
+    for (int64_t i = 0; i < post_orders.back().size(); ++i) {
+      positions[post_orders.back()[i]] = {computation_index, i};
+    }
+  }
+
   auto run_to_fix_point = [&](int64_t aggressiveness) {
-    absl::flat_hash_set<const HloInstruction*> already_inferred_from_operands;
-    absl::flat_hash_set<const HloInstruction*> already_inferred_from_users;
+    // The positions of the instructions to visit in the forward and backward
+    // passes, per computation. Initially all of them.
+    std::vector<PositionSet> pending_from_operands;
+    std::vector<PositionSet> pending_from_users;
+    for (const std::vector<HloInstruction*>& post_order : post_orders) {
+      pending_from_operands.emplace_back(post_order.size());
+      pending_from_users.emplace_back(post_order.size());
+    }
+    auto set_pending = [&](std::vector<PositionSet>& pending,
+                           const HloInstruction* hlo, bool is_pending) {
+      auto it = positions.find(hlo);
+      if (it == positions.end()) {
+        // Not in one of the computations of `execution_threads`.
+        return;
+      }
+      auto [computation_index, position] = it->second;
+      if (is_pending) {
+        pending[computation_index].Insert(position);
+      } else {
+        pending[computation_index].Erase(position);
+      }
+    };
+    auto clear_cache = [&](HloInstruction* hlo,
+                           HloInstruction* hlo_for_users = nullptr) {
+      for (auto operand : hlo->operands()) {
+        set_pending(pending_from_users, operand, true);
+      }
+      if (hlo_for_users == nullptr) {
+        hlo_for_users = hlo;
+      }
+      for (auto user : hlo_for_users->users()) {
+        set_pending(pending_from_operands, user, true);
+      }
+    };
     bool changed_last_iter = true;
     const bool may_merge_partial = is_spmd_ && aggressiveness > 0;
     while (changed_last_iter) {
       changed_last_iter = false;
       int64_t inferred_from_operand_counter = 0;
       int64_t inferred_from_user_counter = 0;
-      int64_t instruction_counter = 0;
-      int64_t already_sharded_counter = 0;
-      for (const HloComputation* computation :
-           module->computations(execution_threads)) {
-        VLOG(2) << "Consider computation: " << computation->name();
-        std::vector<HloInstruction*> instructions =
-            computation->MakeInstructionPostOrder();
-
-        instruction_counter += instructions.size();
-        already_sharded_counter += absl::c_count_if(
-            instructions,
-            [](const HloInstruction* inst) { return inst->has_sharding(); });
-        auto clear_cache = [&](HloInstruction* hlo,
-                               HloInstruction* hlo_for_users = nullptr) {
-          for (auto operand : hlo->operands()) {
-            already_inferred_from_users.erase(operand);
-          }
-          if (hlo_for_users == nullptr) {
-            hlo_for_users = hlo;
-          }
-          for (auto user : hlo_for_users->users()) {
-            already_inferred_from_operands.erase(user);
-          }
-        };
+      for (int64_t c = 0; c < computations.size(); ++c) {
+        VLOG(2) << "Consider computation: " << computations[c]->name();
+        const std::vector<HloInstruction*>& instructions = post_orders[c];
         // First iterate the HLO graph in post order taking shardings from
-        // operands.
-        for (HloInstruction* instruction : instructions) {
-          if (already_inferred_from_operands.contains(instruction)) {
-            continue;
-          }
+        // operands. Instructions that become pending behind the current
+        // position are visited in the next iteration.
+        for (int64_t i = pending_from_operands[c].Next(-1); i >= 0;
+             i = pending_from_operands[c].Next(i)) {
+          HloInstruction* instruction = instructions[i];
           if (provided_shardings.contains(instruction)) {
             if (!may_merge_partial) {
               continue;
@@ -2747,12 +2832,12 @@ StatusOr<bool> ShardingPropagation::Run(
               VLOG(2) << "Refined partial sharding (forward-pass): "
                       << instruction->ToString();
               clear_cache(instruction, man_conversion_op_after);
-              already_inferred_from_operands.insert(instruction);
+              pending_from_operands[c].Erase(i);
               changed_last_iter = true;
             }
             continue;
           }
-          already_inferred_from_operands.insert(instruction);
+          pending_from_operands[c].Erase(i);
           if (InferShardingFromOperands(instruction, computation_map,
                                         aggressiveness, *call_graph)) {
             ++inferred_from_operand_counter;
@@ -2770,51 +2855,50 @@ StatusOr<bool> ShardingPropagation::Run(
         }
         // Then iterate the HLO graph in reverse post order taking shardings
         // from users.
-        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
-          if ((*it)->IsCustomCall("SPMDFullToShardShape") ||
-              (*it)->IsCustomCall("SPMDShardToFullShape")) {
+        for (int64_t i = pending_from_users[c].Previous(instructions.size());
+             i >= 0; i = pending_from_users[c].Previous(i)) {
+          HloInstruction* instruction = instructions[i];
+          if (instruction->IsCustomCall("SPMDFullToShardShape") ||
+              instruction->IsCustomCall("SPMDShardToFullShape")) {
             // The manual conversion op is processed together with the sharding
             // op before it. If the conversion op is removed from cache, the
             // sharding op should also be removed.
-            if (!already_inferred_from_users.contains(*it)) {
-              already_inferred_from_users.erase((*it)->operand(0));
-            }
+            set_pending(pending_from_users, instruction->operand(0), true);
           }
-          if (already_inferred_from_users.contains(*it)) {
-            continue;
-          }
-          if (provided_shardings.contains(*it)) {
+          if (provided_shardings.contains(instruction)) {
             if (!may_merge_partial) {
               continue;
             }
-            auto uit = unspecified_dims.find(*it);
+            auto uit = unspecified_dims.find(instruction);
             HloInstruction* man_conversion_op_after;
             if (uit != unspecified_dims.end() &&
                 InferUnspecifiedDimsFromUsers(
-                    *it, uit->second, aggressiveness, is_spmd_,
+                    instruction, uit->second, aggressiveness, is_spmd_,
                     &man_conversion_op_after, *call_graph)) {
               ++inferred_from_user_counter;
               VLOG(2) << "Refined partial sharding (backward-pass): "
-                      << (*it)->ToString();
-              clear_cache(*it, man_conversion_op_after);
-              already_inferred_from_users.insert(*it);
+                      << instruction->ToString();
+              clear_cache(instruction, man_conversion_op_after);
+              pending_from_users[c].Erase(i);
               if (man_conversion_op_after != nullptr) {
-                already_inferred_from_users.insert(man_conversion_op_after);
+                set_pending(pending_from_users, man_conversion_op_after,
+                            false);
               }
               changed_last_iter = true;
             }
             continue;
           }
-          already_inferred_from_users.insert(*it);
-          if (InferShardingFromUsers(*it, computation_map, aggressiveness,
-                                     is_spmd_, sharding_helper_.get(),
-                                     *call_graph)) {
+          pending_from_users[c].Erase(i);
+          if (InferShardingFromUsers(instruction, computation_map,
+                                     aggressiveness, is_spmd_,
+                                     sharding_helper_.get(), *call_graph)) {
             ++inferred_from_user_counter;
             any_changed = true;
-            VLOG(2) << "Add sharding (backward-pass): " << (*it)->ToString();
+            VLOG(2) << "Add sharding (backward-pass): "
+                    << instruction->ToString();
             absl::flat_hash_set<HloInstruction*> changed_in_comp_prop;
-            maybe_computation_propagation(*it, &changed_in_comp_prop);
-            clear_cache(*it);
+            maybe_computation_propagation(instruction, &changed_in_comp_prop);
+            clear_cache(instruction);
             for (auto hlo : changed_in_comp_prop) {
               clear_cache(hlo);
             }
@@ -2822,14 +2906,25 @@ StatusOr<bool> ShardingPropagation::Run(
           }
         }
       }
-      VLOG(1) << "Sharding propagation iteration " << iterations << ";"
-              << "\n  total instructions: " << instruction_counter
-              << "\n  instructions already sharded: " << already_sharded_counter
-              << "\n  shardings inferred from operands: "
-              << inferred_from_operand_counter
-              << "\n  shardings inferred from users: "
-              << inferred_from_user_counter
-              << "\n  aggressiveness: " << aggressiveness;
+      if (VLOG_IS_ON(1)) {
+        int64_t instruction_counter = 0;
+        int64_t already_sharded_counter = 0;
+        for (const std::vector<HloInstruction*>& instructions : post_orders) {
+          instruction_counter += instructions.size();
+          already_sharded_counter += absl::c_count_if(
+              instructions,
+              [](const HloInstruction* inst) { return inst->has_sharding(); });
+        }
+        VLOG(1) << "Sharding propagation iteration " << iterations << ";"
+                << "\n  total instructions: " << instruction_counter
+                << "\n  instructions already sharded: "
+                << already_sharded_counter
+                << "\n  shardings inferred from operands: "
+                << inferred_from_operand_counter
+                << "\n  shardings inferred from users: "
+                << inferred_from_user_counter
+                << "\n  aggressiveness: " << aggressiveness;
+      }
       ++iterations;
     }
     return OkStatus();
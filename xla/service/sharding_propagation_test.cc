@@ -21,12 +21,14 @@ limitations under the License.
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/str_replace.h"
 #include "xla/hlo/ir/hlo_op_metadata.h"
 #include "xla/hlo/utils/hlo_matchers.h"
 #include "xla/protobuf_util.h"
 #include "xla/service/hlo_parser.h"
 #include "xla/tests/hlo_test_base.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace op = xla::testing::opcode_matchers;
 
@@ -9150,5 +9152,62 @@ ENTRY %entry {
   EXPECT_THAT(module->entry_computation()->parameter_instruction(1),
               op::Sharding("{devices=[4]0,1,2,3}"));
 }
+
+// Returns a module with a stack of `num_layers` transformer-style layers, each
+// an attention-like block of batched dots and an MLP, where only the input and
+// the weights are sharded.
+std::string MakeTransformerModule(int64_t num_layers) {
+  std::string hlo = R"(
+HloModule transformer
+
+ENTRY %entry {
+  %x0 = f32[8,128,512] parameter(0), sharding={devices=[4,1,1]0,1,2,3}
+)";
+  for (int64_t i = 0; i < num_layers; ++i) {
+    absl::StrAppend(
+        &hlo, absl::StrReplaceAll(R"(
+  %w1_$i = f32[512,2048] parameter($p1), sharding={devices=[1,4]0,1,2,3}
+  %w2_$i = f32[2048,512] parameter($p2), sharding={devices=[4,1]0,1,2,3}
+  %scores_$i = f32[8,128,128] dot(%x$i, %x$i), lhs_batch_dims={0},
+    lhs_contracting_dims={2}, rhs_batch_dims={0}, rhs_contracting_dims={2}
+  %probs_$i = f32[8,128,128] exponential(%scores_$i)
+  %context_$i = f32[8,128,512] dot(%probs_$i, %x$i), lhs_batch_dims={0},
+    lhs_contracting_dims={2}, rhs_batch_dims={0}, rhs_contracting_dims={1}
+  %attention_$i = f32[8,128,512] add(%x$i, %context_$i)
+  %hidden_$i = f32[8,128,2048] dot(%attention_$i, %w1_$i),
+    lhs_contracting_dims={2}, rhs_contracting_dims={0}
+  %activation_$i = f32[8,128,2048] tanh(%hidden_$i)
+  %mlp_$i = f32[8,128,512] dot(%activation_$i, %w2_$i),
+    lhs_contracting_dims={2}, rhs_contracting_dims={0}
+  %x$n = f32[8,128,512] add(%attention_$i, %mlp_$i)
+)",
+                                  {{"$i", absl::StrCat(i)},
+                                   {"$n", absl::StrCat(i + 1)},
+                                   {"$p1", absl::StrCat(2 * i + 1)},
+                                   {"$p2", absl::StrCat(2 * i + 2)}}));
+  }
+  absl::StrAppend(&hlo, "  ROOT %out = f32[8,128,512] copy(%x", num_layers,
+                  ")\n}\n");
+  return hlo;
+}
+
+void BM_TransformerLayers(::testing::benchmark::State& state) {
+  const int64_t num_layers = state.range(0);
+  const std::string hlo = MakeTransformerModule(num_layers);
+  for (auto s : state) {
+    state.PauseTiming();
+    auto module = ParseAndReturnUnverifiedModule(hlo).value();
+    state.ResumeTiming();
+    CHECK(ShardingPropagation(/*is_spmd=*/true, /*propagate_metadata=*/true)
+              .Run(module.get())
+              .value());
+    state.PauseTiming();
+    CHECK(module->entry_computation()->root_instruction()->has_sharding());
+    state.ResumeTiming();
+  }
+}
+
+BENCHMARK(BM_TransformerLayers)->Arg(16)->Arg(64)->Arg(256);
+
 }  // namespace
 }  // namespace xla
@@ -22,6 +22,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_replace.h"
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/hlo/utils/hlo_matchers.h"
 #include "xla/service/hlo_dce.h"
@@ -167,6 +168,46 @@ ENTRY cluster {
   }
 }
 
+TEST_F(TopkRewriterTest, RewriteOtherElementTypes) {
+  for (std::string type : {"f64", "f16", "s32"}) {
+    const std::string hlo_string = absl::StrReplaceAll(
+        R"(
+HloModule module
+
+%compare {
+  %p.0.lhs = $0[] parameter(0)
+  %p.0.rhs = $0[] parameter(1)
+  %p.1.lhs = s32[] parameter(2)
+  %p.1.rhs = s32[] parameter(3)
+  ROOT %gt = pred[] compare(%p.0.lhs, %p.0.rhs), direction=GT
+}
+
+ENTRY cluster {
+  %arg_tuple.1 = $0[8,1234] parameter(0)
+  %iota.4 = s32[8,1234] iota(), iota_dimension=1
+  %sort.27 = ($0[8,1234], s32[8,1234]) sort(%arg_tuple.1, %iota.4),
+    dimensions={1}, is_stable=true, to_apply=%compare
+  %get-tuple-element.28 = $0[8,1234] get-tuple-element(%sort.27), index=0
+  %slice.29 = $0[8,5] slice(%get-tuple-element.28), slice={[0:8], [0:5]}
+  %get-tuple-element.30 = s32[8,1234] get-tuple-element(%sort.27), index=1
+  %slice.31 = s32[8,5] slice(%get-tuple-element.30), slice={[0:8], [0:5]}
+  ROOT %tuple.32 = ($0[8,5], s32[8,5]) tuple(%slice.29, %slice.31)
+})",
+        {{"$0", type}});
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(hlo_string));
+    TopkRewriter rewriter(
+        [](const HloSortInstruction*, int64_t) { return true; });
+    TF_ASSERT_OK_AND_ASSIGN(bool changed, rewriter.Run(module.get()));
+    TF_ASSERT_OK(HloDCE().Run(module.get()).status());
+    EXPECT_TRUE(changed) << type;
+    EXPECT_THAT(
+        module->entry_computation()->root_instruction(),
+        op::Tuple(op::GetTupleElement(op::CustomCall(op::Parameter(0)), 0),
+                  op::GetTupleElement(op::CustomCall(op::Parameter(0)), 1)));
+  }
+}
+
 TEST_F(TopkRewriterTest, RewriteWithBroadcast) {
   for (std::string comparator : {getComparator(), getComparator()}) {
     const std::string hlo_string = R"(
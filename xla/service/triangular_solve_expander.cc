@@ -16,6 +16,7 @@ limitations under the License.
 #include "xla/service/triangular_solve_expander.h"
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "absl/types/span.h"
@@ -541,8 +542,9 @@ XlaOp TriangularSolveExpander::BuildTriangularSolve(
   });
 }
 
-TriangularSolveExpander::TriangularSolveExpander(int64_t block_size)
-    : block_size_(block_size) {
+TriangularSolveExpander::TriangularSolveExpander(int64_t block_size,
+                                                 HloPredicate extra_filter)
+    : OpExpanderPass(std::move(extra_filter)), block_size_(block_size) {
   CHECK_GE(block_size_, 1);
 }
 
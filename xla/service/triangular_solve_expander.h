@@ -24,7 +24,8 @@ namespace xla {
 
 class TriangularSolveExpander : public OpExpanderPass {
  public:
-  explicit TriangularSolveExpander(int64_t block_size = 128);
+  explicit TriangularSolveExpander(int64_t block_size = 128,
+                                   HloPredicate extra_filter = nullptr);
 
   absl::string_view name() const override {
     return "triangular_solve_expander";